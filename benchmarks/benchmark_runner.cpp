@@ -3,9 +3,23 @@
 
 #include "benchmark_scenario.h"
 #include "benchmark_service.h"
+#include "compressing_service.h"
 #include "inprocess_framework.h"
+#include "parameter_sweep.h"
+#include "payload_generator.h"
+#include "recording_service.h"
+#include "reference_service.h"
+#include "resource_usage.h"
+#include "server_process.h"
+#include "wait_strategy.h"
+#include "work_stealing_executor.h"
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
 #include <iostream>
 #include <memory>
+#include <sstream>
 #include <vector>
 #include <string>
 
@@ -15,6 +29,14 @@ namespace scenarios {
 extern std::unique_ptr<BenchmarkScenario> CreateEchoBenchmark();
 extern std::unique_ptr<BenchmarkScenario> CreateThroughputBenchmark();
 extern std::unique_ptr<BenchmarkScenario> CreateReliabilityBenchmark();
+extern std::unique_ptr<BenchmarkScenario> CreateSloThroughputBenchmark();
+extern std::unique_ptr<BenchmarkScenario> CreateMixedWorkloadBenchmark();
+extern std::unique_ptr<BenchmarkScenario> CreateTraceReplayBenchmark();
+extern std::unique_ptr<BenchmarkScenario> CreateConnectionChurnBenchmark();
+extern std::unique_ptr<BenchmarkScenario> CreateFanOutBenchmark();
+extern std::unique_ptr<BenchmarkScenario> CreateLargeMessageBenchmark();
+extern std::unique_ptr<BenchmarkScenario> CreateEchoChainBenchmark();
+extern std::unique_ptr<BenchmarkScenario> CreateShapeEchoBenchmark();
 }
 }
 
@@ -22,43 +44,423 @@ extern std::unique_ptr<BenchmarkScenario> CreateReliabilityBenchmark();
 namespace benchmark {
 namespace inprocess {
 extern std::unique_ptr<common::IFrameworkFactory> CreateInProcessFactory();
+extern std::unique_ptr<common::IFrameworkFactory> CreateThreadedFactory(
+    HandoffQueueKind queue, common::WaitStrategy wait);
 }
+#ifdef HAS_RAWTCP
+namespace rawtcp {
+extern std::unique_ptr<common::IFrameworkFactory> CreateRawTcpFactory(bool handler_pool);
+extern std::unique_ptr<common::IFrameworkFactory> CreateUdsFactory(size_t fd_threshold,
+                                                                  bool handler_pool);
+extern std::unique_ptr<common::IFrameworkFactory> CreateRawTcpUringFactory(bool handler_pool);
+extern std::unique_ptr<common::IFrameworkFactory> CreateUdsUringFactory(bool handler_pool);
+}
+#endif
+#ifdef HAS_SHM
+namespace shm {
+extern std::unique_ptr<common::IFrameworkFactory> CreateShmFactory(common::WaitStrategy wait,
+                                                                  bool handler_pool);
+extern std::unique_ptr<common::IFrameworkFactory> CreateShmPollFactory(bool handler_pool);
+}
+#endif
+#ifdef HAS_GRPC
+namespace grpc_impl {
+extern std::unique_ptr<common::IFrameworkFactory> CreateGrpcFactory(int channels);
+extern std::unique_ptr<common::IFrameworkFactory> CreateGrpcSyncFactory(int channels);
+extern std::unique_ptr<common::IFrameworkFactory> CreateGrpcCallbackFactory(int channels);
+extern std::unique_ptr<common::IFrameworkFactory> CreateGrpcArenaFactory(int channels);
+extern std::unique_ptr<common::IFrameworkFactory> CreateGrpcRawFactory(int channels);
+extern double EchoCodecNanos(const common::IFrameworkFactory* factory, size_t message_size);
+}
+#endif
+#ifdef HAS_CAPNPROTO
+namespace capnp_impl {
+extern std::unique_ptr<common::IFrameworkFactory> CreateCapnProtoFactory();
+}
+#endif
+#ifdef HAS_TRPC
+namespace trpc_impl {
+extern std::unique_ptr<common::IFrameworkFactory> CreateTrpcFactory(int threads);
+extern std::unique_ptr<common::IFrameworkFactory> CreateTrpcMergeFactory(int threads);
+extern std::unique_ptr<common::IFrameworkFactory> CreateTrpcSeparateFactory(int threads);
+}
+#endif
 }
-
-// TODO: Add framework factory registration when implementations are complete
-// #ifdef HAS_GRPC
-// extern std::unique_ptr<common::IFrameworkFactory> CreateGrpcFactory();
-// #endif
-// #ifdef HAS_CAPNPROTO
-// extern std::unique_ptr<common::IFrameworkFactory> CreateCapnProtoFactory();
-// #endif
-// #ifdef HAS_TRPC
-// extern std::unique_ptr<common::IFrameworkFactory> CreateTrpcFactory();
-// #endif
 
 void PrintUsage(const char* program_name) {
   std::cout << "Usage: " << program_name << " [options]\n"
             << "\nOptions:\n"
-            << "  --framework <name>     Framework to benchmark\n"
-            << "                         Options: inprocess|grpc|capnproto|trpc|all\n"
+            << "  --framework <names>    Comma-separated frameworks to benchmark\n"
+            << "                         Options: inprocess|inprocess-mutex|inprocess-mpmc|\n"
+            << "                         inprocess-spsc|inprocess-steal|rawtcp|rawtcp-uring|\n"
+            << "                         uds|uds-inline|uds-uring|shm|shm-poll|grpc|\n"
+            << "                         grpc-sync|grpc-callback|grpc-arena|grpc-raw|\n"
+            << "                         capnproto|trpc|trpc-merge|trpc-separate|all\n"
             << "                         (default: all)\n"
-            << "  --scenario <name>      Scenario to run (echo|throughput|reliability|all)\n"
+            << "  --scenario <name>      Scenario to run\n"
+            << "                         (echo|throughput|reliability|slo|mixed|replay|\n"
+            << "                         churn|fanout|large|chain|shapes|all)\n"
             << "                         (default: echo)\n"
             << "  --duration <seconds>   Test duration (default: 10)\n"
-            << "  --message-size <bytes> Message size (default: 1024)\n"
+            << "  --warmup <seconds>     Warm-up before measuring (default: 1)\n"
+            << "  --message-size <list>  Message size(s) in bytes; each scenario runs once\n"
+            << "                         per size (default: 1024)\n"
+            << "  --payload <spec>       Payload content: random | entropy:<bits> | text |\n"
+            << "                         json | records (default: a run of 'x' for echo\n"
+            << "                         messages, random bytes for chunks)\n"
+            << "  --payload-seed <n>     Seed of the payload content (default: 1)\n"
+            << "  --threads <n>          Worker threads per client (default: 1)\n"
+            << "  --pipeline-depth <n>   Outstanding async requests per thread (default: 1)\n"
             << "  --address <addr>       Server address (default: localhost:50051)\n"
+            << "  --external-server      Use a server already listening at --address instead\n"
+            << "                         of starting one in this process\n"
+            << "  --fd-threshold <n>     Body size from which the uds framework passes a\n"
+            << "                         memfd instead of copying (default: 64K)\n"
+            << "  --wait-strategy <list> How idle threads of the inprocess-mutex/mpmc/spsc\n"
+            << "                         and shm frameworks wait: spin|spin-yield|\n"
+            << "                         spin-futex|block; each framework runs once per\n"
+            << "                         strategy (default: spin-futex for inprocess-*,\n"
+            << "                         block for shm)\n"
+            << "  --grpc-channels <n>    Connections each gRPC client spreads its threads\n"
+            << "                         over (default: 1)\n"
+            << "  --trpc-threads <n>     Runtime threads of the trpc frameworks: fiber\n"
+            << "                         workers, or reactor plus handler threads\n"
+            << "                         (default: one per CPU)\n"
+            << "  --handler-pool         Run the native servers' unary handlers and the\n"
+            << "                         reference service's async completions on a shared\n"
+            << "                         work-stealing pool, and report its counters\n"
             << "  --output <file>        Output JSON results to file\n"
             << "  --verbose              Enable verbose output\n"
             << "  --help                 Show this help message\n"
+            << "\nProcess Placement:\n"
+            << "  --server-mode          Only serve the selected framework at --address until\n"
+            << "                         interrupted, for a client run elsewhere\n"
+            << "  --client-mode          Only run clients, against a server started with\n"
+            << "                         --server-mode (same as --external-server)\n"
+            << "  --fork-server          Start each framework's server in a child process and\n"
+            << "                         report its CPU and memory next to the client's\n"
+            << "                         (in-process frameworks are always served here)\n"
+            << "  --server-cpus <list>   CPUs for the server, e.g. 0-3,8 (default: all)\n"
+            << "  --client-cpus <list>   CPUs for the clients (default: all)\n"
+            << "\nLatency SLO (slo scenario):\n"
+            << "  --slo-latency-us <us>  Latency bound (default: 1000)\n"
+            << "  --slo-percentile <p>   Percentile held to the bound, e.g. 99 or 99.9\n"
+            << "                         (default: 99)\n"
+            << "  --slo-start-rps <r>    First offered rate of the ramp (default: 1000)\n"
+            << "  --slo-max-rps <r>      Upper limit of the ramp (default: 10000000)\n"
+            << "\nMixed Workload (mixed scenario):\n"
+            << "  --mix <weights>        Operation weights (default: echo=80,batch=15,stream=5)\n"
+            << "  --size-dist <spec>     Payload sizes: fixed:<n> | uniform:<min>:<max> |\n"
+            << "                         lognormal:<median>:<sigma>[:<max>] |\n"
+            << "                         bimodal:<small>:<large>:<p_large> | cdf:<file>\n"
+            << "                         (default: fixed at --message-size)\n"
+            << "                         Runs on --threads workers, at least one per\n"
+            << "                         weighted operation and never fewer than two\n"
+            << "\nScatter-Gather (fanout scenario):\n"
+            << "  --fanout <list>        Backend counts, e.g. 1:64:x2 (default: 1,2,4,8,16)\n"
+            << "  --fanout-k <n>         Backends addressed per request (default: all)\n"
+            << "  --fanout-quorum <n>    Answers needed to complete (default: all addressed)\n"
+            << "\nLarge Messages (large scenario):\n"
+            << "  --large-sizes <list>   Payload sizes, e.g. 1M:1G:x4 (default: 1M:64M:x4)\n"
+            << "  --large-chunk-size <n> Chunk size of streamed transfers (default: 1M)\n"
+            << "  --large-repeats <n>    Unary calls per size (default: 3)\n"
+            << "\nDependent Calls (chain scenario):\n"
+            << "  --chain-lengths <list> Calls per chain, e.g. 1:32:x2 (default: 1,2,4,8,16)\n"
+            << "\nMessage Shapes (shapes scenario):\n"
+            << "  --shapes <list>        Shapes to echo: nested,arrays,map,sparse,strings\n"
+            << "                         or all (default: all)\n"
+            << "  --shape-sizes <list>   Field bytes per message, e.g. 64:1M:x4\n"
+            << "                         (default: 256,4K,64K)\n"
+            << "\nCompression:\n"
+            << "  --compression <name>   Compress payloads (echo message, chunk and batch\n"
+            << "                         data) at both ends of every framework call:\n"
+            << "                         lz|zlib, zlib where it was found at build time\n"
+            << "                         (default: off)\n"
+            << "  --compress-threshold <spec>\n"
+            << "                         Smallest payload compressed: <bytes> for all, or\n"
+            << "                         echo=<bytes>,chunk=<bytes>,batch=<bytes>\n"
+            << "                         (default: 256)\n"
+            << "  --link-gbps <list>     Simulated link rates for the effective\n"
+            << "                         throughput report (default: 1,10,100)\n"
+            << "\nWorkload Traces:\n"
+            << "  --record-trace <file>  Record every call made by the run to a trace\n"
+            << "  --trace <file>         Trace to replay (replay scenario)\n"
+            << "  --trace-speed <x>      Replay speed factor (default: 1.0)\n"
+            << "\nSweep Mode:\n"
+            << "  --sweep                Run an echo sweep over the grid below instead of\n"
+            << "                         the selected scenarios\n"
+            << "  --sweep-sizes <list>   Message sizes (default: 1024)\n"
+            << "  --sweep-clients <list> Client counts (default: 1)\n"
+            << "  --sweep-threads <list> Threads per client (default: 1)\n"
+            << "  --sweep-depths <list>  Pipelining depths (default: 1)\n"
+            << "  --sweep-samples <n>    Latin-hypercube sample count (default: 0 = full grid)\n"
+            << "  --seed <n>             Sampling seed (default: 1)\n"
+            << "  --csv <file>           Output the sweep grid as CSV\n"
+            << "  Lists are comma-separated values and inclusive ranges with an optional\n"
+            << "  step, e.g. 64:64K:x4 (geometric) or 1:8:+1 (arithmetic); values take\n"
+            << "  an optional K/M/G suffix\n"
             << "\nAvailable Frameworks:\n"
             << "  inprocess  - In-process reference implementation (no network)\n"
-            << "  grpc       - gRPC (requires gRPC installation)\n"
+            << "  inprocess-mutex, inprocess-mpmc, inprocess-spsc\n"
+            << "             - In-process, but calls cross to server worker threads\n"
+            << "               through a mutex queue, a lock-free MPMC ring, or an\n"
+            << "               SPSC ring per client thread (thread handoff baseline)\n"
+            << "  inprocess-steal\n"
+            << "             - The same handoff into the shared work-stealing pool\n"
+            << "  rawtcp     - Native epoll TCP transport (kernel networking baseline)\n"
+            << "  uds        - The same transport over Unix sockets, passing large\n"
+            << "               bodies as memfds (see --fd-threshold)\n"
+            << "  uds-inline - Unix sockets with every body copied through the socket\n"
+            << "  rawtcp-uring, uds-uring\n"
+            << "             - rawtcp and uds-inline with io_uring server loops; epoll\n"
+            << "               where the kernel lacks io_uring (needs Linux 6.1+)\n"
+            << "  shm        - Shared-memory rings between processes, futex wakeups\n"
+            << "  shm-poll   - shm with --wait-strategy spin-yield\n"
+            << "  grpc       - gRPC on the completion-queue API, one queue and\n"
+            << "               polling thread per CPU (requires gRPC installation)\n"
+            << "  grpc-sync, grpc-callback\n"
+            << "             - gRPC on the sync and callback server APIs\n"
+            << "  grpc-arena - grpc-callback with unary messages on per-call arenas\n"
+            << "  grpc-raw   - grpc-callback with unary calls sent as pre-serialized\n"
+            << "               ByteBuffers, encoded straight from the common types\n"
             << "  capnproto  - Cap'n Proto (requires Cap'n Proto installation)\n"
-            << "  trpc       - tRPC-cpp (requires tRPC installation)\n"
+            << "  trpc       - tRPC-cpp on its fiber runtime (requires tRPC installation)\n"
+            << "  trpc-merge, trpc-separate\n"
+            << "             - tRPC-cpp on the merge (I/O threads run handlers) and\n"
+            << "               separate (I/O and handler pools) thread models; unary\n"
+            << "               calls only, streams need the fiber runtime\n"
             << "  all        - Run all available frameworks\n"
             << std::endl;
 }
 
+bool WriteTextFile(const std::string& path, const std::string& contents) {
+  std::ofstream out(path);
+  if (!out) {
+    std::cerr << "Error: Cannot open " << path << " for writing" << std::endl;
+    return false;
+  }
+  out << contents;
+  return static_cast<bool>(out);
+}
+
+// Serve the reference service through the framework for the duration of
+// its runs. Failing to start is not fatal for a network framework, as a
+// server may already be listening at the address, but nothing outside this
+// process can serve an in-process one, so the caller skips it.
+std::unique_ptr<benchmark::common::IBenchmarkServer> StartLocalServer(
+    benchmark::common::IFrameworkFactory* factory, const std::string& address,
+    bool handler_pool) {
+  auto server = factory->CreateServer(benchmark::scenarios::MakeReferenceService(handler_pool));
+  if (!server || !server->Start(address)) {
+    if (factory->IsInProcess()) {
+      std::cerr << "Error: could not start a " << factory->GetName() << " server at "
+                << address << ", skipping it" << std::endl;
+    } else {
+      std::cerr << "Warning: could not start a " << factory->GetName() << " server at "
+                << address << ", expecting one to be running" << std::endl;
+    }
+    return nullptr;
+  }
+  return server;
+}
+
+// True if `name` is in the comma-separated framework list or it is "all"
+bool Selected(const std::string& list, const std::string& name) {
+  size_t begin = 0;
+  while (begin <= list.size()) {
+    size_t end = list.find(',', begin);
+    if (end == std::string::npos) end = list.size();
+    std::string item = list.substr(begin, end - begin);
+    if (item == name || item == "all") return true;
+    begin = end + 1;
+  }
+  return false;
+}
+
+// Counters of the shared work-stealing pool over a run, when it runs in
+// this process
+void AddExecutorMetrics(const benchmark::common::ExecutorStats& stats,
+                        benchmark::scenarios::BenchmarkResults* results) {
+  results->custom_metrics.emplace_back("pool_workers", stats.num_workers);
+  results->custom_metrics.emplace_back("pool_tasks", static_cast<double>(stats.executed));
+  results->custom_metrics.emplace_back("pool_injected", static_cast<double>(stats.injected));
+  results->custom_metrics.emplace_back("pool_steals", static_cast<double>(stats.steals));
+  results->custom_metrics.emplace_back("pool_max_queue_depth",
+                                       static_cast<double>(stats.max_queue_depth));
+  results->custom_metrics.emplace_back("pool_idle_percent", stats.IdlePercent());
+}
+
+#ifdef HAS_GRPC
+// Codec cost of an echo round trip, measured on its own, next to the rest
+// of the echo latency, which is transport and scheduling
+void AddCodecMetrics(double codec_ns, benchmark::scenarios::BenchmarkResults* results) {
+  results->custom_metrics.emplace_back("codec_us", codec_ns / 1000.0);
+  if (results->scenario_name != "Echo Latency" || results->latency_stats.GetCount() == 0) return;
+  double p50_ns = static_cast<double>(results->latency_stats.GetP50());
+  results->custom_metrics.emplace_back("transport_us", std::max(0.0, p50_ns - codec_ns) / 1000.0);
+  results->custom_metrics.emplace_back("codec_percent", p50_ns > 0 ? 100.0 * codec_ns / p50_ns : 0);
+}
+#endif
+
+// What the compression stage did over a run: ratio, CPU cost, and the
+// payload rate it would reach over each simulated link, where compressing
+// pays off once its CPU time costs less than the link time it saves
+void AddCompressionMetrics(const benchmark::common::compression::Stats& stats,
+                           const std::vector<double>& link_gbps,
+                           benchmark::scenarios::BenchmarkResults* results) {
+  uint64_t raw_bytes = stats.raw_bytes;
+  uint64_t wire_bytes = stats.wire_bytes;
+  if (stats.packed == 0 || wire_bytes == 0) return;
+  results->custom_metrics.emplace_back(
+      "compress_ratio", static_cast<double>(raw_bytes) / static_cast<double>(wire_bytes));
+  results->custom_metrics.emplace_back(
+      "compressed_percent", 100.0 * static_cast<double>(stats.compressed) /
+                                static_cast<double>(stats.packed));
+  if (stats.compress_ns > 0) {
+    results->custom_metrics.emplace_back(
+        "compress_mbps", benchmark::common::utils::CalculateThroughputMBps(
+                             raw_bytes, static_cast<int64_t>(stats.compress_ns.load())));
+  }
+  if (stats.decompress_ns > 0) {
+    results->custom_metrics.emplace_back(
+        "decompress_mbps",
+        benchmark::common::utils::CalculateThroughputMBps(
+            stats.unpacked_bytes, static_cast<int64_t>(stats.decompress_ns.load())));
+  }
+  if (stats.errors > 0) {
+    results->custom_metrics.emplace_back("unpack_errors", static_cast<double>(stats.errors));
+  }
+  for (double gbps : link_gbps) {
+    double link = gbps * 1e9 / 8;
+    double effective = benchmark::common::compression::EffectiveThroughput(stats, link);
+    std::ostringstream name;
+    name << gbps << "gbps";
+    results->custom_metrics.emplace_back("effective_mbps_at_" + name.str(), effective / 1e6);
+    results->custom_metrics.emplace_back("speedup_at_" + name.str(), effective / link);
+  }
+}
+
+// Parse a comma-separated list of link rates in Gbit/s
+bool ParseLinkRates(const char* text, std::vector<double>* rates) {
+  rates->clear();
+  std::stringstream items(text);
+  std::string item;
+  while (std::getline(items, item, ',')) {
+    char* end = nullptr;
+    double rate = std::strtod(item.c_str(), &end);
+    if (item.empty() || *end != '\0' || rate <= 0) {
+      std::cerr << "Invalid rate in --link-gbps: " << text << std::endl;
+      return false;
+    }
+    rates->push_back(rate);
+  }
+  return !rates->empty();
+}
+
+// Parse a comma-separated list of wait strategy names
+bool ParseWaitStrategies(const char* text,
+                         std::vector<benchmark::common::WaitStrategy>* strategies) {
+  strategies->clear();
+  std::string list = text;
+  size_t begin = 0;
+  while (begin <= list.size()) {
+    size_t end = list.find(',', begin);
+    if (end == std::string::npos) end = list.size();
+    benchmark::common::WaitStrategy strategy;
+    if (!benchmark::common::ParseWaitStrategy(list.substr(begin, end - begin), &strategy)) {
+      std::cerr << "Invalid wait strategy in --wait-strategy: " << text << std::endl;
+      return false;
+    }
+    strategies->push_back(strategy);
+    begin = end + 1;
+  }
+  return true;
+}
+
+// Latency next to CPU cost for every run, so configurations that trade one
+// for the other (such as wait strategies) can be compared at a glance
+void PrintComparison(const std::vector<benchmark::scenarios::BenchmarkResults>& results) {
+  std::cout << "\n========================================" << std::endl;
+  std::cout << "Latency vs CPU" << std::endl;
+  std::cout << "========================================" << std::endl;
+  std::cout << std::left << std::setw(44) << "Framework" << std::setw(14) << "Scenario"
+            << std::right << std::setw(12) << "req/s" << std::setw(10) << "p50 us"
+            << std::setw(10) << "p99 us" << std::setw(10) << "p99.9 us" << std::setw(8)
+            << "CPU%" << std::setw(12) << "CPU us/req" << std::endl;
+  for (const auto& result : results) {
+    const auto& latency = result.latency_stats;
+    double cpu_percent = result.avg_cpu_percent + result.server_cpu_percent;
+    double cpu_us = result.cpu_us_per_request + result.server_cpu_us_per_request;
+    std::cout << std::left << std::setw(44) << result.framework_name << std::setw(14)
+              << result.scenario_name << std::right << std::fixed << std::setprecision(0)
+              << std::setw(12) << result.requests_per_second << std::setprecision(1)
+              << std::setw(10) << latency.GetP50() / 1000.0 << std::setw(10)
+              << latency.GetP99() / 1000.0 << std::setw(10)
+              << latency.GetPercentile(0.999) / 1000.0 << std::setw(8) << cpu_percent
+              << std::setprecision(2) << std::setw(12) << cpu_us << std::endl;
+  }
+  std::cout << std::endl;
+}
+
+// Fork a server process for the framework. As with StartLocalServer(),
+// failing to start is not fatal.
+std::unique_ptr<benchmark::scenarios::ServerProcess> StartServerProcess(
+    benchmark::common::IFrameworkFactory* factory, const std::string& address,
+    const std::vector<int>& cpus, bool handler_pool) {
+  auto process = std::make_unique<benchmark::scenarios::ServerProcess>();
+  if (!process->Start(factory, address, cpus, handler_pool)) {
+    std::cerr << "Warning: could not start a " << factory->GetName()
+              << " server process at " << address << ", expecting one to be running"
+              << std::endl;
+    return nullptr;
+  }
+  return process;
+}
+
+// Where a framework's server runs. In-process frameworks can only be
+// reached from this process, so they are served here whatever
+// --fork-server or --external-server ask for.
+enum class ServerPlacement { kLocal, kForked, kExternal };
+
+ServerPlacement PlaceServer(const benchmark::common::IFrameworkFactory* factory,
+                            bool fork_server, bool external_server) {
+  if (factory->IsInProcess()) {
+    if (fork_server || external_server) {
+      std::cout << "  Note: " << factory->GetName()
+                << " is in-process, serving it in this process" << std::endl;
+    }
+    return ServerPlacement::kLocal;
+  }
+  if (fork_server) return ServerPlacement::kForked;
+  return external_server ? ServerPlacement::kExternal : ServerPlacement::kLocal;
+}
+
+// Lets load-generating scenarios sample the server's CPU over their own
+// measured window
+void AttachServerProcess(benchmark::scenarios::ServerProcess* process,
+                         benchmark::scenarios::BenchmarkConfig* config) {
+  config->server_cpu_nanos = [process]() -> int64_t {
+    benchmark::scenarios::ServerUsage usage;
+    return process->Sample(&usage) ? usage.cpu_ns : -1;
+  };
+}
+
+bool ParseCpuArg(const std::string& flag, const char* text, std::vector<int>* cpus) {
+  if (!benchmark::common::utils::ParseCpuList(text, cpus)) {
+    std::cerr << "Invalid CPU list for " << flag << ": " << text << std::endl;
+    return false;
+  }
+  return true;
+}
+
+bool ParseSweepArg(const std::string& flag, const char* text, std::vector<long>* values) {
+  if (!benchmark::scenarios::ParseSweepList(text, values)) {
+    std::cerr << "Invalid list for " << flag << ": " << text << std::endl;
+    return false;
+  }
+  return true;
+}
+
 int main(int argc, char* argv[]) {
   std::cout << "proto-bench: RPC Framework Benchmark\n" << std::endl;
 
@@ -66,6 +468,27 @@ int main(int argc, char* argv[]) {
   benchmark::scenarios::BenchmarkConfig config;
   std::string framework = "all";
   std::string scenario = "echo";
+  bool sweep = false;
+  benchmark::scenarios::SweepSpec sweep_spec;
+  std::string csv_file;
+  std::vector<long> message_sizes = {static_cast<long>(config.message_size)};
+  std::string record_trace_file;
+  bool external_server = false;
+  bool server_mode = false;
+  bool fork_server = false;
+  std::vector<int> server_cpus;
+  std::vector<int> client_cpus;
+  size_t fd_threshold = 64 * 1024;
+  // Accepted in every build, read only where gRPC and tRPC were built
+  [[maybe_unused]] long grpc_channels = 1;
+  [[maybe_unused]] long trpc_threads = 0;
+  std::vector<benchmark::common::WaitStrategy> wait_strategies;
+  bool handler_pool = false;
+  std::string payload_spec;
+  uint64_t payload_seed = 1;
+  std::string compression;
+  benchmark::common::compression::Thresholds compress_thresholds;
+  std::vector<double> link_gbps = {1, 10, 100};
 
   for (int i = 1; i < argc; i++) {
     std::string arg = argv[i];
@@ -79,10 +502,109 @@ int main(int argc, char* argv[]) {
       scenario = argv[++i];
     } else if (arg == "--duration" && i + 1 < argc) {
       config.duration_seconds = std::stoi(argv[++i]);
+    } else if (arg == "--warmup" && i + 1 < argc) {
+      config.warmup_seconds = std::stoi(argv[++i]);
     } else if (arg == "--message-size" && i + 1 < argc) {
-      config.message_size = std::stoul(argv[++i]);
+      if (!ParseSweepArg(arg, argv[++i], &message_sizes)) return 1;
+    } else if (arg == "--payload" && i + 1 < argc) {
+      payload_spec = argv[++i];
+    } else if (arg == "--payload-seed" && i + 1 < argc) {
+      payload_seed = std::stoull(argv[++i]);
+    } else if (arg == "--threads" && i + 1 < argc) {
+      config.num_threads_per_client = std::stoi(argv[++i]);
+    } else if (arg == "--pipeline-depth" && i + 1 < argc) {
+      config.pipeline_depth = std::stoi(argv[++i]);
+    } else if (arg == "--slo-latency-us" && i + 1 < argc) {
+      config.slo_latency_us = std::stoll(argv[++i]);
+    } else if (arg == "--slo-percentile" && i + 1 < argc) {
+      config.slo_percentile = std::stod(argv[++i]) / 100.0;
+    } else if (arg == "--slo-start-rps" && i + 1 < argc) {
+      config.slo_start_rps = std::stod(argv[++i]);
+    } else if (arg == "--slo-max-rps" && i + 1 < argc) {
+      config.slo_max_rps = std::stod(argv[++i]);
+    } else if (arg == "--mix" && i + 1 < argc) {
+      config.workload_mix = argv[++i];
+    } else if (arg == "--size-dist" && i + 1 < argc) {
+      config.size_distribution = argv[++i];
+    } else if (arg == "--fanout" && i + 1 < argc) {
+      config.fanout_counts = argv[++i];
+    } else if (arg == "--fanout-k" && i + 1 < argc) {
+      config.fanout_k = std::stoi(argv[++i]);
+    } else if (arg == "--fanout-quorum" && i + 1 < argc) {
+      config.fanout_quorum = std::stoi(argv[++i]);
+    } else if (arg == "--large-sizes" && i + 1 < argc) {
+      config.large_sizes = argv[++i];
+    } else if (arg == "--large-chunk-size" && i + 1 < argc) {
+      std::vector<long> chunk;
+      if (!ParseSweepArg(arg, argv[++i], &chunk) || chunk.size() != 1) return 1;
+      config.large_chunk_size = static_cast<size_t>(chunk[0]);
+    } else if (arg == "--large-repeats" && i + 1 < argc) {
+      config.large_repeats = std::stoi(argv[++i]);
+    } else if (arg == "--chain-lengths" && i + 1 < argc) {
+      config.chain_lengths = argv[++i];
+    } else if (arg == "--shapes" && i + 1 < argc) {
+      config.message_shapes = argv[++i];
+    } else if (arg == "--shape-sizes" && i + 1 < argc) {
+      config.shape_sizes = argv[++i];
+    } else if (arg == "--record-trace" && i + 1 < argc) {
+      record_trace_file = argv[++i];
+    } else if (arg == "--trace" && i + 1 < argc) {
+      config.trace_file = argv[++i];
+    } else if (arg == "--trace-speed" && i + 1 < argc) {
+      config.trace_speed = std::stod(argv[++i]);
+    } else if (arg == "--sweep") {
+      sweep = true;
+    } else if (arg == "--sweep-sizes" && i + 1 < argc) {
+      if (!ParseSweepArg(arg, argv[++i], &sweep_spec.message_sizes)) return 1;
+    } else if (arg == "--sweep-clients" && i + 1 < argc) {
+      if (!ParseSweepArg(arg, argv[++i], &sweep_spec.client_counts)) return 1;
+    } else if (arg == "--sweep-threads" && i + 1 < argc) {
+      if (!ParseSweepArg(arg, argv[++i], &sweep_spec.thread_counts)) return 1;
+    } else if (arg == "--sweep-depths" && i + 1 < argc) {
+      if (!ParseSweepArg(arg, argv[++i], &sweep_spec.pipeline_depths)) return 1;
+    } else if (arg == "--sweep-samples" && i + 1 < argc) {
+      sweep_spec.lhs_samples = std::stoi(argv[++i]);
+    } else if (arg == "--seed" && i + 1 < argc) {
+      sweep_spec.seed = static_cast<uint32_t>(std::stoul(argv[++i]));
+    } else if (arg == "--csv" && i + 1 < argc) {
+      csv_file = argv[++i];
     } else if (arg == "--address" && i + 1 < argc) {
       config.server_address = argv[++i];
+    } else if (arg == "--external-server" || arg == "--client-mode") {
+      external_server = true;
+    } else if (arg == "--server-mode") {
+      server_mode = true;
+    } else if (arg == "--fork-server") {
+      fork_server = true;
+    } else if (arg == "--server-cpus" && i + 1 < argc) {
+      if (!ParseCpuArg(arg, argv[++i], &server_cpus)) return 1;
+    } else if (arg == "--client-cpus" && i + 1 < argc) {
+      if (!ParseCpuArg(arg, argv[++i], &client_cpus)) return 1;
+    } else if (arg == "--fd-threshold" && i + 1 < argc) {
+      std::vector<long> threshold;
+      if (!ParseSweepArg(arg, argv[++i], &threshold) || threshold.size() != 1) return 1;
+      fd_threshold = static_cast<size_t>(threshold[0]);
+    } else if (arg == "--grpc-channels" && i + 1 < argc) {
+      std::vector<long> channels;
+      if (!ParseSweepArg(arg, argv[++i], &channels) || channels.size() != 1) return 1;
+      grpc_channels = channels[0];
+    } else if (arg == "--trpc-threads" && i + 1 < argc) {
+      std::vector<long> threads;
+      if (!ParseSweepArg(arg, argv[++i], &threads) || threads.size() != 1) return 1;
+      trpc_threads = threads[0];
+    } else if (arg == "--wait-strategy" && i + 1 < argc) {
+      if (!ParseWaitStrategies(argv[++i], &wait_strategies)) return 1;
+    } else if (arg == "--handler-pool") {
+      handler_pool = true;
+    } else if (arg == "--compression" && i + 1 < argc) {
+      compression = argv[++i];
+    } else if (arg == "--compress-threshold" && i + 1 < argc) {
+      if (!benchmark::common::compression::ParseThresholds(argv[++i], &compress_thresholds)) {
+        std::cerr << "Invalid value for --compress-threshold: " << argv[i] << std::endl;
+        return 1;
+      }
+    } else if (arg == "--link-gbps" && i + 1 < argc) {
+      if (!ParseLinkRates(argv[++i], &link_gbps)) return 1;
     } else if (arg == "--output" && i + 1 < argc) {
       config.output_file = argv[++i];
     } else if (arg == "--verbose") {
@@ -94,6 +616,19 @@ int main(int argc, char* argv[]) {
     }
   }
 
+  // Payload content is set process-wide before any server starts, so a
+  // forked server inherits it
+  if (!payload_spec.empty()) {
+    std::string error;
+    auto generator = benchmark::common::payload::ParsePayloadSpec(payload_spec, payload_seed,
+                                                                  &error);
+    if (!generator) {
+      std::cerr << "Invalid --payload: " << error << std::endl;
+      return 1;
+    }
+    benchmark::common::payload::PayloadGenerator::SetShared(std::move(generator));
+  }
+
   // Create benchmark scenarios
   std::vector<std::unique_ptr<benchmark::scenarios::BenchmarkScenario>> scenarios_list;
 
@@ -106,6 +641,30 @@ int main(int argc, char* argv[]) {
   if (scenario == "reliability" || scenario == "all") {
     scenarios_list.push_back(benchmark::scenarios::CreateReliabilityBenchmark());
   }
+  if (scenario == "slo" || scenario == "all") {
+    scenarios_list.push_back(benchmark::scenarios::CreateSloThroughputBenchmark());
+  }
+  if (scenario == "mixed" || scenario == "all") {
+    scenarios_list.push_back(benchmark::scenarios::CreateMixedWorkloadBenchmark());
+  }
+  if (scenario == "churn" || scenario == "all") {
+    scenarios_list.push_back(benchmark::scenarios::CreateConnectionChurnBenchmark());
+  }
+  if (scenario == "fanout" || scenario == "all") {
+    scenarios_list.push_back(benchmark::scenarios::CreateFanOutBenchmark());
+  }
+  if (scenario == "large" || scenario == "all") {
+    scenarios_list.push_back(benchmark::scenarios::CreateLargeMessageBenchmark());
+  }
+  if (scenario == "chain" || scenario == "all") {
+    scenarios_list.push_back(benchmark::scenarios::CreateEchoChainBenchmark());
+  }
+  if (scenario == "shapes" || scenario == "all") {
+    scenarios_list.push_back(benchmark::scenarios::CreateShapeEchoBenchmark());
+  }
+  if (scenario == "replay" || (scenario == "all" && !config.trace_file.empty())) {
+    scenarios_list.push_back(benchmark::scenarios::CreateTraceReplayBenchmark());
+  }
 
   if (scenarios_list.empty()) {
     std::cerr << "Error: No valid scenarios specified" << std::endl;
@@ -116,69 +675,341 @@ int main(int argc, char* argv[]) {
   std::vector<std::unique_ptr<benchmark::common::IFrameworkFactory>> factories;
 
   // Always include in-process reference implementation
-  if (framework == "inprocess" || framework == "reference" || framework == "all") {
+  if (Selected(framework, "inprocess") || Selected(framework, "reference")) {
     factories.push_back(benchmark::inprocess::CreateInProcessFactory());
   }
+  // Frameworks with idle threads run once per requested wait strategy
+  auto strategies_or = [&](benchmark::common::WaitStrategy fallback) {
+    return wait_strategies.empty() ? std::vector<benchmark::common::WaitStrategy>{fallback}
+                                   : wait_strategies;
+  };
+  const std::pair<const char*, benchmark::inprocess::HandoffQueueKind> threaded[] = {
+      {"inprocess-mutex", benchmark::inprocess::HandoffQueueKind::kMutex},
+      {"inprocess-mpmc", benchmark::inprocess::HandoffQueueKind::kMpmc},
+      {"inprocess-spsc", benchmark::inprocess::HandoffQueueKind::kSpsc},
+  };
+  for (const auto& entry : threaded) {
+    if (!Selected(framework, entry.first)) continue;
+    for (auto wait : strategies_or(benchmark::common::WaitStrategy::kSpinFutex)) {
+      factories.push_back(benchmark::inprocess::CreateThreadedFactory(entry.second, wait));
+    }
+  }
+  if (Selected(framework, "inprocess-steal")) {
+    // The pool's workers wait on their own; callers use the default
+    factories.push_back(benchmark::inprocess::CreateThreadedFactory(
+        benchmark::inprocess::HandoffQueueKind::kSteal,
+        benchmark::common::WaitStrategy::kSpinFutex));
+  }
+
+#ifdef HAS_RAWTCP
+  if (Selected(framework, "rawtcp")) {
+    factories.push_back(benchmark::rawtcp::CreateRawTcpFactory(handler_pool));
+  }
+  if (Selected(framework, "uds")) {
+    factories.push_back(benchmark::rawtcp::CreateUdsFactory(fd_threshold, handler_pool));
+  }
+  if (Selected(framework, "uds-inline")) {
+    factories.push_back(benchmark::rawtcp::CreateUdsFactory(0, handler_pool));
+  }
+  if (Selected(framework, "rawtcp-uring")) {
+    factories.push_back(benchmark::rawtcp::CreateRawTcpUringFactory(handler_pool));
+  }
+  if (Selected(framework, "uds-uring")) {
+    factories.push_back(benchmark::rawtcp::CreateUdsUringFactory(handler_pool));
+  }
+#endif
 
-  // TODO: Register RPC framework factories when implementations are complete
-  // #ifdef HAS_GRPC
-  //   if (framework == "grpc" || framework == "all") {
-  //     factories.push_back(CreateGrpcFactory());
-  //   }
-  // #endif
-  // #ifdef HAS_CAPNPROTO
-  //   if (framework == "capnproto" || framework == "all") {
-  //     factories.push_back(CreateCapnProtoFactory());
-  //   }
-  // #endif
-  // #ifdef HAS_TRPC
-  //   if (framework == "trpc" || framework == "all") {
-  //     factories.push_back(CreateTrpcFactory());
-  //   }
-  // #endif
+#ifdef HAS_SHM
+  if (Selected(framework, "shm")) {
+    for (auto wait : strategies_or(benchmark::common::WaitStrategy::kBlock)) {
+      factories.push_back(benchmark::shm::CreateShmFactory(wait, handler_pool));
+    }
+  }
+  if (Selected(framework, "shm-poll")) {
+    factories.push_back(benchmark::shm::CreateShmPollFactory(handler_pool));
+  }
+#endif
+
+#ifdef HAS_GRPC
+  int channels = static_cast<int>(grpc_channels);
+  if (Selected(framework, "grpc")) {
+    factories.push_back(benchmark::grpc_impl::CreateGrpcFactory(channels));
+  }
+  if (Selected(framework, "grpc-sync")) {
+    factories.push_back(benchmark::grpc_impl::CreateGrpcSyncFactory(channels));
+  }
+  if (Selected(framework, "grpc-callback")) {
+    factories.push_back(benchmark::grpc_impl::CreateGrpcCallbackFactory(channels));
+  }
+  if (Selected(framework, "grpc-arena")) {
+    factories.push_back(benchmark::grpc_impl::CreateGrpcArenaFactory(channels));
+  }
+  if (Selected(framework, "grpc-raw")) {
+    factories.push_back(benchmark::grpc_impl::CreateGrpcRawFactory(channels));
+  }
+#endif
+
+#ifdef HAS_CAPNPROTO
+  if (Selected(framework, "capnproto")) {
+    factories.push_back(benchmark::capnp_impl::CreateCapnProtoFactory());
+  }
+#endif
+
+#ifdef HAS_TRPC
+  // One tRPC runtime runs per process, so the models take turns: each
+  // framework's clients and server release it before the next one starts
+  int runtime_threads = static_cast<int>(trpc_threads);
+  if (Selected(framework, "trpc")) {
+    factories.push_back(benchmark::trpc_impl::CreateTrpcFactory(runtime_threads));
+  }
+  if (Selected(framework, "trpc-merge")) {
+    factories.push_back(benchmark::trpc_impl::CreateTrpcMergeFactory(runtime_threads));
+  }
+  if (Selected(framework, "trpc-separate")) {
+    factories.push_back(benchmark::trpc_impl::CreateTrpcSeparateFactory(runtime_threads));
+  }
+#endif
 
   if (factories.empty()) {
     std::cerr << "Error: No frameworks selected. Use --framework inprocess to run baseline tests." << std::endl;
     return 1;
   }
 
+  // Compress payloads at both ends of every call; the servers started for
+  // the run are wrapped too, so both ends agree
+  std::shared_ptr<benchmark::common::compression::Stats> compression_stats;
+  if (!compression.empty()) {
+    std::shared_ptr<const benchmark::common::compression::ICompressor> compressor =
+        benchmark::common::compression::CreateCompressor(compression);
+    if (!compressor) {
+      std::cerr << "Error: Unknown compressor " << compression << "; this build has:";
+      for (const auto& name : benchmark::common::compression::CompressorNames()) {
+        std::cerr << " " << name;
+      }
+      std::cerr << std::endl;
+      return 1;
+    }
+    compression_stats = std::make_shared<benchmark::common::compression::Stats>();
+    for (auto& factory : factories) {
+      factory = std::make_unique<benchmark::common::compression::CompressingFactory>(
+          std::move(factory), compressor, compress_thresholds, compression_stats);
+    }
+  }
+
+  if (server_mode) {
+    if (factories.size() != 1) {
+      std::cerr << "Error: --server-mode serves exactly one framework; pick it with --framework"
+                << std::endl;
+      return 1;
+    }
+    if (factories.front()->IsInProcess()) {
+      std::cerr << "Error: " << factories.front()->GetName()
+                << " is in-process; other processes cannot reach its server" << std::endl;
+      return 1;
+    }
+    return benchmark::scenarios::ServeUntilSignal(factories.front().get(),
+                                                  config.server_address, server_cpus,
+                                                  handler_pool);
+  }
+
+  // Pin before any client thread exists so they all inherit the set. A
+  // forked server that was given no CPUs of its own keeps the original set.
+  if (fork_server && server_cpus.empty()) {
+    server_cpus = benchmark::common::utils::UsableCpus();
+  }
+  if (!client_cpus.empty() && !benchmark::common::utils::PinToCpus(client_cpus)) {
+    std::cerr << "Warning: could not pin the clients to the requested CPUs" << std::endl;
+  }
+
+  // Capture every call made through the selected frameworks
+  std::shared_ptr<benchmark::common::trace::TraceWriter> trace_writer;
+  if (!record_trace_file.empty()) {
+    trace_writer = std::make_shared<benchmark::common::trace::TraceWriter>();
+    if (!trace_writer->Open(record_trace_file)) {
+      std::cerr << "Error: Cannot create trace " << record_trace_file << std::endl;
+      return 1;
+    }
+    for (auto& factory : factories) {
+      factory = std::make_unique<benchmark::common::trace::RecordingFactory>(
+          std::move(factory), trace_writer);
+    }
+  }
+
+  config.message_size = static_cast<size_t>(message_sizes.front());
+  bool start_failed = false;
+
+  if (sweep) {
+    std::vector<benchmark::scenarios::SweepCell> cells;
+
+    for (auto& factory : factories) {
+      std::cout << "Sweeping framework: " << factory->GetName() << std::endl;
+      benchmark::scenarios::BenchmarkConfig sweep_config = config;
+      std::unique_ptr<benchmark::common::IBenchmarkServer> server;
+      std::unique_ptr<benchmark::scenarios::ServerProcess> server_process;
+      auto placement = PlaceServer(factory.get(), fork_server, external_server);
+      if (placement == ServerPlacement::kForked) {
+        server_process = StartServerProcess(factory.get(), config.server_address, server_cpus,
+                                          handler_pool);
+        if (server_process) AttachServerProcess(server_process.get(), &sweep_config);
+      } else if (placement == ServerPlacement::kLocal) {
+        server = StartLocalServer(factory.get(), config.server_address, handler_pool);
+        if (!server && factory->IsInProcess()) {
+          start_failed = true;
+          continue;
+        }
+      }
+      benchmark::scenarios::ParameterSweep parameter_sweep(sweep_spec, sweep_config);
+      parameter_sweep.Run(factory.get(), &cells);
+      if (server) server->Stop();
+    }
+
+    std::cout << benchmark::scenarios::ParameterSweep::ToCSV(cells) << std::endl;
+
+    if (!config.output_file.empty() &&
+        !WriteTextFile(config.output_file,
+                       benchmark::scenarios::ParameterSweep::ToJSON(cells))) {
+      return 1;
+    }
+    if (!csv_file.empty() &&
+        !WriteTextFile(csv_file, benchmark::scenarios::ParameterSweep::ToCSV(cells))) {
+      return 1;
+    }
+
+    std::cout << "Sweep complete!" << std::endl;
+    return start_failed ? 1 : 0;
+  }
+
   // Run benchmarks
   std::cout << "Configuration:" << std::endl;
   std::cout << "  Frameworks: " << framework << std::endl;
   std::cout << "  Scenarios: " << scenario << std::endl;
   std::cout << "  Duration: " << config.duration_seconds << " seconds" << std::endl;
-  std::cout << "  Message size: " << config.message_size << " bytes" << std::endl;
+  std::cout << "  Message sizes:";
+  for (long size : message_sizes) {
+    std::cout << " " << size;
+  }
+  std::cout << " bytes" << std::endl;
+  std::cout << "  Threads: " << config.num_threads_per_client << std::endl;
+  std::cout << "  Pipeline depth: " << config.pipeline_depth << std::endl;
   std::cout << "  Server address: " << config.server_address << std::endl;
+  if (const auto* generator = benchmark::common::payload::PayloadGenerator::Shared()) {
+    std::ostringstream entropy;
+    entropy << std::fixed << std::setprecision(2) << generator->Entropy();
+    std::cout << "  Payload: " << generator->Describe() << ", " << entropy.str()
+              << " bits/byte" << std::endl;
+  }
+  if (!compression.empty()) {
+    std::cout << "  Compression: " << compression << std::endl;
+  }
+  if (fork_server) {
+    std::cout << "  Server process: forked" << std::endl;
+  }
   std::cout << std::endl;
 
   std::vector<benchmark::scenarios::BenchmarkResults> all_results;
 
   for (auto& factory : factories) {
     std::cout << "Testing framework: " << factory->GetName() << std::endl;
+    std::unique_ptr<benchmark::common::IBenchmarkServer> server;
+    std::unique_ptr<benchmark::scenarios::ServerProcess> server_process;
+    auto placement = PlaceServer(factory.get(), fork_server, external_server);
+    if (placement == ServerPlacement::kForked) {
+      server_process = StartServerProcess(factory.get(), config.server_address, server_cpus,
+                                          handler_pool);
+    } else if (placement == ServerPlacement::kLocal) {
+      server = StartLocalServer(factory.get(), config.server_address, handler_pool);
+      if (!server && factory->IsInProcess()) {
+        start_failed = true;
+        continue;
+      }
+    }
 
     for (auto& bench : scenarios_list) {
-      std::cout << "  Running scenario: " << bench->GetName() << std::endl;
+      for (long size : message_sizes) {
+        std::cout << "  Running scenario: " << bench->GetName()
+                  << " (" << size << " bytes)" << std::endl;
 
-      auto client = factory->CreateClient();
-      if (!client) {
-        std::cerr << "    Failed to create client" << std::endl;
-        continue;
-      }
+        auto client = factory->CreateClient();
+        if (!client) {
+          std::cerr << "    Failed to create client" << std::endl;
+          continue;
+        }
+
+        benchmark::scenarios::BenchmarkConfig run_config = config;
+        run_config.message_size = static_cast<size_t>(size);
+
+        // Server usage over the whole run, for scenarios that do not
+        // sample their own measured window
+        benchmark::scenarios::ServerUsage server_before;
+        auto run_start = std::chrono::steady_clock::now();
+        if (server_process) {
+          AttachServerProcess(server_process.get(), &run_config);
+          server_process->ResetPeak();
+          server_process->Sample(&server_before);
+        }
+
+        // The shared pool only serves this run when the server is local
+        benchmark::common::WorkStealingExecutor* pool =
+            server_process ? nullptr : benchmark::common::WorkStealingExecutor::SharedIfStarted();
+        if (pool) pool->ResetStats();
+        if (compression_stats) compression_stats->Reset();
+
+        bench->SetFactory(factory.get());
+        auto results = bench->Run(client.get(), run_config);
+        if (pool) AddExecutorMetrics(pool->Stats(), &results);
+        if (compression_stats) AddCompressionMetrics(*compression_stats, link_gbps, &results);
+#ifdef HAS_GRPC
+        double codec_ns = benchmark::grpc_impl::EchoCodecNanos(factory.get(), run_config.message_size);
+        if (codec_ns >= 0) AddCodecMetrics(codec_ns, &results);
+#endif
+
+        benchmark::scenarios::ServerUsage server_after;
+        if (server_process && server_process->Sample(&server_after)) {
+          results.server_peak_memory_bytes = server_after.peak_rss_bytes;
+          int64_t wall_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+              std::chrono::steady_clock::now() - run_start).count();
+          if (results.server_cpu_percent == 0 && server_before.cpu_ns >= 0 &&
+              server_after.cpu_ns >= server_before.cpu_ns && wall_ns > 0) {
+            results.server_cpu_percent =
+                100.0 * static_cast<double>(server_after.cpu_ns - server_before.cpu_ns) / wall_ns;
+          }
+        }
 
-      auto results = bench->Run(client.get(), config);
-      results.framework_name = factory->GetName();
-      results.Print();
+        results.framework_name = factory->GetName();
+        results.message_size = run_config.message_size;
+        results.Print();
 
-      all_results.push_back(results);
+        all_results.push_back(results);
+      }
     }
+
+    // Free the address before the next framework starts its server there
+    if (server) server->Stop();
+  }
+
+  if (all_results.size() > 1) {
+    PrintComparison(all_results);
   }
 
   // Output results to file if requested
   if (!config.output_file.empty()) {
-    // TODO: Write JSON output to file
-    std::cout << "JSON output not yet implemented" << std::endl;
+    std::string json = "[\n";
+    for (size_t i = 0; i < all_results.size(); i++) {
+      json += all_results[i].ToJSON();
+      json += (i + 1 < all_results.size()) ? ",\n" : "\n";
+    }
+    json += "]\n";
+    if (!WriteTextFile(config.output_file, json)) {
+      return 1;
+    }
+  }
+
+  if (trace_writer) {
+    trace_writer->Close();
+    std::cout << "Recorded " << trace_writer->GetRecordCount() << " calls to "
+              << record_trace_file << std::endl;
   }
 
   std::cout << "Benchmark complete!" << std::endl;
-  return 0;
+  return start_failed ? 1 : 0;
 }
@@ -0,0 +1,244 @@
+// benchmark.capnp: messages built with the Cap'n Proto adapter's
+// conversions, flattened into one contiguous buffer and read in place
+
+#include "codec_suite.h"
+#include "capnproto_support.h"
+#include <capnp/serialize.h>
+#include <kj/io.h>
+#include <cstring>
+
+namespace benchmark {
+namespace codec {
+
+namespace {
+
+namespace schema = ::benchmark::capnp_schema;
+using capnp_impl::ToCapnp;
+
+template<typename T> struct SchemaOf;
+template<> struct SchemaOf<common::EchoRequest> { using type = schema::EchoRequest; };
+template<> struct SchemaOf<common::EchoResponse> { using type = schema::EchoResponse; };
+template<> struct SchemaOf<common::StreamRequest> { using type = schema::StreamRequest; };
+template<> struct SchemaOf<common::DataChunk> { using type = schema::DataChunk; };
+template<> struct SchemaOf<common::UploadResponse> { using type = schema::UploadResponse; };
+template<> struct SchemaOf<common::BatchRequest> { using type = schema::BatchRequest; };
+template<> struct SchemaOf<common::BatchResponse> { using type = schema::BatchResponse; };
+template<> struct SchemaOf<common::NestedMessage> { using type = schema::NestedMessage; };
+template<> struct SchemaOf<common::ArrayMessage> { using type = schema::ArrayMessage; };
+template<> struct SchemaOf<common::MapMessage> { using type = schema::MapMessage; };
+template<> struct SchemaOf<common::SparseMessage> { using type = schema::SparseMessage; };
+template<> struct SchemaOf<common::StringMessage> { using type = schema::StringMessage; };
+
+template<typename Blob>
+uint64_t MixBlob(uint64_t hash, Blob value) {
+  return MixBytes(hash, value.begin(), value.size());
+}
+
+// Field walks matching Touch() of the common types. Each getter checks
+// its pointer's bounds here, which is the work a lazy decode deferred.
+uint64_t TouchCapnp(schema::EchoRequest::Reader message) {
+  uint64_t hash = MixBlob(0, message.getMessage());
+  hash = Mix(hash, static_cast<uint64_t>(message.getTimestamp()));
+  return Mix(hash, message.getSequenceNumber());
+}
+
+uint64_t TouchCapnp(schema::EchoResponse::Reader message) {
+  uint64_t hash = MixBlob(0, message.getMessage());
+  hash = Mix(hash, static_cast<uint64_t>(message.getClientTimestamp()));
+  hash = Mix(hash, static_cast<uint64_t>(message.getServerTimestamp()));
+  return Mix(hash, message.getSequenceNumber());
+}
+
+uint64_t TouchCapnp(schema::StreamRequest::Reader message) {
+  uint64_t hash = Mix(0, message.getChunkSize());
+  hash = Mix(hash, message.getChunkCount());
+  return Mix(hash, message.getDelayMs());
+}
+
+uint64_t TouchCapnp(schema::DataChunk::Reader message) {
+  uint64_t hash = Mix(0, message.getSequenceNumber());
+  hash = MixBlob(hash, message.getData());
+  hash = Mix(hash, message.getChecksum());
+  return Mix(hash, static_cast<uint64_t>(message.getTimestamp()));
+}
+
+uint64_t TouchCapnp(schema::UploadResponse::Reader message) {
+  uint64_t hash = Mix(0, message.getTotalBytes());
+  hash = Mix(hash, message.getChunkCount());
+  hash = Mix(hash, static_cast<uint64_t>(message.getDurationNs()));
+  return Mix(hash, message.getChecksumValid() ? 1 : 0);
+}
+
+uint64_t TouchCapnp(schema::BatchRequest::Reader message) {
+  uint64_t hash = 0;
+  auto items = message.getItems();
+  for (auto item : items) {
+    hash = MixBlob(hash, item.getId());
+    hash = MixBlob(hash, item.getOperation());
+    hash = MixBlob(hash, item.getData());
+  }
+  hash = Mix(hash, items.size());
+  return Mix(hash, message.getFailOnError() ? 1 : 0);
+}
+
+uint64_t TouchCapnp(schema::BatchResponse::Reader message) {
+  uint64_t hash = 0;
+  auto results = message.getResults();
+  for (auto result : results) {
+    hash = MixBlob(hash, result.getId());
+    hash = Mix(hash, result.getSuccess() ? 1 : 0);
+    hash = MixBlob(hash, result.getErrorMessage());
+    hash = MixBlob(hash, result.getResultData());
+  }
+  hash = Mix(hash, results.size());
+  hash = Mix(hash, message.getTotalProcessed());
+  return Mix(hash, message.getTotalFailed());
+}
+
+uint64_t TouchTree(schema::TreeNode::Reader node, uint64_t hash) {
+  hash = Mix(hash, static_cast<uint64_t>(node.getId()));
+  hash = MixDouble(hash, node.getWeight());
+  hash = MixBlob(hash, node.getLabel());
+  auto children = node.getChildren();
+  hash = Mix(hash, children.size());
+  for (auto child : children) hash = TouchTree(child, hash);
+  return hash;
+}
+
+uint64_t TouchCapnp(schema::NestedMessage::Reader message) {
+  return TouchTree(message.getRoot(), 0);
+}
+
+uint64_t TouchCapnp(schema::ArrayMessage::Reader message) {
+  uint64_t hash = 0;
+  auto values = message.getValues();
+  auto samples = message.getSamples();
+  auto counts = message.getCounts();
+  for (int64_t value : values) hash = Mix(hash, static_cast<uint64_t>(value));
+  for (double sample : samples) hash = MixDouble(hash, sample);
+  for (uint32_t count : counts) hash = Mix(hash, count);
+  hash = Mix(hash, values.size());
+  hash = Mix(hash, samples.size());
+  return Mix(hash, counts.size());
+}
+
+uint64_t TouchCapnp(schema::MapMessage::Reader message) {
+  auto counters = message.getCounters();
+  uint64_t counter_sum = 0;
+  for (auto entry : counters) {
+    counter_sum = MixEntry(counter_sum, Mix(MixBlob(0, entry.getKey()),
+                                            static_cast<uint64_t>(entry.getValue())));
+  }
+  auto labels = message.getLabels();
+  uint64_t label_sum = 0;
+  for (auto entry : labels) {
+    label_sum = MixEntry(label_sum, MixBlob(Mix(0, entry.getKey()), entry.getValue()));
+  }
+  uint64_t hash = Mix(Mix(0, counter_sum), counters.size());
+  return Mix(Mix(hash, label_sum), labels.size());
+}
+
+uint64_t TouchCapnp(schema::SparseMessage::Reader message) {
+  uint64_t hash = 0;
+  auto records = message.getRecords();
+  for (auto record : records) {
+    capnp_impl::ForEachSetField(
+        record,
+        [&hash](size_t index, int64_t value) {
+          hash = Mix(Mix(hash, index), static_cast<uint64_t>(value));
+        },
+        [&hash](size_t index, double value) {
+          hash = MixDouble(Mix(hash, kDoubleField + index), value);
+        },
+        [&hash](size_t index, capnp::Text::Reader value) {
+          hash = MixBlob(Mix(hash, kTextField + index), value);
+        });
+  }
+  return Mix(hash, records.size());
+}
+
+uint64_t TouchCapnp(schema::StringMessage::Reader message) {
+  uint64_t hash = 0;
+  auto records = message.getRecords();
+  for (auto record : records) {
+    hash = MixBlob(hash, record.getName());
+    hash = MixBlob(hash, record.getEmail());
+    hash = MixBlob(hash, record.getCity());
+    hash = MixBlob(hash, record.getNote());
+    auto tags = record.getTags();
+    for (auto tag : tags) hash = MixBlob(hash, tag);
+    hash = Mix(hash, tags.size());
+  }
+  return Mix(hash, records.size());
+}
+
+// Encoding builds the message into a reused, zeroed first segment that
+// holds all of it, then writes the segment table and segment into one
+// buffer. Decoding opens that buffer in place and reads the root, which
+// is all Cap'n Proto does before fields are accessed.
+template<typename T>
+class CapnProtoCase : public ICodecCase {
+public:
+  explicit CapnProtoCase(const T& sample) : sample_(sample) {
+    capnp::MallocMessageBuilder sizing;
+    ToCapnp(sample_, sizing.initRoot<Schema>());
+    size_t words = capnp::computeSerializedSizeInWords(sizing) + kSlackWords;
+    scratch_ = kj::heapArray<capnp::word>(words);
+    std::memset(scratch_.begin(), 0, scratch_.asBytes().size());
+    buffer_ = kj::heapArray<capnp::word>(words);
+  }
+
+  size_t Encode() override {
+    // The builder zeroes what it used of the segment when it goes away
+    capnp::MallocMessageBuilder builder(scratch_.asPtr());
+    ToCapnp(sample_, builder.initRoot<Schema>());
+    encoded_words_ = capnp::computeSerializedSizeInWords(builder);
+    kj::ArrayOutputStream out(buffer_.asBytes());
+    capnp::writeMessage(out, builder);
+    return encoded_words_ * sizeof(capnp::word);
+  }
+
+  bool Decode() override {
+    capnp::FlatArrayMessageReader reader(buffer_.slice(0, encoded_words_),
+                                         capnp_impl::UnlimitedReaderOptions());
+    reader.getRoot<Schema>();
+    return true;
+  }
+
+  uint64_t DecodeAndTouch() override {
+    capnp::FlatArrayMessageReader reader(buffer_.slice(0, encoded_words_),
+                                         capnp_impl::UnlimitedReaderOptions());
+    return TouchCapnp(reader.getRoot<Schema>());
+  }
+
+private:
+  using Schema = typename SchemaOf<T>::type;
+
+  // Room for the segment table on top of the message
+  static constexpr size_t kSlackWords = 8;
+
+  const T& sample_;
+  kj::Array<capnp::word> scratch_;
+  kj::Array<capnp::word> buffer_;
+  size_t encoded_words_ = 0;
+};
+
+class CapnProtoCodec : public ICodec {
+public:
+  std::string GetName() const override { return "capnproto"; }
+  std::string GetSchema() const override { return "benchmark.capnp"; }
+
+  std::unique_ptr<ICodecCase> CreateCase(MessageKind kind,
+                                         const MessageSet& messages) override {
+    return MakeCase<CapnProtoCase>(kind, messages);
+  }
+};
+
+} // namespace
+
+std::unique_ptr<ICodec> CreateCapnProtoCodec() {
+  return std::make_unique<CapnProtoCodec>();
+}
+
+} // namespace codec
+} // namespace benchmark
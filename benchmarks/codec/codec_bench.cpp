@@ -0,0 +1,293 @@
+// codec_bench: encode and decode cost of every schema's codec, per message
+// type and payload size, with no transport in the way
+
+#include "codec_suite.h"
+#include "parameter_sweep.h"
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+
+using benchmark::codec::ICodec;
+using benchmark::codec::ICodecCase;
+using benchmark::codec::MessageKind;
+
+// Keeps every measured result live
+volatile uint64_t g_sink = 0;
+
+struct Row {
+  std::string codec;
+  std::string schema;
+  MessageKind kind = MessageKind::kEchoRequest;
+  size_t payload_size = 0;
+  size_t encoded_size = 0;
+  double encode_ns = 0.0;
+  double decode_ns = 0.0;
+  double touch_ns = 0.0;
+};
+
+void PrintUsage(const char* program_name) {
+  std::cout << "Usage: " << program_name << " [options]\n"
+            << "\nOptions:\n"
+            << "  --codec <names>        Comma-separated codecs to measure\n"
+            << "                         Options: native|flat|protobuf|capnproto|all\n"
+            << "                         (default: all built)\n"
+            << "  --message-size <list>  Payload sizes in bytes, e.g. 64,1K or 16:1M:x16\n"
+            << "                         (default: 16,256,4K,64K,1M)\n"
+            << "  --min-time <ms>        Measure each operation for at least this long\n"
+            << "                         per repetition (default: 100)\n"
+            << "  --repetitions <n>      Repetitions per operation; the median is\n"
+            << "                         reported (default: 5)\n"
+            << "  --payload <spec>       Payload content: random | entropy:<bits> | text |\n"
+            << "                         json | records (default: random letters for\n"
+            << "                         text fields, random bytes for byte fields)\n"
+            << "  --seed <n>             Seed of the payload content (default: 1)\n"
+            << "  --csv <file>           Also write the results as CSV\n"
+            << "  --help                 Show this help message\n"
+            << "\nEach row times three operations on one sample message:\n"
+            << "  encode        common types to bytes\n"
+            << "  decode        bytes to the codec's readable form (lazy formats only\n"
+            << "                open the buffer)\n"
+            << "  decode+touch  decode, then read every field and payload byte\n"
+            << "StreamRequest and UploadResponse carry no payload and run once. The\n"
+            << "message-zoo shapes (NestedMessage to StringMessage) hold the given\n"
+            << "bytes of field data and keep their own content.\n"
+            << std::endl;
+}
+
+bool Selected(const std::string& list, const std::string& name) {
+  std::stringstream items(list);
+  std::string item;
+  while (std::getline(items, item, ',')) {
+    if (item == name || item == "all") return true;
+  }
+  return false;
+}
+
+// Mean nanoseconds per call of `op`, run in batches until `min_time` has
+// passed; the median of `repetitions` such runs
+template<typename Op>
+double MeasureNanos(Op op, std::chrono::milliseconds min_time, int repetitions) {
+  constexpr int kBatch = 16;
+
+  uint64_t sink = 0;
+  for (int i = 0; i < kBatch; i++) sink += op();
+
+  std::vector<double> runs;
+  for (int r = 0; r < repetitions; r++) {
+    auto start = std::chrono::steady_clock::now();
+    auto elapsed = std::chrono::steady_clock::duration::zero();
+    long calls = 0;
+    while (elapsed < min_time) {
+      for (int i = 0; i < kBatch; i++) sink += op();
+      calls += kBatch;
+      elapsed = std::chrono::steady_clock::now() - start;
+    }
+    runs.push_back(static_cast<double>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count()) /
+        static_cast<double>(calls));
+  }
+  g_sink = g_sink + sink;
+
+  std::nth_element(runs.begin(), runs.begin() + runs.size() / 2, runs.end());
+  return runs[runs.size() / 2];
+}
+
+// Checks the round trip, then times the case. False if the codec does not
+// reproduce the sample.
+bool MeasureCase(ICodecCase* codec_case, uint64_t expected_checksum,
+                 std::chrono::milliseconds min_time, int repetitions, Row* row) {
+  row->encoded_size = codec_case->Encode();
+  if (!codec_case->Decode() || codec_case->DecodeAndTouch() != expected_checksum) {
+    return false;
+  }
+  row->encode_ns = MeasureNanos([&] { return codec_case->Encode(); }, min_time, repetitions);
+  row->decode_ns = MeasureNanos([&] { return codec_case->Decode() ? 1 : 0; },
+                                min_time, repetitions);
+  row->touch_ns = MeasureNanos([&] { return codec_case->DecodeAndTouch(); },
+                               min_time, repetitions);
+  return true;
+}
+
+void PrintRow(const Row& row) {
+  std::cout << std::left << std::setw(11) << row.codec
+            << std::setw(16) << benchmark::codec::MessageKindName(row.kind)
+            << std::right << std::setw(9) << row.payload_size
+            << std::setw(10) << row.encoded_size
+            << std::fixed << std::setprecision(1)
+            << std::setw(13) << row.encode_ns
+            << std::setw(13) << row.decode_ns
+            << std::setw(13) << row.touch_ns << std::endl;
+}
+
+std::string ToCSV(const std::vector<Row>& rows) {
+  std::ostringstream csv;
+  csv << std::fixed << std::setprecision(1);
+  csv << "codec,schema,message,payload_bytes,encoded_bytes,encode_ns,decode_ns,"
+      << "decode_touch_ns\n";
+  for (const auto& row : rows) {
+    csv << row.codec << ","
+        << row.schema << ","
+        << benchmark::codec::MessageKindName(row.kind) << ","
+        << row.payload_size << ","
+        << row.encoded_size << ","
+        << row.encode_ns << ","
+        << row.decode_ns << ","
+        << row.touch_ns << "\n";
+  }
+  return csv.str();
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+  std::string codec_names = "all";
+  std::vector<long> sizes = {16, 256, 4 << 10, 64 << 10, 1 << 20};
+  long min_time_ms = 100;
+  long repetitions = 5;
+  std::string csv_file;
+  std::string payload_spec;
+  uint64_t seed = 1;
+
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    std::vector<long> values;
+    if (arg == "--help" || arg == "-h") {
+      PrintUsage(argv[0]);
+      return 0;
+    } else if (arg == "--codec" && i + 1 < argc) {
+      codec_names = argv[++i];
+    } else if (arg == "--message-size" && i + 1 < argc) {
+      if (!benchmark::scenarios::ParseSweepList(argv[++i], &sizes)) {
+        std::cerr << "Invalid list for --message-size: " << argv[i] << std::endl;
+        return 1;
+      }
+    } else if ((arg == "--min-time" || arg == "--repetitions") && i + 1 < argc) {
+      if (!benchmark::scenarios::ParseSweepList(argv[++i], &values) || values.size() != 1) {
+        std::cerr << "Invalid value for " << arg << ": " << argv[i] << std::endl;
+        return 1;
+      }
+      (arg == "--min-time" ? min_time_ms : repetitions) = values[0];
+    } else if (arg == "--payload" && i + 1 < argc) {
+      payload_spec = argv[++i];
+    } else if (arg == "--seed" && i + 1 < argc) {
+      seed = std::stoull(argv[++i]);
+    } else if (arg == "--csv" && i + 1 < argc) {
+      csv_file = argv[++i];
+    } else {
+      std::cerr << "Unknown option: " << arg << std::endl;
+      PrintUsage(argv[0]);
+      return 1;
+    }
+  }
+
+  std::unique_ptr<benchmark::common::payload::PayloadGenerator> payload;
+  if (!payload_spec.empty()) {
+    std::string error;
+    payload = benchmark::common::payload::ParsePayloadSpec(payload_spec, seed, &error);
+    if (!payload) {
+      std::cerr << "Invalid --payload: " << error << std::endl;
+      return 1;
+    }
+  }
+
+  std::vector<std::unique_ptr<ICodec>> codecs;
+  if (Selected(codec_names, "native")) {
+    codecs.push_back(benchmark::codec::CreateNativeCodec());
+  }
+  if (Selected(codec_names, "flat")) {
+    codecs.push_back(benchmark::codec::CreateFlatCodec());
+  }
+#ifdef HAS_PROTOBUF
+  if (Selected(codec_names, "protobuf")) {
+    codecs.push_back(benchmark::codec::CreateProtobufCodec());
+  }
+#endif
+#ifdef HAS_CAPNPROTO
+  if (Selected(codec_names, "capnproto")) {
+    codecs.push_back(benchmark::codec::CreateCapnProtoCodec());
+  }
+#endif
+  if (codecs.empty()) {
+    std::cerr << "Error: No codecs selected; this build has: native, flat"
+#ifdef HAS_PROTOBUF
+              << ", protobuf"
+#endif
+#ifdef HAS_CAPNPROTO
+              << ", capnproto"
+#endif
+              << std::endl;
+    return 1;
+  }
+
+  std::cout << "codec_bench: encode/decode cost per message (ns/op, median of "
+            << repetitions << " x " << min_time_ms << " ms)" << std::endl;
+  if (payload) {
+    std::cout << "payload: " << payload->Describe() << ", " << std::fixed
+              << std::setprecision(2) << payload->Entropy() << " bits/byte" << std::endl;
+  }
+  std::cout << std::endl;
+  for (const auto& codec : codecs) {
+    std::cout << "  " << std::left << std::setw(11) << codec->GetName()
+              << codec->GetSchema() << std::endl;
+  }
+  std::cout << "\n" << std::left << std::setw(11) << "codec"
+            << std::setw(16) << "message"
+            << std::right << std::setw(9) << "payload"
+            << std::setw(10) << "bytes"
+            << std::setw(13) << "encode_ns"
+            << std::setw(13) << "decode_ns"
+            << std::setw(13) << "touch_ns" << std::endl;
+
+  std::vector<benchmark::codec::MessageSet> message_sets;
+  message_sets.reserve(sizes.size());
+  for (long size : sizes) {
+    message_sets.push_back(
+        benchmark::codec::MakeMessages(static_cast<size_t>(size), payload.get()));
+  }
+
+  auto min_time = std::chrono::milliseconds(min_time_ms);
+  std::vector<Row> rows;
+  bool all_ok = true;
+  for (MessageKind kind : benchmark::codec::kAllMessageKinds) {
+    size_t size_count = benchmark::codec::HasPayload(kind) ? sizes.size() : 1;
+    for (size_t s = 0; s < size_count; s++) {
+      const auto& messages = message_sets[s];
+      uint64_t expected = benchmark::codec::TouchSample(kind, messages);
+      for (const auto& codec : codecs) {
+        Row row;
+        row.codec = codec->GetName();
+        row.schema = codec->GetSchema();
+        row.kind = kind;
+        row.payload_size = benchmark::codec::HasPayload(kind) ? static_cast<size_t>(sizes[s]) : 0;
+        auto codec_case = codec->CreateCase(kind, messages);
+        if (!MeasureCase(codec_case.get(), expected, min_time, static_cast<int>(repetitions),
+                         &row)) {
+          std::cerr << "Error: " << row.codec << " does not round-trip "
+                    << benchmark::codec::MessageKindName(kind) << " of "
+                    << row.payload_size << " bytes" << std::endl;
+          all_ok = false;
+          continue;
+        }
+        PrintRow(row);
+        rows.push_back(row);
+      }
+    }
+  }
+
+  if (!csv_file.empty()) {
+    std::ofstream out(csv_file);
+    out << ToCSV(rows);
+    if (!out) {
+      std::cerr << "Error: Cannot write " << csv_file << std::endl;
+      return 1;
+    }
+  }
+  return all_ok ? 0 : 1;
+}
@@ -0,0 +1,262 @@
+#include "codec_suite.h"
+#include "benchmark_utils.h"
+#include "message_shapes.h"
+
+namespace benchmark {
+namespace codec {
+
+namespace {
+
+constexpr int64_t kTimestamp = 1700000000000000000;
+
+// Printable text, so string fields stay valid UTF-8
+std::string MakeText(size_t size, uint32_t seed) {
+  std::vector<uint8_t> random = common::utils::GenerateRandomData(size, seed);
+  std::string text(size, ' ');
+  for (size_t i = 0; i < size; i++) {
+    text[i] = static_cast<char>('a' + random[i] % 26);
+  }
+  return text;
+}
+
+// Size of item `index` when `total` bytes are split over kBatchItems
+size_t ItemSize(size_t total, size_t index) {
+  return total / kBatchItems + (index < total % kBatchItems ? 1 : 0);
+}
+
+// Trees are walked depth first, each node before its children
+uint64_t TouchTree(const common::TreeNode& node, uint64_t hash) {
+  hash = Mix(hash, static_cast<uint64_t>(node.id));
+  hash = MixDouble(hash, node.weight);
+  hash = MixBytes(hash, node.label.data(), node.label.size());
+  hash = Mix(hash, node.children.size());
+  for (const auto& child : node.children) hash = TouchTree(child, hash);
+  return hash;
+}
+
+} // namespace
+
+const char* MessageKindName(MessageKind kind) {
+  switch (kind) {
+    case MessageKind::kEchoRequest: return "EchoRequest";
+    case MessageKind::kEchoResponse: return "EchoResponse";
+    case MessageKind::kStreamRequest: return "StreamRequest";
+    case MessageKind::kDataChunk: return "DataChunk";
+    case MessageKind::kUploadResponse: return "UploadResponse";
+    case MessageKind::kBatchRequest: return "BatchRequest";
+    case MessageKind::kBatchResponse: return "BatchResponse";
+    case MessageKind::kNestedMessage: return "NestedMessage";
+    case MessageKind::kArrayMessage: return "ArrayMessage";
+    case MessageKind::kMapMessage: return "MapMessage";
+    case MessageKind::kSparseMessage: return "SparseMessage";
+    case MessageKind::kStringMessage: return "StringMessage";
+  }
+  return "unknown";
+}
+
+bool HasPayload(MessageKind kind) {
+  return kind != MessageKind::kStreamRequest && kind != MessageKind::kUploadResponse;
+}
+
+MessageSet MakeMessages(size_t payload_size,
+                        const common::payload::PayloadGenerator* payload) {
+  MessageSet set;
+  auto bytes = [&](size_t size, uint32_t seed) {
+    return payload ? payload->MakeBytes(size, seed)
+                   : common::utils::GenerateRandomData(size, seed);
+  };
+
+  set.echo_request.message = payload ? payload->MakeText(payload_size, 1)
+                                     : MakeText(payload_size, 1);
+  set.echo_request.timestamp = kTimestamp;
+  set.echo_request.sequence_number = 42;
+
+  set.echo_response.message = set.echo_request.message;
+  set.echo_response.client_timestamp = kTimestamp;
+  set.echo_response.server_timestamp = kTimestamp + 1000;
+  set.echo_response.sequence_number = 42;
+
+  set.stream_request.chunk_size = 65536;
+  set.stream_request.chunk_count = 1000;
+  set.stream_request.delay_ms = 0;
+
+  set.data_chunk.sequence_number = 7;
+  set.data_chunk.data = bytes(payload_size, 2);
+  set.data_chunk.checksum = common::utils::CRC32().Calculate(set.data_chunk.data);
+  set.data_chunk.timestamp = kTimestamp;
+
+  set.upload_response.total_bytes = 65536000;
+  set.upload_response.chunk_count = 1000;
+  set.upload_response.duration_ns = 12345678;
+  set.upload_response.checksum_valid = true;
+
+  // Every fourth item fails, so results carry both outcomes
+  for (size_t i = 0; i < kBatchItems; i++) {
+    common::BatchItem item;
+    item.id = "item-" + std::to_string(i);
+    item.operation = i % 4 == 3 ? "fail" : "echo";
+    item.data = bytes(ItemSize(payload_size, i), static_cast<uint32_t>(100 + i));
+    common::BatchResult result;
+    result.id = item.id;
+    result.success = i % 4 != 3;
+    if (result.success) {
+      result.result_data = item.data;
+    } else {
+      result.error_message = "Operation failed as requested";
+      set.batch_response.total_failed++;
+    }
+    set.batch_request.items.push_back(std::move(item));
+    set.batch_response.results.push_back(std::move(result));
+  }
+  set.batch_request.fail_on_error = false;
+  set.batch_response.total_processed = static_cast<uint32_t>(kBatchItems);
+
+  set.nested = common::shapes::MakeNested(payload_size);
+  set.arrays = common::shapes::MakeArrays(payload_size);
+  set.map = common::shapes::MakeMap(payload_size);
+  set.sparse = common::shapes::MakeSparse(payload_size);
+  set.strings = common::shapes::MakeStrings(payload_size);
+
+  return set;
+}
+
+uint64_t Touch(const common::EchoRequest& message) {
+  uint64_t hash = MixBytes(0, message.message.data(), message.message.size());
+  hash = Mix(hash, static_cast<uint64_t>(message.timestamp));
+  return Mix(hash, message.sequence_number);
+}
+
+uint64_t Touch(const common::EchoResponse& message) {
+  uint64_t hash = MixBytes(0, message.message.data(), message.message.size());
+  hash = Mix(hash, static_cast<uint64_t>(message.client_timestamp));
+  hash = Mix(hash, static_cast<uint64_t>(message.server_timestamp));
+  return Mix(hash, message.sequence_number);
+}
+
+uint64_t Touch(const common::StreamRequest& message) {
+  uint64_t hash = Mix(0, message.chunk_size);
+  hash = Mix(hash, message.chunk_count);
+  return Mix(hash, message.delay_ms);
+}
+
+uint64_t Touch(const common::DataChunk& message) {
+  uint64_t hash = Mix(0, message.sequence_number);
+  hash = MixBytes(hash, message.data.data(), message.data.size());
+  hash = Mix(hash, message.checksum);
+  return Mix(hash, static_cast<uint64_t>(message.timestamp));
+}
+
+uint64_t Touch(const common::UploadResponse& message) {
+  uint64_t hash = Mix(0, message.total_bytes);
+  hash = Mix(hash, message.chunk_count);
+  hash = Mix(hash, static_cast<uint64_t>(message.duration_ns));
+  return Mix(hash, message.checksum_valid ? 1 : 0);
+}
+
+uint64_t Touch(const common::BatchRequest& message) {
+  uint64_t hash = 0;
+  for (const auto& item : message.items) {
+    hash = MixBytes(hash, item.id.data(), item.id.size());
+    hash = MixBytes(hash, item.operation.data(), item.operation.size());
+    hash = MixBytes(hash, item.data.data(), item.data.size());
+  }
+  hash = Mix(hash, message.items.size());
+  return Mix(hash, message.fail_on_error ? 1 : 0);
+}
+
+uint64_t Touch(const common::BatchResponse& message) {
+  uint64_t hash = 0;
+  for (const auto& result : message.results) {
+    hash = MixBytes(hash, result.id.data(), result.id.size());
+    hash = Mix(hash, result.success ? 1 : 0);
+    hash = MixBytes(hash, result.error_message.data(), result.error_message.size());
+    hash = MixBytes(hash, result.result_data.data(), result.result_data.size());
+  }
+  hash = Mix(hash, message.results.size());
+  hash = Mix(hash, message.total_processed);
+  return Mix(hash, message.total_failed);
+}
+
+uint64_t Touch(const common::NestedMessage& message) {
+  return TouchTree(message.root, 0);
+}
+
+uint64_t Touch(const common::ArrayMessage& message) {
+  uint64_t hash = 0;
+  for (int64_t value : message.values) hash = Mix(hash, static_cast<uint64_t>(value));
+  for (double sample : message.samples) hash = MixDouble(hash, sample);
+  for (uint32_t count : message.counts) hash = Mix(hash, count);
+  hash = Mix(hash, message.values.size());
+  hash = Mix(hash, message.samples.size());
+  return Mix(hash, message.counts.size());
+}
+
+uint64_t Touch(const common::MapMessage& message) {
+  uint64_t counters = 0;
+  for (const auto& entry : message.counters) {
+    uint64_t key = MixBytes(0, entry.first.data(), entry.first.size());
+    counters = MixEntry(counters, Mix(key, static_cast<uint64_t>(entry.second)));
+  }
+  uint64_t labels = 0;
+  for (const auto& entry : message.labels) {
+    labels = MixEntry(labels, MixBytes(Mix(0, entry.first), entry.second.data(),
+                                       entry.second.size()));
+  }
+  uint64_t hash = Mix(Mix(0, counters), message.counters.size());
+  return Mix(Mix(hash, labels), message.labels.size());
+}
+
+// Set fields mix their index in as well, so moving a value to another
+// field changes the checksum
+uint64_t Touch(const common::SparseMessage& message) {
+  uint64_t hash = 0;
+  for (const auto& record : message.records) {
+    for (size_t i = 0; i < common::SparseRecord::kIntFields; i++) {
+      if (record.ints[i]) hash = Mix(Mix(hash, i), static_cast<uint64_t>(*record.ints[i]));
+    }
+    for (size_t i = 0; i < common::SparseRecord::kDoubleFields; i++) {
+      if (record.doubles[i]) hash = MixDouble(Mix(hash, kDoubleField + i), *record.doubles[i]);
+    }
+    for (size_t i = 0; i < common::SparseRecord::kTextFields; i++) {
+      if (record.texts[i]) {
+        hash = MixBytes(Mix(hash, kTextField + i), record.texts[i]->data(),
+                        record.texts[i]->size());
+      }
+    }
+  }
+  return Mix(hash, message.records.size());
+}
+
+uint64_t Touch(const common::StringMessage& message) {
+  uint64_t hash = 0;
+  for (const auto& record : message.records) {
+    hash = MixBytes(hash, record.name.data(), record.name.size());
+    hash = MixBytes(hash, record.email.data(), record.email.size());
+    hash = MixBytes(hash, record.city.data(), record.city.size());
+    hash = MixBytes(hash, record.note.data(), record.note.size());
+    for (const auto& tag : record.tags) hash = MixBytes(hash, tag.data(), tag.size());
+    hash = Mix(hash, record.tags.size());
+  }
+  return Mix(hash, message.records.size());
+}
+
+uint64_t TouchSample(MessageKind kind, const MessageSet& messages) {
+  switch (kind) {
+    case MessageKind::kEchoRequest: return Touch(messages.echo_request);
+    case MessageKind::kEchoResponse: return Touch(messages.echo_response);
+    case MessageKind::kStreamRequest: return Touch(messages.stream_request);
+    case MessageKind::kDataChunk: return Touch(messages.data_chunk);
+    case MessageKind::kUploadResponse: return Touch(messages.upload_response);
+    case MessageKind::kBatchRequest: return Touch(messages.batch_request);
+    case MessageKind::kBatchResponse: return Touch(messages.batch_response);
+    case MessageKind::kNestedMessage: return Touch(messages.nested);
+    case MessageKind::kArrayMessage: return Touch(messages.arrays);
+    case MessageKind::kMapMessage: return Touch(messages.map);
+    case MessageKind::kSparseMessage: return Touch(messages.sparse);
+    case MessageKind::kStringMessage: return Touch(messages.strings);
+  }
+  return 0;
+}
+
+} // namespace codec
+} // namespace benchmark
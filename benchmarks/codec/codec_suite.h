@@ -0,0 +1,214 @@
+#pragma once
+
+#include "benchmark_types.h"
+#include "payload_generator.h"
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string>
+
+namespace benchmark {
+namespace codec {
+
+// Codec-only measurements: each schema's encoding of the common messages,
+// timed with no transport, framing or threads involved.
+//
+//   encode        the application's values (the common types) to bytes,
+//                 through whatever the codec builds on the way
+//   decode        bytes to the codec's readable form: parsed messages for
+//                 eager formats, an opened reader for lazy ones
+//   decode+touch  decode, then read every field and every payload byte,
+//                 so a lazy format pays for the access it deferred
+
+enum class MessageKind {
+  kEchoRequest,
+  kEchoResponse,
+  kStreamRequest,
+  kDataChunk,
+  kUploadResponse,
+  kBatchRequest,
+  kBatchResponse,
+  kNestedMessage,
+  kArrayMessage,
+  kMapMessage,
+  kSparseMessage,
+  kStringMessage
+};
+
+constexpr MessageKind kAllMessageKinds[] = {
+  MessageKind::kEchoRequest,   MessageKind::kEchoResponse, MessageKind::kStreamRequest,
+  MessageKind::kDataChunk,     MessageKind::kUploadResponse, MessageKind::kBatchRequest,
+  MessageKind::kBatchResponse, MessageKind::kNestedMessage, MessageKind::kArrayMessage,
+  MessageKind::kMapMessage,    MessageKind::kSparseMessage, MessageKind::kStringMessage
+};
+
+const char* MessageKindName(MessageKind kind);
+
+// False for the fixed-size control messages, which are measured once
+// rather than per payload size
+bool HasPayload(MessageKind kind);
+
+// Batches split their payload over this many items
+constexpr size_t kBatchItems = 16;
+
+// One sample of every message with `payload_size` bytes of payload: text
+// fields get printable characters (protobuf requires UTF-8), byte fields
+// random data; or both come from `payload` when one is given. The
+// message-zoo shapes hold `payload_size` bytes of field data and keep
+// their own content (message_shapes.h) whatever `payload` is.
+struct MessageSet {
+  common::EchoRequest echo_request;
+  common::EchoResponse echo_response;
+  common::StreamRequest stream_request;
+  common::DataChunk data_chunk;
+  common::UploadResponse upload_response;
+  common::BatchRequest batch_request;
+  common::BatchResponse batch_response;
+  common::NestedMessage nested;
+  common::ArrayMessage arrays;
+  common::MapMessage map;
+  common::SparseMessage sparse;
+  common::StringMessage strings;
+};
+
+MessageSet MakeMessages(size_t payload_size,
+                        const common::payload::PayloadGenerator* payload = nullptr);
+
+// Checksum of the values read from a message. Every codec walks its
+// decoded form in the same field order with these, so a round trip must
+// reproduce the checksum of the sample.
+inline uint64_t Mix(uint64_t hash, uint64_t value) {
+  return (hash ^ value) * 0x100000001b3ull;
+}
+
+// Reads every byte once; the plain sum over words keeps the pass near
+// memory speed, so touching costs what reading the payload costs
+inline uint64_t MixBytes(uint64_t hash, const void* data, size_t size) {
+  const auto* bytes = static_cast<const uint8_t*>(data);
+  uint64_t sum = 0;
+  size_t i = 0;
+  for (; i + 8 <= size; i += 8) {
+    uint64_t word;
+    std::memcpy(&word, bytes + i, 8);
+    sum += word;
+  }
+  uint64_t tail = 0;
+  if (i < size) std::memcpy(&tail, bytes + i, size - i);
+  return Mix(Mix(hash, sum + tail), size);
+}
+
+inline uint64_t MixDouble(uint64_t hash, double value) {
+  uint64_t bits;
+  std::memcpy(&bits, &value, sizeof(bits));
+  return Mix(hash, bits);
+}
+
+// Checksum field numbers of a SparseRecord's doubles and texts; ints are
+// numbered from 0
+constexpr size_t kDoubleField = common::SparseRecord::kIntFields;
+constexpr size_t kTextField = kDoubleField + common::SparseRecord::kDoubleFields;
+
+// Map entries are combined by sum, as protobuf iterates maps in no
+// particular order
+inline uint64_t MixEntry(uint64_t sum, uint64_t entry_hash) {
+  return sum + entry_hash;
+}
+
+uint64_t Touch(const common::EchoRequest& message);
+uint64_t Touch(const common::EchoResponse& message);
+uint64_t Touch(const common::StreamRequest& message);
+uint64_t Touch(const common::DataChunk& message);
+uint64_t Touch(const common::UploadResponse& message);
+uint64_t Touch(const common::BatchRequest& message);
+uint64_t Touch(const common::BatchResponse& message);
+uint64_t Touch(const common::NestedMessage& message);
+uint64_t Touch(const common::ArrayMessage& message);
+uint64_t Touch(const common::MapMessage& message);
+uint64_t Touch(const common::SparseMessage& message);
+uint64_t Touch(const common::StringMessage& message);
+
+// Checksum of the sample of `kind` in `messages`
+uint64_t TouchSample(MessageKind kind, const MessageSet& messages);
+
+// One codec bound to one sample message. A case keeps its buffers and
+// decoded objects between calls, as an endpoint reusing them would.
+class ICodecCase {
+public:
+  virtual ~ICodecCase() = default;
+
+  // Encode the sample; returns the encoded size in bytes
+  virtual size_t Encode() = 0;
+
+  // Decode the last encoding; false if it does not parse
+  virtual bool Decode() = 0;
+
+  // Decode the last encoding and return the checksum of all its fields
+  virtual uint64_t DecodeAndTouch() = 0;
+};
+
+class ICodec {
+public:
+  virtual ~ICodec() = default;
+
+  virtual std::string GetName() const = 0;
+
+  // Schema or format the codec implements
+  virtual std::string GetSchema() const = 0;
+
+  // A case for the sample of `kind`; `messages` must outlive it
+  virtual std::unique_ptr<ICodecCase> CreateCase(MessageKind kind,
+                                                 const MessageSet& messages) = 0;
+};
+
+// Dispatches CreateCase() to a case template instantiated per message type
+template<template<typename> class Case>
+std::unique_ptr<ICodecCase> MakeCase(MessageKind kind, const MessageSet& messages) {
+  switch (kind) {
+    case MessageKind::kEchoRequest:
+      return std::make_unique<Case<common::EchoRequest>>(messages.echo_request);
+    case MessageKind::kEchoResponse:
+      return std::make_unique<Case<common::EchoResponse>>(messages.echo_response);
+    case MessageKind::kStreamRequest:
+      return std::make_unique<Case<common::StreamRequest>>(messages.stream_request);
+    case MessageKind::kDataChunk:
+      return std::make_unique<Case<common::DataChunk>>(messages.data_chunk);
+    case MessageKind::kUploadResponse:
+      return std::make_unique<Case<common::UploadResponse>>(messages.upload_response);
+    case MessageKind::kBatchRequest:
+      return std::make_unique<Case<common::BatchRequest>>(messages.batch_request);
+    case MessageKind::kBatchResponse:
+      return std::make_unique<Case<common::BatchResponse>>(messages.batch_response);
+    case MessageKind::kNestedMessage:
+      return std::make_unique<Case<common::NestedMessage>>(messages.nested);
+    case MessageKind::kArrayMessage:
+      return std::make_unique<Case<common::ArrayMessage>>(messages.arrays);
+    case MessageKind::kMapMessage:
+      return std::make_unique<Case<common::MapMessage>>(messages.map);
+    case MessageKind::kSparseMessage:
+      return std::make_unique<Case<common::SparseMessage>>(messages.sparse);
+    case MessageKind::kStringMessage:
+      return std::make_unique<Case<common::StringMessage>>(messages.strings);
+  }
+  return nullptr;
+}
+
+// The common wire format of the native transports (wire_format.h),
+// decoded into the common types as their servers do
+std::unique_ptr<ICodec> CreateNativeCodec();
+
+// The same flat blocks read in place through their views (flat_format.h)
+std::unique_ptr<ICodec> CreateFlatCodec();
+
+#ifdef HAS_PROTOBUF
+// benchmark.proto through the generated protobuf messages
+std::unique_ptr<ICodec> CreateProtobufCodec();
+#endif
+
+#ifdef HAS_CAPNPROTO
+// benchmark.capnp, flattened into one contiguous buffer and read in place
+std::unique_ptr<ICodec> CreateCapnProtoCodec();
+#endif
+
+} // namespace codec
+} // namespace benchmark
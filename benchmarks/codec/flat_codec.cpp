@@ -0,0 +1,236 @@
+// The flat format read in place: the same bytes as the native codec, but
+// decoding only opens the block and fields are read through its view
+
+#include "codec_suite.h"
+#include "flat_format.h"
+
+namespace benchmark {
+namespace codec {
+
+namespace {
+
+namespace flat = common::flat;
+
+template<typename T> struct ViewOf;
+template<> struct ViewOf<common::EchoRequest> { using type = flat::EchoRequestView; };
+template<> struct ViewOf<common::EchoResponse> { using type = flat::EchoResponseView; };
+template<> struct ViewOf<common::StreamRequest> { using type = flat::StreamRequestView; };
+template<> struct ViewOf<common::DataChunk> { using type = flat::DataChunkView; };
+template<> struct ViewOf<common::UploadResponse> { using type = flat::UploadResponseView; };
+template<> struct ViewOf<common::BatchRequest> { using type = flat::BatchRequestView; };
+template<> struct ViewOf<common::BatchResponse> { using type = flat::BatchResponseView; };
+template<> struct ViewOf<common::NestedMessage> { using type = flat::NestedMessageView; };
+template<> struct ViewOf<common::ArrayMessage> { using type = flat::ArrayMessageView; };
+template<> struct ViewOf<common::MapMessage> { using type = flat::MapMessageView; };
+template<> struct ViewOf<common::SparseMessage> { using type = flat::SparseMessageView; };
+template<> struct ViewOf<common::StringMessage> { using type = flat::StringMessageView; };
+
+uint64_t MixView(uint64_t hash, std::string_view value) {
+  return MixBytes(hash, value.data(), value.size());
+}
+
+uint64_t MixView(uint64_t hash, flat::ByteView value) {
+  return MixBytes(hash, value.data, value.size);
+}
+
+// Field walks matching Touch() of the common types
+uint64_t TouchFlat(flat::EchoRequestView message) {
+  uint64_t hash = MixView(0, message.message());
+  hash = Mix(hash, static_cast<uint64_t>(message.timestamp()));
+  return Mix(hash, message.sequence_number());
+}
+
+uint64_t TouchFlat(flat::EchoResponseView message) {
+  uint64_t hash = MixView(0, message.message());
+  hash = Mix(hash, static_cast<uint64_t>(message.client_timestamp()));
+  hash = Mix(hash, static_cast<uint64_t>(message.server_timestamp()));
+  return Mix(hash, message.sequence_number());
+}
+
+uint64_t TouchFlat(flat::StreamRequestView message) {
+  uint64_t hash = Mix(0, message.chunk_size());
+  hash = Mix(hash, message.chunk_count());
+  return Mix(hash, message.delay_ms());
+}
+
+uint64_t TouchFlat(flat::DataChunkView message) {
+  uint64_t hash = Mix(0, message.sequence_number());
+  hash = MixView(hash, message.data());
+  hash = Mix(hash, message.checksum());
+  return Mix(hash, static_cast<uint64_t>(message.timestamp()));
+}
+
+uint64_t TouchFlat(flat::UploadResponseView message) {
+  uint64_t hash = Mix(0, message.total_bytes());
+  hash = Mix(hash, message.chunk_count());
+  hash = Mix(hash, static_cast<uint64_t>(message.duration_ns()));
+  return Mix(hash, message.checksum_valid() ? 1 : 0);
+}
+
+uint64_t TouchFlat(flat::BatchRequestView message) {
+  uint64_t hash = 0;
+  auto items = message.items();
+  for (size_t i = 0; i < items.size(); i++) {
+    auto item = items[i];
+    hash = MixView(hash, item.id());
+    hash = MixView(hash, item.operation());
+    hash = MixView(hash, item.data());
+  }
+  hash = Mix(hash, items.size());
+  return Mix(hash, message.fail_on_error() ? 1 : 0);
+}
+
+uint64_t TouchFlat(flat::BatchResponseView message) {
+  uint64_t hash = 0;
+  auto results = message.results();
+  for (size_t i = 0; i < results.size(); i++) {
+    auto result = results[i];
+    hash = MixView(hash, result.id());
+    hash = Mix(hash, result.success() ? 1 : 0);
+    hash = MixView(hash, result.error_message());
+    hash = MixView(hash, result.result_data());
+  }
+  hash = Mix(hash, results.size());
+  hash = Mix(hash, message.total_processed());
+  return Mix(hash, message.total_failed());
+}
+
+uint64_t TouchTree(flat::TreeNodeView node, uint64_t hash) {
+  hash = Mix(hash, static_cast<uint64_t>(node.id()));
+  hash = MixDouble(hash, node.weight());
+  hash = MixView(hash, node.label());
+  auto children = node.children();
+  hash = Mix(hash, children.size());
+  for (size_t i = 0; i < children.size(); i++) hash = TouchTree(children[i], hash);
+  return hash;
+}
+
+uint64_t TouchFlat(flat::NestedMessageView message) {
+  return TouchTree(message.root(), 0);
+}
+
+uint64_t TouchFlat(flat::ArrayMessageView message) {
+  uint64_t hash = 0;
+  auto values = message.values();
+  auto samples = message.samples();
+  auto counts = message.counts();
+  for (size_t i = 0; i < values.size(); i++) hash = Mix(hash, static_cast<uint64_t>(values[i]));
+  for (size_t i = 0; i < samples.size(); i++) hash = MixDouble(hash, samples[i]);
+  for (size_t i = 0; i < counts.size(); i++) hash = Mix(hash, counts[i]);
+  hash = Mix(hash, values.size());
+  hash = Mix(hash, samples.size());
+  return Mix(hash, counts.size());
+}
+
+uint64_t TouchFlat(flat::MapMessageView message) {
+  auto counters = message.counters();
+  uint64_t counter_sum = 0;
+  for (size_t i = 0; i < counters.size(); i++) {
+    uint64_t key = MixView(0, counters[i].key());
+    counter_sum = MixEntry(counter_sum, Mix(key, static_cast<uint64_t>(counters[i].value())));
+  }
+  auto labels = message.labels();
+  uint64_t label_sum = 0;
+  for (size_t i = 0; i < labels.size(); i++) {
+    label_sum = MixEntry(label_sum, MixView(Mix(0, labels[i].key()), labels[i].value()));
+  }
+  uint64_t hash = Mix(Mix(0, counter_sum), counters.size());
+  return Mix(Mix(hash, label_sum), labels.size());
+}
+
+uint64_t TouchFlat(flat::SparseMessageView message) {
+  uint64_t hash = 0;
+  auto records = message.records();
+  for (size_t r = 0; r < records.size(); r++) {
+    auto record = records[r];
+    uint32_t present = record.present();
+    for (size_t i = 0; i < common::SparseRecord::kIntFields; i++) {
+      if (present & (1u << i)) hash = Mix(Mix(hash, i), static_cast<uint64_t>(record.int_value(i)));
+    }
+    for (size_t i = 0; i < common::SparseRecord::kDoubleFields; i++) {
+      if (present & (1u << (flat::SparseRecordView::kDoubleBit + i))) {
+        hash = MixDouble(Mix(hash, kDoubleField + i), record.double_value(i));
+      }
+    }
+    for (size_t i = 0; i < common::SparseRecord::kTextFields; i++) {
+      if (present & (1u << (flat::SparseRecordView::kTextBit + i))) {
+        hash = MixView(Mix(hash, kTextField + i), record.text_value(i));
+      }
+    }
+  }
+  return Mix(hash, records.size());
+}
+
+uint64_t TouchFlat(flat::StringMessageView message) {
+  uint64_t hash = 0;
+  auto records = message.records();
+  for (size_t r = 0; r < records.size(); r++) {
+    auto record = records[r];
+    hash = MixView(hash, record.name());
+    hash = MixView(hash, record.email());
+    hash = MixView(hash, record.city());
+    hash = MixView(hash, record.note());
+    auto tags = record.tags();
+    for (size_t i = 0; i < tags.size(); i++) hash = MixView(hash, tags[i].value());
+    hash = Mix(hash, tags.size());
+  }
+  return Mix(hash, records.size());
+}
+
+// The block is encoded into an 8-aligned buffer, so every field read is
+// aligned; decoding is the one validation pass of Open()
+template<typename T>
+class FlatCase : public ICodecCase {
+public:
+  explicit FlatCase(const T& sample)
+    : sample_(sample),
+      buffer_((flat::EncodedSize(sample) + sizeof(uint64_t) - 1) / sizeof(uint64_t)) {}
+
+  size_t Encode() override {
+    size_t size = flat::EncodedSize(sample_);
+    common::wire::WireWriter writer(Data(), buffer_.size() * sizeof(uint64_t));
+    flat::Encode(sample_, &writer);
+    encoded_size_ = size;
+    return size;
+  }
+
+  bool Decode() override {
+    View view;
+    return flat::Open(Data(), encoded_size_, &view);
+  }
+
+  uint64_t DecodeAndTouch() override {
+    View view;
+    if (!flat::Open(Data(), encoded_size_, &view)) return 0;
+    return TouchFlat(view);
+  }
+
+private:
+  using View = typename ViewOf<T>::type;
+
+  uint8_t* Data() { return reinterpret_cast<uint8_t*>(buffer_.data()); }
+
+  const T& sample_;
+  std::vector<uint64_t> buffer_;
+  size_t encoded_size_ = 0;
+};
+
+class FlatCodec : public ICodec {
+public:
+  std::string GetName() const override { return "flat"; }
+  std::string GetSchema() const override { return "flat_format.h"; }
+
+  std::unique_ptr<ICodecCase> CreateCase(MessageKind kind,
+                                         const MessageSet& messages) override {
+    return MakeCase<FlatCase>(kind, messages);
+  }
+};
+
+} // namespace
+
+std::unique_ptr<ICodec> CreateFlatCodec() {
+  return std::make_unique<FlatCodec>();
+}
+
+} // namespace codec
+} // namespace benchmark
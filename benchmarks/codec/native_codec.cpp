@@ -0,0 +1,61 @@
+// The native wire format: message bodies as the rawtcp, uds and shm
+// transports write them, without the frame header
+
+#include "codec_suite.h"
+#include "wire_format.h"
+
+namespace benchmark {
+namespace codec {
+
+namespace {
+
+namespace wire = common::wire;
+
+// Decoding is eager: the flat body is copied out into the common type
+template<typename T>
+class NativeCase : public ICodecCase {
+public:
+  explicit NativeCase(const T& sample) : sample_(sample) {}
+
+  size_t Encode() override {
+    buffer_.clear();
+    wire::WireWriter writer(&buffer_);
+    wire::Encode(sample_, &writer);
+    return buffer_.size();
+  }
+
+  bool Decode() override {
+    wire::WireReader reader(reinterpret_cast<const uint8_t*>(buffer_.data()), buffer_.size());
+    return wire::Decode(&reader, &decoded_) && reader.AtEnd();
+  }
+
+  uint64_t DecodeAndTouch() override {
+    if (!Decode()) return 0;
+    return Touch(decoded_);
+  }
+
+private:
+  const T& sample_;
+  std::string buffer_;
+  T decoded_;
+};
+
+class NativeCodec : public ICodec {
+public:
+  std::string GetName() const override { return "native"; }
+  std::string GetSchema() const override { return "wire_format.h"; }
+
+  std::unique_ptr<ICodecCase> CreateCase(MessageKind kind,
+                                         const MessageSet& messages) override {
+    return MakeCase<NativeCase>(kind, messages);
+  }
+};
+
+} // namespace
+
+std::unique_ptr<ICodec> CreateNativeCodec() {
+  return std::make_unique<NativeCodec>();
+}
+
+} // namespace codec
+} // namespace benchmark
@@ -0,0 +1,291 @@
+// benchmark.proto through protobuf's generated messages, built from the
+// gRPC adapter's schema without gRPC itself
+
+#include "codec_suite.h"
+#include "benchmark.pb.h"
+#include "shape_proto.h"
+
+namespace benchmark {
+namespace codec {
+
+namespace {
+
+namespace pb = ::benchmark;
+
+template<typename T> struct ProtoOf;
+template<> struct ProtoOf<common::EchoRequest> { using type = pb::EchoRequest; };
+template<> struct ProtoOf<common::EchoResponse> { using type = pb::EchoResponse; };
+template<> struct ProtoOf<common::StreamRequest> { using type = pb::StreamRequest; };
+template<> struct ProtoOf<common::DataChunk> { using type = pb::DataChunk; };
+template<> struct ProtoOf<common::UploadResponse> { using type = pb::UploadResponse; };
+template<> struct ProtoOf<common::BatchRequest> { using type = pb::BatchRequest; };
+template<> struct ProtoOf<common::BatchResponse> { using type = pb::BatchResponse; };
+template<> struct ProtoOf<common::NestedMessage> { using type = pb::NestedMessage; };
+template<> struct ProtoOf<common::ArrayMessage> { using type = pb::ArrayMessage; };
+template<> struct ProtoOf<common::MapMessage> { using type = pb::MapMessage; };
+template<> struct ProtoOf<common::SparseMessage> { using type = pb::SparseMessage; };
+template<> struct ProtoOf<common::StringMessage> { using type = pb::StringMessage; };
+
+void SetBytes(const std::vector<uint8_t>& from, std::string* to) {
+  to->assign(reinterpret_cast<const char*>(from.data()), from.size());
+}
+
+// Filling the messages is part of encoding, as it is for an application
+// that keeps its values in its own types
+void ToProto(const common::EchoRequest& from, pb::EchoRequest* to) {
+  to->set_message(from.message);
+  to->set_timestamp(from.timestamp);
+  to->set_sequence_number(from.sequence_number);
+}
+
+void ToProto(const common::EchoResponse& from, pb::EchoResponse* to) {
+  to->set_message(from.message);
+  to->set_client_timestamp(from.client_timestamp);
+  to->set_server_timestamp(from.server_timestamp);
+  to->set_sequence_number(from.sequence_number);
+}
+
+void ToProto(const common::StreamRequest& from, pb::StreamRequest* to) {
+  to->set_chunk_size(from.chunk_size);
+  to->set_chunk_count(from.chunk_count);
+  to->set_delay_ms(from.delay_ms);
+}
+
+void ToProto(const common::DataChunk& from, pb::DataChunk* to) {
+  to->set_sequence_number(from.sequence_number);
+  SetBytes(from.data, to->mutable_data());
+  to->set_checksum(from.checksum);
+  to->set_timestamp(from.timestamp);
+}
+
+void ToProto(const common::UploadResponse& from, pb::UploadResponse* to) {
+  to->set_total_bytes(from.total_bytes);
+  to->set_chunk_count(from.chunk_count);
+  to->set_duration_ns(from.duration_ns);
+  to->set_checksum_valid(from.checksum_valid);
+}
+
+void ToProto(const common::BatchRequest& from, pb::BatchRequest* to) {
+  for (const auto& item : from.items) {
+    auto* out = to->add_items();
+    out->set_id(item.id);
+    out->set_operation(item.operation);
+    SetBytes(item.data, out->mutable_data());
+  }
+  to->set_fail_on_error(from.fail_on_error);
+}
+
+void ToProto(const common::BatchResponse& from, pb::BatchResponse* to) {
+  for (const auto& result : from.results) {
+    auto* out = to->add_results();
+    out->set_id(result.id);
+    out->set_success(result.success);
+    out->set_error_message(result.error_message);
+    SetBytes(result.result_data, out->mutable_result_data());
+  }
+  to->set_total_processed(from.total_processed);
+  to->set_total_failed(from.total_failed);
+}
+
+void ToProto(const common::NestedMessage& from, pb::NestedMessage* to) {
+  common::shapes::NestedToProto(from, to);
+}
+
+void ToProto(const common::ArrayMessage& from, pb::ArrayMessage* to) {
+  common::shapes::ArraysToProto(from, to);
+}
+
+void ToProto(const common::MapMessage& from, pb::MapMessage* to) {
+  common::shapes::MapToProto(from, to);
+}
+
+void ToProto(const common::SparseMessage& from, pb::SparseMessage* to) {
+  common::shapes::SparseToProto(from, to);
+}
+
+void ToProto(const common::StringMessage& from, pb::StringMessage* to) {
+  common::shapes::StringsToProto(from, to);
+}
+
+uint64_t MixString(uint64_t hash, const std::string& value) {
+  return MixBytes(hash, value.data(), value.size());
+}
+
+// Field walks matching Touch() of the common types
+uint64_t TouchProto(const pb::EchoRequest& message) {
+  uint64_t hash = MixString(0, message.message());
+  hash = Mix(hash, static_cast<uint64_t>(message.timestamp()));
+  return Mix(hash, message.sequence_number());
+}
+
+uint64_t TouchProto(const pb::EchoResponse& message) {
+  uint64_t hash = MixString(0, message.message());
+  hash = Mix(hash, static_cast<uint64_t>(message.client_timestamp()));
+  hash = Mix(hash, static_cast<uint64_t>(message.server_timestamp()));
+  return Mix(hash, message.sequence_number());
+}
+
+uint64_t TouchProto(const pb::StreamRequest& message) {
+  uint64_t hash = Mix(0, message.chunk_size());
+  hash = Mix(hash, message.chunk_count());
+  return Mix(hash, message.delay_ms());
+}
+
+uint64_t TouchProto(const pb::DataChunk& message) {
+  uint64_t hash = Mix(0, message.sequence_number());
+  hash = MixString(hash, message.data());
+  hash = Mix(hash, message.checksum());
+  return Mix(hash, static_cast<uint64_t>(message.timestamp()));
+}
+
+uint64_t TouchProto(const pb::UploadResponse& message) {
+  uint64_t hash = Mix(0, message.total_bytes());
+  hash = Mix(hash, message.chunk_count());
+  hash = Mix(hash, static_cast<uint64_t>(message.duration_ns()));
+  return Mix(hash, message.checksum_valid() ? 1 : 0);
+}
+
+uint64_t TouchProto(const pb::BatchRequest& message) {
+  uint64_t hash = 0;
+  for (const auto& item : message.items()) {
+    hash = MixString(hash, item.id());
+    hash = MixString(hash, item.operation());
+    hash = MixString(hash, item.data());
+  }
+  hash = Mix(hash, static_cast<uint64_t>(message.items_size()));
+  return Mix(hash, message.fail_on_error() ? 1 : 0);
+}
+
+uint64_t TouchProto(const pb::BatchResponse& message) {
+  uint64_t hash = 0;
+  for (const auto& result : message.results()) {
+    hash = MixString(hash, result.id());
+    hash = Mix(hash, result.success() ? 1 : 0);
+    hash = MixString(hash, result.error_message());
+    hash = MixString(hash, result.result_data());
+  }
+  hash = Mix(hash, static_cast<uint64_t>(message.results_size()));
+  hash = Mix(hash, message.total_processed());
+  return Mix(hash, message.total_failed());
+}
+
+uint64_t TouchTree(const pb::TreeNode& node, uint64_t hash) {
+  hash = Mix(hash, static_cast<uint64_t>(node.id()));
+  hash = MixDouble(hash, node.weight());
+  hash = MixString(hash, node.label());
+  hash = Mix(hash, static_cast<uint64_t>(node.children_size()));
+  for (const auto& child : node.children()) hash = TouchTree(child, hash);
+  return hash;
+}
+
+uint64_t TouchProto(const pb::NestedMessage& message) {
+  return TouchTree(message.root(), 0);
+}
+
+uint64_t TouchProto(const pb::ArrayMessage& message) {
+  uint64_t hash = 0;
+  for (int64_t value : message.values()) hash = Mix(hash, static_cast<uint64_t>(value));
+  for (double sample : message.samples()) hash = MixDouble(hash, sample);
+  for (uint32_t count : message.counts()) hash = Mix(hash, count);
+  hash = Mix(hash, static_cast<uint64_t>(message.values_size()));
+  hash = Mix(hash, static_cast<uint64_t>(message.samples_size()));
+  return Mix(hash, static_cast<uint64_t>(message.counts_size()));
+}
+
+uint64_t TouchProto(const pb::MapMessage& message) {
+  uint64_t counters = 0;
+  for (const auto& entry : message.counters()) {
+    counters = MixEntry(counters, Mix(MixString(0, entry.first),
+                                      static_cast<uint64_t>(entry.second)));
+  }
+  uint64_t labels = 0;
+  for (const auto& entry : message.labels()) {
+    labels = MixEntry(labels, MixString(Mix(0, entry.first), entry.second));
+  }
+  uint64_t hash = Mix(Mix(0, counters), message.counters_size());
+  return Mix(Mix(hash, labels), message.labels_size());
+}
+
+// Set fields come in field order, as in Touch()
+uint64_t TouchProto(const pb::SparseMessage& message) {
+  uint64_t hash = 0;
+  for (const auto& record : message.records()) {
+    common::shapes::ForEachSetField(
+        record,
+        [&hash](size_t index, int64_t value) {
+          hash = Mix(Mix(hash, index), static_cast<uint64_t>(value));
+        },
+        [&hash](size_t index, double value) {
+          hash = MixDouble(Mix(hash, kDoubleField + index), value);
+        },
+        [&hash](size_t index, const std::string& value) {
+          hash = MixString(Mix(hash, kTextField + index), value);
+        });
+  }
+  return Mix(hash, static_cast<uint64_t>(message.records_size()));
+}
+
+uint64_t TouchProto(const pb::StringMessage& message) {
+  uint64_t hash = 0;
+  for (const auto& record : message.records()) {
+    hash = MixString(hash, record.name());
+    hash = MixString(hash, record.email());
+    hash = MixString(hash, record.city());
+    hash = MixString(hash, record.note());
+    for (const auto& tag : record.tags()) hash = MixString(hash, tag);
+    hash = Mix(hash, static_cast<uint64_t>(record.tags_size()));
+  }
+  return Mix(hash, static_cast<uint64_t>(message.records_size()));
+}
+
+// Both messages live across calls: Clear() keeps their string and
+// repeated-field storage, as a server reusing its messages would
+template<typename T>
+class ProtobufCase : public ICodecCase {
+public:
+  explicit ProtobufCase(const T& sample) : sample_(sample) {}
+
+  size_t Encode() override {
+    message_.Clear();
+    ToProto(sample_, &message_);
+    message_.SerializeToString(&buffer_);
+    return buffer_.size();
+  }
+
+  bool Decode() override {
+    return decoded_.ParseFromArray(buffer_.data(), static_cast<int>(buffer_.size()));
+  }
+
+  uint64_t DecodeAndTouch() override {
+    if (!Decode()) return 0;
+    return TouchProto(decoded_);
+  }
+
+private:
+  using Proto = typename ProtoOf<T>::type;
+
+  const T& sample_;
+  Proto message_;
+  std::string buffer_;
+  Proto decoded_;
+};
+
+class ProtobufCodec : public ICodec {
+public:
+  std::string GetName() const override { return "protobuf"; }
+  std::string GetSchema() const override { return "benchmark.proto"; }
+
+  std::unique_ptr<ICodecCase> CreateCase(MessageKind kind,
+                                         const MessageSet& messages) override {
+    return MakeCase<ProtobufCase>(kind, messages);
+  }
+};
+
+} // namespace
+
+std::unique_ptr<ICodec> CreateProtobufCodec() {
+  return std::make_unique<ProtobufCodec>();
+}
+
+} // namespace codec
+} // namespace benchmark
@@ -6,12 +6,25 @@
 namespace benchmark {
 namespace scenarios {
 
+void BenchmarkResults::ComputeDerivedMetrics() {
+  requests_per_second = common::utils::CalculateRequestsPerSecond(
+      successful_requests, total_duration_ns);
+  throughput_mbps = common::utils::CalculateThroughputMBps(
+      total_bytes, total_duration_ns);
+  success_rate = total_requests > 0
+      ? (double)successful_requests / total_requests
+      : 0.0;
+}
+
 void BenchmarkResults::Print() const {
   std::cout << "\n========================================" << std::endl;
   std::cout << "Benchmark Results" << std::endl;
   std::cout << "========================================" << std::endl;
   std::cout << "Scenario: " << scenario_name << std::endl;
   std::cout << "Framework: " << framework_name << std::endl;
+  if (message_size > 0) {
+    std::cout << "Message size: " << message_size << " bytes" << std::endl;
+  }
   std::cout << std::endl;
 
   std::cout << "Throughput:" << std::endl;
@@ -35,7 +48,7 @@ void BenchmarkResults::Print() const {
             << (success_rate * 100.0) << "%" << std::endl;
   std::cout << std::endl;
 
-  if (peak_memory_bytes > 0 || avg_cpu_percent > 0) {
+  if (peak_memory_bytes > 0 || avg_cpu_percent > 0 || cpu_us_per_request > 0) {
     std::cout << "Resources:" << std::endl;
     if (peak_memory_bytes > 0) {
       std::cout << "  Peak memory: " << common::utils::FormatBytes(peak_memory_bytes) << std::endl;
@@ -44,6 +57,54 @@ void BenchmarkResults::Print() const {
       std::cout << "  Avg CPU: " << std::fixed << std::setprecision(1)
                 << avg_cpu_percent << "%" << std::endl;
     }
+    if (cpu_us_per_request > 0) {
+      std::cout << "  CPU per request: " << std::fixed << std::setprecision(2)
+                << cpu_us_per_request << " us" << std::endl;
+    }
+    std::cout << std::endl;
+  }
+
+  if (server_peak_memory_bytes > 0 || server_cpu_percent > 0) {
+    std::cout << "Server resources:" << std::endl;
+    if (server_peak_memory_bytes > 0) {
+      std::cout << "  Peak memory: " << common::utils::FormatBytes(server_peak_memory_bytes)
+                << std::endl;
+    }
+    if (server_cpu_percent > 0) {
+      std::cout << "  Avg CPU: " << std::fixed << std::setprecision(1)
+                << server_cpu_percent << "%" << std::endl;
+    }
+    if (server_cpu_us_per_request > 0) {
+      std::cout << "  CPU per request: " << std::fixed << std::setprecision(2)
+                << server_cpu_us_per_request << " us" << std::endl;
+    }
+    std::cout << std::endl;
+  }
+
+  if (!custom_metrics.empty()) {
+    std::cout << "Scenario metrics:" << std::endl;
+    for (const auto& metric : custom_metrics) {
+      std::cout << "  " << metric.first << ": " << std::fixed
+                << std::setprecision(2) << metric.second << std::endl;
+    }
+    std::cout << std::endl;
+  }
+
+  for (const auto& s : series) {
+    std::cout << s.name << ":" << std::endl;
+    std::cout << " ";
+    for (const auto& column : s.columns) {
+      std::cout << " " << std::setw(14) << column;
+    }
+    std::cout << std::endl;
+    for (const auto& row : s.rows) {
+      std::cout << " ";
+      for (double value : row) {
+        std::cout << " " << std::setw(14) << std::fixed << std::setprecision(2)
+                  << value;
+      }
+      std::cout << std::endl;
+    }
     std::cout << std::endl;
   }
 
@@ -57,6 +118,9 @@ std::string BenchmarkResults::ToJSON() const {
   json << "{\n";
   json << "  \"scenario\": \"" << scenario_name << "\",\n";
   json << "  \"framework\": \"" << framework_name << "\",\n";
+  if (message_size > 0) {
+    json << "  \"message_size\": " << message_size << ",\n";
+  }
   json << "  \"throughput\": {\n";
   json << "    \"requests_per_second\": " << requests_per_second << ",\n";
   json << "    \"throughput_mbps\": " << throughput_mbps << ",\n";
@@ -79,19 +143,61 @@ std::string BenchmarkResults::ToJSON() const {
   json << "    \"success_rate\": " << success_rate << "\n";
   json << "  }";
 
-  if (peak_memory_bytes > 0 || avg_cpu_percent > 0) {
+  std::vector<std::pair<std::string, double>> resources;
+  if (peak_memory_bytes > 0) {
+    resources.emplace_back("peak_memory_bytes", static_cast<double>(peak_memory_bytes));
+  }
+  if (avg_cpu_percent > 0) resources.emplace_back("avg_cpu_percent", avg_cpu_percent);
+  if (cpu_us_per_request > 0) resources.emplace_back("cpu_us_per_request", cpu_us_per_request);
+  if (server_peak_memory_bytes > 0) {
+    resources.emplace_back("server_peak_memory_bytes",
+                           static_cast<double>(server_peak_memory_bytes));
+  }
+  if (server_cpu_percent > 0) resources.emplace_back("server_cpu_percent", server_cpu_percent);
+  if (server_cpu_us_per_request > 0) {
+    resources.emplace_back("server_cpu_us_per_request", server_cpu_us_per_request);
+  }
+  if (!resources.empty()) {
     json << ",\n  \"resources\": {\n";
-    if (peak_memory_bytes > 0) {
-      json << "    \"peak_memory_bytes\": " << peak_memory_bytes;
-      if (avg_cpu_percent > 0) json << ",";
-      json << "\n";
+    for (size_t i = 0; i < resources.size(); i++) {
+      json << "    \"" << resources[i].first << "\": " << resources[i].second
+           << (i + 1 < resources.size() ? ",\n" : "\n");
     }
-    if (avg_cpu_percent > 0) {
-      json << "    \"avg_cpu_percent\": " << avg_cpu_percent << "\n";
+    json << "  }";
+  }
+
+  if (!custom_metrics.empty()) {
+    json << ",\n  \"metrics\": {\n";
+    for (size_t i = 0; i < custom_metrics.size(); i++) {
+      json << "    \"" << custom_metrics[i].first << "\": "
+           << custom_metrics[i].second
+           << (i + 1 < custom_metrics.size() ? ",\n" : "\n");
     }
     json << "  }";
   }
 
+  if (!series.empty()) {
+    json << ",\n  \"series\": [\n";
+    for (size_t i = 0; i < series.size(); i++) {
+      const auto& s = series[i];
+      json << "    {\n      \"name\": \"" << s.name << "\",\n";
+      json << "      \"columns\": [";
+      for (size_t c = 0; c < s.columns.size(); c++) {
+        json << (c > 0 ? ", " : "") << "\"" << s.columns[c] << "\"";
+      }
+      json << "],\n      \"rows\": [";
+      for (size_t r = 0; r < s.rows.size(); r++) {
+        json << (r > 0 ? ", " : "") << "[";
+        for (size_t c = 0; c < s.rows[r].size(); c++) {
+          json << (c > 0 ? ", " : "") << s.rows[r][c];
+        }
+        json << "]";
+      }
+      json << "]\n    }" << (i + 1 < series.size() ? ",\n" : "\n");
+    }
+    json << "  ]";
+  }
+
   json << "\n}";
   return json.str();
 }
@@ -2,8 +2,11 @@
 
 #include "benchmark_service.h"
 #include "benchmark_utils.h"
+#include <functional>
 #include <string>
 #include <memory>
+#include <utility>
+#include <vector>
 
 namespace benchmark {
 namespace scenarios {
@@ -18,25 +21,87 @@ struct BenchmarkConfig {
   int num_clients = 1;
   int num_threads_per_client = 1;
 
+  // Outstanding async requests per thread (1 = synchronous calls)
+  int pipeline_depth = 1;
+
   // Data sizes
   size_t message_size = 1024;
   size_t batch_size = 100;
 
+  // Mixed workload: payload size distribution (see size_distribution.h;
+  // empty means fixed at message_size) and relative operation weights
+  std::string size_distribution;
+  std::string workload_mix = "echo=80,batch=15,stream=5";
+
+  // Trace replay: recorded workload and time scaling (2.0 = twice as fast)
+  std::string trace_file;
+  double trace_speed = 1.0;
+
   // Server address
   std::string server_address = "localhost:50051";
 
+  // CPU time used so far by a server in another process, in nanoseconds
+  // (-1 if unavailable). Empty when the server shares this process.
+  std::function<int64_t()> server_cpu_nanos;
+
   // Warm-up period before measuring
   int warmup_seconds = 1;
 
+  // Latency SLO for the maximum sustainable throughput search: the
+  // slo_percentile latency must stay at or below slo_latency_us with no
+  // errors. Each probe runs for duration_seconds.
+  double slo_percentile = 0.99;
+  int64_t slo_latency_us = 1000;
+  double slo_start_rps = 1000.0;
+  double slo_max_rps = 10000000.0;
+  int slo_search_steps = 6;
+
+  // Connection churn: calls timed individually on each new connection
+  // before the steady-state calls that serve as the baseline
+  int churn_first_calls = 10;
+  int churn_steady_calls = 100;
+
+  // Scatter-gather fan-out: backend counts to step through (sweep list
+  // syntax), backends addressed per request (0 = all) and answers needed
+  // before a request completes (0 = every addressed backend)
+  std::string fanout_counts = "1,2,4,8,16";
+  int fanout_k = 0;
+  int fanout_quorum = 0;
+
+  // Large messages: payload sizes (sweep list syntax, e.g. "1M:1G:x4"),
+  // chunk size of the streamed variants and unary repetitions per size
+  std::string large_sizes = "1M:64M:x4";
+  size_t large_chunk_size = 1 << 20;
+  int large_repeats = 3;
+
+  // Dependent call chains: chain lengths to step through (sweep list
+  // syntax)
+  std::string chain_lengths = "1,2,4,8,16";
+
+  // Message shapes: shapes to echo ("all" or a list of nested, arrays,
+  // map, sparse and strings) and their sizes in field bytes (sweep list
+  // syntax)
+  std::string message_shapes = "all";
+  std::string shape_sizes = "256,4K,64K";
+
   // Output settings
   bool verbose = false;
   std::string output_file;
 };
 
+// Tabular scenario output such as a saturation curve. Every row holds one
+// value per column.
+struct ResultSeries {
+  std::string name;
+  std::vector<std::string> columns;
+  std::vector<std::vector<double>> rows;
+};
+
 // Results from a benchmark run
 struct BenchmarkResults {
   std::string scenario_name;
   std::string framework_name;
+  size_t message_size = 0;
 
   // Latency statistics
   common::utils::LatencyStats latency_stats;
@@ -53,10 +118,25 @@ struct BenchmarkResults {
   uint64_t failed_requests = 0;
   double success_rate = 0.0;
 
-  // Resource usage (if measured)
+  // Resource usage (if measured). CPU covers the whole process, so with a
+  // local server it includes both client and server.
   double avg_cpu_percent = 0.0;
+  double cpu_us_per_request = 0.0;
   uint64_t peak_memory_bytes = 0;
 
+  // The same for a server running in its own process
+  double server_cpu_percent = 0.0;
+  double server_cpu_us_per_request = 0.0;
+  uint64_t server_peak_memory_bytes = 0;
+
+  // Scenario-specific metrics, reported in insertion order
+  std::vector<std::pair<std::string, double>> custom_metrics;
+  std::vector<ResultSeries> series;
+
+  // Fill requests_per_second, throughput_mbps and success_rate from the
+  // raw counters
+  void ComputeDerivedMetrics();
+
   // Print results
   void Print() const;
 
@@ -77,8 +157,13 @@ public:
 
   const std::string& GetName() const { return name_; }
 
+  // Factory of the framework under test, for scenarios that need more than
+  // the one client passed to Run() (connection churn, extra servers)
+  void SetFactory(common::IFrameworkFactory* factory) { factory_ = factory; }
+
 protected:
   std::string name_;
+  common::IFrameworkFactory* factory_ = nullptr;
 };
 
 } // namespace scenarios
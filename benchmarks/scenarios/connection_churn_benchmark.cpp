@@ -0,0 +1,223 @@
+#include "benchmark_scenario.h"
+#include "payload_generator.h"
+#include <algorithm>
+#include <atomic>
+#include <iostream>
+#include <mutex>
+#include <thread>
+
+namespace benchmark {
+namespace scenarios {
+
+// Measures what short-lived clients pay for a connection.
+//
+// The first half of the run opens connections one at a time and records
+// connect time, time to the first successful call, the latency of each of
+// the first churn_first_calls calls and a steady-state baseline. The
+// second half churns connect / call / disconnect cycles from
+// num_threads_per_client threads at once to measure connection throughput
+// under contention.
+class ConnectionChurnBenchmark : public BenchmarkScenario {
+public:
+  ConnectionChurnBenchmark() : BenchmarkScenario("Connection Churn") {}
+
+  BenchmarkResults Run(
+      common::IBenchmarkClient* client,
+      const BenchmarkConfig& config) override {
+
+    BenchmarkResults results;
+    results.scenario_name = name_;
+    results.framework_name = "unknown";
+
+    message_ = common::payload::SharedText(config.message_size);
+    int first_calls = std::max(1, config.churn_first_calls);
+
+    auto phase_duration = std::chrono::milliseconds(
+        std::max(1, config.duration_seconds) * 500);
+
+    // Sequential phase: per-connection startup costs
+    common::utils::LatencyStats connect_stats;
+    common::utils::LatencyStats disconnect_stats;
+    common::utils::LatencyStats steady_stats;
+    std::vector<common::utils::LatencyStats> call_index_stats(first_calls);
+    uint64_t connections = 0;
+    uint64_t failed_attempts = 0;  // First-call attempts that failed and were retried
+
+    auto phase_end = std::chrono::steady_clock::now() + phase_duration;
+    while (std::chrono::steady_clock::now() < phase_end) {
+      std::unique_ptr<common::IBenchmarkClient> owned;
+      auto* conn = Acquire(client, &owned);
+      if (!conn) {
+        std::cerr << "Failed to create client" << std::endl;
+        break;
+      }
+
+      auto connect_start = common::utils::GetTimestampNanos();
+      bool connected = conn->Connect(config.server_address);
+      auto connect_end = common::utils::GetTimestampNanos();
+      results.total_requests++;
+      if (!connected || !conn->GetService()) {
+        results.failed_requests++;
+        continue;
+      }
+      connect_stats.AddSample(connect_end - connect_start);
+      connections++;
+
+      // Time to first successful call includes retries of failed ones. A
+      // connection counts as one request, failed only if no call succeeded.
+      auto* service = conn->GetService();
+      int64_t ttfc = 0;
+      for (int attempt = 0; attempt < 100; attempt++) {
+        int64_t latency = 0;
+        if (Call(service, &latency)) {
+          ttfc = common::utils::GetTimestampNanos() - connect_start;
+          call_index_stats[0].AddSample(latency);
+          break;
+        }
+        failed_attempts++;
+      }
+
+      if (ttfc == 0) {
+        results.failed_requests++;
+      } else {
+        results.latency_stats.AddSample(ttfc);
+        results.successful_requests++;
+        results.total_bytes += 2 * message_.size();
+
+        for (int i = 1; i < first_calls; i++) {
+          int64_t latency = 0;
+          if (Call(service, &latency)) call_index_stats[i].AddSample(latency);
+        }
+        for (int i = 0; i < config.churn_steady_calls; i++) {
+          int64_t latency = 0;
+          if (Call(service, &latency)) steady_stats.AddSample(latency);
+        }
+      }
+
+      auto disconnect_start = common::utils::GetTimestampNanos();
+      conn->Disconnect();
+      owned.reset();
+      disconnect_stats.AddSample(common::utils::GetTimestampNanos() - disconnect_start);
+    }
+
+    results.total_duration_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        phase_duration).count();
+    results.ComputeDerivedMetrics();
+
+    // Concurrent phase: connect / call / disconnect cycles from many threads
+    int num_threads = std::max(1, config.num_threads_per_client);
+    std::mutex cycle_mutex;
+    common::utils::LatencyStats cycle_stats;
+    std::atomic<uint64_t> cycles{0};
+    std::atomic<uint64_t> cycle_failures{0};
+
+    auto churn_start = std::chrono::steady_clock::now();
+    auto churn_end = churn_start + phase_duration;
+    std::vector<std::thread> workers;
+    for (int t = 0; t < num_threads; t++) {
+      workers.emplace_back([&]() {
+        common::utils::LatencyStats local;
+        while (std::chrono::steady_clock::now() < churn_end) {
+          auto cycle_start = common::utils::GetTimestampNanos();
+          std::unique_ptr<common::IBenchmarkClient> owned;
+          auto* conn = factory_ ? (owned = factory_->CreateClient()).get() : nullptr;
+          int64_t latency = 0;
+          bool ok = conn && conn->Connect(config.server_address) &&
+                    conn->GetService() && Call(conn->GetService(), &latency);
+          if (conn) conn->Disconnect();
+          owned.reset();
+
+          if (ok) {
+            local.AddSample(common::utils::GetTimestampNanos() - cycle_start);
+            cycles++;
+          } else {
+            cycle_failures++;
+            if (!conn) break;
+          }
+        }
+        std::lock_guard<std::mutex> lock(cycle_mutex);
+        cycle_stats.Merge(local);
+      });
+    }
+    for (auto& worker : workers) {
+      worker.join();
+    }
+    auto churn_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - churn_start).count();
+
+    double steady_p50 = static_cast<double>(steady_stats.GetP50());
+    double first_p50 = static_cast<double>(call_index_stats[0].GetP50());
+
+    results.custom_metrics.emplace_back("connections", static_cast<double>(connections));
+    results.custom_metrics.emplace_back("connect_p50_us", connect_stats.GetP50() / 1000.0);
+    results.custom_metrics.emplace_back("connect_p99_us", connect_stats.GetP99() / 1000.0);
+    results.custom_metrics.emplace_back("failed_first_call_attempts",
+                                        static_cast<double>(failed_attempts));
+    results.custom_metrics.emplace_back("ttfc_p50_us", results.latency_stats.GetP50() / 1000.0);
+    results.custom_metrics.emplace_back("ttfc_p99_us", results.latency_stats.GetP99() / 1000.0);
+    results.custom_metrics.emplace_back("first_call_p50_us", first_p50 / 1000.0);
+    results.custom_metrics.emplace_back("steady_p50_us", steady_p50 / 1000.0);
+    results.custom_metrics.emplace_back("first_call_penalty",
+                                        steady_p50 > 0 ? first_p50 / steady_p50 : 0.0);
+    results.custom_metrics.emplace_back("disconnect_p50_us",
+                                        disconnect_stats.GetP50() / 1000.0);
+    results.custom_metrics.emplace_back("churn_threads", num_threads);
+    results.custom_metrics.emplace_back(
+        "churn_cycles_per_sec",
+        common::utils::CalculateRequestsPerSecond(cycles.load(), churn_ns));
+    results.custom_metrics.emplace_back("churn_cycle_p50_us", cycle_stats.GetP50() / 1000.0);
+    results.custom_metrics.emplace_back("churn_cycle_p99_us", cycle_stats.GetP99() / 1000.0);
+    results.custom_metrics.emplace_back("churn_failures",
+                                        static_cast<double>(cycle_failures.load()));
+
+    ResultSeries warmup_curve;
+    warmup_curve.name = "Latency by call index on a new connection";
+    warmup_curve.columns = {"call_index", "p50_us", "p99_us", "vs_steady_p50"};
+    for (int i = 0; i < first_calls; i++) {
+      const auto& stats = call_index_stats[i];
+      warmup_curve.rows.push_back({
+          static_cast<double>(i + 1),
+          stats.GetP50() / 1000.0,
+          stats.GetP99() / 1000.0,
+          steady_p50 > 0 ? stats.GetP50() / steady_p50 : 0.0});
+    }
+    results.series.push_back(warmup_curve);
+
+    if (!factory_) {
+      std::cerr << "Connection churn: no factory set, concurrent phase skipped"
+                << std::endl;
+    }
+
+    return results;
+  }
+
+private:
+  // New client from the factory, or the caller's client if there is none
+  common::IBenchmarkClient* Acquire(
+      common::IBenchmarkClient* fallback,
+      std::unique_ptr<common::IBenchmarkClient>* owned) {
+    if (!factory_) return fallback;
+    *owned = factory_->CreateClient();
+    return owned->get();
+  }
+
+  bool Call(common::IBenchmarkService* service, int64_t* latency_ns) {
+    common::EchoRequest request;
+    request.message = message_;
+    request.timestamp = common::utils::GetTimestampNanos();
+
+    auto call_start = common::utils::GetTimestampNanos();
+    auto result = service->Echo(request);
+    *latency_ns = common::utils::GetTimestampNanos() - call_start;
+    return result.ok();
+  }
+
+  std::string message_;
+};
+
+std::unique_ptr<BenchmarkScenario> CreateConnectionChurnBenchmark() {
+  return std::make_unique<ConnectionChurnBenchmark>();
+}
+
+} // namespace scenarios
+} // namespace benchmark
@@ -0,0 +1,135 @@
+#include "benchmark_scenario.h"
+#include "parameter_sweep.h"
+#include "payload_generator.h"
+#include <algorithm>
+#include <iostream>
+
+namespace benchmark {
+namespace scenarios {
+
+// Chains of K dependent echoes, each sending the previous response's
+// message. Every chain is timed twice, alternately: through the service's
+// EchoChain(), which a framework may pipeline or run server-side in one
+// round trip, and as K sequential Echo() round trips. Steps through the
+// lengths in chain_lengths and reports both latencies against K; where the
+// framework has no chained path the two columns match.
+class EchoChainBenchmark : public BenchmarkScenario {
+public:
+  EchoChainBenchmark() : BenchmarkScenario("Dependent Call Chain") {}
+
+  BenchmarkResults Run(
+      common::IBenchmarkClient* client,
+      const BenchmarkConfig& config) override {
+
+    BenchmarkResults results;
+    results.scenario_name = name_;
+    results.framework_name = "unknown";
+
+    std::vector<long> lengths;
+    if (!ParseSweepList(config.chain_lengths, &lengths)) {
+      std::cerr << "Invalid chain lengths: " << config.chain_lengths << std::endl;
+      return results;
+    }
+
+    if (!client->Connect(config.server_address)) {
+      std::cerr << "Failed to connect to server" << std::endl;
+      return results;
+    }
+
+    auto* service = client->GetService();
+    if (!service) {
+      std::cerr << "Failed to get service" << std::endl;
+      return results;
+    }
+
+    common::EchoRequest request;
+    request.message = common::payload::SharedText(config.message_size);
+
+    ResultSeries table;
+    table.name = "Chain latency by length";
+    table.columns = {"length", "chain_p50_us", "chain_p99_us",
+                     "sequential_p50_us", "sequential_p99_us", "speedup_p50"};
+
+    auto per_length = std::chrono::milliseconds(
+        std::max<long>(100, config.duration_seconds * 1000L / lengths.size()));
+
+    for (long length_value : lengths) {
+      uint32_t length = static_cast<uint32_t>(std::max<long>(1, length_value));
+
+      // A few unmeasured chains of each kind
+      for (int i = 0; i < 3; i++) {
+        service->EchoChain(request, length);
+        service->IBenchmarkService::EchoChain(request, length);
+      }
+
+      common::utils::LatencyStats chained;
+      common::utils::LatencyStats sequential;
+      uint64_t requests = 0;
+      uint64_t failures = 0;
+      auto end_time = std::chrono::steady_clock::now() + per_length;
+
+      while (std::chrono::steady_clock::now() < end_time) {
+        request.timestamp = common::utils::GetTimestampNanos();
+        request.sequence_number = static_cast<uint32_t>(requests);
+
+        auto start = common::utils::GetTimestampNanos();
+        bool ok = service->EchoChain(request, length).ok();
+        auto end = common::utils::GetTimestampNanos();
+        if (ok) {
+          chained.AddSample(end - start);
+        } else {
+          failures++;
+        }
+
+        // The base class implementation: one round trip per link
+        start = common::utils::GetTimestampNanos();
+        ok = service->IBenchmarkService::EchoChain(request, length).ok();
+        end = common::utils::GetTimestampNanos();
+        if (ok) {
+          sequential.AddSample(end - start);
+        } else {
+          failures++;
+        }
+
+        requests += 2;
+      }
+
+      double chain_p50 = static_cast<double>(chained.GetP50());
+      table.rows.push_back({
+          static_cast<double>(length),
+          chain_p50 / 1000.0,
+          chained.GetP99() / 1000.0,
+          sequential.GetP50() / 1000.0,
+          sequential.GetP99() / 1000.0,
+          chain_p50 > 0 ? sequential.GetP50() / chain_p50 : 0.0});
+
+      if (config.verbose) {
+        std::cout << "Chain length " << length << ": "
+                  << chain_p50 / 1000.0 << " us chained, "
+                  << sequential.GetP50() / 1000.0 << " us sequential (p50)" << std::endl;
+      }
+
+      // Headline numbers are those of the longest chain
+      results.latency_stats = chained;
+      results.total_requests += requests;
+      results.successful_requests += requests - failures;
+      results.failed_requests += failures;
+      results.total_bytes += (requests - failures) * length * 2 * request.message.size();
+      results.total_duration_ns += std::chrono::duration_cast<std::chrono::nanoseconds>(
+          per_length).count();
+    }
+
+    client->Disconnect();
+
+    results.ComputeDerivedMetrics();
+    results.series.push_back(table);
+    return results;
+  }
+};
+
+std::unique_ptr<BenchmarkScenario> CreateEchoChainBenchmark() {
+  return std::make_unique<EchoChainBenchmark>();
+}
+
+} // namespace scenarios
+} // namespace benchmark
@@ -0,0 +1,293 @@
+#include "benchmark_scenario.h"
+#include "parameter_sweep.h"
+#include "payload_generator.h"
+#include "reference_service.h"
+#include <algorithm>
+#include <cctype>
+#include <condition_variable>
+#include <iostream>
+#include <mutex>
+#include <numeric>
+#include <random>
+#include <thread>
+
+namespace benchmark {
+namespace scenarios {
+
+namespace {
+
+// Address of the i-th backend: bump the port of "host:port", otherwise
+// append a suffix so in-process addresses stay distinct
+std::string BackendAddress(const std::string& base, int index) {
+  auto colon = base.rfind(':');
+  if (colon != std::string::npos && colon + 1 < base.size() &&
+      std::all_of(base.begin() + colon + 1, base.end(),
+                  [](unsigned char c) { return std::isdigit(c) != 0; })) {
+    int port = std::stoi(base.substr(colon + 1));
+    return base.substr(0, colon + 1) + std::to_string(port + 1 + index);
+  }
+  return base + "/fanout-" + std::to_string(index);
+}
+
+// N backends, each with its own server, client and leg thread. The driver
+// publishes a request generation; selected legs issue their call and
+// report completion back.
+class FanOutGroup {
+public:
+  FanOutGroup(common::IFrameworkFactory* factory, const std::string& base_address,
+              int num_backends, const std::string& message)
+    : message_(message) {
+
+    for (int i = 0; i < num_backends; i++) {
+      auto leg = std::make_unique<Leg>();
+      std::string address = BackendAddress(base_address, i);
+
+      leg->server = factory->CreateServer(
+          std::make_shared<reference::ReferenceServiceImpl>());
+      if (!leg->server || !leg->server->Start(address)) {
+        std::cerr << "Fan-out: failed to start server at " << address << std::endl;
+        return;
+      }
+      leg->client = factory->CreateClient();
+      if (!leg->client || !leg->client->Connect(address) || !leg->client->GetService()) {
+        std::cerr << "Fan-out: failed to connect to " << address << std::endl;
+        return;
+      }
+      legs_.push_back(std::move(leg));
+    }
+
+    selected_.assign(legs_.size(), false);
+    for (size_t i = 0; i < legs_.size(); i++) {
+      legs_[i]->thread = std::thread([this, i]() { LegLoop(i); });
+    }
+    ok_ = true;
+  }
+
+  ~FanOutGroup() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stop_ = true;
+    }
+    work_cv_.notify_all();
+    for (auto& leg : legs_) {
+      if (leg->thread.joinable()) leg->thread.join();
+      if (leg->client) leg->client->Disconnect();
+      if (leg->server) leg->server->Stop();
+    }
+  }
+
+  bool ok() const { return ok_; }
+  size_t size() const { return legs_.size(); }
+
+  // Send one logical request to `targets` and return the time until
+  // `quorum` of them answered. Waits for all targets before returning so
+  // stragglers do not overlap the next request. Returns -1 if fewer than
+  // `quorum` legs succeeded. Legs only add to their stats when `measure`
+  // is set, so they cover the same requests as the caller's.
+  int64_t Scatter(const std::vector<size_t>& targets, size_t quorum, bool measure) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    std::fill(selected_.begin(), selected_.end(), false);
+    for (size_t t : targets) selected_[t] = true;
+    pending_ = targets.size();
+    succeeded_ = 0;
+    quorum_ns_ = -1;
+    quorum_ = quorum;
+    measure_ = measure;
+    start_ns_ = common::utils::GetTimestampNanos();
+    generation_++;
+    work_cv_.notify_all();
+
+    done_cv_.wait(lock, [this] { return pending_ == 0; });
+    return quorum_ns_;
+  }
+
+  common::utils::LatencyStats MergedLegStats() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    common::utils::LatencyStats merged;
+    for (const auto& leg : legs_) merged.Merge(leg->stats);
+    return merged;
+  }
+
+private:
+  struct Leg {
+    std::unique_ptr<common::IBenchmarkServer> server;
+    std::unique_ptr<common::IBenchmarkClient> client;
+    std::thread thread;
+    common::utils::LatencyStats stats;  // Guarded by mutex_
+  };
+
+  void LegLoop(size_t index) {
+    uint64_t seen = 0;
+    auto* service = legs_[index]->client->GetService();
+
+    while (true) {
+      int64_t start_ns = 0;
+      bool measure = false;
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        work_cv_.wait(lock, [&] { return stop_ || generation_ != seen; });
+        if (stop_) return;
+        seen = generation_;
+        if (!selected_[index]) continue;
+        start_ns = start_ns_;
+        measure = measure_;
+      }
+
+      common::EchoRequest request;
+      request.message = message_;
+      request.timestamp = common::utils::GetTimestampNanos();
+      auto call_start = common::utils::GetTimestampNanos();
+      auto result = service->Echo(request);
+      auto call_end = common::utils::GetTimestampNanos();
+
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (result.ok()) {
+        if (measure) legs_[index]->stats.AddSample(call_end - call_start);
+        if (++succeeded_ == quorum_) {
+          quorum_ns_ = call_end - start_ns;
+        }
+      }
+      if (--pending_ == 0) {
+        done_cv_.notify_one();
+      }
+    }
+  }
+
+  std::string message_;
+  std::vector<std::unique_ptr<Leg>> legs_;
+  bool ok_ = false;
+
+  std::mutex mutex_;
+  std::condition_variable work_cv_;
+  std::condition_variable done_cv_;
+  uint64_t generation_ = 0;
+  bool stop_ = false;
+  std::vector<bool> selected_;
+  size_t pending_ = 0;
+  size_t succeeded_ = 0;
+  size_t quorum_ = 0;
+  bool measure_ = false;
+  int64_t start_ns_ = 0;
+  int64_t quorum_ns_ = -1;
+};
+
+} // namespace
+
+// Scatter-gather over N backends started through the framework factory.
+// Each logical request goes to all N backends (or a random k of them) at
+// once and completes when all of them, or a quorum, have answered. Runs
+// once per backend count in fanout_counts and reports per-leg latency next
+// to the fan-out completion latency, exposing tail amplification.
+class FanOutBenchmark : public BenchmarkScenario {
+public:
+  FanOutBenchmark() : BenchmarkScenario("Scatter-Gather Fan-Out") {}
+
+  BenchmarkResults Run(
+      common::IBenchmarkClient* client,
+      const BenchmarkConfig& config) override {
+
+    BenchmarkResults results;
+    results.scenario_name = name_;
+    results.framework_name = "unknown";
+    (void)client;
+
+    if (!factory_) {
+      std::cerr << "Fan-out benchmark needs a framework factory" << std::endl;
+      return results;
+    }
+
+    std::vector<long> counts;
+    if (!ParseSweepList(config.fanout_counts, &counts)) {
+      std::cerr << "Invalid fan-out counts: " << config.fanout_counts << std::endl;
+      return results;
+    }
+
+    std::string message = common::payload::SharedText(config.message_size);
+    std::mt19937 gen(12345);
+
+    ResultSeries table;
+    table.name = "Fan-out latency by backend count";
+    table.columns = {"backends", "targets", "quorum", "leg_p50_us", "leg_p99_us",
+                     "fanout_p50_us", "fanout_p99_us", "fanout_p999_us",
+                     "p99_amplification"};
+
+    auto per_count = std::chrono::milliseconds(
+        std::max<long>(100, config.duration_seconds * 1000L / counts.size()));
+
+    for (long n : counts) {
+      FanOutGroup group(factory_, config.server_address, static_cast<int>(n), message);
+      if (!group.ok()) {
+        results.failed_requests++;
+        continue;
+      }
+
+      size_t targets = config.fanout_k > 0
+          ? std::min<size_t>(config.fanout_k, group.size())
+          : group.size();
+      size_t quorum = config.fanout_quorum > 0
+          ? std::min<size_t>(config.fanout_quorum, targets)
+          : targets;
+
+      std::vector<size_t> all(group.size());
+      std::iota(all.begin(), all.end(), 0);
+
+      common::utils::LatencyStats fanout_stats;
+      auto measure_start = std::chrono::steady_clock::now() +
+                           std::chrono::seconds(std::max(0, config.warmup_seconds));
+      auto end_time = measure_start + per_count;
+      uint64_t requests = 0;
+      uint64_t failures = 0;
+
+      while (std::chrono::steady_clock::now() < end_time) {
+        bool measuring = std::chrono::steady_clock::now() >= measure_start;
+        std::vector<size_t> chosen = all;
+        if (targets < chosen.size()) {
+          std::shuffle(chosen.begin(), chosen.end(), gen);
+          chosen.resize(targets);
+        }
+
+        int64_t latency = group.Scatter(chosen, quorum, measuring);
+        if (!measuring) continue;
+        requests++;
+        if (latency >= 0) {
+          fanout_stats.AddSample(latency);
+        } else {
+          failures++;
+        }
+      }
+
+      auto leg_stats = group.MergedLegStats();
+      double leg_p99 = static_cast<double>(leg_stats.GetP99());
+      table.rows.push_back({
+          static_cast<double>(n),
+          static_cast<double>(targets),
+          static_cast<double>(quorum),
+          leg_stats.GetP50() / 1000.0,
+          leg_p99 / 1000.0,
+          fanout_stats.GetP50() / 1000.0,
+          fanout_stats.GetP99() / 1000.0,
+          fanout_stats.GetPercentile(0.999) / 1000.0,
+          leg_p99 > 0 ? fanout_stats.GetP99() / leg_p99 : 0.0});
+
+      // Headline numbers are those of the widest fan-out
+      results.latency_stats = fanout_stats;
+      results.total_requests += requests;
+      results.successful_requests += requests - failures;
+      results.failed_requests += failures;
+      results.total_bytes += (requests - failures) * targets * 2 * message.size();
+      results.total_duration_ns += std::chrono::duration_cast<std::chrono::nanoseconds>(
+          per_count).count();
+    }
+
+    results.ComputeDerivedMetrics();
+    results.series.push_back(table);
+    return results;
+  }
+};
+
+std::unique_ptr<BenchmarkScenario> CreateFanOutBenchmark() {
+  return std::make_unique<FanOutBenchmark>();
+}
+
+} // namespace scenarios
+} // namespace benchmark
@@ -0,0 +1,292 @@
+#include "benchmark_scenario.h"
+#include "parameter_sweep.h"
+#include "payload_generator.h"
+#include "resource_usage.h"
+#include <algorithm>
+#include <atomic>
+#include <future>
+#include <iostream>
+
+namespace benchmark {
+namespace scenarios {
+
+namespace {
+
+constexpr auto kStreamTimeout = std::chrono::seconds(120);
+
+// Peak RSS growth over a section of code, in multiples of a payload size.
+// The baseline is taken after the caller has built its own payload, so a
+// value of 1.0 means the call held one extra payload-sized buffer at peak.
+class PeakMemoryProbe {
+public:
+  explicit PeakMemoryProbe(bool reset_supported) : reset_supported_(reset_supported) {}
+
+  void Begin() {
+    common::utils::MemoryUsage usage;
+    if (reset_supported_) common::utils::ResetPeakRss();
+    common::utils::ReadMemoryUsage(&usage);
+    baseline_ = usage.rss_bytes;
+  }
+
+  double End(uint64_t payload_bytes) const {
+    common::utils::MemoryUsage usage;
+    if (!reset_supported_ || payload_bytes == 0 ||
+        !common::utils::ReadMemoryUsage(&usage)) {
+      return 0.0;
+    }
+    uint64_t growth = usage.peak_rss_bytes > baseline_ ? usage.peak_rss_bytes - baseline_ : 0;
+    return static_cast<double>(growth) / payload_bytes;
+  }
+
+private:
+  bool reset_supported_;
+  uint64_t baseline_ = 0;
+};
+
+struct TransferStats {
+  bool ok = false;
+  int64_t duration_ns = 0;
+  int64_t first_byte_ns = 0;
+  uint64_t bytes = 0;
+  double peak_multiple = 0.0;
+};
+
+} // namespace
+
+// Moves payloads from 1 MB up to 1 GB three ways: as one unary Echo, as a
+// server stream of large_chunk_size chunks and as a client-streamed upload.
+// For each it reports throughput, time to first byte and peak RSS growth
+// as a multiple of the payload size, which exposes frameworks that copy
+// whole messages or refuse them past a size limit.
+class LargeMessageBenchmark : public BenchmarkScenario {
+public:
+  LargeMessageBenchmark() : BenchmarkScenario("Large Messages") {}
+
+  BenchmarkResults Run(
+      common::IBenchmarkClient* client,
+      const BenchmarkConfig& config) override {
+
+    BenchmarkResults results;
+    results.scenario_name = name_;
+    results.framework_name = "unknown";
+
+    std::vector<long> sizes;
+    if (!ParseSweepList(config.large_sizes, &sizes)) {
+      std::cerr << "Invalid large message sizes: " << config.large_sizes << std::endl;
+      return results;
+    }
+
+    if (!client->Connect(config.server_address)) {
+      std::cerr << "Failed to connect to server" << std::endl;
+      return results;
+    }
+
+    auto* service = client->GetService();
+    if (!service) {
+      std::cerr << "Failed to get service" << std::endl;
+      return results;
+    }
+
+    common::utils::MemoryUsage usage;
+    bool reset_supported = common::utils::ReadMemoryUsage(&usage) &&
+                           common::utils::ResetPeakRss();
+    if (!reset_supported) {
+      std::cerr << "Large messages: peak RSS reset unavailable, "
+                << "memory multiples not reported" << std::endl;
+    }
+    PeakMemoryProbe probe(reset_supported);
+
+    size_t chunk_size = std::max<size_t>(1, config.large_chunk_size);
+    int repeats = std::max(1, config.large_repeats);
+
+    ResultSeries table;
+    table.name = "Large message transfers";
+    table.columns = {"size_mb", "unary_ms", "unary_mbps", "unary_peak_x",
+                     "stream_ttfb_ms", "stream_mbps", "stream_peak_x",
+                     "upload_mbps", "upload_peak_x"};
+
+    auto run_start = common::utils::GetTimestampNanos();
+
+    for (long size_value : sizes) {
+      size_t size = static_cast<size_t>(size_value);
+      if (config.verbose) {
+        std::cout << "Transferring " << common::utils::FormatBytes(size) << std::endl;
+      }
+
+      // Unary: median of the repetitions
+      common::utils::LatencyStats unary_latency;
+      double unary_peak = 0.0;
+      for (int r = 0; r < repeats; r++) {
+        auto unary = RunUnary(service, size, &probe);
+        Account(&results, unary, 2 * size);
+        if (!unary.ok) break;
+        unary_latency.AddSample(unary.duration_ns);
+        results.latency_stats.AddSample(unary.duration_ns);
+        unary_peak = std::max(unary_peak, unary.peak_multiple);
+      }
+
+      auto stream = RunStream(service, size, chunk_size, &probe);
+      Account(&results, stream, size);
+      auto upload = RunUpload(service, size, chunk_size, &probe);
+      Account(&results, upload, size);
+
+      double unary_ns = static_cast<double>(unary_latency.GetP50());
+      table.rows.push_back({
+          size / 1048576.0,
+          unary_ns / 1e6,
+          unary_ns > 0 ? common::utils::CalculateThroughputMBps(
+              2 * size, static_cast<int64_t>(unary_ns)) : 0.0,
+          unary_peak,
+          stream.ok ? stream.first_byte_ns / 1e6 : 0.0,
+          stream.ok ? common::utils::CalculateThroughputMBps(
+              stream.bytes, stream.duration_ns) : 0.0,
+          stream.peak_multiple,
+          upload.ok ? common::utils::CalculateThroughputMBps(
+              upload.bytes, upload.duration_ns) : 0.0,
+          upload.peak_multiple});
+    }
+
+    results.total_duration_ns = common::utils::GetTimestampNanos() - run_start;
+    client->Disconnect();
+
+    results.ComputeDerivedMetrics();
+    results.custom_metrics.emplace_back("chunk_size_bytes", static_cast<double>(chunk_size));
+    results.custom_metrics.emplace_back("peak_rss_tracked", reset_supported ? 1.0 : 0.0);
+    results.series.push_back(table);
+    return results;
+  }
+
+private:
+  static void Account(BenchmarkResults* results, const TransferStats& stats,
+                      uint64_t expected_bytes) {
+    results->total_requests++;
+    if (stats.ok) {
+      results->successful_requests++;
+      results->total_bytes += expected_bytes;
+    } else {
+      results->failed_requests++;
+    }
+  }
+
+  TransferStats RunUnary(common::IBenchmarkService* service, size_t size,
+                         PeakMemoryProbe* probe) {
+    TransferStats stats;
+    common::utils::TrimHeap();
+
+    common::EchoRequest request;
+    request.message = common::payload::SharedText(size);
+    probe->Begin();
+
+    request.timestamp = common::utils::GetTimestampNanos();
+    auto start = common::utils::GetTimestampNanos();
+    auto result = service->Echo(request);
+    stats.duration_ns = common::utils::GetTimestampNanos() - start;
+
+    // A unary response arrives whole, so its first byte is its last
+    stats.first_byte_ns = stats.duration_ns;
+    stats.ok = result.ok() && result.value.message.size() == size;
+    stats.bytes = result.value.message.size();
+    stats.peak_multiple = probe->End(size);
+    if (!result.ok()) {
+      std::cerr << "Large messages: unary " << common::utils::FormatBytes(size)
+                << " failed: " << result.error_message << std::endl;
+    }
+    return stats;
+  }
+
+  TransferStats RunStream(common::IBenchmarkService* service, size_t size,
+                          size_t chunk_size, PeakMemoryProbe* probe) {
+    TransferStats stats;
+    common::utils::TrimHeap();
+
+    common::StreamRequest request;
+    request.chunk_size = static_cast<uint32_t>(std::min(size, chunk_size));
+    request.chunk_count = static_cast<uint32_t>(
+        (size + request.chunk_size - 1) / request.chunk_size);
+
+    auto received = std::make_shared<std::atomic<uint64_t>>(0);
+    auto first_byte = std::make_shared<std::atomic<int64_t>>(0);
+    auto done = std::make_shared<std::promise<common::ErrorCode>>();
+    auto status = done->get_future();
+    probe->Begin();
+
+    // Completion may arrive on a framework thread after StreamData returns
+    auto start = common::utils::GetTimestampNanos();
+    service->StreamData(
+        request,
+        [received, first_byte](const common::DataChunk& chunk) {
+          int64_t none = 0;
+          first_byte->compare_exchange_strong(none, common::utils::GetTimestampNanos());
+          *received += chunk.data.size();
+        },
+        [done](common::ErrorCode code, const std::string&) { done->set_value(code); });
+
+    if (status.wait_for(kStreamTimeout) != std::future_status::ready) {
+      std::cerr << "Large messages: stream timed out" << std::endl;
+      return stats;
+    }
+    stats.duration_ns = common::utils::GetTimestampNanos() - start;
+    stats.first_byte_ns = first_byte->load() > 0 ? first_byte->load() - start : 0;
+    stats.bytes = received->load();
+    stats.ok = status.get() == common::ErrorCode::OK &&
+               stats.bytes == static_cast<uint64_t>(request.chunk_size) * request.chunk_count;
+    stats.peak_multiple = probe->End(size);
+    return stats;
+  }
+
+  TransferStats RunUpload(common::IBenchmarkService* service, size_t size,
+                          size_t chunk_size, PeakMemoryProbe* probe) {
+    TransferStats stats;
+    common::utils::TrimHeap();
+
+    // One chunk buffer is reused for the whole upload. Checksum 0 skips
+    // the server's verify, so the upload measures copies and transport
+    // rather than the CRC.
+    common::DataChunk chunk;
+    chunk.data = common::payload::SharedBytes(std::min(size, chunk_size), 1);
+
+    auto done = std::make_shared<std::promise<common::Result<common::UploadResponse>>>();
+    auto status = done->get_future();
+    probe->Begin();
+
+    auto start = common::utils::GetTimestampNanos();
+    common::StreamCallback<common::DataChunk> sink;
+    service->UploadData(
+        sink,
+        [done](const common::Result<common::UploadResponse>& result) {
+          done->set_value(result);
+        });
+    if (!sink) {
+      std::cerr << "Large messages: service does not accept uploads" << std::endl;
+      return stats;
+    }
+
+    uint64_t sent = 0;
+    for (uint32_t seq = 0; sent < size; seq++) {
+      if (size - sent < chunk.data.size()) chunk.data.resize(size - sent);
+      chunk.sequence_number = seq;
+      chunk.timestamp = common::utils::GetTimestampNanos();
+      sink(chunk);
+      sent += chunk.data.size();
+    }
+    sink(common::DataChunk());
+
+    if (status.wait_for(kStreamTimeout) != std::future_status::ready) {
+      std::cerr << "Large messages: upload timed out" << std::endl;
+      return stats;
+    }
+    stats.duration_ns = common::utils::GetTimestampNanos() - start;
+    auto result = status.get();
+    stats.bytes = result.value.total_bytes;
+    stats.ok = result.ok() && result.value.checksum_valid && stats.bytes == size;
+    stats.peak_multiple = probe->End(size);
+    return stats;
+  }
+};
+
+std::unique_ptr<BenchmarkScenario> CreateLargeMessageBenchmark() {
+  return std::make_unique<LargeMessageBenchmark>();
+}
+
+} // namespace scenarios
+} // namespace benchmark
@@ -0,0 +1,372 @@
+#include "load_generator.h"
+#include "payload_generator.h"
+#include "resource_usage.h"
+#include <iostream>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <algorithm>
+#include <random>
+
+namespace benchmark {
+namespace scenarios {
+
+namespace {
+
+// Per-worker counters. The mutex also guards in_flight because pipelined
+// completions may run on a framework thread.
+struct WorkerState {
+  std::mutex mutex;
+  std::condition_variable cv;
+  int in_flight = 0;
+
+  common::utils::LatencyStats latency_stats;
+  uint64_t total_requests = 0;
+  uint64_t successful_requests = 0;
+  uint64_t failed_requests = 0;
+  uint64_t total_bytes = 0;
+};
+
+void RecordResult(
+    WorkerState* state,
+    const common::Result<common::EchoResponse>& result,
+    size_t request_bytes,
+    int64_t latency_ns) {
+  state->total_requests++;
+  if (result.ok()) {
+    state->latency_stats.AddSample(latency_ns);
+    state->successful_requests++;
+    state->total_bytes += request_bytes + result.value.message.size();
+  } else {
+    state->failed_requests++;
+  }
+}
+
+// Samples are only recorded once the warm-up deadline has passed
+void RunSyncWorker(
+    common::IBenchmarkService* service,
+    const std::string& message,
+    std::chrono::steady_clock::time_point measure_start,
+    std::chrono::steady_clock::time_point end_time,
+    WorkerState* state) {
+
+  uint32_t sequence_number = 0;
+  auto now = std::chrono::steady_clock::now();
+
+  while (now < end_time) {
+    bool measuring = now >= measure_start;
+
+    common::EchoRequest request;
+    request.message = message;
+    request.timestamp = common::utils::GetTimestampNanos();
+    request.sequence_number = sequence_number++;
+
+    auto call_start = common::utils::GetTimestampNanos();
+    auto result = service->Echo(request);
+    auto call_end = common::utils::GetTimestampNanos();
+
+    if (measuring) {
+      RecordResult(state, result, request.message.size(), call_end - call_start);
+    }
+    now = std::chrono::steady_clock::now();
+  }
+}
+
+void RunPipelinedWorker(
+    common::IBenchmarkService* service,
+    const std::string& message,
+    int pipeline_depth,
+    std::chrono::steady_clock::time_point measure_start,
+    std::chrono::steady_clock::time_point end_time,
+    const std::shared_ptr<WorkerState>& state) {
+
+  uint32_t sequence_number = 0;
+  auto now = std::chrono::steady_clock::now();
+
+  while (now < end_time) {
+    {
+      std::unique_lock<std::mutex> lock(state->mutex);
+      state->cv.wait(lock, [&] { return state->in_flight < pipeline_depth; });
+      state->in_flight++;
+    }
+
+    bool measuring = std::chrono::steady_clock::now() >= measure_start;
+
+    common::EchoRequest request;
+    request.message = message;
+    request.timestamp = common::utils::GetTimestampNanos();
+    request.sequence_number = sequence_number++;
+
+    size_t request_bytes = request.message.size();
+    auto call_start = common::utils::GetTimestampNanos();
+    service->EchoAsync(request,
+        [state, measuring, request_bytes, call_start](
+            const common::Result<common::EchoResponse>& result) {
+          auto call_end = common::utils::GetTimestampNanos();
+          {
+            std::lock_guard<std::mutex> lock(state->mutex);
+            if (measuring) {
+              RecordResult(state.get(), result, request_bytes,
+                           call_end - call_start);
+            }
+            state->in_flight--;
+          }
+          state->cv.notify_one();
+        });
+
+    now = std::chrono::steady_clock::now();
+  }
+
+  // Drain outstanding requests so their samples are counted
+  std::unique_lock<std::mutex> lock(state->mutex);
+  if (!state->cv.wait_for(lock, std::chrono::seconds(10),
+                          [&] { return state->in_flight == 0; })) {
+    std::cerr << "Load generator: " << state->in_flight
+              << " requests still outstanding after drain timeout" << std::endl;
+  }
+}
+
+// Issues requests at scheduled times until end_time. Latency is charged
+// from the scheduled time, not from when the call was actually made.
+void RunOpenLoopSender(
+    common::IBenchmarkService* service,
+    const std::string& message,
+    double interval_ns,
+    ArrivalProcess arrival,
+    uint32_t seed,
+    int max_outstanding,
+    std::chrono::steady_clock::time_point measure_start,
+    std::chrono::steady_clock::time_point end_time,
+    const std::shared_ptr<WorkerState>& state) {
+
+  using Clock = std::chrono::steady_clock;
+
+  std::mt19937_64 gen(seed);
+  std::exponential_distribution<double> exponential(1.0 / interval_ns);
+  auto next_interval = [&]() {
+    double ns = arrival == ArrivalProcess::kPoisson ? exponential(gen) : interval_ns;
+    return std::chrono::nanoseconds(static_cast<int64_t>(ns));
+  };
+
+  uint32_t sequence_number = 0;
+  auto scheduled = Clock::now() + next_interval();
+
+  while (scheduled < end_time) {
+    auto now = Clock::now();
+    if (now < scheduled) {
+      // Sleep for coarse waits and spin for the final stretch
+      auto remaining = scheduled - now;
+      if (remaining > std::chrono::microseconds(100)) {
+        std::this_thread::sleep_for(remaining - std::chrono::microseconds(50));
+      }
+      while (Clock::now() < scheduled) {
+      }
+    }
+
+    {
+      std::unique_lock<std::mutex> lock(state->mutex);
+      state->cv.wait(lock, [&] { return state->in_flight < max_outstanding; });
+      state->in_flight++;
+    }
+
+    bool measuring = scheduled >= measure_start;
+    auto scheduled_at = scheduled;
+
+    common::EchoRequest request;
+    request.message = message;
+    request.timestamp = common::utils::GetTimestampNanos();
+    request.sequence_number = sequence_number++;
+
+    size_t request_bytes = request.message.size();
+    service->EchoAsync(request,
+        [state, measuring, request_bytes, scheduled_at](
+            const common::Result<common::EchoResponse>& result) {
+          auto latency = std::chrono::duration_cast<std::chrono::nanoseconds>(
+              Clock::now() - scheduled_at).count();
+          {
+            std::lock_guard<std::mutex> lock(state->mutex);
+            if (measuring) {
+              RecordResult(state.get(), result, request_bytes, latency);
+            }
+            state->in_flight--;
+          }
+          state->cv.notify_one();
+        });
+
+    scheduled += next_interval();
+  }
+
+  std::unique_lock<std::mutex> lock(state->mutex);
+  if (!state->cv.wait_for(lock, std::chrono::seconds(10),
+                          [&] { return state->in_flight == 0; })) {
+    // Requests that never completed count against the run
+    state->total_requests += state->in_flight;
+    state->failed_requests += state->in_flight;
+    std::cerr << "Load generator: " << state->in_flight
+              << " requests still outstanding after drain timeout" << std::endl;
+  }
+}
+
+bool GetServices(
+    const std::vector<common::IBenchmarkClient*>& clients,
+    std::vector<common::IBenchmarkService*>* services) {
+  for (auto* client : clients) {
+    auto* service = client ? client->GetService() : nullptr;
+    if (!service) {
+      std::cerr << "Failed to get service" << std::endl;
+      return false;
+    }
+    services->push_back(service);
+  }
+  return !services->empty();
+}
+
+void MergeStates(
+    const std::vector<std::shared_ptr<WorkerState>>& states,
+    BenchmarkResults* results) {
+  for (const auto& state : states) {
+    std::lock_guard<std::mutex> lock(state->mutex);
+    results->latency_stats.Merge(state->latency_stats);
+    results->total_requests += state->total_requests;
+    results->successful_requests += state->successful_requests;
+    results->failed_requests += state->failed_requests;
+    results->total_bytes += state->total_bytes;
+  }
+}
+
+} // namespace
+
+BenchmarkResults RunEchoLoad(
+    const std::vector<common::IBenchmarkClient*>& clients,
+    const BenchmarkConfig& config) {
+
+  BenchmarkResults results;
+  results.framework_name = "unknown";  // Set by caller
+
+  results.message_size = config.message_size;
+
+  int threads_per_client = std::max(1, config.num_threads_per_client);
+  int pipeline_depth = std::max(1, config.pipeline_depth);
+  std::string test_message = common::payload::SharedText(config.message_size);
+
+  std::vector<common::IBenchmarkService*> services;
+  if (!GetServices(clients, &services)) {
+    return results;
+  }
+
+  if (config.verbose && config.warmup_seconds > 0) {
+    std::cout << "Warming up for " << config.warmup_seconds << " seconds..." << std::endl;
+  }
+
+  auto measure_start = std::chrono::steady_clock::now() +
+                       std::chrono::seconds(std::max(0, config.warmup_seconds));
+  auto end_time = measure_start + std::chrono::seconds(config.duration_seconds);
+
+  std::vector<std::shared_ptr<WorkerState>> states;
+  std::vector<std::thread> workers;
+
+  for (auto* service : services) {
+    for (int t = 0; t < threads_per_client; t++) {
+      auto state = std::make_shared<WorkerState>();
+      states.push_back(state);
+
+      if (pipeline_depth == 1) {
+        workers.emplace_back(RunSyncWorker, service, std::cref(test_message),
+                             measure_start, end_time, state.get());
+      } else {
+        workers.emplace_back(RunPipelinedWorker, service, std::cref(test_message),
+                             pipeline_depth, measure_start, end_time, state);
+      }
+    }
+  }
+
+  // Sample process CPU over the measured window only
+  std::this_thread::sleep_until(measure_start);
+  int64_t cpu_start = common::utils::ReadProcessCpuNanos();
+  int64_t server_cpu_start = config.server_cpu_nanos ? config.server_cpu_nanos() : -1;
+
+  for (auto& worker : workers) {
+    worker.join();
+  }
+
+  auto actual_end = std::chrono::steady_clock::now();
+  int64_t cpu_end = common::utils::ReadProcessCpuNanos();
+  int64_t server_cpu_end = server_cpu_start >= 0 ? config.server_cpu_nanos() : -1;
+  results.total_duration_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+      actual_end - measure_start
+  ).count();
+
+  MergeStates(states, &results);
+  results.ComputeDerivedMetrics();
+  if (cpu_start >= 0 && cpu_end >= cpu_start && results.total_duration_ns > 0) {
+    double cpu_ns = static_cast<double>(cpu_end - cpu_start);
+    results.avg_cpu_percent = 100.0 * cpu_ns / results.total_duration_ns;
+    if (results.total_requests > 0) {
+      results.cpu_us_per_request = cpu_ns / 1000.0 / results.total_requests;
+    }
+  }
+  if (server_cpu_start >= 0 && server_cpu_end >= server_cpu_start &&
+      results.total_duration_ns > 0) {
+    double cpu_ns = static_cast<double>(server_cpu_end - server_cpu_start);
+    results.server_cpu_percent = 100.0 * cpu_ns / results.total_duration_ns;
+    if (results.total_requests > 0) {
+      results.server_cpu_us_per_request = cpu_ns / 1000.0 / results.total_requests;
+    }
+  }
+  return results;
+}
+
+BenchmarkResults RunOpenLoopEcho(
+    const std::vector<common::IBenchmarkClient*>& clients,
+    const BenchmarkConfig& config,
+    const OpenLoopSpec& spec) {
+
+  BenchmarkResults results;
+  results.framework_name = "unknown";  // Set by caller
+  results.message_size = config.message_size;
+
+  std::vector<common::IBenchmarkService*> services;
+  if (!GetServices(clients, &services) || spec.target_rps <= 0.0) {
+    return results;
+  }
+
+  int threads_per_client = std::max(1, config.num_threads_per_client);
+  int total_threads = threads_per_client * static_cast<int>(services.size());
+  double interval_ns = 1e9 * total_threads / spec.target_rps;
+  std::string test_message = common::payload::SharedText(config.message_size);
+
+  auto measure_start = std::chrono::steady_clock::now() +
+                       std::chrono::seconds(std::max(0, config.warmup_seconds));
+  auto end_time = measure_start + std::chrono::seconds(config.duration_seconds);
+
+  std::vector<std::shared_ptr<WorkerState>> states;
+  std::vector<std::thread> workers;
+
+  for (auto* service : services) {
+    for (int t = 0; t < threads_per_client; t++) {
+      auto state = std::make_shared<WorkerState>();
+      states.push_back(state);
+      uint32_t seed = spec.seed + static_cast<uint32_t>(workers.size());
+      workers.emplace_back(RunOpenLoopSender, service, std::cref(test_message),
+                           interval_ns, spec.arrival, seed, spec.max_outstanding,
+                           measure_start, end_time, state);
+    }
+  }
+
+  for (auto& worker : workers) {
+    worker.join();
+  }
+
+  // The measured window is the schedule, not the time it took to drain it
+  results.total_duration_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+      end_time - measure_start
+  ).count();
+
+  MergeStates(states, &results);
+  results.ComputeDerivedMetrics();
+  results.custom_metrics.emplace_back("offered_rps", spec.target_rps);
+  return results;
+}
+
+} // namespace scenarios
+} // namespace benchmark
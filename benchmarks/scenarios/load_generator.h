@@ -0,0 +1,49 @@
+#pragma once
+
+#include "benchmark_scenario.h"
+#include <vector>
+
+namespace benchmark {
+namespace scenarios {
+
+// Closed-loop echo load generator shared by the echo scenario and the
+// parameter sweep.
+//
+// Every client gets config.num_threads_per_client worker threads. Each
+// worker keeps config.pipeline_depth requests outstanding: a depth of 1
+// issues synchronous Echo calls, larger depths use EchoAsync and issue a
+// new request whenever one completes. The clients must already be
+// connected; they are not disconnected afterwards.
+BenchmarkResults RunEchoLoad(
+    const std::vector<common::IBenchmarkClient*>& clients,
+    const BenchmarkConfig& config);
+
+// Inter-arrival distribution for open-loop load
+enum class ArrivalProcess {
+  kUniform,  // Fixed interval between sends
+  kPoisson   // Exponentially distributed intervals
+};
+
+struct OpenLoopSpec {
+  double target_rps = 1000.0;
+  ArrivalProcess arrival = ArrivalProcess::kPoisson;
+  uint32_t seed = 1;
+
+  // Per-thread cap on outstanding requests; once reached, sending waits
+  // and the wait shows up as latency of the delayed requests
+  int max_outstanding = 1024;
+};
+
+// Open-loop echo load generator. Requests are issued on a schedule that
+// does not depend on response times, split evenly across
+// config.num_threads_per_client threads per client. Latency is measured
+// from the scheduled send time, so a service that falls behind is charged
+// for the queueing delay instead of hiding it (no coordinated omission).
+// The offered rate is reported as the "offered_rps" custom metric.
+BenchmarkResults RunOpenLoopEcho(
+    const std::vector<common::IBenchmarkClient*>& clients,
+    const BenchmarkConfig& config,
+    const OpenLoopSpec& spec);
+
+} // namespace scenarios
+} // namespace benchmark
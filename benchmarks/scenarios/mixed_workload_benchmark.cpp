@@ -0,0 +1,302 @@
+#include "benchmark_scenario.h"
+#include "payload_generator.h"
+#include "size_distribution.h"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <future>
+#include <iostream>
+#include <sstream>
+#include <thread>
+
+namespace benchmark {
+namespace scenarios {
+
+namespace {
+
+enum Operation { kEcho = 0, kBatch = 1, kStream = 2, kOperationCount = 3 };
+
+const char* const kOperationNames[kOperationCount] = {"echo", "batch", "stream"};
+const char* const kOperationTitles[kOperationCount] = {"Echo", "BatchProcess", "StreamData"};
+
+// Batch requests spread their payload over this many items and streams
+// never use chunks larger than kMaxChunkSize
+constexpr size_t kBatchItems = 8;
+constexpr size_t kMaxChunkSize = 64 * 1024;
+
+struct OperationStats {
+  common::utils::LatencyStats latency_stats;
+  uint64_t successful = 0;
+  uint64_t failed = 0;
+  uint64_t bytes = 0;
+};
+
+using ThreadStats = std::array<OperationStats, kOperationCount>;
+
+// Parse "echo=80,batch=15,stream=5"; omitted operations get weight 0
+bool ParseMix(const std::string& text, std::array<double, kOperationCount>* weights) {
+  weights->fill(0.0);
+  std::istringstream stream(text);
+  std::string item;
+  while (std::getline(stream, item, ',')) {
+    auto eq = item.find('=');
+    if (eq == std::string::npos) return false;
+
+    std::string name = item.substr(0, eq);
+    double weight = 0.0;
+    try {
+      weight = std::stod(item.substr(eq + 1));
+    } catch (const std::exception&) {
+      return false;
+    }
+    if (weight < 0.0) return false;
+
+    auto it = std::find(std::begin(kOperationNames), std::end(kOperationNames), name);
+    if (it == std::end(kOperationNames)) return false;
+    (*weights)[it - std::begin(kOperationNames)] = weight;
+  }
+
+  double total = (*weights)[kEcho] + (*weights)[kBatch] + (*weights)[kStream];
+  return total > 0.0;
+}
+
+} // namespace
+
+// Runs a weighted blend of Echo, BatchProcess and StreamData calls from
+// several threads at once, with payload sizes drawn from a configurable
+// distribution, and reports latency separately for each operation type so
+// interference between large and small requests is visible.
+class MixedWorkloadBenchmark : public BenchmarkScenario {
+public:
+  MixedWorkloadBenchmark() : BenchmarkScenario("Mixed Workload") {}
+
+  BenchmarkResults Run(
+      common::IBenchmarkClient* client,
+      const BenchmarkConfig& config) override {
+
+    BenchmarkResults results;
+    results.scenario_name = name_;
+    results.framework_name = "unknown";
+
+    std::array<double, kOperationCount> weights;
+    if (!ParseMix(config.workload_mix, &weights)) {
+      std::cerr << "Invalid workload mix: " << config.workload_mix << std::endl;
+      return results;
+    }
+
+    std::string spec = config.size_distribution.empty()
+        ? "fixed:" + std::to_string(config.message_size)
+        : config.size_distribution;
+    std::string error;
+    auto sizes = ParseSizeDistribution(spec, &error);
+    if (!sizes) {
+      std::cerr << "Mixed workload: " << error << std::endl;
+      return results;
+    }
+
+    if (!client->Connect(config.server_address)) {
+      std::cerr << "Failed to connect to server" << std::endl;
+      return results;
+    }
+
+    auto* service = client->GetService();
+    if (!service) {
+      std::cerr << "Failed to get service" << std::endl;
+      return results;
+    }
+
+    if (config.verbose) {
+      std::cout << "Mix: " << config.workload_mix
+                << ", sizes: " << sizes->Describe() << std::endl;
+    }
+
+    // Shared read-only payload sources; requests copy slices of these
+    echo_payload_ = common::payload::SharedText(sizes->MaxSize());
+    if (const auto* generator = common::payload::PayloadGenerator::Shared()) {
+      batch_payload_ = generator->MakeBytes(sizes->MaxSize() + kBatchItems, 1);
+    } else {
+      batch_payload_.assign(sizes->MaxSize() + kBatchItems, 0x5a);
+    }
+
+    // With a single worker the operations would only ever run back to back,
+    // so there is at least one worker per weighted operation, and never fewer
+    // than two, for large calls to interfere with small ones
+    int weighted = static_cast<int>(std::count_if(
+        weights.begin(), weights.end(), [](double weight) { return weight > 0.0; }));
+    int num_threads = std::max({2, weighted, config.num_threads_per_client});
+    auto measure_start = std::chrono::steady_clock::now() +
+                         std::chrono::seconds(std::max(0, config.warmup_seconds));
+    auto end_time = measure_start + std::chrono::seconds(config.duration_seconds);
+
+    std::vector<ThreadStats> thread_stats(num_threads);
+    std::vector<std::thread> workers;
+    for (int t = 0; t < num_threads; t++) {
+      workers.emplace_back([&, t]() {
+        RunWorker(service, *sizes, weights, 0x9e3779b9u + t,
+                  measure_start, end_time, &thread_stats[t]);
+      });
+    }
+    for (auto& worker : workers) {
+      worker.join();
+    }
+
+    results.total_duration_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - measure_start).count();
+
+    client->Disconnect();
+
+    for (int op = 0; op < kOperationCount; op++) {
+      OperationStats merged;
+      for (const auto& stats : thread_stats) {
+        merged.latency_stats.Merge(stats[op].latency_stats);
+        merged.successful += stats[op].successful;
+        merged.failed += stats[op].failed;
+        merged.bytes += stats[op].bytes;
+      }
+
+      results.latency_stats.Merge(merged.latency_stats);
+      results.successful_requests += merged.successful;
+      results.failed_requests += merged.failed;
+      results.total_bytes += merged.bytes;
+
+      std::string prefix = kOperationNames[op];
+      const auto& latency = merged.latency_stats;
+      results.custom_metrics.emplace_back(prefix + "_count",
+                                          static_cast<double>(latency.GetCount()));
+      results.custom_metrics.emplace_back(prefix + "_failed",
+                                          static_cast<double>(merged.failed));
+      results.custom_metrics.emplace_back(prefix + "_p50_us", latency.GetP50() / 1000.0);
+      results.custom_metrics.emplace_back(prefix + "_p99_us", latency.GetP99() / 1000.0);
+      results.custom_metrics.emplace_back(prefix + "_p999_us",
+                                          latency.GetPercentile(0.999) / 1000.0);
+      results.custom_metrics.emplace_back(prefix + "_max_us", latency.GetMax() / 1000.0);
+
+      if (latency.GetCount() > 0) {
+        ResultSeries histogram;
+        histogram.name = std::string(kOperationTitles[op]) + " latency histogram";
+        histogram.columns = {"upper_us", "count"};
+        for (const auto& bucket : latency.GetHistogram()) {
+          histogram.rows.push_back({bucket.first / 1000.0,
+                                    static_cast<double>(bucket.second)});
+        }
+        results.series.push_back(histogram);
+      }
+    }
+
+    results.total_requests = results.successful_requests + results.failed_requests;
+    results.ComputeDerivedMetrics();
+    return results;
+  }
+
+private:
+  void RunWorker(
+      common::IBenchmarkService* service,
+      const SizeDistribution& sizes,
+      const std::array<double, kOperationCount>& weights,
+      uint32_t seed,
+      std::chrono::steady_clock::time_point measure_start,
+      std::chrono::steady_clock::time_point end_time,
+      ThreadStats* stats) {
+
+    std::mt19937_64 gen(seed);
+    std::discrete_distribution<int> pick(weights.begin(), weights.end());
+    uint32_t sequence_number = 0;
+
+    auto now = std::chrono::steady_clock::now();
+    while (now < end_time) {
+      bool measuring = now >= measure_start;
+      int op = pick(gen);
+      size_t size = sizes.Sample(gen);
+
+      uint64_t bytes = 0;
+      auto call_start = common::utils::GetTimestampNanos();
+      bool ok = false;
+      switch (op) {
+        case kEcho:
+          ok = CallEcho(service, size, sequence_number++, &bytes);
+          break;
+        case kBatch:
+          ok = CallBatch(service, size, &bytes);
+          break;
+        case kStream:
+          ok = CallStream(service, size, &bytes);
+          break;
+      }
+      auto call_end = common::utils::GetTimestampNanos();
+
+      if (measuring) {
+        auto& op_stats = (*stats)[op];
+        if (ok) {
+          op_stats.latency_stats.AddSample(call_end - call_start);
+          op_stats.successful++;
+          op_stats.bytes += bytes;
+        } else {
+          op_stats.failed++;
+        }
+      }
+      now = std::chrono::steady_clock::now();
+    }
+  }
+
+  bool CallEcho(common::IBenchmarkService* service, size_t size,
+                uint32_t sequence_number, uint64_t* bytes) {
+    common::EchoRequest request;
+    request.message.assign(echo_payload_, 0, size);
+    request.timestamp = common::utils::GetTimestampNanos();
+    request.sequence_number = sequence_number;
+
+    auto result = service->Echo(request);
+    *bytes = request.message.size() + result.value.message.size();
+    return result.ok();
+  }
+
+  bool CallBatch(common::IBenchmarkService* service, size_t size, uint64_t* bytes) {
+    size_t item_size = std::max<size_t>(1, size / kBatchItems);
+
+    common::BatchRequest request;
+    request.items.resize(kBatchItems);
+    for (size_t i = 0; i < kBatchItems; i++) {
+      request.items[i].id = std::to_string(i);
+      request.items[i].operation = "echo";
+      auto slice = batch_payload_.begin() + i * item_size;
+      request.items[i].data.assign(slice, slice + item_size);
+    }
+
+    auto result = service->BatchProcess(request);
+    *bytes = kBatchItems * item_size;
+    for (const auto& item : result.value.results) {
+      *bytes += item.result_data.size();
+    }
+    return result.ok() && result.value.total_failed == 0;
+  }
+
+  bool CallStream(common::IBenchmarkService* service, size_t size, uint64_t* bytes) {
+    common::StreamRequest request;
+    request.chunk_size = static_cast<uint32_t>(std::min(size, kMaxChunkSize));
+    request.chunk_count = static_cast<uint32_t>(
+        (size + request.chunk_size - 1) / request.chunk_size);
+
+    // Completion may arrive on a framework thread after StreamData returns
+    auto received = std::make_shared<std::atomic<uint64_t>>(0);
+    auto done = std::make_shared<std::promise<common::ErrorCode>>();
+    auto status = done->get_future();
+    service->StreamData(
+        request,
+        [received](const common::DataChunk& chunk) { *received += chunk.data.size(); },
+        [done](common::ErrorCode code, const std::string&) { done->set_value(code); });
+
+    bool ok = status.get() == common::ErrorCode::OK;
+    *bytes = received->load();
+    return ok;
+  }
+
+  std::string echo_payload_;
+  std::vector<uint8_t> batch_payload_;
+};
+
+std::unique_ptr<BenchmarkScenario> CreateMixedWorkloadBenchmark() {
+  return std::make_unique<MixedWorkloadBenchmark>();
+}
+
+} // namespace scenarios
+} // namespace benchmark
@@ -0,0 +1,312 @@
+#include "parameter_sweep.h"
+#include "load_generator.h"
+#include <algorithm>
+#include <iostream>
+#include <iomanip>
+#include <memory>
+#include <numeric>
+#include <random>
+#include <sstream>
+
+namespace benchmark {
+namespace scenarios {
+
+namespace {
+
+// Integer with an optional binary K / M / G suffix ("64K" = 65536)
+bool ParseNumber(const std::string& text, long* value) {
+  if (text.empty()) return false;
+
+  long multiplier = 1;
+  std::string digits = text;
+  switch (text.back()) {
+    case 'K': case 'k': multiplier = 1L << 10; break;
+    case 'M': case 'm': multiplier = 1L << 20; break;
+    case 'G': case 'g': multiplier = 1L << 30; break;
+    default: break;
+  }
+  if (multiplier != 1) digits.pop_back();
+  if (digits.empty()) return false;
+
+  try {
+    size_t consumed = 0;
+    *value = std::stol(digits, &consumed) * multiplier;
+    return consumed == digits.size();
+  } catch (const std::exception&) {
+    return false;
+  }
+}
+
+std::vector<std::string> Split(const std::string& text, char separator) {
+  std::vector<std::string> parts;
+  std::string part;
+  std::istringstream stream(text);
+  while (std::getline(stream, part, separator)) {
+    parts.push_back(part);
+  }
+  return parts;
+}
+
+bool ParseRange(const std::string& item, std::vector<long>* values) {
+  auto parts = Split(item, ':');
+  if (parts.size() < 2 || parts.size() > 3) return false;
+
+  long start = 0;
+  long end = 0;
+  if (!ParseNumber(parts[0], &start) || !ParseNumber(parts[1], &end)) {
+    return false;
+  }
+
+  std::string step = parts.size() == 3 ? parts[2] : "x2";
+  if (step.size() < 2) return false;
+
+  long amount = 0;
+  if (!ParseNumber(step.substr(1), &amount)) return false;
+
+  // Stop before a step would overflow past `end`
+  if (step[0] == '+') {
+    if (amount < 1) return false;
+    for (long v = start; v <= end; v += amount) {
+      values->push_back(v);
+      if (v > end - amount) break;
+    }
+  } else if (step[0] == 'x' || step[0] == '*') {
+    if (amount < 2 || start < 1) return false;
+    for (long v = start; v <= end; v *= amount) {
+      values->push_back(v);
+      if (v > end / amount) break;
+    }
+  } else {
+    return false;
+  }
+  return true;
+}
+
+// Latin-hypercube selection of dimension indices: each dimension is split
+// into `samples` strata and every stratum is used exactly once
+std::vector<std::vector<size_t>> LatinHypercube(
+    const std::vector<size_t>& dimension_sizes, int samples, uint32_t seed) {
+
+  std::mt19937 gen(seed);
+  std::uniform_real_distribution<double> jitter(0.0, 1.0);
+  std::vector<std::vector<size_t>> rows(samples,
+                                        std::vector<size_t>(dimension_sizes.size()));
+
+  for (size_t d = 0; d < dimension_sizes.size(); d++) {
+    std::vector<int> strata(samples);
+    std::iota(strata.begin(), strata.end(), 0);
+    std::shuffle(strata.begin(), strata.end(), gen);
+
+    for (int i = 0; i < samples; i++) {
+      double u = (strata[i] + jitter(gen)) / samples;
+      size_t index = static_cast<size_t>(u * dimension_sizes[d]);
+      rows[i][d] = std::min(index, dimension_sizes[d] - 1);
+    }
+  }
+  return rows;
+}
+
+std::string CsvQuote(const std::string& text) {
+  std::string quoted = "\"";
+  for (char c : text) {
+    if (c == '"') quoted += '"';
+    quoted += c;
+  }
+  quoted += '"';
+  return quoted;
+}
+
+} // namespace
+
+bool ParseSweepList(const std::string& text, std::vector<long>* values) {
+  std::vector<long> parsed;
+  for (const auto& item : Split(text, ',')) {
+    if (item.find(':') != std::string::npos) {
+      if (!ParseRange(item, &parsed)) return false;
+    } else {
+      long value = 0;
+      if (!ParseNumber(item, &value)) return false;
+      parsed.push_back(value);
+    }
+  }
+
+  if (parsed.empty()) return false;
+  for (long v : parsed) {
+    if (v < 1) return false;
+  }
+
+  std::sort(parsed.begin(), parsed.end());
+  parsed.erase(std::unique(parsed.begin(), parsed.end()), parsed.end());
+  *values = parsed;
+  return true;
+}
+
+std::vector<SweepPoint> BuildSweepPoints(const SweepSpec& spec) {
+  auto make_point = [&spec](size_t s, size_t c, size_t t, size_t p) {
+    SweepPoint point;
+    point.message_size = static_cast<size_t>(spec.message_sizes[s]);
+    point.num_clients = static_cast<int>(spec.client_counts[c]);
+    point.num_threads_per_client = static_cast<int>(spec.thread_counts[t]);
+    point.pipeline_depth = static_cast<int>(spec.pipeline_depths[p]);
+    return point;
+  };
+
+  std::vector<SweepPoint> points;
+
+  if (spec.lhs_samples <= 0) {
+    for (size_t s = 0; s < spec.message_sizes.size(); s++)
+      for (size_t c = 0; c < spec.client_counts.size(); c++)
+        for (size_t t = 0; t < spec.thread_counts.size(); t++)
+          for (size_t p = 0; p < spec.pipeline_depths.size(); p++)
+            points.push_back(make_point(s, c, t, p));
+    return points;
+  }
+
+  auto rows = LatinHypercube(
+      {spec.message_sizes.size(), spec.client_counts.size(),
+       spec.thread_counts.size(), spec.pipeline_depths.size()},
+      spec.lhs_samples, spec.seed);
+
+  // Small dimensions can map several strata onto the same grid point
+  std::sort(rows.begin(), rows.end());
+  rows.erase(std::unique(rows.begin(), rows.end()), rows.end());
+
+  for (const auto& row : rows) {
+    points.push_back(make_point(row[0], row[1], row[2], row[3]));
+  }
+  return points;
+}
+
+ParameterSweep::ParameterSweep(
+    const SweepSpec& spec, const BenchmarkConfig& base_config)
+  : spec_(spec),
+    base_config_(base_config),
+    points_(BuildSweepPoints(spec)) {}
+
+void ParameterSweep::Run(
+    common::IFrameworkFactory* factory, std::vector<SweepCell>* cells) {
+
+  std::vector<std::unique_ptr<common::IBenchmarkClient>> pool;
+
+  for (size_t i = 0; i < points_.size(); i++) {
+    const auto& point = points_[i];
+    std::cout << "  Sweep point " << (i + 1) << "/" << points_.size()
+              << ": size=" << point.message_size
+              << " clients=" << point.num_clients
+              << " threads=" << point.num_threads_per_client
+              << " depth=" << point.pipeline_depth << std::endl;
+
+    // Reuse pooled connections; only points that needed a new or
+    // re-established connection pay the warm-up again
+    bool all_warm = true;
+    bool connect_failed = false;
+
+    while (static_cast<int>(pool.size()) < point.num_clients) {
+      pool.push_back(factory->CreateClient());
+      all_warm = false;
+    }
+
+    std::vector<common::IBenchmarkClient*> clients;
+    for (int c = 0; c < point.num_clients; c++) {
+      auto* client = pool[c].get();
+      if (!client) {
+        connect_failed = true;
+        break;
+      }
+      if (!client->IsConnected()) {
+        all_warm = false;
+        if (!client->Connect(base_config_.server_address)) {
+          connect_failed = true;
+          break;
+        }
+      }
+      clients.push_back(client);
+    }
+
+    if (connect_failed) {
+      std::cerr << "    Failed to connect client, skipping point" << std::endl;
+      continue;
+    }
+
+    BenchmarkConfig config = base_config_;
+    config.message_size = point.message_size;
+    config.num_clients = point.num_clients;
+    config.num_threads_per_client = point.num_threads_per_client;
+    config.pipeline_depth = point.pipeline_depth;
+    if (all_warm && !spec_.rewarm_each_point) {
+      config.warmup_seconds = 0;
+    }
+
+    SweepCell cell;
+    cell.framework_name = factory->GetName();
+    cell.point = point;
+    cell.results = RunEchoLoad(clients, config);
+    cell.results.scenario_name = "Echo Sweep";
+    cell.results.framework_name = cell.framework_name;
+
+    if (base_config_.verbose) {
+      cell.results.Print();
+    }
+
+    cells->push_back(std::move(cell));
+  }
+
+  for (auto& client : pool) {
+    if (client && client->IsConnected()) {
+      client->Disconnect();
+    }
+  }
+}
+
+std::string ParameterSweep::ToJSON(const std::vector<SweepCell>& cells) {
+  std::ostringstream json;
+  json << "[\n";
+  for (size_t i = 0; i < cells.size(); i++) {
+    const auto& cell = cells[i];
+    json << "{\n";
+    json << "\"framework\": \"" << cell.framework_name << "\",\n";
+    json << "\"message_size\": " << cell.point.message_size << ",\n";
+    json << "\"num_clients\": " << cell.point.num_clients << ",\n";
+    json << "\"threads_per_client\": " << cell.point.num_threads_per_client << ",\n";
+    json << "\"pipeline_depth\": " << cell.point.pipeline_depth << ",\n";
+    json << "\"results\": " << cell.results.ToJSON() << "\n";
+    json << "}" << (i + 1 < cells.size() ? "," : "") << "\n";
+  }
+  json << "]\n";
+  return json.str();
+}
+
+std::string ParameterSweep::ToCSV(const std::vector<SweepCell>& cells) {
+  std::ostringstream csv;
+  csv << std::fixed << std::setprecision(2);
+  csv << "framework,message_size,num_clients,threads_per_client,pipeline_depth,"
+      << "requests_per_second,throughput_mbps,mean_ns,p50_ns,p95_ns,p99_ns,"
+      << "max_ns,successful_requests,failed_requests,cpu_percent,cpu_us_per_request,"
+      << "server_cpu_percent,server_cpu_us_per_request\n";
+
+  for (const auto& cell : cells) {
+    const auto& r = cell.results;
+    csv << CsvQuote(cell.framework_name) << ","
+        << cell.point.message_size << ","
+        << cell.point.num_clients << ","
+        << cell.point.num_threads_per_client << ","
+        << cell.point.pipeline_depth << ","
+        << r.requests_per_second << ","
+        << r.throughput_mbps << ","
+        << static_cast<int64_t>(r.latency_stats.GetMean()) << ","
+        << r.latency_stats.GetP50() << ","
+        << r.latency_stats.GetP95() << ","
+        << r.latency_stats.GetP99() << ","
+        << r.latency_stats.GetMax() << ","
+        << r.successful_requests << ","
+        << r.failed_requests << ","
+        << r.avg_cpu_percent << ","
+        << r.cpu_us_per_request << ","
+        << r.server_cpu_percent << ","
+        << r.server_cpu_us_per_request << "\n";
+  }
+  return csv.str();
+}
+
+} // namespace scenarios
+} // namespace benchmark
@@ -0,0 +1,72 @@
+#pragma once
+
+#include "benchmark_scenario.h"
+#include <string>
+#include <vector>
+
+namespace benchmark {
+namespace scenarios {
+
+// One point of the message size x concurrency grid
+struct SweepPoint {
+  size_t message_size = 1024;
+  int num_clients = 1;
+  int num_threads_per_client = 1;
+  int pipeline_depth = 1;
+};
+
+// Dimensions of a sweep. Every dimension must have at least one value.
+struct SweepSpec {
+  std::vector<long> message_sizes = {1024};
+  std::vector<long> client_counts = {1};
+  std::vector<long> thread_counts = {1};
+  std::vector<long> pipeline_depths = {1};
+
+  // 0 runs the full Cartesian product, otherwise this many points are
+  // drawn from the grid with Latin-hypercube sampling
+  int lhs_samples = 0;
+  uint32_t seed = 1;
+
+  // Repeat the warm-up for points whose clients are already warm
+  bool rewarm_each_point = false;
+};
+
+// Measured results for a single framework at a single grid point
+struct SweepCell {
+  std::string framework_name;
+  SweepPoint point;
+  BenchmarkResults results;
+};
+
+// Parse a sweep dimension such as "64,256,1024", "1:16" or "64:65536:x4".
+// Ranges are inclusive and take an optional "+N" (arithmetic) or "xN"
+// (geometric) step; the default step is x2. Items may be mixed, e.g.
+// "1,2,4:64:x2". Values take an optional binary K/M/G suffix, e.g.
+// "1M:1G:x4". Returns false on malformed input.
+bool ParseSweepList(const std::string& text, std::vector<long>* values);
+
+// Expand a spec into the list of points to run
+std::vector<SweepPoint> BuildSweepPoints(const SweepSpec& spec);
+
+// Runs every sweep point against a framework factory in one process.
+// Connected clients are pooled per factory and reused across points so
+// that each connection only pays its warm-up once.
+class ParameterSweep {
+public:
+  ParameterSweep(const SweepSpec& spec, const BenchmarkConfig& base_config);
+
+  // Run all points against one framework and append the cells
+  void Run(common::IFrameworkFactory* factory, std::vector<SweepCell>* cells);
+
+  // Export the grid as a JSON array of cells or as one CSV row per cell
+  static std::string ToJSON(const std::vector<SweepCell>& cells);
+  static std::string ToCSV(const std::vector<SweepCell>& cells);
+
+private:
+  SweepSpec spec_;
+  BenchmarkConfig base_config_;
+  std::vector<SweepPoint> points_;
+};
+
+} // namespace scenarios
+} // namespace benchmark
@@ -0,0 +1,225 @@
+#include "server_process.h"
+#include "benchmark_utils.h"
+#include "reference_service.h"
+#include "resource_usage.h"
+#include "work_stealing_executor.h"
+#include <cerrno>
+#include <csignal>
+#include <fcntl.h>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace benchmark {
+namespace scenarios {
+
+namespace {
+
+// Control messages are short lines, so a byte at a time is fine
+bool ReadLine(int fd, std::string* line) {
+  line->clear();
+  char c = 0;
+  while (true) {
+    ssize_t n = ::read(fd, &c, 1);
+    if (n < 0 && errno == EINTR) continue;
+    if (n <= 0) return false;
+    if (c == '\n') return true;
+    line->push_back(c);
+  }
+}
+
+bool WriteLine(int fd, const std::string& line) {
+  std::string data = line + "\n";
+  size_t written = 0;
+  while (written < data.size()) {
+    ssize_t n = ::write(fd, data.data() + written, data.size() - written);
+    if (n < 0 && errno == EINTR) continue;
+    if (n <= 0) return false;
+    written += static_cast<size_t>(n);
+  }
+  return true;
+}
+
+std::string FormatUsage() {
+  common::utils::MemoryUsage memory;
+  common::utils::ReadMemoryUsage(&memory);
+  return std::to_string(common::utils::ReadProcessCpuNanos()) + " " +
+         std::to_string(memory.peak_rss_bytes);
+}
+
+std::unique_ptr<common::IBenchmarkServer> StartServer(
+    common::IFrameworkFactory* factory, const std::string& address,
+    const std::vector<int>& cpus, bool handler_pool) {
+  if (!cpus.empty() && !common::utils::PinToCpus(cpus)) {
+    std::cerr << "Warning: could not pin the server to the requested CPUs" << std::endl;
+  }
+  auto server = factory->CreateServer(MakeReferenceService(handler_pool));
+  if (!server || !server->Start(address)) {
+    std::cerr << "Error: could not start a " << factory->GetName() << " server at "
+              << address << std::endl;
+    return nullptr;
+  }
+  return server;
+}
+
+// Body of the forked child: serve and answer commands until told to stop
+// or the runner goes away
+int RunChild(common::IFrameworkFactory* factory, const std::string& address,
+             const std::vector<int>& cpus, bool handler_pool, int command_fd, int reply_fd) {
+  auto server = StartServer(factory, address, cpus, handler_pool);
+  if (!server) {
+    WriteLine(reply_fd, "failed");
+    return 1;
+  }
+  common::utils::ResetPeakRss();
+  WriteLine(reply_fd, "ready");
+
+  std::string command;
+  while (ReadLine(command_fd, &command)) {
+    if (command == "usage") {
+      WriteLine(reply_fd, FormatUsage());
+    } else if (command == "reset") {
+      WriteLine(reply_fd, common::utils::ResetPeakRss() ? "ok" : "unsupported");
+    } else if (command == "stop") {
+      break;
+    } else {
+      WriteLine(reply_fd, "unknown");
+    }
+  }
+
+  server->Stop();
+  WriteLine(reply_fd, "stopped");
+  return 0;
+}
+
+} // namespace
+
+std::shared_ptr<common::IBenchmarkService> MakeReferenceService(bool handler_pool) {
+  return std::make_shared<reference::ReferenceServiceImpl>(
+      handler_pool ? &common::WorkStealingExecutor::Shared() : nullptr);
+}
+
+ServerProcess::~ServerProcess() {
+  Stop();
+}
+
+bool ServerProcess::Start(common::IFrameworkFactory* factory, const std::string& address,
+                          const std::vector<int>& cpus, bool handler_pool) {
+  int commands[2];
+  int replies[2];
+  if (::pipe2(commands, O_CLOEXEC) != 0) return false;
+  if (::pipe2(replies, O_CLOEXEC) != 0) {
+    ::close(commands[0]);
+    ::close(commands[1]);
+    return false;
+  }
+
+  // A child that died must not kill the runner on its next command
+  ::signal(SIGPIPE, SIG_IGN);
+
+  // Output buffered before the fork would otherwise be written twice
+  std::cout.flush();
+  std::cerr.flush();
+
+  pid_t pid = ::fork();
+  if (pid < 0) {
+    for (int fd : {commands[0], commands[1], replies[0], replies[1]}) ::close(fd);
+    return false;
+  }
+  if (pid == 0) {
+    ::close(commands[1]);
+    ::close(replies[0]);
+    int code = RunChild(factory, address, cpus, handler_pool, commands[0], replies[1]);
+    std::cout.flush();
+    std::cerr.flush();
+    ::_exit(code);
+  }
+
+  ::close(commands[0]);
+  ::close(replies[1]);
+  pid_ = pid;
+  command_fd_ = commands[1];
+  reply_fd_ = replies[0];
+
+  std::string status;
+  if (!ReadLine(reply_fd_, &status) || status != "ready") {
+    Stop();
+    return false;
+  }
+  return true;
+}
+
+bool ServerProcess::Request(const std::string& command, std::string* reply) {
+  return command_fd_ >= 0 && WriteLine(command_fd_, command) && ReadLine(reply_fd_, reply);
+}
+
+bool ServerProcess::Sample(ServerUsage* usage) {
+  std::string reply;
+  if (!Request("usage", &reply)) return false;
+  std::istringstream fields(reply);
+  return static_cast<bool>(fields >> usage->cpu_ns >> usage->peak_rss_bytes);
+}
+
+bool ServerProcess::ResetPeak() {
+  std::string reply;
+  return Request("reset", &reply) && reply == "ok";
+}
+
+void ServerProcess::Stop() {
+  if (pid_ < 0) return;
+
+  // Wait for the server to shut down before reaping, so the next server
+  // can bind the same address
+  std::string reply;
+  if (WriteLine(command_fd_, "stop")) {
+    ReadLine(reply_fd_, &reply);
+  }
+  ::close(command_fd_);
+  ::close(reply_fd_);
+  command_fd_ = -1;
+  reply_fd_ = -1;
+
+  int status = 0;
+  while (::waitpid(pid_, &status, 0) < 0 && errno == EINTR) {
+  }
+  pid_ = -1;
+}
+
+int ServeUntilSignal(common::IFrameworkFactory* factory, const std::string& address,
+                     const std::vector<int>& cpus, bool handler_pool) {
+  // Block the signals before any server thread exists so that all of them
+  // inherit the mask and only sigwait() below sees the signal
+  sigset_t signals;
+  sigemptyset(&signals);
+  sigaddset(&signals, SIGINT);
+  sigaddset(&signals, SIGTERM);
+  ::pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+
+  auto server = StartServer(factory, address, cpus, handler_pool);
+  if (!server) return 1;
+  common::utils::ResetPeakRss();
+
+  std::cout << "Serving " << factory->GetName() << " at " << address
+            << " (Ctrl-C to stop)" << std::endl;
+  int signal_number = 0;
+  sigwait(&signals, &signal_number);
+
+  server->Stop();
+
+  common::utils::MemoryUsage memory;
+  int64_t cpu_ns = common::utils::ReadProcessCpuNanos();
+  std::cout << "Server stopped" << std::endl;
+  if (cpu_ns >= 0) {
+    std::cout << "  CPU time: " << common::utils::FormatDuration(cpu_ns) << std::endl;
+  }
+  if (common::utils::ReadMemoryUsage(&memory)) {
+    std::cout << "  Peak memory: " << common::utils::FormatBytes(memory.peak_rss_bytes)
+              << std::endl;
+  }
+  return 0;
+}
+
+} // namespace scenarios
+} // namespace benchmark
@@ -0,0 +1,63 @@
+#pragma once
+
+#include "benchmark_service.h"
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <sys/types.h>
+#include <vector>
+
+namespace benchmark {
+namespace scenarios {
+
+// Resources used by a server process
+struct ServerUsage {
+  int64_t cpu_ns = -1;          // User + system CPU time since it started
+  uint64_t peak_rss_bytes = 0;  // Since it started or the last ResetPeak()
+};
+
+// The reference service every runner-started server serves. With
+// handler_pool its async calls complete on the shared work-stealing
+// executor.
+std::shared_ptr<common::IBenchmarkService> MakeReferenceService(bool handler_pool);
+
+// A reference server for one framework in a forked child process, so the
+// client's measurements do not include it and each side can be pinned to
+// its own CPUs. The runner controls it over a pair of pipes; the child
+// also stops when the runner exits and its end of the pipe closes.
+class ServerProcess {
+public:
+  ServerProcess() = default;
+  ~ServerProcess();
+  ServerProcess(const ServerProcess&) = delete;
+  ServerProcess& operator=(const ServerProcess&) = delete;
+
+  // Fork, pin the child to `cpus` (empty keeps this process's set), and
+  // wait until its server listens at `address`. Call from a single-threaded
+  // point of the runner, between benchmark runs.
+  bool Start(common::IFrameworkFactory* factory, const std::string& address,
+             const std::vector<int>& cpus, bool handler_pool = false);
+
+  bool Sample(ServerUsage* usage);
+  bool ResetPeak();
+
+  // Stop the server and reap the child
+  void Stop();
+
+private:
+  // Send one command line and read the one-line reply
+  bool Request(const std::string& command, std::string* reply);
+
+  pid_t pid_ = -1;
+  int command_fd_ = -1;
+  int reply_fd_ = -1;
+};
+
+// --server-mode: serve the reference service through `factory` at
+// `address` until SIGINT or SIGTERM, then report the resources used.
+// Returns the process exit code.
+int ServeUntilSignal(common::IFrameworkFactory* factory, const std::string& address,
+                     const std::vector<int>& cpus, bool handler_pool = false);
+
+} // namespace scenarios
+} // namespace benchmark
@@ -0,0 +1,166 @@
+#include "benchmark_scenario.h"
+#include "message_shapes.h"
+#include "parameter_sweep.h"
+#include <algorithm>
+#include <iostream>
+
+namespace benchmark {
+namespace scenarios {
+
+namespace {
+
+// Latency of one shape at one size
+struct ShapePoint {
+  size_t field_bytes = 0;
+  common::utils::LatencyStats latency;
+  uint64_t calls = 0;
+  uint64_t failures = 0;
+};
+
+// Echoes `sample` until `end_time`. The first, unmeasured echoes are
+// compared with the sample, so a codec that loses a field fails the point
+// instead of reporting a latency; the timed calls only check the status.
+template<typename Message>
+ShapePoint MeasureShape(common::IBenchmarkService* service, const Message& sample,
+                        std::chrono::steady_clock::time_point end_time) {
+  ShapePoint point;
+  point.field_bytes = common::shapes::FieldBytes(sample);
+
+  for (int i = 0; i < 3; i++) {
+    auto result = service->EchoShape(sample);
+    if (!result.ok() || !common::shapes::Equal(result.value, sample)) {
+      point.failures++;
+      return point;
+    }
+  }
+
+  while (std::chrono::steady_clock::now() < end_time) {
+    auto start = common::utils::GetTimestampNanos();
+    bool ok = service->EchoShape(sample).ok();
+    auto end = common::utils::GetTimestampNanos();
+    if (ok) {
+      point.latency.AddSample(end - start);
+    } else {
+      point.failures++;
+    }
+    point.calls++;
+  }
+  return point;
+}
+
+ShapePoint MeasureShape(common::IBenchmarkService* service, common::shapes::Shape shape,
+                        size_t size, std::chrono::steady_clock::time_point end_time) {
+  using common::shapes::Shape;
+  switch (shape) {
+    case Shape::kNested:
+      return MeasureShape(service, common::shapes::MakeNested(size), end_time);
+    case Shape::kArrays:
+      return MeasureShape(service, common::shapes::MakeArrays(size), end_time);
+    case Shape::kMap:
+      return MeasureShape(service, common::shapes::MakeMap(size), end_time);
+    case Shape::kSparse:
+      return MeasureShape(service, common::shapes::MakeSparse(size), end_time);
+    case Shape::kStrings:
+      break;
+  }
+  return MeasureShape(service, common::shapes::MakeStrings(size), end_time);
+}
+
+} // namespace
+
+// Sequential echoes of each message-zoo shape (see message_shapes.h) at
+// each size in shape_sizes. Every shape gets one table of latency against
+// size, so codecs that are cheap for flat payloads but slow on trees,
+// maps or many small fields show up end to end.
+class ShapeEchoBenchmark : public BenchmarkScenario {
+public:
+  ShapeEchoBenchmark() : BenchmarkScenario("Message Shapes") {}
+
+  BenchmarkResults Run(
+      common::IBenchmarkClient* client,
+      const BenchmarkConfig& config) override {
+
+    BenchmarkResults results;
+    results.scenario_name = name_;
+    results.framework_name = "unknown";
+
+    std::vector<common::shapes::Shape> shapes;
+    if (!common::shapes::ParseShapeList(config.message_shapes, &shapes)) {
+      std::cerr << "Invalid message shapes: " << config.message_shapes << std::endl;
+      return results;
+    }
+    std::vector<long> sizes;
+    if (!ParseSweepList(config.shape_sizes, &sizes)) {
+      std::cerr << "Invalid shape sizes: " << config.shape_sizes << std::endl;
+      return results;
+    }
+
+    if (!client->Connect(config.server_address)) {
+      std::cerr << "Failed to connect to server" << std::endl;
+      return results;
+    }
+
+    auto* service = client->GetService();
+    if (!service) {
+      std::cerr << "Failed to get service" << std::endl;
+      return results;
+    }
+
+    auto per_point = std::chrono::milliseconds(std::max<long>(
+        100, config.duration_seconds * 1000L / static_cast<long>(shapes.size() * sizes.size())));
+
+    for (auto shape : shapes) {
+      const char* shape_name = common::shapes::ShapeName(shape);
+      ResultSeries table;
+      table.name = std::string("Echo latency of ") + shape_name + " by size";
+      table.columns = {"size", "field_bytes", "p50_us", "p99_us", "calls_per_s"};
+
+      for (long size_value : sizes) {
+        size_t size = static_cast<size_t>(std::max<long>(1, size_value));
+        ShapePoint point = MeasureShape(service, shape, size,
+                                        std::chrono::steady_clock::now() + per_point);
+        if (point.calls == 0) {
+          std::cerr << "Echo of " << shape_name << " at " << size
+                    << " bytes failed or came back changed" << std::endl;
+        }
+
+        double seconds = std::chrono::duration<double>(per_point).count();
+        uint64_t succeeded = point.calls - std::min(point.calls, point.failures);
+        table.rows.push_back({
+            static_cast<double>(size),
+            static_cast<double>(point.field_bytes),
+            point.latency.GetP50() / 1000.0,
+            point.latency.GetP99() / 1000.0,
+            succeeded / seconds});
+
+        if (config.verbose) {
+          std::cout << shape_name << " at " << size << " bytes: "
+                    << point.latency.GetP50() / 1000.0 << " us (p50)" << std::endl;
+        }
+
+        // Headline latency is that of the last point
+        results.latency_stats = point.latency;
+        results.total_requests += std::max(point.calls, point.failures);
+        results.successful_requests += succeeded;
+        results.failed_requests += point.failures;
+        results.total_bytes += succeeded * 2 * point.field_bytes;
+        results.total_duration_ns += std::chrono::duration_cast<std::chrono::nanoseconds>(
+            per_point).count();
+      }
+
+      results.series.push_back(table);
+    }
+
+    client->Disconnect();
+
+    results.ComputeDerivedMetrics();
+    return results;
+  }
+};
+
+std::unique_ptr<BenchmarkScenario> CreateShapeEchoBenchmark() {
+  return std::make_unique<ShapeEchoBenchmark>();
+}
+
+} // namespace scenarios
+} // namespace benchmark
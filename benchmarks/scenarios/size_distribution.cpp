@@ -0,0 +1,235 @@
+#include "size_distribution.h"
+#include "parameter_sweep.h"
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <sstream>
+#include <vector>
+
+namespace benchmark {
+namespace scenarios {
+
+namespace {
+
+constexpr size_t kDefaultLogNormalMax = 64 * 1024 * 1024;
+
+class FixedDistribution : public SizeDistribution {
+public:
+  explicit FixedDistribution(size_t size) : size_(size) {}
+
+  size_t Sample(std::mt19937_64&) const override { return size_; }
+  size_t MaxSize() const override { return size_; }
+  std::string Describe() const override {
+    return "fixed(" + std::to_string(size_) + ")";
+  }
+
+private:
+  size_t size_;
+};
+
+class UniformDistribution : public SizeDistribution {
+public:
+  UniformDistribution(size_t min, size_t max) : min_(min), max_(max) {}
+
+  size_t Sample(std::mt19937_64& gen) const override {
+    return std::uniform_int_distribution<size_t>(min_, max_)(gen);
+  }
+  size_t MaxSize() const override { return max_; }
+  std::string Describe() const override {
+    return "uniform(" + std::to_string(min_) + ", " + std::to_string(max_) + ")";
+  }
+
+private:
+  size_t min_;
+  size_t max_;
+};
+
+class LogNormalDistribution : public SizeDistribution {
+public:
+  LogNormalDistribution(double median, double sigma, size_t max)
+    : median_(median), sigma_(sigma), max_(max) {}
+
+  size_t Sample(std::mt19937_64& gen) const override {
+    std::lognormal_distribution<double> dist(std::log(median_), sigma_);
+    double value = std::round(dist(gen));
+    return std::min(max_, static_cast<size_t>(std::max(1.0, value)));
+  }
+  size_t MaxSize() const override { return max_; }
+  std::string Describe() const override {
+    std::ostringstream oss;
+    oss << "lognormal(median " << median_ << ", sigma " << sigma_ << ")";
+    return oss.str();
+  }
+
+private:
+  double median_;
+  double sigma_;
+  size_t max_;
+};
+
+class BimodalDistribution : public SizeDistribution {
+public:
+  BimodalDistribution(size_t small, size_t large, double p_large)
+    : small_(small), large_(large), p_large_(p_large) {}
+
+  size_t Sample(std::mt19937_64& gen) const override {
+    return std::bernoulli_distribution(p_large_)(gen) ? large_ : small_;
+  }
+  size_t MaxSize() const override { return std::max(small_, large_); }
+  std::string Describe() const override {
+    std::ostringstream oss;
+    oss << "bimodal(" << small_ << ", " << large_ << ", p_large " << p_large_ << ")";
+    return oss.str();
+  }
+
+private:
+  size_t small_;
+  size_t large_;
+  double p_large_;
+};
+
+// Piecewise-linear inverse CDF over the points of an empirical table
+class EmpiricalDistribution : public SizeDistribution {
+public:
+  EmpiricalDistribution(std::vector<std::pair<double, double>> points,
+                        std::string source)
+    : points_(std::move(points)), source_(std::move(source)) {}
+
+  size_t Sample(std::mt19937_64& gen) const override {
+    double u = std::uniform_real_distribution<double>(0.0, 1.0)(gen);
+    auto it = std::lower_bound(
+        points_.begin(), points_.end(), u,
+        [](const std::pair<double, double>& p, double v) { return p.second < v; });
+    if (it == points_.end()) return static_cast<size_t>(points_.back().first);
+    if (it == points_.begin()) return static_cast<size_t>(it->first);
+
+    auto prev = it - 1;
+    double span = it->second - prev->second;
+    double t = span > 0.0 ? (u - prev->second) / span : 1.0;
+    return static_cast<size_t>(std::round(prev->first + t * (it->first - prev->first)));
+  }
+  size_t MaxSize() const override {
+    return static_cast<size_t>(points_.back().first);
+  }
+  std::string Describe() const override { return "cdf(" + source_ + ")"; }
+
+private:
+  std::vector<std::pair<double, double>> points_;  // (size, cumulative)
+  std::string source_;
+};
+
+std::vector<std::string> SplitSpec(const std::string& spec) {
+  std::vector<std::string> parts;
+  std::string part;
+  std::istringstream stream(spec);
+  while (std::getline(stream, part, ':')) {
+    parts.push_back(part);
+  }
+  return parts;
+}
+
+// Sizes take the same K/M/G suffixes as --message-size, e.g. "64K"
+bool ToSize(const std::string& text, size_t* value) {
+  std::vector<long> parsed;
+  if (!ParseSweepList(text, &parsed) || parsed.size() != 1 || parsed[0] < 1) return false;
+  *value = static_cast<size_t>(parsed[0]);
+  return true;
+}
+
+bool ToDouble(const std::string& text, double* value) {
+  try {
+    size_t consumed = 0;
+    *value = std::stod(text, &consumed);
+    return consumed == text.size();
+  } catch (const std::exception&) {
+    return false;
+  }
+}
+
+std::unique_ptr<SizeDistribution> LoadEmpiricalCdf(
+    const std::string& path, std::string* error) {
+  std::ifstream in(path);
+  if (!in) {
+    *error = "cannot open CDF file " + path;
+    return nullptr;
+  }
+
+  std::vector<std::pair<double, double>> points;
+  std::string line;
+  while (std::getline(in, line)) {
+    auto comment = line.find('#');
+    if (comment != std::string::npos) line.resize(comment);
+
+    std::istringstream fields(line);
+    double size = 0.0;
+    double cumulative = 0.0;
+    if (!(fields >> size)) continue;
+    if (!(fields >> cumulative) || size < 1.0 || cumulative < 0.0 || cumulative > 1.0) {
+      *error = "malformed CDF line in " + path + ": " + line;
+      return nullptr;
+    }
+    if (!points.empty() &&
+        (size < points.back().first || cumulative < points.back().second)) {
+      *error = "CDF in " + path + " must be non-decreasing";
+      return nullptr;
+    }
+    points.emplace_back(size, cumulative);
+  }
+
+  if (points.empty()) {
+    *error = "CDF file " + path + " has no entries";
+    return nullptr;
+  }
+  points.back().second = 1.0;
+  return std::make_unique<EmpiricalDistribution>(std::move(points), path);
+}
+
+} // namespace
+
+std::unique_ptr<SizeDistribution> ParseSizeDistribution(
+    const std::string& spec, std::string* error) {
+
+  // The CDF path may itself contain ':'
+  if (spec.compare(0, 4, "cdf:") == 0) {
+    return LoadEmpiricalCdf(spec.substr(4), error);
+  }
+
+  auto parts = SplitSpec(spec);
+  const std::string kind = parts.empty() ? "" : parts[0];
+
+  if (kind == "fixed" && parts.size() == 2) {
+    size_t size = 0;
+    if (ToSize(parts[1], &size)) {
+      return std::make_unique<FixedDistribution>(size);
+    }
+  } else if (kind == "uniform" && parts.size() == 3) {
+    size_t min = 0;
+    size_t max = 0;
+    if (ToSize(parts[1], &min) && ToSize(parts[2], &max) && min <= max) {
+      return std::make_unique<UniformDistribution>(min, max);
+    }
+  } else if (kind == "lognormal" && (parts.size() == 3 || parts.size() == 4)) {
+    double median = 0.0;
+    double sigma = 0.0;
+    size_t max = kDefaultLogNormalMax;
+    if (ToDouble(parts[1], &median) && ToDouble(parts[2], &sigma) &&
+        median >= 1.0 && sigma >= 0.0 &&
+        (parts.size() == 3 || ToSize(parts[3], &max))) {
+      return std::make_unique<LogNormalDistribution>(median, sigma, max);
+    }
+  } else if (kind == "bimodal" && parts.size() == 4) {
+    size_t small = 0;
+    size_t large = 0;
+    double p_large = 0.0;
+    if (ToSize(parts[1], &small) && ToSize(parts[2], &large) &&
+        ToDouble(parts[3], &p_large) && p_large >= 0.0 && p_large <= 1.0) {
+      return std::make_unique<BimodalDistribution>(small, large, p_large);
+    }
+  }
+
+  *error = "invalid size distribution '" + spec + "'";
+  return nullptr;
+}
+
+} // namespace scenarios
+} // namespace benchmark
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <random>
+#include <string>
+
+namespace benchmark {
+namespace scenarios {
+
+// Source of payload sizes for workloads that do not use a single fixed
+// message size. Sample() is const so one distribution can be shared by
+// threads that each own a generator.
+class SizeDistribution {
+public:
+  virtual ~SizeDistribution() = default;
+
+  virtual size_t Sample(std::mt19937_64& gen) const = 0;
+
+  // Largest size Sample() can return, used to size payload buffers
+  virtual size_t MaxSize() const = 0;
+
+  virtual std::string Describe() const = 0;
+};
+
+// Parse a distribution spec:
+//   fixed:<bytes>
+//   uniform:<min>:<max>
+//   lognormal:<median>:<sigma>[:<max>]     (max defaults to 64 MB)
+//   bimodal:<small>:<large>:<p_large>
+//   cdf:<file>   lines of "<bytes> <cumulative probability>", '#' comments
+// Byte sizes take an optional binary K/M/G suffix, e.g. "uniform:1K:1M".
+// Returns nullptr and fills `error` if the spec is invalid.
+std::unique_ptr<SizeDistribution> ParseSizeDistribution(
+    const std::string& spec, std::string* error);
+
+} // namespace scenarios
+} // namespace benchmark
@@ -0,0 +1,155 @@
+#include "benchmark_scenario.h"
+#include "load_generator.h"
+#include <algorithm>
+#include <iostream>
+
+namespace benchmark {
+namespace scenarios {
+
+// Finds the highest offered rate a framework sustains while the configured
+// latency percentile stays within the SLO. The open-loop rate is doubled
+// from slo_start_rps until the SLO breaks or errors appear, then the
+// boundary is refined with a binary search.
+class SloThroughputBenchmark : public BenchmarkScenario {
+public:
+  SloThroughputBenchmark() : BenchmarkScenario("Max Sustainable Throughput") {}
+
+  BenchmarkResults Run(
+      common::IBenchmarkClient* client,
+      const BenchmarkConfig& config) override {
+
+    BenchmarkResults results;
+    results.scenario_name = name_;
+    results.framework_name = "unknown";
+
+    if (!client->Connect(config.server_address)) {
+      std::cerr << "Failed to connect to server" << std::endl;
+      return results;
+    }
+
+    slo_ns_ = config.slo_latency_us * 1000;
+    percentile_ = config.slo_percentile;
+    probes_.clear();
+
+    double good_rps = 0.0;
+    double bad_rps = 0.0;
+    BenchmarkResults best;
+
+    // Ramp phase
+    double rate = config.slo_start_rps;
+    while (rate <= config.slo_max_rps) {
+      auto probe = RunProbe(client, config, rate);
+      if (!Passed(probe)) {
+        bad_rps = rate;
+        break;
+      }
+      good_rps = rate;
+      best = probe;
+      rate *= 2.0;
+    }
+
+    // Refine between the last passing and the first failing rate
+    if (bad_rps > 0.0) {
+      for (int step = 0; step < config.slo_search_steps; step++) {
+        double mid = (good_rps + bad_rps) / 2.0;
+        auto probe = RunProbe(client, config, mid);
+        if (Passed(probe)) {
+          good_rps = mid;
+          best = probe;
+        } else {
+          bad_rps = mid;
+        }
+      }
+    }
+
+    client->Disconnect();
+
+    if (good_rps > 0.0) {
+      results = best;
+    } else if (!probes_.empty()) {
+      results = probes_.front().results;
+    }
+    results.scenario_name = name_;
+    results.custom_metrics.clear();
+    results.custom_metrics.emplace_back("max_sustainable_rps", good_rps);
+    results.custom_metrics.emplace_back("slo_percentile", config.slo_percentile * 100.0);
+    results.custom_metrics.emplace_back("slo_latency_us",
+                                        static_cast<double>(config.slo_latency_us));
+    results.custom_metrics.emplace_back(
+        "latency_at_max_us",
+        good_rps > 0.0 ? best.latency_stats.GetPercentile(config.slo_percentile) / 1000.0
+                       : 0.0);
+
+    ResultSeries curve;
+    curve.name = "Saturation curve";
+    curve.columns = {"offered_rps", "achieved_rps", "p50_us", "p99_us",
+                     "slo_pct_us", "errors", "passed"};
+    std::sort(probes_.begin(), probes_.end(),
+              [](const Probe& a, const Probe& b) { return a.offered_rps < b.offered_rps; });
+    for (const auto& probe : probes_) {
+      const auto& r = probe.results;
+      curve.rows.push_back({
+          probe.offered_rps,
+          r.requests_per_second,
+          r.latency_stats.GetP50() / 1000.0,
+          r.latency_stats.GetP99() / 1000.0,
+          r.latency_stats.GetPercentile(config.slo_percentile) / 1000.0,
+          static_cast<double>(r.failed_requests),
+          Passed(r) ? 1.0 : 0.0});
+    }
+    results.series.push_back(curve);
+
+    return results;
+  }
+
+private:
+  struct Probe {
+    double offered_rps;
+    BenchmarkResults results;
+  };
+
+  BenchmarkResults RunProbe(
+      common::IBenchmarkClient* client,
+      const BenchmarkConfig& config,
+      double rate) {
+
+    // Only the first probe pays the warm-up
+    BenchmarkConfig probe_config = config;
+    if (!probes_.empty()) {
+      probe_config.warmup_seconds = 0;
+    }
+
+    OpenLoopSpec spec;
+    spec.target_rps = rate;
+    auto probe = RunOpenLoopEcho({client}, probe_config, spec);
+
+    if (config.verbose) {
+      std::cout << "    offered " << rate << " req/s: p"
+                << config.slo_percentile * 100.0 << " = "
+                << common::utils::FormatDuration(
+                       probe.latency_stats.GetPercentile(config.slo_percentile))
+                << ", errors " << probe.failed_requests
+                << (Passed(probe) ? " (pass)" : " (fail)") << std::endl;
+    }
+
+    probes_.push_back({rate, probe});
+    return probe;
+  }
+
+  bool Passed(const BenchmarkResults& probe) const {
+    return probe.failed_requests == 0 &&
+           probe.successful_requests > 0 &&
+           probe.latency_stats.GetPercentile(percentile_) <= slo_ns_;
+  }
+
+  int64_t slo_ns_ = 0;
+  double percentile_ = 0.99;
+  std::vector<Probe> probes_;
+};
+
+std::unique_ptr<BenchmarkScenario> CreateSloThroughputBenchmark() {
+  return std::make_unique<SloThroughputBenchmark>();
+}
+
+} // namespace scenarios
+} // namespace benchmark
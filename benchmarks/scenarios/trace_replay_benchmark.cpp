@@ -0,0 +1,475 @@
+#include "benchmark_scenario.h"
+#include "payload_generator.h"
+#include "workload_trace.h"
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <iostream>
+#include <mutex>
+#include <thread>
+
+namespace benchmark {
+namespace scenarios {
+
+namespace {
+
+using common::trace::TraceOperation;
+using common::trace::TraceRecord;
+
+constexpr int kOperationCount = 8;
+
+struct ReplayState {
+  std::mutex mutex;
+  std::condition_variable cv;
+  int in_flight = 0;
+
+  common::utils::LatencyStats latency[kOperationCount];
+  common::utils::LatencyStats drift;
+  uint64_t successful = 0;
+  uint64_t failed = 0;
+  uint64_t skipped = 0;
+  uint64_t bytes = 0;
+};
+
+void Record(ReplayState* state, int op, bool ok, int64_t latency_ns, uint64_t bytes) {
+  if (ok) {
+    state->latency[op].AddSample(latency_ns);
+    state->successful++;
+    state->bytes += bytes;
+  } else {
+    state->failed++;
+  }
+}
+
+// Send time of a call: records how far it drifted behind its scheduled
+// time and returns the timestamp its latency is measured from
+int64_t MarkSent(ReplayState* state, std::chrono::steady_clock::time_point scheduled) {
+  int64_t drift_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now() - scheduled).count();
+  {
+    std::lock_guard<std::mutex> lock(state->mutex);
+    state->drift.AddSample(std::max<int64_t>(0, drift_ns));
+  }
+  return common::utils::GetTimestampNanos();
+}
+
+// Threads that make blocking calls (synchronous calls and the sending side
+// of client streams) off the schedule threads, so a slow call does not
+// hold back the records after it. Another thread starts whenever none is
+// idle, up to kMaxCallers; past that calls queue, and the wait shows up
+// as drift.
+class CallerPool {
+public:
+  static constexpr size_t kMaxCallers = 256;
+
+  ~CallerPool() { Stop(); }
+
+  void Submit(std::function<void()> call) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    queue_.push_back(std::move(call));
+    if (idle_ == 0 && threads_.size() < kMaxCallers) {
+      threads_.emplace_back([this]() { Work(); });
+    } else {
+      cv_.notify_one();
+    }
+  }
+
+  // Runs the queued calls to completion, then joins the threads
+  void Stop() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stopping_ = true;
+    }
+    cv_.notify_all();
+    for (auto& thread : threads_) thread.join();
+    threads_.clear();
+  }
+
+private:
+  void Work() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+      idle_++;
+      cv_.wait(lock, [this]() { return stopping_ || !queue_.empty(); });
+      idle_--;
+      if (queue_.empty()) return;
+      auto call = std::move(queue_.front());
+      queue_.pop_front();
+      lock.unlock();
+      call();
+      lock.lock();
+    }
+  }
+
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  std::deque<std::function<void()>> queue_;
+  std::vector<std::thread> threads_;
+  size_t idle_ = 0;
+  bool stopping_ = false;
+};
+
+} // namespace
+
+// Replays a recorded workload trace (see workload_trace.h) open-loop: each
+// record is issued at its recorded offset from the start, scaled by
+// trace_speed, regardless of how long earlier calls took. Records are
+// dealt round-robin to num_threads_per_client threads that all walk the
+// memory-mapped trace in place; blocking calls and client streams are
+// handed to a CallerPool so those threads never wait on a call. Reports
+// how far actual send times drifted behind the trace alongside
+// per-operation latency.
+class TraceReplayBenchmark : public BenchmarkScenario {
+public:
+  TraceReplayBenchmark() : BenchmarkScenario("Trace Replay") {}
+
+  BenchmarkResults Run(
+      common::IBenchmarkClient* client,
+      const BenchmarkConfig& config) override {
+
+    BenchmarkResults results;
+    results.scenario_name = name_;
+    results.framework_name = "unknown";
+
+    if (config.trace_file.empty()) {
+      std::cerr << "Trace replay requires --trace <file>" << std::endl;
+      return results;
+    }
+
+    common::trace::TraceReader reader;
+    std::string error;
+    if (!reader.Open(config.trace_file, &error)) {
+      std::cerr << "Trace replay: " << error << std::endl;
+      return results;
+    }
+
+    if (!client->Connect(config.server_address)) {
+      std::cerr << "Failed to connect to server" << std::endl;
+      return results;
+    }
+
+    auto* service = client->GetService();
+    if (!service) {
+      std::cerr << "Failed to get service" << std::endl;
+      return results;
+    }
+
+    int num_threads = std::max(1, config.num_threads_per_client);
+    double speed = config.trace_speed > 0.0 ? config.trace_speed : 1.0;
+
+    if (config.verbose) {
+      std::cout << "Replaying " << reader.GetRecordCount() << " records from "
+                << config.trace_file << " on " << num_threads << " threads at "
+                << speed << "x" << std::endl;
+    }
+
+    std::vector<std::shared_ptr<ReplayState>> states;
+    for (int t = 0; t < num_threads; t++) {
+      states.push_back(std::make_shared<ReplayState>());
+    }
+
+    CallerPool callers;
+    auto start = std::chrono::steady_clock::now() + std::chrono::milliseconds(10);
+    std::vector<std::thread> workers;
+    for (int t = 0; t < num_threads; t++) {
+      workers.emplace_back([&, t]() {
+        ReplayThread(service, reader, t, num_threads, speed, start, &callers, states[t]);
+      });
+    }
+    for (auto& worker : workers) {
+      worker.join();
+    }
+    callers.Stop();
+
+    results.total_duration_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - start).count();
+
+    client->Disconnect();
+
+    uint64_t skipped = 0;
+    uint64_t trace_ns = 0;
+    for (uint64_t i = 0; i < reader.GetRecordCount(); i++) {
+      trace_ns += reader.GetRecord(i).inter_arrival_ns;
+    }
+
+    common::utils::LatencyStats drift;
+    common::utils::LatencyStats per_op[kOperationCount];
+    for (const auto& state : states) {
+      std::lock_guard<std::mutex> lock(state->mutex);
+      for (int op = 0; op < kOperationCount; op++) {
+        per_op[op].Merge(state->latency[op]);
+        results.latency_stats.Merge(state->latency[op]);
+      }
+      drift.Merge(state->drift);
+      results.successful_requests += state->successful;
+      results.failed_requests += state->failed;
+      results.total_bytes += state->bytes;
+      skipped += state->skipped;
+    }
+    results.total_requests = results.successful_requests + results.failed_requests;
+    results.ComputeDerivedMetrics();
+
+    results.custom_metrics.emplace_back("trace_records",
+                                        static_cast<double>(reader.GetRecordCount()));
+    results.custom_metrics.emplace_back("skipped_records", static_cast<double>(skipped));
+    results.custom_metrics.emplace_back("trace_duration_ms", trace_ns / speed / 1e6);
+    results.custom_metrics.emplace_back("replay_duration_ms",
+                                        results.total_duration_ns / 1e6);
+    results.custom_metrics.emplace_back("drift_mean_us", drift.GetMean() / 1000.0);
+    results.custom_metrics.emplace_back("drift_p50_us", drift.GetP50() / 1000.0);
+    results.custom_metrics.emplace_back("drift_p99_us", drift.GetP99() / 1000.0);
+    results.custom_metrics.emplace_back("drift_max_us", drift.GetMax() / 1000.0);
+
+    for (int op = 0; op < kOperationCount; op++) {
+      if (per_op[op].GetCount() == 0) continue;
+      std::string prefix = common::trace::TraceOperationName(
+          static_cast<TraceOperation>(op));
+      results.custom_metrics.emplace_back(prefix + "_count",
+                                          static_cast<double>(per_op[op].GetCount()));
+      results.custom_metrics.emplace_back(prefix + "_p50_us", per_op[op].GetP50() / 1000.0);
+      results.custom_metrics.emplace_back(prefix + "_p99_us", per_op[op].GetP99() / 1000.0);
+    }
+
+    ResultSeries drift_histogram;
+    drift_histogram.name = "Send time drift histogram";
+    drift_histogram.columns = {"upper_us", "count"};
+    for (const auto& bucket : drift.GetHistogram()) {
+      drift_histogram.rows.push_back({bucket.first / 1000.0,
+                                      static_cast<double>(bucket.second)});
+    }
+    results.series.push_back(drift_histogram);
+
+    return results;
+  }
+
+private:
+  void ReplayThread(
+      common::IBenchmarkService* service,
+      const common::trace::TraceReader& reader,
+      int thread_index,
+      int num_threads,
+      double speed,
+      std::chrono::steady_clock::time_point start,
+      CallerPool* callers,
+      const std::shared_ptr<ReplayState>& state) {
+
+    uint64_t offset_ns = 0;
+    uint32_t sequence_number = 0;
+
+    for (uint64_t i = 0; i < reader.GetRecordCount(); i++) {
+      const TraceRecord& record = reader.GetRecord(i);
+      offset_ns += record.inter_arrival_ns;
+      if (i % num_threads != static_cast<uint64_t>(thread_index)) continue;
+
+      auto scheduled = start + std::chrono::nanoseconds(
+          static_cast<int64_t>(offset_ns / speed));
+      std::this_thread::sleep_until(scheduled);
+      Issue(service, record, sequence_number++, scheduled, callers, state);
+    }
+
+    std::unique_lock<std::mutex> lock(state->mutex);
+    if (!state->cv.wait_for(lock, std::chrono::seconds(10),
+                            [&] { return state->in_flight == 0; })) {
+      state->failed += state->in_flight;
+      std::cerr << "Trace replay: " << state->in_flight
+                << " async calls still outstanding" << std::endl;
+    }
+  }
+
+  // Issues one record without blocking: asynchronous calls and streams
+  // start here, blocking calls and client streams on `callers`. Every call
+  // is counted in flight until it completes.
+  void Issue(
+      common::IBenchmarkService* service,
+      const TraceRecord& record,
+      uint32_t sequence_number,
+      std::chrono::steady_clock::time_point scheduled,
+      CallerPool* callers,
+      const std::shared_ptr<ReplayState>& state) {
+
+    auto op = static_cast<TraceOperation>(record.operation);
+    int index = record.operation;
+
+    switch (op) {
+      case TraceOperation::kEcho:
+      case TraceOperation::kEchoAsync: {
+        common::EchoRequest request;
+        request.message = common::payload::SharedText(record.payload_size, sequence_number);
+        request.sequence_number = sequence_number;
+        uint64_t bytes = request.message.size();
+
+        BeginAsync(state.get());
+        if (op == TraceOperation::kEcho) {
+          callers->Submit([service, request, scheduled, state, index, bytes]() mutable {
+            request.timestamp = MarkSent(state.get(), scheduled);
+            auto result = service->Echo(request);
+            EndAsync(state.get(), index, result.ok(), request.timestamp,
+                     bytes + result.value.message.size());
+          });
+        } else {
+          int64_t call_start = MarkSent(state.get(), scheduled);
+          request.timestamp = call_start;
+          service->EchoAsync(request,
+              [state, index, call_start, bytes](
+                  const common::Result<common::EchoResponse>& result) {
+                EndAsync(state.get(), index, result.ok(), call_start,
+                         bytes + result.value.message.size());
+              });
+        }
+        break;
+      }
+
+      case TraceOperation::kBatchProcess:
+      case TraceOperation::kBatchProcessAsync: {
+        common::BatchRequest request;
+        size_t items = std::max<size_t>(1, record.item_count);
+        request.items.resize(items);
+        for (size_t i = 0; i < items; i++) {
+          request.items[i].id = std::to_string(i);
+          request.items[i].operation = "echo";
+          if (const auto* generator = common::payload::PayloadGenerator::Shared()) {
+            request.items[i].data = generator->MakeBytes(record.payload_size / items,
+                                                         sequence_number * items + i);
+          } else {
+            request.items[i].data.assign(record.payload_size / items, 0x5a);
+          }
+        }
+        uint64_t bytes = record.payload_size;
+
+        BeginAsync(state.get());
+        if (op == TraceOperation::kBatchProcess) {
+          callers->Submit([service, request, scheduled, state, index, bytes]() {
+            int64_t call_start = MarkSent(state.get(), scheduled);
+            auto result = service->BatchProcess(request);
+            EndAsync(state.get(), index, result.ok(), call_start, bytes);
+          });
+        } else {
+          int64_t call_start = MarkSent(state.get(), scheduled);
+          service->BatchProcessAsync(request,
+              [state, index, call_start, bytes](
+                  const common::Result<common::BatchResponse>& result) {
+                EndAsync(state.get(), index, result.ok(), call_start, bytes);
+              });
+        }
+        break;
+      }
+
+      case TraceOperation::kEchoChain: {
+        common::EchoRequest request;
+        request.message = common::payload::SharedText(record.payload_size, sequence_number);
+        request.sequence_number = sequence_number;
+        uint32_t length = record.item_count;
+        uint64_t bytes = request.message.size();
+
+        BeginAsync(state.get());
+        callers->Submit([service, request, length, scheduled, state, index, bytes]() mutable {
+          request.timestamp = MarkSent(state.get(), scheduled);
+          auto result = service->EchoChain(request, length);
+          EndAsync(state.get(), index, result.ok(), request.timestamp, bytes * 2 * length);
+        });
+        break;
+      }
+
+      case TraceOperation::kStreamData: {
+        common::StreamRequest request;
+        request.chunk_count = std::max<uint32_t>(1, record.item_count);
+        request.chunk_size = record.payload_size / request.chunk_count;
+
+        BeginAsync(state.get());
+        int64_t call_start = MarkSent(state.get(), scheduled);
+        auto received = std::make_shared<std::atomic<uint64_t>>(0);
+        service->StreamData(
+            request,
+            [received](const common::DataChunk& chunk) {
+              *received += chunk.data.size();
+            },
+            [state, index, call_start, received](common::ErrorCode code,
+                                                 const std::string&) {
+              EndAsync(state.get(), index, code == common::ErrorCode::OK,
+                       call_start, received->load());
+            });
+        break;
+      }
+
+      case TraceOperation::kUploadData:
+      case TraceOperation::kBidirectionalStream: {
+        // The recorded bytes split evenly over the recorded chunks; an
+        // empty upload sends only the closing chunk
+        uint32_t chunks = std::max<uint32_t>(1, record.item_count);
+        size_t chunk_size = record.payload_size / chunks;
+        common::DataChunk chunk;
+        if (chunk_size > 0) chunk.data = common::payload::SharedBytes(chunk_size, sequence_number);
+
+        BeginAsync(state.get());
+        callers->Submit([service, op, chunk, chunks, scheduled, state, index]() mutable {
+          int64_t call_start = MarkSent(state.get(), scheduled);
+          common::StreamCallback<common::DataChunk> sink;
+          if (op == TraceOperation::kUploadData) {
+            service->UploadData(
+                sink,
+                [state, index, call_start](
+                    const common::Result<common::UploadResponse>& result) {
+                  EndAsync(state.get(), index, result.ok(), call_start,
+                           result.value.total_bytes);
+                });
+          } else {
+            auto received = std::make_shared<std::atomic<uint64_t>>(0);
+            service->BidirectionalStream(
+                sink,
+                [received](const common::DataChunk& reply) {
+                  *received += reply.data.size();
+                },
+                [state, index, call_start, received](common::ErrorCode code,
+                                                     const std::string&) {
+                  EndAsync(state.get(), index, code == common::ErrorCode::OK,
+                           call_start, received->load());
+                });
+          }
+          if (!sink) {
+            EndAsync(state.get(), index, false, call_start, 0);
+            return;
+          }
+          for (uint32_t i = 0; i < chunks && !chunk.data.empty(); i++) {
+            chunk.sequence_number = i;
+            chunk.timestamp = common::utils::GetTimestampNanos();
+            sink(chunk);
+          }
+          sink(common::DataChunk());
+        });
+        break;
+      }
+
+      default: {
+        // Operations this build does not know, from a newer trace
+        std::lock_guard<std::mutex> lock(state->mutex);
+        state->skipped++;
+        break;
+      }
+    }
+  }
+
+  static void BeginAsync(ReplayState* state) {
+    std::lock_guard<std::mutex> lock(state->mutex);
+    state->in_flight++;
+  }
+
+  static void EndAsync(ReplayState* state, int op, bool ok,
+                       int64_t call_start, uint64_t bytes) {
+    auto call_end = common::utils::GetTimestampNanos();
+    {
+      std::lock_guard<std::mutex> lock(state->mutex);
+      Record(state, op, ok, call_end - call_start, bytes);
+      state->in_flight--;
+    }
+    state->cv.notify_one();
+  }
+};
+
+std::unique_ptr<BenchmarkScenario> CreateTraceReplayBenchmark() {
+  return std::make_unique<TraceReplayBenchmark>();
+}
+
+} // namespace scenarios
+} // namespace benchmark
@@ -36,12 +36,16 @@ public:
       StreamCallback<DataChunk> on_chunk,
       CompletionCallback on_complete) = 0;
 
-  // Client streaming for upload throughput testing
+  // Client streaming for upload throughput testing. The service installs
+  // its chunk sink into chunk_provider; the caller then invokes
+  // chunk_provider once per chunk and ends the stream with an empty chunk,
+  // after which on_complete runs.
   virtual void UploadData(
       StreamCallback<DataChunk>& chunk_provider,
       ResponseCallback<UploadResponse> on_complete) = 0;
 
-  // Bidirectional streaming
+  // Bidirectional streaming. chunk_provider works as in UploadData; each
+  // chunk the caller sends is answered through on_chunk.
   virtual void BidirectionalStream(
       StreamCallback<DataChunk>& chunk_provider,
       StreamCallback<DataChunk> on_chunk,
@@ -54,6 +58,31 @@ public:
   virtual void BatchProcessAsync(
       const BatchRequest& request,
       ResponseCallback<BatchResponse> callback) = 0;
+
+  // Chain of `length` dependent echoes: each call sends the message of the
+  // previous response with the next sequence number, and the last response
+  // is returned. By default every link is its own round trip; transports
+  // that can run the chain remotely (or pipeline it) override this.
+  virtual Result<EchoResponse> EchoChain(const EchoRequest& request, uint32_t length) {
+    if (length == 0) {
+      return Result<EchoResponse>(ErrorCode::INVALID_ARGUMENT, "Chain length must be positive");
+    }
+    Result<EchoResponse> result = Echo(request);
+    EchoRequest next = request;
+    for (uint32_t i = 1; i < length && result.ok(); i++) {
+      next.message = std::move(result.value.message);
+      next.sequence_number++;
+      result = Echo(next);
+    }
+    return result;
+  }
+
+  // Echo of one message-zoo shape: the response is the request unchanged
+  virtual Result<NestedMessage> EchoShape(const NestedMessage& request) = 0;
+  virtual Result<ArrayMessage> EchoShape(const ArrayMessage& request) = 0;
+  virtual Result<MapMessage> EchoShape(const MapMessage& request) = 0;
+  virtual Result<SparseMessage> EchoShape(const SparseMessage& request) = 0;
+  virtual Result<StringMessage> EchoShape(const StringMessage& request) = 0;
 };
 
 // Abstract client interface
@@ -100,6 +129,10 @@ public:
   // Get framework name
   virtual std::string GetName() const = 0;
 
+  // True if clients can only reach servers started in their own process,
+  // so the framework cannot be served by another one
+  virtual bool IsInProcess() const { return false; }
+
   // Create a client instance
   virtual std::unique_ptr<IBenchmarkClient> CreateClient() = 0;
 
@@ -1,9 +1,13 @@
 #pragma once
 
+#include <array>
 #include <cstdint>
+#include <map>
+#include <optional>
 #include <string>
 #include <vector>
 #include <memory>
+#include <utility>
 
 namespace benchmark {
 namespace common {
@@ -112,6 +116,65 @@ struct BatchResponse {
   BatchResponse() : total_processed(0), total_failed(0) {}
 };
 
+// Message zoo: shapes that stress codecs in ways the single-blob messages
+// above do not. Each is echoed back unchanged by
+// IBenchmarkService::EchoShape().
+
+// Deeply nested structs: a tree of nodes
+struct TreeNode {
+  int64_t id;
+  double weight;
+  std::string label;
+  std::vector<TreeNode> children;
+
+  TreeNode() : id(0), weight(0.0) {}
+};
+
+struct NestedMessage {
+  TreeNode root;
+};
+
+// Large repeated scalar arrays
+struct ArrayMessage {
+  std::vector<int64_t> values;     // Wide range, so varints vary in length
+  std::vector<double> samples;
+  std::vector<uint32_t> counts;    // Small, one-byte varints
+};
+
+// Maps with string and integer keys
+struct MapMessage {
+  std::map<std::string, int64_t> counters;
+  std::map<uint32_t, std::string> labels;
+};
+
+// A record of many optional fields, most of them unset
+struct SparseRecord {
+  static constexpr size_t kIntFields = 16;
+  static constexpr size_t kDoubleFields = 8;
+  static constexpr size_t kTextFields = 8;
+
+  std::array<std::optional<int64_t>, kIntFields> ints;
+  std::array<std::optional<double>, kDoubleFields> doubles;
+  std::array<std::optional<std::string>, kTextFields> texts;
+};
+
+struct SparseMessage {
+  std::vector<SparseRecord> records;
+};
+
+// String-heavy records
+struct StringRecord {
+  std::string name;
+  std::string email;
+  std::string city;
+  std::string note;
+  std::vector<std::string> tags;
+};
+
+struct StringMessage {
+  std::vector<StringRecord> records;
+};
+
 // Result wrapper for error handling
 template<typename T>
 struct Result {
@@ -121,6 +184,7 @@ struct Result {
 
   Result() : error_code(ErrorCode::OK) {}
   explicit Result(const T& val) : value(val), error_code(ErrorCode::OK) {}
+  explicit Result(T&& val) : value(std::move(val)), error_code(ErrorCode::OK) {}
   Result(ErrorCode code, const std::string& msg)
     : error_code(code), error_message(msg) {}
 
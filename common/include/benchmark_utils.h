@@ -4,6 +4,7 @@
 #include <vector>
 #include <chrono>
 #include <string>
+#include <utility>
 
 namespace benchmark {
 namespace common {
@@ -22,7 +23,7 @@ inline int64_t GetTimestampMicros() {
   ).count();
 }
 
-// Simple CRC32 implementation for checksum
+// CRC32 (IEEE) for chunk checksums, slice-by-8
 class CRC32 {
 public:
   CRC32();
@@ -30,7 +31,7 @@ public:
   uint32_t Calculate(const std::vector<uint8_t>& data);
 
 private:
-  uint32_t table_[256];
+  uint32_t table_[8][256];
   void InitTable();
 };
 
@@ -53,6 +54,7 @@ double CalculateRequestsPerSecond(uint64_t count, int64_t duration_ns);
 class LatencyStats {
 public:
   void AddSample(int64_t latency_ns);
+  void Merge(const LatencyStats& other);
   void Reset();
 
   uint64_t GetCount() const { return count_; }
@@ -63,6 +65,13 @@ public:
   int64_t GetP95() const;
   int64_t GetP99() const;
 
+  // Value at the given quantile in [0, 1]
+  int64_t GetPercentile(double percentile) const;
+
+  // Sample counts in power-of-two buckets, as (upper bound ns, count)
+  // pairs from the bucket holding the minimum to the one holding the max
+  std::vector<std::pair<int64_t, uint64_t>> GetHistogram() const;
+
   std::string ToString() const;
 
 private:
@@ -74,7 +83,6 @@ private:
   bool sorted_ = false;
 
   void EnsureSorted();
-  int64_t GetPercentile(double percentile) const;
 };
 
 } // namespace utils
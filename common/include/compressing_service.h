@@ -0,0 +1,133 @@
+#pragma once
+
+#include "benchmark_service.h"
+#include "compression.h"
+#include <memory>
+
+namespace benchmark {
+namespace common {
+namespace compression {
+
+// Which end of the call a CompressingService sits on. Clients pack the
+// payloads of requests and unpack those of responses; servers do the
+// reverse around the real service.
+enum class Side { kClient, kServer };
+
+// Decorator that packs the payload fields (echo message, DataChunk data,
+// BatchItem data, BatchResult result_data) of everything it sends and
+// unpacks everything it receives, so any framework carries them
+// compressed. Both ends of a call must use the same compressor.
+class CompressingService : public IBenchmarkService {
+public:
+  CompressingService(IBenchmarkService* inner, Side side, PayloadCodec codec,
+                     Thresholds thresholds);
+
+  Result<EchoResponse> Echo(const EchoRequest& request) override;
+
+  void EchoAsync(
+      const EchoRequest& request,
+      ResponseCallback<EchoResponse> callback) override;
+
+  void StreamData(
+      const StreamRequest& request,
+      StreamCallback<DataChunk> on_chunk,
+      CompletionCallback on_complete) override;
+
+  void UploadData(
+      StreamCallback<DataChunk>& chunk_provider,
+      ResponseCallback<UploadResponse> on_complete) override;
+
+  void BidirectionalStream(
+      StreamCallback<DataChunk>& chunk_provider,
+      StreamCallback<DataChunk> on_chunk,
+      CompletionCallback on_complete) override;
+
+  Result<BatchResponse> BatchProcess(const BatchRequest& request) override;
+
+  void BatchProcessAsync(
+      const BatchRequest& request,
+      ResponseCallback<BatchResponse> callback) override;
+
+  Result<EchoResponse> EchoChain(const EchoRequest& request, uint32_t length) override;
+
+  Result<NestedMessage> EchoShape(const NestedMessage& request) override;
+  Result<ArrayMessage> EchoShape(const ArrayMessage& request) override;
+  Result<MapMessage> EchoShape(const MapMessage& request) override;
+  Result<SparseMessage> EchoShape(const SparseMessage& request) override;
+  Result<StringMessage> EchoShape(const StringMessage& request) override;
+
+private:
+  // Requests go out on the client and come in on the server
+  bool Outgoing(bool request) const { return request == (side_ == Side::kClient); }
+
+  bool Convert(const EchoRequest& from, EchoRequest* to) const;
+  bool Convert(EchoResponse* message) const;
+  bool Convert(const BatchRequest& from, BatchRequest* to) const;
+  bool Convert(BatchResponse* message) const;
+
+  // Chunks flow client to server in uploads and server to client otherwise
+  bool ConvertChunk(DataChunk* chunk, bool to_server) const;
+
+  template<typename T>
+  ResponseCallback<T> ConvertingCallback(ResponseCallback<T> callback) const;
+
+  IBenchmarkService* inner_;
+  Side side_;
+  PayloadCodec codec_;
+  Thresholds thresholds_;
+};
+
+// The service above applied as a server, owning the real service
+class CompressingServerService : public CompressingService {
+public:
+  CompressingServerService(std::shared_ptr<IBenchmarkService> inner, PayloadCodec codec,
+                           Thresholds thresholds);
+
+private:
+  std::shared_ptr<IBenchmarkService> owned_;
+};
+
+// Client wrapper that hands out a client-side CompressingService around
+// the wrapped client's service
+class CompressingClient : public IBenchmarkClient {
+public:
+  CompressingClient(std::unique_ptr<IBenchmarkClient> inner, PayloadCodec codec,
+                    Thresholds thresholds);
+
+  IBenchmarkService* GetService() override;
+  bool Connect(const std::string& address) override;
+  void Disconnect() override;
+  bool IsConnected() const override;
+
+private:
+  std::unique_ptr<IBenchmarkClient> inner_;
+  PayloadCodec codec_;
+  Thresholds thresholds_;
+  std::unique_ptr<CompressingService> service_;
+};
+
+// Factory wrapper that compresses both ends of every framework call. Its
+// clients and the servers it starts in this process count into `stats`; a
+// forked or external server counts its half in its own process.
+class CompressingFactory : public IFrameworkFactory {
+public:
+  CompressingFactory(std::unique_ptr<IFrameworkFactory> inner,
+                     std::shared_ptr<const ICompressor> compressor, Thresholds thresholds,
+                     std::shared_ptr<Stats> stats);
+
+  std::string GetName() const override;
+  bool IsInProcess() const override;
+  std::unique_ptr<IBenchmarkClient> CreateClient() override;
+  std::unique_ptr<IBenchmarkServer> CreateServer(
+      std::shared_ptr<IBenchmarkService> service) override;
+
+private:
+  std::unique_ptr<IFrameworkFactory> inner_;
+  std::shared_ptr<const ICompressor> compressor_;
+  Thresholds thresholds_;
+  std::shared_ptr<Stats> stats_;
+};
+
+} // namespace compression
+} // namespace common
+} // namespace benchmark
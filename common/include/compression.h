@@ -0,0 +1,115 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace benchmark {
+namespace common {
+namespace compression {
+
+// A block compressor. Implementations are stateless between calls and
+// safe to share across threads.
+class ICompressor {
+public:
+  virtual ~ICompressor() = default;
+
+  virtual std::string GetName() const = 0;
+
+  // Method id written into each compressed payload, so a peer configured
+  // with another compressor rejects it instead of misreading it
+  virtual uint8_t GetMethod() const = 0;
+
+  // Upper bound of Compress() output for `size` input bytes
+  virtual size_t MaxCompressedSize(size_t size) const = 0;
+
+  // Upper bound of Decompress() output for `size` compressed bytes, so a
+  // corrupt raw size is rejected before the receiver allocates it
+  virtual size_t MaxDecompressedSize(size_t size) const = 0;
+
+  // Compress `size` bytes into `out`, which holds MaxCompressedSize(size)
+  // bytes; returns the compressed size, or 0 on failure
+  virtual size_t Compress(const uint8_t* data, size_t size, uint8_t* out) const = 0;
+
+  // Decompress into `out`, which must come out at exactly `raw_size`
+  // bytes; false if the input is corrupt or has another size
+  virtual bool Decompress(const uint8_t* data, size_t size, uint8_t* out,
+                          size_t raw_size) const = 0;
+};
+
+// Built-in LZ77 compressor: byte-aligned literal runs and 64K-window
+// matches, tuned for speed over ratio
+std::unique_ptr<ICompressor> CreateLzCompressor();
+
+// The compressor called `name` ("lz", or "zlib" where zlib was found);
+// nullptr if there is none
+std::unique_ptr<ICompressor> CreateCompressor(const std::string& name);
+
+// Names accepted by CreateCompressor() in this build
+std::vector<std::string> CompressorNames();
+
+// Smallest payload compressed per field; smaller ones are sent stored
+struct Thresholds {
+  size_t echo = 256;
+  size_t chunk = 256;
+  size_t batch = 256;
+};
+
+// Parse "<bytes>" for all fields or "echo=<bytes>,chunk=<bytes>,batch=<bytes>"
+// with any subset of the keys; sizes take a K/M suffix
+bool ParseThresholds(const std::string& text, Thresholds* thresholds);
+
+// Counters of one compression stage, shared by its clients and servers
+struct Stats {
+  std::atomic<uint64_t> packed{0};          // payloads sent through the stage
+  std::atomic<uint64_t> compressed{0};      // of those, sent compressed
+  std::atomic<uint64_t> raw_bytes{0};       // payload bytes before packing
+  std::atomic<uint64_t> wire_bytes{0};      // payload bytes after packing
+  std::atomic<uint64_t> compress_ns{0};
+  std::atomic<uint64_t> unpacked{0};        // payloads received
+  std::atomic<uint64_t> unpacked_bytes{0};  // payload bytes after unpacking
+  std::atomic<uint64_t> decompress_ns{0};
+  std::atomic<uint64_t> errors{0};          // payloads that failed to unpack
+
+  void Reset();
+};
+
+// Frames payloads for the stage. A packed payload is a method byte, 0 for
+// stored or the compressor's method, then for compressed payloads the raw
+// size as u32 and the compressed bytes. Empty payloads pass unchanged, as
+// streams end on an empty chunk.
+class PayloadCodec {
+public:
+  PayloadCodec(std::shared_ptr<const ICompressor> compressor, std::shared_ptr<Stats> stats)
+    : compressor_(std::move(compressor)), stats_(std::move(stats)) {}
+
+  // Pack `size` bytes into `out`, compressing from `threshold` bytes on
+  void Pack(const uint8_t* data, size_t size, size_t threshold, std::string* out) const;
+  void Pack(const uint8_t* data, size_t size, size_t threshold, std::vector<uint8_t>* out) const;
+
+  // Unpack in place; false if the payload is corrupt
+  bool Unpack(std::string* payload) const;
+  bool Unpack(std::vector<uint8_t>* payload) const;
+
+private:
+  template<typename Buffer>
+  void PackInto(const uint8_t* data, size_t size, size_t threshold, Buffer* out) const;
+
+  template<typename Buffer>
+  bool UnpackInPlace(Buffer* payload) const;
+
+  std::shared_ptr<const ICompressor> compressor_;
+  std::shared_ptr<Stats> stats_;
+};
+
+// Effective payload throughput in bytes/s over a link of
+// `link_bytes_per_second`, with the stage's CPU time and its wire bytes
+// paid one after the other. Without compression this is the link rate.
+double EffectiveThroughput(const Stats& stats, double link_bytes_per_second);
+
+} // namespace compression
+} // namespace common
+} // namespace benchmark
@@ -0,0 +1,550 @@
+#pragma once
+
+#include "benchmark_types.h"
+#include "wire_format.h"
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+
+namespace benchmark {
+namespace common {
+namespace flat {
+
+// Flat encoding of the common types, read in place with no parse step.
+// Every message is one little-endian block:
+//
+//   u16 version | u16 kind | u32 size | root record | lists | blobs
+//
+// The root record holds the fixed-size fields at their natural alignment.
+// Strings and byte arrays are Refs {u32 offset, u32 length} to blobs, and
+// lists are Refs {offset, count} to arrays of fixed-size item records;
+// offsets count from the block start. Records, lists and blobs start on
+// 8-byte boundaries of the block and all padding is zero.
+//
+// Open() validates the header and every Ref against the block once, in
+// time proportional to the number of fields and never to the payload.
+// After that a view's accessors read straight from the buffer without
+// further checks; views borrow the buffer and must not outlive it.
+//
+// Fields are read with memcpy, so a block need not sit on an aligned
+// address (frame bodies follow a 12-byte header), but one that does reads
+// every field aligned. A change to any layout bumps kVersion.
+
+constexpr uint16_t kVersion = 1;
+constexpr size_t kHeaderSize = 8;
+constexpr size_t kAlignment = 8;
+
+enum class Kind : uint16_t {
+  kEchoRequest = 1,
+  kEchoResponse = 2,
+  kStreamRequest = 3,
+  kDataChunk = 4,
+  kUploadResponse = 5,
+  kBatchRequest = 6,
+  kBatchResponse = 7,
+  kEchoChainRequest = 8,
+  kStatus = 9,
+  kNestedMessage = 10,
+  kArrayMessage = 11,
+  kMapMessage = 12,
+  kSparseMessage = 13,
+  kStringMessage = 14
+};
+
+// Trees nested deeper than this are rejected, as protobuf does by default
+constexpr size_t kMaxTreeDepth = 100;
+
+inline size_t AlignUp(size_t size) {
+  return (size + kAlignment - 1) & ~(kAlignment - 1);
+}
+
+// A byte array read in place
+struct ByteView {
+  const uint8_t* data = nullptr;
+  size_t size = 0;
+
+  bool empty() const { return size == 0; }
+};
+
+// Accessors shared by the record views. A view is a pointer to its record
+// and to the block that its Refs point into.
+class RecordView {
+public:
+  RecordView() = default;
+  RecordView(const uint8_t* block, const uint8_t* record) : block_(block), record_(record) {}
+
+protected:
+  template<typename T>
+  T Load(size_t offset) const {
+    T value;
+    std::memcpy(&value, record_ + offset, sizeof(T));
+    return value;
+  }
+
+  ByteView Blob(size_t offset) const {
+    return ByteView{block_ + Load<uint32_t>(offset), Load<uint32_t>(offset + 4)};
+  }
+
+  std::string_view Text(size_t offset) const {
+    ByteView bytes = Blob(offset);
+    return std::string_view(reinterpret_cast<const char*>(bytes.data), bytes.size);
+  }
+
+  // Validation of one Ref: `length` items of `item_size` bytes in bounds
+  static bool CheckRef(size_t block_size, const uint8_t* record, size_t offset,
+                       size_t item_size = 1);
+
+  // Validation of the list Ref at `offset` and of every `Item` in it
+  template<typename Item>
+  static bool CheckList(const uint8_t* block, size_t block_size, const uint8_t* record,
+                        size_t offset) {
+    if (!CheckRef(block_size, record, offset, Item::kRecordSize)) return false;
+    uint32_t start = 0;
+    uint32_t count = 0;
+    std::memcpy(&start, record + offset, 4);
+    std::memcpy(&count, record + offset + 4, 4);
+    for (size_t i = 0; i < count; i++) {
+      if (!Item::Check(block, block_size, block + start + i * Item::kRecordSize)) return false;
+    }
+    return true;
+  }
+
+  const uint8_t* block_ = nullptr;
+  const uint8_t* record_ = nullptr;
+};
+
+// Array of fixed-size item records
+template<typename Item>
+class ListView : public RecordView {
+public:
+  ListView() = default;
+  ListView(const uint8_t* block, const uint8_t* items, size_t count)
+    : RecordView(block, items), count_(count) {}
+
+  size_t size() const { return count_; }
+  Item operator[](size_t index) const {
+    return Item(block_, record_ + index * Item::kRecordSize);
+  }
+
+private:
+  size_t count_ = 0;
+};
+
+class EchoRequestView : public RecordView {
+public:
+  static constexpr Kind kKind = Kind::kEchoRequest;
+  static constexpr size_t kRecordSize = 24;
+  using RecordView::RecordView;
+
+  int64_t timestamp() const { return Load<int64_t>(0); }
+  uint32_t sequence_number() const { return Load<uint32_t>(8); }
+  std::string_view message() const { return Text(16); }
+
+  static bool Check(const uint8_t* block, size_t size, const uint8_t* record);
+};
+
+class EchoResponseView : public RecordView {
+public:
+  static constexpr Kind kKind = Kind::kEchoResponse;
+  static constexpr size_t kRecordSize = 32;
+  using RecordView::RecordView;
+
+  int64_t client_timestamp() const { return Load<int64_t>(0); }
+  int64_t server_timestamp() const { return Load<int64_t>(8); }
+  uint32_t sequence_number() const { return Load<uint32_t>(16); }
+  std::string_view message() const { return Text(24); }
+
+  static bool Check(const uint8_t* block, size_t size, const uint8_t* record);
+};
+
+class StreamRequestView : public RecordView {
+public:
+  static constexpr Kind kKind = Kind::kStreamRequest;
+  static constexpr size_t kRecordSize = 16;
+  using RecordView::RecordView;
+
+  uint32_t chunk_size() const { return Load<uint32_t>(0); }
+  uint32_t chunk_count() const { return Load<uint32_t>(4); }
+  uint32_t delay_ms() const { return Load<uint32_t>(8); }
+
+  static bool Check(const uint8_t*, size_t, const uint8_t*) { return true; }
+};
+
+class DataChunkView : public RecordView {
+public:
+  static constexpr Kind kKind = Kind::kDataChunk;
+  static constexpr size_t kRecordSize = 24;
+  using RecordView::RecordView;
+
+  int64_t timestamp() const { return Load<int64_t>(0); }
+  uint32_t sequence_number() const { return Load<uint32_t>(8); }
+  uint32_t checksum() const { return Load<uint32_t>(12); }
+  ByteView data() const { return Blob(16); }
+
+  static bool Check(const uint8_t* block, size_t size, const uint8_t* record);
+};
+
+class UploadResponseView : public RecordView {
+public:
+  static constexpr Kind kKind = Kind::kUploadResponse;
+  static constexpr size_t kRecordSize = 24;
+  using RecordView::RecordView;
+
+  uint64_t total_bytes() const { return Load<uint64_t>(0); }
+  int64_t duration_ns() const { return Load<int64_t>(8); }
+  uint32_t chunk_count() const { return Load<uint32_t>(16); }
+  bool checksum_valid() const { return Load<uint8_t>(20) != 0; }
+
+  static bool Check(const uint8_t*, size_t, const uint8_t*) { return true; }
+};
+
+class BatchItemView : public RecordView {
+public:
+  static constexpr size_t kRecordSize = 24;
+  using RecordView::RecordView;
+
+  std::string_view id() const { return Text(0); }
+  std::string_view operation() const { return Text(8); }
+  ByteView data() const { return Blob(16); }
+
+  static bool Check(const uint8_t* block, size_t size, const uint8_t* record);
+};
+
+class BatchRequestView : public RecordView {
+public:
+  static constexpr Kind kKind = Kind::kBatchRequest;
+  static constexpr size_t kRecordSize = 16;
+  using RecordView::RecordView;
+
+  ListView<BatchItemView> items() const {
+    return ListView<BatchItemView>(block_, block_ + Load<uint32_t>(0), Load<uint32_t>(4));
+  }
+  bool fail_on_error() const { return Load<uint8_t>(8) != 0; }
+
+  static bool Check(const uint8_t* block, size_t size, const uint8_t* record);
+};
+
+class BatchResultView : public RecordView {
+public:
+  static constexpr size_t kRecordSize = 32;
+  using RecordView::RecordView;
+
+  std::string_view id() const { return Text(0); }
+  std::string_view error_message() const { return Text(8); }
+  ByteView result_data() const { return Blob(16); }
+  bool success() const { return Load<uint8_t>(24) != 0; }
+
+  static bool Check(const uint8_t* block, size_t size, const uint8_t* record);
+};
+
+class BatchResponseView : public RecordView {
+public:
+  static constexpr Kind kKind = Kind::kBatchResponse;
+  static constexpr size_t kRecordSize = 16;
+  using RecordView::RecordView;
+
+  ListView<BatchResultView> results() const {
+    return ListView<BatchResultView>(block_, block_ + Load<uint32_t>(0), Load<uint32_t>(4));
+  }
+  uint32_t total_processed() const { return Load<uint32_t>(8); }
+  uint32_t total_failed() const { return Load<uint32_t>(12); }
+
+  static bool Check(const uint8_t* block, size_t size, const uint8_t* record);
+};
+
+// The chain length, then the first request's record inline
+class EchoChainRequestView : public RecordView {
+public:
+  static constexpr Kind kKind = Kind::kEchoChainRequest;
+  static constexpr size_t kRecordSize = 8 + EchoRequestView::kRecordSize;
+  using RecordView::RecordView;
+
+  uint32_t length() const { return Load<uint32_t>(0); }
+  EchoRequestView request() const { return EchoRequestView(block_, record_ + 8); }
+
+  static bool Check(const uint8_t* block, size_t size, const uint8_t* record);
+};
+
+class StatusView : public RecordView {
+public:
+  static constexpr Kind kKind = Kind::kStatus;
+  static constexpr size_t kRecordSize = 16;
+  using RecordView::RecordView;
+
+  uint32_t code() const { return Load<uint32_t>(0); }
+  std::string_view message() const { return Text(8); }
+
+  static bool Check(const uint8_t* block, size_t size, const uint8_t* record);
+};
+
+// Array of scalars, read in place
+template<typename T>
+class ScalarListView {
+public:
+  ScalarListView() = default;
+  ScalarListView(const uint8_t* items, size_t count) : items_(items), count_(count) {}
+
+  size_t size() const { return count_; }
+  T operator[](size_t index) const {
+    T value;
+    std::memcpy(&value, items_ + index * sizeof(T), sizeof(T));
+    return value;
+  }
+
+  // The raw little-endian array, for bulk copies
+  const uint8_t* bytes() const { return items_; }
+
+private:
+  const uint8_t* items_ = nullptr;
+  size_t count_ = 0;
+};
+
+// One string of a list of strings
+class TextItemView : public RecordView {
+public:
+  static constexpr size_t kRecordSize = 8;
+  using RecordView::RecordView;
+
+  std::string_view value() const { return Text(0); }
+
+  static bool Check(const uint8_t* block, size_t size, const uint8_t* record);
+};
+
+// A tree node's children are a list of node records. Encoders write the
+// records breadth first, so a tree's records are one contiguous run.
+class TreeNodeView : public RecordView {
+public:
+  static constexpr size_t kRecordSize = 32;
+  using RecordView::RecordView;
+
+  int64_t id() const { return Load<int64_t>(0); }
+  double weight() const { return Load<double>(8); }
+  std::string_view label() const { return Text(16); }
+  ListView<TreeNodeView> children() const {
+    return ListView<TreeNodeView>(block_, block_ + Load<uint32_t>(24), Load<uint32_t>(28));
+  }
+
+  // Checks the whole subtree, at most kMaxTreeDepth deep. A block of
+  // `size` bytes holds no more than size / kRecordSize genuine nodes, so
+  // the walk stops there and lists that overlap or loop cannot stretch it.
+  static bool Check(const uint8_t* block, size_t size, const uint8_t* record);
+
+private:
+  static bool CheckSubtree(const uint8_t* block, size_t size, const uint8_t* record,
+                           size_t depth, size_t* budget);
+};
+
+// The root node's record inline
+class NestedMessageView : public RecordView {
+public:
+  static constexpr Kind kKind = Kind::kNestedMessage;
+  static constexpr size_t kRecordSize = TreeNodeView::kRecordSize;
+  using RecordView::RecordView;
+
+  TreeNodeView root() const { return TreeNodeView(block_, record_); }
+
+  static bool Check(const uint8_t* block, size_t size, const uint8_t* record) {
+    return TreeNodeView::Check(block, size, record);
+  }
+};
+
+class ArrayMessageView : public RecordView {
+public:
+  static constexpr Kind kKind = Kind::kArrayMessage;
+  static constexpr size_t kRecordSize = 24;
+  using RecordView::RecordView;
+
+  ScalarListView<int64_t> values() const { return Scalars<int64_t>(0); }
+  ScalarListView<double> samples() const { return Scalars<double>(8); }
+  ScalarListView<uint32_t> counts() const { return Scalars<uint32_t>(16); }
+
+  static bool Check(const uint8_t* block, size_t size, const uint8_t* record);
+
+private:
+  template<typename T>
+  ScalarListView<T> Scalars(size_t offset) const {
+    return ScalarListView<T>(block_ + Load<uint32_t>(offset), Load<uint32_t>(offset + 4));
+  }
+};
+
+class CounterEntryView : public RecordView {
+public:
+  static constexpr size_t kRecordSize = 16;
+  using RecordView::RecordView;
+
+  std::string_view key() const { return Text(0); }
+  int64_t value() const { return Load<int64_t>(8); }
+
+  static bool Check(const uint8_t* block, size_t size, const uint8_t* record);
+};
+
+class LabelEntryView : public RecordView {
+public:
+  static constexpr size_t kRecordSize = 16;
+  using RecordView::RecordView;
+
+  uint32_t key() const { return Load<uint32_t>(0); }
+  std::string_view value() const { return Text(8); }
+
+  static bool Check(const uint8_t* block, size_t size, const uint8_t* record);
+};
+
+// Maps are lists of entries in key order
+class MapMessageView : public RecordView {
+public:
+  static constexpr Kind kKind = Kind::kMapMessage;
+  static constexpr size_t kRecordSize = 16;
+  using RecordView::RecordView;
+
+  ListView<CounterEntryView> counters() const {
+    return ListView<CounterEntryView>(block_, block_ + Load<uint32_t>(0), Load<uint32_t>(4));
+  }
+  ListView<LabelEntryView> labels() const {
+    return ListView<LabelEntryView>(block_, block_ + Load<uint32_t>(8), Load<uint32_t>(12));
+  }
+
+  static bool Check(const uint8_t* block, size_t size, const uint8_t* record);
+};
+
+// Every field has its slot; bit i of present() marks int field i, bit
+// 16 + i double field i and bit 24 + i text field i. Unset slots are zero.
+class SparseRecordView : public RecordView {
+public:
+  static constexpr size_t kRecordSize = 8 + 8 * (SparseRecord::kIntFields +
+                                                 SparseRecord::kDoubleFields +
+                                                 SparseRecord::kTextFields);
+  static constexpr size_t kDoubleBit = SparseRecord::kIntFields;
+  static constexpr size_t kTextBit = kDoubleBit + SparseRecord::kDoubleFields;
+  using RecordView::RecordView;
+
+  uint32_t present() const { return Load<uint32_t>(0); }
+  int64_t int_value(size_t index) const { return Load<int64_t>(8 + 8 * index); }
+  double double_value(size_t index) const { return Load<double>(8 + 8 * (kDoubleBit + index)); }
+  std::string_view text_value(size_t index) const { return Text(8 + 8 * (kTextBit + index)); }
+
+  static bool Check(const uint8_t* block, size_t size, const uint8_t* record);
+};
+
+class SparseMessageView : public RecordView {
+public:
+  static constexpr Kind kKind = Kind::kSparseMessage;
+  static constexpr size_t kRecordSize = 8;
+  using RecordView::RecordView;
+
+  ListView<SparseRecordView> records() const {
+    return ListView<SparseRecordView>(block_, block_ + Load<uint32_t>(0), Load<uint32_t>(4));
+  }
+
+  static bool Check(const uint8_t* block, size_t size, const uint8_t* record);
+};
+
+class StringRecordView : public RecordView {
+public:
+  static constexpr size_t kRecordSize = 40;
+  using RecordView::RecordView;
+
+  std::string_view name() const { return Text(0); }
+  std::string_view email() const { return Text(8); }
+  std::string_view city() const { return Text(16); }
+  std::string_view note() const { return Text(24); }
+  ListView<TextItemView> tags() const {
+    return ListView<TextItemView>(block_, block_ + Load<uint32_t>(32), Load<uint32_t>(36));
+  }
+
+  static bool Check(const uint8_t* block, size_t size, const uint8_t* record);
+};
+
+class StringMessageView : public RecordView {
+public:
+  static constexpr Kind kKind = Kind::kStringMessage;
+  static constexpr size_t kRecordSize = 8;
+  using RecordView::RecordView;
+
+  ListView<StringRecordView> records() const {
+    return ListView<StringRecordView>(block_, block_ + Load<uint32_t>(0), Load<uint32_t>(4));
+  }
+
+  static bool Check(const uint8_t* block, size_t size, const uint8_t* record);
+};
+
+// The kind in a block's header, before Open(); false if `size` cannot hold
+// a header
+bool PeekKind(const uint8_t* data, size_t size, Kind* kind);
+
+// Validates the header: version, kind, and a size that covers the root
+// record and fits in `size` bytes. Sets `block_size` from the header.
+bool CheckHeader(const uint8_t* data, size_t size, Kind kind, size_t record_size,
+                 size_t* block_size);
+
+// Opens the block at `data` as a `View`. False if the version or kind is
+// not the expected one or any Ref points outside the block.
+template<typename View>
+bool Open(const uint8_t* data, size_t size, View* view) {
+  size_t block_size = 0;
+  if (!CheckHeader(data, size, View::kKind, View::kRecordSize, &block_size)) return false;
+  const uint8_t* record = data + kHeaderSize;
+  if (!View::Check(data, block_size, record)) return false;
+  *view = View(data, record);
+  return true;
+}
+
+// Encoded size of a message's block
+size_t EncodedSize(const EchoRequest& message);
+size_t EncodedSize(const EchoResponse& message);
+size_t EncodedSize(const StreamRequest& message);
+size_t EncodedSize(const DataChunk& message);
+size_t EncodedSize(const UploadResponse& message);
+size_t EncodedSize(const BatchRequest& message);
+size_t EncodedSize(const BatchResponse& message);
+size_t EncodedSize(const wire::EchoChainRequest& message);
+size_t EncodedSize(const NestedMessage& message);
+size_t EncodedSize(const ArrayMessage& message);
+size_t EncodedSize(const MapMessage& message);
+size_t EncodedSize(const SparseMessage& message);
+size_t EncodedSize(const StringMessage& message);
+
+// Write a message's block front to back through `writer`
+void Encode(const EchoRequest& message, wire::WireWriter* writer);
+void Encode(const EchoResponse& message, wire::WireWriter* writer);
+void Encode(const StreamRequest& message, wire::WireWriter* writer);
+void Encode(const DataChunk& message, wire::WireWriter* writer);
+void Encode(const UploadResponse& message, wire::WireWriter* writer);
+void Encode(const BatchRequest& message, wire::WireWriter* writer);
+void Encode(const BatchResponse& message, wire::WireWriter* writer);
+void Encode(const wire::EchoChainRequest& message, wire::WireWriter* writer);
+void Encode(const NestedMessage& message, wire::WireWriter* writer);
+void Encode(const ArrayMessage& message, wire::WireWriter* writer);
+void Encode(const MapMessage& message, wire::WireWriter* writer);
+void Encode(const SparseMessage& message, wire::WireWriter* writer);
+void Encode(const StringMessage& message, wire::WireWriter* writer);
+void EncodeStatus(ErrorCode code, const std::string& message, wire::WireWriter* writer);
+
+// Copy a view out into the common type, reusing the target's buffers
+void CopyOut(EchoRequestView view, EchoRequest* to);
+void CopyOut(EchoResponseView view, EchoResponse* to);
+void CopyOut(StreamRequestView view, StreamRequest* to);
+void CopyOut(DataChunkView view, DataChunk* to);
+void CopyOut(UploadResponseView view, UploadResponse* to);
+void CopyOut(BatchRequestView view, BatchRequest* to);
+void CopyOut(BatchResponseView view, BatchResponse* to);
+void CopyOut(EchoChainRequestView view, wire::EchoChainRequest* to);
+void CopyOut(NestedMessageView view, NestedMessage* to);
+void CopyOut(ArrayMessageView view, ArrayMessage* to);
+void CopyOut(MapMessageView view, MapMessage* to);
+void CopyOut(SparseMessageView view, SparseMessage* to);
+void CopyOut(StringMessageView view, StringMessage* to);
+
+// Open and copy out in one step
+template<typename View, typename T>
+bool Decode(const uint8_t* data, size_t size, T* message) {
+  View view;
+  if (!Open(data, size, &view)) return false;
+  CopyOut(view, message);
+  return true;
+}
+
+} // namespace flat
+} // namespace common
+} // namespace benchmark
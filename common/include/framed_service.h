@@ -0,0 +1,171 @@
+#pragma once
+
+#include "benchmark_service.h"
+#include "wire_format.h"
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+namespace benchmark {
+namespace common {
+
+class WorkStealingExecutor;
+
+namespace wire {
+
+// Transport-independent halves of the native framed protocol. A transport
+// only moves frames; these classes turn service calls into frames on the
+// client and frames back into service calls on the server.
+
+// Fills in a frame body through the given writer
+using BodyEncoder = std::function<void(WireWriter* writer)>;
+
+// Sending side of a connection. SendFrame() must be safe to call from
+// several threads and either writes the whole frame or returns false.
+class FrameSender {
+public:
+  virtual ~FrameSender() = default;
+
+  // body_size is exact; transports may reserve space and encode in place
+  virtual bool SendFrame(MessageType type, uint32_t call_id,
+                         size_t body_size, const BodyEncoder& encode) = 0;
+};
+
+// Encode `message` as the body of one frame
+template<typename T>
+bool SendMessage(FrameSender* sender, MessageType type, uint32_t call_id, const T& message) {
+  return sender->SendFrame(type, call_id, EncodedSize(message),
+                           [&message](WireWriter* writer) { Encode(message, writer); });
+}
+
+bool SendStatus(FrameSender* sender, MessageType type, uint32_t call_id,
+                ErrorCode code, const std::string& message);
+
+// Client side: outstanding calls by call id. The transport's receive path
+// hands every incoming frame to Deliver().
+class CallTable {
+public:
+  // Handles the frames of one call and returns true once the call is done.
+  // A null header signals that the connection was lost.
+  using Handler = std::function<bool(const FrameHeader* header, WireReader* reader)>;
+
+  uint32_t NextCallId() { return next_call_id_.fetch_add(1, std::memory_order_relaxed); }
+
+  void Register(uint32_t call_id, Handler handler);
+
+  // Returns true if the call was still outstanding
+  bool Remove(uint32_t call_id);
+
+  void Deliver(const FrameHeader& header, const uint8_t* body);
+
+  // Fail every outstanding call, e.g. after the connection dropped
+  void FailAll();
+
+private:
+  std::mutex mutex_;
+  std::unordered_map<uint32_t, std::shared_ptr<Handler>> calls_;
+  std::atomic<uint32_t> next_call_id_{1};
+};
+
+// Client-side stub that implements the full service over a sender and a
+// call table. Thread-safe; async callbacks and stream chunks run on the
+// transport's receive thread.
+class FramedServiceStub : public IBenchmarkService {
+public:
+  FramedServiceStub(FrameSender* sender, CallTable* calls)
+    : sender_(sender), calls_(calls) {}
+
+  Result<EchoResponse> Echo(const EchoRequest& request) override;
+
+  void EchoAsync(
+      const EchoRequest& request,
+      ResponseCallback<EchoResponse> callback) override;
+
+  void StreamData(
+      const StreamRequest& request,
+      StreamCallback<DataChunk> on_chunk,
+      CompletionCallback on_complete) override;
+
+  void UploadData(
+      StreamCallback<DataChunk>& chunk_provider,
+      ResponseCallback<UploadResponse> on_complete) override;
+
+  void BidirectionalStream(
+      StreamCallback<DataChunk>& chunk_provider,
+      StreamCallback<DataChunk> on_chunk,
+      CompletionCallback on_complete) override;
+
+  Result<BatchResponse> BatchProcess(const BatchRequest& request) override;
+
+  void BatchProcessAsync(
+      const BatchRequest& request,
+      ResponseCallback<BatchResponse> callback) override;
+
+  // One frame for the whole chain; the server runs the links
+  Result<EchoResponse> EchoChain(const EchoRequest& request, uint32_t length) override;
+
+  Result<NestedMessage> EchoShape(const NestedMessage& request) override;
+  Result<ArrayMessage> EchoShape(const ArrayMessage& request) override;
+  Result<MapMessage> EchoShape(const MapMessage& request) override;
+  Result<SparseMessage> EchoShape(const SparseMessage& request) override;
+  Result<StringMessage> EchoShape(const StringMessage& request) override;
+
+private:
+  template<typename Request, typename Response>
+  void StartUnary(MessageType request_type, MessageType response_type,
+                  const Request& request, ResponseCallback<Response> callback);
+
+  template<typename Request, typename Response>
+  Result<Response> CallUnary(MessageType request_type, MessageType response_type,
+                             const Request& request);
+
+  bool StartClientStream(MessageType begin_type, MessageType chunk_type,
+                         CallTable::Handler handler,
+                         StreamCallback<DataChunk>& chunk_provider);
+
+  // Register `handler` and send the opening frame; false if the call never
+  // started and its callback has not run
+  bool StartCall(uint32_t call_id, CallTable::Handler handler,
+                 const std::function<bool()>& send);
+
+  FrameSender* sender_;
+  CallTable* calls_;
+};
+
+// Server side: decodes request frames of one connection and calls the
+// service. Responses, stream chunks and completions are sent through the
+// connection's sender, which async service callbacks keep alive. Not
+// thread-safe; feed it from the connection's receive thread.
+//
+// With an executor, unary handlers run on its workers and the receive
+// thread goes straight back to decoding; streams stay on the receive
+// thread, which owns their chunk sinks.
+class ServiceDispatcher {
+public:
+  ServiceDispatcher(std::shared_ptr<IBenchmarkService> service,
+                    std::shared_ptr<FrameSender> sender,
+                    WorkStealingExecutor* executor = nullptr)
+    : service_(std::move(service)), sender_(std::move(sender)), executor_(executor) {}
+
+  // Returns false on a protocol error; the connection should be closed
+  bool Dispatch(const FrameHeader& header, const uint8_t* body);
+
+private:
+  bool CheckSink(uint32_t call_id);
+
+  template<typename Message>
+  bool EchoShape(uint32_t call_id, WireReader* reader);
+
+  std::shared_ptr<IBenchmarkService> service_;
+  std::shared_ptr<FrameSender> sender_;
+  WorkStealingExecutor* executor_;
+
+  // Open client streams by call id
+  std::unordered_map<uint32_t, StreamCallback<DataChunk>> sinks_;
+};
+
+} // namespace wire
+} // namespace common
+} // namespace benchmark
@@ -0,0 +1,251 @@
+#pragma once
+
+#include "wait_strategy.h"
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+
+namespace benchmark {
+namespace common {
+
+// Queues that hand work from one thread to another, from the simplest to
+// the most specialized. They only move items; waiting for an item is left
+// to the caller (see Doorbell), except for the mutex queue, whose
+// condition variable is part of the design being measured.
+
+// Spacing that keeps independently written atomics off each other's
+// cache lines
+constexpr size_t kCacheLineSize = 64;
+
+// Unbounded FIFO under one mutex; consumers block on a condition variable
+template <typename T>
+class MutexQueue {
+public:
+  // Returns false once closed
+  bool Push(const T& item) {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (closed_) return false;
+      items_.push_back(item);
+    }
+    not_empty_.notify_one();
+    return true;
+  }
+
+  // Wait until an item arrives or Close() is called. Returns false once
+  // closed and drained.
+  bool Pop(T* item) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    not_empty_.wait(lock, [this]() { return !items_.empty() || closed_; });
+    if (items_.empty()) return false;
+    *item = items_.front();
+    items_.pop_front();
+    return true;
+  }
+
+  void Close() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      closed_ = true;
+    }
+    not_empty_.notify_all();
+  }
+
+private:
+  std::mutex mutex_;
+  std::condition_variable not_empty_;
+  std::deque<T> items_;
+  bool closed_ = false;
+};
+
+// Bounded lock-free multi-producer multi-consumer ring (Dmitry Vyukov's
+// design). Each cell carries a sequence number that tells producers and
+// consumers whether it is theirs to fill or drain, so a push or pop is one
+// CAS on the shared position plus uncontended accesses to the cell.
+template <typename T>
+class MpmcRing {
+public:
+  // `capacity` is rounded up to a power of two
+  explicit MpmcRing(size_t capacity) {
+    size_t size = 2;
+    while (size < capacity) size <<= 1;
+    mask_ = size - 1;
+    cells_.reset(new Cell[size]);
+    for (size_t i = 0; i < size; i++) {
+      cells_[i].sequence.store(i, std::memory_order_relaxed);
+    }
+  }
+
+  // Returns false when the ring is full
+  bool TryPush(const T& item) {
+    size_t position = enqueue_.load(std::memory_order_relaxed);
+    while (true) {
+      Cell& cell = cells_[position & mask_];
+      size_t sequence = cell.sequence.load(std::memory_order_acquire);
+      intptr_t diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(position);
+      if (diff == 0) {
+        if (enqueue_.compare_exchange_weak(position, position + 1,
+                                           std::memory_order_relaxed)) {
+          cell.item = item;
+          cell.sequence.store(position + 1, std::memory_order_release);
+          return true;
+        }
+      } else if (diff < 0) {
+        return false;
+      } else {
+        position = enqueue_.load(std::memory_order_relaxed);
+      }
+    }
+  }
+
+  // Returns false when the ring is empty
+  bool TryPop(T* item) {
+    size_t position = dequeue_.load(std::memory_order_relaxed);
+    while (true) {
+      Cell& cell = cells_[position & mask_];
+      size_t sequence = cell.sequence.load(std::memory_order_acquire);
+      intptr_t diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(position + 1);
+      if (diff == 0) {
+        if (dequeue_.compare_exchange_weak(position, position + 1,
+                                           std::memory_order_relaxed)) {
+          *item = cell.item;
+          cell.sequence.store(position + mask_ + 1, std::memory_order_release);
+          return true;
+        }
+      } else if (diff < 0) {
+        return false;
+      } else {
+        position = dequeue_.load(std::memory_order_relaxed);
+      }
+    }
+  }
+
+  // A snapshot; only exact while no other thread pushes or pops
+  bool Empty() const {
+    return enqueue_.load(std::memory_order_acquire) == dequeue_.load(std::memory_order_acquire);
+  }
+
+private:
+  struct Cell {
+    std::atomic<size_t> sequence{0};
+    T item{};
+  };
+
+  std::unique_ptr<Cell[]> cells_;
+  size_t mask_ = 0;
+  alignas(kCacheLineSize) std::atomic<size_t> enqueue_{0};
+  alignas(kCacheLineSize) std::atomic<size_t> dequeue_{0};
+};
+
+// Bounded lock-free single-producer single-consumer ring. Each side keeps
+// a cached copy of the other side's index and only reloads it when the
+// ring looks full or empty, so steady traffic touches no shared line
+// besides the items themselves.
+template <typename T>
+class SpscRing {
+public:
+  // `capacity` is rounded up to a power of two
+  explicit SpscRing(size_t capacity) {
+    size_t size = 2;
+    while (size < capacity) size <<= 1;
+    mask_ = size - 1;
+    items_.reset(new T[size]);
+  }
+
+  // Producer only; returns false when the ring is full
+  bool TryPush(const T& item) {
+    size_t tail = tail_.load(std::memory_order_relaxed);
+    if (tail - cached_head_ > mask_) {
+      cached_head_ = head_.load(std::memory_order_acquire);
+      if (tail - cached_head_ > mask_) return false;
+    }
+    items_[tail & mask_] = item;
+    tail_.store(tail + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Consumer only; returns false when the ring is empty
+  bool TryPop(T* item) {
+    size_t head = head_.load(std::memory_order_relaxed);
+    if (head == cached_tail_) {
+      cached_tail_ = tail_.load(std::memory_order_acquire);
+      if (head == cached_tail_) return false;
+    }
+    *item = items_[head & mask_];
+    head_.store(head + 1, std::memory_order_release);
+    return true;
+  }
+
+  bool Empty() const {
+    return head_.load(std::memory_order_acquire) == tail_.load(std::memory_order_acquire);
+  }
+
+private:
+  std::unique_ptr<T[]> items_;
+  size_t mask_ = 0;
+  alignas(kCacheLineSize) std::atomic<size_t> head_{0};
+  size_t cached_tail_ = 0;  // Consumer's copy
+  alignas(kCacheLineSize) std::atomic<size_t> tail_{0};
+  size_t cached_head_ = 0;  // Producer's copy
+};
+
+// Waiting and wake-up for a consumer of the lock-free rings, under a
+// WaitStrategy. Ring() costs a producer one atomic load unless someone is
+// asleep, so a busy or spinning consumer never makes its producers enter
+// the kernel.
+class Doorbell {
+public:
+  explicit Doorbell(WaitStrategy strategy = WaitStrategy::kSpinFutex) : strategy_(strategy) {}
+
+  // Wait until `ready()` holds. A sleeper re-checks `ready` after
+  // announcing itself, so an item pushed meanwhile is never missed.
+  template <typename Ready>
+  void Wait(Ready ready) {
+    SpinWaiter waiter(strategy_, &budget_);
+    while (!ready()) {
+      if (waiter.Pause()) {
+        Sleep(ready);
+        return;
+      }
+    }
+  }
+
+  // Call after publishing an item; wakes one sleeper
+  void Ring() { Wake(1); }
+
+  // Wake every sleeper, e.g. to shut down
+  void RingAll() { Wake(INT32_MAX); }
+
+private:
+  template <typename Ready>
+  void Sleep(Ready ready) {
+    sleepers_.fetch_add(1, std::memory_order_seq_cst);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    while (true) {
+      uint32_t seq = seq_.load(std::memory_order_seq_cst);
+      if (ready()) break;
+      FutexWait(&seq_, seq);
+    }
+    sleepers_.fetch_sub(1, std::memory_order_relaxed);
+  }
+
+  void Wake(int count) {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (sleepers_.load(std::memory_order_relaxed) == 0) return;
+    // A sleeper that read the old sequence number returns from FutexWait
+    seq_.fetch_add(1, std::memory_order_seq_cst);
+    FutexWake(&seq_, count);
+  }
+
+  const WaitStrategy strategy_;
+  SpinBudget budget_;
+  std::atomic<uint32_t> seq_{0};
+  std::atomic<int> sleepers_{0};
+};
+
+} // namespace common
+} // namespace benchmark
@@ -2,9 +2,12 @@
 
 #include "benchmark_service.h"
 #include "reference_service.h"
+#include "wait_strategy.h"
+#include <array>
 #include <memory>
-#include <mutex>
-#include <map>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
 
 namespace benchmark {
 namespace inprocess {
@@ -13,6 +16,35 @@ namespace inprocess {
 // This implements the benchmark interfaces but runs everything in-process
 // Useful for baseline measurements and testing the benchmark framework itself
 
+// Address -> service map shared by in-process servers and clients. Entries
+// are spread over independently locked shards and lookups only take a
+// shared lock, so concurrent connects from many threads do not serialize
+// on one registry mutex.
+class ServiceRegistry {
+public:
+  static ServiceRegistry& Instance();
+
+  // Returns false if the address is already registered
+  bool Register(const std::string& address,
+                std::shared_ptr<common::IBenchmarkService> service);
+  void Unregister(const std::string& address);
+
+  // Returns nullptr if nothing is registered at the address
+  std::shared_ptr<common::IBenchmarkService> Lookup(const std::string& address) const;
+
+private:
+  static constexpr size_t kShardCount = 16;
+
+  struct alignas(64) Shard {
+    mutable std::shared_mutex mutex;
+    std::unordered_map<std::string, std::shared_ptr<common::IBenchmarkService>> services;
+  };
+
+  Shard& ShardFor(const std::string& address) const;
+
+  mutable std::array<Shard, kShardCount> shards_;
+};
+
 class InProcessClient : public common::IBenchmarkClient {
 public:
   InProcessClient();
@@ -31,7 +63,7 @@ private:
 class InProcessServer : public common::IBenchmarkServer {
 public:
   explicit InProcessServer(std::shared_ptr<common::IBenchmarkService> service);
-  ~InProcessServer() override = default;
+  ~InProcessServer() override;
 
   bool Start(const std::string& address) override;
   void Stop() override;
@@ -42,23 +74,81 @@ private:
   std::shared_ptr<common::IBenchmarkService> service_;
   std::string address_;
   bool running_;
+};
 
-  static std::mutex registry_mutex_;
-  static std::map<std::string, std::shared_ptr<common::IBenchmarkService>> registry_;
+class InProcessFactory : public common::IFrameworkFactory {
+public:
+  std::string GetName() const override;
+  bool IsInProcess() const override;
+  std::unique_ptr<common::IBenchmarkClient> CreateClient() override;
+  std::unique_ptr<common::IBenchmarkServer> CreateServer(
+      std::shared_ptr<common::IBenchmarkService> service) override;
+};
 
-  friend class InProcessClient;
+// Queue that carries calls from client threads to server worker threads
+// (see handoff_queue.h)
+enum class HandoffQueueKind {
+  kMutex,  // One mutex and condition variable queue for all workers
+  kMpmc,   // One lock-free MPMC ring for all workers
+  kSpsc,   // A lock-free SPSC ring per client thread, each drained by one worker
+  kSteal   // The shared work-stealing executor (see work_stealing_executor.h)
 };
 
-class InProcessFactory : public common::IFrameworkFactory {
+class HandoffService;
+
+// In-process server whose service runs on its own worker threads. Clients
+// find it through the registry like InProcessServer, but every call
+// crosses to a worker through the chosen queue and async callbacks run
+// there, so it measures the thread handoff and wake-up that every real
+// framework pays on top of its transport. Idle workers and callers waiting
+// for a reply wait under `wait`; with the mutex queue, idle workers always
+// block on its condition variable. kSteal uses the process's shared
+// executor, whose workers keep their own count and wait strategy.
+class ThreadedServer : public common::IBenchmarkServer {
 public:
+  // num_workers = 0 uses one worker per CPU in the process affinity mask
+  ThreadedServer(std::shared_ptr<common::IBenchmarkService> service, HandoffQueueKind queue,
+                 common::WaitStrategy wait = common::WaitStrategy::kSpinFutex,
+                 int num_workers = 0);
+  ~ThreadedServer() override;
+
+  bool Start(const std::string& address) override;
+  void Stop() override;
+  bool IsRunning() const override;
+  void Wait() override;
+
+private:
+  std::shared_ptr<common::IBenchmarkService> service_;
+  HandoffQueueKind queue_;
+  common::WaitStrategy wait_;
+  int num_workers_;
+  std::shared_ptr<HandoffService> handoff_;
+  std::string address_;
+};
+
+class ThreadedFactory : public common::IFrameworkFactory {
+public:
+  explicit ThreadedFactory(HandoffQueueKind queue,
+                           common::WaitStrategy wait = common::WaitStrategy::kSpinFutex,
+                           int num_workers = 0)
+    : queue_(queue), wait_(wait), num_workers_(num_workers) {}
+
   std::string GetName() const override;
+  bool IsInProcess() const override;
   std::unique_ptr<common::IBenchmarkClient> CreateClient() override;
   std::unique_ptr<common::IBenchmarkServer> CreateServer(
       std::shared_ptr<common::IBenchmarkService> service) override;
+
+private:
+  HandoffQueueKind queue_;
+  common::WaitStrategy wait_;
+  int num_workers_;
 };
 
-// Factory function
+// Factory functions
 std::unique_ptr<common::IFrameworkFactory> CreateInProcessFactory();
+std::unique_ptr<common::IFrameworkFactory> CreateThreadedFactory(HandoffQueueKind queue,
+                                                          common::WaitStrategy wait);
 
 } // namespace inprocess
 } // namespace benchmark
@@ -0,0 +1,57 @@
+#pragma once
+
+#include "benchmark_types.h"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace benchmark {
+namespace common {
+namespace shapes {
+
+// The message-zoo shapes of benchmark_types.h by name, with samples of
+// each at a given size for the shapes scenario and codec_bench
+
+enum class Shape { kNested, kArrays, kMap, kSparse, kStrings };
+
+constexpr Shape kAllShapes[] = {
+  Shape::kNested, Shape::kArrays, Shape::kMap, Shape::kSparse, Shape::kStrings
+};
+
+// "nested", "arrays", "map", "sparse" or "strings"
+const char* ShapeName(Shape shape);
+
+// Parse a comma-separated list of shape names, or "all"
+bool ParseShapeList(const std::string& text, std::vector<Shape>* shapes);
+
+// Samples with roughly `size` bytes of field data, the same for the same
+// seed:
+//   nested   a binary tree of labelled nodes, about log2(size / 28) deep
+//   arrays   three parallel arrays of int64, double and uint32
+//   map      a string-keyed and an integer-keyed map
+//   sparse   records of 32 optional fields with about a quarter set
+//   strings  person-like records of short strings and tag lists
+NestedMessage MakeNested(size_t size, uint64_t seed = 1);
+ArrayMessage MakeArrays(size_t size, uint64_t seed = 1);
+MapMessage MakeMap(size_t size, uint64_t seed = 1);
+SparseMessage MakeSparse(size_t size, uint64_t seed = 1);
+StringMessage MakeStrings(size_t size, uint64_t seed = 1);
+
+// Bytes of field data: scalars at their size, strings at their length
+size_t FieldBytes(const NestedMessage& message);
+size_t FieldBytes(const ArrayMessage& message);
+size_t FieldBytes(const MapMessage& message);
+size_t FieldBytes(const SparseMessage& message);
+size_t FieldBytes(const StringMessage& message);
+
+// Field-by-field equality, to check an echo came back unchanged
+bool Equal(const NestedMessage& a, const NestedMessage& b);
+bool Equal(const ArrayMessage& a, const ArrayMessage& b);
+bool Equal(const MapMessage& a, const MapMessage& b);
+bool Equal(const SparseMessage& a, const SparseMessage& b);
+bool Equal(const StringMessage& a, const StringMessage& b);
+
+} // namespace shapes
+} // namespace common
+} // namespace benchmark
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace benchmark {
+namespace common {
+namespace payload {
+
+// Payload bytes with controlled content. A generator builds one pool of
+// kPoolSize bytes from its seed up front; payloads are windows of that
+// pool (wrapping around), so producing them costs a memcpy and the same
+// seed always yields the same bytes. The pool is larger than the match
+// window of common compressors, so wrapping adds no redundancy they see.
+class PayloadGenerator {
+public:
+  static constexpr size_t kPoolSize = 1 << 20;
+
+  // A generator over `pool`, which ParsePayloadSpec() builds
+  PayloadGenerator(std::string pool, std::string description);
+
+  // Copy `size` bytes starting `offset` bytes into the stream
+  void Fill(uint8_t* out, size_t size, uint64_t offset) const;
+
+  // Payload number `variant`; different variants start at unrelated
+  // places in the pool. Text keeps to 7-bit ASCII, since protobuf checks
+  // string fields for UTF-8, so binary pools lose their top bit there.
+  std::string MakeText(size_t size, uint64_t variant = 0) const;
+  std::vector<uint8_t> MakeBytes(size_t size, uint64_t variant = 0) const;
+
+  // Order-0 entropy of the pool in bits per byte
+  double Entropy() const;
+
+  const std::string& Describe() const { return description_; }
+
+  // The generator every scenario and the reference service draw from, or
+  // nullptr when none is set and they keep their built-in fillers. Set it
+  // before any client or server starts.
+  static const PayloadGenerator* Shared();
+  static void SetShared(std::unique_ptr<PayloadGenerator> generator);
+
+private:
+  static void FillFrom(const std::string& pool, uint8_t* out, size_t size, uint64_t offset);
+
+  std::string pool_;
+  std::string text_pool_;  // empty when pool_ is ASCII already
+  std::string description_;
+};
+
+// Parse a payload spec:
+//   random             uniform bytes (8 bits/byte, incompressible)
+//   entropy:<bits>     i.i.d. bytes with the given order-0 entropy, 0-8
+//   text               English-like prose from a Zipf-weighted word list
+//   json               JSON event records with dictionary keys and values
+//   records            log lines whose fields come from fixed dictionaries
+// Returns nullptr and fills `error` if the spec is invalid.
+std::unique_ptr<PayloadGenerator> ParsePayloadSpec(
+    const std::string& spec, uint64_t seed, std::string* error);
+
+// Payloads of the shared generator, or the fillers used without one: a
+// run of 'x' for text and GenerateRandomData(size, variant) for bytes
+std::string SharedText(size_t size, uint64_t variant = 0);
+std::vector<uint8_t> SharedBytes(size_t size, uint64_t variant);
+
+} // namespace payload
+} // namespace common
+} // namespace benchmark
@@ -0,0 +1,93 @@
+#pragma once
+
+#include "benchmark_service.h"
+#include "workload_trace.h"
+#include <memory>
+
+namespace benchmark {
+namespace common {
+namespace trace {
+
+// Decorator that appends a trace record for every call and forwards it to
+// the wrapped service unchanged
+class RecordingService : public IBenchmarkService {
+public:
+  RecordingService(IBenchmarkService* inner, std::shared_ptr<TraceWriter> writer);
+
+  Result<EchoResponse> Echo(const EchoRequest& request) override;
+
+  void EchoAsync(
+      const EchoRequest& request,
+      ResponseCallback<EchoResponse> callback) override;
+
+  void StreamData(
+      const StreamRequest& request,
+      StreamCallback<DataChunk> on_chunk,
+      CompletionCallback on_complete) override;
+
+  void UploadData(
+      StreamCallback<DataChunk>& chunk_provider,
+      ResponseCallback<UploadResponse> on_complete) override;
+
+  void BidirectionalStream(
+      StreamCallback<DataChunk>& chunk_provider,
+      StreamCallback<DataChunk> on_chunk,
+      CompletionCallback on_complete) override;
+
+  Result<BatchResponse> BatchProcess(const BatchRequest& request) override;
+
+  void BatchProcessAsync(
+      const BatchRequest& request,
+      ResponseCallback<BatchResponse> callback) override;
+
+  Result<EchoResponse> EchoChain(const EchoRequest& request, uint32_t length) override;
+
+  Result<NestedMessage> EchoShape(const NestedMessage& request) override;
+  Result<ArrayMessage> EchoShape(const ArrayMessage& request) override;
+  Result<MapMessage> EchoShape(const MapMessage& request) override;
+  Result<SparseMessage> EchoShape(const SparseMessage& request) override;
+  Result<StringMessage> EchoShape(const StringMessage& request) override;
+
+private:
+  IBenchmarkService* inner_;
+  std::shared_ptr<TraceWriter> writer_;
+};
+
+// Client wrapper that hands out a RecordingService around the wrapped
+// client's service, so any scenario can be captured unmodified
+class RecordingClient : public IBenchmarkClient {
+public:
+  RecordingClient(std::unique_ptr<IBenchmarkClient> inner,
+                  std::shared_ptr<TraceWriter> writer);
+
+  IBenchmarkService* GetService() override;
+  bool Connect(const std::string& address) override;
+  void Disconnect() override;
+  bool IsConnected() const override;
+
+private:
+  std::unique_ptr<IBenchmarkClient> inner_;
+  std::shared_ptr<TraceWriter> writer_;
+  std::unique_ptr<RecordingService> service_;
+};
+
+// Factory wrapper whose clients are all RecordingClients sharing one trace
+class RecordingFactory : public IFrameworkFactory {
+public:
+  RecordingFactory(std::unique_ptr<IFrameworkFactory> inner,
+                   std::shared_ptr<TraceWriter> writer);
+
+  std::string GetName() const override;
+  bool IsInProcess() const override;
+  std::unique_ptr<IBenchmarkClient> CreateClient() override;
+  std::unique_ptr<IBenchmarkServer> CreateServer(
+      std::shared_ptr<IBenchmarkService> service) override;
+
+private:
+  std::unique_ptr<IFrameworkFactory> inner_;
+  std::shared_ptr<TraceWriter> writer_;
+};
+
+} // namespace trace
+} // namespace common
+} // namespace benchmark
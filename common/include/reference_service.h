@@ -3,19 +3,32 @@
 #include "benchmark_service.h"
 #include "benchmark_types.h"
 #include "benchmark_utils.h"
+#include <memory>
 #include <mutex>
 #include <condition_variable>
 #include <thread>
 #include <vector>
 
 namespace benchmark {
+
+namespace common {
+class WorkStealingExecutor;
+}
+
 namespace reference {
 
 // Reference implementation of the benchmark service
 // This provides a simple, correct implementation for testing and baseline comparison
-class ReferenceServiceImpl : public common::IBenchmarkService {
+//
+// Async calls complete inline unless an executor is given; their work and
+// callback then run on it, the way a real server hands requests to a pool.
+// The service must be owned by a shared_ptr for that, so queued work can
+// keep it alive; otherwise async calls still complete inline.
+class ReferenceServiceImpl : public common::IBenchmarkService,
+                             public std::enable_shared_from_this<ReferenceServiceImpl> {
 public:
-  ReferenceServiceImpl() = default;
+  explicit ReferenceServiceImpl(common::WorkStealingExecutor* executor = nullptr)
+    : executor_(executor) {}
   ~ReferenceServiceImpl() override = default;
 
   // Synchronous Echo
@@ -53,7 +66,15 @@ public:
       const common::BatchRequest& request,
       common::ResponseCallback<common::BatchResponse> callback) override;
 
+  // Message-zoo echoes return a copy of the request
+  common::Result<common::NestedMessage> EchoShape(const common::NestedMessage& request) override;
+  common::Result<common::ArrayMessage> EchoShape(const common::ArrayMessage& request) override;
+  common::Result<common::MapMessage> EchoShape(const common::MapMessage& request) override;
+  common::Result<common::SparseMessage> EchoShape(const common::SparseMessage& request) override;
+  common::Result<common::StringMessage> EchoShape(const common::StringMessage& request) override;
+
 private:
+  common::WorkStealingExecutor* executor_;
   common::utils::CRC32 crc32_;
 };
 
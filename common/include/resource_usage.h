@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace benchmark {
+namespace common {
+namespace utils {
+
+// Resident memory of the current process, from /proc/self/status
+struct MemoryUsage {
+  uint64_t rss_bytes = 0;       // VmRSS
+  uint64_t peak_rss_bytes = 0;  // VmHWM, high-water mark since start or last reset
+};
+
+// Returns false where /proc is unavailable
+bool ReadMemoryUsage(MemoryUsage* usage);
+
+// Reset the peak RSS high-water mark to the current RSS so the next
+// ReadMemoryUsage() reports the peak of the section that follows. Needs
+// Linux 4.0+; returns false if the reset is not supported.
+bool ResetPeakRss();
+
+// CPU time (user + system) used by all threads of this process so far, in
+// nanoseconds; -1 if unavailable
+int64_t ReadProcessCpuNanos();
+
+// Parse a CPU list such as "0-3,6" (the taskset/cpuset syntax)
+bool ParseCpuList(const std::string& text, std::vector<int>* cpus);
+
+// Restrict the calling thread, and threads it creates afterwards, to
+// `cpus`. Pin before starting workers so they all inherit the set.
+bool PinToCpus(const std::vector<int>& cpus);
+
+// CPUs this thread may run on, which is fewer than the machine has once
+// pinned; empty if unknown
+std::vector<int> UsableCpus();
+
+// Return freed heap memory to the OS so a following RSS baseline does not
+// include pages left over from earlier large allocations
+void TrimHeap();
+
+} // namespace utils
+} // namespace common
+} // namespace benchmark
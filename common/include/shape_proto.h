@@ -0,0 +1,201 @@
+#pragma once
+
+#include "benchmark_types.h"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace benchmark {
+namespace common {
+namespace shapes {
+
+// Copies between the message-zoo types and their protobuf messages. The
+// gRPC and tRPC adapters and codec_bench generate the same messages into
+// different packages, so the copies are templates over the generated
+// types; each caller wraps them in its own ToProto()/FromProto().
+
+template<typename Proto>
+void TreeToProto(const TreeNode& from, Proto* to) {
+  to->set_id(from.id);
+  to->set_weight(from.weight);
+  to->set_label(from.label);
+  for (const auto& child : from.children) TreeToProto(child, to->add_children());
+}
+
+template<typename Proto>
+void TreeFromProto(const Proto& from, TreeNode* to) {
+  to->id = from.id();
+  to->weight = from.weight();
+  to->label = from.label();
+  to->children.resize(static_cast<size_t>(from.children_size()));
+  for (int i = 0; i < from.children_size(); i++) {
+    TreeFromProto(from.children(i), &to->children[static_cast<size_t>(i)]);
+  }
+}
+
+// Calls ints(index, value), doubles(index, value) and texts(index, value)
+// for the fields a SparseRecord message has set
+template<typename Proto, typename Ints, typename Doubles, typename Texts>
+void ForEachSetField(const Proto& record, Ints ints, Doubles doubles, Texts texts) {
+  if (record.has_int_0()) ints(0, record.int_0());
+  if (record.has_int_1()) ints(1, record.int_1());
+  if (record.has_int_2()) ints(2, record.int_2());
+  if (record.has_int_3()) ints(3, record.int_3());
+  if (record.has_int_4()) ints(4, record.int_4());
+  if (record.has_int_5()) ints(5, record.int_5());
+  if (record.has_int_6()) ints(6, record.int_6());
+  if (record.has_int_7()) ints(7, record.int_7());
+  if (record.has_int_8()) ints(8, record.int_8());
+  if (record.has_int_9()) ints(9, record.int_9());
+  if (record.has_int_10()) ints(10, record.int_10());
+  if (record.has_int_11()) ints(11, record.int_11());
+  if (record.has_int_12()) ints(12, record.int_12());
+  if (record.has_int_13()) ints(13, record.int_13());
+  if (record.has_int_14()) ints(14, record.int_14());
+  if (record.has_int_15()) ints(15, record.int_15());
+  if (record.has_double_0()) doubles(0, record.double_0());
+  if (record.has_double_1()) doubles(1, record.double_1());
+  if (record.has_double_2()) doubles(2, record.double_2());
+  if (record.has_double_3()) doubles(3, record.double_3());
+  if (record.has_double_4()) doubles(4, record.double_4());
+  if (record.has_double_5()) doubles(5, record.double_5());
+  if (record.has_double_6()) doubles(6, record.double_6());
+  if (record.has_double_7()) doubles(7, record.double_7());
+  if (record.has_text_0()) texts(0, record.text_0());
+  if (record.has_text_1()) texts(1, record.text_1());
+  if (record.has_text_2()) texts(2, record.text_2());
+  if (record.has_text_3()) texts(3, record.text_3());
+  if (record.has_text_4()) texts(4, record.text_4());
+  if (record.has_text_5()) texts(5, record.text_5());
+  if (record.has_text_6()) texts(6, record.text_6());
+  if (record.has_text_7()) texts(7, record.text_7());
+}
+
+template<typename Proto>
+void SparseRecordToProto(const SparseRecord& from, Proto* to) {
+  if (from.ints[0]) to->set_int_0(*from.ints[0]);
+  if (from.ints[1]) to->set_int_1(*from.ints[1]);
+  if (from.ints[2]) to->set_int_2(*from.ints[2]);
+  if (from.ints[3]) to->set_int_3(*from.ints[3]);
+  if (from.ints[4]) to->set_int_4(*from.ints[4]);
+  if (from.ints[5]) to->set_int_5(*from.ints[5]);
+  if (from.ints[6]) to->set_int_6(*from.ints[6]);
+  if (from.ints[7]) to->set_int_7(*from.ints[7]);
+  if (from.ints[8]) to->set_int_8(*from.ints[8]);
+  if (from.ints[9]) to->set_int_9(*from.ints[9]);
+  if (from.ints[10]) to->set_int_10(*from.ints[10]);
+  if (from.ints[11]) to->set_int_11(*from.ints[11]);
+  if (from.ints[12]) to->set_int_12(*from.ints[12]);
+  if (from.ints[13]) to->set_int_13(*from.ints[13]);
+  if (from.ints[14]) to->set_int_14(*from.ints[14]);
+  if (from.ints[15]) to->set_int_15(*from.ints[15]);
+  if (from.doubles[0]) to->set_double_0(*from.doubles[0]);
+  if (from.doubles[1]) to->set_double_1(*from.doubles[1]);
+  if (from.doubles[2]) to->set_double_2(*from.doubles[2]);
+  if (from.doubles[3]) to->set_double_3(*from.doubles[3]);
+  if (from.doubles[4]) to->set_double_4(*from.doubles[4]);
+  if (from.doubles[5]) to->set_double_5(*from.doubles[5]);
+  if (from.doubles[6]) to->set_double_6(*from.doubles[6]);
+  if (from.doubles[7]) to->set_double_7(*from.doubles[7]);
+  if (from.texts[0]) *to->mutable_text_0() = *from.texts[0];
+  if (from.texts[1]) *to->mutable_text_1() = *from.texts[1];
+  if (from.texts[2]) *to->mutable_text_2() = *from.texts[2];
+  if (from.texts[3]) *to->mutable_text_3() = *from.texts[3];
+  if (from.texts[4]) *to->mutable_text_4() = *from.texts[4];
+  if (from.texts[5]) *to->mutable_text_5() = *from.texts[5];
+  if (from.texts[6]) *to->mutable_text_6() = *from.texts[6];
+  if (from.texts[7]) *to->mutable_text_7() = *from.texts[7];
+}
+
+template<typename Proto>
+void SparseRecordFromProto(const Proto& from, SparseRecord* to) {
+  *to = SparseRecord();
+  ForEachSetField(
+      from,
+      [to](size_t index, int64_t value) { to->ints[index] = value; },
+      [to](size_t index, double value) { to->doubles[index] = value; },
+      [to](size_t index, const std::string& value) { to->texts[index] = value; });
+}
+
+// Whole messages
+template<typename Proto>
+void NestedToProto(const NestedMessage& from, Proto* to) {
+  TreeToProto(from.root, to->mutable_root());
+}
+
+template<typename Proto>
+void NestedFromProto(const Proto& from, NestedMessage* to) {
+  TreeFromProto(from.root(), &to->root);
+}
+
+template<typename Proto>
+void ArraysToProto(const ArrayMessage& from, Proto* to) {
+  to->mutable_values()->Add(from.values.begin(), from.values.end());
+  to->mutable_samples()->Add(from.samples.begin(), from.samples.end());
+  to->mutable_counts()->Add(from.counts.begin(), from.counts.end());
+}
+
+template<typename Proto>
+void ArraysFromProto(const Proto& from, ArrayMessage* to) {
+  to->values.assign(from.values().begin(), from.values().end());
+  to->samples.assign(from.samples().begin(), from.samples().end());
+  to->counts.assign(from.counts().begin(), from.counts().end());
+}
+
+template<typename Proto>
+void MapToProto(const MapMessage& from, Proto* to) {
+  to->mutable_counters()->insert(from.counters.begin(), from.counters.end());
+  to->mutable_labels()->insert(from.labels.begin(), from.labels.end());
+}
+
+// Protobuf maps iterate in no particular order
+template<typename Proto>
+void MapFromProto(const Proto& from, MapMessage* to) {
+  to->counters.clear();
+  for (const auto& entry : from.counters()) to->counters.emplace(entry.first, entry.second);
+  to->labels.clear();
+  for (const auto& entry : from.labels()) to->labels.emplace(entry.first, entry.second);
+}
+
+template<typename Proto>
+void SparseToProto(const SparseMessage& from, Proto* to) {
+  for (const auto& record : from.records) SparseRecordToProto(record, to->add_records());
+}
+
+template<typename Proto>
+void SparseFromProto(const Proto& from, SparseMessage* to) {
+  to->records.resize(static_cast<size_t>(from.records_size()));
+  for (int i = 0; i < from.records_size(); i++) {
+    SparseRecordFromProto(from.records(i), &to->records[static_cast<size_t>(i)]);
+  }
+}
+
+template<typename Proto>
+void StringsToProto(const StringMessage& from, Proto* to) {
+  for (const auto& record : from.records) {
+    auto* out = to->add_records();
+    out->set_name(record.name);
+    out->set_email(record.email);
+    out->set_city(record.city);
+    out->set_note(record.note);
+    for (const auto& tag : record.tags) out->add_tags(tag);
+  }
+}
+
+template<typename Proto>
+void StringsFromProto(const Proto& from, StringMessage* to) {
+  to->records.resize(static_cast<size_t>(from.records_size()));
+  for (int i = 0; i < from.records_size(); i++) {
+    const auto& record = from.records(i);
+    StringRecord& out = to->records[static_cast<size_t>(i)];
+    out.name = record.name();
+    out.email = record.email();
+    out.city = record.city();
+    out.note = record.note();
+    out.tags.assign(record.tags().begin(), record.tags().end());
+  }
+}
+
+} // namespace shapes
+} // namespace common
+} // namespace benchmark
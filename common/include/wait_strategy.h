@@ -0,0 +1,117 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <thread>
+
+namespace benchmark {
+namespace common {
+
+// How a thread waits for work or for a reply, trading CPU burned while
+// idle against the latency of waking up:
+//   kSpin       poll until ready; lowest latency, one busy core per waiter
+//   kSpinYield  poll briefly, then keep polling with yields in between
+//   kSpinFutex  poll for an adaptive budget, then sleep on a futex
+//   kBlock      sleep on a futex straight away
+enum class WaitStrategy { kSpin, kSpinYield, kSpinFutex, kBlock };
+
+const char* WaitStrategyName(WaitStrategy strategy);
+
+// Accepts the names returned by WaitStrategyName()
+bool ParseWaitStrategy(const std::string& name, WaitStrategy* strategy);
+
+// Hint to the CPU that this thread is spinning
+inline void CpuRelax() {
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_ia32_pause();
+#elif defined(__aarch64__)
+  asm volatile("yield");
+#endif
+}
+
+// Sleep while `*word` equals `expected`; may return spuriously. A futex on
+// Linux, address-keyed condition variables elsewhere. Wakeups never read
+// the word, so a waiter may free it as soon as it sees the new value.
+void FutexWait(std::atomic<uint32_t>* word, uint32_t expected);
+void FutexWake(std::atomic<uint32_t>* word, int count);
+
+// Polls kSpinFutex spends before sleeping, shared by the waits of one kind
+// (one queue, one ring direction). A wait that succeeded while spinning
+// pulls the budget towards twice the polls it needed; a wait that had to
+// sleep shrinks it, so idle periods cost little CPU. Always zero with one
+// usable CPU, where spinning only delays the thread being waited for.
+class SpinBudget {
+public:
+  int Get() const;
+  void Record(bool slept, int polls);
+
+private:
+  std::atomic<int> polls_{256};
+};
+
+// Steps of one wait under a strategy. The caller owns the loop:
+//
+//   SpinWaiter waiter(strategy, &budget);
+//   while (!ready()) {
+//     if (waiter.Pause()) sleep until woken;
+//   }
+//
+// Pause() spins or yields once and returns false, or returns true when
+// the strategy says to sleep from now on.
+class SpinWaiter {
+public:
+  SpinWaiter(WaitStrategy strategy, SpinBudget* budget)
+    : strategy_(strategy), budget_(budget) {}
+
+  ~SpinWaiter() {
+    // A wait that found its condition on the first check says nothing
+    if (strategy_ == WaitStrategy::kSpinFutex && (polls_ > 0 || slept_)) {
+      budget_->Record(slept_, polls_);
+    }
+  }
+
+  SpinWaiter(const SpinWaiter&) = delete;
+  SpinWaiter& operator=(const SpinWaiter&) = delete;
+
+  bool Pause() {
+    if (slept_) return true;
+    switch (strategy_) {
+      case WaitStrategy::kSpin:
+        break;
+      case WaitStrategy::kSpinYield:
+        if (polls_ >= kYieldAfterPolls) {
+          polls_++;
+          std::this_thread::yield();
+          return false;
+        }
+        break;
+      case WaitStrategy::kSpinFutex:
+        if (limit_ < 0) limit_ = budget_->Get();
+        if (polls_ >= limit_) slept_ = true;
+        break;
+      case WaitStrategy::kBlock:
+        slept_ = true;
+        break;
+    }
+    if (slept_) return true;
+    polls_++;
+    CpuRelax();
+    return false;
+  }
+
+  // Pauses so far, for callers that check a clock now and then
+  int polls() const { return polls_; }
+
+private:
+  static constexpr int kYieldAfterPolls = 256;
+
+  WaitStrategy strategy_;
+  SpinBudget* budget_;
+  int polls_ = 0;
+  int limit_ = -1;
+  bool slept_ = false;
+};
+
+} // namespace common
+} // namespace benchmark
@@ -0,0 +1,227 @@
+#pragma once
+
+#include "benchmark_types.h"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace benchmark {
+namespace common {
+namespace wire {
+
+// Minimal length-prefixed binary framing of the common types for native
+// transports. Every frame is a fixed little-endian header followed by the
+// message body:
+//
+//   u32 body_length | u8 type | u8 flags | u16 reserved | u32 call_id
+//
+// call_id ties responses and stream frames to the call that started them,
+// so one connection can carry many outstanding calls. Every body is one
+// flat block (flat_format.h), which the receiver can read in place;
+// Decode() copies it out into the common types.
+
+constexpr size_t kFrameHeaderSize = 12;
+
+// Upper bound on a frame body; larger lengths are treated as corruption
+constexpr uint32_t kMaxFrameBody = 0xF0000000u;
+
+// Header flag: the body is not in the byte stream but fills a memfd that
+// travels with the header over a Unix socket (SCM_RIGHTS)
+constexpr uint8_t kFlagBodyInFd = 0x01;
+
+enum class MessageType : uint8_t {
+  kEchoRequest = 1,
+  kEchoResponse = 2,
+  kStreamRequest = 3,
+  kStreamChunk = 4,
+  kStreamEnd = 5,      // Status that ends a server or bidirectional stream
+  kUploadBegin = 6,
+  kUploadChunk = 7,    // An empty chunk ends the upload
+  kUploadResponse = 8,
+  kBidiBegin = 9,
+  kBidiChunk = 10,     // An empty chunk ends the client side
+  kBatchRequest = 11,
+  kBatchResponse = 12,
+  kError = 13,         // Status of a failed unary call
+  kEchoChain = 14,     // Whole echo chain, answered like kEchoRequest
+  kShapeEcho = 15      // Message-zoo echo, both ways; the block's kind names the shape
+};
+
+// Body of kEchoChain: the first request and the number of links the
+// server runs before answering with the last response
+struct EchoChainRequest {
+  uint32_t length = 0;
+  EchoRequest request;
+};
+
+struct FrameHeader {
+  uint32_t body_length = 0;
+  MessageType type = MessageType::kError;
+  uint8_t flags = 0;
+  uint32_t call_id = 0;
+};
+
+// Writes little-endian values. Appends to a byte string, fills a caller
+// buffer in place (which must hold the whole encoding), or, when built
+// with no destination, only counts the bytes an encoding would take.
+class WireWriter {
+public:
+  WireWriter() = default;
+  explicit WireWriter(std::string* out) : out_(out) {}
+  WireWriter(uint8_t* data, size_t capacity) : data_(data), capacity_(capacity) {}
+
+  void PutU8(uint8_t value) { Write(&value, 1); }
+  void PutU16(uint16_t value);
+  void PutU32(uint32_t value);
+  void PutU64(uint64_t value);
+  void PutI64(int64_t value) { PutU64(static_cast<uint64_t>(value)); }
+  void PutBool(bool value) { PutU8(value ? 1 : 0); }
+  void PutBytes(const void* data, size_t size);
+  void PutString(const std::string& value) { PutBytes(value.data(), value.size()); }
+  void PutBytes(const std::vector<uint8_t>& value) { PutBytes(value.data(), value.size()); }
+
+  // Bytes as they are, with no length prefix
+  void PutRaw(const void* data, size_t size) {
+    if (size > 0) Write(data, size);
+  }
+
+  // Bytes written (or counted) so far
+  size_t size() const { return size_; }
+
+private:
+  void Write(const void* bytes, size_t size);
+
+  std::string* out_ = nullptr;
+  uint8_t* data_ = nullptr;
+  size_t capacity_ = 0;
+  size_t size_ = 0;
+};
+
+// Bounds-checked reads over a frame body. Every getter returns false once
+// the body is exhausted and leaves the reader failed.
+class WireReader {
+public:
+  WireReader(const uint8_t* data, size_t size) : data_(data), size_(size) {}
+
+  bool GetU8(uint8_t* value);
+  bool GetU16(uint16_t* value);
+  bool GetU32(uint32_t* value);
+  bool GetU64(uint64_t* value);
+  bool GetI64(int64_t* value);
+  bool GetBool(bool* value);
+  bool GetString(std::string* value);
+  bool GetBytes(std::vector<uint8_t>* value);
+
+  // Everything not yet read, e.g. a flat block to open in place
+  void GetRest(const uint8_t** data, size_t* size);
+
+  bool AtEnd() const { return offset_ == size_; }
+
+private:
+  bool Take(size_t size, const uint8_t** bytes);
+
+  const uint8_t* data_;
+  size_t size_;
+  size_t offset_ = 0;
+};
+
+// Start a frame in `out` and return its offset; EndFrame() fills in the
+// body length once the body has been appended
+size_t BeginFrame(std::string* out, MessageType type, uint32_t call_id);
+void EndFrame(std::string* out, size_t frame_offset);
+
+// Write a complete header into kFrameHeaderSize bytes of raw memory
+void WriteFrameHeader(uint8_t* data, MessageType type, uint32_t call_id,
+                      uint32_t body_length, uint8_t flags = 0);
+
+// Decode a header from at least kFrameHeaderSize bytes. Returns false for
+// unknown message types or oversized bodies.
+bool ParseFrameHeader(const uint8_t* data, FrameHeader* header);
+
+// Message bodies
+void Encode(const EchoRequest& message, WireWriter* writer);
+void Encode(const EchoResponse& message, WireWriter* writer);
+void Encode(const StreamRequest& message, WireWriter* writer);
+void Encode(const DataChunk& message, WireWriter* writer);
+void Encode(const UploadResponse& message, WireWriter* writer);
+void Encode(const BatchRequest& message, WireWriter* writer);
+void Encode(const BatchResponse& message, WireWriter* writer);
+void Encode(const EchoChainRequest& message, WireWriter* writer);
+void Encode(const NestedMessage& message, WireWriter* writer);
+void Encode(const ArrayMessage& message, WireWriter* writer);
+void Encode(const MapMessage& message, WireWriter* writer);
+void Encode(const SparseMessage& message, WireWriter* writer);
+void Encode(const StringMessage& message, WireWriter* writer);
+void EncodeStatus(ErrorCode code, const std::string& message, WireWriter* writer);
+
+bool Decode(WireReader* reader, EchoRequest* message);
+bool Decode(WireReader* reader, EchoResponse* message);
+bool Decode(WireReader* reader, StreamRequest* message);
+bool Decode(WireReader* reader, DataChunk* message);
+bool Decode(WireReader* reader, UploadResponse* message);
+bool Decode(WireReader* reader, BatchRequest* message);
+bool Decode(WireReader* reader, BatchResponse* message);
+bool Decode(WireReader* reader, EchoChainRequest* message);
+bool Decode(WireReader* reader, NestedMessage* message);
+bool Decode(WireReader* reader, ArrayMessage* message);
+bool Decode(WireReader* reader, MapMessage* message);
+bool Decode(WireReader* reader, SparseMessage* message);
+bool Decode(WireReader* reader, StringMessage* message);
+bool DecodeStatus(WireReader* reader, ErrorCode* code, std::string* message);
+
+// Size of a message body without encoding it
+size_t EncodedSize(const EchoRequest& message);
+size_t EncodedSize(const EchoResponse& message);
+size_t EncodedSize(const StreamRequest& message);
+size_t EncodedSize(const DataChunk& message);
+size_t EncodedSize(const UploadResponse& message);
+size_t EncodedSize(const BatchRequest& message);
+size_t EncodedSize(const BatchResponse& message);
+size_t EncodedSize(const EchoChainRequest& message);
+size_t EncodedSize(const NestedMessage& message);
+size_t EncodedSize(const ArrayMessage& message);
+size_t EncodedSize(const MapMessage& message);
+size_t EncodedSize(const SparseMessage& message);
+size_t EncodedSize(const StringMessage& message);
+
+// Encode a whole frame holding one message
+template<typename T>
+void AppendFrame(std::string* out, MessageType type, uint32_t call_id, const T& message) {
+  size_t offset = BeginFrame(out, type, call_id);
+  WireWriter writer(out);
+  Encode(message, &writer);
+  EndFrame(out, offset);
+}
+
+void AppendStatusFrame(std::string* out, MessageType type, uint32_t call_id,
+                       ErrorCode code, const std::string& message);
+
+// Receive buffer that reassembles frames from a byte stream. Read into
+// WritableSpace(), Commit() what arrived, then drain complete frames with
+// NextFrame()/Consume().
+class FrameBuffer {
+public:
+  // Space for at least `min_size` more bytes; grows to fit a whole frame
+  // once its header has been seen
+  uint8_t* WritableSpace(size_t min_size, size_t* available);
+  void Commit(size_t size) { end_ += size; }
+
+  // True when a complete frame is buffered; sets `corrupt` on a bad header.
+  // Frames flagged kFlagBodyInFd are complete after the header and return
+  // a null body.
+  bool NextFrame(FrameHeader* header, const uint8_t** body, bool* corrupt);
+
+  // Drop the frame returned by the last NextFrame()
+  void Consume();
+
+private:
+  std::vector<uint8_t> data_;
+  size_t begin_ = 0;
+  size_t end_ = 0;
+  size_t frame_size_ = 0;
+};
+
+} // namespace wire
+} // namespace common
+} // namespace benchmark
@@ -0,0 +1,176 @@
+#pragma once
+
+#include "handoff_queue.h"
+#include "wait_strategy.h"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace benchmark {
+namespace common {
+
+// Unit of work for the executor. The callable lives in the node itself,
+// so a task costs one allocation sized to its captures and a call through
+// one function pointer, and may be move-only, unlike std::function.
+struct ExecutorTask {
+  void (*run)(ExecutorTask* task) = nullptr;  // Runs the callable, then frees the node
+  ExecutorTask* next = nullptr;               // Link in the injection queue
+};
+
+template <typename Fn>
+struct CallableTask : ExecutorTask {
+  explicit CallableTask(Fn&& callable) : fn(std::move(callable)) { run = &Run; }
+
+  static void Run(ExecutorTask* task) {
+    auto* self = static_cast<CallableTask*>(task);
+    self->fn();
+    delete self;
+  }
+
+  Fn fn;
+};
+
+// Chase-Lev deque (in the formulation of Le et al., "Correct and Efficient
+// Work-Stealing for Weak Memory Models"). The owning worker pushes and
+// pops at the bottom without atomic read-modify-writes; other workers
+// steal from the top with one CAS. The array grows when full; outgrown
+// arrays are kept until the deque goes away because a thief may still be
+// reading one.
+class WorkStealingDeque {
+public:
+  explicit WorkStealingDeque(size_t capacity = 256);
+
+  // Owner only
+  void Push(ExecutorTask* task);
+  ExecutorTask* Pop();
+
+  // Any thread; null when empty or when another thread won the race
+  ExecutorTask* Steal();
+
+  // A snapshot that may be stale by the time it returns
+  size_t Size() const {
+    int64_t bottom = bottom_.load(std::memory_order_relaxed);
+    int64_t top = top_.load(std::memory_order_relaxed);
+    return bottom > top ? static_cast<size_t>(bottom - top) : 0;
+  }
+
+private:
+  struct Array {
+    explicit Array(size_t size) : mask(size - 1), slots(new std::atomic<ExecutorTask*>[size]) {}
+    size_t Capacity() const { return mask + 1; }
+    ExecutorTask* Get(int64_t index) const {
+      return slots[static_cast<size_t>(index) & mask].load(std::memory_order_relaxed);
+    }
+    void Put(int64_t index, ExecutorTask* task) {
+      slots[static_cast<size_t>(index) & mask].store(task, std::memory_order_relaxed);
+    }
+
+    size_t mask;
+    std::unique_ptr<std::atomic<ExecutorTask*>[]> slots;
+  };
+
+  alignas(kCacheLineSize) std::atomic<int64_t> top_{0};
+  alignas(kCacheLineSize) std::atomic<int64_t> bottom_{0};
+  std::atomic<Array*> array_;
+  std::vector<std::unique_ptr<Array>> arrays_;  // Current one last; owner only
+};
+
+// Counters of an executor since it started or since ResetStats()
+struct ExecutorStats {
+  int num_workers = 0;
+  uint64_t executed = 0;        // Tasks run
+  uint64_t injected = 0;        // Tasks submitted from outside the pool
+  uint64_t steals = 0;          // Tasks taken from another worker's deque
+  uint64_t queue_depth = 0;     // Tasks waiting when the stats were read
+  uint64_t max_queue_depth = 0; // Deepest single deque seen at a push
+  int64_t idle_ns = 0;          // Time workers spent waiting, summed
+  int64_t elapsed_ns = 0;       // Wall time covered
+
+  // Share of the workers' time spent waiting for work
+  double IdlePercent() const {
+    return elapsed_ns > 0 && num_workers > 0
+               ? 100.0 * static_cast<double>(idle_ns) / (static_cast<double>(elapsed_ns) * num_workers)
+               : 0.0;
+  }
+};
+
+// Thread pool in which every worker owns a deque. Tasks submitted by a
+// worker go to the bottom of its own deque, so a handler's follow-up work
+// runs hot in the same cache unless an idle worker steals it; tasks from
+// other threads go through a shared injection queue. Idle workers look in
+// their deque, then the injection queue, then steal from the others
+// before waiting under the configured WaitStrategy.
+class WorkStealingExecutor {
+public:
+  struct Options {
+    int num_workers = 0;     // 0 = one per CPU in the affinity mask
+    bool pin_workers = false;
+    std::vector<int> cpus;   // For pin_workers; empty = the affinity mask
+    WaitStrategy wait = WaitStrategy::kSpinFutex;
+  };
+
+  WorkStealingExecutor();
+  explicit WorkStealingExecutor(const Options& options);
+  ~WorkStealingExecutor();
+  WorkStealingExecutor(const WorkStealingExecutor&) = delete;
+  WorkStealingExecutor& operator=(const WorkStealingExecutor&) = delete;
+
+  // Run `fn` on a worker. Returns false, without running it, once
+  // Shutdown() has started; workers may still submit follow-up work then.
+  template <typename Fn>
+  bool Submit(Fn&& fn) {
+    using Task = CallableTask<typename std::decay<Fn>::type>;
+    auto* task = new Task(typename std::decay<Fn>::type(std::forward<Fn>(fn)));
+    if (!SubmitTask(task)) {
+      delete task;
+      return false;
+    }
+    return true;
+  }
+
+  // Run every queued task and join the workers
+  void Shutdown();
+
+  int num_workers() const { return static_cast<int>(workers_.size()); }
+
+  ExecutorStats Stats() const;
+  void ResetStats();
+
+  // Process-wide pool with default options, started on first use. A
+  // forked child gets a pool of its own rather than the parent's threads.
+  static WorkStealingExecutor& Shared();
+
+  // The shared pool if this process has started it, else null
+  static WorkStealingExecutor* SharedIfStarted();
+
+private:
+  struct Worker;
+
+  bool SubmitTask(ExecutorTask* task);
+  void Run(Worker* worker);
+  ExecutorTask* FindTask(Worker* worker);
+  ExecutorTask* PopInjected();
+  bool HasWork() const;
+
+  Options options_;
+  std::vector<std::unique_ptr<Worker>> workers_;
+  Doorbell bell_;
+  std::atomic<bool> stopping_{false};
+
+  std::mutex inject_mutex_;
+  ExecutorTask* inject_head_ = nullptr;
+  ExecutorTask* inject_tail_ = nullptr;
+  std::atomic<uint64_t> inject_size_{0};
+  std::atomic<uint64_t> injected_{0};
+
+  std::atomic<int64_t> stats_start_ns_{0};
+};
+
+} // namespace common
+} // namespace benchmark
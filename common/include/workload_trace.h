@@ -0,0 +1,112 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string>
+
+namespace benchmark {
+namespace common {
+namespace trace {
+
+// Compact binary workload trace.
+//
+// A trace is a 32-byte TraceHeader followed by fixed-size 16-byte
+// TraceRecords, all little-endian. Fixed-size records let the reader map
+// the file and walk it in place without loading it into memory.
+
+constexpr char kTraceMagic[8] = {'P', 'B', 'T', 'R', 'A', 'C', 'E', '\0'};
+constexpr uint32_t kTraceVersion = 1;
+
+enum class TraceOperation : uint8_t {
+  kEcho = 0,
+  kEchoAsync = 1,
+  kStreamData = 2,
+  kUploadData = 3,
+  kBidirectionalStream = 4,
+  kBatchProcess = 5,
+  kBatchProcessAsync = 6,
+  kEchoChain = 7              // item_count holds the chain length
+};
+
+const char* TraceOperationName(TraceOperation op);
+
+struct TraceHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t record_size;
+  uint64_t record_count;     // Filled in when the writer is closed
+  int64_t start_timestamp_ns;
+};
+
+struct TraceRecord {
+  uint64_t inter_arrival_ns;  // Time since the previous record
+  uint32_t payload_size;      // Request payload bytes (total for streams)
+  uint16_t item_count;        // Batch items or stream chunks, saturating
+  uint8_t operation;          // TraceOperation
+  uint8_t reserved;
+};
+
+static_assert(sizeof(TraceHeader) == 32, "TraceHeader must stay 32 bytes");
+static_assert(sizeof(TraceRecord) == 16, "TraceRecord must stay 16 bytes");
+
+// Thread-safe appender. Inter-arrival times are taken from the moment
+// Append() is called. Client streams learn their size only as they end,
+// so they append a record when they start and Update() it afterwards.
+class TraceWriter {
+public:
+  TraceWriter() = default;
+  ~TraceWriter();
+
+  TraceWriter(const TraceWriter&) = delete;
+  TraceWriter& operator=(const TraceWriter&) = delete;
+
+  bool Open(const std::string& path);
+  // Returns the record's index, or kNoRecord if nothing was written
+  uint64_t Append(TraceOperation op, uint64_t payload_size, uint64_t item_count);
+
+  // Rewrite the payload size and item count of an appended record
+  void Update(uint64_t index, uint64_t payload_size, uint64_t item_count);
+
+  static constexpr uint64_t kNoRecord = UINT64_MAX;
+
+  // Flush records and finalize the header
+  void Close();
+
+  uint64_t GetRecordCount() const;
+
+private:
+  mutable std::mutex mutex_;
+  std::FILE* file_ = nullptr;
+  TraceHeader header_{};
+  int64_t last_ns_ = 0;
+};
+
+// Read-only memory-mapped view of a trace file
+class TraceReader {
+public:
+  TraceReader() = default;
+  ~TraceReader();
+
+  TraceReader(const TraceReader&) = delete;
+  TraceReader& operator=(const TraceReader&) = delete;
+
+  // Map and validate the file. Returns false and fills `error` on failure.
+  bool Open(const std::string& path, std::string* error);
+  void Close();
+
+  const TraceHeader& GetHeader() const { return *header_; }
+  uint64_t GetRecordCount() const { return record_count_; }
+  const TraceRecord& GetRecord(uint64_t index) const { return records_[index]; }
+
+private:
+  void* mapping_ = nullptr;
+  size_t mapping_size_ = 0;
+  const TraceHeader* header_ = nullptr;
+  const TraceRecord* records_ = nullptr;
+  uint64_t record_count_ = 0;
+};
+
+} // namespace trace
+} // namespace common
+} // namespace benchmark
@@ -24,15 +24,35 @@ void CRC32::InitTable() {
         crc >>= 1;
       }
     }
-    table_[i] = crc;
+    table_[0][i] = crc;
+  }
+  // table_[k][i] is the CRC of byte i followed by k zero bytes
+  for (int k = 1; k < 8; k++) {
+    for (uint32_t i = 0; i < 256; i++) {
+      uint32_t previous = table_[k - 1][i];
+      table_[k][i] = (previous >> 8) ^ table_[0][previous & 0xFF];
+    }
   }
 }
 
+// Slice-by-8: eight bytes per step, each through its own table, then the
+// tail a byte at a time
 uint32_t CRC32::Calculate(const uint8_t* data, size_t length) {
   uint32_t crc = 0xFFFFFFFF;
+  for (; length >= 8; data += 8, length -= 8) {
+    uint32_t low = crc ^ (static_cast<uint32_t>(data[0]) |
+                          static_cast<uint32_t>(data[1]) << 8 |
+                          static_cast<uint32_t>(data[2]) << 16 |
+                          static_cast<uint32_t>(data[3]) << 24);
+    uint32_t high = static_cast<uint32_t>(data[4]) | static_cast<uint32_t>(data[5]) << 8 |
+                    static_cast<uint32_t>(data[6]) << 16 | static_cast<uint32_t>(data[7]) << 24;
+    crc = table_[7][low & 0xFF] ^ table_[6][(low >> 8) & 0xFF] ^
+          table_[5][(low >> 16) & 0xFF] ^ table_[4][low >> 24] ^
+          table_[3][high & 0xFF] ^ table_[2][(high >> 8) & 0xFF] ^
+          table_[1][(high >> 16) & 0xFF] ^ table_[0][high >> 24];
+  }
   for (size_t i = 0; i < length; i++) {
-    uint8_t index = (crc ^ data[i]) & 0xFF;
-    crc = (crc >> 8) ^ table_[index];
+    crc = (crc >> 8) ^ table_[0][(crc ^ data[i]) & 0xFF];
   }
   return crc ^ 0xFFFFFFFF;
 }
@@ -44,11 +64,17 @@ uint32_t CRC32::Calculate(const std::vector<uint8_t>& data) {
 // Generate random data
 std::vector<uint8_t> GenerateRandomData(size_t size, uint32_t seed) {
   std::vector<uint8_t> data(size);
-  std::mt19937 gen(seed == 0 ? std::random_device{}() : seed);
-  std::uniform_int_distribution<> dis(0, 255);
+  std::mt19937_64 gen(seed == 0 ? std::random_device{}() : seed);
 
-  for (size_t i = 0; i < size; i++) {
-    data[i] = static_cast<uint8_t>(dis(gen));
+  // Eight bytes per draw keeps multi-megabyte payloads cheap to build
+  size_t i = 0;
+  for (; i + 8 <= size; i += 8) {
+    uint64_t word = gen();
+    std::memcpy(&data[i], &word, 8);
+  }
+  if (i < size) {
+    uint64_t word = gen();
+    std::memcpy(&data[i], &word, size - i);
   }
 
   return data;
@@ -117,6 +143,16 @@ void LatencyStats::AddSample(int64_t latency_ns) {
   sorted_ = false;
 }
 
+void LatencyStats::Merge(const LatencyStats& other) {
+  if (other.count_ == 0) return;
+  samples_.insert(samples_.end(), other.samples_.begin(), other.samples_.end());
+  count_ += other.count_;
+  sum_ += other.sum_;
+  min_ = std::min(min_, other.min_);
+  max_ = std::max(max_, other.max_);
+  sorted_ = false;
+}
+
 void LatencyStats::Reset() {
   samples_.clear();
   count_ = 0;
@@ -149,6 +185,27 @@ int64_t LatencyStats::GetPercentile(double percentile) const {
   return samples_[index];
 }
 
+std::vector<std::pair<int64_t, uint64_t>> LatencyStats::GetHistogram() const {
+  std::vector<std::pair<int64_t, uint64_t>> buckets;
+  if (samples_.empty()) return buckets;
+  const_cast<LatencyStats*>(this)->EnsureSorted();
+
+  int64_t upper = 1;
+  while (upper < samples_.front()) upper <<= 1;
+
+  size_t index = 0;
+  while (index < samples_.size()) {
+    uint64_t count = 0;
+    while (index < samples_.size() && samples_[index] <= upper) {
+      count++;
+      index++;
+    }
+    buckets.emplace_back(upper, count);
+    upper <<= 1;
+  }
+  return buckets;
+}
+
 int64_t LatencyStats::GetP50() const {
   return GetPercentile(0.50);
 }
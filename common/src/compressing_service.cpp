@@ -0,0 +1,291 @@
+#include "compressing_service.h"
+
+namespace benchmark {
+namespace common {
+namespace compression {
+
+namespace {
+
+const char kCorruptPayload[] = "Corrupt compressed payload";
+
+// Pack into `to` or copy and unpack, by direction
+template<typename Buffer>
+bool ConvertPayload(const PayloadCodec& codec, const Buffer& from, Buffer* to,
+                    bool outgoing, size_t threshold) {
+  if (outgoing) {
+    codec.Pack(reinterpret_cast<const uint8_t*>(from.data()), from.size(), threshold, to);
+    return true;
+  }
+  *to = from;
+  return codec.Unpack(to);
+}
+
+template<typename Buffer>
+bool ConvertPayload(const PayloadCodec& codec, Buffer* payload, bool outgoing,
+                    size_t threshold) {
+  if (!outgoing) return codec.Unpack(payload);
+  Buffer packed;
+  codec.Pack(reinterpret_cast<const uint8_t*>(payload->data()), payload->size(), threshold,
+             &packed);
+  payload->swap(packed);
+  return true;
+}
+
+} // namespace
+
+// CompressingService implementation
+CompressingService::CompressingService(IBenchmarkService* inner, Side side, PayloadCodec codec,
+                                       Thresholds thresholds)
+  : inner_(inner), side_(side), codec_(std::move(codec)), thresholds_(thresholds) {}
+
+bool CompressingService::Convert(const EchoRequest& from, EchoRequest* to) const {
+  to->timestamp = from.timestamp;
+  to->sequence_number = from.sequence_number;
+  return ConvertPayload(codec_, from.message, &to->message, Outgoing(true), thresholds_.echo);
+}
+
+bool CompressingService::Convert(EchoResponse* message) const {
+  return ConvertPayload(codec_, &message->message, Outgoing(false), thresholds_.echo);
+}
+
+bool CompressingService::Convert(const BatchRequest& from, BatchRequest* to) const {
+  to->fail_on_error = from.fail_on_error;
+  to->items.resize(from.items.size());
+  bool ok = true;
+  for (size_t i = 0; i < from.items.size(); i++) {
+    to->items[i].id = from.items[i].id;
+    to->items[i].operation = from.items[i].operation;
+    ok &= ConvertPayload(codec_, from.items[i].data, &to->items[i].data, Outgoing(true),
+                         thresholds_.batch);
+  }
+  return ok;
+}
+
+bool CompressingService::Convert(BatchResponse* message) const {
+  bool ok = true;
+  for (auto& result : message->results) {
+    ok &= ConvertPayload(codec_, &result.result_data, Outgoing(false), thresholds_.batch);
+  }
+  return ok;
+}
+
+bool CompressingService::ConvertChunk(DataChunk* chunk, bool to_server) const {
+  return ConvertPayload(codec_, &chunk->data, Outgoing(to_server), thresholds_.chunk);
+}
+
+// Converts the response on its way to `callback`
+template<typename T>
+ResponseCallback<T> CompressingService::ConvertingCallback(ResponseCallback<T> callback) const {
+  return [this, callback = std::move(callback)](const Result<T>& result) {
+    if (!result.ok()) {
+      callback(result);
+      return;
+    }
+    Result<T> converted = result;
+    if (!Convert(&converted.value)) {
+      callback(Result<T>(ErrorCode::INTERNAL, kCorruptPayload));
+      return;
+    }
+    callback(converted);
+  };
+}
+
+Result<EchoResponse> CompressingService::Echo(const EchoRequest& request) {
+  EchoRequest converted;
+  if (!Convert(request, &converted)) {
+    return Result<EchoResponse>(ErrorCode::INVALID_ARGUMENT, kCorruptPayload);
+  }
+  Result<EchoResponse> result = inner_->Echo(converted);
+  if (result.ok() && !Convert(&result.value)) {
+    return Result<EchoResponse>(ErrorCode::INTERNAL, kCorruptPayload);
+  }
+  return result;
+}
+
+void CompressingService::EchoAsync(
+    const EchoRequest& request,
+    ResponseCallback<EchoResponse> callback) {
+  EchoRequest converted;
+  if (!Convert(request, &converted)) {
+    callback(Result<EchoResponse>(ErrorCode::INVALID_ARGUMENT, kCorruptPayload));
+    return;
+  }
+  inner_->EchoAsync(converted, ConvertingCallback(std::move(callback)));
+}
+
+// Chunks that fail to unpack are passed on as they came and counted in
+// the stage's errors; streams have no per-chunk error path
+void CompressingService::StreamData(
+    const StreamRequest& request,
+    StreamCallback<DataChunk> on_chunk,
+    CompletionCallback on_complete) {
+  inner_->StreamData(
+      request,
+      [this, on_chunk = std::move(on_chunk)](const DataChunk& chunk) {
+        DataChunk converted = chunk;
+        ConvertChunk(&converted, false);
+        on_chunk(converted);
+      },
+      std::move(on_complete));
+}
+
+void CompressingService::UploadData(
+    StreamCallback<DataChunk>& chunk_provider,
+    ResponseCallback<UploadResponse> on_complete) {
+  auto inner_provider = std::make_shared<StreamCallback<DataChunk>>();
+  inner_->UploadData(*inner_provider, std::move(on_complete));
+  chunk_provider = [this, inner_provider](const DataChunk& chunk) {
+    DataChunk converted = chunk;
+    ConvertChunk(&converted, true);
+    (*inner_provider)(converted);
+  };
+}
+
+void CompressingService::BidirectionalStream(
+    StreamCallback<DataChunk>& chunk_provider,
+    StreamCallback<DataChunk> on_chunk,
+    CompletionCallback on_complete) {
+  auto inner_provider = std::make_shared<StreamCallback<DataChunk>>();
+  inner_->BidirectionalStream(
+      *inner_provider,
+      [this, on_chunk = std::move(on_chunk)](const DataChunk& chunk) {
+        DataChunk converted = chunk;
+        ConvertChunk(&converted, false);
+        on_chunk(converted);
+      },
+      std::move(on_complete));
+  chunk_provider = [this, inner_provider](const DataChunk& chunk) {
+    DataChunk converted = chunk;
+    ConvertChunk(&converted, true);
+    (*inner_provider)(converted);
+  };
+}
+
+Result<BatchResponse> CompressingService::BatchProcess(const BatchRequest& request) {
+  BatchRequest converted;
+  if (!Convert(request, &converted)) {
+    return Result<BatchResponse>(ErrorCode::INVALID_ARGUMENT, kCorruptPayload);
+  }
+  Result<BatchResponse> result = inner_->BatchProcess(converted);
+  if (result.ok() && !Convert(&result.value)) {
+    return Result<BatchResponse>(ErrorCode::INTERNAL, kCorruptPayload);
+  }
+  return result;
+}
+
+void CompressingService::BatchProcessAsync(
+    const BatchRequest& request,
+    ResponseCallback<BatchResponse> callback) {
+  BatchRequest converted;
+  if (!Convert(request, &converted)) {
+    callback(Result<BatchResponse>(ErrorCode::INVALID_ARGUMENT, kCorruptPayload));
+    return;
+  }
+  inner_->BatchProcessAsync(converted, ConvertingCallback(std::move(callback)));
+}
+
+// Each link the server runs is packed and unpacked on its own
+Result<EchoResponse> CompressingService::EchoChain(const EchoRequest& request,
+                                                   uint32_t length) {
+  EchoRequest converted;
+  if (!Convert(request, &converted)) {
+    return Result<EchoResponse>(ErrorCode::INVALID_ARGUMENT, kCorruptPayload);
+  }
+  Result<EchoResponse> result = inner_->EchoChain(converted, length);
+  if (result.ok() && !Convert(&result.value)) {
+    return Result<EchoResponse>(ErrorCode::INTERNAL, kCorruptPayload);
+  }
+  return result;
+}
+
+// Shapes carry no payload fields, so they pass through unpacked
+Result<NestedMessage> CompressingService::EchoShape(const NestedMessage& request) {
+  return inner_->EchoShape(request);
+}
+
+Result<ArrayMessage> CompressingService::EchoShape(const ArrayMessage& request) {
+  return inner_->EchoShape(request);
+}
+
+Result<MapMessage> CompressingService::EchoShape(const MapMessage& request) {
+  return inner_->EchoShape(request);
+}
+
+Result<SparseMessage> CompressingService::EchoShape(const SparseMessage& request) {
+  return inner_->EchoShape(request);
+}
+
+Result<StringMessage> CompressingService::EchoShape(const StringMessage& request) {
+  return inner_->EchoShape(request);
+}
+
+// CompressingServerService implementation
+CompressingServerService::CompressingServerService(
+    std::shared_ptr<IBenchmarkService> inner, PayloadCodec codec, Thresholds thresholds)
+  : CompressingService(inner.get(), Side::kServer, std::move(codec), thresholds),
+    owned_(std::move(inner)) {}
+
+// CompressingClient implementation
+CompressingClient::CompressingClient(
+    std::unique_ptr<IBenchmarkClient> inner, PayloadCodec codec, Thresholds thresholds)
+  : inner_(std::move(inner)), codec_(std::move(codec)), thresholds_(thresholds) {}
+
+IBenchmarkService* CompressingClient::GetService() {
+  auto* inner_service = inner_->GetService();
+  if (!inner_service) {
+    service_.reset();
+    return nullptr;
+  }
+  if (!service_) {
+    service_ = std::make_unique<CompressingService>(inner_service, Side::kClient, codec_,
+                                                    thresholds_);
+  }
+  return service_.get();
+}
+
+bool CompressingClient::Connect(const std::string& address) {
+  service_.reset();
+  return inner_->Connect(address);
+}
+
+void CompressingClient::Disconnect() {
+  service_.reset();
+  inner_->Disconnect();
+}
+
+bool CompressingClient::IsConnected() const {
+  return inner_->IsConnected();
+}
+
+// CompressingFactory implementation
+CompressingFactory::CompressingFactory(
+    std::unique_ptr<IFrameworkFactory> inner,
+    std::shared_ptr<const ICompressor> compressor, Thresholds thresholds,
+    std::shared_ptr<Stats> stats)
+  : inner_(std::move(inner)), compressor_(std::move(compressor)), thresholds_(thresholds),
+    stats_(std::move(stats)) {}
+
+std::string CompressingFactory::GetName() const {
+  return inner_->GetName() + "+" + compressor_->GetName();
+}
+
+bool CompressingFactory::IsInProcess() const {
+  return inner_->IsInProcess();
+}
+
+std::unique_ptr<IBenchmarkClient> CompressingFactory::CreateClient() {
+  auto client = inner_->CreateClient();
+  if (!client) return nullptr;
+  return std::make_unique<CompressingClient>(std::move(client),
+                                             PayloadCodec(compressor_, stats_), thresholds_);
+}
+
+std::unique_ptr<IBenchmarkServer> CompressingFactory::CreateServer(
+    std::shared_ptr<IBenchmarkService> service) {
+  return inner_->CreateServer(std::make_shared<CompressingServerService>(
+      std::move(service), PayloadCodec(compressor_, stats_), thresholds_));
+}
+
+} // namespace compression
+} // namespace common
+} // namespace benchmark
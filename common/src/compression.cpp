@@ -0,0 +1,400 @@
+#include "compression.h"
+#include "benchmark_utils.h"
+#include <algorithm>
+#include <cstring>
+#include <sstream>
+#ifdef HAS_ZLIB
+#include <zlib.h>
+#endif
+
+namespace benchmark {
+namespace common {
+namespace compression {
+
+namespace {
+
+constexpr uint8_t kStored = 0;
+constexpr size_t kRawSizeBytes = 4;
+
+// LZ block format. A block is a series of sequences, each a token byte
+// (literal run length in the high nibble, match length minus kMinMatch in
+// the low one), the run length's overflow bytes when its nibble is 15,
+// the literals, then a u16 offset back into the output and the match
+// length's overflow bytes. The last sequence is literals only and ends at
+// the end of the block.
+constexpr size_t kMinMatch = 4;
+constexpr size_t kHashBits = 12;
+constexpr size_t kMaxOffset = 65535;
+
+uint32_t Load32(const uint8_t* data) {
+  uint32_t value;
+  std::memcpy(&value, data, 4);
+  return value;
+}
+
+uint64_t Load64(const uint8_t* data) {
+  uint64_t value;
+  std::memcpy(&value, data, 8);
+  return value;
+}
+
+uint32_t Hash(uint32_t sequence) {
+  return (sequence * 2654435761u) >> (32 - kHashBits);
+}
+
+uint8_t* PutLength(uint8_t* out, size_t length) {
+  while (length >= 255) {
+    *out++ = 255;
+    length -= 255;
+  }
+  *out++ = static_cast<uint8_t>(length);
+  return out;
+}
+
+uint8_t* PutLiterals(uint8_t* out, const uint8_t* literals, size_t count, size_t match_code) {
+  uint8_t* token = out++;
+  *token = static_cast<uint8_t>((count < 15 ? count : 15) << 4 | match_code);
+  if (count >= 15) out = PutLength(out, count - 15);
+  std::memcpy(out, literals, count);
+  return out + count;
+}
+
+// Common prefix length of `a` and `b`, reading no further than `limit`
+size_t MatchLength(const uint8_t* a, const uint8_t* b, const uint8_t* limit) {
+  const uint8_t* start = b;
+  while (b + 8 <= limit) {
+    uint64_t diff = Load64(a) ^ Load64(b);
+    if (diff) return static_cast<size_t>(b - start) + (__builtin_ctzll(diff) >> 3);
+    a += 8;
+    b += 8;
+  }
+  while (b < limit && *a == *b) {
+    a++;
+    b++;
+  }
+  return static_cast<size_t>(b - start);
+}
+
+bool GetLength(const uint8_t** in, const uint8_t* end, size_t* length) {
+  uint8_t byte;
+  do {
+    if (*in == end) return false;
+    byte = *(*in)++;
+    *length += byte;
+  } while (byte == 255);
+  return true;
+}
+
+class LzCompressor : public ICompressor {
+public:
+  std::string GetName() const override { return "lz"; }
+  uint8_t GetMethod() const override { return 1; }
+
+  size_t MaxCompressedSize(size_t size) const override {
+    return size + size / 255 + 16;
+  }
+
+  // A match length overflow byte of 255 stands for 255 output bytes, the
+  // most any input byte yields
+  size_t MaxDecompressedSize(size_t size) const override {
+    return size * 255;
+  }
+
+  size_t Compress(const uint8_t* data, size_t size, uint8_t* out) const override {
+    // Positions plus one, so that zero marks an empty slot
+    uint32_t table[1 << kHashBits] = {};
+    const uint8_t* end = data + size;
+    const uint8_t* anchor = data;
+    const uint8_t* pos = data;
+    uint8_t* start = out;
+
+    while (pos + kMinMatch <= end) {
+      uint32_t sequence = Load32(pos);
+      uint32_t& slot = table[Hash(sequence)];
+      const uint8_t* candidate = slot ? data + slot - 1 : nullptr;
+      slot = static_cast<uint32_t>(pos - data) + 1;
+
+      if (!candidate || static_cast<size_t>(pos - candidate) > kMaxOffset ||
+          Load32(candidate) != sequence) {
+        // Skip faster through data that keeps failing to match
+        pos += 1 + (static_cast<size_t>(pos - anchor) >> 6);
+        continue;
+      }
+
+      size_t length = kMinMatch + MatchLength(candidate + kMinMatch, pos + kMinMatch, end);
+      size_t match_code = length - kMinMatch < 15 ? length - kMinMatch : 15;
+      out = PutLiterals(out, anchor, static_cast<size_t>(pos - anchor), match_code);
+      uint16_t offset = static_cast<uint16_t>(pos - candidate);
+      *out++ = static_cast<uint8_t>(offset);
+      *out++ = static_cast<uint8_t>(offset >> 8);
+      if (match_code == 15) out = PutLength(out, length - kMinMatch - 15);
+      pos += length;
+      anchor = pos;
+    }
+
+    out = PutLiterals(out, anchor, static_cast<size_t>(end - anchor), 0);
+    return static_cast<size_t>(out - start);
+  }
+
+  bool Decompress(const uint8_t* data, size_t size, uint8_t* out,
+                  size_t raw_size) const override {
+    const uint8_t* in = data;
+    const uint8_t* in_end = data + size;
+    uint8_t* op = out;
+    uint8_t* out_end = out + raw_size;
+
+    while (in < in_end) {
+      uint8_t token = *in++;
+      size_t literals = token >> 4;
+      if (literals == 15 && !GetLength(&in, in_end, &literals)) return false;
+      if (literals > static_cast<size_t>(in_end - in) ||
+          literals > static_cast<size_t>(out_end - op)) {
+        return false;
+      }
+      std::memcpy(op, in, literals);
+      in += literals;
+      op += literals;
+      if (in == in_end) break;
+
+      if (in_end - in < 2) return false;
+      size_t offset = in[0] | static_cast<size_t>(in[1]) << 8;
+      in += 2;
+      size_t length = token & 15;
+      if (length == 15 && !GetLength(&in, in_end, &length)) return false;
+      length += kMinMatch;
+      if (offset == 0 || offset > static_cast<size_t>(op - out) ||
+          length > static_cast<size_t>(out_end - op)) {
+        return false;
+      }
+      // A match closer than its length repeats itself; each pass copies
+      // all that is behind the cursor, doubling the step
+      const uint8_t* match = op - offset;
+      while (length > 0) {
+        size_t step = std::min(static_cast<size_t>(op - match), length);
+        std::memcpy(op, match, step);
+        op += step;
+        length -= step;
+      }
+    }
+    return op == out_end;
+  }
+};
+
+#ifdef HAS_ZLIB
+// zlib at its fastest level, for a denser reference point than lz
+class ZlibCompressor : public ICompressor {
+public:
+  std::string GetName() const override { return "zlib"; }
+  uint8_t GetMethod() const override { return 2; }
+
+  size_t MaxCompressedSize(size_t size) const override {
+    return compressBound(static_cast<uLong>(size));
+  }
+
+  // Deflate expands at most about 1032:1
+  size_t MaxDecompressedSize(size_t size) const override {
+    return size * 1032 + 64;
+  }
+
+  size_t Compress(const uint8_t* data, size_t size, uint8_t* out) const override {
+    uLongf out_size = compressBound(static_cast<uLong>(size));
+    if (compress2(out, &out_size, data, static_cast<uLong>(size), Z_BEST_SPEED) != Z_OK) {
+      return 0;
+    }
+    return out_size;
+  }
+
+  bool Decompress(const uint8_t* data, size_t size, uint8_t* out,
+                  size_t raw_size) const override {
+    uLongf out_size = static_cast<uLongf>(raw_size);
+    return uncompress(out, &out_size, data, static_cast<uLong>(size)) == Z_OK &&
+           out_size == raw_size;
+  }
+};
+#endif
+
+bool ParseSize(const std::string& text, size_t* size) {
+  if (text.empty()) return false;
+  size_t digits = 0;
+  unsigned long long value = 0;
+  try {
+    value = std::stoull(text, &digits);
+  } catch (...) {
+    return false;
+  }
+  std::string suffix = text.substr(digits);
+  if (suffix == "K" || suffix == "k") {
+    value <<= 10;
+  } else if (suffix == "M" || suffix == "m") {
+    value <<= 20;
+  } else if (!suffix.empty()) {
+    return false;
+  }
+  *size = static_cast<size_t>(value);
+  return true;
+}
+
+} // namespace
+
+std::unique_ptr<ICompressor> CreateLzCompressor() {
+  return std::make_unique<LzCompressor>();
+}
+
+std::unique_ptr<ICompressor> CreateCompressor(const std::string& name) {
+  if (name == "lz") return CreateLzCompressor();
+#ifdef HAS_ZLIB
+  if (name == "zlib") return std::make_unique<ZlibCompressor>();
+#endif
+  return nullptr;
+}
+
+std::vector<std::string> CompressorNames() {
+  std::vector<std::string> names = {"lz"};
+#ifdef HAS_ZLIB
+  names.push_back("zlib");
+#endif
+  return names;
+}
+
+bool ParseThresholds(const std::string& text, Thresholds* thresholds) {
+  size_t all = 0;
+  if (ParseSize(text, &all)) {
+    thresholds->echo = thresholds->chunk = thresholds->batch = all;
+    return true;
+  }
+
+  std::stringstream items(text);
+  std::string item;
+  while (std::getline(items, item, ',')) {
+    size_t equals = item.find('=');
+    if (equals == std::string::npos) return false;
+    std::string key = item.substr(0, equals);
+    size_t value = 0;
+    if (!ParseSize(item.substr(equals + 1), &value)) return false;
+    if (key == "echo") {
+      thresholds->echo = value;
+    } else if (key == "chunk") {
+      thresholds->chunk = value;
+    } else if (key == "batch") {
+      thresholds->batch = value;
+    } else {
+      return false;
+    }
+  }
+  return true;
+}
+
+void Stats::Reset() {
+  packed = 0;
+  compressed = 0;
+  raw_bytes = 0;
+  wire_bytes = 0;
+  compress_ns = 0;
+  unpacked = 0;
+  unpacked_bytes = 0;
+  decompress_ns = 0;
+  errors = 0;
+}
+
+// PayloadCodec implementation
+template<typename Buffer>
+void PayloadCodec::PackInto(const uint8_t* data, size_t size, size_t threshold,
+                            Buffer* out) const {
+  if (size == 0) {
+    out->clear();
+    return;
+  }
+
+  int64_t start = utils::GetTimestampNanos();
+  size_t packed_size = 0;
+  if (size >= threshold) {
+    out->resize(1 + kRawSizeBytes + compressor_->MaxCompressedSize(size));
+    auto* bytes = reinterpret_cast<uint8_t*>(&(*out)[0]);
+    size_t compressed = compressor_->Compress(data, size, bytes + 1 + kRawSizeBytes);
+    if (compressed > 0 && compressed + kRawSizeBytes < size) {
+      bytes[0] = compressor_->GetMethod();
+      uint32_t raw_size = static_cast<uint32_t>(size);
+      std::memcpy(bytes + 1, &raw_size, kRawSizeBytes);
+      packed_size = 1 + kRawSizeBytes + compressed;
+      stats_->compressed++;
+    }
+  }
+  if (packed_size == 0) {
+    // Below the threshold or incompressible
+    out->resize(1 + size);
+    auto* bytes = reinterpret_cast<uint8_t*>(&(*out)[0]);
+    bytes[0] = kStored;
+    std::memcpy(bytes + 1, data, size);
+    packed_size = 1 + size;
+  }
+  out->resize(packed_size);
+
+  stats_->compress_ns += static_cast<uint64_t>(utils::GetTimestampNanos() - start);
+  stats_->packed++;
+  stats_->raw_bytes += size;
+  stats_->wire_bytes += packed_size;
+}
+
+template<typename Buffer>
+bool PayloadCodec::UnpackInPlace(Buffer* payload) const {
+  if (payload->empty()) return true;
+
+  int64_t start = utils::GetTimestampNanos();
+  const auto* bytes = reinterpret_cast<const uint8_t*>(payload->data());
+  bool ok = false;
+  if (bytes[0] == kStored) {
+    payload->erase(payload->begin());
+    ok = true;
+  } else if (bytes[0] == compressor_->GetMethod() && payload->size() >= 1 + kRawSizeBytes) {
+    uint32_t raw_size = 0;
+    std::memcpy(&raw_size, bytes + 1, kRawSizeBytes);
+    size_t compressed = payload->size() - 1 - kRawSizeBytes;
+    // Check the claimed size before allocating it
+    if (raw_size > 0 && raw_size <= compressor_->MaxDecompressedSize(compressed)) {
+      Buffer raw(raw_size, 0);
+      ok = compressor_->Decompress(bytes + 1 + kRawSizeBytes, compressed,
+                                   reinterpret_cast<uint8_t*>(&raw[0]), raw_size);
+      if (ok) payload->swap(raw);
+    }
+  }
+
+  stats_->decompress_ns += static_cast<uint64_t>(utils::GetTimestampNanos() - start);
+  stats_->unpacked++;
+  if (ok) {
+    stats_->unpacked_bytes += payload->size();
+  } else {
+    stats_->errors++;
+  }
+  return ok;
+}
+
+void PayloadCodec::Pack(const uint8_t* data, size_t size, size_t threshold,
+                        std::string* out) const {
+  PackInto(data, size, threshold, out);
+}
+
+void PayloadCodec::Pack(const uint8_t* data, size_t size, size_t threshold,
+                        std::vector<uint8_t>* out) const {
+  PackInto(data, size, threshold, out);
+}
+
+bool PayloadCodec::Unpack(std::string* payload) const {
+  return UnpackInPlace(payload);
+}
+
+bool PayloadCodec::Unpack(std::vector<uint8_t>* payload) const {
+  return UnpackInPlace(payload);
+}
+
+double EffectiveThroughput(const Stats& stats, double link_bytes_per_second) {
+  double raw_bytes = static_cast<double>(stats.raw_bytes.load());
+  if (raw_bytes == 0 || link_bytes_per_second <= 0) return link_bytes_per_second;
+  double cpu_seconds = static_cast<double>(stats.compress_ns.load() +
+                                           stats.decompress_ns.load()) / 1e9;
+  double wire_seconds = static_cast<double>(stats.wire_bytes.load()) / link_bytes_per_second;
+  return raw_bytes / (cpu_seconds + wire_seconds);
+}
+
+} // namespace compression
+} // namespace common
+} // namespace benchmark
@@ -0,0 +1,730 @@
+#include "flat_format.h"
+
+namespace benchmark {
+namespace common {
+namespace flat {
+
+static_assert(__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__,
+              "flat views load fields in host byte order");
+
+namespace {
+
+using wire::WireWriter;
+
+constexpr uint8_t kZeros[kAlignment] = {};
+
+// Hands out block offsets for lists and blobs in the order they follow
+// the root record. Encoders place everything first, while writing the
+// records, then write the blobs in the same order.
+class Layout {
+public:
+  explicit Layout(size_t fixed_size) : cursor_(fixed_size) {}
+
+  uint32_t Place(size_t size) {
+    size_t offset = cursor_;
+    cursor_ += AlignUp(size);
+    return static_cast<uint32_t>(offset);
+  }
+
+private:
+  size_t cursor_;
+};
+
+void PutPadding(WireWriter* writer, size_t size) {
+  writer->PutRaw(kZeros, AlignUp(size) - size);
+}
+
+void PutHeader(WireWriter* writer, Kind kind, size_t block_size) {
+  writer->PutU16(kVersion);
+  writer->PutU16(static_cast<uint16_t>(kind));
+  writer->PutU32(static_cast<uint32_t>(block_size));
+}
+
+void PutRef(WireWriter* writer, uint32_t offset, size_t length) {
+  writer->PutU32(offset);
+  writer->PutU32(static_cast<uint32_t>(length));
+}
+
+void PutBlobRef(WireWriter* writer, Layout* layout, size_t size) {
+  PutRef(writer, layout->Place(size), size);
+}
+
+void PutF64(WireWriter* writer, double value) {
+  writer->PutRaw(&value, sizeof(value));
+}
+
+void PutBlob(WireWriter* writer, const void* data, size_t size) {
+  writer->PutRaw(data, size);
+  PutPadding(writer, size);
+}
+
+template<typename T>
+void PutScalarsRef(WireWriter* writer, Layout* layout, const std::vector<T>& values) {
+  PutRef(writer, layout->Place(values.size() * sizeof(T)), values.size());
+}
+
+void PutBlob(WireWriter* writer, const std::string& value) {
+  PutBlob(writer, value.data(), value.size());
+}
+
+void PutBlob(WireWriter* writer, const std::vector<uint8_t>& value) {
+  PutBlob(writer, value.data(), value.size());
+}
+
+// EchoRequest's record and blob, shared with EchoChainRequest
+void PutRecord(const EchoRequest& message, Layout* layout, WireWriter* writer) {
+  writer->PutI64(message.timestamp);
+  writer->PutU32(message.sequence_number);
+  writer->PutU32(0);
+  PutBlobRef(writer, layout, message.message.size());
+}
+
+size_t BlobSize(const EchoRequest& message) {
+  return AlignUp(message.message.size());
+}
+
+size_t BlobSize(const BatchItem& item) {
+  return AlignUp(item.id.size()) + AlignUp(item.operation.size()) + AlignUp(item.data.size());
+}
+
+size_t BlobSize(const BatchResult& result) {
+  return AlignUp(result.id.size()) + AlignUp(result.error_message.size()) +
+         AlignUp(result.result_data.size());
+}
+
+size_t BlobSize(const SparseRecord& record) {
+  size_t size = 0;
+  for (const auto& field : record.texts) size += field ? AlignUp(field->size()) : 0;
+  return size;
+}
+
+size_t BlobSize(const StringRecord& record) {
+  size_t size = AlignUp(record.name.size()) + AlignUp(record.email.size()) +
+                AlignUp(record.city.size()) + AlignUp(record.note.size());
+  for (const auto& tag : record.tags) size += AlignUp(tag.size());
+  return size;
+}
+
+// Records and labels of a subtree
+size_t TreeSize(const TreeNode& node) {
+  size_t size = TreeNodeView::kRecordSize + AlignUp(node.label.size());
+  for (const auto& child : node.children) size += TreeSize(child);
+  return size;
+}
+
+// The nodes of a tree breadth first, root first
+std::vector<const TreeNode*> BreadthFirst(const TreeNode& root) {
+  std::vector<const TreeNode*> nodes{&root};
+  for (size_t i = 0; i < nodes.size(); i++) {
+    for (const auto& child : nodes[i]->children) nodes.push_back(&child);
+  }
+  return nodes;
+}
+
+template<typename View>
+constexpr size_t FixedSize() {
+  return kHeaderSize + View::kRecordSize;
+}
+
+void CopyBytes(ByteView from, std::vector<uint8_t>* to) {
+  to->assign(from.data, from.data + from.size);
+}
+
+template<typename T>
+void CopyScalars(ScalarListView<T> from, std::vector<T>* to) {
+  to->resize(from.size());
+  if (!to->empty()) std::memcpy(to->data(), from.bytes(), to->size() * sizeof(T));
+}
+
+void CopyTree(TreeNodeView view, TreeNode* to) {
+  to->id = view.id();
+  to->weight = view.weight();
+  to->label.assign(view.label());
+  auto children = view.children();
+  to->children.resize(children.size());
+  for (size_t i = 0; i < children.size(); i++) CopyTree(children[i], &to->children[i]);
+}
+
+} // namespace
+
+// Validation
+bool PeekKind(const uint8_t* data, size_t size, Kind* kind) {
+  if (size < kHeaderSize) return false;
+  uint16_t raw_kind = 0;
+  std::memcpy(&raw_kind, data + 2, 2);
+  *kind = static_cast<Kind>(raw_kind);
+  return true;
+}
+
+bool RecordView::CheckRef(size_t block_size, const uint8_t* record, size_t offset,
+                          size_t item_size) {
+  uint32_t start = 0;
+  uint32_t length = 0;
+  std::memcpy(&start, record + offset, 4);
+  std::memcpy(&length, record + offset + 4, 4);
+  return static_cast<uint64_t>(start) + static_cast<uint64_t>(length) * item_size <= block_size;
+}
+
+bool CheckHeader(const uint8_t* data, size_t size, Kind kind, size_t record_size,
+                 size_t* block_size) {
+  if (size < kHeaderSize) return false;
+  uint16_t version = 0;
+  uint16_t raw_kind = 0;
+  uint32_t raw_size = 0;
+  std::memcpy(&version, data, 2);
+  std::memcpy(&raw_kind, data + 2, 2);
+  std::memcpy(&raw_size, data + 4, 4);
+  if (version != kVersion || raw_kind != static_cast<uint16_t>(kind)) return false;
+  if (raw_size < kHeaderSize + record_size || raw_size > size) return false;
+  *block_size = raw_size;
+  return true;
+}
+
+bool EchoRequestView::Check(const uint8_t* /*block*/, size_t size, const uint8_t* record) {
+  return CheckRef(size, record, 16);
+}
+
+bool EchoResponseView::Check(const uint8_t* /*block*/, size_t size, const uint8_t* record) {
+  return CheckRef(size, record, 24);
+}
+
+bool DataChunkView::Check(const uint8_t* /*block*/, size_t size, const uint8_t* record) {
+  return CheckRef(size, record, 16);
+}
+
+bool BatchItemView::Check(const uint8_t* /*block*/, size_t size, const uint8_t* record) {
+  return CheckRef(size, record, 0) && CheckRef(size, record, 8) && CheckRef(size, record, 16);
+}
+
+bool BatchRequestView::Check(const uint8_t* block, size_t size, const uint8_t* record) {
+  if (!CheckRef(size, record, 0, BatchItemView::kRecordSize)) return false;
+  BatchRequestView view(block, record);
+  auto items = view.items();
+  for (size_t i = 0; i < items.size(); i++) {
+    if (!BatchItemView::Check(block, size, block + view.Load<uint32_t>(0) +
+                                               i * BatchItemView::kRecordSize)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool BatchResultView::Check(const uint8_t* /*block*/, size_t size, const uint8_t* record) {
+  return CheckRef(size, record, 0) && CheckRef(size, record, 8) && CheckRef(size, record, 16);
+}
+
+bool BatchResponseView::Check(const uint8_t* block, size_t size, const uint8_t* record) {
+  if (!CheckRef(size, record, 0, BatchResultView::kRecordSize)) return false;
+  BatchResponseView view(block, record);
+  auto results = view.results();
+  for (size_t i = 0; i < results.size(); i++) {
+    if (!BatchResultView::Check(block, size, block + view.Load<uint32_t>(0) +
+                                                 i * BatchResultView::kRecordSize)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool EchoChainRequestView::Check(const uint8_t* block, size_t size, const uint8_t* record) {
+  return EchoRequestView::Check(block, size, record + 8);
+}
+
+bool StatusView::Check(const uint8_t* /*block*/, size_t size, const uint8_t* record) {
+  return CheckRef(size, record, 8);
+}
+
+bool TextItemView::Check(const uint8_t* /*block*/, size_t size, const uint8_t* record) {
+  return CheckRef(size, record, 0);
+}
+
+bool TreeNodeView::Check(const uint8_t* block, size_t size, const uint8_t* record) {
+  size_t budget = size / kRecordSize;
+  return CheckSubtree(block, size, record, 1, &budget);
+}
+
+bool TreeNodeView::CheckSubtree(const uint8_t* block, size_t size, const uint8_t* record,
+                                size_t depth, size_t* budget) {
+  if (depth > kMaxTreeDepth || *budget == 0) return false;
+  --*budget;
+  if (!CheckRef(size, record, 16) || !CheckRef(size, record, 24, kRecordSize)) return false;
+  TreeNodeView view(block, record);
+  const uint8_t* children = block + view.Load<uint32_t>(24);
+  for (size_t i = 0; i < view.children().size(); i++) {
+    if (!CheckSubtree(block, size, children + i * kRecordSize, depth + 1, budget)) return false;
+  }
+  return true;
+}
+
+bool ArrayMessageView::Check(const uint8_t* /*block*/, size_t size, const uint8_t* record) {
+  return CheckRef(size, record, 0, sizeof(int64_t)) && CheckRef(size, record, 8, sizeof(double)) &&
+         CheckRef(size, record, 16, sizeof(uint32_t));
+}
+
+bool CounterEntryView::Check(const uint8_t* /*block*/, size_t size, const uint8_t* record) {
+  return CheckRef(size, record, 0);
+}
+
+bool LabelEntryView::Check(const uint8_t* /*block*/, size_t size, const uint8_t* record) {
+  return CheckRef(size, record, 8);
+}
+
+bool MapMessageView::Check(const uint8_t* block, size_t size, const uint8_t* record) {
+  return CheckList<CounterEntryView>(block, size, record, 0) &&
+         CheckList<LabelEntryView>(block, size, record, 8);
+}
+
+bool SparseRecordView::Check(const uint8_t* /*block*/, size_t size, const uint8_t* record) {
+  for (size_t i = 0; i < SparseRecord::kTextFields; i++) {
+    if (!CheckRef(size, record, 8 + 8 * (kTextBit + i))) return false;
+  }
+  return true;
+}
+
+bool SparseMessageView::Check(const uint8_t* block, size_t size, const uint8_t* record) {
+  return CheckList<SparseRecordView>(block, size, record, 0);
+}
+
+bool StringRecordView::Check(const uint8_t* block, size_t size, const uint8_t* record) {
+  return CheckRef(size, record, 0) && CheckRef(size, record, 8) && CheckRef(size, record, 16) &&
+         CheckRef(size, record, 24) && CheckList<TextItemView>(block, size, record, 32);
+}
+
+bool StringMessageView::Check(const uint8_t* block, size_t size, const uint8_t* record) {
+  return CheckList<StringRecordView>(block, size, record, 0);
+}
+
+// Sizes
+size_t EncodedSize(const EchoRequest& message) {
+  return FixedSize<EchoRequestView>() + BlobSize(message);
+}
+
+size_t EncodedSize(const EchoResponse& message) {
+  return FixedSize<EchoResponseView>() + AlignUp(message.message.size());
+}
+
+size_t EncodedSize(const StreamRequest& /*message*/) {
+  return FixedSize<StreamRequestView>();
+}
+
+size_t EncodedSize(const DataChunk& message) {
+  return FixedSize<DataChunkView>() + AlignUp(message.data.size());
+}
+
+size_t EncodedSize(const UploadResponse& /*message*/) {
+  return FixedSize<UploadResponseView>();
+}
+
+size_t EncodedSize(const BatchRequest& message) {
+  size_t size = FixedSize<BatchRequestView>() +
+                message.items.size() * BatchItemView::kRecordSize;
+  for (const auto& item : message.items) size += BlobSize(item);
+  return size;
+}
+
+size_t EncodedSize(const BatchResponse& message) {
+  size_t size = FixedSize<BatchResponseView>() +
+                message.results.size() * BatchResultView::kRecordSize;
+  for (const auto& result : message.results) size += BlobSize(result);
+  return size;
+}
+
+size_t EncodedSize(const wire::EchoChainRequest& message) {
+  return FixedSize<EchoChainRequestView>() + BlobSize(message.request);
+}
+
+size_t EncodedSize(const NestedMessage& message) {
+  return kHeaderSize + TreeSize(message.root);
+}
+
+size_t EncodedSize(const ArrayMessage& message) {
+  return FixedSize<ArrayMessageView>() + AlignUp(message.values.size() * sizeof(int64_t)) +
+         AlignUp(message.samples.size() * sizeof(double)) +
+         AlignUp(message.counts.size() * sizeof(uint32_t));
+}
+
+size_t EncodedSize(const MapMessage& message) {
+  size_t size = FixedSize<MapMessageView>() +
+                message.counters.size() * CounterEntryView::kRecordSize +
+                message.labels.size() * LabelEntryView::kRecordSize;
+  for (const auto& entry : message.counters) size += AlignUp(entry.first.size());
+  for (const auto& entry : message.labels) size += AlignUp(entry.second.size());
+  return size;
+}
+
+size_t EncodedSize(const SparseMessage& message) {
+  size_t size = FixedSize<SparseMessageView>() +
+                message.records.size() * SparseRecordView::kRecordSize;
+  for (const auto& record : message.records) size += BlobSize(record);
+  return size;
+}
+
+size_t EncodedSize(const StringMessage& message) {
+  size_t size = FixedSize<StringMessageView>() +
+                message.records.size() * StringRecordView::kRecordSize;
+  for (const auto& record : message.records) {
+    size += record.tags.size() * TextItemView::kRecordSize + BlobSize(record);
+  }
+  return size;
+}
+
+// Encoders
+void Encode(const EchoRequest& message, WireWriter* writer) {
+  PutHeader(writer, Kind::kEchoRequest, EncodedSize(message));
+  Layout layout(FixedSize<EchoRequestView>());
+  PutRecord(message, &layout, writer);
+  PutBlob(writer, message.message);
+}
+
+void Encode(const EchoResponse& message, WireWriter* writer) {
+  PutHeader(writer, Kind::kEchoResponse, EncodedSize(message));
+  Layout layout(FixedSize<EchoResponseView>());
+  writer->PutI64(message.client_timestamp);
+  writer->PutI64(message.server_timestamp);
+  writer->PutU32(message.sequence_number);
+  writer->PutU32(0);
+  PutBlobRef(writer, &layout, message.message.size());
+  PutBlob(writer, message.message);
+}
+
+void Encode(const StreamRequest& message, WireWriter* writer) {
+  PutHeader(writer, Kind::kStreamRequest, EncodedSize(message));
+  writer->PutU32(message.chunk_size);
+  writer->PutU32(message.chunk_count);
+  writer->PutU32(message.delay_ms);
+  writer->PutU32(0);
+}
+
+void Encode(const DataChunk& message, WireWriter* writer) {
+  PutHeader(writer, Kind::kDataChunk, EncodedSize(message));
+  Layout layout(FixedSize<DataChunkView>());
+  writer->PutI64(message.timestamp);
+  writer->PutU32(message.sequence_number);
+  writer->PutU32(message.checksum);
+  PutBlobRef(writer, &layout, message.data.size());
+  PutBlob(writer, message.data);
+}
+
+void Encode(const UploadResponse& message, WireWriter* writer) {
+  PutHeader(writer, Kind::kUploadResponse, EncodedSize(message));
+  writer->PutU64(message.total_bytes);
+  writer->PutI64(message.duration_ns);
+  writer->PutU32(message.chunk_count);
+  writer->PutBool(message.checksum_valid);
+  writer->PutRaw(kZeros, 3);
+}
+
+void Encode(const BatchRequest& message, WireWriter* writer) {
+  PutHeader(writer, Kind::kBatchRequest, EncodedSize(message));
+  Layout layout(FixedSize<BatchRequestView>());
+  size_t count = message.items.size();
+  PutRef(writer, layout.Place(count * BatchItemView::kRecordSize), count);
+  writer->PutBool(message.fail_on_error);
+  writer->PutRaw(kZeros, 7);
+
+  for (const auto& item : message.items) {
+    PutBlobRef(writer, &layout, item.id.size());
+    PutBlobRef(writer, &layout, item.operation.size());
+    PutBlobRef(writer, &layout, item.data.size());
+  }
+  for (const auto& item : message.items) {
+    PutBlob(writer, item.id);
+    PutBlob(writer, item.operation);
+    PutBlob(writer, item.data);
+  }
+}
+
+void Encode(const BatchResponse& message, WireWriter* writer) {
+  PutHeader(writer, Kind::kBatchResponse, EncodedSize(message));
+  Layout layout(FixedSize<BatchResponseView>());
+  size_t count = message.results.size();
+  PutRef(writer, layout.Place(count * BatchResultView::kRecordSize), count);
+  writer->PutU32(message.total_processed);
+  writer->PutU32(message.total_failed);
+
+  for (const auto& result : message.results) {
+    PutBlobRef(writer, &layout, result.id.size());
+    PutBlobRef(writer, &layout, result.error_message.size());
+    PutBlobRef(writer, &layout, result.result_data.size());
+    writer->PutBool(result.success);
+    writer->PutRaw(kZeros, 7);
+  }
+  for (const auto& result : message.results) {
+    PutBlob(writer, result.id);
+    PutBlob(writer, result.error_message);
+    PutBlob(writer, result.result_data);
+  }
+}
+
+void Encode(const wire::EchoChainRequest& message, WireWriter* writer) {
+  PutHeader(writer, Kind::kEchoChainRequest, flat::EncodedSize(message));
+  Layout layout(FixedSize<EchoChainRequestView>());
+  writer->PutU32(message.length);
+  writer->PutU32(0);
+  PutRecord(message.request, &layout, writer);
+  PutBlob(writer, message.request.message);
+}
+
+void Encode(const NestedMessage& message, WireWriter* writer) {
+  PutHeader(writer, Kind::kNestedMessage, flat::EncodedSize(message));
+  // Written breadth first, each node's children are the next records to
+  // be placed, so the lists follow the root record back to back and the
+  // labels come after them
+  auto nodes = BreadthFirst(message.root);
+  Layout lists(FixedSize<NestedMessageView>());
+  Layout blobs(kHeaderSize + nodes.size() * TreeNodeView::kRecordSize);
+  for (const TreeNode* node : nodes) {
+    writer->PutI64(node->id);
+    PutF64(writer, node->weight);
+    PutBlobRef(writer, &blobs, node->label.size());
+    size_t count = node->children.size();
+    PutRef(writer, lists.Place(count * TreeNodeView::kRecordSize), count);
+  }
+  for (const TreeNode* node : nodes) PutBlob(writer, node->label);
+}
+
+void Encode(const ArrayMessage& message, WireWriter* writer) {
+  PutHeader(writer, Kind::kArrayMessage, flat::EncodedSize(message));
+  Layout layout(FixedSize<ArrayMessageView>());
+  PutScalarsRef(writer, &layout, message.values);
+  PutScalarsRef(writer, &layout, message.samples);
+  PutScalarsRef(writer, &layout, message.counts);
+  PutBlob(writer, message.values.data(), message.values.size() * sizeof(int64_t));
+  PutBlob(writer, message.samples.data(), message.samples.size() * sizeof(double));
+  PutBlob(writer, message.counts.data(), message.counts.size() * sizeof(uint32_t));
+}
+
+void Encode(const MapMessage& message, WireWriter* writer) {
+  PutHeader(writer, Kind::kMapMessage, flat::EncodedSize(message));
+  Layout layout(FixedSize<MapMessageView>());
+  size_t counters = message.counters.size();
+  size_t labels = message.labels.size();
+  PutRef(writer, layout.Place(counters * CounterEntryView::kRecordSize), counters);
+  PutRef(writer, layout.Place(labels * LabelEntryView::kRecordSize), labels);
+
+  for (const auto& entry : message.counters) {
+    PutBlobRef(writer, &layout, entry.first.size());
+    writer->PutI64(entry.second);
+  }
+  for (const auto& entry : message.labels) {
+    writer->PutU32(entry.first);
+    writer->PutU32(0);
+    PutBlobRef(writer, &layout, entry.second.size());
+  }
+  for (const auto& entry : message.counters) PutBlob(writer, entry.first);
+  for (const auto& entry : message.labels) PutBlob(writer, entry.second);
+}
+
+void Encode(const SparseMessage& message, WireWriter* writer) {
+  PutHeader(writer, Kind::kSparseMessage, flat::EncodedSize(message));
+  Layout layout(FixedSize<SparseMessageView>());
+  size_t count = message.records.size();
+  PutRef(writer, layout.Place(count * SparseRecordView::kRecordSize), count);
+
+  for (const auto& record : message.records) {
+    uint32_t present = 0;
+    for (size_t i = 0; i < SparseRecord::kIntFields; i++) {
+      if (record.ints[i]) present |= 1u << i;
+    }
+    for (size_t i = 0; i < SparseRecord::kDoubleFields; i++) {
+      if (record.doubles[i]) present |= 1u << (SparseRecordView::kDoubleBit + i);
+    }
+    for (size_t i = 0; i < SparseRecord::kTextFields; i++) {
+      if (record.texts[i]) present |= 1u << (SparseRecordView::kTextBit + i);
+    }
+    writer->PutU32(present);
+    writer->PutU32(0);
+    for (const auto& field : record.ints) writer->PutI64(field.value_or(0));
+    for (const auto& field : record.doubles) PutF64(writer, field.value_or(0.0));
+    for (const auto& field : record.texts) PutBlobRef(writer, &layout, field ? field->size() : 0);
+  }
+  for (const auto& record : message.records) {
+    for (const auto& field : record.texts) {
+      if (field) PutBlob(writer, *field);
+    }
+  }
+}
+
+void Encode(const StringMessage& message, WireWriter* writer) {
+  size_t block_size = flat::EncodedSize(message);
+  PutHeader(writer, Kind::kStringMessage, block_size);
+  // The records' tag lists hold Refs of their own, so lists and blobs are
+  // laid out separately: every list first, then every string
+  size_t blob_size = 0;
+  for (const auto& record : message.records) blob_size += BlobSize(record);
+  Layout lists(FixedSize<StringMessageView>());
+  Layout blobs(block_size - blob_size);
+  size_t count = message.records.size();
+  PutRef(writer, lists.Place(count * StringRecordView::kRecordSize), count);
+
+  for (const auto& record : message.records) {
+    PutBlobRef(writer, &blobs, record.name.size());
+    PutBlobRef(writer, &blobs, record.email.size());
+    PutBlobRef(writer, &blobs, record.city.size());
+    PutBlobRef(writer, &blobs, record.note.size());
+    size_t tags = record.tags.size();
+    PutRef(writer, lists.Place(tags * TextItemView::kRecordSize), tags);
+  }
+  for (const auto& record : message.records) {
+    for (const auto& tag : record.tags) PutBlobRef(writer, &blobs, tag.size());
+  }
+  for (const auto& record : message.records) {
+    PutBlob(writer, record.name);
+    PutBlob(writer, record.email);
+    PutBlob(writer, record.city);
+    PutBlob(writer, record.note);
+  }
+  for (const auto& record : message.records) {
+    for (const auto& tag : record.tags) PutBlob(writer, tag);
+  }
+}
+
+void EncodeStatus(ErrorCode code, const std::string& message, WireWriter* writer) {
+  PutHeader(writer, Kind::kStatus, FixedSize<StatusView>() + AlignUp(message.size()));
+  Layout layout(FixedSize<StatusView>());
+  writer->PutU32(static_cast<uint32_t>(code));
+  writer->PutU32(0);
+  PutBlobRef(writer, &layout, message.size());
+  PutBlob(writer, message);
+}
+
+// Copying out
+void CopyOut(EchoRequestView view, EchoRequest* to) {
+  to->message.assign(view.message());
+  to->timestamp = view.timestamp();
+  to->sequence_number = view.sequence_number();
+}
+
+void CopyOut(EchoResponseView view, EchoResponse* to) {
+  to->message.assign(view.message());
+  to->client_timestamp = view.client_timestamp();
+  to->server_timestamp = view.server_timestamp();
+  to->sequence_number = view.sequence_number();
+}
+
+void CopyOut(StreamRequestView view, StreamRequest* to) {
+  to->chunk_size = view.chunk_size();
+  to->chunk_count = view.chunk_count();
+  to->delay_ms = view.delay_ms();
+}
+
+void CopyOut(DataChunkView view, DataChunk* to) {
+  to->sequence_number = view.sequence_number();
+  CopyBytes(view.data(), &to->data);
+  to->checksum = view.checksum();
+  to->timestamp = view.timestamp();
+}
+
+void CopyOut(UploadResponseView view, UploadResponse* to) {
+  to->total_bytes = view.total_bytes();
+  to->chunk_count = view.chunk_count();
+  to->duration_ns = view.duration_ns();
+  to->checksum_valid = view.checksum_valid();
+}
+
+void CopyOut(BatchRequestView view, BatchRequest* to) {
+  auto items = view.items();
+  to->items.resize(items.size());
+  for (size_t i = 0; i < items.size(); i++) {
+    BatchItemView item = items[i];
+    to->items[i].id.assign(item.id());
+    to->items[i].operation.assign(item.operation());
+    CopyBytes(item.data(), &to->items[i].data);
+  }
+  to->fail_on_error = view.fail_on_error();
+}
+
+void CopyOut(BatchResponseView view, BatchResponse* to) {
+  auto results = view.results();
+  to->results.resize(results.size());
+  for (size_t i = 0; i < results.size(); i++) {
+    BatchResultView result = results[i];
+    to->results[i].id.assign(result.id());
+    to->results[i].success = result.success();
+    to->results[i].error_message.assign(result.error_message());
+    CopyBytes(result.result_data(), &to->results[i].result_data);
+  }
+  to->total_processed = view.total_processed();
+  to->total_failed = view.total_failed();
+}
+
+void CopyOut(EchoChainRequestView view, wire::EchoChainRequest* to) {
+  to->length = view.length();
+  CopyOut(view.request(), &to->request);
+}
+
+void CopyOut(NestedMessageView view, NestedMessage* to) {
+  CopyTree(view.root(), &to->root);
+}
+
+void CopyOut(ArrayMessageView view, ArrayMessage* to) {
+  CopyScalars(view.values(), &to->values);
+  CopyScalars(view.samples(), &to->samples);
+  CopyScalars(view.counts(), &to->counts);
+}
+
+void CopyOut(MapMessageView view, MapMessage* to) {
+  // Entries arrive in key order, so each insert goes at the end
+  to->counters.clear();
+  auto counters = view.counters();
+  for (size_t i = 0; i < counters.size(); i++) {
+    to->counters.emplace_hint(to->counters.end(), std::string(counters[i].key()),
+                              counters[i].value());
+  }
+  to->labels.clear();
+  auto labels = view.labels();
+  for (size_t i = 0; i < labels.size(); i++) {
+    to->labels.emplace_hint(to->labels.end(), labels[i].key(), std::string(labels[i].value()));
+  }
+}
+
+void CopyOut(SparseMessageView view, SparseMessage* to) {
+  auto records = view.records();
+  to->records.resize(records.size());
+  for (size_t i = 0; i < records.size(); i++) {
+    SparseRecordView record = records[i];
+    SparseRecord& out = to->records[i];
+    uint32_t present = record.present();
+    for (size_t f = 0; f < SparseRecord::kIntFields; f++) {
+      if (present & (1u << f)) {
+        out.ints[f] = record.int_value(f);
+      } else {
+        out.ints[f].reset();
+      }
+    }
+    for (size_t f = 0; f < SparseRecord::kDoubleFields; f++) {
+      if (present & (1u << (SparseRecordView::kDoubleBit + f))) {
+        out.doubles[f] = record.double_value(f);
+      } else {
+        out.doubles[f].reset();
+      }
+    }
+    for (size_t f = 0; f < SparseRecord::kTextFields; f++) {
+      if (present & (1u << (SparseRecordView::kTextBit + f))) {
+        out.texts[f].emplace(record.text_value(f));
+      } else {
+        out.texts[f].reset();
+      }
+    }
+  }
+}
+
+void CopyOut(StringMessageView view, StringMessage* to) {
+  auto records = view.records();
+  to->records.resize(records.size());
+  for (size_t i = 0; i < records.size(); i++) {
+    StringRecordView record = records[i];
+    StringRecord& out = to->records[i];
+    out.name.assign(record.name());
+    out.email.assign(record.email());
+    out.city.assign(record.city());
+    out.note.assign(record.note());
+    auto tags = record.tags();
+    out.tags.resize(tags.size());
+    for (size_t t = 0; t < tags.size(); t++) out.tags[t].assign(tags[t].value());
+  }
+}
+
+} // namespace flat
+} // namespace common
+} // namespace benchmark
@@ -0,0 +1,454 @@
+#include "framed_service.h"
+#include "flat_format.h"
+#include "work_stealing_executor.h"
+#include <condition_variable>
+
+namespace benchmark {
+namespace common {
+namespace wire {
+
+namespace {
+
+const char* const kConnectionLost = "Connection lost";
+const char* const kNotConnected = "Not connected";
+
+// Handler for a call answered by exactly one response or error frame
+template<typename Response>
+CallTable::Handler UnaryHandler(MessageType response_type,
+                                ResponseCallback<Response> callback) {
+  return [response_type, callback](const FrameHeader* header, WireReader* reader) {
+    if (!header) {
+      callback(Result<Response>(ErrorCode::UNAVAILABLE, kConnectionLost));
+      return true;
+    }
+
+    if (header->type == response_type) {
+      Response response;
+      if (Decode(reader, &response)) {
+        callback(Result<Response>(std::move(response)));
+      } else {
+        callback(Result<Response>(ErrorCode::INTERNAL, "Malformed response"));
+      }
+      return true;
+    }
+
+    ErrorCode code = ErrorCode::INTERNAL;
+    std::string message = "Unexpected response";
+    if (header->type == MessageType::kError) {
+      DecodeStatus(reader, &code, &message);
+    }
+    callback(Result<Response>(code, message));
+    return true;
+  };
+}
+
+// Handler for a call answered by chunk frames and a closing status
+CallTable::Handler StreamHandler(StreamCallback<DataChunk> on_chunk,
+                                 CompletionCallback on_complete) {
+  return [on_chunk, on_complete](const FrameHeader* header, WireReader* reader) {
+    if (!header) {
+      on_complete(ErrorCode::UNAVAILABLE, kConnectionLost);
+      return true;
+    }
+
+    if (header->type == MessageType::kStreamChunk) {
+      DataChunk chunk;
+      if (!Decode(reader, &chunk)) {
+        on_complete(ErrorCode::INTERNAL, "Malformed chunk");
+        return true;
+      }
+      on_chunk(chunk);
+      return false;
+    }
+
+    ErrorCode code = ErrorCode::INTERNAL;
+    std::string message = "Unexpected response";
+    if (header->type == MessageType::kStreamEnd || header->type == MessageType::kError) {
+      DecodeStatus(reader, &code, &message);
+    }
+    on_complete(code, message);
+    return true;
+  };
+}
+
+// Answer a unary call with its response or error frame
+template<typename Response>
+void SendResult(FrameSender* sender, MessageType response_type, uint32_t call_id,
+                const Result<Response>& result) {
+  if (result.ok()) {
+    SendMessage(sender, response_type, call_id, result.value);
+  } else {
+    SendStatus(sender, MessageType::kError, call_id, result.error_code, result.error_message);
+  }
+}
+
+} // namespace
+
+bool SendStatus(FrameSender* sender, MessageType type, uint32_t call_id,
+                ErrorCode code, const std::string& message) {
+  WireWriter counter;
+  EncodeStatus(code, message, &counter);
+  return sender->SendFrame(type, call_id, counter.size(), [&](WireWriter* writer) {
+    EncodeStatus(code, message, writer);
+  });
+}
+
+// CallTable implementation
+void CallTable::Register(uint32_t call_id, Handler handler) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  calls_[call_id] = std::make_shared<Handler>(std::move(handler));
+}
+
+bool CallTable::Remove(uint32_t call_id) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return calls_.erase(call_id) > 0;
+}
+
+void CallTable::Deliver(const FrameHeader& header, const uint8_t* body) {
+  std::shared_ptr<Handler> handler;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = calls_.find(header.call_id);
+    if (it == calls_.end()) return;
+    handler = it->second;
+  }
+
+  WireReader reader(body, header.body_length);
+  if ((*handler)(&header, &reader)) {
+    Remove(header.call_id);
+  }
+}
+
+void CallTable::FailAll() {
+  std::unordered_map<uint32_t, std::shared_ptr<Handler>> pending;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    pending.swap(calls_);
+  }
+  for (auto& entry : pending) {
+    (*entry.second)(nullptr, nullptr);
+  }
+}
+
+// FramedServiceStub implementation
+bool FramedServiceStub::StartCall(uint32_t call_id, CallTable::Handler handler,
+                                  const std::function<bool()>& send) {
+  calls_->Register(call_id, std::move(handler));
+  if (send()) return true;
+
+  // Only report failure if the connection has not already failed the call
+  return !calls_->Remove(call_id);
+}
+
+template<typename Request, typename Response>
+void FramedServiceStub::StartUnary(MessageType request_type, MessageType response_type,
+                                   const Request& request,
+                                   ResponseCallback<Response> callback) {
+  uint32_t call_id = calls_->NextCallId();
+  bool started = StartCall(
+      call_id, UnaryHandler<Response>(response_type, callback),
+      [&]() { return SendMessage(sender_, request_type, call_id, request); });
+  if (!started) {
+    callback(Result<Response>(ErrorCode::UNAVAILABLE, kNotConnected));
+  }
+}
+
+template<typename Request, typename Response>
+Result<Response> FramedServiceStub::CallUnary(MessageType request_type,
+                                              MessageType response_type,
+                                              const Request& request) {
+  struct Waiter {
+    std::mutex mutex;
+    std::condition_variable cv;
+    bool done = false;
+    Result<Response> result;
+  };
+  auto waiter = std::make_shared<Waiter>();
+
+  StartUnary<Request, Response>(
+      request_type, response_type, request,
+      [waiter](const Result<Response>& result) {
+        std::lock_guard<std::mutex> lock(waiter->mutex);
+        waiter->result = result;
+        waiter->done = true;
+        waiter->cv.notify_one();
+      });
+
+  std::unique_lock<std::mutex> lock(waiter->mutex);
+  waiter->cv.wait(lock, [&] { return waiter->done; });
+  return std::move(waiter->result);
+}
+
+bool FramedServiceStub::StartClientStream(MessageType begin_type, MessageType chunk_type,
+                                          CallTable::Handler handler,
+                                          StreamCallback<DataChunk>& chunk_provider) {
+  uint32_t call_id = calls_->NextCallId();
+  bool started = StartCall(call_id, std::move(handler), [&]() {
+    return sender_->SendFrame(begin_type, call_id, 0, [](WireWriter*) {});
+  });
+  if (!started) return false;
+
+  FrameSender* sender = sender_;
+  chunk_provider = [sender, call_id, chunk_type](const DataChunk& chunk) {
+    SendMessage(sender, chunk_type, call_id, chunk);
+  };
+  return true;
+}
+
+Result<EchoResponse> FramedServiceStub::Echo(const EchoRequest& request) {
+  return CallUnary<EchoRequest, EchoResponse>(
+      MessageType::kEchoRequest, MessageType::kEchoResponse, request);
+}
+
+void FramedServiceStub::EchoAsync(const EchoRequest& request,
+                                  ResponseCallback<EchoResponse> callback) {
+  StartUnary<EchoRequest, EchoResponse>(
+      MessageType::kEchoRequest, MessageType::kEchoResponse, request, std::move(callback));
+}
+
+void FramedServiceStub::StreamData(const StreamRequest& request,
+                                   StreamCallback<DataChunk> on_chunk,
+                                   CompletionCallback on_complete) {
+  uint32_t call_id = calls_->NextCallId();
+  bool started = StartCall(
+      call_id, StreamHandler(std::move(on_chunk), on_complete),
+      [&]() { return SendMessage(sender_, MessageType::kStreamRequest, call_id, request); });
+  if (!started) {
+    on_complete(ErrorCode::UNAVAILABLE, kNotConnected);
+  }
+}
+
+void FramedServiceStub::UploadData(StreamCallback<DataChunk>& chunk_provider,
+                                   ResponseCallback<UploadResponse> on_complete) {
+  auto handler = UnaryHandler<UploadResponse>(MessageType::kUploadResponse, on_complete);
+  if (!StartClientStream(MessageType::kUploadBegin, MessageType::kUploadChunk,
+                         std::move(handler), chunk_provider)) {
+    on_complete(Result<UploadResponse>(ErrorCode::UNAVAILABLE, kNotConnected));
+  }
+}
+
+void FramedServiceStub::BidirectionalStream(StreamCallback<DataChunk>& chunk_provider,
+                                            StreamCallback<DataChunk> on_chunk,
+                                            CompletionCallback on_complete) {
+  if (!StartClientStream(MessageType::kBidiBegin, MessageType::kBidiChunk,
+                         StreamHandler(std::move(on_chunk), on_complete), chunk_provider)) {
+    on_complete(ErrorCode::UNAVAILABLE, kNotConnected);
+  }
+}
+
+Result<BatchResponse> FramedServiceStub::BatchProcess(const BatchRequest& request) {
+  return CallUnary<BatchRequest, BatchResponse>(
+      MessageType::kBatchRequest, MessageType::kBatchResponse, request);
+}
+
+void FramedServiceStub::BatchProcessAsync(const BatchRequest& request,
+                                          ResponseCallback<BatchResponse> callback) {
+  StartUnary<BatchRequest, BatchResponse>(
+      MessageType::kBatchRequest, MessageType::kBatchResponse, request, std::move(callback));
+}
+
+Result<EchoResponse> FramedServiceStub::EchoChain(const EchoRequest& request, uint32_t length) {
+  if (length == 0) return IBenchmarkService::EchoChain(request, length);
+  EchoChainRequest chain;
+  chain.length = length;
+  chain.request = request;
+  return CallUnary<EchoChainRequest, EchoResponse>(
+      MessageType::kEchoChain, MessageType::kEchoResponse, chain);
+}
+
+// Every shape travels as kShapeEcho both ways
+Result<NestedMessage> FramedServiceStub::EchoShape(const NestedMessage& request) {
+  return CallUnary<NestedMessage, NestedMessage>(
+      MessageType::kShapeEcho, MessageType::kShapeEcho, request);
+}
+
+Result<ArrayMessage> FramedServiceStub::EchoShape(const ArrayMessage& request) {
+  return CallUnary<ArrayMessage, ArrayMessage>(
+      MessageType::kShapeEcho, MessageType::kShapeEcho, request);
+}
+
+Result<MapMessage> FramedServiceStub::EchoShape(const MapMessage& request) {
+  return CallUnary<MapMessage, MapMessage>(
+      MessageType::kShapeEcho, MessageType::kShapeEcho, request);
+}
+
+Result<SparseMessage> FramedServiceStub::EchoShape(const SparseMessage& request) {
+  return CallUnary<SparseMessage, SparseMessage>(
+      MessageType::kShapeEcho, MessageType::kShapeEcho, request);
+}
+
+Result<StringMessage> FramedServiceStub::EchoShape(const StringMessage& request) {
+  return CallUnary<StringMessage, StringMessage>(
+      MessageType::kShapeEcho, MessageType::kShapeEcho, request);
+}
+
+// ServiceDispatcher implementation
+bool ServiceDispatcher::Dispatch(const FrameHeader& header, const uint8_t* body) {
+  WireReader reader(body, header.body_length);
+  uint32_t call_id = header.call_id;
+  FrameSender* sender = sender_.get();
+
+  switch (header.type) {
+    case MessageType::kEchoRequest: {
+      EchoRequest request;
+      if (!Decode(&reader, &request)) return false;
+      if (executor_) {
+        auto service = service_;
+        auto keep = sender_;
+        bool queued = executor_->Submit([service, keep, call_id, request = std::move(request)]() {
+          SendResult(keep.get(), MessageType::kEchoResponse, call_id, service->Echo(request));
+        });
+        if (queued) return true;
+        SendStatus(sender, MessageType::kError, call_id, ErrorCode::UNAVAILABLE,
+                   "Server shutting down");
+        return true;
+      }
+      SendResult(sender, MessageType::kEchoResponse, call_id, service_->Echo(request));
+      return true;
+    }
+
+    case MessageType::kBatchRequest: {
+      BatchRequest request;
+      if (!Decode(&reader, &request)) return false;
+      if (executor_) {
+        auto service = service_;
+        auto keep = sender_;
+        bool queued = executor_->Submit([service, keep, call_id, request = std::move(request)]() {
+          SendResult(keep.get(), MessageType::kBatchResponse, call_id,
+                     service->BatchProcess(request));
+        });
+        if (queued) return true;
+        SendStatus(sender, MessageType::kError, call_id, ErrorCode::UNAVAILABLE,
+                   "Server shutting down");
+        return true;
+      }
+      SendResult(sender, MessageType::kBatchResponse, call_id, service_->BatchProcess(request));
+      return true;
+    }
+
+    case MessageType::kEchoChain: {
+      EchoChainRequest chain;
+      if (!Decode(&reader, &chain)) return false;
+      if (executor_) {
+        auto service = service_;
+        auto keep = sender_;
+        bool queued = executor_->Submit([service, keep, call_id, chain = std::move(chain)]() {
+          SendResult(keep.get(), MessageType::kEchoResponse, call_id,
+                     service->EchoChain(chain.request, chain.length));
+        });
+        if (queued) return true;
+        SendStatus(sender, MessageType::kError, call_id, ErrorCode::UNAVAILABLE,
+                   "Server shutting down");
+        return true;
+      }
+      SendResult(sender, MessageType::kEchoResponse, call_id,
+                 service_->EchoChain(chain.request, chain.length));
+      return true;
+    }
+
+    case MessageType::kShapeEcho: {
+      flat::Kind kind;
+      if (!flat::PeekKind(body, header.body_length, &kind)) return false;
+      switch (kind) {
+        case flat::Kind::kNestedMessage: return EchoShape<NestedMessage>(call_id, &reader);
+        case flat::Kind::kArrayMessage: return EchoShape<ArrayMessage>(call_id, &reader);
+        case flat::Kind::kMapMessage: return EchoShape<MapMessage>(call_id, &reader);
+        case flat::Kind::kSparseMessage: return EchoShape<SparseMessage>(call_id, &reader);
+        case flat::Kind::kStringMessage: return EchoShape<StringMessage>(call_id, &reader);
+        default: return false;
+      }
+    }
+
+    case MessageType::kStreamRequest: {
+      StreamRequest request;
+      if (!Decode(&reader, &request)) return false;
+      auto keep = sender_;
+      service_->StreamData(
+          request,
+          [keep, call_id](const DataChunk& chunk) {
+            SendMessage(keep.get(), MessageType::kStreamChunk, call_id, chunk);
+          },
+          [keep, call_id](ErrorCode code, const std::string& message) {
+            SendStatus(keep.get(), MessageType::kStreamEnd, call_id, code, message);
+          });
+      return true;
+    }
+
+    case MessageType::kUploadBegin: {
+      auto keep = sender_;
+      service_->UploadData(
+          sinks_[call_id],
+          [keep, call_id](const Result<UploadResponse>& result) {
+            if (result.ok()) {
+              SendMessage(keep.get(), MessageType::kUploadResponse, call_id, result.value);
+            } else {
+              SendStatus(keep.get(), MessageType::kError, call_id,
+                         result.error_code, result.error_message);
+            }
+          });
+      return CheckSink(call_id);
+    }
+
+    case MessageType::kBidiBegin: {
+      auto keep = sender_;
+      service_->BidirectionalStream(
+          sinks_[call_id],
+          [keep, call_id](const DataChunk& chunk) {
+            SendMessage(keep.get(), MessageType::kStreamChunk, call_id, chunk);
+          },
+          [keep, call_id](ErrorCode code, const std::string& message) {
+            SendStatus(keep.get(), MessageType::kStreamEnd, call_id, code, message);
+          });
+      return CheckSink(call_id);
+    }
+
+    case MessageType::kUploadChunk:
+    case MessageType::kBidiChunk: {
+      DataChunk chunk;
+      if (!Decode(&reader, &chunk)) return false;
+      auto it = sinks_.find(call_id);
+      if (it == sinks_.end()) return true;  // Stream already failed
+      it->second(chunk);
+      if (chunk.data.empty()) sinks_.erase(call_id);
+      return true;
+    }
+
+    default:
+      // Response types are never valid from a client
+      return false;
+  }
+}
+
+template<typename Message>
+bool ServiceDispatcher::EchoShape(uint32_t call_id, WireReader* reader) {
+  Message request;
+  if (!Decode(reader, &request)) return false;
+  if (executor_) {
+    auto service = service_;
+    auto keep = sender_;
+    bool queued = executor_->Submit([service, keep, call_id, request = std::move(request)]() {
+      SendResult(keep.get(), MessageType::kShapeEcho, call_id, service->EchoShape(request));
+    });
+    if (queued) return true;
+    SendStatus(sender_.get(), MessageType::kError, call_id, ErrorCode::UNAVAILABLE,
+               "Server shutting down");
+    return true;
+  }
+  SendResult(sender_.get(), MessageType::kShapeEcho, call_id, service_->EchoShape(request));
+  return true;
+}
+
+// A service that installs no sink cannot take the client's chunks
+bool ServiceDispatcher::CheckSink(uint32_t call_id) {
+  auto it = sinks_.find(call_id);
+  if (it != sinks_.end() && it->second) return true;
+
+  sinks_.erase(call_id);
+  SendStatus(sender_.get(), MessageType::kError, call_id,
+             ErrorCode::INTERNAL, "Service does not accept client streams");
+  return true;
+}
+
+} // namespace wire
+} // namespace common
+} // namespace benchmark
@@ -4,10 +4,49 @@
 namespace benchmark {
 namespace inprocess {
 
-// Static registry for in-process "servers"
-std::mutex InProcessServer::registry_mutex_;
-std::map<std::string, std::shared_ptr<common::IBenchmarkService>>
-    InProcessServer::registry_;
+namespace {
+
+// Shared fallback for clients connecting to an address with no server.
+// The reference service is stateless, so one instance serves every client
+// and connects do not pay for building a new one.
+std::shared_ptr<common::IBenchmarkService> DefaultService() {
+  static const auto service = std::make_shared<reference::ReferenceServiceImpl>();
+  return service;
+}
+
+} // namespace
+
+// ServiceRegistry implementation
+ServiceRegistry& ServiceRegistry::Instance() {
+  static ServiceRegistry registry;
+  return registry;
+}
+
+ServiceRegistry::Shard& ServiceRegistry::ShardFor(const std::string& address) const {
+  return shards_[std::hash<std::string>{}(address) % kShardCount];
+}
+
+bool ServiceRegistry::Register(
+    const std::string& address,
+    std::shared_ptr<common::IBenchmarkService> service) {
+  auto& shard = ShardFor(address);
+  std::unique_lock<std::shared_mutex> lock(shard.mutex);
+  return shard.services.emplace(address, std::move(service)).second;
+}
+
+void ServiceRegistry::Unregister(const std::string& address) {
+  auto& shard = ShardFor(address);
+  std::unique_lock<std::shared_mutex> lock(shard.mutex);
+  shard.services.erase(address);
+}
+
+std::shared_ptr<common::IBenchmarkService> ServiceRegistry::Lookup(
+    const std::string& address) const {
+  auto& shard = ShardFor(address);
+  std::shared_lock<std::shared_mutex> lock(shard.mutex);
+  auto it = shard.services.find(address);
+  return it != shard.services.end() ? it->second : nullptr;
+}
 
 // InProcessClient implementation
 InProcessClient::InProcessClient() : connected_(false) {}
@@ -17,18 +56,13 @@ common::IBenchmarkService* InProcessClient::GetService() {
 }
 
 bool InProcessClient::Connect(const std::string& address) {
-  std::lock_guard<std::mutex> lock(InProcessServer::registry_mutex_);
-
-  auto it = InProcessServer::registry_.find(address);
-  if (it != InProcessServer::registry_.end()) {
-    service_ = it->second;
-    connected_ = true;
-    return true;
-  }
+  service_ = ServiceRegistry::Instance().Lookup(address);
 
-  // If no server is registered, create a default reference service
+  // If no server is registered, use the default reference service
   // This allows benchmarks to run without explicitly starting a server
-  service_ = std::make_shared<reference::ReferenceServiceImpl>();
+  if (!service_) {
+    service_ = DefaultService();
+  }
   connected_ = true;
   return true;
 }
@@ -47,26 +81,25 @@ InProcessServer::InProcessServer(
     std::shared_ptr<common::IBenchmarkService> service)
   : service_(service), running_(false) {}
 
-bool InProcessServer::Start(const std::string& address) {
-  std::lock_guard<std::mutex> lock(registry_mutex_);
+InProcessServer::~InProcessServer() {
+  Stop();
+}
 
-  if (registry_.find(address) != registry_.end()) {
+bool InProcessServer::Start(const std::string& address) {
+  if (!ServiceRegistry::Instance().Register(address, service_)) {
     std::cerr << "InProcessServer: Address " << address
               << " already in use" << std::endl;
     return false;
   }
 
-  registry_[address] = service_;
   address_ = address;
   running_ = true;
   return true;
 }
 
 void InProcessServer::Stop() {
-  std::lock_guard<std::mutex> lock(registry_mutex_);
-
   if (running_ && !address_.empty()) {
-    registry_.erase(address_);
+    ServiceRegistry::Instance().Unregister(address_);
     running_ = false;
   }
 }
@@ -85,6 +118,10 @@ std::string InProcessFactory::GetName() const {
   return "InProcess (Reference)";
 }
 
+bool InProcessFactory::IsInProcess() const {
+  return true;
+}
+
 std::unique_ptr<common::IBenchmarkClient> InProcessFactory::CreateClient() {
   return std::make_unique<InProcessClient>();
 }
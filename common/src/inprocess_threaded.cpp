@@ -0,0 +1,534 @@
+#include "inprocess_framework.h"
+#include "handoff_queue.h"
+#include "resource_usage.h"
+#include "work_stealing_executor.h"
+#include <algorithm>
+#include <iostream>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace benchmark {
+namespace inprocess {
+
+namespace {
+
+// One call on its way to a worker. Two words, so the rings copy it
+// cheaply; `arg` points at the caller's stack for synchronous calls and
+// at a heap closure for asynchronous ones.
+struct Task {
+  void (*run)(void*) = nullptr;
+  void* arg = nullptr;
+};
+
+// Ring slots per queue; a full ring makes producers wait for room
+constexpr size_t kRingCapacity = 4096;
+
+// Client threads that can hold an SPSC ring of one server at once
+constexpr size_t kMaxLanes = 1024;
+
+// Where a synchronous caller waits for its worker. The worker's last
+// access is the exchange in Signal(); the futex wake after it does not
+// read the state, so the caller may return and free it straight away.
+class Completion {
+public:
+  void Signal() {
+    if (state_.exchange(kDone, std::memory_order_acq_rel) == kSleeping) {
+      common::FutexWake(&state_, 1);
+    }
+  }
+
+  void Wait(common::WaitStrategy strategy, common::SpinBudget* budget) {
+    common::SpinWaiter waiter(strategy, budget);
+    while (state_.load(std::memory_order_acquire) != kDone) {
+      if (!waiter.Pause()) continue;
+      uint32_t expected = kPending;
+      if (!state_.compare_exchange_strong(expected, kSleeping, std::memory_order_acq_rel) &&
+          expected == kDone) {
+        return;
+      }
+      common::FutexWait(&state_, kSleeping);
+    }
+  }
+
+private:
+  enum : uint32_t { kPending, kSleeping, kDone };
+
+  std::atomic<uint32_t> state_{kPending};
+};
+
+class TaskQueue {
+public:
+  virtual ~TaskQueue() = default;
+
+  // From any client thread; false once closed
+  virtual bool Push(const Task& task) = 0;
+
+  // From worker `worker`: wait for a task. Returns false once closed and
+  // drained.
+  virtual bool Pop(int worker, Task* task) = 0;
+
+  virtual void Close() = 0;
+};
+
+class MutexTaskQueue : public TaskQueue {
+public:
+  bool Push(const Task& task) override { return queue_.Push(task); }
+  bool Pop(int, Task* task) override { return queue_.Pop(task); }
+  void Close() override { queue_.Close(); }
+
+private:
+  common::MutexQueue<Task> queue_;
+};
+
+class MpmcTaskQueue : public TaskQueue {
+public:
+  explicit MpmcTaskQueue(common::WaitStrategy wait) : ring_(kRingCapacity), bell_(wait) {}
+
+  bool Push(const Task& task) override {
+    if (closed_.load(std::memory_order_acquire)) return false;
+    while (!ring_.TryPush(task)) {
+      if (closed_.load(std::memory_order_acquire)) return false;
+      std::this_thread::yield();
+    }
+    bell_.Ring();
+    return true;
+  }
+
+  bool Pop(int, Task* task) override {
+    while (true) {
+      if (ring_.TryPop(task)) return true;
+      if (closed_.load(std::memory_order_acquire) && ring_.Empty()) return false;
+      bell_.Wait([this]() {
+        return !ring_.Empty() || closed_.load(std::memory_order_acquire);
+      });
+    }
+  }
+
+  void Close() override {
+    closed_.store(true, std::memory_order_release);
+    bell_.RingAll();
+  }
+
+private:
+  common::MpmcRing<Task> ring_;
+  common::Doorbell bell_;
+  std::atomic<bool> closed_{false};
+};
+
+// Each client thread claims its own ring, served by one worker, so no two
+// threads ever push into or pop from the same ring. A thread gives its
+// ring back when it exits and a later thread may claim it.
+class SpscTaskQueue : public TaskQueue {
+public:
+  SpscTaskQueue(int num_workers, common::WaitStrategy wait)
+    : num_workers_(num_workers), id_(next_id_.fetch_add(1)), cursors_(num_workers) {
+    for (int i = 0; i < num_workers; i++) {
+      bells_.push_back(std::make_unique<common::Doorbell>(wait));
+    }
+  }
+
+  bool Push(const Task& task) override {
+    if (closed_.load(std::memory_order_acquire)) return false;
+    Lane* lane = LaneForThisThread();
+    if (!lane) return false;
+    while (!lane->ring.TryPush(task)) {
+      if (closed_.load(std::memory_order_acquire)) return false;
+      std::this_thread::yield();
+    }
+    bells_[lane->worker]->Ring();
+    return true;
+  }
+
+  bool Pop(int worker, Task* task) override {
+    while (true) {
+      if (PopAny(worker, task)) return true;
+      if (closed_.load(std::memory_order_acquire) && !HasWork(worker)) return false;
+      bells_[worker]->Wait([this, worker]() {
+        return HasWork(worker) || closed_.load(std::memory_order_acquire);
+      });
+    }
+  }
+
+  void Close() override {
+    closed_.store(true, std::memory_order_release);
+    for (auto& bell : bells_) {
+      bell->RingAll();
+    }
+  }
+
+private:
+  struct Lane {
+    explicit Lane(int worker) : ring(kRingCapacity), worker(worker) {}
+    common::SpscRing<Task> ring;
+    int worker;
+    std::atomic<bool> claimed{true};
+  };
+
+  // Rings a thread holds, released when it exits. Entries keep their lane
+  // alive, so a queue destroyed first leaves nothing dangling.
+  struct ThreadLanes {
+    std::vector<std::pair<uint64_t, std::shared_ptr<Lane>>> lanes;
+    ~ThreadLanes() {
+      for (auto& entry : lanes) {
+        entry.second->claimed.store(false, std::memory_order_release);
+      }
+    }
+  };
+
+  Lane* LaneForThisThread() {
+    thread_local ThreadLanes held;
+    for (auto& entry : held.lanes) {
+      if (entry.first == id_) return entry.second.get();
+    }
+
+    std::lock_guard<std::mutex> lock(lanes_mutex_);
+    std::shared_ptr<Lane> lane;
+    for (auto& candidate : owned_) {
+      bool expected = false;
+      if (candidate->claimed.compare_exchange_strong(expected, true,
+                                                     std::memory_order_acq_rel)) {
+        lane = candidate;
+        break;
+      }
+    }
+    if (!lane) {
+      size_t index = owned_.size();
+      if (index >= kMaxLanes) {
+        std::cerr << "ThreadedServer: more than " << kMaxLanes
+                  << " client threads for the spsc queue" << std::endl;
+        return nullptr;
+      }
+      lane = std::make_shared<Lane>(static_cast<int>(index % num_workers_));
+      owned_.push_back(lane);
+      lanes_[index].store(lane.get(), std::memory_order_release);
+      lane_count_.store(index + 1, std::memory_order_release);
+    }
+    held.lanes.emplace_back(id_, lane);
+    return lane.get();
+  }
+
+  // Resume after the lane served last so a busy lane cannot starve the
+  // others
+  bool PopAny(int worker, Task* task) {
+    size_t count = lane_count_.load(std::memory_order_acquire);
+    size_t lanes = (count + num_workers_ - 1 - worker) / num_workers_;
+    size_t& cursor = cursors_[worker];
+    for (size_t k = 0; k < lanes; k++) {
+      size_t lane = (cursor + k) % lanes;
+      if (lanes_[worker + lane * num_workers_].load(std::memory_order_acquire)
+              ->ring.TryPop(task)) {
+        cursor = lane + 1;
+        return true;
+      }
+    }
+    return false;
+  }
+
+  bool HasWork(int worker) const {
+    size_t count = lane_count_.load(std::memory_order_acquire);
+    for (size_t i = static_cast<size_t>(worker); i < count; i += num_workers_) {
+      if (!lanes_[i].load(std::memory_order_acquire)->ring.Empty()) return true;
+    }
+    return false;
+  }
+
+  static std::atomic<uint64_t> next_id_;
+
+  const int num_workers_;
+  const uint64_t id_;
+  std::vector<std::unique_ptr<common::Doorbell>> bells_;
+  std::vector<size_t> cursors_;  // Per worker, only touched by that worker
+  std::atomic<bool> closed_{false};
+
+  std::mutex lanes_mutex_;
+  std::vector<std::shared_ptr<Lane>> owned_;
+  std::atomic<Lane*> lanes_[kMaxLanes] = {};
+  std::atomic<size_t> lane_count_{0};
+};
+
+std::atomic<uint64_t> SpscTaskQueue::next_id_{1};
+
+std::unique_ptr<TaskQueue> MakeTaskQueue(HandoffQueueKind kind, int num_workers,
+                                         common::WaitStrategy wait) {
+  switch (kind) {
+    case HandoffQueueKind::kMutex: return std::make_unique<MutexTaskQueue>();
+    case HandoffQueueKind::kMpmc: return std::make_unique<MpmcTaskQueue>(wait);
+    case HandoffQueueKind::kSpsc: return std::make_unique<SpscTaskQueue>(num_workers, wait);
+    case HandoffQueueKind::kSteal: return nullptr;
+  }
+  return nullptr;
+}
+
+const char* QueueName(HandoffQueueKind kind) {
+  switch (kind) {
+    case HandoffQueueKind::kMutex: return "mutex";
+    case HandoffQueueKind::kMpmc: return "mpmc";
+    case HandoffQueueKind::kSpsc: return "spsc";
+    case HandoffQueueKind::kSteal: return "steal";
+  }
+  return "unknown";
+}
+
+const common::ErrorCode kStopped = common::ErrorCode::UNAVAILABLE;
+const char* const kStoppedMessage = "server stopped";
+
+} // namespace
+
+// Proxy registered in place of the service: every call becomes a task for
+// the worker threads. Streams hand over their setup; the chunk callbacks
+// the service installs are then called directly.
+class HandoffService : public common::IBenchmarkService {
+public:
+  HandoffService(std::shared_ptr<common::IBenchmarkService> service, HandoffQueueKind kind,
+                 common::WaitStrategy wait, int num_workers)
+    : service_(std::move(service)), wait_(wait),
+      queue_(MakeTaskQueue(kind, num_workers, wait)) {
+    if (!queue_) {
+      executor_ = &common::WorkStealingExecutor::Shared();
+      return;
+    }
+    for (int i = 0; i < num_workers; i++) {
+      workers_.emplace_back([this, i]() {
+        Task task;
+        while (queue_->Pop(i, &task)) {
+          task.run(task.arg);
+        }
+      });
+    }
+  }
+
+  ~HandoffService() override { Shutdown(); }
+
+  // Finish queued calls and stop the workers; later calls fail. Calls
+  // already handed to the shared executor still run there, which is why
+  // posted calls hold the service rather than this proxy.
+  void Shutdown() {
+    stopped_.store(true, std::memory_order_release);
+    if (!queue_) return;
+    queue_->Close();
+    for (auto& worker : workers_) {
+      if (worker.joinable()) worker.join();
+    }
+  }
+
+  common::Result<common::EchoResponse> Echo(const common::EchoRequest& request) override {
+    common::Result<common::EchoResponse> result(kStopped, kStoppedMessage);
+    Call([&]() { result = service_->Echo(request); });
+    return result;
+  }
+
+  void EchoAsync(const common::EchoRequest& request,
+                 common::ResponseCallback<common::EchoResponse> callback) override {
+    if (!Post([service = service_, request, callback]() {
+          service->EchoAsync(request, callback);
+        })) {
+      callback(common::Result<common::EchoResponse>(kStopped, kStoppedMessage));
+    }
+  }
+
+  void StreamData(const common::StreamRequest& request,
+                  common::StreamCallback<common::DataChunk> on_chunk,
+                  common::CompletionCallback on_complete) override {
+    if (!Post([service = service_, request, on_chunk, on_complete]() {
+          service->StreamData(request, on_chunk, on_complete);
+        })) {
+      on_complete(kStopped, kStoppedMessage);
+    }
+  }
+
+  void UploadData(common::StreamCallback<common::DataChunk>& chunk_provider,
+                  common::ResponseCallback<common::UploadResponse> on_complete) override {
+    if (!Call([&]() { service_->UploadData(chunk_provider, on_complete); })) {
+      on_complete(common::Result<common::UploadResponse>(kStopped, kStoppedMessage));
+    }
+  }
+
+  void BidirectionalStream(common::StreamCallback<common::DataChunk>& chunk_provider,
+                           common::StreamCallback<common::DataChunk> on_chunk,
+                           common::CompletionCallback on_complete) override {
+    if (!Call([&]() { service_->BidirectionalStream(chunk_provider, on_chunk, on_complete); })) {
+      on_complete(kStopped, kStoppedMessage);
+    }
+  }
+
+  common::Result<common::BatchResponse> BatchProcess(
+      const common::BatchRequest& request) override {
+    common::Result<common::BatchResponse> result(kStopped, kStoppedMessage);
+    Call([&]() { result = service_->BatchProcess(request); });
+    return result;
+  }
+
+  void BatchProcessAsync(const common::BatchRequest& request,
+                         common::ResponseCallback<common::BatchResponse> callback) override {
+    if (!Post([service = service_, request, callback]() {
+          service->BatchProcessAsync(request, callback);
+        })) {
+      callback(common::Result<common::BatchResponse>(kStopped, kStoppedMessage));
+    }
+  }
+
+  // One handoff for the whole chain, like a single remote call
+  common::Result<common::EchoResponse> EchoChain(const common::EchoRequest& request,
+                                                 uint32_t length) override {
+    common::Result<common::EchoResponse> result(kStopped, kStoppedMessage);
+    Call([&]() { result = service_->EchoChain(request, length); });
+    return result;
+  }
+
+  common::Result<common::NestedMessage> EchoShape(const common::NestedMessage& request) override {
+    common::Result<common::NestedMessage> result(kStopped, kStoppedMessage);
+    Call([&]() { result = service_->EchoShape(request); });
+    return result;
+  }
+
+  common::Result<common::ArrayMessage> EchoShape(const common::ArrayMessage& request) override {
+    common::Result<common::ArrayMessage> result(kStopped, kStoppedMessage);
+    Call([&]() { result = service_->EchoShape(request); });
+    return result;
+  }
+
+  common::Result<common::MapMessage> EchoShape(const common::MapMessage& request) override {
+    common::Result<common::MapMessage> result(kStopped, kStoppedMessage);
+    Call([&]() { result = service_->EchoShape(request); });
+    return result;
+  }
+
+  common::Result<common::SparseMessage> EchoShape(const common::SparseMessage& request) override {
+    common::Result<common::SparseMessage> result(kStopped, kStoppedMessage);
+    Call([&]() { result = service_->EchoShape(request); });
+    return result;
+  }
+
+  common::Result<common::StringMessage> EchoShape(const common::StringMessage& request) override {
+    common::Result<common::StringMessage> result(kStopped, kStoppedMessage);
+    Call([&]() { result = service_->EchoShape(request); });
+    return result;
+  }
+
+private:
+  bool Enqueue(const Task& task) {
+    if (!executor_) return queue_->Push(task);
+    if (stopped_.load(std::memory_order_acquire)) return false;
+    return executor_->Submit([task]() { task.run(task.arg); });
+  }
+
+  // Run `body` on a worker and wait for it; nothing is allocated unless
+  // the executor takes the task
+  template <typename Body>
+  bool Call(Body&& body) {
+    struct Pending {
+      std::remove_reference_t<Body>* body = nullptr;
+      Completion done;
+    } pending;
+    pending.body = &body;
+    Task task;
+    task.run = [](void* arg) {
+      auto* call = static_cast<Pending*>(arg);
+      (*call->body)();
+      call->done.Signal();
+    };
+    task.arg = &pending;
+    if (!Enqueue(task)) return false;
+    pending.done.Wait(wait_, &reply_budget_);
+    return true;
+  }
+
+  // Run `body` on a worker without waiting. It may outlive this proxy on
+  // the shared executor, so it must not capture `this`.
+  template <typename Body>
+  bool Post(Body&& body) {
+    using Closure = typename std::decay<Body>::type;
+    auto* closure = new Closure(std::forward<Body>(body));
+    Task task;
+    task.run = [](void* arg) {
+      auto* call = static_cast<Closure*>(arg);
+      (*call)();
+      delete call;
+    };
+    task.arg = closure;
+    if (!Enqueue(task)) {
+      delete closure;
+      return false;
+    }
+    return true;
+  }
+
+  std::shared_ptr<common::IBenchmarkService> service_;
+  const common::WaitStrategy wait_;
+  common::SpinBudget reply_budget_;  // Shared by all synchronous callers
+  std::unique_ptr<TaskQueue> queue_;  // Null with the executor
+  common::WorkStealingExecutor* executor_ = nullptr;
+  std::atomic<bool> stopped_{false};
+  std::vector<std::thread> workers_;
+};
+
+// ThreadedServer implementation
+ThreadedServer::ThreadedServer(std::shared_ptr<common::IBenchmarkService> service,
+                               HandoffQueueKind queue, common::WaitStrategy wait,
+                               int num_workers)
+  : service_(std::move(service)), queue_(queue), wait_(wait), num_workers_(num_workers) {
+  if (num_workers_ <= 0) {
+    num_workers_ = std::max(1, static_cast<int>(common::utils::UsableCpus().size()));
+  }
+}
+
+ThreadedServer::~ThreadedServer() {
+  Stop();
+}
+
+bool ThreadedServer::Start(const std::string& address) {
+  auto handoff = std::make_shared<HandoffService>(service_, queue_, wait_, num_workers_);
+  if (!ServiceRegistry::Instance().Register(address, handoff)) {
+    std::cerr << "ThreadedServer: Address " << address
+              << " already in use" << std::endl;
+    return false;
+  }
+  address_ = address;
+  handoff_ = std::move(handoff);
+  return true;
+}
+
+void ThreadedServer::Stop() {
+  if (!handoff_) return;
+  ServiceRegistry::Instance().Unregister(address_);
+  handoff_->Shutdown();
+  handoff_.reset();
+}
+
+bool ThreadedServer::IsRunning() const {
+  return handoff_ != nullptr;
+}
+
+void ThreadedServer::Wait() {
+  // Like InProcessServer, nothing to wait for
+}
+
+// ThreadedFactory implementation
+std::string ThreadedFactory::GetName() const {
+  if (queue_ == HandoffQueueKind::kSteal) return "InProcess (threaded, steal)";
+  return std::string("InProcess (threaded, ") + QueueName(queue_) + ", " +
+         common::WaitStrategyName(wait_) + ")";
+}
+
+bool ThreadedFactory::IsInProcess() const {
+  return true;
+}
+
+std::unique_ptr<common::IBenchmarkClient> ThreadedFactory::CreateClient() {
+  return std::make_unique<InProcessClient>();
+}
+
+std::unique_ptr<common::IBenchmarkServer> ThreadedFactory::CreateServer(
+    std::shared_ptr<common::IBenchmarkService> service) {
+  return std::make_unique<ThreadedServer>(std::move(service), queue_, wait_, num_workers_);
+}
+
+std::unique_ptr<common::IFrameworkFactory> CreateThreadedFactory(HandoffQueueKind queue,
+                                                          common::WaitStrategy wait) {
+  return std::make_unique<ThreadedFactory>(queue, wait);
+}
+
+} // namespace inprocess
+} // namespace benchmark
@@ -0,0 +1,307 @@
+#include "message_shapes.h"
+#include <algorithm>
+#include <iterator>
+#include <sstream>
+
+namespace benchmark {
+namespace common {
+namespace shapes {
+
+namespace {
+
+// SplitMix64: fast, and the same sequence for the same seed everywhere
+class Random {
+public:
+  explicit Random(uint64_t seed) : state_(seed) {}
+
+  uint64_t Next() {
+    uint64_t z = (state_ += 0x9e3779b97f4a7c15ull);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+    return z ^ (z >> 31);
+  }
+
+  size_t Below(size_t bound) { return static_cast<size_t>(Next() % bound); }
+
+  // Uniform in [0, 1)
+  double Unit() { return static_cast<double>(Next() >> 11) * 0x1.0p-53; }
+
+  template<size_t N>
+  const char* Pick(const char* const (&words)[N]) { return words[Below(N)]; }
+
+private:
+  uint64_t state_;
+};
+
+const char* const kFirstNames[] = {
+  "ada", "alan", "barbara", "claude", "donald", "edsger", "frances", "grace",
+  "john", "ken", "leslie", "margaret", "niklaus", "radia", "tony", "yukihiro"
+};
+
+const char* const kLastNames[] = {
+  "allen", "backus", "dijkstra", "hamilton", "hoare", "hopper", "kernighan",
+  "knuth", "lamport", "liskov", "lovelace", "matsumoto", "perlman", "ritchie",
+  "shannon", "turing", "wirth"
+};
+
+const char* const kCities[] = {
+  "amsterdam", "berlin", "boston", "cairo", "dublin", "helsinki", "lagos",
+  "lima", "madrid", "montreal", "nairobi", "osaka", "oslo", "seoul", "sydney",
+  "zurich"
+};
+
+const char* const kWords[] = {
+  "account", "active", "archive", "billing", "cache", "cluster", "customer",
+  "daily", "default", "disk", "error", "event", "export", "latency", "legacy",
+  "limit", "metric", "network", "order", "pending", "primary", "queue",
+  "region", "replica", "request", "retry", "service", "session", "shard",
+  "status", "storage", "timeout", "trace", "update", "user", "warning"
+};
+
+std::string Words(Random* random, size_t count, char separator) {
+  std::string text;
+  for (size_t i = 0; i < count; i++) {
+    if (i > 0) text += separator;
+    text += random->Pick(kWords);
+  }
+  return text;
+}
+
+// Nodes are numbered as in a binary heap, so node i has children 2i+1 and
+// 2i+2 and a tree of n nodes is about log2(n) deep
+TreeNode MakeTree(size_t index, size_t count, Random* random) {
+  TreeNode node;
+  node.id = static_cast<int64_t>(index) * 7919 + 1;
+  node.weight = random->Unit() * 1000.0;
+  node.label = std::string(random->Pick(kWords)) + "-" + std::to_string(index);
+  for (size_t child = 2 * index + 1; child <= 2 * index + 2 && child < count; child++) {
+    node.children.push_back(MakeTree(child, count, random));
+  }
+  return node;
+}
+
+size_t TreeBytes(const TreeNode& node) {
+  size_t bytes = sizeof(node.id) + sizeof(node.weight) + node.label.size();
+  for (const auto& child : node.children) bytes += TreeBytes(child);
+  return bytes;
+}
+
+bool TreeEqual(const TreeNode& a, const TreeNode& b) {
+  if (a.id != b.id || a.weight != b.weight || a.label != b.label ||
+      a.children.size() != b.children.size()) {
+    return false;
+  }
+  for (size_t i = 0; i < a.children.size(); i++) {
+    if (!TreeEqual(a.children[i], b.children[i])) return false;
+  }
+  return true;
+}
+
+size_t RecordBytes(const SparseRecord& record) {
+  size_t bytes = 0;
+  for (const auto& field : record.ints) bytes += field ? sizeof(int64_t) : 0;
+  for (const auto& field : record.doubles) bytes += field ? sizeof(double) : 0;
+  for (const auto& field : record.texts) bytes += field ? field->size() : 0;
+  return bytes;
+}
+
+size_t RecordBytes(const StringRecord& record) {
+  size_t bytes = record.name.size() + record.email.size() + record.city.size() +
+                 record.note.size();
+  for (const auto& tag : record.tags) bytes += tag.size();
+  return bytes;
+}
+
+bool RecordEqual(const SparseRecord& a, const SparseRecord& b) {
+  return a.ints == b.ints && a.doubles == b.doubles && a.texts == b.texts;
+}
+
+bool RecordEqual(const StringRecord& a, const StringRecord& b) {
+  return a.name == b.name && a.email == b.email && a.city == b.city && a.note == b.note &&
+         a.tags == b.tags;
+}
+
+template<typename Message>
+bool RecordsEqual(const Message& a, const Message& b) {
+  if (a.records.size() != b.records.size()) return false;
+  for (size_t i = 0; i < a.records.size(); i++) {
+    if (!RecordEqual(a.records[i], b.records[i])) return false;
+  }
+  return true;
+}
+
+// Approximate field bytes of one node, for sizing the tree up front
+constexpr size_t kNodeBytes = 28;
+
+} // namespace
+
+const char* ShapeName(Shape shape) {
+  switch (shape) {
+    case Shape::kNested: return "nested";
+    case Shape::kArrays: return "arrays";
+    case Shape::kMap: return "map";
+    case Shape::kSparse: return "sparse";
+    case Shape::kStrings: return "strings";
+  }
+  return "unknown";
+}
+
+bool ParseShapeList(const std::string& text, std::vector<Shape>* shapes) {
+  shapes->clear();
+  if (text == "all") {
+    shapes->assign(std::begin(kAllShapes), std::end(kAllShapes));
+    return true;
+  }
+
+  std::stringstream stream(text);
+  std::string name;
+  while (std::getline(stream, name, ',')) {
+    bool found = false;
+    for (Shape shape : kAllShapes) {
+      if (name == ShapeName(shape)) {
+        shapes->push_back(shape);
+        found = true;
+      }
+    }
+    if (!found) return false;
+  }
+  return !shapes->empty();
+}
+
+// Samples
+NestedMessage MakeNested(size_t size, uint64_t seed) {
+  Random random(seed);
+  NestedMessage message;
+  message.root = MakeTree(0, std::max<size_t>(1, size / kNodeBytes), &random);
+  return message;
+}
+
+ArrayMessage MakeArrays(size_t size, uint64_t seed) {
+  Random random(seed);
+  ArrayMessage message;
+  size_t count = std::max<size_t>(
+      1, size / (sizeof(int64_t) + sizeof(double) + sizeof(uint32_t)));
+  message.values.reserve(count);
+  message.samples.reserve(count);
+  message.counts.reserve(count);
+  for (size_t i = 0; i < count; i++) {
+    // Magnitudes spread evenly over 1 to 63 bits, half of them negative
+    int64_t value = static_cast<int64_t>(random.Next() >> (1 + random.Below(63)));
+    message.values.push_back(random.Next() & 1 ? -value : value);
+    message.samples.push_back(random.Unit() * 100.0);
+    message.counts.push_back(static_cast<uint32_t>(random.Below(100)));
+  }
+  return message;
+}
+
+MapMessage MakeMap(size_t size, uint64_t seed) {
+  Random random(seed);
+  MapMessage message;
+  size_t bytes = 0;
+  for (uint32_t i = 0; bytes < size || message.labels.empty(); i++) {
+    std::string key = std::string(random.Pick(kWords)) + "." + random.Pick(kWords) + "." +
+                      std::to_string(i);
+    bytes += key.size() + sizeof(int64_t);
+    message.counters.emplace(std::move(key), static_cast<int64_t>(random.Next() >> 20));
+
+    std::string label = Words(&random, 2, ' ');
+    bytes += sizeof(uint32_t) + label.size();
+    message.labels.emplace(i * 2654435761u, std::move(label));
+  }
+  return message;
+}
+
+SparseMessage MakeSparse(size_t size, uint64_t seed) {
+  Random random(seed);
+  SparseMessage message;
+  size_t bytes = 0;
+  while (bytes < size || message.records.empty()) {
+    SparseRecord record;
+    for (auto& field : record.ints) {
+      if (random.Below(4) == 0) field = static_cast<int64_t>(random.Next() >> 24);
+    }
+    for (auto& field : record.doubles) {
+      if (random.Below(4) == 0) field = random.Unit() * 1e6;
+    }
+    for (auto& field : record.texts) {
+      if (random.Below(4) == 0) field = Words(&random, 1 + random.Below(3), ' ');
+    }
+    bytes += std::max<size_t>(1, RecordBytes(record));
+    message.records.push_back(std::move(record));
+  }
+  return message;
+}
+
+StringMessage MakeStrings(size_t size, uint64_t seed) {
+  Random random(seed);
+  StringMessage message;
+  size_t bytes = 0;
+  while (bytes < size || message.records.empty()) {
+    StringRecord record;
+    std::string first = random.Pick(kFirstNames);
+    std::string last = random.Pick(kLastNames);
+    record.name = first + " " + last;
+    record.email = first + "." + last + std::to_string(random.Below(1000)) + "@example.com";
+    record.city = random.Pick(kCities);
+    record.note = Words(&random, 4 + random.Below(6), ' ');
+    size_t tags = 2 + random.Below(4);
+    for (size_t i = 0; i < tags; i++) record.tags.push_back(random.Pick(kWords));
+    bytes += RecordBytes(record);
+    message.records.push_back(std::move(record));
+  }
+  return message;
+}
+
+// Sizes
+size_t FieldBytes(const NestedMessage& message) {
+  return TreeBytes(message.root);
+}
+
+size_t FieldBytes(const ArrayMessage& message) {
+  return message.values.size() * sizeof(int64_t) + message.samples.size() * sizeof(double) +
+         message.counts.size() * sizeof(uint32_t);
+}
+
+size_t FieldBytes(const MapMessage& message) {
+  size_t bytes = 0;
+  for (const auto& entry : message.counters) bytes += entry.first.size() + sizeof(int64_t);
+  for (const auto& entry : message.labels) bytes += sizeof(uint32_t) + entry.second.size();
+  return bytes;
+}
+
+size_t FieldBytes(const SparseMessage& message) {
+  size_t bytes = 0;
+  for (const auto& record : message.records) bytes += RecordBytes(record);
+  return bytes;
+}
+
+size_t FieldBytes(const StringMessage& message) {
+  size_t bytes = 0;
+  for (const auto& record : message.records) bytes += RecordBytes(record);
+  return bytes;
+}
+
+// Equality
+bool Equal(const NestedMessage& a, const NestedMessage& b) {
+  return TreeEqual(a.root, b.root);
+}
+
+bool Equal(const ArrayMessage& a, const ArrayMessage& b) {
+  return a.values == b.values && a.samples == b.samples && a.counts == b.counts;
+}
+
+bool Equal(const MapMessage& a, const MapMessage& b) {
+  return a.counters == b.counters && a.labels == b.labels;
+}
+
+bool Equal(const SparseMessage& a, const SparseMessage& b) {
+  return RecordsEqual(a, b);
+}
+
+bool Equal(const StringMessage& a, const StringMessage& b) {
+  return RecordsEqual(a, b);
+}
+
+} // namespace shapes
+} // namespace common
+} // namespace benchmark
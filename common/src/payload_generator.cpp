@@ -0,0 +1,337 @@
+#include "payload_generator.h"
+#include "benchmark_utils.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+namespace benchmark {
+namespace common {
+namespace payload {
+
+namespace {
+
+// Small, fast and seedable; the pool only has to look random
+class SplitMix64 {
+public:
+  explicit SplitMix64(uint64_t seed) : state_(seed) {}
+
+  uint64_t Next() {
+    uint64_t z = (state_ += 0x9e3779b97f4a7c15ull);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+    return z ^ (z >> 31);
+  }
+
+  // Uniform in [0, bound)
+  uint32_t Below(uint32_t bound) {
+    return static_cast<uint32_t>((Next() >> 32) * bound >> 32);
+  }
+
+private:
+  uint64_t state_;
+};
+
+// Draws indexes with given weights through a 64K-entry lookup table, one
+// table read per draw
+class WeightedTable {
+public:
+  explicit WeightedTable(const std::vector<double>& weights) : table_(kEntries) {
+    double total = 0;
+    for (double weight : weights) total += weight;
+    double cumulative = 0;
+    size_t begin = 0;
+    for (size_t i = 0; i < weights.size() && begin < kEntries; i++) {
+      cumulative += weights[i];
+      size_t end = i + 1 == weights.size()
+                       ? kEntries
+                       : static_cast<size_t>(std::llround(cumulative / total * kEntries));
+      for (size_t j = begin; j < std::min(end, kEntries); j++) {
+        table_[j] = static_cast<uint16_t>(i);
+      }
+      begin = std::max(begin, end);
+    }
+  }
+
+  uint16_t Draw(uint16_t random) const { return table_[random]; }
+  uint16_t Draw(SplitMix64* rng) const { return table_[rng->Next() >> 48]; }
+
+private:
+  static constexpr size_t kEntries = 1 << 16;
+  std::vector<uint16_t> table_;
+};
+
+std::vector<double> ZipfWeights(size_t count) {
+  std::vector<double> weights(count);
+  for (size_t i = 0; i < count; i++) weights[i] = 1.0 / static_cast<double>(i + 1);
+  return weights;
+}
+
+template<size_t N>
+const char* Pick(const char* const (&words)[N], SplitMix64* rng) {
+  return words[rng->Below(N)];
+}
+
+std::string RandomPool(SplitMix64* rng) {
+  std::string pool(PayloadGenerator::kPoolSize, '\0');
+  for (size_t i = 0; i < pool.size(); i += 8) {
+    uint64_t word = rng->Next();
+    std::memcpy(&pool[i], &word, 8);
+  }
+  return pool;
+}
+
+double EntropyOf(const std::vector<double>& weights) {
+  double total = 0;
+  for (double weight : weights) total += weight;
+  double entropy = 0;
+  for (double weight : weights) {
+    double p = weight / total;
+    if (p > 0) entropy -= p * std::log2(p);
+  }
+  return entropy;
+}
+
+// Bytes drawn i.i.d. from weights r^i over all 256 values, with r found by
+// bisection so the order-0 entropy is `bits`; r = 1 is uniform (8 bits)
+// and r -> 0 a single value. Values are shuffled so the likely ones are
+// not just the small ones.
+std::string EntropyPool(double bits, SplitMix64* rng) {
+  std::vector<double> weights(256);
+  auto fill = [&](double ratio) {
+    double weight = 1.0;
+    for (auto& w : weights) {
+      w = weight;
+      weight *= ratio;
+    }
+  };
+  double low = 0.0;
+  double high = 1.0;
+  for (int i = 0; i < 60; i++) {
+    double mid = (low + high) / 2;
+    fill(mid);
+    (EntropyOf(weights) < bits ? low : high) = mid;
+  }
+  fill(high);
+
+  uint8_t values[256];
+  for (int i = 0; i < 256; i++) values[i] = static_cast<uint8_t>(i);
+  for (int i = 255; i > 0; i--) std::swap(values[i], values[rng->Below(i + 1)]);
+
+  // Four draws per random word
+  WeightedTable table(weights);
+  std::string pool(PayloadGenerator::kPoolSize, '\0');
+  for (size_t i = 0; i < pool.size(); i += 4) {
+    uint64_t word = rng->Next();
+    for (size_t k = 0; k < 4; k++) {
+      uint16_t draw = table.Draw(static_cast<uint16_t>(word >> (16 * k)));
+      pool[i + k] = static_cast<char>(values[draw]);
+    }
+  }
+  return pool;
+}
+
+const char* const kWords[] = {
+    "the", "of", "and", "to", "a", "in", "is", "that", "for", "it", "as", "was", "with",
+    "be", "by", "on", "not", "he", "this", "are", "or", "his", "from", "at", "which", "but",
+    "have", "an", "had", "they", "you", "were", "their", "one", "all", "we", "can", "her",
+    "has", "there", "been", "if", "more", "when", "will", "would", "who", "so", "no",
+    "time", "system", "data", "request", "server", "network", "latency", "message",
+    "service", "between", "through", "first", "number", "because", "process", "each",
+    "result", "within", "during", "client", "should", "about", "other", "after", "value",
+    "performance", "transport", "benchmark", "measurement", "connection", "protocol",
+    "throughput", "memory", "without", "several", "however", "response", "framework",
+    "important", "different", "implementation", "interface", "configuration", "payload",
+};
+
+const char* const kUsers[] = {"alice", "bob", "carol", "dave", "erin", "frank", "grace",
+                              "heidi", "ivan", "judy", "mallory", "oscar", "peggy", "trent"};
+const char* const kEvents[] = {"page_view", "click", "add_to_cart", "checkout", "login",
+                               "logout", "search", "purchase", "share", "error"};
+const char* const kPaths[] = {"/api/v1/items", "/api/v1/cart", "/api/v1/users", "/api/v2/search",
+                              "/api/v1/orders", "/static/app.js", "/health", "/api/v1/auth"};
+const char* const kRegions[] = {"us-east-1", "us-west-2", "eu-west-1", "eu-central-1",
+                                "ap-southeast-1", "ap-northeast-1"};
+const char* const kTags[] = {"mobile", "desktop", "beta", "premium", "trial", "internal",
+                             "canary", "returning"};
+const char* const kLevels[] = {"INFO", "INFO", "INFO", "INFO", "DEBUG", "WARN", "ERROR"};
+const char* const kServices[] = {"checkout-service", "cart-service", "auth-service",
+                                 "search-service", "inventory-service", "gateway"};
+const char* const kMethods[] = {"GET", "GET", "GET", "POST", "PUT", "DELETE"};
+const int kStatuses[] = {200, 200, 200, 200, 200, 201, 204, 304, 400, 404, 500, 503};
+
+// Appends generated units until the pool is full, then cuts it to size
+template<typename Unit>
+std::string BuildPool(Unit unit) {
+  std::string pool;
+  pool.reserve(PayloadGenerator::kPoolSize + 4096);
+  while (pool.size() < PayloadGenerator::kPoolSize) unit(&pool);
+  pool.resize(PayloadGenerator::kPoolSize);
+  return pool;
+}
+
+std::string TextPool(SplitMix64* rng) {
+  constexpr size_t kWordCount = sizeof(kWords) / sizeof(kWords[0]);
+  WeightedTable words(ZipfWeights(kWordCount));
+  return BuildPool([&](std::string* pool) {
+    // One sentence of 6 to 21 words
+    uint32_t length = 6 + rng->Below(16);
+    for (uint32_t i = 0; i < length; i++) {
+      std::string word = kWords[words.Draw(rng)];
+      if (i == 0) word[0] = static_cast<char>(word[0] - 'a' + 'A');
+      pool->append(word);
+      if (i + 1 == length) {
+        pool->append(rng->Below(8) == 0 ? ".\n" : ". ");
+      } else {
+        pool->append(rng->Below(12) == 0 ? ", " : " ");
+      }
+    }
+  });
+}
+
+std::string JsonPool(SplitMix64* rng) {
+  uint64_t id = 100000 + rng->Below(900000);
+  char buffer[512];
+  return BuildPool([&](std::string* pool) {
+    id += 1 + rng->Below(8);
+    int length = std::snprintf(
+        buffer, sizeof(buffer),
+        "{\"id\":%llu,\"user\":\"%s\",\"event\":\"%s\",\"path\":\"%s/%u\",\"region\":\"%s\","
+        "\"status\":%d,\"latency_ms\":%u.%02u,\"tags\":[\"%s\",\"%s\"],\"ok\":%s}\n",
+        static_cast<unsigned long long>(id), Pick(kUsers, rng), Pick(kEvents, rng),
+        Pick(kPaths, rng), rng->Below(10000), Pick(kRegions, rng),
+        kStatuses[rng->Below(sizeof(kStatuses) / sizeof(kStatuses[0]))], rng->Below(500),
+        rng->Below(100), Pick(kTags, rng), Pick(kTags, rng), rng->Below(20) ? "true" : "false");
+    pool->append(buffer, static_cast<size_t>(length));
+  });
+}
+
+std::string RecordsPool(SplitMix64* rng) {
+  uint64_t millis = 1700000000000ull;
+  char buffer[256];
+  return BuildPool([&](std::string* pool) {
+    millis += rng->Below(50);
+    uint64_t seconds = millis / 1000;
+    int length = std::snprintf(
+        buffer, sizeof(buffer),
+        "2023-11-14T%02u:%02u:%02u.%03uZ %-5s %s req=%08x %s %s/%u %d %ums\n",
+        static_cast<unsigned>(seconds / 3600 % 24), static_cast<unsigned>(seconds / 60 % 60),
+        static_cast<unsigned>(seconds % 60), static_cast<unsigned>(millis % 1000),
+        Pick(kLevels, rng), Pick(kServices, rng), static_cast<unsigned>(rng->Next()),
+        Pick(kMethods, rng), Pick(kPaths, rng), rng->Below(1000),
+        kStatuses[rng->Below(sizeof(kStatuses) / sizeof(kStatuses[0]))], rng->Below(250));
+    pool->append(buffer, static_cast<size_t>(length));
+  });
+}
+
+std::unique_ptr<PayloadGenerator>& SharedSlot() {
+  static std::unique_ptr<PayloadGenerator> shared;
+  return shared;
+}
+
+} // namespace
+
+PayloadGenerator::PayloadGenerator(std::string pool, std::string description)
+  : pool_(std::move(pool)), description_(std::move(description)) {
+  bool ascii = std::all_of(pool_.begin(), pool_.end(),
+                           [](char c) { return static_cast<uint8_t>(c) < 0x80; });
+  if (!ascii) {
+    text_pool_ = pool_;
+    for (char& c : text_pool_) c = static_cast<char>(c & 0x7f);
+  }
+}
+
+void PayloadGenerator::Fill(uint8_t* out, size_t size, uint64_t offset) const {
+  FillFrom(pool_, out, size, offset);
+}
+
+void PayloadGenerator::FillFrom(const std::string& pool, uint8_t* out, size_t size,
+                                uint64_t offset) {
+  size_t position = static_cast<size_t>(offset % pool.size());
+  while (size > 0) {
+    size_t step = std::min(size, pool.size() - position);
+    std::memcpy(out, pool.data() + position, step);
+    out += step;
+    size -= step;
+    position = 0;
+  }
+}
+
+std::string PayloadGenerator::MakeText(size_t size, uint64_t variant) const {
+  std::string text(size, '\0');
+  if (size > 0) {
+    FillFrom(text_pool_.empty() ? pool_ : text_pool_, reinterpret_cast<uint8_t*>(&text[0]),
+             size, variant * 0x9e3779b97f4a7c15ull);
+  }
+  return text;
+}
+
+std::vector<uint8_t> PayloadGenerator::MakeBytes(size_t size, uint64_t variant) const {
+  std::vector<uint8_t> bytes(size);
+  if (size > 0) Fill(bytes.data(), size, variant * 0x9e3779b97f4a7c15ull);
+  return bytes;
+}
+
+double PayloadGenerator::Entropy() const {
+  std::vector<double> counts(256);
+  for (char c : pool_) counts[static_cast<uint8_t>(c)]++;
+  return EntropyOf(counts);
+}
+
+const PayloadGenerator* PayloadGenerator::Shared() {
+  return SharedSlot().get();
+}
+
+void PayloadGenerator::SetShared(std::unique_ptr<PayloadGenerator> generator) {
+  SharedSlot() = std::move(generator);
+}
+
+std::unique_ptr<PayloadGenerator> ParsePayloadSpec(
+    const std::string& spec, uint64_t seed, std::string* error) {
+  SplitMix64 rng(seed);
+  std::string description = spec + " (seed " + std::to_string(seed) + ")";
+
+  if (spec == "random") {
+    return std::make_unique<PayloadGenerator>(RandomPool(&rng), description);
+  }
+  if (spec.rfind("entropy:", 0) == 0) {
+    char* end = nullptr;
+    std::string value = spec.substr(8);
+    double bits = std::strtod(value.c_str(), &end);
+    if (value.empty() || *end != '\0' || !(bits >= 0 && bits <= 8)) {
+      *error = "entropy takes bits per byte between 0 and 8: " + spec;
+      return nullptr;
+    }
+    return std::make_unique<PayloadGenerator>(EntropyPool(bits, &rng), description);
+  }
+  if (spec == "text") {
+    return std::make_unique<PayloadGenerator>(TextPool(&rng), description);
+  }
+  if (spec == "json") {
+    return std::make_unique<PayloadGenerator>(JsonPool(&rng), description);
+  }
+  if (spec == "records") {
+    return std::make_unique<PayloadGenerator>(RecordsPool(&rng), description);
+  }
+  *error = "unknown payload spec: " + spec;
+  return nullptr;
+}
+
+std::string SharedText(size_t size, uint64_t variant) {
+  if (const auto* generator = PayloadGenerator::Shared()) {
+    return generator->MakeText(size, variant);
+  }
+  return std::string(size, 'x');
+}
+
+std::vector<uint8_t> SharedBytes(size_t size, uint64_t variant) {
+  if (const auto* generator = PayloadGenerator::Shared()) {
+    return generator->MakeBytes(size, variant);
+  }
+  return utils::GenerateRandomData(size, static_cast<uint32_t>(variant));
+}
+
+} // namespace payload
+} // namespace common
+} // namespace benchmark
@@ -0,0 +1,195 @@
+#include "recording_service.h"
+
+namespace benchmark {
+namespace common {
+namespace trace {
+
+namespace {
+
+uint64_t BatchPayloadSize(const BatchRequest& request) {
+  uint64_t bytes = 0;
+  for (const auto& item : request.items) {
+    bytes += item.data.size();
+  }
+  return bytes;
+}
+
+// Wraps the provider a service installed for a client stream so the
+// stream's record gets its bytes and chunk count once the closing empty
+// chunk passes
+void CountChunks(StreamCallback<DataChunk>& chunk_provider,
+                 std::shared_ptr<TraceWriter> writer, uint64_t record) {
+  if (!chunk_provider || record == TraceWriter::kNoRecord) return;
+
+  struct Counts {
+    uint64_t bytes = 0;
+    uint64_t chunks = 0;
+    bool done = false;
+  };
+  auto counts = std::make_shared<Counts>();
+  chunk_provider = [inner = std::move(chunk_provider), writer = std::move(writer), record,
+                    counts](const DataChunk& chunk) {
+    if (!counts->done) {
+      if (chunk.data.empty()) {
+        counts->done = true;
+        writer->Update(record, counts->bytes, counts->chunks);
+      } else {
+        counts->bytes += chunk.data.size();
+        counts->chunks++;
+      }
+    }
+    inner(chunk);
+  };
+}
+
+} // namespace
+
+// RecordingService implementation
+RecordingService::RecordingService(
+    IBenchmarkService* inner, std::shared_ptr<TraceWriter> writer)
+  : inner_(inner), writer_(std::move(writer)) {}
+
+Result<EchoResponse> RecordingService::Echo(const EchoRequest& request) {
+  writer_->Append(TraceOperation::kEcho, request.message.size(), 1);
+  return inner_->Echo(request);
+}
+
+void RecordingService::EchoAsync(
+    const EchoRequest& request,
+    ResponseCallback<EchoResponse> callback) {
+  writer_->Append(TraceOperation::kEchoAsync, request.message.size(), 1);
+  inner_->EchoAsync(request, std::move(callback));
+}
+
+void RecordingService::StreamData(
+    const StreamRequest& request,
+    StreamCallback<DataChunk> on_chunk,
+    CompletionCallback on_complete) {
+  writer_->Append(TraceOperation::kStreamData,
+                  static_cast<uint64_t>(request.chunk_size) * request.chunk_count,
+                  request.chunk_count);
+  inner_->StreamData(request, std::move(on_chunk), std::move(on_complete));
+}
+
+void RecordingService::UploadData(
+    StreamCallback<DataChunk>& chunk_provider,
+    ResponseCallback<UploadResponse> on_complete) {
+  // Sizes are filled in when the upload ends
+  uint64_t record = writer_->Append(TraceOperation::kUploadData, 0, 0);
+  inner_->UploadData(chunk_provider, std::move(on_complete));
+  CountChunks(chunk_provider, writer_, record);
+}
+
+void RecordingService::BidirectionalStream(
+    StreamCallback<DataChunk>& chunk_provider,
+    StreamCallback<DataChunk> on_chunk,
+    CompletionCallback on_complete) {
+  uint64_t record = writer_->Append(TraceOperation::kBidirectionalStream, 0, 0);
+  inner_->BidirectionalStream(chunk_provider, std::move(on_chunk),
+                              std::move(on_complete));
+  CountChunks(chunk_provider, writer_, record);
+}
+
+Result<BatchResponse> RecordingService::BatchProcess(const BatchRequest& request) {
+  writer_->Append(TraceOperation::kBatchProcess, BatchPayloadSize(request),
+                  request.items.size());
+  return inner_->BatchProcess(request);
+}
+
+void RecordingService::BatchProcessAsync(
+    const BatchRequest& request,
+    ResponseCallback<BatchResponse> callback) {
+  writer_->Append(TraceOperation::kBatchProcessAsync, BatchPayloadSize(request),
+                  request.items.size());
+  inner_->BatchProcessAsync(request, std::move(callback));
+}
+
+// One record for the whole chain, replayed through EchoChain, so its
+// dependent links are not replayed as a burst of independent echoes
+Result<EchoResponse> RecordingService::EchoChain(const EchoRequest& request, uint32_t length) {
+  writer_->Append(TraceOperation::kEchoChain, request.message.size(), length);
+  return inner_->EchoChain(request, length);
+}
+
+// Traces have no shape record either, and no echo stands in for a shape,
+// so message-zoo calls pass through unrecorded
+Result<NestedMessage> RecordingService::EchoShape(const NestedMessage& request) {
+  return inner_->EchoShape(request);
+}
+
+Result<ArrayMessage> RecordingService::EchoShape(const ArrayMessage& request) {
+  return inner_->EchoShape(request);
+}
+
+Result<MapMessage> RecordingService::EchoShape(const MapMessage& request) {
+  return inner_->EchoShape(request);
+}
+
+Result<SparseMessage> RecordingService::EchoShape(const SparseMessage& request) {
+  return inner_->EchoShape(request);
+}
+
+Result<StringMessage> RecordingService::EchoShape(const StringMessage& request) {
+  return inner_->EchoShape(request);
+}
+
+// RecordingClient implementation
+RecordingClient::RecordingClient(
+    std::unique_ptr<IBenchmarkClient> inner,
+    std::shared_ptr<TraceWriter> writer)
+  : inner_(std::move(inner)), writer_(std::move(writer)) {}
+
+IBenchmarkService* RecordingClient::GetService() {
+  auto* inner_service = inner_->GetService();
+  if (!inner_service) {
+    service_.reset();
+    return nullptr;
+  }
+  if (!service_) {
+    service_ = std::make_unique<RecordingService>(inner_service, writer_);
+  }
+  return service_.get();
+}
+
+bool RecordingClient::Connect(const std::string& address) {
+  service_.reset();
+  return inner_->Connect(address);
+}
+
+void RecordingClient::Disconnect() {
+  service_.reset();
+  inner_->Disconnect();
+}
+
+bool RecordingClient::IsConnected() const {
+  return inner_->IsConnected();
+}
+
+// RecordingFactory implementation
+RecordingFactory::RecordingFactory(
+    std::unique_ptr<IFrameworkFactory> inner,
+    std::shared_ptr<TraceWriter> writer)
+  : inner_(std::move(inner)), writer_(std::move(writer)) {}
+
+std::string RecordingFactory::GetName() const {
+  return inner_->GetName();
+}
+
+bool RecordingFactory::IsInProcess() const {
+  return inner_->IsInProcess();
+}
+
+std::unique_ptr<IBenchmarkClient> RecordingFactory::CreateClient() {
+  auto client = inner_->CreateClient();
+  if (!client) return nullptr;
+  return std::make_unique<RecordingClient>(std::move(client), writer_);
+}
+
+std::unique_ptr<IBenchmarkServer> RecordingFactory::CreateServer(
+    std::shared_ptr<IBenchmarkService> service) {
+  return inner_->CreateServer(std::move(service));
+}
+
+} // namespace trace
+} // namespace common
+} // namespace benchmark
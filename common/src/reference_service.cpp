@@ -1,6 +1,9 @@
 #include "reference_service.h"
+#include "payload_generator.h"
+#include "work_stealing_executor.h"
 #include <thread>
 #include <chrono>
+#include <utility>
 
 namespace benchmark {
 namespace reference {
@@ -14,13 +17,21 @@ common::Result<common::EchoResponse> ReferenceServiceImpl::Echo(
   response.server_timestamp = common::utils::GetTimestampNanos();
   response.sequence_number = request.sequence_number;
 
-  return common::Result<common::EchoResponse>(response);
+  return common::Result<common::EchoResponse>(std::move(response));
 }
 
 void ReferenceServiceImpl::EchoAsync(
     const common::EchoRequest& request,
     common::ResponseCallback<common::EchoResponse> callback) {
 
+  if (executor_) {
+    if (auto self = weak_from_this().lock()) {
+      bool queued = executor_->Submit([self, request, callback]() {
+        callback(self->Echo(request));
+      });
+      if (queued) return;
+    }
+  }
   auto result = Echo(request);
   callback(result);
 }
@@ -30,12 +41,15 @@ void ReferenceServiceImpl::StreamData(
     common::StreamCallback<common::DataChunk> on_chunk,
     common::CompletionCallback on_complete) {
 
-  // Generate and stream chunks
+  // Every chunk has the same size and is packed on its own, so one payload
+  // and its checksum serve the whole stream; generating and checksumming
+  // each chunk would cap large streams below the transport's rate
+  common::DataChunk chunk;
+  chunk.data = common::payload::SharedBytes(request.chunk_size, 0);
+  chunk.checksum = crc32_.Calculate(chunk.data);
+
   for (uint32_t i = 0; i < request.chunk_count; i++) {
-    common::DataChunk chunk;
     chunk.sequence_number = i;
-    chunk.data = common::utils::GenerateRandomData(request.chunk_size, i);
-    chunk.checksum = crc32_.Calculate(chunk.data);
     chunk.timestamp = common::utils::GetTimestampNanos();
 
     on_chunk(chunk);
@@ -53,21 +67,30 @@ void ReferenceServiceImpl::UploadData(
     common::StreamCallback<common::DataChunk>& chunk_provider,
     common::ResponseCallback<common::UploadResponse> on_complete) {
 
-  common::UploadResponse response;
-  response.total_bytes = 0;
-  response.chunk_count = 0;
-  response.checksum_valid = true;
-
-  auto start_time = common::utils::GetTimestampNanos();
-
-  // This is a simplified version - in reality, chunk_provider would be called
-  // repeatedly until the stream ends. For now, we'll indicate this is not
-  // fully implemented in this reference version.
-
-  auto end_time = common::utils::GetTimestampNanos();
-  response.duration_ns = end_time - start_time;
+  struct UploadState {
+    common::UploadResponse response;
+    int64_t start_time = common::utils::GetTimestampNanos();
+    bool done = false;
+  };
+  auto state = std::make_shared<UploadState>();
+
+  // Chunks are inspected in place and never copied
+  chunk_provider = [this, state, on_complete](const common::DataChunk& chunk) {
+    if (state->done) return;
+
+    if (chunk.data.empty()) {
+      state->done = true;
+      state->response.duration_ns = common::utils::GetTimestampNanos() - state->start_time;
+      on_complete(common::Result<common::UploadResponse>(std::move(state->response)));
+      return;
+    }
 
-  on_complete(common::Result<common::UploadResponse>(response));
+    state->response.total_bytes += chunk.data.size();
+    state->response.chunk_count++;
+    if (chunk.checksum != 0 && crc32_.Calculate(chunk.data) != chunk.checksum) {
+      state->response.checksum_valid = false;
+    }
+  };
 }
 
 void ReferenceServiceImpl::BidirectionalStream(
@@ -75,11 +98,18 @@ void ReferenceServiceImpl::BidirectionalStream(
     common::StreamCallback<common::DataChunk> on_chunk,
     common::CompletionCallback on_complete) {
 
-  // Simplified bidirectional streaming
-  // In a real implementation, this would process incoming chunks
-  // and send responses simultaneously
+  // Each incoming chunk is echoed straight back; an empty chunk ends the stream
+  auto done = std::make_shared<bool>(false);
+  chunk_provider = [done, on_chunk, on_complete](const common::DataChunk& chunk) {
+    if (*done) return;
 
-  on_complete(common::ErrorCode::OK, "");
+    if (chunk.data.empty()) {
+      *done = true;
+      on_complete(common::ErrorCode::OK, "");
+      return;
+    }
+    on_chunk(chunk);
+  };
 }
 
 common::Result<common::BatchResponse> ReferenceServiceImpl::BatchProcess(
@@ -111,25 +141,54 @@ common::Result<common::BatchResponse> ReferenceServiceImpl::BatchProcess(
       response.total_failed++;
     }
 
-    response.results.push_back(result);
+    bool failed = !result.success;
+    response.results.push_back(std::move(result));
     response.total_processed++;
 
     // Stop on first error if requested
-    if (!result.success && request.fail_on_error) {
+    if (failed && request.fail_on_error) {
       break;
     }
   }
 
-  return common::Result<common::BatchResponse>(response);
+  return common::Result<common::BatchResponse>(std::move(response));
 }
 
 void ReferenceServiceImpl::BatchProcessAsync(
     const common::BatchRequest& request,
     common::ResponseCallback<common::BatchResponse> callback) {
 
+  if (executor_) {
+    if (auto self = weak_from_this().lock()) {
+      bool queued = executor_->Submit([self, request, callback]() {
+        callback(self->BatchProcess(request));
+      });
+      if (queued) return;
+    }
+  }
   auto result = BatchProcess(request);
   callback(result);
 }
 
+common::Result<common::NestedMessage> ReferenceServiceImpl::EchoShape(const common::NestedMessage& request) {
+  return common::Result<common::NestedMessage>(request);
+}
+
+common::Result<common::ArrayMessage> ReferenceServiceImpl::EchoShape(const common::ArrayMessage& request) {
+  return common::Result<common::ArrayMessage>(request);
+}
+
+common::Result<common::MapMessage> ReferenceServiceImpl::EchoShape(const common::MapMessage& request) {
+  return common::Result<common::MapMessage>(request);
+}
+
+common::Result<common::SparseMessage> ReferenceServiceImpl::EchoShape(const common::SparseMessage& request) {
+  return common::Result<common::SparseMessage>(request);
+}
+
+common::Result<common::StringMessage> ReferenceServiceImpl::EchoShape(const common::StringMessage& request) {
+  return common::Result<common::StringMessage>(request);
+}
+
 } // namespace reference
 } // namespace benchmark
@@ -0,0 +1,120 @@
+#include "resource_usage.h"
+#include <fstream>
+#include <sched.h>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <sys/resource.h>
+
+#if defined(__GLIBC__)
+#include <malloc.h>
+#endif
+
+namespace benchmark {
+namespace common {
+namespace utils {
+
+bool ReadMemoryUsage(MemoryUsage* usage) {
+  std::ifstream status("/proc/self/status");
+  if (!status) return false;
+
+  bool found_rss = false;
+  bool found_hwm = false;
+  std::string line;
+  while (std::getline(status, line)) {
+    uint64_t* target = nullptr;
+    if (line.compare(0, 6, "VmRSS:") == 0) {
+      target = &usage->rss_bytes;
+      found_rss = true;
+    } else if (line.compare(0, 6, "VmHWM:") == 0) {
+      target = &usage->peak_rss_bytes;
+      found_hwm = true;
+    } else {
+      continue;
+    }
+
+    // Values are reported as "<n> kB"
+    std::istringstream fields(line.substr(6));
+    uint64_t kb = 0;
+    fields >> kb;
+    *target = kb * 1024;
+  }
+  return found_rss && found_hwm;
+}
+
+bool ResetPeakRss() {
+  std::ofstream clear_refs("/proc/self/clear_refs");
+  if (!clear_refs) return false;
+  clear_refs << "5";
+  clear_refs.flush();
+  return static_cast<bool>(clear_refs);
+}
+
+int64_t ReadProcessCpuNanos() {
+  rusage usage{};
+  if (::getrusage(RUSAGE_SELF, &usage) != 0) return -1;
+  auto nanos = [](const timeval& time) {
+    return static_cast<int64_t>(time.tv_sec) * 1000000000 +
+           static_cast<int64_t>(time.tv_usec) * 1000;
+  };
+  return nanos(usage.ru_utime) + nanos(usage.ru_stime);
+}
+
+bool ParseCpuList(const std::string& text, std::vector<int>* cpus) {
+  cpus->clear();
+  std::istringstream items(text);
+  std::string item;
+  while (std::getline(items, item, ',')) {
+    size_t dash = item.find('-');
+    int first = 0;
+    int last = 0;
+    try {
+      size_t used = 0;
+      first = std::stoi(item, &used);
+      if (dash == std::string::npos) {
+        if (used != item.size()) return false;
+        last = first;
+      } else {
+        if (used != dash) return false;
+        last = std::stoi(item.substr(dash + 1), &used);
+        if (dash + 1 + used != item.size()) return false;
+      }
+    } catch (const std::exception&) {
+      return false;
+    }
+    if (first < 0 || last < first || last >= CPU_SETSIZE) return false;
+    for (int cpu = first; cpu <= last; cpu++) {
+      cpus->push_back(cpu);
+    }
+  }
+  return !cpus->empty();
+}
+
+bool PinToCpus(const std::vector<int>& cpus) {
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  for (int cpu : cpus) {
+    CPU_SET(cpu, &set);
+  }
+  return ::sched_setaffinity(0, sizeof(set), &set) == 0;
+}
+
+std::vector<int> UsableCpus() {
+  std::vector<int> cpus;
+  cpu_set_t set;
+  if (::sched_getaffinity(0, sizeof(set), &set) != 0) return cpus;
+  for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+    if (CPU_ISSET(cpu, &set)) cpus.push_back(cpu);
+  }
+  return cpus;
+}
+
+void TrimHeap() {
+#if defined(__GLIBC__)
+  malloc_trim(0);
+#endif
+}
+
+} // namespace utils
+} // namespace common
+} // namespace benchmark
@@ -0,0 +1,108 @@
+#include "wait_strategy.h"
+#include "resource_usage.h"
+#include <algorithm>
+
+#if defined(__linux__)
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#else
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#endif
+
+namespace benchmark {
+namespace common {
+
+namespace {
+
+// Bounds of the adaptive spin budget, in polls
+constexpr int kMinSpinPolls = 16;
+constexpr int kMaxSpinPolls = 1 << 15;
+
+bool HaveSpareCpu() {
+  static const bool spare = utils::UsableCpus().size() > 1;
+  return spare;
+}
+
+#if !defined(__linux__)
+// Waiters hash onto a fixed set of condition variables by word address
+struct FutexBucket {
+  std::mutex mutex;
+  std::condition_variable cv;
+};
+
+FutexBucket& BucketFor(const void* word) {
+  static FutexBucket buckets[64];
+  return buckets[std::hash<const void*>()(word) % 64];
+}
+#endif
+
+} // namespace
+
+const char* WaitStrategyName(WaitStrategy strategy) {
+  switch (strategy) {
+    case WaitStrategy::kSpin: return "spin";
+    case WaitStrategy::kSpinYield: return "spin-yield";
+    case WaitStrategy::kSpinFutex: return "spin-futex";
+    case WaitStrategy::kBlock: return "block";
+  }
+  return "unknown";
+}
+
+bool ParseWaitStrategy(const std::string& name, WaitStrategy* strategy) {
+  for (WaitStrategy candidate : {WaitStrategy::kSpin, WaitStrategy::kSpinYield,
+                                 WaitStrategy::kSpinFutex, WaitStrategy::kBlock}) {
+    if (name == WaitStrategyName(candidate)) {
+      *strategy = candidate;
+      return true;
+    }
+  }
+  return false;
+}
+
+#if defined(__linux__)
+void FutexWait(std::atomic<uint32_t>* word, uint32_t expected) {
+  ::syscall(SYS_futex, reinterpret_cast<uint32_t*>(word), FUTEX_WAIT_PRIVATE, expected,
+            nullptr, nullptr, 0);
+}
+
+void FutexWake(std::atomic<uint32_t>* word, int count) {
+  ::syscall(SYS_futex, reinterpret_cast<uint32_t*>(word), FUTEX_WAKE_PRIVATE, count,
+            nullptr, nullptr, 0);
+}
+#else
+void FutexWait(std::atomic<uint32_t>* word, uint32_t expected) {
+  FutexBucket& bucket = BucketFor(word);
+  std::unique_lock<std::mutex> lock(bucket.mutex);
+  if (word->load(std::memory_order_seq_cst) != expected) return;
+  bucket.cv.wait(lock);
+}
+
+void FutexWake(std::atomic<uint32_t>* word, int) {
+  // Other words share the bucket, so everyone wakes and re-checks
+  FutexBucket& bucket = BucketFor(word);
+  { std::lock_guard<std::mutex> lock(bucket.mutex); }
+  bucket.cv.notify_all();
+}
+#endif
+
+// SpinBudget implementation
+int SpinBudget::Get() const {
+  return HaveSpareCpu() ? polls_.load(std::memory_order_relaxed) : 0;
+}
+
+void SpinBudget::Record(bool slept, int polls) {
+  // Updates from racing waiters may be lost; it is only a hint
+  int budget = polls_.load(std::memory_order_relaxed);
+  if (slept) {
+    budget -= budget / 8;
+  } else {
+    budget += (2 * polls - budget) / 8;
+  }
+  polls_.store(std::clamp(budget, kMinSpinPolls, kMaxSpinPolls), std::memory_order_relaxed);
+}
+
+} // namespace common
+} // namespace benchmark
@@ -0,0 +1,338 @@
+#include "wire_format.h"
+#include "flat_format.h"
+#include <algorithm>
+#include <cstring>
+
+namespace benchmark {
+namespace common {
+namespace wire {
+
+namespace {
+
+uint32_t LoadU32(const uint8_t* data) {
+  return static_cast<uint32_t>(data[0]) |
+         static_cast<uint32_t>(data[1]) << 8 |
+         static_cast<uint32_t>(data[2]) << 16 |
+         static_cast<uint32_t>(data[3]) << 24;
+}
+
+void StoreU32(char* data, uint32_t value) {
+  for (int i = 0; i < 4; i++) {
+    data[i] = static_cast<char>(value >> (8 * i));
+  }
+}
+
+} // namespace
+
+// WireWriter implementation
+void WireWriter::Write(const void* bytes, size_t size) {
+  if (out_) {
+    out_->append(static_cast<const char*>(bytes), size);
+  } else if (data_ && size_ + size <= capacity_) {
+    std::memcpy(data_ + size_, bytes, size);
+  }
+  size_ += size;
+}
+
+void WireWriter::PutU16(uint16_t value) {
+  PutU8(static_cast<uint8_t>(value));
+  PutU8(static_cast<uint8_t>(value >> 8));
+}
+
+void WireWriter::PutU32(uint32_t value) {
+  char bytes[4];
+  StoreU32(bytes, value);
+  Write(bytes, 4);
+}
+
+void WireWriter::PutU64(uint64_t value) {
+  PutU32(static_cast<uint32_t>(value));
+  PutU32(static_cast<uint32_t>(value >> 32));
+}
+
+void WireWriter::PutBytes(const void* data, size_t size) {
+  PutU32(static_cast<uint32_t>(size));
+  Write(data, size);
+}
+
+// WireReader implementation
+bool WireReader::Take(size_t size, const uint8_t** bytes) {
+  if (size > size_ - offset_) {
+    offset_ = size_;
+    return false;
+  }
+  *bytes = data_ + offset_;
+  offset_ += size;
+  return true;
+}
+
+bool WireReader::GetU8(uint8_t* value) {
+  const uint8_t* bytes = nullptr;
+  if (!Take(1, &bytes)) return false;
+  *value = bytes[0];
+  return true;
+}
+
+bool WireReader::GetU16(uint16_t* value) {
+  const uint8_t* bytes = nullptr;
+  if (!Take(2, &bytes)) return false;
+  *value = static_cast<uint16_t>(bytes[0] | bytes[1] << 8);
+  return true;
+}
+
+bool WireReader::GetU32(uint32_t* value) {
+  const uint8_t* bytes = nullptr;
+  if (!Take(4, &bytes)) return false;
+  *value = LoadU32(bytes);
+  return true;
+}
+
+bool WireReader::GetU64(uint64_t* value) {
+  uint32_t low = 0;
+  uint32_t high = 0;
+  if (!GetU32(&low) || !GetU32(&high)) return false;
+  *value = static_cast<uint64_t>(high) << 32 | low;
+  return true;
+}
+
+bool WireReader::GetI64(int64_t* value) {
+  uint64_t raw = 0;
+  if (!GetU64(&raw)) return false;
+  *value = static_cast<int64_t>(raw);
+  return true;
+}
+
+bool WireReader::GetBool(bool* value) {
+  uint8_t raw = 0;
+  if (!GetU8(&raw)) return false;
+  *value = raw != 0;
+  return true;
+}
+
+bool WireReader::GetString(std::string* value) {
+  uint32_t size = 0;
+  const uint8_t* bytes = nullptr;
+  if (!GetU32(&size) || !Take(size, &bytes)) return false;
+  value->assign(reinterpret_cast<const char*>(bytes), size);
+  return true;
+}
+
+bool WireReader::GetBytes(std::vector<uint8_t>* value) {
+  uint32_t size = 0;
+  const uint8_t* bytes = nullptr;
+  if (!GetU32(&size) || !Take(size, &bytes)) return false;
+  value->assign(bytes, bytes + size);
+  return true;
+}
+
+void WireReader::GetRest(const uint8_t** data, size_t* size) {
+  *data = data_ + offset_;
+  *size = size_ - offset_;
+  offset_ = size_;
+}
+
+// Framing
+size_t BeginFrame(std::string* out, MessageType type, uint32_t call_id) {
+  size_t offset = out->size();
+  WireWriter writer(out);
+  writer.PutU32(0);
+  writer.PutU8(static_cast<uint8_t>(type));
+  writer.PutU8(0);
+  writer.PutU16(0);
+  writer.PutU32(call_id);
+  return offset;
+}
+
+void EndFrame(std::string* out, size_t frame_offset) {
+  uint32_t body_length = static_cast<uint32_t>(
+      out->size() - frame_offset - kFrameHeaderSize);
+  StoreU32(&(*out)[frame_offset], body_length);
+}
+
+void WriteFrameHeader(uint8_t* data, MessageType type, uint32_t call_id,
+                      uint32_t body_length, uint8_t flags) {
+  WireWriter writer(data, kFrameHeaderSize);
+  writer.PutU32(body_length);
+  writer.PutU8(static_cast<uint8_t>(type));
+  writer.PutU8(flags);
+  writer.PutU16(0);
+  writer.PutU32(call_id);
+}
+
+bool ParseFrameHeader(const uint8_t* data, FrameHeader* header) {
+  header->body_length = LoadU32(data);
+  header->type = static_cast<MessageType>(data[4]);
+  header->flags = data[5];
+  header->call_id = LoadU32(data + 8);
+
+  return header->body_length <= kMaxFrameBody &&
+         data[4] >= static_cast<uint8_t>(MessageType::kEchoRequest) &&
+         data[4] <= static_cast<uint8_t>(MessageType::kShapeEcho);
+}
+
+void AppendStatusFrame(std::string* out, MessageType type, uint32_t call_id,
+                       ErrorCode code, const std::string& message) {
+  size_t offset = BeginFrame(out, type, call_id);
+  WireWriter writer(out);
+  EncodeStatus(code, message, &writer);
+  EndFrame(out, offset);
+}
+
+// Message bodies, as flat blocks
+namespace {
+
+template<typename View, typename T>
+bool DecodeBlock(WireReader* reader, T* message) {
+  const uint8_t* data = nullptr;
+  size_t size = 0;
+  reader->GetRest(&data, &size);
+  return flat::Decode<View>(data, size, message);
+}
+
+} // namespace
+
+size_t EncodedSize(const EchoRequest& message) { return flat::EncodedSize(message); }
+size_t EncodedSize(const EchoResponse& message) { return flat::EncodedSize(message); }
+size_t EncodedSize(const StreamRequest& message) { return flat::EncodedSize(message); }
+size_t EncodedSize(const DataChunk& message) { return flat::EncodedSize(message); }
+size_t EncodedSize(const UploadResponse& message) { return flat::EncodedSize(message); }
+size_t EncodedSize(const BatchRequest& message) { return flat::EncodedSize(message); }
+size_t EncodedSize(const BatchResponse& message) { return flat::EncodedSize(message); }
+size_t EncodedSize(const EchoChainRequest& message) { return flat::EncodedSize(message); }
+size_t EncodedSize(const NestedMessage& message) { return flat::EncodedSize(message); }
+size_t EncodedSize(const ArrayMessage& message) { return flat::EncodedSize(message); }
+size_t EncodedSize(const MapMessage& message) { return flat::EncodedSize(message); }
+size_t EncodedSize(const SparseMessage& message) { return flat::EncodedSize(message); }
+size_t EncodedSize(const StringMessage& message) { return flat::EncodedSize(message); }
+
+void Encode(const EchoRequest& message, WireWriter* writer) { flat::Encode(message, writer); }
+void Encode(const EchoResponse& message, WireWriter* writer) { flat::Encode(message, writer); }
+void Encode(const StreamRequest& message, WireWriter* writer) { flat::Encode(message, writer); }
+void Encode(const DataChunk& message, WireWriter* writer) { flat::Encode(message, writer); }
+void Encode(const UploadResponse& message, WireWriter* writer) { flat::Encode(message, writer); }
+void Encode(const BatchRequest& message, WireWriter* writer) { flat::Encode(message, writer); }
+void Encode(const BatchResponse& message, WireWriter* writer) { flat::Encode(message, writer); }
+void Encode(const EchoChainRequest& message, WireWriter* writer) { flat::Encode(message, writer); }
+void Encode(const NestedMessage& message, WireWriter* writer) { flat::Encode(message, writer); }
+void Encode(const ArrayMessage& message, WireWriter* writer) { flat::Encode(message, writer); }
+void Encode(const MapMessage& message, WireWriter* writer) { flat::Encode(message, writer); }
+void Encode(const SparseMessage& message, WireWriter* writer) { flat::Encode(message, writer); }
+void Encode(const StringMessage& message, WireWriter* writer) { flat::Encode(message, writer); }
+
+bool Decode(WireReader* reader, EchoRequest* message) {
+  return DecodeBlock<flat::EchoRequestView>(reader, message);
+}
+
+bool Decode(WireReader* reader, EchoResponse* message) {
+  return DecodeBlock<flat::EchoResponseView>(reader, message);
+}
+
+bool Decode(WireReader* reader, StreamRequest* message) {
+  return DecodeBlock<flat::StreamRequestView>(reader, message);
+}
+
+bool Decode(WireReader* reader, DataChunk* message) {
+  return DecodeBlock<flat::DataChunkView>(reader, message);
+}
+
+bool Decode(WireReader* reader, UploadResponse* message) {
+  return DecodeBlock<flat::UploadResponseView>(reader, message);
+}
+
+bool Decode(WireReader* reader, BatchRequest* message) {
+  return DecodeBlock<flat::BatchRequestView>(reader, message);
+}
+
+bool Decode(WireReader* reader, BatchResponse* message) {
+  return DecodeBlock<flat::BatchResponseView>(reader, message);
+}
+
+bool Decode(WireReader* reader, EchoChainRequest* message) {
+  return DecodeBlock<flat::EchoChainRequestView>(reader, message);
+}
+
+bool Decode(WireReader* reader, NestedMessage* message) {
+  return DecodeBlock<flat::NestedMessageView>(reader, message);
+}
+
+bool Decode(WireReader* reader, ArrayMessage* message) {
+  return DecodeBlock<flat::ArrayMessageView>(reader, message);
+}
+
+bool Decode(WireReader* reader, MapMessage* message) {
+  return DecodeBlock<flat::MapMessageView>(reader, message);
+}
+
+bool Decode(WireReader* reader, SparseMessage* message) {
+  return DecodeBlock<flat::SparseMessageView>(reader, message);
+}
+
+bool Decode(WireReader* reader, StringMessage* message) {
+  return DecodeBlock<flat::StringMessageView>(reader, message);
+}
+
+void EncodeStatus(ErrorCode code, const std::string& message, WireWriter* writer) {
+  flat::EncodeStatus(code, message, writer);
+}
+
+bool DecodeStatus(WireReader* reader, ErrorCode* code, std::string* message) {
+  const uint8_t* data = nullptr;
+  size_t size = 0;
+  reader->GetRest(&data, &size);
+  flat::StatusView view;
+  if (!flat::Open(data, size, &view)) return false;
+  *code = static_cast<ErrorCode>(view.code());
+  message->assign(view.message());
+  return true;
+}
+
+// FrameBuffer implementation
+uint8_t* FrameBuffer::WritableSpace(size_t min_size, size_t* available) {
+  // Compact once the consumed prefix dominates the buffer
+  if (begin_ > 0 && (begin_ == end_ || begin_ >= data_.size() / 2)) {
+    std::memmove(data_.data(), data_.data() + begin_, end_ - begin_);
+    end_ -= begin_;
+    begin_ = 0;
+  }
+
+  size_t wanted = std::max(min_size, frame_size_ > end_ - begin_
+                                         ? frame_size_ - (end_ - begin_)
+                                         : size_t{0});
+  if (data_.size() - end_ < wanted) {
+    data_.resize(end_ + wanted);
+  }
+  *available = data_.size() - end_;
+  return data_.data() + end_;
+}
+
+bool FrameBuffer::NextFrame(FrameHeader* header, const uint8_t** body, bool* corrupt) {
+  *corrupt = false;
+  size_t buffered = end_ - begin_;
+  if (buffered < kFrameHeaderSize) return false;
+
+  if (!ParseFrameHeader(data_.data() + begin_, header)) {
+    *corrupt = true;
+    return false;
+  }
+
+  if (header->flags & kFlagBodyInFd) {
+    frame_size_ = kFrameHeaderSize;
+    *body = nullptr;
+    return true;
+  }
+
+  frame_size_ = kFrameHeaderSize + header->body_length;
+  if (buffered < frame_size_) return false;
+
+  *body = data_.data() + begin_ + kFrameHeaderSize;
+  return true;
+}
+
+void FrameBuffer::Consume() {
+  begin_ += frame_size_;
+  frame_size_ = 0;
+}
+
+} // namespace wire
+} // namespace common
+} // namespace benchmark
@@ -0,0 +1,287 @@
+#include "work_stealing_executor.h"
+#include "benchmark_utils.h"
+#include "resource_usage.h"
+#include <algorithm>
+#include <iostream>
+#include <unistd.h>
+
+namespace benchmark {
+namespace common {
+
+// WorkStealingDeque implementation
+WorkStealingDeque::WorkStealingDeque(size_t capacity) {
+  size_t size = 2;
+  while (size < capacity) size <<= 1;
+  arrays_.push_back(std::make_unique<Array>(size));
+  array_.store(arrays_.back().get(), std::memory_order_relaxed);
+}
+
+void WorkStealingDeque::Push(ExecutorTask* task) {
+  int64_t bottom = bottom_.load(std::memory_order_relaxed);
+  int64_t top = top_.load(std::memory_order_acquire);
+  Array* array = array_.load(std::memory_order_relaxed);
+  if (bottom - top > static_cast<int64_t>(array->mask)) {
+    auto grown = std::make_unique<Array>(array->Capacity() * 2);
+    for (int64_t i = top; i < bottom; i++) {
+      grown->Put(i, array->Get(i));
+    }
+    array = grown.get();
+    arrays_.push_back(std::move(grown));
+    array_.store(array, std::memory_order_release);
+  }
+  array->Put(bottom, task);
+  std::atomic_thread_fence(std::memory_order_release);
+  bottom_.store(bottom + 1, std::memory_order_relaxed);
+}
+
+ExecutorTask* WorkStealingDeque::Pop() {
+  int64_t bottom = bottom_.load(std::memory_order_relaxed) - 1;
+  Array* array = array_.load(std::memory_order_relaxed);
+  bottom_.store(bottom, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  int64_t top = top_.load(std::memory_order_relaxed);
+
+  if (top > bottom) {
+    bottom_.store(bottom + 1, std::memory_order_relaxed);
+    return nullptr;
+  }
+  ExecutorTask* task = array->Get(bottom);
+  if (top == bottom) {
+    // Last task: race the thieves for it
+    if (!top_.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst,
+                                      std::memory_order_relaxed)) {
+      task = nullptr;
+    }
+    bottom_.store(bottom + 1, std::memory_order_relaxed);
+  }
+  return task;
+}
+
+ExecutorTask* WorkStealingDeque::Steal() {
+  int64_t top = top_.load(std::memory_order_acquire);
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  int64_t bottom = bottom_.load(std::memory_order_acquire);
+  if (top >= bottom) return nullptr;
+
+  Array* array = array_.load(std::memory_order_acquire);
+  ExecutorTask* task = array->Get(top);
+  if (!top_.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst,
+                                    std::memory_order_relaxed)) {
+    return nullptr;
+  }
+  return task;
+}
+
+// Per-worker state; counters are only written by the worker itself
+struct alignas(kCacheLineSize) WorkStealingExecutor::Worker {
+  int index = 0;
+  WorkStealingDeque deque;
+  std::thread thread;
+  uint32_t random = 0;  // Victim selection, xorshift
+
+  std::atomic<uint64_t> executed{0};
+  std::atomic<uint64_t> steals{0};
+  std::atomic<uint64_t> max_depth{0};
+  std::atomic<int64_t> idle_ns{0};
+};
+
+namespace {
+
+// The executor and worker the current thread belongs to, if any
+thread_local WorkStealingExecutor* current_executor = nullptr;
+thread_local void* current_worker = nullptr;
+
+// Counters are single-writer, so a plain add avoids a locked instruction
+void Bump(std::atomic<uint64_t>* counter, uint64_t amount = 1) {
+  counter->store(counter->load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+}
+
+} // namespace
+
+// WorkStealingExecutor implementation
+WorkStealingExecutor::WorkStealingExecutor() : WorkStealingExecutor(Options()) {}
+
+WorkStealingExecutor::WorkStealingExecutor(const Options& options)
+  : options_(options), bell_(options.wait) {
+  std::vector<int> cpus = options_.cpus.empty() ? utils::UsableCpus() : options_.cpus;
+  int count = options_.num_workers;
+  if (count <= 0) count = std::max(1, static_cast<int>(cpus.size()));
+  stats_start_ns_.store(utils::GetTimestampNanos(), std::memory_order_relaxed);
+
+  for (int i = 0; i < count; i++) {
+    auto worker = std::make_unique<Worker>();
+    worker->index = i;
+    worker->random = 0x9e3779b9u * static_cast<uint32_t>(i + 1);
+    workers_.push_back(std::move(worker));
+  }
+  for (auto& worker : workers_) {
+    Worker* self = worker.get();
+    int cpu = cpus.empty() ? -1 : cpus[static_cast<size_t>(self->index) % cpus.size()];
+    self->thread = std::thread([this, self, cpu]() {
+      if (options_.pin_workers && cpu >= 0 && !utils::PinToCpus({cpu})) {
+        std::cerr << "WorkStealingExecutor: could not pin worker " << self->index
+                  << " to CPU " << cpu << std::endl;
+      }
+      Run(self);
+    });
+  }
+}
+
+WorkStealingExecutor::~WorkStealingExecutor() {
+  Shutdown();
+}
+
+bool WorkStealingExecutor::SubmitTask(ExecutorTask* task) {
+  if (current_executor == this) {
+    auto* worker = static_cast<Worker*>(current_worker);
+    worker->deque.Push(task);
+    uint64_t depth = worker->deque.Size();
+    if (depth > worker->max_depth.load(std::memory_order_relaxed)) {
+      worker->max_depth.store(depth, std::memory_order_relaxed);
+    }
+  } else {
+    std::lock_guard<std::mutex> lock(inject_mutex_);
+    if (stopping_.load(std::memory_order_relaxed)) return false;
+    task->next = nullptr;
+    if (inject_tail_) {
+      inject_tail_->next = task;
+    } else {
+      inject_head_ = task;
+    }
+    inject_tail_ = task;
+    inject_size_.fetch_add(1, std::memory_order_release);
+    injected_.fetch_add(1, std::memory_order_relaxed);
+  }
+  bell_.Ring();
+  return true;
+}
+
+ExecutorTask* WorkStealingExecutor::PopInjected() {
+  if (inject_size_.load(std::memory_order_acquire) == 0) return nullptr;
+  std::lock_guard<std::mutex> lock(inject_mutex_);
+  ExecutorTask* task = inject_head_;
+  if (!task) return nullptr;
+  inject_head_ = task->next;
+  if (!inject_head_) inject_tail_ = nullptr;
+  inject_size_.fetch_sub(1, std::memory_order_relaxed);
+  return task;
+}
+
+ExecutorTask* WorkStealingExecutor::FindTask(Worker* worker) {
+  if (ExecutorTask* task = worker->deque.Pop()) return task;
+  if (ExecutorTask* task = PopInjected()) return task;
+
+  // Start at a random victim so thieves spread out
+  size_t count = workers_.size();
+  worker->random ^= worker->random << 13;
+  worker->random ^= worker->random >> 17;
+  worker->random ^= worker->random << 5;
+  size_t start = worker->random % count;
+  for (size_t k = 0; k < count; k++) {
+    Worker* victim = workers_[(start + k) % count].get();
+    if (victim == worker) continue;
+    if (ExecutorTask* task = victim->deque.Steal()) {
+      Bump(&worker->steals);
+      return task;
+    }
+  }
+  return nullptr;
+}
+
+bool WorkStealingExecutor::HasWork() const {
+  if (inject_size_.load(std::memory_order_acquire) > 0) return true;
+  for (const auto& worker : workers_) {
+    if (worker->deque.Size() > 0) return true;
+  }
+  return false;
+}
+
+void WorkStealingExecutor::Run(Worker* worker) {
+  current_executor = this;
+  current_worker = worker;
+  while (true) {
+    if (ExecutorTask* task = FindTask(worker)) {
+      task->run(task);
+      Bump(&worker->executed);
+      continue;
+    }
+    // A lost steal race also lands here; HasWork() then returns at once
+    if (stopping_.load(std::memory_order_acquire) && !HasWork()) break;
+    int64_t idle_start = utils::GetTimestampNanos();
+    bell_.Wait([this]() { return HasWork() || stopping_.load(std::memory_order_acquire); });
+    worker->idle_ns.store(worker->idle_ns.load(std::memory_order_relaxed) +
+                              utils::GetTimestampNanos() - idle_start,
+                          std::memory_order_relaxed);
+  }
+  current_executor = nullptr;
+  current_worker = nullptr;
+}
+
+void WorkStealingExecutor::Shutdown() {
+  {
+    std::lock_guard<std::mutex> lock(inject_mutex_);
+    if (stopping_.exchange(true)) return;
+  }
+  bell_.RingAll();
+  for (auto& worker : workers_) {
+    if (worker->thread.joinable()) worker->thread.join();
+  }
+}
+
+ExecutorStats WorkStealingExecutor::Stats() const {
+  ExecutorStats stats;
+  stats.num_workers = num_workers();
+  stats.injected = injected_.load(std::memory_order_relaxed);
+  stats.queue_depth = inject_size_.load(std::memory_order_relaxed);
+  for (const auto& worker : workers_) {
+    stats.executed += worker->executed.load(std::memory_order_relaxed);
+    stats.steals += worker->steals.load(std::memory_order_relaxed);
+    stats.max_queue_depth =
+        std::max(stats.max_queue_depth, worker->max_depth.load(std::memory_order_relaxed));
+    stats.idle_ns += worker->idle_ns.load(std::memory_order_relaxed);
+    stats.queue_depth += worker->deque.Size();
+  }
+  stats.elapsed_ns = utils::GetTimestampNanos() - stats_start_ns_.load(std::memory_order_relaxed);
+  return stats;
+}
+
+void WorkStealingExecutor::ResetStats() {
+  // Meant for between runs; a reset racing a busy worker may lose one of
+  // its updates
+  injected_.store(0, std::memory_order_relaxed);
+  for (auto& worker : workers_) {
+    worker->executed.store(0, std::memory_order_relaxed);
+    worker->steals.store(0, std::memory_order_relaxed);
+    worker->max_depth.store(0, std::memory_order_relaxed);
+    worker->idle_ns.store(0, std::memory_order_relaxed);
+  }
+  stats_start_ns_.store(utils::GetTimestampNanos(), std::memory_order_relaxed);
+}
+
+namespace {
+
+std::mutex shared_mutex;
+WorkStealingExecutor* shared_executor = nullptr;
+pid_t shared_pid = 0;
+
+} // namespace
+
+WorkStealingExecutor& WorkStealingExecutor::Shared() {
+  std::lock_guard<std::mutex> lock(shared_mutex);
+  if (!shared_executor || shared_pid != ::getpid()) {
+    // The parent's pool has no threads in a forked child; it is left
+    // behind rather than destroyed, since joining them would hang. The
+    // pool lives until exit so late completions always find it.
+    shared_executor = new WorkStealingExecutor();
+    shared_pid = ::getpid();
+  }
+  return *shared_executor;
+}
+
+WorkStealingExecutor* WorkStealingExecutor::SharedIfStarted() {
+  std::lock_guard<std::mutex> lock(shared_mutex);
+  return shared_executor && shared_pid == ::getpid() ? shared_executor : nullptr;
+}
+
+} // namespace common
+} // namespace benchmark
@@ -0,0 +1,178 @@
+#include "workload_trace.h"
+#include "benchmark_utils.h"
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace benchmark {
+namespace common {
+namespace trace {
+
+namespace {
+
+int64_t SteadyNanos() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()
+  ).count();
+}
+
+} // namespace
+
+const char* TraceOperationName(TraceOperation op) {
+  switch (op) {
+    case TraceOperation::kEcho: return "echo";
+    case TraceOperation::kEchoAsync: return "echo_async";
+    case TraceOperation::kStreamData: return "stream_data";
+    case TraceOperation::kUploadData: return "upload_data";
+    case TraceOperation::kBidirectionalStream: return "bidirectional_stream";
+    case TraceOperation::kBatchProcess: return "batch_process";
+    case TraceOperation::kBatchProcessAsync: return "batch_process_async";
+    case TraceOperation::kEchoChain: return "echo_chain";
+  }
+  return "unknown";
+}
+
+// TraceWriter implementation
+TraceWriter::~TraceWriter() {
+  Close();
+}
+
+bool TraceWriter::Open(const std::string& path) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (file_) return false;
+
+  file_ = std::fopen(path.c_str(), "wb");
+  if (!file_) return false;
+
+  std::memcpy(header_.magic, kTraceMagic, sizeof(kTraceMagic));
+  header_.version = kTraceVersion;
+  header_.record_size = sizeof(TraceRecord);
+  header_.record_count = 0;
+  header_.start_timestamp_ns = utils::GetTimestampNanos();
+  last_ns_ = SteadyNanos();
+
+  return std::fwrite(&header_, sizeof(header_), 1, file_) == 1;
+}
+
+uint64_t TraceWriter::Append(
+    TraceOperation op, uint64_t payload_size, uint64_t item_count) {
+  int64_t now = SteadyNanos();
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (!file_) return kNoRecord;
+
+  TraceRecord record{};
+  record.inter_arrival_ns = static_cast<uint64_t>(std::max<int64_t>(0, now - last_ns_));
+  record.payload_size = static_cast<uint32_t>(std::min<uint64_t>(payload_size, UINT32_MAX));
+  record.item_count = static_cast<uint16_t>(std::min<uint64_t>(item_count, UINT16_MAX));
+  record.operation = static_cast<uint8_t>(op);
+  last_ns_ = std::max(last_ns_, now);
+
+  if (std::fwrite(&record, sizeof(record), 1, file_) != 1) return kNoRecord;
+  return header_.record_count++;
+}
+
+void TraceWriter::Update(uint64_t index, uint64_t payload_size, uint64_t item_count) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (!file_ || index >= header_.record_count) return;
+
+  // payload_size and item_count are adjacent, so one write covers both
+  TraceRecord record{};
+  record.payload_size = static_cast<uint32_t>(std::min<uint64_t>(payload_size, UINT32_MAX));
+  record.item_count = static_cast<uint16_t>(std::min<uint64_t>(item_count, UINT16_MAX));
+  constexpr size_t kOffset = offsetof(TraceRecord, payload_size);
+  constexpr size_t kSize = offsetof(TraceRecord, operation) - kOffset;
+  long position = static_cast<long>(sizeof(TraceHeader) + index * sizeof(TraceRecord) + kOffset);
+  if (std::fseek(file_, position, SEEK_SET) == 0) {
+    std::fwrite(reinterpret_cast<const char*>(&record) + kOffset, kSize, 1, file_);
+  }
+  std::fseek(file_, 0, SEEK_END);
+}
+
+void TraceWriter::Close() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (!file_) return;
+
+  std::fseek(file_, 0, SEEK_SET);
+  std::fwrite(&header_, sizeof(header_), 1, file_);
+  std::fclose(file_);
+  file_ = nullptr;
+}
+
+uint64_t TraceWriter::GetRecordCount() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return header_.record_count;
+}
+
+// TraceReader implementation
+TraceReader::~TraceReader() {
+  Close();
+}
+
+bool TraceReader::Open(const std::string& path, std::string* error) {
+  Close();
+
+  int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    *error = "cannot open trace " + path;
+    return false;
+  }
+
+  struct stat st;
+  if (::fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(TraceHeader)) {
+    ::close(fd);
+    *error = "trace " + path + " is too short";
+    return false;
+  }
+
+  mapping_size_ = static_cast<size_t>(st.st_size);
+  mapping_ = ::mmap(nullptr, mapping_size_, PROT_READ, MAP_PRIVATE, fd, 0);
+  ::close(fd);
+  if (mapping_ == MAP_FAILED) {
+    mapping_ = nullptr;
+    *error = "cannot map trace " + path;
+    return false;
+  }
+
+  // Replay walks the records front to back
+  ::madvise(mapping_, mapping_size_, MADV_SEQUENTIAL);
+
+  header_ = static_cast<const TraceHeader*>(mapping_);
+  if (std::memcmp(header_->magic, kTraceMagic, sizeof(kTraceMagic)) != 0 ||
+      header_->version != kTraceVersion ||
+      header_->record_size != sizeof(TraceRecord)) {
+    Close();
+    *error = path + " is not a version " + std::to_string(kTraceVersion) + " trace";
+    return false;
+  }
+
+  // Trust the file size over the header count so that traces from a
+  // process that never closed its writer remain readable
+  uint64_t available = (mapping_size_ - sizeof(TraceHeader)) / sizeof(TraceRecord);
+  record_count_ = header_->record_count > 0
+      ? std::min<uint64_t>(header_->record_count, available)
+      : available;
+  records_ = reinterpret_cast<const TraceRecord*>(
+      static_cast<const char*>(mapping_) + sizeof(TraceHeader));
+  return true;
+}
+
+void TraceReader::Close() {
+  if (mapping_) {
+    ::munmap(mapping_, mapping_size_);
+  }
+  mapping_ = nullptr;
+  mapping_size_ = 0;
+  header_ = nullptr;
+  records_ = nullptr;
+  record_count_ = 0;
+}
+
+} // namespace trace
+} // namespace common
+} // namespace benchmark
@@ -1,34 +1,404 @@
-// Cap'n Proto client implementation
-// This file will contain the Cap'n Proto-specific implementation of IBenchmarkClient
+// Cap'n Proto client: the common service over the bootstrap capability
 
-#include "benchmark_service.h"
-#include "benchmark_types.h"
-
-// TODO: Include generated Cap'n Proto headers
-// #include "benchmark.capnp.h"
+#include "capnproto_framework.h"
+#include "capnproto_support.h"
+#include <capnp/rpc-twoparty.h>
+#include <kj/async-io.h>
+#include <iostream>
 
 namespace benchmark {
 namespace capnp_impl {
 
-// TODO: Implement Cap'n Proto client wrapper that implements common::IBenchmarkClient
-// Cap'n Proto uses a different RPC model than gRPC
-// Reference: https://capnproto.org/cxxrpc.html
-
-// class CapnProtoBenchmarkClient : public common::IBenchmarkClient {
-// public:
-//   CapnProtoBenchmarkClient();
-//   ~CapnProtoBenchmarkClient() override;
-//
-//   common::IBenchmarkService* GetService() override;
-//   bool Connect(const std::string& address) override;
-//   void Disconnect() override;
-//   bool IsConnected() const override;
-//
-// private:
-//   capnp::EzRpcClient client_;
-//   BenchmarkService::Client capability_;
-//   // ... other members
-// };
+namespace {
+
+const char* const kNotConnected = "Cap'n Proto client is not connected";
+
+} // namespace
+
+// The client's event-loop thread. It owns the connection and the
+// bootstrap capability, which are not thread-safe; other threads reach
+// them by running functions on the loop through its executor.
+class ClientLoop {
+public:
+  ~ClientLoop() { Stop(); }
+
+  // Starts the thread and connects to `address`; false if it cannot
+  bool Start(const std::string& address) {
+    std::promise<bool> started;
+    auto connected = started.get_future();
+    thread_ = std::thread([this, address, &started] { Serve(address, &started); });
+    if (!connected.get()) {
+      thread_.join();
+      return false;
+    }
+    return true;
+  }
+
+  void Stop() {
+    if (!thread_.joinable()) return;
+    stop_->fulfill();
+    thread_.join();
+  }
+
+  // Runs `func` on the loop thread and waits for its result, or for the
+  // promise it returns to resolve. Throws if the loop goes away first.
+  // Not for the loop thread itself.
+  template<typename Func>
+  decltype(auto) Wait(Func&& func) {
+    return executor_->executeSync(kj::fwd<Func>(func));
+  }
+
+  // Runs `func` on the loop thread, inline when already on it; false if
+  // the loop has gone away
+  template<typename Func>
+  bool Post(Func&& func) {
+    if (std::this_thread::get_id() == loop_thread_) {
+      func();
+      return true;
+    }
+    try {
+      executor_->executeSync(kj::fwd<Func>(func));
+      return true;
+    } catch (const kj::Exception&) {
+      return false;
+    }
+  }
+
+  // Loop thread only
+  schema::BenchmarkService::Client& service() { return *service_; }
+
+  // Loop thread only: keeps a call running until it settles
+  void Detach(kj::Promise<void> promise) { tasks_->add(kj::mv(promise)); }
+
+private:
+  void Serve(const std::string& address, std::promise<bool>* started) {
+    kj::AsyncIoContext io = kj::setupAsyncIo();
+    kj::Own<kj::AsyncIoStream> connection;
+    try {
+      auto network_address = io.provider->getNetwork().parseAddress(address).wait(io.waitScope);
+      connection = network_address->connect().wait(io.waitScope);
+    } catch (const kj::Exception& exception) {
+      std::cerr << "CapnProtoClient: cannot connect to " << address << ": "
+                << exception.getDescription().cStr() << std::endl;
+      started->set_value(false);
+      return;
+    }
+
+    capnp::TwoPartyVatNetwork network(*connection, capnp::rpc::twoparty::Side::CLIENT,
+                                      UnlimitedReaderOptions());
+    auto rpc = capnp::makeRpcClient(network);
+    capnp::MallocMessageBuilder vat_id_message(8);
+    auto server_id = vat_id_message.initRoot<capnp::rpc::twoparty::VatId>();
+    server_id.setSide(capnp::rpc::twoparty::Side::SERVER);
+    schema::BenchmarkService::Client service =
+        rpc.bootstrap(server_id.asReader()).castAs<schema::BenchmarkService>();
+
+    // Calls still in flight are cancelled when the loop stops
+    TaskErrorLogger errors("CapnProtoClient");
+    kj::TaskSet tasks(errors);
+
+    auto stop = kj::newPromiseAndCrossThreadFulfiller<void>();
+    stop_ = kj::mv(stop.fulfiller);
+    executor_ = kj::getCurrentThreadExecutor().addRef();
+    loop_thread_ = std::this_thread::get_id();
+    service_ = &service;
+    tasks_ = &tasks;
+
+    started->set_value(true);
+    stop.promise.wait(io.waitScope);
+  }
+
+  std::thread thread_;
+  // Set by the loop thread before Start() returns
+  std::thread::id loop_thread_;
+  kj::Own<const kj::Executor> executor_;
+  kj::Own<kj::CrossThreadPromiseFulfiller<void>> stop_;
+  schema::BenchmarkService::Client* service_ = nullptr;
+  kj::TaskSet* tasks_ = nullptr;
+};
+
+namespace {
+
+// Result of a unary call once it settles; `send` issues it on the loop
+// thread and returns its RemotePromise
+template<typename T, typename Send>
+kj::Promise<common::Result<T>> Settle(Send& send) {
+  return send().then(
+      [](auto&& response) { return ToResult<T>(response); },
+      [](kj::Exception&& exception) { return ErrorResult<T>(exception); });
+}
+
+template<typename T, typename Send>
+common::Result<T> CallBlocking(ClientLoop* loop, Send send) {
+  try {
+    return loop->Wait([&send]() { return Settle<T>(send); });
+  } catch (const kj::Exception& exception) {
+    // The loop stopped with the call in flight
+    return ErrorResult<T>(exception);
+  }
+}
+
+// `callback` runs on the loop thread
+template<typename T, typename Send>
+void CallAsync(ClientLoop* loop, Send send, common::ResponseCallback<T> callback) {
+  // Post() runs the function before it returns, so references are safe
+  bool posted = loop->Post([loop, &send, &callback]() {
+    loop->Detach(Settle<T>(send).then(
+        [callback = std::move(callback)](common::Result<T>&& result) { callback(result); }));
+  });
+  if (!posted) callback(common::Result<T>(common::ErrorCode::UNAVAILABLE, kNotConnected));
+}
+
+void Complete(const common::CompletionCallback& on_complete, schema::Status::Reader status) {
+  on_complete(FromStatusCode(status.getCode()), status.getMessage().cStr());
+}
+
+void Fail(const common::CompletionCallback& on_complete, const kj::Exception& exception) {
+  on_complete(FromException(exception), exception.getDescription().cStr());
+}
+
+// Caller-side provider for a client stream: chunks go to the queue, and
+// the closing empty chunk closes it
+common::StreamCallback<common::DataChunk> ProviderFor(std::shared_ptr<ChunkQueue> queue) {
+  return [queue](const common::DataChunk& chunk) {
+    if (chunk.data.empty()) {
+      queue->Close(common::ErrorCode::OK, std::string());
+    } else {
+      queue->Push(chunk);
+    }
+  };
+}
+
+// Receiving end of a server stream. Each chunk is read in place from the
+// request into one reused DataChunk and handed on.
+class ChunkReceiver final : public schema::DataChunkStream::Server {
+public:
+  explicit ChunkReceiver(common::StreamCallback<common::DataChunk> on_chunk)
+    : on_chunk_(std::move(on_chunk)) {}
+
+  kj::Promise<void> write(WriteContext context) override {
+    FromCapnp(context.getParams().getChunk(), &chunk_);
+    on_chunk_(chunk_);
+    return kj::READY_NOW;
+  }
+
+  // The server reports how the stream ended in its own results
+  kj::Promise<void> done(DoneContext) override { return kj::READY_NOW; }
+
+private:
+  common::StreamCallback<common::DataChunk> on_chunk_;
+  common::DataChunk chunk_;
+};
+
+} // namespace
+
+// CapnProtoServiceStub implementation
+common::Result<common::EchoResponse> CapnProtoServiceStub::Echo(
+    const common::EchoRequest& request) {
+  return CallBlocking<common::EchoResponse>(loop_, [this, &request]() {
+    auto call = loop_->service().echoRequest();
+    ToCapnp(request, call.initRequest());
+    return call.send();
+  });
+}
+
+void CapnProtoServiceStub::EchoAsync(
+    const common::EchoRequest& request,
+    common::ResponseCallback<common::EchoResponse> callback) {
+  CallAsync<common::EchoResponse>(loop_, [this, &request]() {
+    auto call = loop_->service().echoRequest();
+    ToCapnp(request, call.initRequest());
+    return call.send();
+  }, std::move(callback));
+}
+
+void CapnProtoServiceStub::StreamData(
+    const common::StreamRequest& request,
+    common::StreamCallback<common::DataChunk> on_chunk,
+    common::CompletionCallback on_complete) {
+  bool posted = loop_->Post([this, &request, &on_chunk, &on_complete]() {
+    auto call = loop_->service().streamDataRequest();
+    ToCapnp(request, call.initRequest());
+    call.setSink(kj::heap<ChunkReceiver>(std::move(on_chunk)));
+    // The server returns once done() on the sink has returned, so every
+    // chunk has been handed on by then
+    loop_->Detach(call.send().then(
+        [on_complete](capnp::Response<schema::BenchmarkService::StreamDataResults>&& response) {
+          Complete(on_complete, response.getStatus());
+        },
+        [on_complete](kj::Exception&& exception) { Fail(on_complete, exception); }));
+  });
+  if (!posted) on_complete(common::ErrorCode::UNAVAILABLE, kNotConnected);
+}
+
+void CapnProtoServiceStub::UploadData(
+    common::StreamCallback<common::DataChunk>& chunk_provider,
+    common::ResponseCallback<common::UploadResponse> on_complete) {
+  auto queue = std::make_shared<ChunkQueue>();
+  chunk_provider = ProviderFor(queue);
+  bool posted = loop_->Post([this, &queue, &on_complete]() {
+    // Writes go to the pipelined stream capability without waiting for
+    // uploadData() to return
+    auto call = loop_->service().uploadDataRequest().send();
+    schema::UploadStream::Client stream = call.getStream();
+    auto written = WriteChunks(queue, stream);
+    loop_->Detach(written
+        .then([stream = kj::mv(stream)]() mutable
+                  -> kj::Promise<capnp::Response<schema::UploadStream::DoneResults>> {
+          return stream.doneRequest().send();
+        })
+        .then(
+            [on_complete](capnp::Response<schema::UploadStream::DoneResults>&& response) {
+              on_complete(ToResult<common::UploadResponse>(response));
+            },
+            [on_complete](kj::Exception&& exception) {
+              on_complete(ErrorResult<common::UploadResponse>(exception));
+            })
+        .attach(kj::mv(call)));
+  });
+  if (!posted) {
+    on_complete(common::Result<common::UploadResponse>(common::ErrorCode::UNAVAILABLE,
+                                                       kNotConnected));
+  }
+}
+
+void CapnProtoServiceStub::BidirectionalStream(
+    common::StreamCallback<common::DataChunk>& chunk_provider,
+    common::StreamCallback<common::DataChunk> on_chunk,
+    common::CompletionCallback on_complete) {
+  auto queue = std::make_shared<ChunkQueue>();
+  chunk_provider = ProviderFor(queue);
+  bool posted = loop_->Post([this, &queue, &on_chunk, &on_complete]() {
+    auto request = loop_->service().bidirectionalStreamRequest();
+    request.setReplies(kj::heap<ChunkReceiver>(std::move(on_chunk)));
+    auto call = request.send();
+    schema::DataChunkStream::Client stream = call.getStream();
+    auto written = WriteChunks(queue, stream);
+    loop_->Detach(written
+        .then([stream = kj::mv(stream)]() mutable
+                  -> kj::Promise<capnp::Response<schema::DataChunkStream::DoneResults>> {
+          return stream.doneRequest().send();
+        })
+        .then(
+            [on_complete](capnp::Response<schema::DataChunkStream::DoneResults>&& response) {
+              Complete(on_complete, response.getStatus());
+            },
+            [on_complete](kj::Exception&& exception) { Fail(on_complete, exception); })
+        .attach(kj::mv(call)));
+  });
+  if (!posted) on_complete(common::ErrorCode::UNAVAILABLE, kNotConnected);
+}
+
+common::Result<common::BatchResponse> CapnProtoServiceStub::BatchProcess(
+    const common::BatchRequest& request) {
+  return CallBlocking<common::BatchResponse>(loop_, [this, &request]() {
+    auto call = loop_->service().batchProcessRequest();
+    ToCapnp(request, call.initRequest());
+    return call.send();
+  });
+}
+
+void CapnProtoServiceStub::BatchProcessAsync(
+    const common::BatchRequest& request,
+    common::ResponseCallback<common::BatchResponse> callback) {
+  CallAsync<common::BatchResponse>(loop_, [this, &request]() {
+    auto call = loop_->service().batchProcessRequest();
+    ToCapnp(request, call.initRequest());
+    return call.send();
+  }, std::move(callback));
+}
+
+common::Result<common::EchoResponse> CapnProtoServiceStub::EchoChain(
+    const common::EchoRequest& request, uint32_t length) {
+  if (length == 0) return IBenchmarkService::EchoChain(request, length);
+  return CallBlocking<common::EchoResponse>(loop_, [this, &request, length]() {
+    auto call = loop_->service().echoChainRequest();
+    ToCapnp(request, call.initRequest());
+    // Dropping each call's promise keeps the call alive while its
+    // pipelined capability is in use
+    schema::EchoLink::Client link = call.send().getLink();
+    for (uint32_t i = 1; i < length; i++) {
+      link = link.nextRequest().send().getLink();
+    }
+    return link.resultRequest().send();
+  });
+}
+
+common::Result<common::NestedMessage> CapnProtoServiceStub::EchoShape(
+    const common::NestedMessage& request) {
+  return CallBlocking<common::NestedMessage>(loop_, [this, &request]() {
+    auto call = loop_->service().echoNestedRequest();
+    ToCapnp(request, call.initRequest());
+    return call.send();
+  });
+}
+
+common::Result<common::ArrayMessage> CapnProtoServiceStub::EchoShape(
+    const common::ArrayMessage& request) {
+  return CallBlocking<common::ArrayMessage>(loop_, [this, &request]() {
+    auto call = loop_->service().echoArraysRequest();
+    ToCapnp(request, call.initRequest());
+    return call.send();
+  });
+}
+
+common::Result<common::MapMessage> CapnProtoServiceStub::EchoShape(
+    const common::MapMessage& request) {
+  return CallBlocking<common::MapMessage>(loop_, [this, &request]() {
+    auto call = loop_->service().echoMapRequest();
+    ToCapnp(request, call.initRequest());
+    return call.send();
+  });
+}
+
+common::Result<common::SparseMessage> CapnProtoServiceStub::EchoShape(
+    const common::SparseMessage& request) {
+  return CallBlocking<common::SparseMessage>(loop_, [this, &request]() {
+    auto call = loop_->service().echoSparseRequest();
+    ToCapnp(request, call.initRequest());
+    return call.send();
+  });
+}
+
+common::Result<common::StringMessage> CapnProtoServiceStub::EchoShape(
+    const common::StringMessage& request) {
+  return CallBlocking<common::StringMessage>(loop_, [this, &request]() {
+    auto call = loop_->service().echoStringsRequest();
+    ToCapnp(request, call.initRequest());
+    return call.send();
+  });
+}
+
+// CapnProtoClient implementation
+CapnProtoClient::CapnProtoClient() = default;
+
+CapnProtoClient::~CapnProtoClient() {
+  Disconnect();
+}
+
+common::IBenchmarkService* CapnProtoClient::GetService() {
+  return service_.get();
+}
+
+bool CapnProtoClient::Connect(const std::string& address) {
+  Disconnect();
+
+  auto loop = std::make_unique<ClientLoop>();
+  if (!loop->Start(address)) return false;
+
+  loop_ = std::move(loop);
+  service_ = std::make_unique<CapnProtoServiceStub>(loop_.get());
+  return true;
+}
+
+void CapnProtoClient::Disconnect() {
+  service_.reset();
+  loop_.reset();
+}
+
+bool CapnProtoClient::IsConnected() const {
+  return service_ != nullptr;
+}
 
 } // namespace capnp_impl
 } // namespace benchmark
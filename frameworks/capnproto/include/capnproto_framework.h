@@ -0,0 +1,125 @@
+#pragma once
+
+#include "benchmark_service.h"
+#include <kj/async.h>
+#include <atomic>
+#include <condition_variable>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace benchmark {
+namespace capnp_impl {
+
+// Cap'n Proto adapter: the common service over two-party RPC on kj async
+// I/O. Each side runs one event-loop thread that owns its connections and
+// capabilities; calls from other threads hop onto it through the loop's
+// kj::Executor. Streams use `-> stream` methods (see benchmark.capnp), so
+// each direction has Cap'n Proto's flow control.
+
+class ClientLoop;
+
+class CapnProtoServer : public common::IBenchmarkServer {
+public:
+  explicit CapnProtoServer(std::shared_ptr<common::IBenchmarkService> service)
+    : service_(std::move(service)) {}
+  ~CapnProtoServer() override;
+
+  bool Start(const std::string& address) override;
+  void Stop() override;
+  bool IsRunning() const override;
+  void Wait() override;
+
+private:
+  // The event-loop thread: listens on `address`, reports the outcome
+  // through `started`, then serves until Stop()
+  void Serve(const std::string& address, std::promise<bool>* started);
+
+  std::shared_ptr<common::IBenchmarkService> service_;
+  std::thread thread_;
+  std::atomic<bool> running_{false};
+  std::mutex mutex_;
+  kj::Own<kj::CrossThreadPromiseFulfiller<void>> stop_;  // Guarded by mutex_
+  std::mutex wait_mutex_;
+  std::condition_variable wait_cv_;
+};
+
+// Client-side service over the bootstrap capability. Blocking calls wait
+// for the loop thread; async calls and streams complete on it, so their
+// callbacks run there.
+class CapnProtoServiceStub : public common::IBenchmarkService {
+public:
+  explicit CapnProtoServiceStub(ClientLoop* loop) : loop_(loop) {}
+
+  common::Result<common::EchoResponse> Echo(const common::EchoRequest& request) override;
+
+  void EchoAsync(
+      const common::EchoRequest& request,
+      common::ResponseCallback<common::EchoResponse> callback) override;
+
+  void StreamData(
+      const common::StreamRequest& request,
+      common::StreamCallback<common::DataChunk> on_chunk,
+      common::CompletionCallback on_complete) override;
+
+  void UploadData(
+      common::StreamCallback<common::DataChunk>& chunk_provider,
+      common::ResponseCallback<common::UploadResponse> on_complete) override;
+
+  void BidirectionalStream(
+      common::StreamCallback<common::DataChunk>& chunk_provider,
+      common::StreamCallback<common::DataChunk> on_chunk,
+      common::CompletionCallback on_complete) override;
+
+  common::Result<common::BatchResponse> BatchProcess(
+      const common::BatchRequest& request) override;
+
+  void BatchProcessAsync(
+      const common::BatchRequest& request,
+      common::ResponseCallback<common::BatchResponse> callback) override;
+
+  // Pipelined: every link is sent at once, on the capability the previous
+  // link will return, and the chain costs one round trip
+  common::Result<common::EchoResponse> EchoChain(const common::EchoRequest& request,
+                                                 uint32_t length) override;
+
+  common::Result<common::NestedMessage> EchoShape(const common::NestedMessage& request) override;
+  common::Result<common::ArrayMessage> EchoShape(const common::ArrayMessage& request) override;
+  common::Result<common::MapMessage> EchoShape(const common::MapMessage& request) override;
+  common::Result<common::SparseMessage> EchoShape(const common::SparseMessage& request) override;
+  common::Result<common::StringMessage> EchoShape(const common::StringMessage& request) override;
+
+private:
+  ClientLoop* loop_;
+};
+
+// One connection, shared by all calling threads
+class CapnProtoClient : public common::IBenchmarkClient {
+public:
+  CapnProtoClient();
+  ~CapnProtoClient() override;
+
+  common::IBenchmarkService* GetService() override;
+  bool Connect(const std::string& address) override;
+  void Disconnect() override;
+  bool IsConnected() const override;
+
+private:
+  std::unique_ptr<ClientLoop> loop_;
+  std::unique_ptr<CapnProtoServiceStub> service_;
+};
+
+class CapnProtoFactory : public common::IFrameworkFactory {
+public:
+  std::string GetName() const override { return "Cap'n Proto"; }
+  std::unique_ptr<common::IBenchmarkClient> CreateClient() override;
+  std::unique_ptr<common::IBenchmarkServer> CreateServer(
+      std::shared_ptr<common::IBenchmarkService> service) override;
+};
+
+std::unique_ptr<common::IFrameworkFactory> CreateCapnProtoFactory();
+
+} // namespace capnp_impl
+} // namespace benchmark
@@ -0,0 +1,214 @@
+#pragma once
+
+#include "benchmark.capnp.h"
+#include "benchmark_service.h"
+#include "benchmark_types.h"
+#include <capnp/message.h>
+#include <kj/async.h>
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+
+namespace benchmark {
+namespace capnp_impl {
+
+// Pieces shared by the Cap'n Proto client and server. The generated types
+// live in benchmark::capnp_schema, next to the common types in
+// benchmark::common.
+
+namespace schema = ::benchmark::capnp_schema;
+
+extern const char* const kNoClientStreams;
+
+// Both ends read messages of any size; the large-message scenario goes
+// well past the default 64 MiB traversal limit
+capnp::ReaderOptions UnlimitedReaderOptions();
+
+// Copy between the common types and the generated messages. Reading a
+// Data or Text field yields a view into the received segment, so each
+// payload is copied once, straight into the common type; the DataChunk
+// reader reuses the target's buffer, so a stream decodes without
+// allocating once its chunk size is reached.
+void ToCapnp(const common::EchoRequest& from, schema::EchoRequest::Builder to);
+void ToCapnp(const common::EchoResponse& from, schema::EchoResponse::Builder to);
+void ToCapnp(const common::StreamRequest& from, schema::StreamRequest::Builder to);
+void ToCapnp(const common::DataChunk& from, schema::DataChunk::Builder to);
+void ToCapnp(const common::UploadResponse& from, schema::UploadResponse::Builder to);
+void ToCapnp(const common::BatchRequest& from, schema::BatchRequest::Builder to);
+void ToCapnp(const common::BatchResponse& from, schema::BatchResponse::Builder to);
+void ToCapnp(const common::NestedMessage& from, schema::NestedMessage::Builder to);
+void ToCapnp(const common::ArrayMessage& from, schema::ArrayMessage::Builder to);
+void ToCapnp(const common::MapMessage& from, schema::MapMessage::Builder to);
+void ToCapnp(const common::SparseMessage& from, schema::SparseMessage::Builder to);
+void ToCapnp(const common::StringMessage& from, schema::StringMessage::Builder to);
+
+void FromCapnp(schema::EchoRequest::Reader from, common::EchoRequest* to);
+void FromCapnp(schema::EchoResponse::Reader from, common::EchoResponse* to);
+void FromCapnp(schema::StreamRequest::Reader from, common::StreamRequest* to);
+void FromCapnp(schema::DataChunk::Reader from, common::DataChunk* to);
+void FromCapnp(schema::UploadResponse::Reader from, common::UploadResponse* to);
+void FromCapnp(schema::BatchRequest::Reader from, common::BatchRequest* to);
+void FromCapnp(schema::BatchResponse::Reader from, common::BatchResponse* to);
+void FromCapnp(schema::NestedMessage::Reader from, common::NestedMessage* to);
+void FromCapnp(schema::ArrayMessage::Reader from, common::ArrayMessage* to);
+void FromCapnp(schema::MapMessage::Reader from, common::MapMessage* to);
+void FromCapnp(schema::SparseMessage::Reader from, common::SparseMessage* to);
+void FromCapnp(schema::StringMessage::Reader from, common::StringMessage* to);
+
+// SparseRecord presence bits: int i is bit i
+constexpr size_t kSparseDoubleBit = common::SparseRecord::kIntFields;
+constexpr size_t kSparseTextBit = kSparseDoubleBit + common::SparseRecord::kDoubleFields;
+
+// Calls ints(index, value), doubles(index, value) and texts(index, value)
+// for the fields `record` has set
+template<typename Ints, typename Doubles, typename Texts>
+void ForEachSetField(schema::SparseRecord::Reader record, Ints ints, Doubles doubles,
+                     Texts texts) {
+  uint32_t present = record.getPresent();
+  if (present & (1u << 0)) ints(0, record.getInt0());
+  if (present & (1u << 1)) ints(1, record.getInt1());
+  if (present & (1u << 2)) ints(2, record.getInt2());
+  if (present & (1u << 3)) ints(3, record.getInt3());
+  if (present & (1u << 4)) ints(4, record.getInt4());
+  if (present & (1u << 5)) ints(5, record.getInt5());
+  if (present & (1u << 6)) ints(6, record.getInt6());
+  if (present & (1u << 7)) ints(7, record.getInt7());
+  if (present & (1u << 8)) ints(8, record.getInt8());
+  if (present & (1u << 9)) ints(9, record.getInt9());
+  if (present & (1u << 10)) ints(10, record.getInt10());
+  if (present & (1u << 11)) ints(11, record.getInt11());
+  if (present & (1u << 12)) ints(12, record.getInt12());
+  if (present & (1u << 13)) ints(13, record.getInt13());
+  if (present & (1u << 14)) ints(14, record.getInt14());
+  if (present & (1u << 15)) ints(15, record.getInt15());
+  if (present & (1u << (kSparseDoubleBit + 0))) doubles(0, record.getDouble0());
+  if (present & (1u << (kSparseDoubleBit + 1))) doubles(1, record.getDouble1());
+  if (present & (1u << (kSparseDoubleBit + 2))) doubles(2, record.getDouble2());
+  if (present & (1u << (kSparseDoubleBit + 3))) doubles(3, record.getDouble3());
+  if (present & (1u << (kSparseDoubleBit + 4))) doubles(4, record.getDouble4());
+  if (present & (1u << (kSparseDoubleBit + 5))) doubles(5, record.getDouble5());
+  if (present & (1u << (kSparseDoubleBit + 6))) doubles(6, record.getDouble6());
+  if (present & (1u << (kSparseDoubleBit + 7))) doubles(7, record.getDouble7());
+  if (present & (1u << (kSparseTextBit + 0))) texts(0, record.getText0());
+  if (present & (1u << (kSparseTextBit + 1))) texts(1, record.getText1());
+  if (present & (1u << (kSparseTextBit + 2))) texts(2, record.getText2());
+  if (present & (1u << (kSparseTextBit + 3))) texts(3, record.getText3());
+  if (present & (1u << (kSparseTextBit + 4))) texts(4, record.getText4());
+  if (present & (1u << (kSparseTextBit + 5))) texts(5, record.getText5());
+  if (present & (1u << (kSparseTextBit + 6))) texts(6, record.getText6());
+  if (present & (1u << (kSparseTextBit + 7))) texts(7, record.getText7());
+}
+
+void ToStatus(common::ErrorCode code, const std::string& message, schema::Status::Builder to);
+common::ErrorCode FromStatusCode(uint8_t code);
+
+// Error code for a call that failed with an exception rather than a status
+common::ErrorCode FromException(const kj::Exception& exception);
+
+// Result of a finished unary call
+template<typename T, typename Results>
+common::Result<T> ToResult(const Results& results) {
+  auto status = results.getStatus();
+  if (status.getCode() != 0) {
+    return common::Result<T>(FromStatusCode(status.getCode()), status.getMessage().cStr());
+  }
+  common::Result<T> result;
+  FromCapnp(results.getResponse(), &result.value);
+  return result;
+}
+
+// Result of a call that failed with an exception
+template<typename T>
+common::Result<T> ErrorResult(const kj::Exception& exception) {
+  return common::Result<T>(FromException(exception), exception.getDescription().cStr());
+}
+
+// Callback that hands a service result to the event loop, from whichever
+// thread the service completes on. Only the first result counts.
+template<typename T>
+common::ResponseCallback<T> FulfillWith(
+    kj::Own<kj::CrossThreadPromiseFulfiller<common::Result<T>>> fulfiller) {
+  struct Once {
+    kj::Own<kj::CrossThreadPromiseFulfiller<common::Result<T>>> fulfiller;
+    std::atomic<bool> done{false};
+  };
+  auto once = std::make_shared<Once>();
+  once->fulfiller = kj::mv(fulfiller);
+  return [once](const common::Result<T>& result) {
+    if (once->done.exchange(true, std::memory_order_acq_rel)) return;
+    once->fulfiller->fulfill(common::Result<T>(result));
+  };
+}
+
+// Outgoing half of a stream. Producers push chunks from any thread; the
+// event loop drains them in order into a `-> stream` method (see
+// WriteChunks). Once the producer has closed the queue and it has
+// drained, the stream is done. Push and Close are ignored once closed.
+class ChunkQueue {
+public:
+  void Push(const common::DataChunk& chunk);
+  void Close(common::ErrorCode code, const std::string& message);
+
+  // Event-loop side: take the next chunk, if one is queued
+  bool Pop(common::DataChunk* chunk);
+
+  // Closed, and nothing left to pop
+  bool Drained();
+
+  // Resolves on the next Push or Close, or at once if either is pending
+  kj::Promise<void> Ready();
+
+  // How the producer closed the queue; valid once Drained()
+  common::ErrorCode code();
+  std::string message();
+
+private:
+  std::mutex mutex_;
+  std::deque<common::DataChunk> pending_;
+  bool closed_ = false;
+  common::ErrorCode code_ = common::ErrorCode::OK;
+  std::string message_;
+  kj::Own<kj::CrossThreadPromiseFulfiller<void>> waiter_;
+};
+
+common::StreamCallback<common::DataChunk> PushTo(std::shared_ptr<ChunkQueue> queue);
+common::CompletionCallback CloseOf(std::shared_ptr<ChunkQueue> queue);
+
+// Drains `queue` into `sink`, a DataChunkStream or UploadStream client,
+// one write() per chunk. The promise of a streaming call resolves as soon
+// as the flow-control window has room, so waiting on each one before the
+// next keeps a window's worth of chunks in flight rather than one. The
+// result resolves once the queue has drained; the caller ends the stream.
+template<typename Sink>
+kj::Promise<void> WriteChunks(std::shared_ptr<ChunkQueue> queue, Sink sink) {
+  common::DataChunk chunk;
+  if (queue->Pop(&chunk)) {
+    auto request = sink.writeRequest();
+    ToCapnp(chunk, request.initChunk());
+    auto sent = request.send();
+    return sent.then([queue, sink = kj::mv(sink)]() mutable {
+      return WriteChunks(kj::mv(queue), kj::mv(sink));
+    });
+  }
+  if (queue->Drained()) return kj::READY_NOW;
+  auto ready = queue->Ready();
+  return ready.then([queue, sink = kj::mv(sink)]() mutable {
+    return WriteChunks(kj::mv(queue), kj::mv(sink));
+  });
+}
+
+// Logs failed background tasks; a peer going away is not worth a line
+class TaskErrorLogger final : public kj::TaskSet::ErrorHandler {
+public:
+  explicit TaskErrorLogger(const char* owner) : owner_(owner) {}
+
+  void taskFailed(kj::Exception&& exception) override;
+
+private:
+  const char* owner_;
+};
+
+} // namespace capnp_impl
+} // namespace benchmark
@@ -1,47 +1,378 @@
-// Cap'n Proto server implementation
-// This file will contain the Cap'n Proto-specific implementation of IBenchmarkServer
+// Cap'n Proto server: the common service behind the generated
+// BenchmarkService, on one kj event loop
 
-#include "benchmark_service.h"
-#include "benchmark_types.h"
-
-// TODO: Include generated Cap'n Proto headers
-// #include "benchmark.capnp.h"
+#include "capnproto_framework.h"
+#include "capnproto_support.h"
+#include <capnp/rpc-twoparty.h>
+#include <kj/async-io.h>
+#include <kj/debug.h>
+#include <iostream>
 
 namespace benchmark {
 namespace capnp_impl {
 
-// TODO: Implement Cap'n Proto server wrapper that implements common::IBenchmarkServer
-// Cap'n Proto uses capability-based security model
-// Reference: https://capnproto.org/cxxrpc.html
-
-// class CapnProtoBenchmarkServer : public common::IBenchmarkServer {
-// public:
-//   explicit CapnProtoBenchmarkServer(std::shared_ptr<common::IBenchmarkService> service);
-//   ~CapnProtoBenchmarkServer() override;
-//
-//   bool Start(const std::string& address) override;
-//   void Stop() override;
-//   bool IsRunning() const override;
-//   void Wait() override;
-//
-// private:
-//   capnp::EzRpcServer server_;
-//   std::shared_ptr<common::IBenchmarkService> service_;
-//   // ... other members
-// };
-
-// TODO: Implement Cap'n Proto service implementation that bridges to common::IBenchmarkService
-// class BenchmarkServiceImpl final : public BenchmarkService::Server {
-// public:
-//   explicit BenchmarkServiceImpl(std::shared_ptr<common::IBenchmarkService> service);
-//
-//   kj::Promise<void> echo(EchoContext context) override;
-//   kj::Promise<void> streamData(StreamDataContext context) override;
-//   // ... other RPC methods
-//
-// private:
-//   std::shared_ptr<common::IBenchmarkService> service_;
-// };
+namespace {
+
+// Writes out `queue` to `sink` and ends the stream with done(). If the
+// peer goes away first, the queue is closed so producers stop filling it.
+kj::Promise<void> SendAll(std::shared_ptr<ChunkQueue> queue,
+                          schema::DataChunkStream::Client sink) {
+  auto written = WriteChunks(queue, sink);
+  return written.then(
+      [sink = kj::mv(sink)]() mutable { return sink.doneRequest().send().ignoreResult(); },
+      [queue](kj::Exception&& exception) -> kj::Promise<void> {
+        queue->Close(FromException(exception), exception.getDescription().cStr());
+        return kj::mv(exception);
+      });
+}
+
+// Runs a unary method on the service and answers with its result, which
+// may arrive on any thread
+template<typename T, typename Context, typename Call>
+kj::Promise<void> Unary(Context context, Call call) {
+  auto reply = kj::newPromiseAndCrossThreadFulfiller<common::Result<T>>();
+  call(FulfillWith<T>(kj::mv(reply.fulfiller)));
+  return reply.promise.then([context](common::Result<T>&& result) mutable {
+    auto results = context.getResults();
+    ToStatus(result.error_code, result.error_message, results.initStatus());
+    if (result.ok()) ToCapnp(result.value, results.initResponse());
+  });
+}
+
+// Message-zoo echo: the request is read out of the params and the
+// service's answer written back, like any unary call
+template<typename T, typename Context>
+kj::Promise<void> ShapeEcho(common::IBenchmarkService* service, Context context) {
+  T request;
+  FromCapnp(context.getParams().getRequest(), &request);
+  context.releaseParams();
+  return Unary<T>(context, [service, &request](common::ResponseCallback<T> done) {
+    done(service->EchoShape(request));
+  });
+}
+
+// Echo of `request` by the service, settled on the event loop
+kj::Promise<common::Result<common::EchoResponse>> EchoOf(common::IBenchmarkService* service,
+                                                         const common::EchoRequest& request) {
+  auto reply = kj::newPromiseAndCrossThreadFulfiller<common::Result<common::EchoResponse>>();
+  service->EchoAsync(request, FulfillWith<common::EchoResponse>(kj::mv(reply.fulfiller)));
+  return kj::mv(reply.promise);
+}
+
+// One link of an echo chain. The link starts its echo as soon as the
+// previous one has answered, without waiting for the client to ask, so a
+// pipelined chain runs back to back on the server. `request_` holds the
+// link's timestamp and sequence number; its message comes from the
+// previous response.
+class EchoLink final : public schema::EchoLink::Server {
+public:
+  EchoLink(std::shared_ptr<common::IBenchmarkService> service, common::EchoRequest request,
+           kj::Promise<common::Result<common::EchoResponse>> echoed)
+    : service_(std::move(service)), request_(std::move(request)),
+      result_(echoed.fork()) {}
+
+  kj::Promise<void> next(NextContext context) override {
+    common::EchoRequest request = request_;
+    request.message.clear();
+    request.sequence_number++;
+    auto service = service_;
+    auto echoed = result_.addBranch().then(
+        [service, request](common::Result<common::EchoResponse>&& previous) mutable
+            -> kj::Promise<common::Result<common::EchoResponse>> {
+          if (!previous.ok()) return kj::mv(previous);
+          request.message = std::move(previous.value.message);
+          return EchoOf(service.get(), request);
+        });
+    context.getResults().setLink(kj::heap<EchoLink>(service_, kj::mv(request), kj::mv(echoed)));
+    return kj::READY_NOW;
+  }
+
+  kj::Promise<void> result(ResultContext context) override {
+    return result_.addBranch().then(
+        [context](common::Result<common::EchoResponse>&& echoed) mutable {
+          auto results = context.getResults();
+          ToStatus(echoed.error_code, echoed.error_message, results.initStatus());
+          if (echoed.ok()) ToCapnp(echoed.value, results.initResponse());
+        });
+  }
+
+private:
+  std::shared_ptr<common::IBenchmarkService> service_;
+  common::EchoRequest request_;
+  kj::ForkedPromise<common::Result<common::EchoResponse>> result_;
+};
+
+// Client half of an upload. Each chunk is read in place from the request
+// into one reused DataChunk for the service's sink; done() ends the stream
+// and answers with the service's response.
+class UploadInput final : public schema::UploadStream::Server {
+public:
+  explicit UploadInput(common::IBenchmarkService* service) {
+    auto reply = kj::newPromiseAndCrossThreadFulfiller<common::Result<common::UploadResponse>>();
+    result_ = kj::mv(reply.promise);
+    auto on_complete = FulfillWith<common::UploadResponse>(kj::mv(reply.fulfiller));
+    service->UploadData(sink_, on_complete);
+    if (!sink_) {
+      on_complete(common::Result<common::UploadResponse>(common::ErrorCode::INTERNAL,
+                                                         kNoClientStreams));
+    }
+  }
+
+  kj::Promise<void> write(WriteContext context) override {
+    if (sink_) {
+      FromCapnp(context.getParams().getChunk(), &chunk_);
+      sink_(chunk_);
+    }
+    return kj::READY_NOW;
+  }
+
+  kj::Promise<void> done(DoneContext context) override {
+    KJ_REQUIRE(!ended_, "upload stream already ended");
+    ended_ = true;
+    if (sink_) sink_(common::DataChunk());
+    return result_.then([context](common::Result<common::UploadResponse>&& result) mutable {
+      auto results = context.getResults();
+      ToStatus(result.error_code, result.error_message, results.initStatus());
+      if (result.ok()) ToCapnp(result.value, results.initResponse());
+    });
+  }
+
+private:
+  common::StreamCallback<common::DataChunk> sink_;
+  common::DataChunk chunk_;
+  kj::Promise<common::Result<common::UploadResponse>> result_ = nullptr;
+  bool ended_ = false;
+};
+
+// Client half of a bidirectional stream. Chunks go to the service's sink
+// as for an upload, and its replies drain to the client's `replies`
+// stream as they come. done() ends the client half and returns once the
+// replies are done too, with the service's status.
+class BidiInput final : public schema::DataChunkStream::Server {
+public:
+  BidiInput(common::IBenchmarkService* service, schema::DataChunkStream::Client replies)
+    : queue_(std::make_shared<ChunkQueue>()),
+      replies_(SendAll(queue_, kj::mv(replies)).fork()) {
+    service->BidirectionalStream(sink_, PushTo(queue_), CloseOf(queue_));
+    if (!sink_) queue_->Close(common::ErrorCode::INTERNAL, kNoClientStreams);
+  }
+
+  kj::Promise<void> write(WriteContext context) override {
+    if (sink_) {
+      FromCapnp(context.getParams().getChunk(), &chunk_);
+      sink_(chunk_);
+    }
+    return kj::READY_NOW;
+  }
+
+  kj::Promise<void> done(DoneContext context) override {
+    if (sink_) sink_(common::DataChunk());
+    auto queue = queue_;
+    return replies_.addBranch().then([queue, context]() mutable {
+      ToStatus(queue->code(), queue->message(), context.getResults().initStatus());
+    });
+  }
+
+private:
+  std::shared_ptr<ChunkQueue> queue_;
+  kj::ForkedPromise<void> replies_;
+  common::StreamCallback<common::DataChunk> sink_;
+  common::DataChunk chunk_;
+};
+
+class ServiceImpl final : public schema::BenchmarkService::Server {
+public:
+  explicit ServiceImpl(std::shared_ptr<common::IBenchmarkService> service)
+    : service_(std::move(service)) {}
+
+  kj::Promise<void> echo(EchoContext context) override {
+    common::EchoRequest request;
+    FromCapnp(context.getParams().getRequest(), &request);
+    context.releaseParams();
+    return Unary<common::EchoResponse>(
+        context, [this, &request](common::ResponseCallback<common::EchoResponse> done) {
+          service_->EchoAsync(request, std::move(done));
+        });
+  }
+
+  kj::Promise<void> streamData(StreamDataContext context) override {
+    auto params = context.getParams();
+    common::StreamRequest request;
+    FromCapnp(params.getRequest(), &request);
+    auto queue = std::make_shared<ChunkQueue>();
+    auto sent = SendAll(queue, params.getSink());
+    context.releaseParams();
+    service_->StreamData(request, PushTo(queue), CloseOf(queue));
+    return sent.then([queue, context]() mutable {
+      ToStatus(queue->code(), queue->message(), context.getResults().initStatus());
+    });
+  }
+
+  kj::Promise<void> uploadData(UploadDataContext context) override {
+    context.getResults().setStream(kj::heap<UploadInput>(service_.get()));
+    return kj::READY_NOW;
+  }
+
+  kj::Promise<void> bidirectionalStream(BidirectionalStreamContext context) override {
+    auto replies = context.getParams().getReplies();
+    context.releaseParams();
+    context.getResults().setStream(kj::heap<BidiInput>(service_.get(), kj::mv(replies)));
+    return kj::READY_NOW;
+  }
+
+  kj::Promise<void> batchProcess(BatchProcessContext context) override {
+    common::BatchRequest request;
+    FromCapnp(context.getParams().getRequest(), &request);
+    context.releaseParams();
+    return Unary<common::BatchResponse>(
+        context, [this, &request](common::ResponseCallback<common::BatchResponse> done) {
+          service_->BatchProcessAsync(request, std::move(done));
+        });
+  }
+
+  kj::Promise<void> echoChain(EchoChainContext context) override {
+    common::EchoRequest request;
+    FromCapnp(context.getParams().getRequest(), &request);
+    context.releaseParams();
+    auto result = EchoOf(service_.get(), request);
+    context.getResults().setLink(kj::heap<EchoLink>(service_, kj::mv(request), kj::mv(result)));
+    return kj::READY_NOW;
+  }
+
+  kj::Promise<void> echoNested(EchoNestedContext context) override {
+    return ShapeEcho<common::NestedMessage>(service_.get(), context);
+  }
+
+  kj::Promise<void> echoArrays(EchoArraysContext context) override {
+    return ShapeEcho<common::ArrayMessage>(service_.get(), context);
+  }
+
+  kj::Promise<void> echoMap(EchoMapContext context) override {
+    return ShapeEcho<common::MapMessage>(service_.get(), context);
+  }
+
+  kj::Promise<void> echoSparse(EchoSparseContext context) override {
+    return ShapeEcho<common::SparseMessage>(service_.get(), context);
+  }
+
+  kj::Promise<void> echoStrings(EchoStringsContext context) override {
+    return ShapeEcho<common::StringMessage>(service_.get(), context);
+  }
+
+private:
+  std::shared_ptr<common::IBenchmarkService> service_;
+};
+
+// One client connection, serving the bootstrap capability until the
+// client disconnects
+struct ServerConnection {
+  ServerConnection(kj::Own<kj::AsyncIoStream>&& connection, capnp::Capability::Client bootstrap)
+    : stream(kj::mv(connection)),
+      network(*stream, capnp::rpc::twoparty::Side::SERVER, UnlimitedReaderOptions()),
+      rpc(capnp::makeRpcServer(network, kj::mv(bootstrap))) {}
+
+  kj::Own<kj::AsyncIoStream> stream;
+  capnp::TwoPartyVatNetwork network;
+  capnp::RpcSystem<capnp::rpc::twoparty::VatId> rpc;
+};
+
+kj::Promise<void> AcceptLoop(kj::ConnectionReceiver& listener,
+                             schema::BenchmarkService::Client& bootstrap,
+                             kj::TaskSet& connections) {
+  return listener.accept().then(
+      [&listener, &bootstrap, &connections](kj::Own<kj::AsyncIoStream>&& stream) {
+        auto connection = kj::heap<ServerConnection>(kj::mv(stream), bootstrap);
+        auto disconnected = connection->network.onDisconnect();
+        connections.add(disconnected.attach(kj::mv(connection)));
+        return AcceptLoop(listener, bootstrap, connections);
+      });
+}
+
+} // namespace
+
+// CapnProtoServer implementation
+CapnProtoServer::~CapnProtoServer() {
+  Stop();
+}
+
+bool CapnProtoServer::Start(const std::string& address) {
+  if (running_) return false;
+
+  std::promise<bool> started;
+  auto listening = started.get_future();
+  thread_ = std::thread([this, address, &started] { Serve(address, &started); });
+  if (!listening.get()) {
+    thread_.join();
+    return false;
+  }
+
+  running_ = true;
+  return true;
+}
+
+void CapnProtoServer::Serve(const std::string& address, std::promise<bool>* started) {
+  kj::AsyncIoContext io = kj::setupAsyncIo();
+  kj::Own<kj::ConnectionReceiver> listener;
+  try {
+    auto network_address = io.provider->getNetwork().parseAddress(address).wait(io.waitScope);
+    listener = network_address->listen();
+  } catch (const kj::Exception& exception) {
+    std::cerr << "CapnProtoServer: cannot listen on " << address << ": "
+              << exception.getDescription().cStr() << std::endl;
+    started->set_value(false);
+    return;
+  }
+
+  auto stop = kj::newPromiseAndCrossThreadFulfiller<void>();
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = kj::mv(stop.fulfiller);
+  }
+
+  // Declared after the listener, so connections close before it does
+  schema::BenchmarkService::Client bootstrap = kj::heap<ServiceImpl>(service_);
+  TaskErrorLogger errors("CapnProtoServer");
+  kj::TaskSet connections(errors);
+  connections.add(AcceptLoop(*listener, bootstrap, connections));
+
+  started->set_value(true);
+  stop.promise.wait(io.waitScope);
+}
+
+void CapnProtoServer::Stop() {
+  if (!running_.exchange(false)) return;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_->fulfill();
+    stop_ = nullptr;
+  }
+  thread_.join();
+  std::lock_guard<std::mutex> lock(wait_mutex_);
+  wait_cv_.notify_all();
+}
+
+bool CapnProtoServer::IsRunning() const {
+  return running_;
+}
+
+void CapnProtoServer::Wait() {
+  std::unique_lock<std::mutex> lock(wait_mutex_);
+  wait_cv_.wait(lock, [this] { return !running_; });
+}
+
+// CapnProtoFactory implementation
+std::unique_ptr<common::IBenchmarkClient> CapnProtoFactory::CreateClient() {
+  return std::make_unique<CapnProtoClient>();
+}
+
+std::unique_ptr<common::IBenchmarkServer> CapnProtoFactory::CreateServer(
+    std::shared_ptr<common::IBenchmarkService> service) {
+  return std::make_unique<CapnProtoServer>(std::move(service));
+}
+
+std::unique_ptr<common::IFrameworkFactory> CreateCapnProtoFactory() {
+  return std::make_unique<CapnProtoFactory>();
+}
 
 } // namespace capnp_impl
 } // namespace benchmark
@@ -0,0 +1,422 @@
+#include "capnproto_support.h"
+#include <iostream>
+#include <limits>
+
+namespace benchmark {
+namespace capnp_impl {
+
+const char* const kNoClientStreams = "Service does not accept client streams";
+
+namespace {
+
+capnp::Data::Reader Bytes(const std::vector<uint8_t>& data) {
+  return capnp::Data::Reader(data.data(), data.size());
+}
+
+capnp::Text::Reader Text(const std::string& text) {
+  return capnp::Text::Reader(text.c_str(), text.size());
+}
+
+// In place: the vector keeps its capacity from the previous chunk
+void AssignBytes(capnp::Data::Reader from, std::vector<uint8_t>* to) {
+  to->assign(from.begin(), from.end());
+}
+
+void AssignText(capnp::Text::Reader from, std::string* to) {
+  to->assign(from.cStr(), from.size());
+}
+
+void TreeToCapnp(const common::TreeNode& from, schema::TreeNode::Builder to) {
+  to.setId(from.id);
+  to.setWeight(from.weight);
+  to.setLabel(Text(from.label));
+  auto children = to.initChildren(static_cast<unsigned int>(from.children.size()));
+  for (unsigned int i = 0; i < children.size(); ++i) TreeToCapnp(from.children[i], children[i]);
+}
+
+void TreeFromCapnp(schema::TreeNode::Reader from, common::TreeNode* to) {
+  to->id = from.getId();
+  to->weight = from.getWeight();
+  AssignText(from.getLabel(), &to->label);
+  auto children = from.getChildren();
+  to->children.resize(children.size());
+  for (unsigned int i = 0; i < children.size(); ++i) TreeFromCapnp(children[i], &to->children[i]);
+}
+
+void SparseRecordToCapnp(const common::SparseRecord& from, schema::SparseRecord::Builder to) {
+  uint32_t present = 0;
+  for (size_t i = 0; i < common::SparseRecord::kIntFields; i++) {
+    if (from.ints[i]) present |= 1u << i;
+  }
+  for (size_t i = 0; i < common::SparseRecord::kDoubleFields; i++) {
+    if (from.doubles[i]) present |= 1u << (kSparseDoubleBit + i);
+  }
+  for (size_t i = 0; i < common::SparseRecord::kTextFields; i++) {
+    if (from.texts[i]) present |= 1u << (kSparseTextBit + i);
+  }
+  to.setPresent(present);
+  if (from.ints[0]) to.setInt0(*from.ints[0]);
+  if (from.ints[1]) to.setInt1(*from.ints[1]);
+  if (from.ints[2]) to.setInt2(*from.ints[2]);
+  if (from.ints[3]) to.setInt3(*from.ints[3]);
+  if (from.ints[4]) to.setInt4(*from.ints[4]);
+  if (from.ints[5]) to.setInt5(*from.ints[5]);
+  if (from.ints[6]) to.setInt6(*from.ints[6]);
+  if (from.ints[7]) to.setInt7(*from.ints[7]);
+  if (from.ints[8]) to.setInt8(*from.ints[8]);
+  if (from.ints[9]) to.setInt9(*from.ints[9]);
+  if (from.ints[10]) to.setInt10(*from.ints[10]);
+  if (from.ints[11]) to.setInt11(*from.ints[11]);
+  if (from.ints[12]) to.setInt12(*from.ints[12]);
+  if (from.ints[13]) to.setInt13(*from.ints[13]);
+  if (from.ints[14]) to.setInt14(*from.ints[14]);
+  if (from.ints[15]) to.setInt15(*from.ints[15]);
+  if (from.doubles[0]) to.setDouble0(*from.doubles[0]);
+  if (from.doubles[1]) to.setDouble1(*from.doubles[1]);
+  if (from.doubles[2]) to.setDouble2(*from.doubles[2]);
+  if (from.doubles[3]) to.setDouble3(*from.doubles[3]);
+  if (from.doubles[4]) to.setDouble4(*from.doubles[4]);
+  if (from.doubles[5]) to.setDouble5(*from.doubles[5]);
+  if (from.doubles[6]) to.setDouble6(*from.doubles[6]);
+  if (from.doubles[7]) to.setDouble7(*from.doubles[7]);
+  if (from.texts[0]) to.setText0(Text(*from.texts[0]));
+  if (from.texts[1]) to.setText1(Text(*from.texts[1]));
+  if (from.texts[2]) to.setText2(Text(*from.texts[2]));
+  if (from.texts[3]) to.setText3(Text(*from.texts[3]));
+  if (from.texts[4]) to.setText4(Text(*from.texts[4]));
+  if (from.texts[5]) to.setText5(Text(*from.texts[5]));
+  if (from.texts[6]) to.setText6(Text(*from.texts[6]));
+  if (from.texts[7]) to.setText7(Text(*from.texts[7]));
+}
+
+} // namespace
+
+capnp::ReaderOptions UnlimitedReaderOptions() {
+  capnp::ReaderOptions options;
+  options.traversalLimitInWords = std::numeric_limits<uint64_t>::max();
+  return options;
+}
+
+void ToCapnp(const common::EchoRequest& from, schema::EchoRequest::Builder to) {
+  to.setMessage(Text(from.message));
+  to.setTimestamp(from.timestamp);
+  to.setSequenceNumber(from.sequence_number);
+}
+
+void ToCapnp(const common::EchoResponse& from, schema::EchoResponse::Builder to) {
+  to.setMessage(Text(from.message));
+  to.setClientTimestamp(from.client_timestamp);
+  to.setServerTimestamp(from.server_timestamp);
+  to.setSequenceNumber(from.sequence_number);
+}
+
+void ToCapnp(const common::StreamRequest& from, schema::StreamRequest::Builder to) {
+  to.setChunkSize(from.chunk_size);
+  to.setChunkCount(from.chunk_count);
+  to.setDelayMs(from.delay_ms);
+}
+
+void ToCapnp(const common::DataChunk& from, schema::DataChunk::Builder to) {
+  to.setSequenceNumber(from.sequence_number);
+  to.setData(Bytes(from.data));
+  to.setChecksum(from.checksum);
+  to.setTimestamp(from.timestamp);
+}
+
+void ToCapnp(const common::UploadResponse& from, schema::UploadResponse::Builder to) {
+  to.setTotalBytes(from.total_bytes);
+  to.setChunkCount(from.chunk_count);
+  to.setDurationNs(from.duration_ns);
+  to.setChecksumValid(from.checksum_valid);
+}
+
+void ToCapnp(const common::BatchRequest& from, schema::BatchRequest::Builder to) {
+  auto items = to.initItems(static_cast<unsigned int>(from.items.size()));
+  for (unsigned int i = 0; i < items.size(); ++i) {
+    const common::BatchItem& item = from.items[i];
+    items[i].setId(Text(item.id));
+    items[i].setOperation(Text(item.operation));
+    items[i].setData(Bytes(item.data));
+  }
+  to.setFailOnError(from.fail_on_error);
+}
+
+void ToCapnp(const common::BatchResponse& from, schema::BatchResponse::Builder to) {
+  auto results = to.initResults(static_cast<unsigned int>(from.results.size()));
+  for (unsigned int i = 0; i < results.size(); ++i) {
+    const common::BatchResult& result = from.results[i];
+    results[i].setId(Text(result.id));
+    results[i].setSuccess(result.success);
+    results[i].setErrorMessage(Text(result.error_message));
+    results[i].setResultData(Bytes(result.result_data));
+  }
+  to.setTotalProcessed(from.total_processed);
+  to.setTotalFailed(from.total_failed);
+}
+
+void ToCapnp(const common::NestedMessage& from, schema::NestedMessage::Builder to) {
+  TreeToCapnp(from.root, to.initRoot());
+}
+
+void ToCapnp(const common::ArrayMessage& from, schema::ArrayMessage::Builder to) {
+  auto values = to.initValues(static_cast<unsigned int>(from.values.size()));
+  for (unsigned int i = 0; i < values.size(); ++i) values.set(i, from.values[i]);
+  auto samples = to.initSamples(static_cast<unsigned int>(from.samples.size()));
+  for (unsigned int i = 0; i < samples.size(); ++i) samples.set(i, from.samples[i]);
+  auto counts = to.initCounts(static_cast<unsigned int>(from.counts.size()));
+  for (unsigned int i = 0; i < counts.size(); ++i) counts.set(i, from.counts[i]);
+}
+
+void ToCapnp(const common::MapMessage& from, schema::MapMessage::Builder to) {
+  auto counters = to.initCounters(static_cast<unsigned int>(from.counters.size()));
+  unsigned int index = 0;
+  for (const auto& entry : from.counters) {
+    counters[index].setKey(Text(entry.first));
+    counters[index].setValue(entry.second);
+    ++index;
+  }
+  auto labels = to.initLabels(static_cast<unsigned int>(from.labels.size()));
+  index = 0;
+  for (const auto& entry : from.labels) {
+    labels[index].setKey(entry.first);
+    labels[index].setValue(Text(entry.second));
+    ++index;
+  }
+}
+
+void ToCapnp(const common::SparseMessage& from, schema::SparseMessage::Builder to) {
+  auto records = to.initRecords(static_cast<unsigned int>(from.records.size()));
+  for (unsigned int i = 0; i < records.size(); ++i) {
+    SparseRecordToCapnp(from.records[i], records[i]);
+  }
+}
+
+void ToCapnp(const common::StringMessage& from, schema::StringMessage::Builder to) {
+  auto records = to.initRecords(static_cast<unsigned int>(from.records.size()));
+  for (unsigned int i = 0; i < records.size(); ++i) {
+    const common::StringRecord& record = from.records[i];
+    records[i].setName(Text(record.name));
+    records[i].setEmail(Text(record.email));
+    records[i].setCity(Text(record.city));
+    records[i].setNote(Text(record.note));
+    auto tags = records[i].initTags(static_cast<unsigned int>(record.tags.size()));
+    for (unsigned int t = 0; t < tags.size(); ++t) tags.set(t, Text(record.tags[t]));
+  }
+}
+
+void FromCapnp(schema::EchoRequest::Reader from, common::EchoRequest* to) {
+  AssignText(from.getMessage(), &to->message);
+  to->timestamp = from.getTimestamp();
+  to->sequence_number = from.getSequenceNumber();
+}
+
+void FromCapnp(schema::EchoResponse::Reader from, common::EchoResponse* to) {
+  AssignText(from.getMessage(), &to->message);
+  to->client_timestamp = from.getClientTimestamp();
+  to->server_timestamp = from.getServerTimestamp();
+  to->sequence_number = from.getSequenceNumber();
+}
+
+void FromCapnp(schema::StreamRequest::Reader from, common::StreamRequest* to) {
+  to->chunk_size = from.getChunkSize();
+  to->chunk_count = from.getChunkCount();
+  to->delay_ms = from.getDelayMs();
+}
+
+void FromCapnp(schema::DataChunk::Reader from, common::DataChunk* to) {
+  to->sequence_number = from.getSequenceNumber();
+  AssignBytes(from.getData(), &to->data);
+  to->checksum = from.getChecksum();
+  to->timestamp = from.getTimestamp();
+}
+
+void FromCapnp(schema::UploadResponse::Reader from, common::UploadResponse* to) {
+  to->total_bytes = from.getTotalBytes();
+  to->chunk_count = from.getChunkCount();
+  to->duration_ns = from.getDurationNs();
+  to->checksum_valid = from.getChecksumValid();
+}
+
+void FromCapnp(schema::BatchRequest::Reader from, common::BatchRequest* to) {
+  auto items = from.getItems();
+  to->items.resize(items.size());
+  for (unsigned int i = 0; i < items.size(); ++i) {
+    common::BatchItem& item = to->items[i];
+    AssignText(items[i].getId(), &item.id);
+    AssignText(items[i].getOperation(), &item.operation);
+    AssignBytes(items[i].getData(), &item.data);
+  }
+  to->fail_on_error = from.getFailOnError();
+}
+
+void FromCapnp(schema::BatchResponse::Reader from, common::BatchResponse* to) {
+  auto results = from.getResults();
+  to->results.resize(results.size());
+  for (unsigned int i = 0; i < results.size(); ++i) {
+    common::BatchResult& result = to->results[i];
+    AssignText(results[i].getId(), &result.id);
+    result.success = results[i].getSuccess();
+    AssignText(results[i].getErrorMessage(), &result.error_message);
+    AssignBytes(results[i].getResultData(), &result.result_data);
+  }
+  to->total_processed = from.getTotalProcessed();
+  to->total_failed = from.getTotalFailed();
+}
+
+void FromCapnp(schema::NestedMessage::Reader from, common::NestedMessage* to) {
+  TreeFromCapnp(from.getRoot(), &to->root);
+}
+
+void FromCapnp(schema::ArrayMessage::Reader from, common::ArrayMessage* to) {
+  auto values = from.getValues();
+  to->values.assign(values.begin(), values.end());
+  auto samples = from.getSamples();
+  to->samples.assign(samples.begin(), samples.end());
+  auto counts = from.getCounts();
+  to->counts.assign(counts.begin(), counts.end());
+}
+
+// Entries arrive in key order, so each insert goes at the end
+void FromCapnp(schema::MapMessage::Reader from, common::MapMessage* to) {
+  to->counters.clear();
+  for (auto entry : from.getCounters()) {
+    auto key = entry.getKey();
+    to->counters.emplace_hint(to->counters.end(), std::string(key.cStr(), key.size()),
+                              entry.getValue());
+  }
+  to->labels.clear();
+  for (auto entry : from.getLabels()) {
+    auto value = entry.getValue();
+    to->labels.emplace_hint(to->labels.end(), entry.getKey(),
+                            std::string(value.cStr(), value.size()));
+  }
+}
+
+void FromCapnp(schema::SparseMessage::Reader from, common::SparseMessage* to) {
+  auto records = from.getRecords();
+  to->records.resize(records.size());
+  for (unsigned int i = 0; i < records.size(); ++i) {
+    common::SparseRecord& record = to->records[i];
+    record = common::SparseRecord();
+    ForEachSetField(
+        records[i],
+        [&record](size_t index, int64_t value) { record.ints[index] = value; },
+        [&record](size_t index, double value) { record.doubles[index] = value; },
+        [&record](size_t index, capnp::Text::Reader value) {
+          record.texts[index].emplace(value.cStr(), value.size());
+        });
+  }
+}
+
+void FromCapnp(schema::StringMessage::Reader from, common::StringMessage* to) {
+  auto records = from.getRecords();
+  to->records.resize(records.size());
+  for (unsigned int i = 0; i < records.size(); ++i) {
+    common::StringRecord& record = to->records[i];
+    AssignText(records[i].getName(), &record.name);
+    AssignText(records[i].getEmail(), &record.email);
+    AssignText(records[i].getCity(), &record.city);
+    AssignText(records[i].getNote(), &record.note);
+    auto tags = records[i].getTags();
+    record.tags.resize(tags.size());
+    for (unsigned int t = 0; t < tags.size(); ++t) AssignText(tags[t], &record.tags[t]);
+  }
+}
+
+void ToStatus(common::ErrorCode code, const std::string& message, schema::Status::Builder to) {
+  to.setCode(static_cast<uint8_t>(code));
+  if (code != common::ErrorCode::OK) to.setMessage(Text(message));
+}
+
+common::ErrorCode FromStatusCode(uint8_t code) {
+  if (code > static_cast<uint8_t>(common::ErrorCode::UNAVAILABLE)) {
+    return common::ErrorCode::INTERNAL;
+  }
+  return static_cast<common::ErrorCode>(code);
+}
+
+common::ErrorCode FromException(const kj::Exception& exception) {
+  switch (exception.getType()) {
+    case kj::Exception::Type::DISCONNECTED:
+    case kj::Exception::Type::OVERLOADED:
+      return common::ErrorCode::UNAVAILABLE;
+    case kj::Exception::Type::UNIMPLEMENTED:
+      return common::ErrorCode::NOT_FOUND;
+    default:
+      return common::ErrorCode::INTERNAL;
+  }
+}
+
+// ChunkQueue implementation
+void ChunkQueue::Push(const common::DataChunk& chunk) {
+  kj::Own<kj::CrossThreadPromiseFulfiller<void>> waiter;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (closed_) return;
+    pending_.push_back(chunk);
+    waiter = kj::mv(waiter_);
+  }
+  if (waiter.get() != nullptr) waiter->fulfill();
+}
+
+void ChunkQueue::Close(common::ErrorCode code, const std::string& message) {
+  kj::Own<kj::CrossThreadPromiseFulfiller<void>> waiter;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (closed_) return;
+    closed_ = true;
+    code_ = code;
+    message_ = message;
+    waiter = kj::mv(waiter_);
+  }
+  if (waiter.get() != nullptr) waiter->fulfill();
+}
+
+bool ChunkQueue::Pop(common::DataChunk* chunk) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (pending_.empty()) return false;
+  *chunk = std::move(pending_.front());
+  pending_.pop_front();
+  return true;
+}
+
+bool ChunkQueue::Drained() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return closed_ && pending_.empty();
+}
+
+kj::Promise<void> ChunkQueue::Ready() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (closed_ || !pending_.empty()) return kj::READY_NOW;
+  auto ready = kj::newPromiseAndCrossThreadFulfiller<void>();
+  waiter_ = kj::mv(ready.fulfiller);
+  return kj::mv(ready.promise);
+}
+
+common::ErrorCode ChunkQueue::code() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return code_;
+}
+
+std::string ChunkQueue::message() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return message_;
+}
+
+common::StreamCallback<common::DataChunk> PushTo(std::shared_ptr<ChunkQueue> queue) {
+  return [queue](const common::DataChunk& chunk) { queue->Push(chunk); };
+}
+
+common::CompletionCallback CloseOf(std::shared_ptr<ChunkQueue> queue) {
+  return [queue](common::ErrorCode code, const std::string& message) {
+    queue->Close(code, message);
+  };
+}
+
+void TaskErrorLogger::taskFailed(kj::Exception&& exception) {
+  if (exception.getType() == kj::Exception::Type::DISCONNECTED) return;
+  std::cerr << owner_ << ": " << exception.getDescription().cStr() << std::endl;
+}
+
+} // namespace capnp_impl
+} // namespace benchmark
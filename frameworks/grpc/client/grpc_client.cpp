@@ -1,34 +1,458 @@
-// gRPC client implementation
-// This file will contain the gRPC-specific implementation of IBenchmarkClient
+// gRPC client: the common service over the generated stub
 
-#include "benchmark_service.h"
-#include "benchmark_types.h"
-
-// TODO: Include generated gRPC headers
-// #include "benchmark.grpc.pb.h"
+#include "grpc_framework.h"
+#include "grpc_wire.h"
+#include <chrono>
+#include <future>
+#include <iostream>
 
 namespace benchmark {
 namespace grpc_impl {
 
-// TODO: Implement gRPC client wrapper that implements common::IBenchmarkClient
-// class GrpcBenchmarkClient : public common::IBenchmarkClient {
-// public:
-//   GrpcBenchmarkClient();
-//   ~GrpcBenchmarkClient() override;
-//
-//   common::IBenchmarkService* GetService() override;
-//   bool Connect(const std::string& address) override;
-//   void Disconnect() override;
-//   bool IsConnected() const override;
-//
-// private:
-//   std::unique_ptr<::benchmark::BenchmarkService::Stub> stub_;
-//   std::shared_ptr<grpc::Channel> channel_;
-//   // ... other members
-// };
-
-// TODO: Implement gRPC service adapter that implements common::IBenchmarkService
-// This will translate between common types and gRPC generated types
+namespace {
+
+constexpr auto kConnectTimeout = std::chrono::seconds(5);
+
+const char* const kEchoMethod = "/benchmark.BenchmarkService/Echo";
+const char* const kBatchProcessMethod = "/benchmark.BenchmarkService/BatchProcess";
+
+// Where a call's generated messages live
+template<typename Request, typename Response>
+struct HeapMessages {
+  Request request_storage;
+  Response response_storage;
+  Request* request = &request_storage;
+  Response* response = &response_storage;
+};
+
+template<typename Request, typename Response>
+struct ArenaMessages {
+  CallArena arena;
+  Request* request = google::protobuf::Arena::CreateMessage<Request>(arena.get());
+  Response* response = google::protobuf::Arena::CreateMessage<Response>(arena.get());
+};
+
+// A unary call on the callback API, freed once it completes. `start`
+// issues the call on the generated stub.
+template<typename Messages, typename T, typename CommonRequest, typename Start>
+void CallUnary(const CommonRequest& request, common::ResponseCallback<T> callback, Start start) {
+  struct Call {
+    grpc::ClientContext context;
+    Messages messages;
+    common::ResponseCallback<T> callback;
+  };
+  auto* call = new Call();
+  ToProto(request, call->messages.request);
+  call->callback = std::move(callback);
+  start(&call->context, call->messages.request, call->messages.response,
+        [call](grpc::Status status) {
+          call->callback(ToResult<T>(status, *call->messages.response));
+          delete call;
+        });
+}
+
+// The same through the generic stub, with the request pre-serialized
+template<typename T, typename CommonRequest>
+void CallRaw(grpc::GenericStub* stub, const char* method, const CommonRequest& request,
+             common::ResponseCallback<T> callback) {
+  struct Call {
+    grpc::ClientContext context;
+    grpc::ByteBuffer request;
+    grpc::ByteBuffer response;
+    common::ResponseCallback<T> callback;
+  };
+  auto* call = new Call();
+  Encode(request, &call->request);
+  call->callback = std::move(callback);
+  stub->UnaryCall(&call->context, method, grpc::StubOptions(), &call->request, &call->response,
+                  [call](grpc::Status status) {
+                    call->callback(DecodeResult<T>(status, call->response));
+                    delete call;
+                  });
+}
+
+// Blocking call through the generated stub, messages on `Messages`
+template<typename Messages, typename T, typename CommonRequest, typename Call>
+common::Result<T> CallBlocking(const CommonRequest& request, Call call) {
+  Messages messages;
+  ToProto(request, messages.request);
+  grpc::ClientContext context;
+  grpc::Status status = call(&context, *messages.request, messages.response);
+  return ToResult<T>(status, *messages.response);
+}
+
+// The generic stub has no blocking unary call
+template<typename T, typename CommonRequest>
+common::Result<T> CallRawBlocking(grpc::GenericStub* stub, const char* method,
+                                  const CommonRequest& request) {
+  std::promise<common::Result<T>> done;
+  CallRaw<T>(stub, method, request,
+             [&done](const common::Result<T>& result) { done.set_value(result); });
+  return done.get_future().get();
+}
+
+// Message-zoo echo through the generated stub. kRaw has no hand-written
+// encoding of the shapes, so it sends them as kProto does.
+template<typename T, typename Proto, typename Call>
+common::Result<T> CallShape(GrpcCodec codec, const T& request, Call call) {
+  if (codec == GrpcCodec::kArena) {
+    return CallBlocking<ArenaMessages<Proto, Proto>, T>(request, call);
+  }
+  return CallBlocking<HeapMessages<Proto, Proto>, T>(request, call);
+}
+
+// Caller-side provider for a client stream: chunks go to the queue, and
+// the closing empty chunk closes it
+common::StreamCallback<common::DataChunk> ProviderFor(std::shared_ptr<ChunkWriteQueue> writes) {
+  return [writes](const common::DataChunk& chunk) {
+    if (chunk.data.empty()) {
+      writes->Close(grpc::Status::OK);
+    } else {
+      writes->Push(chunk);
+    }
+  };
+}
+
+class StreamDataReactor : public grpc::ClientReadReactor<::benchmark::DataChunk> {
+public:
+  StreamDataReactor(::benchmark::BenchmarkService::Stub* stub, const common::StreamRequest& request,
+                    common::StreamCallback<common::DataChunk> on_chunk,
+                    common::CompletionCallback on_complete)
+    : on_chunk_(std::move(on_chunk)), on_complete_(std::move(on_complete)) {
+    ToProto(request, &request_);
+    stub->async()->StreamData(&context_, &request_, this);
+    StartRead(&in_);
+    StartCall();
+  }
+
+  void OnReadDone(bool ok) override {
+    if (!ok) return;  // The stream ended; OnDone follows
+    FromProto(in_, &chunk_);
+    on_chunk_(chunk_);
+    StartRead(&in_);
+  }
+
+  void OnDone(const grpc::Status& status) override {
+    on_complete_(FromStatusCode(status.error_code()), status.error_message());
+    delete this;
+  }
+
+private:
+  grpc::ClientContext context_;
+  ::benchmark::StreamRequest request_;
+  ::benchmark::DataChunk in_;
+  common::DataChunk chunk_;
+  common::StreamCallback<common::DataChunk> on_chunk_;
+  common::CompletionCallback on_complete_;
+};
+
+// The client streams below hold the call open until the caller's closing
+// chunk has been written, however long the caller takes to send it
+class UploadDataReactor : public grpc::ClientWriteReactor<::benchmark::DataChunk> {
+public:
+  UploadDataReactor(::benchmark::BenchmarkService::Stub* stub,
+                    common::ResponseCallback<common::UploadResponse> on_complete)
+    : on_complete_(std::move(on_complete)),
+      writes_(std::make_shared<ChunkWriteQueue>(
+          [this](const ::benchmark::DataChunk* chunk) { StartWrite(chunk); },
+          [this](const grpc::Status& status) {
+            if (status.ok()) StartWritesDone();
+            RemoveHold();
+          })) {
+    stub->async()->UploadData(&context_, &response_, this);
+    AddHold();
+    StartCall();
+  }
+
+  std::shared_ptr<ChunkWriteQueue> writes() const { return writes_; }
+
+  void OnWriteDone(bool ok) override { writes_->WriteDone(ok); }
+
+  void OnDone(const grpc::Status& status) override {
+    on_complete_(ToResult<common::UploadResponse>(status, response_));
+    delete this;
+  }
+
+private:
+  grpc::ClientContext context_;
+  ::benchmark::UploadResponse response_;
+  common::ResponseCallback<common::UploadResponse> on_complete_;
+  std::shared_ptr<ChunkWriteQueue> writes_;
+};
+
+class BidiReactor
+    : public grpc::ClientBidiReactor<::benchmark::DataChunk, ::benchmark::DataChunk> {
+public:
+  BidiReactor(::benchmark::BenchmarkService::Stub* stub,
+              common::StreamCallback<common::DataChunk> on_chunk,
+              common::CompletionCallback on_complete)
+    : on_chunk_(std::move(on_chunk)), on_complete_(std::move(on_complete)),
+      writes_(std::make_shared<ChunkWriteQueue>(
+          [this](const ::benchmark::DataChunk* chunk) { StartWrite(chunk); },
+          [this](const grpc::Status& status) {
+            if (status.ok()) StartWritesDone();
+            RemoveHold();
+          })) {
+    stub->async()->BidirectionalStream(&context_, this);
+    AddHold();
+    StartRead(&in_);
+    StartCall();
+  }
+
+  std::shared_ptr<ChunkWriteQueue> writes() const { return writes_; }
+
+  void OnReadDone(bool ok) override {
+    if (!ok) return;
+    FromProto(in_, &chunk_);
+    on_chunk_(chunk_);
+    StartRead(&in_);
+  }
+
+  void OnWriteDone(bool ok) override { writes_->WriteDone(ok); }
+
+  void OnDone(const grpc::Status& status) override {
+    on_complete_(FromStatusCode(status.error_code()), status.error_message());
+    delete this;
+  }
+
+private:
+  grpc::ClientContext context_;
+  ::benchmark::DataChunk in_;
+  common::DataChunk chunk_;
+  common::StreamCallback<common::DataChunk> on_chunk_;
+  common::CompletionCallback on_complete_;
+  std::shared_ptr<ChunkWriteQueue> writes_;
+};
+
+} // namespace
+
+// GrpcServiceStub implementation
+GrpcServiceStub::GrpcServiceStub(const std::vector<std::shared_ptr<grpc::Channel>>& channels,
+                                 GrpcCodec codec)
+  : codec_(codec) {
+  for (const auto& channel : channels) {
+    PooledChannel pooled;
+    pooled.channel = channel;
+    pooled.stub = ::benchmark::BenchmarkService::NewStub(channel);
+    if (codec_ == GrpcCodec::kRaw) pooled.generic = std::make_unique<grpc::GenericStub>(channel);
+    channels_.push_back(std::move(pooled));
+  }
+}
+
+GrpcServiceStub::PooledChannel& GrpcServiceStub::Pick() {
+  if (channels_.size() == 1) return channels_[0];
+  static std::atomic<size_t> next_thread{0};
+  thread_local size_t thread_index = next_thread.fetch_add(1, std::memory_order_relaxed);
+  return channels_[thread_index % channels_.size()];
+}
+
+common::Result<common::EchoResponse> GrpcServiceStub::Echo(const common::EchoRequest& request) {
+  using Request = ::benchmark::EchoRequest;
+  using Response = ::benchmark::EchoResponse;
+  PooledChannel& pooled = Pick();
+  auto call = [&pooled](grpc::ClientContext* context, const Request& proto_request,
+                        Response* proto_response) {
+    return pooled.stub->Echo(context, proto_request, proto_response);
+  };
+  switch (codec_) {
+    case GrpcCodec::kArena:
+      return CallBlocking<ArenaMessages<Request, Response>, common::EchoResponse>(request, call);
+    case GrpcCodec::kRaw:
+      return CallRawBlocking<common::EchoResponse>(pooled.generic.get(), kEchoMethod, request);
+    case GrpcCodec::kProto:
+      break;
+  }
+  return CallBlocking<HeapMessages<Request, Response>, common::EchoResponse>(request, call);
+}
+
+void GrpcServiceStub::EchoAsync(
+    const common::EchoRequest& request,
+    common::ResponseCallback<common::EchoResponse> callback) {
+  using Request = ::benchmark::EchoRequest;
+  using Response = ::benchmark::EchoResponse;
+  PooledChannel& pooled = Pick();
+  auto start = [&pooled](grpc::ClientContext* context, const Request* proto_request,
+                         Response* proto_response, std::function<void(grpc::Status)> done) {
+    pooled.stub->async()->Echo(context, proto_request, proto_response, std::move(done));
+  };
+  switch (codec_) {
+    case GrpcCodec::kArena:
+      CallUnary<ArenaMessages<Request, Response>>(request, std::move(callback), start);
+      return;
+    case GrpcCodec::kRaw:
+      CallRaw<common::EchoResponse>(pooled.generic.get(), kEchoMethod, request,
+                                    std::move(callback));
+      return;
+    case GrpcCodec::kProto:
+      break;
+  }
+  CallUnary<HeapMessages<Request, Response>>(request, std::move(callback), start);
+}
+
+void GrpcServiceStub::StreamData(
+    const common::StreamRequest& request,
+    common::StreamCallback<common::DataChunk> on_chunk,
+    common::CompletionCallback on_complete) {
+  new StreamDataReactor(Pick().stub.get(), request, std::move(on_chunk), std::move(on_complete));
+}
+
+void GrpcServiceStub::UploadData(
+    common::StreamCallback<common::DataChunk>& chunk_provider,
+    common::ResponseCallback<common::UploadResponse> on_complete) {
+  auto* reactor = new UploadDataReactor(Pick().stub.get(), std::move(on_complete));
+  chunk_provider = ProviderFor(reactor->writes());
+}
+
+void GrpcServiceStub::BidirectionalStream(
+    common::StreamCallback<common::DataChunk>& chunk_provider,
+    common::StreamCallback<common::DataChunk> on_chunk,
+    common::CompletionCallback on_complete) {
+  auto* reactor = new BidiReactor(Pick().stub.get(), std::move(on_chunk), std::move(on_complete));
+  chunk_provider = ProviderFor(reactor->writes());
+}
+
+common::Result<common::BatchResponse> GrpcServiceStub::BatchProcess(
+    const common::BatchRequest& request) {
+  using Request = ::benchmark::BatchRequest;
+  using Response = ::benchmark::BatchResponse;
+  PooledChannel& pooled = Pick();
+  auto call = [&pooled](grpc::ClientContext* context, const Request& proto_request,
+                        Response* proto_response) {
+    return pooled.stub->BatchProcess(context, proto_request, proto_response);
+  };
+  switch (codec_) {
+    case GrpcCodec::kArena:
+      return CallBlocking<ArenaMessages<Request, Response>, common::BatchResponse>(request, call);
+    case GrpcCodec::kRaw:
+      return CallRawBlocking<common::BatchResponse>(pooled.generic.get(), kBatchProcessMethod,
+                                                    request);
+    case GrpcCodec::kProto:
+      break;
+  }
+  return CallBlocking<HeapMessages<Request, Response>, common::BatchResponse>(request, call);
+}
+
+void GrpcServiceStub::BatchProcessAsync(
+    const common::BatchRequest& request,
+    common::ResponseCallback<common::BatchResponse> callback) {
+  using Request = ::benchmark::BatchRequest;
+  using Response = ::benchmark::BatchResponse;
+  PooledChannel& pooled = Pick();
+  auto start = [&pooled](grpc::ClientContext* context, const Request* proto_request,
+                         Response* proto_response, std::function<void(grpc::Status)> done) {
+    pooled.stub->async()->BatchProcess(context, proto_request, proto_response, std::move(done));
+  };
+  switch (codec_) {
+    case GrpcCodec::kArena:
+      CallUnary<ArenaMessages<Request, Response>>(request, std::move(callback), start);
+      return;
+    case GrpcCodec::kRaw:
+      CallRaw<common::BatchResponse>(pooled.generic.get(), kBatchProcessMethod, request,
+                                     std::move(callback));
+      return;
+    case GrpcCodec::kProto:
+      break;
+  }
+  CallUnary<HeapMessages<Request, Response>>(request, std::move(callback), start);
+}
+
+common::Result<common::NestedMessage> GrpcServiceStub::EchoShape(
+    const common::NestedMessage& request) {
+  PooledChannel& pooled = Pick();
+  return CallShape<common::NestedMessage, ::benchmark::NestedMessage>(
+      codec_, request,
+      [&pooled](grpc::ClientContext* context, const ::benchmark::NestedMessage& proto_request,
+                ::benchmark::NestedMessage* proto_response) {
+        return pooled.stub->EchoNested(context, proto_request, proto_response);
+      });
+}
+
+common::Result<common::ArrayMessage> GrpcServiceStub::EchoShape(
+    const common::ArrayMessage& request) {
+  PooledChannel& pooled = Pick();
+  return CallShape<common::ArrayMessage, ::benchmark::ArrayMessage>(
+      codec_, request,
+      [&pooled](grpc::ClientContext* context, const ::benchmark::ArrayMessage& proto_request,
+                ::benchmark::ArrayMessage* proto_response) {
+        return pooled.stub->EchoArrays(context, proto_request, proto_response);
+      });
+}
+
+common::Result<common::MapMessage> GrpcServiceStub::EchoShape(
+    const common::MapMessage& request) {
+  PooledChannel& pooled = Pick();
+  return CallShape<common::MapMessage, ::benchmark::MapMessage>(
+      codec_, request,
+      [&pooled](grpc::ClientContext* context, const ::benchmark::MapMessage& proto_request,
+                ::benchmark::MapMessage* proto_response) {
+        return pooled.stub->EchoMap(context, proto_request, proto_response);
+      });
+}
+
+common::Result<common::SparseMessage> GrpcServiceStub::EchoShape(
+    const common::SparseMessage& request) {
+  PooledChannel& pooled = Pick();
+  return CallShape<common::SparseMessage, ::benchmark::SparseMessage>(
+      codec_, request,
+      [&pooled](grpc::ClientContext* context, const ::benchmark::SparseMessage& proto_request,
+                ::benchmark::SparseMessage* proto_response) {
+        return pooled.stub->EchoSparse(context, proto_request, proto_response);
+      });
+}
+
+common::Result<common::StringMessage> GrpcServiceStub::EchoShape(
+    const common::StringMessage& request) {
+  PooledChannel& pooled = Pick();
+  return CallShape<common::StringMessage, ::benchmark::StringMessage>(
+      codec_, request,
+      [&pooled](grpc::ClientContext* context, const ::benchmark::StringMessage& proto_request,
+                ::benchmark::StringMessage* proto_response) {
+        return pooled.stub->EchoStrings(context, proto_request, proto_response);
+      });
+}
+
+// GrpcClient implementation
+GrpcClient::~GrpcClient() {
+  Disconnect();
+}
+
+common::IBenchmarkService* GrpcClient::GetService() {
+  return service_.get();
+}
+
+bool GrpcClient::Connect(const std::string& address) {
+  Disconnect();
+
+  grpc::ChannelArguments args;
+  args.SetMaxReceiveMessageSize(-1);
+  args.SetMaxSendMessageSize(-1);
+  // Channels to the same target otherwise share one connection, which
+  // would defeat the pool and hide the cost of connecting from the churn
+  // scenario
+  args.SetInt(GRPC_ARG_USE_LOCAL_SUBCHANNEL_POOL, 1);
+
+  std::vector<std::shared_ptr<grpc::Channel>> channels;
+  auto deadline = std::chrono::system_clock::now() + kConnectTimeout;
+  for (int i = 0; i < std::max(1, options_.channels); i++) {
+    auto channel = grpc::CreateCustomChannel(address, grpc::InsecureChannelCredentials(), args);
+    if (!channel->WaitForConnected(deadline)) {
+      std::cerr << "GrpcClient: cannot connect to " << address << std::endl;
+      return false;
+    }
+    channels.push_back(std::move(channel));
+  }
+
+  service_ = std::make_unique<GrpcServiceStub>(channels, options_.codec);
+  return true;
+}
+
+void GrpcClient::Disconnect() {
+  service_.reset();
+}
+
+bool GrpcClient::IsConnected() const {
+  return service_ != nullptr;
+}
 
 } // namespace grpc_impl
 } // namespace benchmark
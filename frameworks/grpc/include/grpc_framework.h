@@ -0,0 +1,173 @@
+#pragma once
+
+#include "benchmark_service.h"
+#include "grpc_support.h"
+#include <grpcpp/generic/generic_stub.h>
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace benchmark {
+namespace grpc_impl {
+
+// gRPC adapter: the common service over the generated BenchmarkService,
+// with a choice of server API so the engines can be compared on the same
+// wire protocol and client.
+
+// Server API the adapter is built on
+//   kSync      the synchronous API; gRPC's thread pool runs each call
+//              to completion, blocking on stream reads and writes
+//   kAsync     the completion-queue API, with one queue and one polling
+//              thread per CPU driving explicit per-call state machines
+//   kCallback  the callback (reactor) API; gRPC's own threads run the
+//              handlers and completions
+enum class GrpcEngine { kSync, kAsync, kCallback };
+
+const char* GrpcEngineName(GrpcEngine engine);
+
+struct GrpcOptions {
+  GrpcEngine engine = GrpcEngine::kAsync;
+
+  // Unary message handling on both sides. The server honours kArena and
+  // kRaw on the callback engine only; the others always use kProto.
+  GrpcCodec codec = GrpcCodec::kProto;
+
+  // Completion queues (kAsync) or polling queues (kSync); 0 uses one per
+  // CPU in the process affinity mask
+  int num_queues = 0;
+
+  // Client channels, each with its own connection. Every calling thread
+  // sticks to one of them, so threads spread over the pool.
+  int channels = 1;
+};
+
+class GrpcEngineImpl;
+
+class GrpcServer : public common::IBenchmarkServer {
+public:
+  GrpcServer(std::shared_ptr<common::IBenchmarkService> service, const GrpcOptions& options);
+  ~GrpcServer() override;
+
+  bool Start(const std::string& address) override;
+  void Stop() override;
+  bool IsRunning() const override;
+  void Wait() override;
+
+private:
+  std::shared_ptr<common::IBenchmarkService> service_;
+  GrpcOptions options_;
+  std::unique_ptr<GrpcEngineImpl> impl_;
+  std::unique_ptr<grpc::Server> server_;
+  std::atomic<bool> running_{false};
+  std::mutex wait_mutex_;
+  std::condition_variable wait_cv_;
+};
+
+// Client-side service over the generated stub. Blocking calls use the
+// synchronous stub; async calls and streams use the callback API, so
+// their callbacks run on gRPC's threads. The client is the same for
+// every server engine. With kRaw, unary calls go through a generic stub
+// as ByteBuffers.
+class GrpcServiceStub : public common::IBenchmarkService {
+public:
+  GrpcServiceStub(const std::vector<std::shared_ptr<grpc::Channel>>& channels, GrpcCodec codec);
+
+  common::Result<common::EchoResponse> Echo(const common::EchoRequest& request) override;
+
+  void EchoAsync(
+      const common::EchoRequest& request,
+      common::ResponseCallback<common::EchoResponse> callback) override;
+
+  void StreamData(
+      const common::StreamRequest& request,
+      common::StreamCallback<common::DataChunk> on_chunk,
+      common::CompletionCallback on_complete) override;
+
+  void UploadData(
+      common::StreamCallback<common::DataChunk>& chunk_provider,
+      common::ResponseCallback<common::UploadResponse> on_complete) override;
+
+  void BidirectionalStream(
+      common::StreamCallback<common::DataChunk>& chunk_provider,
+      common::StreamCallback<common::DataChunk> on_chunk,
+      common::CompletionCallback on_complete) override;
+
+  common::Result<common::BatchResponse> BatchProcess(
+      const common::BatchRequest& request) override;
+
+  void BatchProcessAsync(
+      const common::BatchRequest& request,
+      common::ResponseCallback<common::BatchResponse> callback) override;
+
+  common::Result<common::NestedMessage> EchoShape(const common::NestedMessage& request) override;
+  common::Result<common::ArrayMessage> EchoShape(const common::ArrayMessage& request) override;
+  common::Result<common::MapMessage> EchoShape(const common::MapMessage& request) override;
+  common::Result<common::SparseMessage> EchoShape(const common::SparseMessage& request) override;
+  common::Result<common::StringMessage> EchoShape(const common::StringMessage& request) override;
+
+private:
+  struct PooledChannel {
+    std::shared_ptr<grpc::Channel> channel;
+    std::unique_ptr<::benchmark::BenchmarkService::Stub> stub;
+    std::unique_ptr<grpc::GenericStub> generic;  // kRaw only
+  };
+
+  // The calling thread's channel
+  PooledChannel& Pick();
+
+  std::vector<PooledChannel> channels_;
+  GrpcCodec codec_;
+};
+
+// A pool of GrpcOptions::channels channels, each its own HTTP/2
+// connection, shared by all calling threads
+class GrpcClient : public common::IBenchmarkClient {
+public:
+  explicit GrpcClient(const GrpcOptions& options) : options_(options) {}
+  ~GrpcClient() override;
+
+  common::IBenchmarkService* GetService() override;
+  bool Connect(const std::string& address) override;
+  void Disconnect() override;
+  bool IsConnected() const override;
+
+private:
+  GrpcOptions options_;
+  std::unique_ptr<GrpcServiceStub> service_;
+};
+
+class GrpcFactory : public common::IFrameworkFactory {
+public:
+  explicit GrpcFactory(const GrpcOptions& options) : options_(options) {}
+
+  std::string GetName() const override;
+  std::unique_ptr<common::IBenchmarkClient> CreateClient() override;
+  std::unique_ptr<common::IBenchmarkServer> CreateServer(
+      std::shared_ptr<common::IBenchmarkService> service) override;
+
+  const GrpcOptions& options() const { return options_; }
+
+private:
+  GrpcOptions options_;
+};
+
+// The completion-queue engine, and the other two for comparison. Each
+// client spreads its threads over `channels` connections.
+std::unique_ptr<common::IFrameworkFactory> CreateGrpcFactory(int channels);
+std::unique_ptr<common::IFrameworkFactory> CreateGrpcSyncFactory(int channels);
+std::unique_ptr<common::IFrameworkFactory> CreateGrpcCallbackFactory(int channels);
+
+// The callback engine with kArena and kRaw unary messages
+std::unique_ptr<common::IFrameworkFactory> CreateGrpcArenaFactory(int channels);
+std::unique_ptr<common::IFrameworkFactory> CreateGrpcRawFactory(int channels);
+
+// MeasureEchoCodecNanos() for a gRPC factory's codec; -1 for any other
+// framework
+double EchoCodecNanos(const common::IFrameworkFactory* factory, size_t message_size);
+
+} // namespace grpc_impl
+} // namespace benchmark
@@ -0,0 +1,141 @@
+#pragma once
+
+#include "benchmark.grpc.pb.h"
+#include "benchmark_types.h"
+#include <google/protobuf/arena.h>
+#include <grpcpp/grpcpp.h>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+
+namespace benchmark {
+namespace grpc_impl {
+
+// Pieces shared by the gRPC client and server. The generated messages
+// live in ::benchmark (the proto package), next to the common types in
+// benchmark::common.
+
+// How unary messages cross the adapter
+//   kProto  generated messages on the heap, copied from and to the common
+//           types and serialized by gRPC (the plain adapter)
+//   kArena  the same messages on a per-call arena, so a call's messages
+//           and their strings come from one block
+//   kRaw    pre-serialized ByteBuffers encoded straight from the common
+//           types (see grpc_wire.h), with no generated message at all
+// Streams always use kProto, and kRaw sends the message-zoo shapes as kProto.
+enum class GrpcCodec { kProto, kArena, kRaw };
+
+const char* GrpcCodecName(GrpcCodec codec);
+
+// Copy between the common types and the generated messages
+void ToProto(const common::EchoRequest& from, ::benchmark::EchoRequest* to);
+void ToProto(const common::EchoResponse& from, ::benchmark::EchoResponse* to);
+void ToProto(const common::StreamRequest& from, ::benchmark::StreamRequest* to);
+void ToProto(const common::DataChunk& from, ::benchmark::DataChunk* to);
+void ToProto(const common::UploadResponse& from, ::benchmark::UploadResponse* to);
+void ToProto(const common::BatchRequest& from, ::benchmark::BatchRequest* to);
+void ToProto(const common::BatchResponse& from, ::benchmark::BatchResponse* to);
+
+void FromProto(const ::benchmark::EchoRequest& from, common::EchoRequest* to);
+void FromProto(const ::benchmark::EchoResponse& from, common::EchoResponse* to);
+void FromProto(const ::benchmark::StreamRequest& from, common::StreamRequest* to);
+void FromProto(const ::benchmark::DataChunk& from, common::DataChunk* to);
+void FromProto(const ::benchmark::UploadResponse& from, common::UploadResponse* to);
+void FromProto(const ::benchmark::BatchRequest& from, common::BatchRequest* to);
+void FromProto(const ::benchmark::BatchResponse& from, common::BatchResponse* to);
+
+void ToProto(const common::NestedMessage& from, ::benchmark::NestedMessage* to);
+void ToProto(const common::ArrayMessage& from, ::benchmark::ArrayMessage* to);
+void ToProto(const common::MapMessage& from, ::benchmark::MapMessage* to);
+void ToProto(const common::SparseMessage& from, ::benchmark::SparseMessage* to);
+void ToProto(const common::StringMessage& from, ::benchmark::StringMessage* to);
+
+void FromProto(const ::benchmark::NestedMessage& from, common::NestedMessage* to);
+void FromProto(const ::benchmark::ArrayMessage& from, common::ArrayMessage* to);
+void FromProto(const ::benchmark::MapMessage& from, common::MapMessage* to);
+void FromProto(const ::benchmark::SparseMessage& from, common::SparseMessage* to);
+void FromProto(const ::benchmark::StringMessage& from, common::StringMessage* to);
+
+grpc::Status ToStatus(common::ErrorCode code, const std::string& message);
+common::ErrorCode FromStatusCode(grpc::StatusCode code);
+
+// Result of a finished unary call
+template<typename T, typename Proto>
+common::Result<T> ToResult(const grpc::Status& status, const Proto& response) {
+  if (!status.ok()) {
+    return common::Result<T>(FromStatusCode(status.error_code()), status.error_message());
+  }
+  common::Result<T> result;
+  FromProto(response, &result.value);
+  return result;
+}
+
+// Arena for one call's messages. Its first block is inline, so messages
+// up to that size cost no allocation beyond the object holding the arena.
+class CallArena {
+public:
+  CallArena() : arena_(Options(block_, sizeof(block_))) {}
+
+  google::protobuf::Arena* get() { return &arena_; }
+
+private:
+  static constexpr size_t kInlineBlock = 4096;
+
+  static google::protobuf::ArenaOptions Options(char* block, size_t size) {
+    google::protobuf::ArenaOptions options;
+    options.initial_block = block;
+    options.initial_block_size = size;
+    return options;
+  }
+
+  alignas(8) char block_[kInlineBlock];
+  google::protobuf::Arena arena_;
+};
+
+// Mean cost in nanoseconds of the codec work in one echo round trip of
+// `message_size` bytes (request and response each encoded and decoded
+// once), measured outside any call so it can be set against latency
+double MeasureEchoCodecNanos(GrpcCodec codec, size_t message_size);
+
+// Outgoing half of a stream. gRPC allows one write in flight per stream,
+// so chunks produced meanwhile wait here in order; once the producer has
+// closed the queue and it has drained, the stream is finished. The write
+// and finish hooks are called without the lock held, and never again
+// after the finish hook, so producers may outlive the stream.
+class ChunkWriteQueue {
+public:
+  using WriteFn = std::function<void(const ::benchmark::DataChunk* chunk)>;
+  using FinishFn = std::function<void(const grpc::Status& status)>;
+
+  ChunkWriteQueue(WriteFn write, FinishFn finish)
+    : write_(std::move(write)), finish_(std::move(finish)) {}
+
+  // Ignored once the queue is closed
+  void Push(const common::DataChunk& chunk);
+
+  // No more chunks; finish with `status` after the queued ones
+  void Close(const grpc::Status& status);
+
+  // The write in flight completed. A failed write means the peer is gone:
+  // queued chunks are dropped and the stream finishes as cancelled.
+  void WriteDone(bool ok);
+
+private:
+  // Start the next write or the finish, if due; releases the lock
+  void Advance(std::unique_lock<std::mutex>* lock);
+
+  WriteFn write_;
+  FinishFn finish_;
+
+  std::mutex mutex_;
+  std::deque<::benchmark::DataChunk> pending_;
+  ::benchmark::DataChunk current_;   // The chunk being written
+  bool writing_ = false;
+  bool closed_ = false;
+  bool finished_ = false;
+  grpc::Status status_;
+};
+
+} // namespace grpc_impl
+} // namespace benchmark
@@ -0,0 +1,41 @@
+#pragma once
+
+#include "grpc_support.h"
+
+namespace benchmark {
+namespace grpc_impl {
+
+// The unary messages in protobuf wire format, written straight from the
+// common types and read straight back into them, with no generated
+// message in between. The bytes are the ones protobuf would produce, so
+// either side may still use the generated code.
+//
+// Encode sizes the message first and writes it into one slice of exactly
+// that size. Decode reads the received slices in place, skips unknown
+// fields and returns false on malformed input.
+
+void Encode(const common::EchoRequest& message, grpc::ByteBuffer* out);
+void Encode(const common::EchoResponse& message, grpc::ByteBuffer* out);
+void Encode(const common::BatchRequest& message, grpc::ByteBuffer* out);
+void Encode(const common::BatchResponse& message, grpc::ByteBuffer* out);
+
+bool Decode(const grpc::ByteBuffer& in, common::EchoRequest* message);
+bool Decode(const grpc::ByteBuffer& in, common::EchoResponse* message);
+bool Decode(const grpc::ByteBuffer& in, common::BatchRequest* message);
+bool Decode(const grpc::ByteBuffer& in, common::BatchResponse* message);
+
+// Result of a finished raw unary call
+template<typename T>
+common::Result<T> DecodeResult(const grpc::Status& status, const grpc::ByteBuffer& response) {
+  if (!status.ok()) {
+    return common::Result<T>(FromStatusCode(status.error_code()), status.error_message());
+  }
+  common::Result<T> result;
+  if (!Decode(response, &result.value)) {
+    return common::Result<T>(common::ErrorCode::INTERNAL, "Malformed response");
+  }
+  return result;
+}
+
+} // namespace grpc_impl
+} // namespace benchmark
@@ -0,0 +1,349 @@
+#include "grpc_support.h"
+#include "grpc_wire.h"
+#include "payload_generator.h"
+#include "shape_proto.h"
+#include <chrono>
+
+namespace benchmark {
+namespace grpc_impl {
+
+namespace {
+
+std::string ToBytes(const std::vector<uint8_t>& data) {
+  return std::string(reinterpret_cast<const char*>(data.data()), data.size());
+}
+
+std::vector<uint8_t> FromBytes(const std::string& bytes) {
+  return std::vector<uint8_t>(bytes.begin(), bytes.end());
+}
+
+// One side of a call in the generated-message codecs: copy into the
+// message and serialize it as gRPC does, or the reverse
+template<typename Proto, typename Common>
+void Send(const Common& from, Proto* message, grpc::ByteBuffer* wire) {
+  ToProto(from, message);
+  bool own_buffer = false;
+  grpc::SerializationTraits<Proto>::Serialize(*message, wire, &own_buffer);
+}
+
+template<typename Proto, typename Common>
+void Receive(grpc::ByteBuffer* wire, Proto* message, Common* to) {
+  grpc::SerializationTraits<Proto>::Deserialize(wire, message);
+  FromProto(*message, to);
+}
+
+void EchoRoundTrip(GrpcCodec codec, const common::EchoRequest& request,
+                   const common::EchoResponse& reply) {
+  grpc::ByteBuffer wire;
+  common::EchoRequest served;
+  common::EchoResponse received;
+  switch (codec) {
+    case GrpcCodec::kProto: {
+      ::benchmark::EchoRequest client_request, server_request;
+      ::benchmark::EchoResponse server_response, client_response;
+      Send(request, &client_request, &wire);
+      Receive(&wire, &server_request, &served);
+      Send(reply, &server_response, &wire);
+      Receive(&wire, &client_response, &received);
+      break;
+    }
+    case GrpcCodec::kArena: {
+      CallArena client, server;
+      using google::protobuf::Arena;
+      Send(request, Arena::CreateMessage<::benchmark::EchoRequest>(client.get()), &wire);
+      Receive(&wire, Arena::CreateMessage<::benchmark::EchoRequest>(server.get()), &served);
+      Send(reply, Arena::CreateMessage<::benchmark::EchoResponse>(server.get()), &wire);
+      Receive(&wire, Arena::CreateMessage<::benchmark::EchoResponse>(client.get()), &received);
+      break;
+    }
+    case GrpcCodec::kRaw:
+      Encode(request, &wire);
+      Decode(wire, &served);
+      Encode(reply, &wire);
+      Decode(wire, &received);
+      break;
+  }
+}
+
+} // namespace
+
+const char* GrpcCodecName(GrpcCodec codec) {
+  switch (codec) {
+    case GrpcCodec::kProto: return "proto";
+    case GrpcCodec::kArena: return "arena";
+    case GrpcCodec::kRaw: return "raw";
+  }
+  return "unknown";
+}
+
+void ToProto(const common::EchoRequest& from, ::benchmark::EchoRequest* to) {
+  to->set_message(from.message);
+  to->set_timestamp(from.timestamp);
+  to->set_sequence_number(from.sequence_number);
+}
+
+void ToProto(const common::EchoResponse& from, ::benchmark::EchoResponse* to) {
+  to->set_message(from.message);
+  to->set_client_timestamp(from.client_timestamp);
+  to->set_server_timestamp(from.server_timestamp);
+  to->set_sequence_number(from.sequence_number);
+}
+
+void ToProto(const common::StreamRequest& from, ::benchmark::StreamRequest* to) {
+  to->set_chunk_size(from.chunk_size);
+  to->set_chunk_count(from.chunk_count);
+  to->set_delay_ms(from.delay_ms);
+}
+
+void ToProto(const common::DataChunk& from, ::benchmark::DataChunk* to) {
+  to->set_sequence_number(from.sequence_number);
+  to->set_data(from.data.data(), from.data.size());
+  to->set_checksum(from.checksum);
+  to->set_timestamp(from.timestamp);
+}
+
+void ToProto(const common::UploadResponse& from, ::benchmark::UploadResponse* to) {
+  to->set_total_bytes(from.total_bytes);
+  to->set_chunk_count(from.chunk_count);
+  to->set_duration_ns(from.duration_ns);
+  to->set_checksum_valid(from.checksum_valid);
+}
+
+void ToProto(const common::BatchRequest& from, ::benchmark::BatchRequest* to) {
+  to->clear_items();
+  to->mutable_items()->Reserve(static_cast<int>(from.items.size()));
+  for (const auto& item : from.items) {
+    auto* out = to->add_items();
+    out->set_id(item.id);
+    out->set_operation(item.operation);
+    out->set_data(ToBytes(item.data));
+  }
+  to->set_fail_on_error(from.fail_on_error);
+}
+
+void ToProto(const common::BatchResponse& from, ::benchmark::BatchResponse* to) {
+  to->clear_results();
+  to->mutable_results()->Reserve(static_cast<int>(from.results.size()));
+  for (const auto& result : from.results) {
+    auto* out = to->add_results();
+    out->set_id(result.id);
+    out->set_success(result.success);
+    out->set_error_message(result.error_message);
+    out->set_result_data(ToBytes(result.result_data));
+  }
+  to->set_total_processed(from.total_processed);
+  to->set_total_failed(from.total_failed);
+}
+
+void FromProto(const ::benchmark::EchoRequest& from, common::EchoRequest* to) {
+  to->message = from.message();
+  to->timestamp = from.timestamp();
+  to->sequence_number = from.sequence_number();
+}
+
+void FromProto(const ::benchmark::EchoResponse& from, common::EchoResponse* to) {
+  to->message = from.message();
+  to->client_timestamp = from.client_timestamp();
+  to->server_timestamp = from.server_timestamp();
+  to->sequence_number = from.sequence_number();
+}
+
+void FromProto(const ::benchmark::StreamRequest& from, common::StreamRequest* to) {
+  to->chunk_size = from.chunk_size();
+  to->chunk_count = from.chunk_count();
+  to->delay_ms = from.delay_ms();
+}
+
+void FromProto(const ::benchmark::DataChunk& from, common::DataChunk* to) {
+  to->sequence_number = from.sequence_number();
+  to->data.assign(from.data().begin(), from.data().end());
+  to->checksum = from.checksum();
+  to->timestamp = from.timestamp();
+}
+
+void FromProto(const ::benchmark::UploadResponse& from, common::UploadResponse* to) {
+  to->total_bytes = from.total_bytes();
+  to->chunk_count = from.chunk_count();
+  to->duration_ns = from.duration_ns();
+  to->checksum_valid = from.checksum_valid();
+}
+
+void FromProto(const ::benchmark::BatchRequest& from, common::BatchRequest* to) {
+  to->items.clear();
+  to->items.reserve(static_cast<size_t>(from.items_size()));
+  for (const auto& item : from.items()) {
+    common::BatchItem out;
+    out.id = item.id();
+    out.operation = item.operation();
+    out.data = FromBytes(item.data());
+    to->items.push_back(std::move(out));
+  }
+  to->fail_on_error = from.fail_on_error();
+}
+
+void FromProto(const ::benchmark::BatchResponse& from, common::BatchResponse* to) {
+  to->results.clear();
+  to->results.reserve(static_cast<size_t>(from.results_size()));
+  for (const auto& result : from.results()) {
+    common::BatchResult out;
+    out.id = result.id();
+    out.success = result.success();
+    out.error_message = result.error_message();
+    out.result_data = FromBytes(result.result_data());
+    to->results.push_back(std::move(out));
+  }
+  to->total_processed = from.total_processed();
+  to->total_failed = from.total_failed();
+}
+
+// Message-zoo shapes
+void ToProto(const common::NestedMessage& from, ::benchmark::NestedMessage* to) {
+  common::shapes::NestedToProto(from, to);
+}
+
+void ToProto(const common::ArrayMessage& from, ::benchmark::ArrayMessage* to) {
+  common::shapes::ArraysToProto(from, to);
+}
+
+void ToProto(const common::MapMessage& from, ::benchmark::MapMessage* to) {
+  common::shapes::MapToProto(from, to);
+}
+
+void ToProto(const common::SparseMessage& from, ::benchmark::SparseMessage* to) {
+  common::shapes::SparseToProto(from, to);
+}
+
+void ToProto(const common::StringMessage& from, ::benchmark::StringMessage* to) {
+  common::shapes::StringsToProto(from, to);
+}
+
+void FromProto(const ::benchmark::NestedMessage& from, common::NestedMessage* to) {
+  common::shapes::NestedFromProto(from, to);
+}
+
+void FromProto(const ::benchmark::ArrayMessage& from, common::ArrayMessage* to) {
+  common::shapes::ArraysFromProto(from, to);
+}
+
+void FromProto(const ::benchmark::MapMessage& from, common::MapMessage* to) {
+  common::shapes::MapFromProto(from, to);
+}
+
+void FromProto(const ::benchmark::SparseMessage& from, common::SparseMessage* to) {
+  common::shapes::SparseFromProto(from, to);
+}
+
+void FromProto(const ::benchmark::StringMessage& from, common::StringMessage* to) {
+  common::shapes::StringsFromProto(from, to);
+}
+
+grpc::Status ToStatus(common::ErrorCode code, const std::string& message) {
+  switch (code) {
+    case common::ErrorCode::OK:
+      return grpc::Status::OK;
+    case common::ErrorCode::INVALID_ARGUMENT:
+      return grpc::Status(grpc::StatusCode::INVALID_ARGUMENT, message);
+    case common::ErrorCode::DEADLINE_EXCEEDED:
+      return grpc::Status(grpc::StatusCode::DEADLINE_EXCEEDED, message);
+    case common::ErrorCode::NOT_FOUND:
+      return grpc::Status(grpc::StatusCode::NOT_FOUND, message);
+    case common::ErrorCode::UNAVAILABLE:
+      return grpc::Status(grpc::StatusCode::UNAVAILABLE, message);
+    case common::ErrorCode::INTERNAL:
+      break;
+  }
+  return grpc::Status(grpc::StatusCode::INTERNAL, message);
+}
+
+common::ErrorCode FromStatusCode(grpc::StatusCode code) {
+  switch (code) {
+    case grpc::StatusCode::OK: return common::ErrorCode::OK;
+    case grpc::StatusCode::INVALID_ARGUMENT: return common::ErrorCode::INVALID_ARGUMENT;
+    case grpc::StatusCode::DEADLINE_EXCEEDED: return common::ErrorCode::DEADLINE_EXCEEDED;
+    case grpc::StatusCode::NOT_FOUND: return common::ErrorCode::NOT_FOUND;
+    case grpc::StatusCode::UNAVAILABLE:
+    case grpc::StatusCode::CANCELLED: return common::ErrorCode::UNAVAILABLE;
+    default: return common::ErrorCode::INTERNAL;
+  }
+}
+
+double MeasureEchoCodecNanos(GrpcCodec codec, size_t message_size) {
+  constexpr int kBatch = 64;
+  constexpr auto kMinDuration = std::chrono::milliseconds(20);
+
+  common::EchoRequest request;
+  request.message = common::payload::SharedText(message_size);
+  request.timestamp = 1700000000000000000;
+  request.sequence_number = 1;
+  common::EchoResponse reply;
+  reply.message = request.message;
+  reply.client_timestamp = request.timestamp;
+  reply.server_timestamp = request.timestamp + 1000;
+  reply.sequence_number = request.sequence_number;
+
+  for (int i = 0; i < kBatch; i++) {
+    EchoRoundTrip(codec, request, reply);
+  }
+  auto start = std::chrono::steady_clock::now();
+  auto elapsed = std::chrono::steady_clock::duration::zero();
+  long round_trips = 0;
+  while (elapsed < kMinDuration) {
+    for (int i = 0; i < kBatch; i++) {
+      EchoRoundTrip(codec, request, reply);
+    }
+    round_trips += kBatch;
+    elapsed = std::chrono::steady_clock::now() - start;
+  }
+  return static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count()) /
+         static_cast<double>(round_trips);
+}
+
+// ChunkWriteQueue implementation
+void ChunkWriteQueue::Push(const common::DataChunk& chunk) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  if (closed_) return;
+  pending_.emplace_back();
+  ToProto(chunk, &pending_.back());
+  if (!writing_) Advance(&lock);
+}
+
+void ChunkWriteQueue::Close(const grpc::Status& status) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  if (closed_) return;
+  closed_ = true;
+  status_ = status;
+  if (!writing_) Advance(&lock);
+}
+
+void ChunkWriteQueue::WriteDone(bool ok) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  writing_ = false;
+  if (!ok) {
+    pending_.clear();
+    if (!closed_) {
+      closed_ = true;
+      status_ = grpc::Status(grpc::StatusCode::CANCELLED, "Stream closed by peer");
+    }
+  }
+  Advance(&lock);
+}
+
+void ChunkWriteQueue::Advance(std::unique_lock<std::mutex>* lock) {
+  if (!pending_.empty()) {
+    current_ = std::move(pending_.front());
+    pending_.pop_front();
+    writing_ = true;
+    lock->unlock();
+    write_(&current_);
+    return;
+  }
+  if (closed_ && !finished_) {
+    finished_ = true;
+    grpc::Status status = status_;
+    lock->unlock();
+    finish_(status);
+  }
+}
+
+} // namespace grpc_impl
+} // namespace benchmark
@@ -0,0 +1,368 @@
+#include "grpc_wire.h"
+#include <google/protobuf/io/coded_stream.h>
+#include <grpcpp/support/proto_buffer_reader.h>
+#include <cassert>
+
+namespace benchmark {
+namespace grpc_impl {
+
+namespace {
+
+using google::protobuf::io::CodedInputStream;
+using google::protobuf::io::CodedOutputStream;
+
+enum WireType : uint32_t {
+  kVarint = 0,
+  kFixed64 = 1,
+  kLengthDelimited = 2,
+  kFixed32 = 5,
+};
+
+constexpr uint32_t Tag(uint32_t field, WireType type) {
+  return (field << 3) | type;
+}
+
+// Sizes. Every field number here is below 16, so each tag is one byte;
+// proto3 leaves out scalar fields holding their default.
+
+size_t VarintSize(uint64_t value) {
+  return value ? 1 + CodedOutputStream::VarintSize64(value) : 0;
+}
+
+size_t BytesSize(size_t length) {
+  return length ? 1 + CodedOutputStream::VarintSize32(static_cast<uint32_t>(length)) + length : 0;
+}
+
+// Repeated messages are written even when empty
+size_t MessageSize(size_t length) {
+  return 1 + CodedOutputStream::VarintSize32(static_cast<uint32_t>(length)) + length;
+}
+
+// Writers, each returning the end of what it wrote
+
+uint8_t* WriteVarint(uint32_t field, uint64_t value, uint8_t* target) {
+  if (!value) return target;
+  target = CodedOutputStream::WriteTagToArray(Tag(field, kVarint), target);
+  return CodedOutputStream::WriteVarint64ToArray(value, target);
+}
+
+uint8_t* WriteBytes(uint32_t field, const void* data, size_t length, uint8_t* target) {
+  if (!length) return target;
+  target = CodedOutputStream::WriteTagToArray(Tag(field, kLengthDelimited), target);
+  target = CodedOutputStream::WriteVarint32ToArray(static_cast<uint32_t>(length), target);
+  return CodedOutputStream::WriteRawToArray(data, static_cast<int>(length), target);
+}
+
+uint8_t* WriteString(uint32_t field, const std::string& value, uint8_t* target) {
+  return WriteBytes(field, value.data(), value.size(), target);
+}
+
+uint8_t* WriteBytes(uint32_t field, const std::vector<uint8_t>& value, uint8_t* target) {
+  return WriteBytes(field, value.data(), value.size(), target);
+}
+
+uint8_t* WriteMessageHeader(uint32_t field, size_t length, uint8_t* target) {
+  target = CodedOutputStream::WriteTagToArray(Tag(field, kLengthDelimited), target);
+  return CodedOutputStream::WriteVarint32ToArray(static_cast<uint32_t>(length), target);
+}
+
+// int64 fields encode negative values as ten-byte varints
+uint64_t AsVarint(int64_t value) {
+  return static_cast<uint64_t>(value);
+}
+
+size_t EncodedSize(const common::EchoRequest& message) {
+  return BytesSize(message.message.size()) + VarintSize(AsVarint(message.timestamp)) +
+         VarintSize(message.sequence_number);
+}
+
+uint8_t* Write(const common::EchoRequest& message, uint8_t* target) {
+  target = WriteString(1, message.message, target);
+  target = WriteVarint(2, AsVarint(message.timestamp), target);
+  return WriteVarint(3, message.sequence_number, target);
+}
+
+size_t EncodedSize(const common::EchoResponse& message) {
+  return BytesSize(message.message.size()) + VarintSize(AsVarint(message.client_timestamp)) +
+         VarintSize(AsVarint(message.server_timestamp)) + VarintSize(message.sequence_number);
+}
+
+uint8_t* Write(const common::EchoResponse& message, uint8_t* target) {
+  target = WriteString(1, message.message, target);
+  target = WriteVarint(2, AsVarint(message.client_timestamp), target);
+  target = WriteVarint(3, AsVarint(message.server_timestamp), target);
+  return WriteVarint(4, message.sequence_number, target);
+}
+
+size_t EncodedSize(const common::BatchItem& item) {
+  return BytesSize(item.id.size()) + BytesSize(item.operation.size()) +
+         BytesSize(item.data.size());
+}
+
+size_t EncodedSize(const common::BatchRequest& message) {
+  size_t size = VarintSize(message.fail_on_error);
+  for (const auto& item : message.items) {
+    size += MessageSize(EncodedSize(item));
+  }
+  return size;
+}
+
+uint8_t* Write(const common::BatchRequest& message, uint8_t* target) {
+  for (const auto& item : message.items) {
+    target = WriteMessageHeader(1, EncodedSize(item), target);
+    target = WriteString(1, item.id, target);
+    target = WriteString(2, item.operation, target);
+    target = WriteBytes(3, item.data, target);
+  }
+  return WriteVarint(2, message.fail_on_error, target);
+}
+
+size_t EncodedSize(const common::BatchResult& result) {
+  return BytesSize(result.id.size()) + VarintSize(result.success) +
+         BytesSize(result.error_message.size()) + BytesSize(result.result_data.size());
+}
+
+size_t EncodedSize(const common::BatchResponse& message) {
+  size_t size = VarintSize(message.total_processed) + VarintSize(message.total_failed);
+  for (const auto& result : message.results) {
+    size += MessageSize(EncodedSize(result));
+  }
+  return size;
+}
+
+uint8_t* Write(const common::BatchResponse& message, uint8_t* target) {
+  for (const auto& result : message.results) {
+    target = WriteMessageHeader(1, EncodedSize(result), target);
+    target = WriteString(1, result.id, target);
+    target = WriteVarint(2, result.success, target);
+    target = WriteString(3, result.error_message, target);
+    target = WriteBytes(4, result.result_data, target);
+  }
+  target = WriteVarint(2, message.total_processed, target);
+  return WriteVarint(3, message.total_failed, target);
+}
+
+template<typename Message>
+void EncodeInto(const Message& message, grpc::ByteBuffer* out) {
+  size_t size = EncodedSize(message);
+  grpc_slice slice = grpc_slice_malloc(size);
+  uint8_t* end = Write(message, GRPC_SLICE_START_PTR(slice));
+  assert(end == GRPC_SLICE_START_PTR(slice) + size);
+  (void)end;
+  grpc::Slice owned(slice, grpc::Slice::STEAL_REF);
+  grpc::ByteBuffer buffer(&owned, 1);
+  out->Swap(&buffer);
+}
+
+// Readers
+
+template<typename T>
+bool ReadVarint(CodedInputStream* in, T* value) {
+  uint64_t raw = 0;
+  if (!in->ReadVarint64(&raw)) return false;
+  *value = static_cast<T>(raw);
+  return true;
+}
+
+bool ReadBool(CodedInputStream* in, bool* value) {
+  uint64_t raw = 0;
+  if (!in->ReadVarint64(&raw)) return false;
+  *value = raw != 0;
+  return true;
+}
+
+bool ReadLength(CodedInputStream* in, uint32_t* length) {
+  if (!in->ReadVarint32(length)) return false;
+  // Refuse lengths past the end before allocating for them
+  int remaining = in->BytesUntilLimit();
+  return remaining < 0 || *length <= static_cast<uint32_t>(remaining);
+}
+
+bool ReadString(CodedInputStream* in, std::string* value) {
+  uint32_t length = 0;
+  return ReadLength(in, &length) && in->ReadString(value, static_cast<int>(length));
+}
+
+bool ReadBytes(CodedInputStream* in, std::vector<uint8_t>* value) {
+  uint32_t length = 0;
+  if (!ReadLength(in, &length)) return false;
+  value->resize(length);
+  return length == 0 || in->ReadRaw(value->data(), static_cast<int>(length));
+}
+
+bool SkipField(CodedInputStream* in, uint32_t tag) {
+  switch (tag & 7) {
+    case kVarint: {
+      uint64_t value = 0;
+      return in->ReadVarint64(&value);
+    }
+    case kFixed64: {
+      uint64_t value = 0;
+      return in->ReadLittleEndian64(&value);
+    }
+    case kLengthDelimited: {
+      uint32_t length = 0;
+      return ReadLength(in, &length) && in->Skip(static_cast<int>(length));
+    }
+    case kFixed32: {
+      uint32_t value = 0;
+      return in->ReadLittleEndian32(&value);
+    }
+    default:
+      return false;
+  }
+}
+
+// ReadTag() returns 0 both at the end and on a truncated tag; only the
+// former leaves nothing before the limit
+bool AtEnd(CodedInputStream* in) {
+  return in->BytesUntilLimit() == 0;
+}
+
+bool Read(CodedInputStream* in, common::EchoRequest* message) {
+  while (uint32_t tag = in->ReadTag()) {
+    bool ok;
+    switch (tag) {
+      case Tag(1, kLengthDelimited): ok = ReadString(in, &message->message); break;
+      case Tag(2, kVarint): ok = ReadVarint(in, &message->timestamp); break;
+      case Tag(3, kVarint): ok = ReadVarint(in, &message->sequence_number); break;
+      default: ok = SkipField(in, tag); break;
+    }
+    if (!ok) return false;
+  }
+  return AtEnd(in);
+}
+
+bool Read(CodedInputStream* in, common::EchoResponse* message) {
+  while (uint32_t tag = in->ReadTag()) {
+    bool ok;
+    switch (tag) {
+      case Tag(1, kLengthDelimited): ok = ReadString(in, &message->message); break;
+      case Tag(2, kVarint): ok = ReadVarint(in, &message->client_timestamp); break;
+      case Tag(3, kVarint): ok = ReadVarint(in, &message->server_timestamp); break;
+      case Tag(4, kVarint): ok = ReadVarint(in, &message->sequence_number); break;
+      default: ok = SkipField(in, tag); break;
+    }
+    if (!ok) return false;
+  }
+  return AtEnd(in);
+}
+
+bool Read(CodedInputStream* in, common::BatchItem* item) {
+  while (uint32_t tag = in->ReadTag()) {
+    bool ok;
+    switch (tag) {
+      case Tag(1, kLengthDelimited): ok = ReadString(in, &item->id); break;
+      case Tag(2, kLengthDelimited): ok = ReadString(in, &item->operation); break;
+      case Tag(3, kLengthDelimited): ok = ReadBytes(in, &item->data); break;
+      default: ok = SkipField(in, tag); break;
+    }
+    if (!ok) return false;
+  }
+  return AtEnd(in);
+}
+
+bool Read(CodedInputStream* in, common::BatchResult* result) {
+  // The common type defaults to success; the wire's default is false
+  result->success = false;
+  while (uint32_t tag = in->ReadTag()) {
+    bool ok;
+    switch (tag) {
+      case Tag(1, kLengthDelimited): ok = ReadString(in, &result->id); break;
+      case Tag(2, kVarint): ok = ReadBool(in, &result->success); break;
+      case Tag(3, kLengthDelimited): ok = ReadString(in, &result->error_message); break;
+      case Tag(4, kLengthDelimited): ok = ReadBytes(in, &result->result_data); break;
+      default: ok = SkipField(in, tag); break;
+    }
+    if (!ok) return false;
+  }
+  return AtEnd(in);
+}
+
+// One element of a repeated message field
+template<typename Item>
+bool ReadItem(CodedInputStream* in, std::vector<Item>* items) {
+  uint32_t length = 0;
+  if (!ReadLength(in, &length)) return false;
+  CodedInputStream::Limit limit = in->PushLimit(static_cast<int>(length));
+  items->emplace_back();
+  bool ok = Read(in, &items->back());
+  in->PopLimit(limit);
+  return ok;
+}
+
+bool Read(CodedInputStream* in, common::BatchRequest* message) {
+  while (uint32_t tag = in->ReadTag()) {
+    bool ok;
+    switch (tag) {
+      case Tag(1, kLengthDelimited): ok = ReadItem(in, &message->items); break;
+      case Tag(2, kVarint): ok = ReadBool(in, &message->fail_on_error); break;
+      default: ok = SkipField(in, tag); break;
+    }
+    if (!ok) return false;
+  }
+  return AtEnd(in);
+}
+
+bool Read(CodedInputStream* in, common::BatchResponse* message) {
+  while (uint32_t tag = in->ReadTag()) {
+    bool ok;
+    switch (tag) {
+      case Tag(1, kLengthDelimited): ok = ReadItem(in, &message->results); break;
+      case Tag(2, kVarint): ok = ReadVarint(in, &message->total_processed); break;
+      case Tag(3, kVarint): ok = ReadVarint(in, &message->total_failed); break;
+      default: ok = SkipField(in, tag); break;
+    }
+    if (!ok) return false;
+  }
+  return AtEnd(in);
+}
+
+template<typename Message>
+bool DecodeFrom(const grpc::ByteBuffer& in, Message* message) {
+  // Copying a ByteBuffer only takes references to its slices
+  grpc::ByteBuffer buffer(in);
+  int length = static_cast<int>(buffer.Length());
+  grpc::ProtoBufferReader reader(&buffer);
+  CodedInputStream stream(&reader);
+  stream.PushLimit(length);
+  *message = Message();
+  return Read(&stream, message);
+}
+
+} // namespace
+
+void Encode(const common::EchoRequest& message, grpc::ByteBuffer* out) {
+  EncodeInto(message, out);
+}
+
+void Encode(const common::EchoResponse& message, grpc::ByteBuffer* out) {
+  EncodeInto(message, out);
+}
+
+void Encode(const common::BatchRequest& message, grpc::ByteBuffer* out) {
+  EncodeInto(message, out);
+}
+
+void Encode(const common::BatchResponse& message, grpc::ByteBuffer* out) {
+  EncodeInto(message, out);
+}
+
+bool Decode(const grpc::ByteBuffer& in, common::EchoRequest* message) {
+  return DecodeFrom(in, message);
+}
+
+bool Decode(const grpc::ByteBuffer& in, common::EchoResponse* message) {
+  return DecodeFrom(in, message);
+}
+
+bool Decode(const grpc::ByteBuffer& in, common::BatchRequest* message) {
+  return DecodeFrom(in, message);
+}
+
+bool Decode(const grpc::ByteBuffer& in, common::BatchResponse* message) {
+  return DecodeFrom(in, message);
+}
+
+} // namespace grpc_impl
+} // namespace benchmark
@@ -0,0 +1,190 @@
+// Raw TCP and Unix socket client: one blocking connection shared by all
+// calling threads, with a reader thread that routes response frames by
+// call id
+
+#include "rawtcp_framework.h"
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace benchmark {
+namespace rawtcp {
+
+using common::wire::FrameHeader;
+using common::wire::MessageType;
+
+namespace {
+
+constexpr size_t kReadSize = 64 * 1024;
+
+} // namespace
+
+// RawTcpClient implementation
+RawTcpClient::RawTcpClient(const TransportOptions& options)
+  : options_(options), service_(this, &calls_) {}
+
+RawTcpClient::~RawTcpClient() {
+  Disconnect();
+}
+
+common::IBenchmarkService* RawTcpClient::GetService() {
+  return connected_ ? &service_ : nullptr;
+}
+
+bool RawTcpClient::Connect(const std::string& address) {
+  Disconnect();
+  if (!(options_.unix_socket ? ConnectUnix(address) : ConnectTcp(address))) {
+    return false;
+  }
+
+  connected_ = true;
+  reader_ = std::thread([this]() { ReadLoop(); });
+  return true;
+}
+
+bool RawTcpClient::ConnectTcp(const std::string& address) {
+  std::string host;
+  uint16_t port = 0;
+  if (!ParseAddress(address, &host, &port)) {
+    std::cerr << "RawTcpClient: invalid address " << address << std::endl;
+    return false;
+  }
+
+  addrinfo hints{};
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  addrinfo* resolved = nullptr;
+  std::string port_text = std::to_string(port);
+  if (::getaddrinfo(host.c_str(), port_text.c_str(), &hints, &resolved) != 0) {
+    std::cerr << "RawTcpClient: cannot resolve " << address << std::endl;
+    return false;
+  }
+
+  for (addrinfo* ai = resolved; ai; ai = ai->ai_next) {
+    int fd = ::socket(ai->ai_family, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) continue;
+
+    // Connection churn leaves many ephemeral ports in TIME_WAIT; marking
+    // them reusable keeps them from blocking servers bound to those ports
+    int reuse = 1;
+    ::setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+    if (::connect(fd, ai->ai_addr, ai->ai_addrlen) == 0) {
+      fd_ = fd;
+      break;
+    }
+    ::close(fd);
+  }
+  ::freeaddrinfo(resolved);
+
+  if (fd_ < 0) {
+    std::cerr << "RawTcpClient: cannot connect to " << address << std::endl;
+    return false;
+  }
+
+  int one = 1;
+  ::setsockopt(fd_, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+  return true;
+}
+
+bool RawTcpClient::ConnectUnix(const std::string& address) {
+  sockaddr_un socket_address{};
+  socklen_t length = 0;
+  if (!MakeUnixAddress(address, &socket_address, &length)) {
+    std::cerr << "RawTcpClient: invalid Unix socket address " << address << std::endl;
+    return false;
+  }
+
+  int fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (fd < 0 || ::connect(fd, reinterpret_cast<sockaddr*>(&socket_address), length) != 0) {
+    std::cerr << "RawTcpClient: cannot connect to " << address << std::endl;
+    if (fd >= 0) ::close(fd);
+    return false;
+  }
+  fd_ = fd;
+  return true;
+}
+
+void RawTcpClient::Disconnect() {
+  if (fd_ < 0) return;
+
+  connected_ = false;
+  ::shutdown(fd_, SHUT_RDWR);
+  if (reader_.joinable()) reader_.join();
+  ::close(fd_);
+  fd_ = -1;
+  calls_.FailAll();
+}
+
+bool RawTcpClient::IsConnected() const {
+  return connected_;
+}
+
+bool RawTcpClient::SendFrame(MessageType type, uint32_t call_id, size_t body_size,
+                             const common::wire::BodyEncoder& encode) {
+  if (!connected_) return false;
+
+  if (options_.fd_threshold > 0 && body_size >= options_.fd_threshold) {
+    int body_fd = memfds_.Write(body_size, encode);
+    if (body_fd < 0) return false;
+
+    uint8_t header[common::wire::kFrameHeaderSize];
+    common::wire::WriteFrameHeader(header, type, call_id, static_cast<uint32_t>(body_size),
+                                   common::wire::kFlagBodyInFd);
+    std::lock_guard<std::mutex> lock(write_mutex_);
+    bool sent = SendAll(fd_, header, sizeof(header), body_fd);
+    ::close(body_fd);
+    return sent;
+  }
+
+  std::lock_guard<std::mutex> lock(write_mutex_);
+  write_buffer_.resize(common::wire::kFrameHeaderSize + body_size);
+  uint8_t* frame = reinterpret_cast<uint8_t*>(&write_buffer_[0]);
+  common::wire::WriteFrameHeader(frame, type, call_id, static_cast<uint32_t>(body_size));
+  common::wire::WireWriter writer(frame + common::wire::kFrameHeaderSize, body_size);
+  encode(&writer);
+  return SendAll(fd_, frame, write_buffer_.size());
+}
+
+void RawTcpClient::ReadLoop() {
+  common::wire::FrameBuffer buffer;
+  auto deliver = [this](const FrameHeader& header, const uint8_t* body) {
+    calls_.Deliver(header, body);
+    return true;
+  };
+
+  while (true) {
+    size_t available = 0;
+    uint8_t* space = buffer.WritableSpace(kReadSize, &available);
+    ssize_t n = options_.unix_socket
+                    ? ReceiveWithFds(fd_, space, available, &passed_fds_)
+                    : ::recv(fd_, space, available, 0);
+    if (n < 0 && errno == EINTR) continue;
+    if (n <= 0) break;
+    buffer.Commit(static_cast<size_t>(n));
+
+    FrameHeader header;
+    const uint8_t* body = nullptr;
+    bool corrupt = false;
+    while (!corrupt && buffer.NextFrame(&header, &body, &corrupt)) {
+      corrupt = !DeliverFrame(header, body, &passed_fds_, &memfds_, deliver);
+      buffer.Consume();
+    }
+
+    if (corrupt) {
+      std::cerr << "RawTcpClient: corrupt frame, closing connection" << std::endl;
+      break;
+    }
+  }
+
+  connected_ = false;
+  CloseAll(&passed_fds_);
+  calls_.FailAll();
+}
+
+} // namespace rawtcp
+} // namespace benchmark
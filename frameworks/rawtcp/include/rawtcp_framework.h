@@ -0,0 +1,125 @@
+#pragma once
+
+#include "benchmark_service.h"
+#include "framed_service.h"
+#include "socket_transport.h"
+#include <deque>
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace benchmark {
+namespace rawtcp {
+
+// Native loopback TCP transport: the common types framed with
+// common/wire_format.h over plain non-blocking sockets and epoll, with no
+// RPC library in between. Serves as the kernel-networking baseline that
+// framework adapters are compared against. The same client and server
+// also run over Unix domain sockets (see TransportOptions), optionally
+// passing large bodies as memfds instead of copying them through the
+// socket.
+
+// Split "host:port" into its parts. Returns false without a numeric port.
+bool ParseAddress(const std::string& address, std::string* host, uint16_t* port);
+
+class ServerLoop;
+
+// Server with one event loop per core, driven by epoll or io_uring (see
+// ServerEngine). Every loop owns a listening socket bound to the same
+// address with SO_REUSEPORT, so the kernel shards incoming connections
+// across loops and a connection stays on the loop that accepted it. Calls
+// are dispatched to the service on the loop thread.
+class RawTcpServer : public common::IBenchmarkServer {
+public:
+  // num_loops = 0 uses one loop per CPU in the process affinity mask
+  RawTcpServer(std::shared_ptr<common::IBenchmarkService> service, int num_loops = 0,
+               const TransportOptions& options = TransportOptions());
+  ~RawTcpServer() override;
+
+  bool Start(const std::string& address) override;
+  void Stop() override;
+  bool IsRunning() const override;
+  void Wait() override;
+
+private:
+  bool StartUnix(const std::string& address);
+
+  // A loop of the configured engine, or epoll if io_uring is unavailable
+  std::unique_ptr<ServerLoop> CreateLoop();
+
+  std::shared_ptr<common::IBenchmarkService> service_;
+  int num_loops_;
+  TransportOptions options_;
+  int listen_fd_ = -1;   // Shared by all loops on Unix sockets
+  std::vector<std::unique_ptr<ServerLoop>> loops_;
+  std::atomic<bool> running_{false};
+  std::mutex wait_mutex_;
+  std::condition_variable wait_cv_;
+};
+
+// One connection shared by all calling threads, with a reader thread that
+// routes response frames to outstanding calls by call id
+class RawTcpClient : public common::IBenchmarkClient, public common::wire::FrameSender {
+public:
+  explicit RawTcpClient(const TransportOptions& options = TransportOptions());
+  ~RawTcpClient() override;
+
+  common::IBenchmarkService* GetService() override;
+  bool Connect(const std::string& address) override;
+  void Disconnect() override;
+  bool IsConnected() const override;
+
+  bool SendFrame(common::wire::MessageType type, uint32_t call_id, size_t body_size,
+                 const common::wire::BodyEncoder& encode) override;
+
+private:
+  bool ConnectTcp(const std::string& address);
+  bool ConnectUnix(const std::string& address);
+  void ReadLoop();
+
+  TransportOptions options_;
+  int fd_ = -1;
+  std::atomic<bool> connected_{false};
+  std::thread reader_;
+  std::mutex write_mutex_;
+  std::string write_buffer_;
+  std::deque<int> passed_fds_;   // Owned by the reader thread
+  MemfdCache memfds_;
+
+  common::wire::CallTable calls_;
+  common::wire::FramedServiceStub service_;
+};
+
+class RawTcpFactory : public common::IFrameworkFactory {
+public:
+  explicit RawTcpFactory(const TransportOptions& options = TransportOptions(),
+                         int server_loops = 0)
+    : options_(options), server_loops_(server_loops) {}
+
+  std::string GetName() const override;
+  std::unique_ptr<common::IBenchmarkClient> CreateClient() override;
+  std::unique_ptr<common::IBenchmarkServer> CreateServer(
+      std::shared_ptr<common::IBenchmarkService> service) override;
+
+private:
+  TransportOptions options_;
+  int server_loops_;
+};
+
+// handler_pool: see TransportOptions
+std::unique_ptr<common::IFrameworkFactory> CreateRawTcpFactory(bool handler_pool);
+
+// Unix domain socket variant; fd_threshold = 0 keeps every body inline
+std::unique_ptr<common::IFrameworkFactory> CreateUdsFactory(size_t fd_threshold,
+                                                           bool handler_pool);
+
+// The same transports with io_uring server loops
+std::unique_ptr<common::IFrameworkFactory> CreateRawTcpUringFactory(bool handler_pool);
+std::unique_ptr<common::IFrameworkFactory> CreateUdsUringFactory(bool handler_pool);
+
+} // namespace rawtcp
+} // namespace benchmark
@@ -0,0 +1,105 @@
+#pragma once
+
+#include "framed_service.h"
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <sys/un.h>
+#include <vector>
+
+namespace benchmark {
+namespace rawtcp {
+
+// How server loops wait for and perform socket I/O
+enum class ServerEngine {
+  kEpoll,    // Readiness from epoll, then one recv()/send() per connection
+  kIoUring   // Completions from io_uring; falls back to epoll where missing
+};
+
+// Which stream socket the native transport runs over
+struct TransportOptions {
+  // AF_UNIX instead of TCP. The address then names the socket: a path
+  // starting with '/', or anything else for the abstract namespace.
+  bool unix_socket = false;
+
+  // Unix sockets only: frame bodies of at least this many bytes are written
+  // into a memfd whose descriptor is passed with the frame header, so the
+  // payload never crosses the socket. 0 always sends bodies inline.
+  size_t fd_threshold = 0;
+
+  // Server only; the client is the same with either engine
+  ServerEngine engine = ServerEngine::kEpoll;
+
+  // Server only: run unary handlers on the shared work-stealing executor
+  // instead of the loop thread that read the request
+  bool handler_pool = false;
+};
+
+bool MakeUnixAddress(const std::string& address, sockaddr_un* result, socklen_t* length);
+
+// Memfds for frame bodies on one connection. A fresh memfd costs several
+// syscalls plus a page fault and zeroing for every page, which outweighs
+// copying small and medium bodies through the socket. Passing a memfd
+// transfers it: the sender closes its descriptor, so once the receiver has
+// read a body it owns that memfd and can fill it with a body going the
+// other way. Both sides keep their mappings by inode, so a memfd that
+// comes back is neither mapped nor faulted in again.
+class MemfdCache {
+public:
+  MemfdCache() = default;
+  ~MemfdCache();
+  MemfdCache(const MemfdCache&) = delete;
+  MemfdCache& operator=(const MemfdCache&) = delete;
+
+  // Encode a body into an owned memfd, or a new one if none is large
+  // enough. Returns the descriptor to pass, which the caller closes after
+  // sending, or -1 on failure.
+  int Write(size_t body_size, const common::wire::BodyEncoder& encode);
+
+  // Map a received memfd; takes ownership of `fd`. Call Done() once the
+  // body has been read.
+  const uint8_t* Map(int fd, size_t body_size);
+  void Done(const uint8_t* data);
+
+private:
+  struct Entry {
+    uint64_t inode = 0;
+    int fd = -1;            // Owned and free for writing when >= 0
+    uint8_t* data = nullptr;
+    size_t size = 0;
+    bool busy = false;      // Being written or read
+    uint64_t last_use = 0;
+  };
+
+  // Insert a mapping and drop the least recently used idle ones
+  Entry* AddLocked(const Entry& entry);
+
+  std::mutex mutex_;
+  std::vector<Entry> entries_;
+  uint64_t clock_ = 0;
+};
+
+// Send all of `data`, waiting for room on non-blocking sockets. A
+// `passed_fd` travels as SCM_RIGHTS with the first byte.
+bool SendAll(int socket_fd, const uint8_t* data, size_t size, int passed_fd = -1);
+
+// recv() that also collects descriptors passed on a Unix socket
+ssize_t ReceiveWithFds(int socket_fd, void* buffer, size_t size, std::deque<int>* fds);
+
+void CloseAll(std::deque<int>* fds);
+
+using FrameCallback = std::function<bool(const common::wire::FrameHeader& header,
+                                         const uint8_t* body)>;
+
+// Hand a frame from FrameBuffer::NextFrame() to `deliver`, mapping the
+// next passed descriptor when its body travelled in a memfd. Returns false
+// on a protocol error or when `deliver` fails.
+bool DeliverFrame(const common::wire::FrameHeader& header, const uint8_t* body,
+                  std::deque<int>* fds, MemfdCache* memfds, const FrameCallback& deliver);
+
+} // namespace rawtcp
+} // namespace benchmark
@@ -0,0 +1,583 @@
+// Raw TCP server: one event loop per core with SO_REUSEPORT accept
+// sharding, and the epoll engine of those loops
+
+#include "server_loop.h"
+#include "benchmark_utils.h"
+#include "resource_usage.h"
+#include "work_stealing_executor.h"
+#include <arpa/inet.h>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace benchmark {
+namespace rawtcp {
+
+using common::wire::FrameHeader;
+using common::wire::MessageType;
+
+namespace {
+
+constexpr int kMaxEvents = 256;
+constexpr size_t kReadSize = 64 * 1024;
+
+} // namespace
+
+bool ParseAddress(const std::string& address, std::string* host, uint16_t* port) {
+  auto colon = address.rfind(':');
+  if (colon == std::string::npos || colon + 1 == address.size()) return false;
+
+  try {
+    size_t consumed = 0;
+    int value = std::stoi(address.substr(colon + 1), &consumed);
+    if (consumed != address.size() - colon - 1 || value < 0 || value > 65535) {
+      return false;
+    }
+    *port = static_cast<uint16_t>(value);
+  } catch (const std::exception&) {
+    return false;
+  }
+
+  *host = address.substr(0, colon);
+  // Accept bracketed IPv6 literals, e.g. "[::1]:50051"
+  if (host->size() >= 2 && host->front() == '[' && host->back() == ']') {
+    *host = host->substr(1, host->size() - 2);
+  }
+  return true;
+}
+
+int OpenListener(const sockaddr* address, socklen_t length) {
+  int fd = ::socket(address->sa_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  if (fd < 0) return -1;
+
+  if (address->sa_family != AF_UNIX) {
+    int one = 1;
+    ::setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    ::setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &one, sizeof(one));
+    ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+  }
+
+  if (::bind(fd, address, length) != 0 || ::listen(fd, 1024) != 0) {
+    std::cerr << "RawTcpServer: bind/listen failed: " << std::strerror(errno) << std::endl;
+    ::close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+// A server-side connection. The fields under out_mutex may be touched by
+// service callbacks on other threads; everything else belongs to the
+// owning loop.
+struct Connection : public common::wire::FrameSender {
+  int fd = -1;
+  int epoll_fd = -1;
+  TransportOptions options;
+  common::wire::FrameBuffer in;
+
+  // Descriptors received with frames whose body is in a memfd, and the
+  // memfds this connection has mapped
+  std::deque<int> passed_fds;
+  MemfdCache memfds;
+
+  ~Connection() override { CloseAll(&passed_fds); }
+
+  // Reset on close, which breaks its reference back to this connection
+  std::unique_ptr<common::wire::ServiceDispatcher> dispatcher;
+
+  std::mutex out_mutex;
+  std::string out;
+  size_t out_offset = 0;
+  bool write_armed = false;
+  bool batching = false;
+  bool closed = false;
+
+  // Encode the frame straight into the output buffer
+  bool SendFrame(MessageType type, uint32_t call_id, size_t body_size,
+                 const common::wire::BodyEncoder& encode) override {
+    if (options.fd_threshold > 0 && body_size >= options.fd_threshold) {
+      return SendFrameInFd(type, call_id, body_size, encode);
+    }
+
+    std::lock_guard<std::mutex> lock(out_mutex);
+    if (closed) return false;
+
+    size_t offset = out.size();
+    out.resize(offset + common::wire::kFrameHeaderSize + body_size);
+    uint8_t* frame = reinterpret_cast<uint8_t*>(&out[offset]);
+    common::wire::WriteFrameHeader(frame, type, call_id, static_cast<uint32_t>(body_size));
+    common::wire::WireWriter writer(frame + common::wire::kFrameHeaderSize, body_size);
+    encode(&writer);
+
+    if (!batching || out.size() - out_offset >= kHighWatermark) {
+      FlushLocked();
+    }
+    return !closed;
+  }
+
+  // Encode the body into a memfd outside the lock, then send the header
+  // with the descriptor once everything queued before it is out
+  bool SendFrameInFd(MessageType type, uint32_t call_id, size_t body_size,
+                     const common::wire::BodyEncoder& encode) {
+    int body_fd = memfds.Write(body_size, encode);
+    if (body_fd < 0) return false;
+
+    uint8_t header[common::wire::kFrameHeaderSize];
+    common::wire::WriteFrameHeader(header, type, call_id, static_cast<uint32_t>(body_size),
+                                   common::wire::kFlagBodyInFd);
+
+    std::lock_guard<std::mutex> lock(out_mutex);
+    const auto* queued = reinterpret_cast<const uint8_t*>(out.data());
+    bool sent = !closed && SendAll(fd, queued + out_offset, out.size() - out_offset) &&
+                SendAll(fd, header, sizeof(header), body_fd);
+    ::close(body_fd);
+    if (!sent) {
+      closed = true;
+      return false;
+    }
+    out.clear();
+    out_offset = 0;
+    SetWriteInterest(false);
+    return true;
+  }
+
+  void Flush() {
+    std::lock_guard<std::mutex> lock(out_mutex);
+    FlushLocked();
+  }
+
+  void FlushLocked() {
+    while (!closed && out_offset < out.size()) {
+      ssize_t n = ::send(fd, out.data() + out_offset, out.size() - out_offset,
+                         MSG_NOSIGNAL | MSG_DONTWAIT);
+      if (n > 0) {
+        out_offset += static_cast<size_t>(n);
+        continue;
+      }
+      if (n < 0 && errno == EINTR) continue;
+      if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+        if (out.size() - out_offset < kHighWatermark) {
+          SetWriteInterest(true);
+          return;
+        }
+        // Too much queued: block this thread until the peer drains some
+        pollfd pfd{fd, POLLOUT, 0};
+        ::poll(&pfd, 1, 1000);
+        continue;
+      }
+      closed = true;
+      return;
+    }
+
+    out.clear();
+    out_offset = 0;
+    SetWriteInterest(false);
+  }
+
+  void SetWriteInterest(bool enabled) {
+    if (write_armed == enabled) return;
+    epoll_event event{};
+    event.events = EPOLLIN | EPOLLRDHUP | (enabled ? static_cast<uint32_t>(EPOLLOUT) : 0u);
+    event.data.fd = fd;
+    ::epoll_ctl(epoll_fd, EPOLL_CTL_MOD, fd, &event);
+    write_armed = enabled;
+  }
+};
+
+// Readiness-based engine: epoll_wait(), then recv() and send() on each
+// ready connection
+class EpollLoop : public ServerLoop {
+public:
+  EpollLoop(std::shared_ptr<common::IBenchmarkService> service, const TransportOptions& options)
+    : service_(std::move(service)), options_(options),
+      executor_(options.handler_pool ? &common::WorkStealingExecutor::Shared() : nullptr) {}
+
+  ~EpollLoop() override { Stop(); }
+
+  bool Listen(const sockaddr* address, socklen_t length) override {
+    listen_fd_ = OpenListener(address, length);
+    if (listen_fd_ < 0) return false;
+    owns_listener_ = true;
+    return Init(EPOLLIN);
+  }
+
+  // EPOLLEXCLUSIVE wakes one loop per connection instead of all
+  bool Share(int listen_fd) override {
+    listen_fd_ = listen_fd;
+    owns_listener_ = false;
+    return Init(EPOLLIN | EPOLLEXCLUSIVE);
+  }
+
+  int listen_fd() const override { return listen_fd_; }
+
+  void Start() override {
+    thread_ = std::thread([this]() { Run(); });
+  }
+
+  void Stop() override {
+    if (thread_.joinable()) {
+      stopping_ = true;
+      uint64_t one = 1;
+      ssize_t ignored = ::write(wake_fd_, &one, sizeof(one));
+      (void)ignored;
+      thread_.join();
+    }
+
+    for (auto& entry : connections_) {
+      std::lock_guard<std::mutex> lock(entry.second->out_mutex);
+      entry.second->closed = true;
+      ::close(entry.first);
+    }
+    for (auto& entry : connections_) {
+      entry.second->dispatcher.reset();
+    }
+    connections_.clear();
+
+    if (!owns_listener_) listen_fd_ = -1;
+    for (int* fd : {&listen_fd_, &wake_fd_, &epoll_fd_}) {
+      if (*fd >= 0) ::close(*fd);
+      *fd = -1;
+    }
+  }
+
+private:
+  bool Init(uint32_t listen_events) {
+    epoll_fd_ = ::epoll_create1(EPOLL_CLOEXEC);
+    wake_fd_ = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (epoll_fd_ < 0 || wake_fd_ < 0) return false;
+
+    AddInterest(listen_fd_, listen_events);
+    AddInterest(wake_fd_, EPOLLIN);
+    return true;
+  }
+
+  void AddInterest(int fd, uint32_t events) {
+    epoll_event event{};
+    event.events = events;
+    event.data.fd = fd;
+    ::epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &event);
+  }
+
+  void Run() {
+    epoll_event events[kMaxEvents];
+    while (!stopping_) {
+      int count = ::epoll_wait(epoll_fd_, events, kMaxEvents, -1);
+      if (count < 0) {
+        if (errno == EINTR) continue;
+        break;
+      }
+
+      for (int i = 0; i < count; i++) {
+        int fd = events[i].data.fd;
+        if (fd == wake_fd_) continue;
+        if (fd == listen_fd_) {
+          AcceptAll();
+          continue;
+        }
+
+        auto it = connections_.find(fd);
+        if (it == connections_.end()) continue;
+        auto conn = it->second;
+
+        if (events[i].events & EPOLLOUT) {
+          conn->Flush();
+        }
+        if (events[i].events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR)) {
+          if (!ReadAndDispatch(conn)) Close(fd);
+        }
+      }
+    }
+  }
+
+  void AcceptAll() {
+    while (true) {
+      int fd = ::accept4(listen_fd_, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+      if (fd < 0) return;
+
+      if (!options_.unix_socket) {
+        int one = 1;
+        ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+      }
+
+      auto conn = std::make_shared<Connection>();
+      conn->fd = fd;
+      conn->epoll_fd = epoll_fd_;
+      conn->options = options_;
+      conn->dispatcher =
+          std::make_unique<common::wire::ServiceDispatcher>(service_, conn, executor_);
+      connections_[fd] = conn;
+      AddInterest(fd, EPOLLIN | EPOLLRDHUP);
+    }
+  }
+
+  void Close(int fd) {
+    auto it = connections_.find(fd);
+    if (it == connections_.end()) return;
+    {
+      std::lock_guard<std::mutex> lock(it->second->out_mutex);
+      it->second->closed = true;
+      ::epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, fd, nullptr);
+      ::close(fd);
+    }
+    it->second->dispatcher.reset();
+    connections_.erase(it);
+  }
+
+  // Read everything available and dispatch each complete frame. Responses
+  // produced while dispatching one read are written with a single send.
+  // Returns false when the connection should be closed.
+  bool ReadAndDispatch(const std::shared_ptr<Connection>& conn) {
+    auto dispatch = [&conn](const FrameHeader& header, const uint8_t* body) {
+      return conn->dispatcher->Dispatch(header, body);
+    };
+
+    while (true) {
+      size_t available = 0;
+      uint8_t* space = conn->in.WritableSpace(kReadSize, &available);
+      ssize_t n = options_.unix_socket
+                      ? ReceiveWithFds(conn->fd, space, available, &conn->passed_fds)
+                      : ::recv(conn->fd, space, available, 0);
+      if (n == 0) return false;
+      if (n < 0) {
+        if (errno == EINTR) continue;
+        return errno == EAGAIN || errno == EWOULDBLOCK;
+      }
+      conn->in.Commit(static_cast<size_t>(n));
+
+      {
+        std::lock_guard<std::mutex> lock(conn->out_mutex);
+        conn->batching = true;
+      }
+
+      bool ok = true;
+      FrameHeader header;
+      const uint8_t* body = nullptr;
+      bool corrupt = false;
+      while (ok && conn->in.NextFrame(&header, &body, &corrupt)) {
+        ok = DeliverFrame(header, body, &conn->passed_fds, &conn->memfds, dispatch);
+        conn->in.Consume();
+      }
+
+      {
+        std::lock_guard<std::mutex> lock(conn->out_mutex);
+        conn->batching = false;
+        conn->FlushLocked();
+        if (conn->closed) return false;
+      }
+      if (!ok || corrupt) return false;
+    }
+  }
+
+  std::shared_ptr<common::IBenchmarkService> service_;
+  TransportOptions options_;
+  common::WorkStealingExecutor* executor_;
+  int listen_fd_ = -1;
+  bool owns_listener_ = false;
+  int epoll_fd_ = -1;
+  int wake_fd_ = -1;
+  std::atomic<bool> stopping_{false};
+  std::thread thread_;
+  std::unordered_map<int, std::shared_ptr<Connection>> connections_;
+};
+
+std::unique_ptr<ServerLoop> CreateEpollLoop(std::shared_ptr<common::IBenchmarkService> service,
+                                            const TransportOptions& options) {
+  return std::make_unique<EpollLoop>(std::move(service), options);
+}
+
+// RawTcpServer implementation
+RawTcpServer::RawTcpServer(std::shared_ptr<common::IBenchmarkService> service,
+                           int num_loops, const TransportOptions& options)
+  : service_(std::move(service)), num_loops_(num_loops), options_(options) {
+  if (num_loops_ <= 0) {
+    // One loop per CPU the server may use, so pinning limits the loops too
+    num_loops_ = static_cast<int>(common::utils::UsableCpus().size());
+    if (num_loops_ <= 0) num_loops_ = std::max(1u, std::thread::hardware_concurrency());
+  }
+}
+
+RawTcpServer::~RawTcpServer() {
+  Stop();
+}
+
+bool RawTcpServer::Start(const std::string& address) {
+  if (running_) return false;
+  if (options_.unix_socket) return StartUnix(address);
+
+  std::string host;
+  uint16_t port = 0;
+  if (!ParseAddress(address, &host, &port)) {
+    std::cerr << "RawTcpServer: invalid address " << address << std::endl;
+    return false;
+  }
+
+  addrinfo hints{};
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  hints.ai_flags = AI_PASSIVE;
+  addrinfo* resolved = nullptr;
+  std::string port_text = std::to_string(port);
+  if (::getaddrinfo(host.empty() ? nullptr : host.c_str(), port_text.c_str(),
+                    &hints, &resolved) != 0 || !resolved) {
+    std::cerr << "RawTcpServer: cannot resolve " << address << std::endl;
+    return false;
+  }
+
+  sockaddr_storage bind_address{};
+  socklen_t bind_length = resolved->ai_addrlen;
+  std::memcpy(&bind_address, resolved->ai_addr, resolved->ai_addrlen);
+  ::freeaddrinfo(resolved);
+
+  for (int i = 0; i < num_loops_; i++) {
+    auto loop = CreateLoop();
+    if (!loop->Listen(reinterpret_cast<sockaddr*>(&bind_address), bind_length)) {
+      loops_.clear();
+      return false;
+    }
+
+    // With port 0 the first loop picks the port and the rest share it
+    if (i == 0 && port == 0) {
+      ::getsockname(loop->listen_fd(), reinterpret_cast<sockaddr*>(&bind_address),
+                    &bind_length);
+    }
+    loops_.push_back(std::move(loop));
+  }
+
+  for (auto& loop : loops_) {
+    loop->Start();
+  }
+  running_ = true;
+  return true;
+}
+
+// Unix sockets have no SO_REUSEPORT sharding, so all loops accept from
+// one listening socket
+bool RawTcpServer::StartUnix(const std::string& address) {
+  sockaddr_un bind_address{};
+  socklen_t bind_length = 0;
+  if (!MakeUnixAddress(address, &bind_address, &bind_length)) {
+    std::cerr << "RawTcpServer: invalid Unix socket address " << address << std::endl;
+    return false;
+  }
+
+  // A stale socket file from an earlier run would make bind() fail
+  if (bind_address.sun_path[0] != '\0') {
+    ::unlink(bind_address.sun_path);
+  }
+
+  listen_fd_ = OpenListener(reinterpret_cast<sockaddr*>(&bind_address), bind_length);
+  if (listen_fd_ < 0) return false;
+
+  for (int i = 0; i < num_loops_; i++) {
+    auto loop = CreateLoop();
+    if (!loop->Share(listen_fd_)) {
+      loops_.clear();
+      ::close(listen_fd_);
+      listen_fd_ = -1;
+      return false;
+    }
+    loops_.push_back(std::move(loop));
+  }
+
+  for (auto& loop : loops_) {
+    loop->Start();
+  }
+  running_ = true;
+  return true;
+}
+
+std::unique_ptr<ServerLoop> RawTcpServer::CreateLoop() {
+  if (options_.engine == ServerEngine::kIoUring) {
+    if (options_.fd_threshold > 0) {
+      std::cerr << "RawTcpServer: memfd passing needs the epoll engine, using epoll"
+                << std::endl;
+    } else if (auto loop = CreateUringLoop(service_, options_)) {
+      return loop;
+    } else {
+      std::cerr << "RawTcpServer: io_uring unavailable (needs Linux 6.1+), using epoll"
+                << std::endl;
+    }
+    // Warn once; the remaining loops go straight to epoll
+    options_.engine = ServerEngine::kEpoll;
+  }
+  return CreateEpollLoop(service_, options_);
+}
+
+void RawTcpServer::Stop() {
+  if (!running_.exchange(false)) return;
+  loops_.clear();
+  if (listen_fd_ >= 0) {
+    ::close(listen_fd_);
+    listen_fd_ = -1;
+  }
+  std::lock_guard<std::mutex> lock(wait_mutex_);
+  wait_cv_.notify_all();
+}
+
+bool RawTcpServer::IsRunning() const {
+  return running_;
+}
+
+void RawTcpServer::Wait() {
+  std::unique_lock<std::mutex> lock(wait_mutex_);
+  wait_cv_.wait(lock, [this] { return !running_; });
+}
+
+// RawTcpFactory implementation
+std::string RawTcpFactory::GetName() const {
+  std::string engine = options_.engine == ServerEngine::kIoUring ? "io_uring" : "epoll";
+  std::string end = options_.handler_pool ? ", handler pool)" : ")";
+  if (!options_.unix_socket) return "RawTCP (" + engine + end;
+  if (options_.fd_threshold == 0) return "UnixSocket (" + engine + end;
+  return "UnixSocket (memfd >= " + common::utils::FormatBytes(options_.fd_threshold) + end;
+}
+
+std::unique_ptr<common::IBenchmarkClient> RawTcpFactory::CreateClient() {
+  return std::make_unique<RawTcpClient>(options_);
+}
+
+std::unique_ptr<common::IBenchmarkServer> RawTcpFactory::CreateServer(
+    std::shared_ptr<common::IBenchmarkService> service) {
+  return std::make_unique<RawTcpServer>(std::move(service), server_loops_, options_);
+}
+
+std::unique_ptr<common::IFrameworkFactory> CreateRawTcpFactory(bool handler_pool) {
+  TransportOptions options;
+  options.handler_pool = handler_pool;
+  return std::make_unique<RawTcpFactory>(options);
+}
+
+std::unique_ptr<common::IFrameworkFactory> CreateUdsFactory(size_t fd_threshold,
+                                                           bool handler_pool) {
+  TransportOptions options;
+  options.unix_socket = true;
+  options.fd_threshold = fd_threshold;
+  options.handler_pool = handler_pool;
+  return std::make_unique<RawTcpFactory>(options);
+}
+
+std::unique_ptr<common::IFrameworkFactory> CreateRawTcpUringFactory(bool handler_pool) {
+  TransportOptions options;
+  options.engine = ServerEngine::kIoUring;
+  options.handler_pool = handler_pool;
+  return std::make_unique<RawTcpFactory>(options);
+}
+
+std::unique_ptr<common::IFrameworkFactory> CreateUdsUringFactory(bool handler_pool) {
+  TransportOptions options;
+  options.unix_socket = true;
+  options.engine = ServerEngine::kIoUring;
+  options.handler_pool = handler_pool;
+  return std::make_unique<RawTcpFactory>(options);
+}
+
+} // namespace rawtcp
+} // namespace benchmark
@@ -0,0 +1,48 @@
+#pragma once
+
+#include "rawtcp_framework.h"
+#include <memory>
+#include <sys/socket.h>
+
+namespace benchmark {
+namespace rawtcp {
+
+// Server threads stop queueing output for a connection and wait for the
+// socket to drain past this much unsent data, which bounds memory for
+// long server streams
+constexpr size_t kHighWatermark = 4 * 1024 * 1024;
+
+// Non-blocking listening socket bound to `address`; TCP listeners get
+// SO_REUSEPORT and TCP_NODELAY, which accepted sockets inherit. Returns -1
+// on failure.
+int OpenListener(const sockaddr* address, socklen_t length);
+
+// One server thread and the connections it accepted. RawTcpServer runs one
+// loop per core; the engines differ only in how they wait for and perform
+// socket I/O.
+class ServerLoop {
+public:
+  virtual ~ServerLoop() = default;
+
+  // Accept on a listening socket of this loop's own at the shared address
+  virtual bool Listen(const sockaddr* address, socklen_t length) = 0;
+
+  // Accept from a listening socket owned by the server and shared by all
+  // loops
+  virtual bool Share(int listen_fd) = 0;
+
+  virtual int listen_fd() const = 0;
+
+  virtual void Start() = 0;
+  virtual void Stop() = 0;
+};
+
+std::unique_ptr<ServerLoop> CreateEpollLoop(std::shared_ptr<common::IBenchmarkService> service,
+                                            const TransportOptions& options);
+
+// Null when the kernel lacks what the io_uring engine needs (Linux 6.1+)
+std::unique_ptr<ServerLoop> CreateUringLoop(std::shared_ptr<common::IBenchmarkService> service,
+                                            const TransportOptions& options);
+
+} // namespace rawtcp
+} // namespace benchmark
@@ -0,0 +1,863 @@
+// io_uring engine of the raw TCP server: multishot accept into direct
+// descriptors, multishot recv from a provided buffer ring, writes from
+// registered buffers, and one io_uring_enter() per loop turn that submits
+// all queued work and waits for completions. Uses the raw system calls, so
+// it needs no liburing.
+
+#include "server_loop.h"
+#include "work_stealing_executor.h"
+#include <algorithm>
+#include <cerrno>
+#include <condition_variable>
+#include <csignal>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <pthread.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#if defined(__linux__) && __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#endif
+
+namespace benchmark {
+namespace rawtcp {
+
+// DEFER_TASKRUN is the newest feature used, so headers without it cannot
+// build this engine and the server falls back to epoll
+#if defined(IORING_SETUP_DEFER_TASKRUN) && defined(IORING_RECV_MULTISHOT)
+
+using common::wire::FrameHeader;
+using common::wire::MessageType;
+
+namespace {
+
+constexpr unsigned kSubmissionEntries = 256;
+constexpr unsigned kCompletionEntries = 4096;
+
+// Direct descriptor table: slot 0 holds the listener, accepted sockets
+// take the rest
+constexpr unsigned kMaxFiles = 4096;
+constexpr unsigned kListenerSlot = 0;
+
+// Provided receive buffers shared by all connections of a loop
+constexpr unsigned kRecvBufferCount = 256;  // Power of two
+constexpr size_t kRecvBufferSize = 16 * 1024;
+constexpr uint16_t kRecvBufferGroup = 0;
+
+// Registered send buffers. Output that fits is copied into a free slab
+// and written with WRITE_FIXED; larger output is sent from the heap.
+constexpr unsigned kSendSlabCount = 64;
+constexpr size_t kSendSlabSize = 64 * 1024;
+
+// Operation in the top byte of user_data; the low bits hold the slot
+enum Op : uint64_t { kAccept = 1, kRecv, kSend, kClose, kWake, kCancel, kTimeout };
+
+uint64_t Tag(Op op, uint32_t slot) {
+  return (static_cast<uint64_t>(op) << 56) | slot;
+}
+
+Op OpOf(uint64_t user_data) {
+  return static_cast<Op>(user_data >> 56);
+}
+
+uint32_t SlotOf(uint64_t user_data) {
+  return static_cast<uint32_t>(user_data);
+}
+
+int Setup(unsigned entries, io_uring_params* params) {
+  return static_cast<int>(::syscall(__NR_io_uring_setup, entries, params));
+}
+
+int Enter(int ring_fd, unsigned to_submit, unsigned min_complete, unsigned flags) {
+  return static_cast<int>(
+      ::syscall(__NR_io_uring_enter, ring_fd, to_submit, min_complete, flags, nullptr, 0));
+}
+
+int Register(int ring_fd, unsigned opcode, const void* arg, unsigned nr_args) {
+  return static_cast<int>(::syscall(__NR_io_uring_register, ring_fd, opcode, arg, nr_args));
+}
+
+} // namespace
+
+class UringLoop;
+
+// A connection on a direct descriptor. Service callbacks on other threads
+// may only queue output; the loop thread submits it.
+struct UringConnection : public common::wire::FrameSender,
+                         public std::enable_shared_from_this<UringConnection> {
+  UringLoop* loop = nullptr;
+  uint32_t slot = 0;
+  common::wire::FrameBuffer in;
+
+  // Reset on close, which breaks its reference back to this connection
+  std::unique_ptr<common::wire::ServiceDispatcher> dispatcher;
+
+  // Loop thread only
+  bool recv_armed = false;
+  bool closing = false;
+  bool cancel_sent = false;
+
+  // Frames collect in `out` until the loop submits them. The write in
+  // flight comes from a send slab or, when larger, from `sending`.
+  std::mutex out_mutex;
+  std::condition_variable drained;
+  std::string out;
+  std::string sending;
+  int send_slab = -1;
+  size_t send_size = 0;
+  size_t send_offset = 0;
+  bool send_in_flight = false;
+  bool scheduled = false;
+  bool closed = false;
+
+  size_t PendingLocked() const { return out.size() + send_size - send_offset; }
+
+  bool SendFrame(MessageType type, uint32_t call_id, size_t body_size,
+                 const common::wire::BodyEncoder& encode) override;
+};
+
+// Completion-based engine. All submissions come from the loop thread
+// (IORING_SETUP_SINGLE_ISSUER), and completions are only processed when
+// it enters the kernel (IORING_SETUP_DEFER_TASKRUN).
+class UringLoop : public ServerLoop {
+public:
+  UringLoop(std::shared_ptr<common::IBenchmarkService> service,
+            common::WorkStealingExecutor* executor)
+    : service_(std::move(service)), executor_(executor), conns_(kMaxFiles) {}
+
+  ~UringLoop() override {
+    Stop();
+    Destroy();
+  }
+
+  // Create the ring and register files and buffers. The ring starts
+  // disabled and is enabled by the loop thread, which becomes its only
+  // submitter.
+  bool Init() {
+    io_uring_params params{};
+    params.flags = IORING_SETUP_SINGLE_ISSUER | IORING_SETUP_DEFER_TASKRUN |
+                   IORING_SETUP_CQSIZE | IORING_SETUP_SUBMIT_ALL | IORING_SETUP_R_DISABLED;
+    params.cq_entries = kCompletionEntries;
+    ring_fd_ = Setup(kSubmissionEntries, &params);
+    if (ring_fd_ < 0) return false;
+    if (!(params.features & IORING_FEAT_SINGLE_MMAP) || !(params.features & IORING_FEAT_NODROP)) {
+      return false;
+    }
+
+    // Submission and completion rings share one mapping
+    ring_size_ = std::max<size_t>(params.sq_off.array + params.sq_entries * sizeof(unsigned),
+                                  params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe));
+    void* ring = ::mmap(nullptr, ring_size_, PROT_READ | PROT_WRITE,
+                        MAP_SHARED | MAP_POPULATE, ring_fd_, IORING_OFF_SQ_RING);
+    if (ring == MAP_FAILED) return false;
+    ring_ = static_cast<uint8_t*>(ring);
+
+    sqes_size_ = params.sq_entries * sizeof(io_uring_sqe);
+    void* sqes = ::mmap(nullptr, sqes_size_, PROT_READ | PROT_WRITE,
+                        MAP_SHARED | MAP_POPULATE, ring_fd_, IORING_OFF_SQES);
+    if (sqes == MAP_FAILED) return false;
+    sqes_ = static_cast<io_uring_sqe*>(sqes);
+
+    sq_head_ = reinterpret_cast<unsigned*>(ring_ + params.sq_off.head);
+    sq_tail_ = reinterpret_cast<unsigned*>(ring_ + params.sq_off.tail);
+    sq_mask_ = *reinterpret_cast<unsigned*>(ring_ + params.sq_off.ring_mask);
+    sq_entries_ = params.sq_entries;
+    cq_head_ = reinterpret_cast<unsigned*>(ring_ + params.cq_off.head);
+    cq_tail_ = reinterpret_cast<unsigned*>(ring_ + params.cq_off.tail);
+    cq_mask_ = *reinterpret_cast<unsigned*>(ring_ + params.cq_off.ring_mask);
+    cqes_ = reinterpret_cast<io_uring_cqe*>(ring_ + params.cq_off.cqes);
+
+    // Submission slots map one to one onto the SQE array
+    auto* array = reinterpret_cast<unsigned*>(ring_ + params.sq_off.array);
+    for (unsigned i = 0; i < sq_entries_; i++) {
+      array[i] = i;
+    }
+    local_tail_ = *sq_tail_;
+
+    return RegisterFiles() && RegisterRecvBuffers() && RegisterSendSlabs();
+  }
+
+  bool Listen(const sockaddr* address, socklen_t length) override {
+    listen_fd_ = OpenListener(address, length);
+    if (listen_fd_ < 0) return false;
+    owns_listener_ = true;
+    return RegisterListener();
+  }
+
+  bool Share(int listen_fd) override {
+    listen_fd_ = listen_fd;
+    owns_listener_ = false;
+    return RegisterListener();
+  }
+
+  int listen_fd() const override { return listen_fd_; }
+
+  void Start() override {
+    wake_fd_ = ::eventfd(0, EFD_CLOEXEC);
+    thread_ = std::thread([this]() { Run(); });
+  }
+
+  void Stop() override {
+    if (thread_.joinable()) {
+      stopping_ = true;
+      Wake();
+      thread_.join();
+    }
+    for (auto& conn : conns_) {
+      if (!conn) continue;
+      {
+        std::lock_guard<std::mutex> lock(conn->out_mutex);
+        conn->closed = true;
+      }
+      conn->drained.notify_all();
+      conn->dispatcher.reset();
+      conn.reset();
+    }
+  }
+
+  // Queue `conn` for submission of its output
+  void Schedule(const std::shared_ptr<UringConnection>& conn) {
+    if (std::this_thread::get_id() == loop_thread_) {
+      ready_.push_back(conn);
+      return;
+    }
+
+    bool wake = false;
+    {
+      std::lock_guard<std::mutex> lock(remote_mutex_);
+      wake = remote_.empty();
+      remote_.push_back(conn);
+    }
+    if (wake) Wake();
+  }
+
+  // Block the caller until the connection has less than kHighWatermark
+  // unsent. The loop thread cannot sleep, so it keeps completing writes.
+  void WaitForRoom(UringConnection* conn) {
+    if (std::this_thread::get_id() != loop_thread_) {
+      std::unique_lock<std::mutex> lock(conn->out_mutex);
+      conn->drained.wait(lock, [conn] {
+        return conn->closed || conn->PendingLocked() < kHighWatermark;
+      });
+      return;
+    }
+
+    while (!stopping_) {
+      {
+        std::lock_guard<std::mutex> lock(conn->out_mutex);
+        if (conn->closed || conn->PendingLocked() < kHighWatermark) return;
+      }
+      SubmitReady();
+      if (EnterAndWait() < 0) return;
+
+      // Other completions wait their turn so frames of a connection are
+      // still dispatched in order
+      io_uring_cqe cqe;
+      while (PopCompletion(&cqe)) {
+        if (OpOf(cqe.user_data) == kSend) {
+          Handle(cqe);
+        } else {
+          deferred_.push_back(cqe);
+        }
+      }
+    }
+  }
+
+private:
+  bool RegisterFiles() {
+    io_uring_rsrc_register files{};
+    files.nr = kMaxFiles;
+    files.flags = IORING_RSRC_REGISTER_SPARSE;
+    if (Register(ring_fd_, IORING_REGISTER_FILES2, &files, sizeof(files)) < 0) return false;
+
+    io_uring_file_index_range range{};
+    range.off = kListenerSlot + 1;
+    range.len = kMaxFiles - range.off;
+    return Register(ring_fd_, IORING_REGISTER_FILE_ALLOC_RANGE, &range, 0) == 0;
+  }
+
+  bool RegisterListener() {
+    int fd = listen_fd_;
+    io_uring_files_update update{};
+    update.offset = kListenerSlot;
+    update.fds = reinterpret_cast<uint64_t>(&fd);
+    return Register(ring_fd_, IORING_REGISTER_FILES_UPDATE, &update, 1) == 1;
+  }
+
+  bool RegisterRecvBuffers() {
+    buf_ring_size_ = kRecvBufferCount * sizeof(io_uring_buf);
+    void* ring = ::mmap(nullptr, buf_ring_size_, PROT_READ | PROT_WRITE,
+                        MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (ring == MAP_FAILED) return false;
+    buf_ring_ = static_cast<io_uring_buf_ring*>(ring);
+
+    recv_buffers_.resize(kRecvBufferCount * kRecvBufferSize);
+    for (unsigned i = 0; i < kRecvBufferCount; i++) {
+      AddRecvBuffer(static_cast<uint16_t>(i));
+    }
+    PublishRecvBuffers();
+
+    io_uring_buf_reg reg{};
+    reg.ring_addr = reinterpret_cast<uint64_t>(buf_ring_);
+    reg.ring_entries = kRecvBufferCount;
+    reg.bgid = kRecvBufferGroup;
+    return Register(ring_fd_, IORING_REGISTER_PBUF_RING, &reg, 1) == 0;
+  }
+
+  // Pinned memory counts against RLIMIT_MEMLOCK; without it every write
+  // goes out as a plain send
+  bool RegisterSendSlabs() {
+    slabs_size_ = kSendSlabCount * kSendSlabSize;
+    void* slabs = ::mmap(nullptr, slabs_size_, PROT_READ | PROT_WRITE,
+                         MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (slabs == MAP_FAILED) return true;
+    slabs_ = static_cast<uint8_t*>(slabs);
+
+    iovec region{slabs_, slabs_size_};
+    if (Register(ring_fd_, IORING_REGISTER_BUFFERS, &region, 1) != 0) {
+      ::munmap(slabs_, slabs_size_);
+      slabs_ = nullptr;
+      return true;
+    }
+    for (unsigned i = 0; i < kSendSlabCount; i++) {
+      free_slabs_.push_back(static_cast<int>(i));
+    }
+    return true;
+  }
+
+  void Destroy() {
+    if (ring_) ::munmap(ring_, ring_size_);
+    if (sqes_) ::munmap(sqes_, sqes_size_);
+    if (ring_fd_ >= 0) ::close(ring_fd_);
+    if (buf_ring_) ::munmap(buf_ring_, buf_ring_size_);
+    if (slabs_) ::munmap(slabs_, slabs_size_);
+    if (owns_listener_ && listen_fd_ >= 0) ::close(listen_fd_);
+    if (wake_fd_ >= 0) ::close(wake_fd_);
+  }
+
+  void Wake() {
+    uint64_t one = 1;
+    ssize_t ignored = ::write(wake_fd_, &one, sizeof(one));
+    (void)ignored;
+  }
+
+  void AddRecvBuffer(uint16_t id) {
+    // Not buf_ring_->bufs: in C++ the header's flexible array member starts
+    // after an empty struct, 8 bytes past where the kernel expects it
+    io_uring_buf* buf = reinterpret_cast<io_uring_buf*>(buf_ring_) +
+                        (buf_tail_ & (kRecvBufferCount - 1));
+    buf->addr = reinterpret_cast<uint64_t>(&recv_buffers_[id * kRecvBufferSize]);
+    buf->len = kRecvBufferSize;
+    buf->bid = id;
+    buf_tail_++;
+  }
+
+  void PublishRecvBuffers() {
+    __atomic_store_n(&buf_ring_->tail, buf_tail_, __ATOMIC_RELEASE);
+  }
+
+  // Next free submission entry, flushing the ring to the kernel when full
+  io_uring_sqe* NextSqe() {
+    for (int attempt = 0; attempt < 2; attempt++) {
+      unsigned head = __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE);
+      if (local_tail_ - head < sq_entries_) {
+        io_uring_sqe* sqe = &sqes_[local_tail_ & sq_mask_];
+        std::memset(sqe, 0, sizeof(*sqe));
+        local_tail_++;
+        inflight_++;
+        return sqe;
+      }
+      Submit(0, 0);
+    }
+    return nullptr;
+  }
+
+  int Submit(unsigned min_complete, unsigned flags) {
+    __atomic_store_n(sq_tail_, local_tail_, __ATOMIC_RELEASE);
+    unsigned pending = local_tail_ - __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE);
+    if (pending == 0 && min_complete == 0) return 0;
+    return Enter(ring_fd_, pending, min_complete, flags);
+  }
+
+  // Submit everything queued and wait for at least one completion; the
+  // only system call of a loop turn
+  int EnterAndWait() {
+    int result = Submit(1, IORING_ENTER_GETEVENTS);
+    if (result < 0 && (errno == EINTR || errno == EAGAIN || errno == EBUSY)) return 0;
+    return result;
+  }
+
+  bool PopCompletion(io_uring_cqe* cqe) {
+    unsigned head = *cq_head_;
+    if (head == __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE)) return false;
+    *cqe = cqes_[head & cq_mask_];
+    __atomic_store_n(cq_head_, head + 1, __ATOMIC_RELEASE);
+    if (!(cqe->flags & IORING_CQE_F_MORE)) inflight_--;
+    return true;
+  }
+
+  void ProcessCompletions() {
+    while (true) {
+      io_uring_cqe cqe;
+      if (!deferred_.empty()) {
+        cqe = deferred_.front();
+        deferred_.pop_front();
+      } else if (!PopCompletion(&cqe)) {
+        break;
+      }
+      Handle(cqe);
+    }
+    PublishRecvBuffers();
+  }
+
+  void Run() {
+    loop_thread_ = std::this_thread::get_id();
+
+    // WRITE_FIXED has no MSG_NOSIGNAL, and writes run on this thread, so a
+    // peer that went away must not raise SIGPIPE here
+    sigset_t pipe_signal;
+    sigemptyset(&pipe_signal);
+    sigaddset(&pipe_signal, SIGPIPE);
+    pthread_sigmask(SIG_BLOCK, &pipe_signal, nullptr);
+
+    if (Register(ring_fd_, IORING_REGISTER_ENABLE_RINGS, nullptr, 0) != 0 ||
+        !ArmAccept() || !ArmWake()) {
+      std::cerr << "RawTcpServer: cannot start io_uring loop: " << std::strerror(errno)
+                << std::endl;
+      return;
+    }
+
+    while (!stopping_) {
+      TakeRemote();
+      SubmitReady();
+      FinishClosing();
+      if (EnterAndWait() < 0) {
+        std::cerr << "RawTcpServer: io_uring_enter failed: " << std::strerror(errno)
+                  << std::endl;
+        break;
+      }
+      ProcessCompletions();
+    }
+    Drain();
+  }
+
+  // Cancel everything in flight and wait, for at most a second, until the
+  // kernel no longer refers to connection or loop memory
+  void Drain() {
+    stopping_ = true;
+    for (auto& conn : conns_) {
+      if (conn) Close(conn);
+    }
+
+    io_uring_sqe* cancel = NextSqe();
+    if (cancel) {
+      cancel->opcode = IORING_OP_ASYNC_CANCEL;
+      cancel->cancel_flags = IORING_ASYNC_CANCEL_ANY;
+      cancel->user_data = Tag(kCancel, 0);
+    }
+    io_uring_sqe* timeout = NextSqe();
+    if (timeout) {
+      timeout->opcode = IORING_OP_TIMEOUT;
+      timeout->addr = reinterpret_cast<uint64_t>(&drain_timeout_);
+      timeout->len = 1;
+      timeout->user_data = Tag(kTimeout, 0);
+    }
+
+    while (inflight_ > 1 && !timed_out_) {
+      FinishClosing();
+      if (EnterAndWait() < 0) break;
+      ProcessCompletions();
+    }
+  }
+
+  void TakeRemote() {
+    std::lock_guard<std::mutex> lock(remote_mutex_);
+    for (auto& conn : remote_) {
+      ready_.push_back(std::move(conn));
+    }
+    remote_.clear();
+  }
+
+  void SubmitReady() {
+    for (auto& conn : ready_) {
+      std::lock_guard<std::mutex> lock(conn->out_mutex);
+      conn->scheduled = false;
+      if (!conn->send_in_flight && !conn->out.empty() && !conn->closed) {
+        StartSendLocked(conn.get());
+      }
+    }
+    ready_.clear();
+  }
+
+  // Move queued output into a write. Small output is copied into a
+  // registered slab, larger output is sent from the string it was encoded
+  // into.
+  void StartSendLocked(UringConnection* conn) {
+    conn->send_slab = -1;
+    if (conn->out.size() <= kSendSlabSize && !free_slabs_.empty()) {
+      conn->send_slab = free_slabs_.back();
+      free_slabs_.pop_back();
+      std::memcpy(SlabData(conn->send_slab), conn->out.data(), conn->out.size());
+      conn->send_size = conn->out.size();
+    } else {
+      conn->sending.swap(conn->out);
+      conn->send_size = conn->sending.size();
+    }
+    conn->out.clear();
+    conn->send_offset = 0;
+    SubmitSendLocked(conn);
+  }
+
+  void SubmitSendLocked(UringConnection* conn) {
+    io_uring_sqe* sqe = NextSqe();
+    if (!sqe) {
+      conn->closed = true;
+      return;
+    }
+
+    const uint8_t* data = conn->send_slab >= 0
+                              ? SlabData(conn->send_slab)
+                              : reinterpret_cast<const uint8_t*>(conn->sending.data());
+    sqe->fd = static_cast<int>(conn->slot);
+    sqe->flags = IOSQE_FIXED_FILE;
+    sqe->addr = reinterpret_cast<uint64_t>(data + conn->send_offset);
+    sqe->len = static_cast<uint32_t>(
+        std::min<size_t>(conn->send_size - conn->send_offset, UINT32_MAX));
+    sqe->user_data = Tag(kSend, conn->slot);
+    if (conn->send_slab >= 0) {
+      sqe->opcode = IORING_OP_WRITE_FIXED;
+      sqe->buf_index = 0;
+    } else {
+      sqe->opcode = IORING_OP_SEND;
+      sqe->msg_flags = MSG_NOSIGNAL;
+    }
+    conn->send_in_flight = true;
+  }
+
+  uint8_t* SlabData(int slab) { return slabs_ + static_cast<size_t>(slab) * kSendSlabSize; }
+
+  bool ArmAccept() {
+    io_uring_sqe* sqe = NextSqe();
+    if (!sqe) return false;
+    sqe->opcode = IORING_OP_ACCEPT;
+    sqe->fd = static_cast<int>(kListenerSlot);
+    sqe->flags = IOSQE_FIXED_FILE;
+    sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+    sqe->file_index = IORING_FILE_INDEX_ALLOC;
+    sqe->user_data = Tag(kAccept, 0);
+    return true;
+  }
+
+  bool ArmWake() {
+    io_uring_sqe* sqe = NextSqe();
+    if (!sqe) return false;
+    sqe->opcode = IORING_OP_READ;
+    sqe->fd = wake_fd_;
+    sqe->addr = reinterpret_cast<uint64_t>(&wake_value_);
+    sqe->len = sizeof(wake_value_);
+    sqe->user_data = Tag(kWake, 0);
+    return true;
+  }
+
+  bool ArmRecv(UringConnection* conn) {
+    io_uring_sqe* sqe = NextSqe();
+    if (!sqe) return false;
+    sqe->opcode = IORING_OP_RECV;
+    sqe->fd = static_cast<int>(conn->slot);
+    sqe->flags = IOSQE_FIXED_FILE | IOSQE_BUFFER_SELECT;
+    sqe->ioprio = IORING_RECV_MULTISHOT;
+    sqe->buf_group = kRecvBufferGroup;
+    sqe->user_data = Tag(kRecv, conn->slot);
+    conn->recv_armed = true;
+    return true;
+  }
+
+  void Handle(const io_uring_cqe& cqe) {
+    switch (OpOf(cqe.user_data)) {
+      case kAccept:
+        HandleAccept(cqe);
+        break;
+      case kRecv:
+        HandleRecv(cqe);
+        break;
+      case kSend:
+        HandleSend(cqe);
+        break;
+      case kWake:
+        if (!stopping_) ArmWake();
+        break;
+      case kTimeout:
+        timed_out_ = true;
+        break;
+      case kClose:
+      case kCancel:
+        break;
+    }
+  }
+
+  void HandleAccept(const io_uring_cqe& cqe) {
+    bool armed = cqe.flags & IORING_CQE_F_MORE;
+    if (cqe.res >= 0) {
+      auto conn = std::make_shared<UringConnection>();
+      conn->loop = this;
+      conn->slot = static_cast<uint32_t>(cqe.res);
+      conns_[conn->slot] = conn;
+      if (stopping_) {
+        Close(conn);
+      } else {
+        conn->dispatcher =
+            std::make_unique<common::wire::ServiceDispatcher>(service_, conn, executor_);
+        if (!ArmRecv(conn.get())) Close(conn);
+      }
+    } else if (cqe.res == -EINVAL) {
+      std::cerr << "RawTcpServer: io_uring accept failed: " << std::strerror(-cqe.res)
+                << std::endl;
+      return;
+    }
+    if (!armed && !stopping_) ArmAccept();
+  }
+
+  void HandleRecv(const io_uring_cqe& cqe) {
+    if (cqe.flags & IORING_CQE_F_BUFFER) {
+      // Copied out right away, so the buffer can go straight back
+      uint16_t id = static_cast<uint16_t>(cqe.flags >> IORING_CQE_BUFFER_SHIFT);
+      auto conn = conns_[SlotOf(cqe.user_data)];
+      if (conn && cqe.res > 0) {
+        size_t size = static_cast<size_t>(cqe.res);
+        size_t available = 0;
+        uint8_t* space = conn->in.WritableSpace(size, &available);
+        std::memcpy(space, &recv_buffers_[id * kRecvBufferSize], size);
+        conn->in.Commit(size);
+      }
+      AddRecvBuffer(id);
+    }
+
+    auto conn = conns_[SlotOf(cqe.user_data)];
+    if (!conn) return;
+    if (!(cqe.flags & IORING_CQE_F_MORE)) conn->recv_armed = false;
+
+    if (cqe.res == 0 || (cqe.res < 0 && cqe.res != -ENOBUFS)) {
+      Close(conn);
+      return;
+    }
+    if (cqe.res > 0 && !conn->closing && !DispatchFrames(conn.get())) {
+      Close(conn);
+      return;
+    }
+    if (!conn->recv_armed && !conn->closing && !stopping_ && !ArmRecv(conn.get())) {
+      Close(conn);
+    }
+  }
+
+  // Dispatch every complete frame. Responses are queued and go out with
+  // the next submission, batched with those of other connections.
+  bool DispatchFrames(UringConnection* conn) {
+    FrameHeader header;
+    const uint8_t* body = nullptr;
+    bool corrupt = false;
+    while (!conn->closing && conn->in.NextFrame(&header, &body, &corrupt)) {
+      // Bodies in memfds need descriptors, which this engine does not
+      // receive
+      bool ok = !(header.flags & common::wire::kFlagBodyInFd) &&
+                conn->dispatcher->Dispatch(header, body);
+      conn->in.Consume();
+      if (!ok) return false;
+    }
+    return !corrupt;
+  }
+
+  void HandleSend(const io_uring_cqe& cqe) {
+    auto conn = conns_[SlotOf(cqe.user_data)];
+    if (!conn) return;
+
+    bool failed = false;
+    {
+      std::lock_guard<std::mutex> lock(conn->out_mutex);
+      conn->send_in_flight = false;
+      if (cqe.res <= 0 || conn->closed) {
+        failed = true;
+      } else {
+        conn->send_offset += static_cast<size_t>(cqe.res);
+      }
+
+      if (!failed && conn->send_offset < conn->send_size) {
+        SubmitSendLocked(conn.get());
+      } else {
+        if (conn->send_slab >= 0) free_slabs_.push_back(conn->send_slab);
+        conn->send_slab = -1;
+        conn->sending.clear();
+        conn->send_size = 0;
+        conn->send_offset = 0;
+        if (failed) {
+          conn->closed = true;
+        } else if (!conn->out.empty()) {
+          StartSendLocked(conn.get());
+        }
+      }
+      failed = conn->closed;
+    }
+    conn->drained.notify_all();
+    if (failed) Close(conn);
+  }
+
+  // Mark the connection closed. Teardown waits for the next loop turn
+  // because this may run inside its own dispatcher.
+  void Close(const std::shared_ptr<UringConnection>& conn) {
+    if (conn->closing) return;
+    conn->closing = true;
+    {
+      std::lock_guard<std::mutex> lock(conn->out_mutex);
+      conn->closed = true;
+    }
+    conn->drained.notify_all();
+    closing_.push_back(conn);
+  }
+
+  // Cancel what is still in flight on closing connections, then close the
+  // descriptors of those with nothing left
+  void FinishClosing() {
+    for (auto it = closing_.begin(); it != closing_.end();) {
+      auto& conn = *it;
+      conn->dispatcher.reset();
+
+      bool busy = false;
+      {
+        std::lock_guard<std::mutex> lock(conn->out_mutex);
+        busy = conn->recv_armed || conn->send_in_flight;
+      }
+      if (busy) {
+        if (!conn->cancel_sent) {
+          io_uring_sqe* sqe = NextSqe();
+          if (sqe) {
+            sqe->opcode = IORING_OP_ASYNC_CANCEL;
+            sqe->fd = static_cast<int>(conn->slot);
+            sqe->cancel_flags = IORING_ASYNC_CANCEL_FD | IORING_ASYNC_CANCEL_FD_FIXED |
+                                IORING_ASYNC_CANCEL_ALL;
+            sqe->user_data = Tag(kCancel, conn->slot);
+            conn->cancel_sent = true;
+          }
+        }
+        ++it;
+        continue;
+      }
+
+      io_uring_sqe* sqe = NextSqe();
+      if (!sqe) {
+        ++it;
+        continue;
+      }
+      sqe->opcode = IORING_OP_CLOSE;
+      sqe->file_index = conn->slot + 1;
+      sqe->user_data = Tag(kClose, conn->slot);
+      conns_[conn->slot].reset();
+      it = closing_.erase(it);
+    }
+  }
+
+  std::shared_ptr<common::IBenchmarkService> service_;
+  common::WorkStealingExecutor* executor_;
+  int listen_fd_ = -1;
+  bool owns_listener_ = false;
+  int wake_fd_ = -1;
+  uint64_t wake_value_ = 0;
+  std::atomic<bool> stopping_{false};
+  std::thread thread_;
+  std::thread::id loop_thread_;
+
+  // Ring mappings
+  int ring_fd_ = -1;
+  uint8_t* ring_ = nullptr;
+  size_t ring_size_ = 0;
+  io_uring_sqe* sqes_ = nullptr;
+  size_t sqes_size_ = 0;
+  unsigned* sq_head_ = nullptr;
+  unsigned* sq_tail_ = nullptr;
+  unsigned sq_mask_ = 0;
+  unsigned sq_entries_ = 0;
+  unsigned local_tail_ = 0;
+  unsigned* cq_head_ = nullptr;
+  unsigned* cq_tail_ = nullptr;
+  unsigned cq_mask_ = 0;
+  io_uring_cqe* cqes_ = nullptr;
+
+  // Operations whose last completion has not arrived yet
+  size_t inflight_ = 0;
+  __kernel_timespec drain_timeout_{1, 0};
+  bool timed_out_ = false;
+
+  // Provided receive buffers
+  io_uring_buf_ring* buf_ring_ = nullptr;
+  size_t buf_ring_size_ = 0;
+  uint16_t buf_tail_ = 0;
+  std::vector<uint8_t> recv_buffers_;
+
+  // Registered send slabs
+  uint8_t* slabs_ = nullptr;
+  size_t slabs_size_ = 0;
+  std::vector<int> free_slabs_;
+
+  // Connections by direct descriptor slot
+  std::vector<std::shared_ptr<UringConnection>> conns_;
+  std::vector<std::shared_ptr<UringConnection>> ready_;
+  std::vector<std::shared_ptr<UringConnection>> closing_;
+  std::deque<io_uring_cqe> deferred_;
+
+  std::mutex remote_mutex_;
+  std::vector<std::shared_ptr<UringConnection>> remote_;
+};
+
+bool UringConnection::SendFrame(MessageType type, uint32_t call_id, size_t body_size,
+                                const common::wire::BodyEncoder& encode) {
+  bool schedule = false;
+  bool full = false;
+  {
+    std::lock_guard<std::mutex> lock(out_mutex);
+    if (closed) return false;
+
+    size_t offset = out.size();
+    out.resize(offset + common::wire::kFrameHeaderSize + body_size);
+    uint8_t* frame = reinterpret_cast<uint8_t*>(&out[offset]);
+    common::wire::WriteFrameHeader(frame, type, call_id, static_cast<uint32_t>(body_size));
+    common::wire::WireWriter writer(frame + common::wire::kFrameHeaderSize, body_size);
+    encode(&writer);
+
+    schedule = !scheduled;
+    scheduled = true;
+    full = PendingLocked() >= kHighWatermark;
+  }
+
+  if (schedule) loop->Schedule(shared_from_this());
+  if (full) loop->WaitForRoom(this);
+
+  std::lock_guard<std::mutex> lock(out_mutex);
+  return !closed;
+}
+
+// Both socket families work the same way here, and memfd passing is
+// refused by the server before it gets this far
+std::unique_ptr<ServerLoop> CreateUringLoop(std::shared_ptr<common::IBenchmarkService> service,
+                                            const TransportOptions& options) {
+  auto loop = std::make_unique<UringLoop>(
+      std::move(service),
+      options.handler_pool ? &common::WorkStealingExecutor::Shared() : nullptr);
+  if (!loop->Init()) return nullptr;
+  return loop;
+}
+
+#else
+
+std::unique_ptr<ServerLoop> CreateUringLoop(std::shared_ptr<common::IBenchmarkService>,
+                                            const TransportOptions&) {
+  return nullptr;
+}
+
+#endif
+
+} // namespace rawtcp
+} // namespace benchmark
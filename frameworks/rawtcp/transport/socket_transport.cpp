@@ -0,0 +1,284 @@
+// Socket helpers shared by the raw TCP and Unix socket client and server,
+// including memfd payload passing over Unix sockets
+
+#include "socket_transport.h"
+#include <cerrno>
+#include <cstring>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace benchmark {
+namespace rawtcp {
+
+namespace {
+
+// Descriptors one recvmsg() can return; a Unix stream read stops after
+// the first message that carries any, so one per frame is the norm
+constexpr size_t kMaxPassedFds = 16;
+
+// Mappings kept per connection and side. Each holds on to the pages of a
+// body; pipelined calls need one per body in flight, so both the count
+// and the retained bytes are bounded.
+constexpr size_t kMaxCachedMemfds = 64;
+constexpr size_t kMaxCachedBytes = 64 * 1024 * 1024;
+
+} // namespace
+
+bool MakeUnixAddress(const std::string& address, sockaddr_un* result, socklen_t* length) {
+  std::memset(result, 0, sizeof(*result));
+  result->sun_family = AF_UNIX;
+
+  if (!address.empty() && address[0] == '/') {
+    if (address.size() >= sizeof(result->sun_path)) return false;
+    std::memcpy(result->sun_path, address.data(), address.size());
+    *length = static_cast<socklen_t>(offsetof(sockaddr_un, sun_path) + address.size() + 1);
+    return true;
+  }
+
+  // Abstract names start with a NUL byte and are not NUL-terminated
+  std::string name = "proto-bench-uds:" + address;
+  if (name.size() + 1 > sizeof(result->sun_path)) return false;
+  std::memcpy(result->sun_path + 1, name.data(), name.size());
+  *length = static_cast<socklen_t>(offsetof(sockaddr_un, sun_path) + 1 + name.size());
+  return true;
+}
+
+// MemfdCache implementation
+MemfdCache::~MemfdCache() {
+  for (auto& entry : entries_) {
+    ::munmap(entry.data, entry.size);
+    if (entry.fd >= 0) ::close(entry.fd);
+  }
+}
+
+int MemfdCache::Write(size_t body_size, const common::wire::BodyEncoder& encode) {
+  Entry* entry = nullptr;
+  uint8_t* data = nullptr;
+  int fd = -1;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto& candidate : entries_) {
+      if (candidate.fd >= 0 && !candidate.busy && candidate.size >= body_size &&
+          (!entry || candidate.size < entry->size)) {
+        entry = &candidate;
+      }
+    }
+    if (entry) {
+      fd = entry->fd;
+      data = entry->data;
+      entry->fd = -1;
+      entry->busy = true;
+      entry->last_use = ++clock_;
+    }
+  }
+
+  if (!data) {
+    fd = ::memfd_create("proto-bench-body", MFD_CLOEXEC);
+    if (fd < 0) return -1;
+
+    void* mapped = MAP_FAILED;
+    struct stat info{};
+    if (::ftruncate(fd, static_cast<off_t>(body_size)) == 0 && ::fstat(fd, &info) == 0) {
+      mapped = ::mmap(nullptr, body_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+    if (mapped == MAP_FAILED) {
+      ::close(fd);
+      return -1;
+    }
+    data = static_cast<uint8_t*>(mapped);
+
+    Entry created;
+    created.inode = info.st_ino;
+    created.data = data;
+    created.size = body_size;
+    created.busy = true;
+    std::lock_guard<std::mutex> lock(mutex_);
+    AddLocked(created);
+  }
+
+  // Entries are never evicted while busy, so the mapping stays valid
+  common::wire::WireWriter writer(data, body_size);
+  encode(&writer);
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (auto& candidate : entries_) {
+    if (candidate.data == data) candidate.busy = false;
+  }
+  return fd;
+}
+
+const uint8_t* MemfdCache::Map(int fd, size_t body_size) {
+  struct stat info{};
+  if (body_size == 0 || ::fstat(fd, &info) != 0 ||
+      static_cast<size_t>(info.st_size) < body_size) {
+    ::close(fd);
+    return nullptr;
+  }
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (auto& entry : entries_) {
+    if (entry.inode == static_cast<uint64_t>(info.st_ino) && !entry.busy &&
+        entry.size >= body_size) {
+      if (entry.fd >= 0) ::close(entry.fd);
+      entry.fd = fd;
+      entry.busy = true;
+      entry.last_use = ++clock_;
+      return entry.data;
+    }
+  }
+
+  size_t size = static_cast<size_t>(info.st_size);
+  void* mapped = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if (mapped == MAP_FAILED) {
+    ::close(fd);
+    return nullptr;
+  }
+
+  Entry received;
+  received.inode = info.st_ino;
+  received.fd = fd;
+  received.data = static_cast<uint8_t*>(mapped);
+  received.size = size;
+  received.busy = true;
+  return AddLocked(received)->data;
+}
+
+void MemfdCache::Done(const uint8_t* data) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (auto& entry : entries_) {
+    if (entry.data == data) entry.busy = false;
+  }
+}
+
+MemfdCache::Entry* MemfdCache::AddLocked(const Entry& entry) {
+  // Dropping a mapping of an inode also drops any older one, which the
+  // peer may have resized
+  for (auto it = entries_.begin(); it != entries_.end();) {
+    if (it->inode == entry.inode && !it->busy) {
+      ::munmap(it->data, it->size);
+      if (it->fd >= 0) ::close(it->fd);
+      it = entries_.erase(it);
+    } else {
+      ++it;
+    }
+  }
+
+  size_t cached_bytes = entry.size;
+  for (const auto& existing : entries_) {
+    cached_bytes += existing.size;
+  }
+
+  while (entries_.size() >= kMaxCachedMemfds || cached_bytes > kMaxCachedBytes) {
+    auto victim = entries_.end();
+    for (auto it = entries_.begin(); it != entries_.end(); ++it) {
+      if (!it->busy && (victim == entries_.end() || it->last_use < victim->last_use)) {
+        victim = it;
+      }
+    }
+    if (victim == entries_.end()) break;
+    cached_bytes -= victim->size;
+    ::munmap(victim->data, victim->size);
+    if (victim->fd >= 0) ::close(victim->fd);
+    entries_.erase(victim);
+  }
+
+  entries_.push_back(entry);
+  entries_.back().last_use = ++clock_;
+  return &entries_.back();
+}
+
+bool SendAll(int socket_fd, const uint8_t* data, size_t size, int passed_fd) {
+  alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int))] = {};
+  size_t sent = 0;
+
+  while (sent < size) {
+    iovec chunk{const_cast<uint8_t*>(data + sent), size - sent};
+    msghdr message{};
+    message.msg_iov = &chunk;
+    message.msg_iovlen = 1;
+
+    if (passed_fd >= 0 && sent == 0) {
+      message.msg_control = control;
+      message.msg_controllen = sizeof(control);
+      cmsghdr* cmsg = CMSG_FIRSTHDR(&message);
+      cmsg->cmsg_level = SOL_SOCKET;
+      cmsg->cmsg_type = SCM_RIGHTS;
+      cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+      std::memcpy(CMSG_DATA(cmsg), &passed_fd, sizeof(int));
+    }
+
+    ssize_t n = ::sendmsg(socket_fd, &message, MSG_NOSIGNAL);
+    if (n > 0) {
+      sent += static_cast<size_t>(n);
+      continue;
+    }
+    if (n < 0 && errno == EINTR) continue;
+    if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+      pollfd pfd{socket_fd, POLLOUT, 0};
+      ::poll(&pfd, 1, 1000);
+      continue;
+    }
+    return false;
+  }
+  return true;
+}
+
+ssize_t ReceiveWithFds(int socket_fd, void* buffer, size_t size, std::deque<int>* fds) {
+  iovec space{buffer, size};
+  alignas(cmsghdr) char control[CMSG_SPACE(kMaxPassedFds * sizeof(int))];
+
+  msghdr message{};
+  message.msg_iov = &space;
+  message.msg_iovlen = 1;
+  message.msg_control = control;
+  message.msg_controllen = sizeof(control);
+
+  ssize_t n = ::recvmsg(socket_fd, &message, MSG_CMSG_CLOEXEC);
+  if (n < 0) return n;
+
+  for (cmsghdr* cmsg = CMSG_FIRSTHDR(&message); cmsg; cmsg = CMSG_NXTHDR(&message, cmsg)) {
+    if (cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS) continue;
+    size_t count = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+    for (size_t i = 0; i < count; i++) {
+      int fd = -1;
+      std::memcpy(&fd, CMSG_DATA(cmsg) + i * sizeof(int), sizeof(int));
+      fds->push_back(fd);
+    }
+  }
+
+  // Descriptors dropped for lack of room would desynchronize the frames
+  if (message.msg_flags & MSG_CTRUNC) {
+    errno = EPROTO;
+    return -1;
+  }
+  return n;
+}
+
+void CloseAll(std::deque<int>* fds) {
+  for (int fd : *fds) {
+    ::close(fd);
+  }
+  fds->clear();
+}
+
+bool DeliverFrame(const common::wire::FrameHeader& header, const uint8_t* body,
+                  std::deque<int>* fds, MemfdCache* memfds, const FrameCallback& deliver) {
+  if (!(header.flags & common::wire::kFlagBodyInFd)) {
+    return deliver(header, body);
+  }
+  if (fds->empty()) return false;
+
+  int fd = fds->front();
+  fds->pop_front();
+  const uint8_t* data = memfds->Map(fd, header.body_length);
+  if (!data) return false;
+
+  bool ok = deliver(header, data);
+  memfds->Done(data);
+  return ok;
+}
+
+} // namespace rawtcp
+} // namespace benchmark
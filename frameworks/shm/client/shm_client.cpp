@@ -0,0 +1,155 @@
+// Shared-memory client: creates the connection's memfd, hands it to the
+// server over a Unix socket, then talks through the rings only
+
+#include "shm_framework.h"
+#include <cstring>
+#include <iostream>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace benchmark {
+namespace shm {
+
+namespace {
+
+// How long an idle reader sleeps before checking that the server is alive
+constexpr int kIdleCheckMs = 100;
+
+bool SendHello(int socket_fd, int region_fd, const Hello& hello) {
+  iovec payload{const_cast<Hello*>(&hello), sizeof(hello)};
+  alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int))] = {};
+
+  msghdr message{};
+  message.msg_iov = &payload;
+  message.msg_iovlen = 1;
+  message.msg_control = control;
+  message.msg_controllen = sizeof(control);
+
+  cmsghdr* cmsg = CMSG_FIRSTHDR(&message);
+  cmsg->cmsg_level = SOL_SOCKET;
+  cmsg->cmsg_type = SCM_RIGHTS;
+  cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+  std::memcpy(CMSG_DATA(cmsg), &region_fd, sizeof(int));
+
+  return ::sendmsg(socket_fd, &message, MSG_NOSIGNAL) == static_cast<ssize_t>(sizeof(hello));
+}
+
+} // namespace
+
+ShmClient::ShmClient(common::WaitStrategy wait, size_t ring_capacity)
+  : wait_(wait), ring_capacity_(ring_capacity), service_(this, &calls_) {}
+
+ShmClient::~ShmClient() {
+  Disconnect();
+}
+
+common::IBenchmarkService* ShmClient::GetService() {
+  return connected_ ? &service_ : nullptr;
+}
+
+bool ShmClient::Connect(const std::string& address) {
+  Disconnect();
+
+  sockaddr_un socket_address{};
+  socklen_t length = 0;
+  if (!MakeSocketAddress(address, &socket_address, &length)) {
+    std::cerr << "ShmClient: invalid address " << address << std::endl;
+    return false;
+  }
+
+  socket_fd_ = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (socket_fd_ < 0 ||
+      ::connect(socket_fd_, reinterpret_cast<sockaddr*>(&socket_address), length) != 0) {
+    std::cerr << "ShmClient: cannot connect to " << address << std::endl;
+    Disconnect();
+    return false;
+  }
+
+  auto region = std::make_unique<SharedRegion>();
+  if (!region->Create(ring_capacity_)) {
+    std::cerr << "ShmClient: cannot create shared region: " << std::strerror(errno)
+              << std::endl;
+    Disconnect();
+    return false;
+  }
+
+  Hello hello;
+  hello.magic = kHelloMagic;
+  hello.wait_strategy = static_cast<uint32_t>(wait_);
+  hello.ring_capacity = ring_capacity_;
+
+  // The server answers with one byte once it has mapped the region
+  char ack = 0;
+  if (!SendHello(socket_fd_, region->fd(), hello) ||
+      ::recv(socket_fd_, &ack, 1, 0) != 1 || ack != 1) {
+    std::cerr << "ShmClient: handshake with " << address << " failed" << std::endl;
+    Disconnect();
+    return false;
+  }
+
+  region_ = std::move(region);
+  sender_ = std::make_unique<RingSender>(region_->to_server(), wait_);
+  connected_ = true;
+  reader_ = std::thread([this]() { ReadLoop(); });
+  return true;
+}
+
+void ShmClient::Disconnect() {
+  if (socket_fd_ < 0) return;
+
+  connected_ = false;
+  if (region_) {
+    region_->to_server()->Close();
+    region_->to_client()->Close();
+  }
+  if (reader_.joinable()) reader_.join();
+  ::close(socket_fd_);
+  socket_fd_ = -1;
+  calls_.FailAll();
+
+  // The region stays mapped until the next Connect() in case a late call
+  // still holds the sender
+}
+
+bool ShmClient::IsConnected() const {
+  return connected_;
+}
+
+bool ShmClient::SendFrame(common::wire::MessageType type, uint32_t call_id, size_t body_size,
+                          const common::wire::BodyEncoder& encode) {
+  if (!connected_) return false;
+  return sender_->SendFrame(type, call_id, body_size, encode);
+}
+
+void ShmClient::ReadLoop() {
+  Ring* ring = region_->to_client();
+  RingReader reader(ring);
+  auto deliver = [this](const common::wire::FrameHeader& header, const uint8_t* body) {
+    calls_.Deliver(header, body);
+    return true;
+  };
+
+  while (connected_) {
+    if (!reader.Drain(deliver)) {
+      std::cerr << "ShmClient: corrupt frame, closing connection" << std::endl;
+      break;
+    }
+    if (ring->IsClosed()) break;
+
+    if (!ring->WaitForData(wait_, kIdleCheckMs)) {
+      // The server never writes to the socket after the handshake, so any
+      // readiness means it has gone
+      pollfd pfd{socket_fd_, POLLIN, 0};
+      if (::poll(&pfd, 1, 0) != 0) break;
+    }
+  }
+
+  // Unblock callers waiting for room in a ring nobody drains any more
+  connected_ = false;
+  region_->to_server()->Close();
+  calls_.FailAll();
+}
+
+} // namespace shm
+} // namespace benchmark
@@ -0,0 +1,124 @@
+#pragma once
+
+#include "benchmark_service.h"
+#include "framed_service.h"
+#include "shm_transport.h"
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace benchmark {
+namespace shm {
+
+// Shared-memory transport between processes: each connection is a memfd
+// holding one lock-free SPSC ring per direction, carrying the same frames
+// as the raw TCP baseline. Frames are encoded directly into the ring and
+// decoded where they lie, so a call costs no socket syscalls and no
+// kernel copies; an idle side waits under the client's WaitStrategy.
+//
+// A Unix domain socket (see MakeSocketAddress()) is only used to hand the
+// memfd to the server and to notice when the peer goes away.
+
+// Default data bytes per ring direction
+constexpr size_t kDefaultRingCapacity = 4 * 1024 * 1024;
+
+struct ServerConnection;
+
+// Server with an accept thread and one thread per connection that drains
+// the client's ring and dispatches calls to the service
+class ShmServer : public common::IBenchmarkServer {
+public:
+  // handler_pool runs unary handlers on the shared work-stealing executor
+  // instead of the connection's thread
+  explicit ShmServer(std::shared_ptr<common::IBenchmarkService> service,
+                     bool handler_pool = false);
+  ~ShmServer() override;
+
+  bool Start(const std::string& address) override;
+  void Stop() override;
+  bool IsRunning() const override;
+  void Wait() override;
+
+private:
+  void AcceptLoop();
+  void Handshake(int fd);
+  void Serve(const std::shared_ptr<ServerConnection>& conn);
+
+  // Join the threads of connections that have ended
+  void ReapLocked();
+
+  std::shared_ptr<common::IBenchmarkService> service_;
+  bool handler_pool_;
+  int listen_fd_ = -1;
+  std::thread acceptor_;
+  std::atomic<bool> running_{false};
+
+  std::mutex connections_mutex_;
+  std::vector<std::shared_ptr<ServerConnection>> connections_;
+
+  std::mutex wait_mutex_;
+  std::condition_variable wait_cv_;
+};
+
+// Client that owns the shared region of its connection. Calls from many
+// threads share the client-to-server ring; a reader thread routes frames
+// from the server's ring to outstanding calls by call id.
+class ShmClient : public common::IBenchmarkClient, public common::wire::FrameSender {
+public:
+  explicit ShmClient(common::WaitStrategy wait = common::WaitStrategy::kBlock,
+                     size_t ring_capacity = kDefaultRingCapacity);
+  ~ShmClient() override;
+
+  common::IBenchmarkService* GetService() override;
+  bool Connect(const std::string& address) override;
+  void Disconnect() override;
+  bool IsConnected() const override;
+
+  bool SendFrame(common::wire::MessageType type, uint32_t call_id, size_t body_size,
+                 const common::wire::BodyEncoder& encode) override;
+
+private:
+  void ReadLoop();
+
+  common::WaitStrategy wait_;
+  size_t ring_capacity_;
+
+  int socket_fd_ = -1;
+  std::unique_ptr<SharedRegion> region_;
+  std::unique_ptr<RingSender> sender_;
+  std::atomic<bool> connected_{false};
+  std::thread reader_;
+
+  common::wire::CallTable calls_;
+  common::wire::FramedServiceStub service_;
+};
+
+class ShmFactory : public common::IFrameworkFactory {
+public:
+  explicit ShmFactory(common::WaitStrategy wait = common::WaitStrategy::kBlock,
+                      bool handler_pool = false)
+    : wait_(wait), handler_pool_(handler_pool) {}
+
+  std::string GetName() const override {
+    return std::string("SharedMemory (") + common::WaitStrategyName(wait_) +
+           (handler_pool_ ? ", handler pool)" : ")");
+  }
+  std::unique_ptr<common::IBenchmarkClient> CreateClient() override;
+  std::unique_ptr<common::IBenchmarkServer> CreateServer(
+      std::shared_ptr<common::IBenchmarkService> service) override;
+
+private:
+  common::WaitStrategy wait_;
+  bool handler_pool_;
+};
+
+std::unique_ptr<common::IFrameworkFactory> CreateShmFactory(common::WaitStrategy wait,
+                                                           bool handler_pool);
+std::unique_ptr<common::IFrameworkFactory> CreateShmPollFactory(bool handler_pool);
+
+} // namespace shm
+} // namespace benchmark
@@ -0,0 +1,180 @@
+#pragma once
+
+#include "framed_service.h"
+#include "wait_strategy.h"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <vector>
+
+namespace benchmark {
+namespace shm {
+
+// Single-producer/single-consumer byte ring in memory shared between two
+// processes. Records are 8-byte aligned and never wrap: a record that does
+// not fit before the end of the data area is preceded by a wrap marker and
+// written at offset 0, so every record is contiguous and can be encoded
+// and decoded in place.
+//
+// Each side waits under a common::WaitStrategy when it has nothing to do,
+// sleeping on a futex "doorbell" if the strategy sleeps. A sleeper
+// announces itself in `waiters` before re-checking the ring, and the other
+// side checks `waiters` after publishing, so a wakeup is only paid for
+// when someone actually sleeps.
+
+struct Doorbell {
+  std::atomic<uint32_t> seq{0};
+  std::atomic<uint32_t> waiters{0};
+};
+
+struct RingControl {
+  alignas(64) std::atomic<uint64_t> head{0};   // Bytes consumed
+  alignas(64) std::atomic<uint64_t> tail{0};   // Bytes produced
+  alignas(64) Doorbell data;                   // Consumer waits for records
+  alignas(64) Doorbell space;                  // Producer waits for room
+  alignas(64) std::atomic<uint32_t> closed{0};
+};
+
+static_assert(std::atomic<uint32_t>::is_always_lock_free &&
+              std::atomic<uint64_t>::is_always_lock_free,
+              "shared rings need address-free atomics");
+
+// A record as seen by the consumer; `data` points into the ring
+struct Record {
+  const uint8_t* data = nullptr;
+  uint32_t size = 0;
+  bool more = false;   // Frame continues in the next record
+};
+
+class Ring {
+public:
+  // Shared bytes needed for a ring with `capacity` data bytes
+  static size_t MappedSize(size_t capacity) { return sizeof(RingControl) + capacity; }
+
+  // Use the ring at `base`; the creating side initializes it
+  void Attach(uint8_t* base, size_t capacity, bool initialize);
+
+  // Largest record payload, so a record never needs more than half the ring
+  size_t MaxRecord() const { return capacity_ / 2 - kRecordHeader; }
+
+  // Producer: wait for room and return `size` contiguous bytes to fill, or
+  // null once the ring is closed. EndWrite() publishes the record.
+  uint8_t* BeginWrite(size_t size, bool more, common::WaitStrategy wait);
+  void EndWrite();
+
+  // Consumer: the record at the head, skipping wrap markers. Release()
+  // frees it once the caller is done reading it in place.
+  bool Peek(Record* record);
+  void Release();
+
+  // Wait up to `timeout_ms` for a record; true if one is available
+  bool WaitForData(common::WaitStrategy wait, int timeout_ms);
+
+  // Mark the ring closed and wake both sides
+  void Close();
+  bool IsClosed() const;
+
+private:
+  static constexpr size_t kRecordHeader = 8;
+
+  RingControl* control_ = nullptr;
+  uint8_t* data_ = nullptr;
+  size_t capacity_ = 0;
+
+  // Producer-side state of the record being written
+  uint64_t pending_tail_ = 0;
+
+  // Consumer-side size of the record returned by Peek()
+  uint64_t peeked_size_ = 0;
+
+  // This process's spin budgets for each side of the ring
+  common::SpinBudget data_budget_;
+  common::SpinBudget space_budget_;
+};
+
+// Sends frames through a ring. Frames that fit in one record are encoded
+// straight into shared memory; larger ones are split into several records
+// and reassembled by the reader. Safe to call from several threads.
+class RingSender : public common::wire::FrameSender {
+public:
+  RingSender(Ring* ring, common::WaitStrategy wait) : ring_(ring), wait_(wait) {}
+
+  bool SendFrame(common::wire::MessageType type, uint32_t call_id, size_t body_size,
+                 const common::wire::BodyEncoder& encode) override;
+
+private:
+  Ring* ring_;
+  common::WaitStrategy wait_;
+  std::mutex mutex_;
+};
+
+// Receives frames from a ring, reading single-record frames in place
+class RingReader {
+public:
+  using FrameCallback = std::function<bool(const common::wire::FrameHeader& header,
+                                           const uint8_t* body)>;
+
+  explicit RingReader(Ring* ring) : ring_(ring) {}
+
+  // Deliver every complete frame in the ring. Returns false on a corrupt
+  // frame or when `on_frame` fails.
+  bool Drain(const FrameCallback& on_frame);
+
+private:
+  bool Deliver(const uint8_t* frame, size_t size, const FrameCallback& on_frame);
+
+  Ring* ring_;
+  std::vector<uint8_t> partial_;
+};
+
+// A memfd holding the client-to-server ring followed by the
+// server-to-client ring, mapped into one process
+class SharedRegion {
+public:
+  SharedRegion() = default;
+  ~SharedRegion();
+  SharedRegion(const SharedRegion&) = delete;
+  SharedRegion& operator=(const SharedRegion&) = delete;
+
+  // Create and initialize a region with two rings of `ring_capacity` bytes
+  bool Create(size_t ring_capacity);
+
+  // Map a region received from the peer; takes ownership of `fd`
+  bool Map(int fd, size_t ring_capacity);
+
+  int fd() const { return fd_; }
+  Ring* to_server() { return &to_server_; }
+  Ring* to_client() { return &to_client_; }
+
+private:
+  bool MapAndAttach(bool initialize);
+
+  int fd_ = -1;
+  void* base_ = nullptr;
+  size_t size_ = 0;
+  size_t ring_capacity_ = 0;
+  Ring to_server_;
+  Ring to_client_;
+};
+
+// Sent by the client together with the region's fd
+struct Hello {
+  uint32_t magic = 0;
+  uint32_t wait_strategy = 0;   // common::WaitStrategy, used by both sides
+  uint64_t ring_capacity = 0;
+};
+
+constexpr uint32_t kHelloMagic = 0x53484d32;  // "SHM2"
+
+// Map a benchmark address to the Unix socket that carries the handshake.
+// Paths starting with '/' are used as is; anything else names a socket in
+// the abstract namespace, so "localhost:50051" needs no file on disk.
+bool MakeSocketAddress(const std::string& address, sockaddr_un* result, socklen_t* length);
+
+} // namespace shm
+} // namespace benchmark
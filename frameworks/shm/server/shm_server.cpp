@@ -0,0 +1,242 @@
+// Shared-memory server: accepts memfd regions over a Unix socket and runs
+// one thread per connection that serves calls straight out of the ring
+
+#include "shm_framework.h"
+#include "work_stealing_executor.h"
+#include <cstring>
+#include <iostream>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace benchmark {
+namespace shm {
+
+namespace {
+
+// Idle connections check this often that the client is still there
+constexpr int kIdleCheckMs = 100;
+
+// Accepted ring sizes; anything else is a broken or hostile client
+constexpr uint64_t kMinRingCapacity = 4096;
+constexpr uint64_t kMaxRingCapacity = uint64_t{1} << 30;
+
+// Receive the hello and the region fd that comes with it. Returns -1 if
+// either is missing.
+int ReceiveHello(int socket_fd, Hello* hello) {
+  iovec payload{hello, sizeof(*hello)};
+  alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int))] = {};
+
+  msghdr message{};
+  message.msg_iov = &payload;
+  message.msg_iovlen = 1;
+  message.msg_control = control;
+  message.msg_controllen = sizeof(control);
+
+  ssize_t received = ::recvmsg(socket_fd, &message, MSG_CMSG_CLOEXEC);
+  cmsghdr* cmsg = CMSG_FIRSTHDR(&message);
+  if (!cmsg || cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS) {
+    return -1;
+  }
+
+  int fd = -1;
+  std::memcpy(&fd, CMSG_DATA(cmsg), sizeof(int));
+  if (received != static_cast<ssize_t>(sizeof(*hello))) {
+    ::close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+} // namespace
+
+// One accepted client. The sender is shared with service callbacks, which
+// keeps the region mapped for as long as any of them can still reply.
+struct ServerConnection {
+  int socket_fd = -1;
+  common::WaitStrategy wait = common::WaitStrategy::kBlock;
+  SharedRegion region;
+  std::unique_ptr<RingSender> sender;
+  std::thread thread;
+  std::atomic<bool> done{false};
+
+  ~ServerConnection() {
+    if (socket_fd >= 0) ::close(socket_fd);
+  }
+};
+
+// ShmServer implementation
+ShmServer::ShmServer(std::shared_ptr<common::IBenchmarkService> service, bool handler_pool)
+  : service_(std::move(service)), handler_pool_(handler_pool) {}
+
+ShmServer::~ShmServer() {
+  Stop();
+}
+
+bool ShmServer::Start(const std::string& address) {
+  if (running_) return false;
+
+  sockaddr_un socket_address{};
+  socklen_t length = 0;
+  if (!MakeSocketAddress(address, &socket_address, &length)) {
+    std::cerr << "ShmServer: invalid address " << address << std::endl;
+    return false;
+  }
+
+  // A stale socket file from an earlier run would make bind() fail
+  if (socket_address.sun_path[0] != '\0') {
+    ::unlink(socket_address.sun_path);
+  }
+
+  listen_fd_ = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (listen_fd_ < 0 ||
+      ::bind(listen_fd_, reinterpret_cast<sockaddr*>(&socket_address), length) != 0 ||
+      ::listen(listen_fd_, 1024) != 0) {
+    std::cerr << "ShmServer: bind/listen failed: " << std::strerror(errno) << std::endl;
+    if (listen_fd_ >= 0) ::close(listen_fd_);
+    listen_fd_ = -1;
+    return false;
+  }
+
+  running_ = true;
+  acceptor_ = std::thread([this]() { AcceptLoop(); });
+  return true;
+}
+
+void ShmServer::Stop() {
+  if (!running_.exchange(false)) return;
+
+  if (acceptor_.joinable()) acceptor_.join();
+  ::close(listen_fd_);
+  listen_fd_ = -1;
+
+  std::vector<std::shared_ptr<ServerConnection>> connections;
+  {
+    std::lock_guard<std::mutex> lock(connections_mutex_);
+    connections.swap(connections_);
+  }
+  for (auto& conn : connections) {
+    conn->region.to_server()->Close();
+    conn->region.to_client()->Close();
+    if (conn->thread.joinable()) conn->thread.join();
+  }
+
+  std::lock_guard<std::mutex> lock(wait_mutex_);
+  wait_cv_.notify_all();
+}
+
+bool ShmServer::IsRunning() const {
+  return running_;
+}
+
+void ShmServer::Wait() {
+  std::unique_lock<std::mutex> lock(wait_mutex_);
+  wait_cv_.wait(lock, [this] { return !running_; });
+}
+
+void ShmServer::AcceptLoop() {
+  while (running_) {
+    // Poll with a timeout so Stop() never has to interrupt accept()
+    pollfd pfd{listen_fd_, POLLIN, 0};
+    if (::poll(&pfd, 1, kIdleCheckMs) <= 0) continue;
+
+    int fd = ::accept4(listen_fd_, nullptr, nullptr, SOCK_CLOEXEC);
+    if (fd < 0) {
+      if (errno == EINTR || errno == ECONNABORTED || errno == EAGAIN) continue;
+      break;
+    }
+    Handshake(fd);
+  }
+}
+
+void ShmServer::Handshake(int fd) {
+  auto conn = std::make_shared<ServerConnection>();
+  conn->socket_fd = fd;
+
+  Hello hello;
+  int region_fd = ReceiveHello(fd, &hello);
+  if (region_fd < 0) return;
+
+  if (hello.magic != kHelloMagic || hello.ring_capacity < kMinRingCapacity ||
+      hello.ring_capacity > kMaxRingCapacity || hello.ring_capacity % 64 != 0 ||
+      hello.wait_strategy > static_cast<uint32_t>(common::WaitStrategy::kBlock)) {
+    ::close(region_fd);
+    std::cerr << "ShmServer: rejected connection with a bad hello" << std::endl;
+    return;
+  }
+  if (!conn->region.Map(region_fd, hello.ring_capacity)) {
+    std::cerr << "ShmServer: rejected connection with a bad region" << std::endl;
+    return;
+  }
+
+  conn->wait = static_cast<common::WaitStrategy>(hello.wait_strategy);
+  conn->sender = std::make_unique<RingSender>(conn->region.to_client(), conn->wait);
+
+  char ack = 1;
+  if (::send(fd, &ack, 1, MSG_NOSIGNAL) != 1) return;
+
+  std::lock_guard<std::mutex> lock(connections_mutex_);
+  ReapLocked();
+  conn->thread = std::thread([this, conn]() { Serve(conn); });
+  connections_.push_back(conn);
+}
+
+void ShmServer::Serve(const std::shared_ptr<ServerConnection>& conn) {
+  Ring* ring = conn->region.to_server();
+  RingReader reader(ring);
+  common::wire::ServiceDispatcher dispatcher(
+      service_, std::shared_ptr<common::wire::FrameSender>(conn, conn->sender.get()),
+      handler_pool_ ? &common::WorkStealingExecutor::Shared() : nullptr);
+  auto dispatch = [&dispatcher](const common::wire::FrameHeader& header, const uint8_t* body) {
+    return dispatcher.Dispatch(header, body);
+  };
+
+  while (running_) {
+    if (!reader.Drain(dispatch) || ring->IsClosed()) break;
+
+    if (!ring->WaitForData(conn->wait, kIdleCheckMs)) {
+      // The client never writes to the socket after the handshake, so any
+      // readiness means it has gone
+      pollfd pfd{conn->socket_fd, POLLIN, 0};
+      if (::poll(&pfd, 1, 0) != 0) break;
+    }
+  }
+
+  conn->region.to_server()->Close();
+  conn->region.to_client()->Close();
+  conn->done = true;
+}
+
+void ShmServer::ReapLocked() {
+  for (auto it = connections_.begin(); it != connections_.end();) {
+    if ((*it)->done) {
+      (*it)->thread.join();
+      it = connections_.erase(it);
+    } else {
+      ++it;
+    }
+  }
+}
+
+// ShmFactory implementation
+std::unique_ptr<common::IBenchmarkClient> ShmFactory::CreateClient() {
+  return std::make_unique<ShmClient>(wait_);
+}
+
+std::unique_ptr<common::IBenchmarkServer> ShmFactory::CreateServer(
+    std::shared_ptr<common::IBenchmarkService> service) {
+  return std::make_unique<ShmServer>(std::move(service), handler_pool_);
+}
+
+std::unique_ptr<common::IFrameworkFactory> CreateShmFactory(common::WaitStrategy wait,
+                                                           bool handler_pool) {
+  return std::make_unique<ShmFactory>(wait, handler_pool);
+}
+
+// Kept as the short name for polling rings
+std::unique_ptr<common::IFrameworkFactory> CreateShmPollFactory(bool handler_pool) {
+  return std::make_unique<ShmFactory>(common::WaitStrategy::kSpinYield, handler_pool);
+}
+
+} // namespace shm
+} // namespace benchmark
@@ -0,0 +1,309 @@
+// Shared-memory rings with futex doorbells, and the memfd region that
+// holds a connection's pair of rings
+
+#include "shm_transport.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <ctime>
+#include <linux/futex.h>
+#include <new>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <thread>
+#include <unistd.h>
+
+namespace benchmark {
+namespace shm {
+
+namespace {
+
+constexpr uint32_t kWrapFlag = 1;   // Rest of the data area is unused
+constexpr uint32_t kMoreFlag = 2;   // Frame continues in the next record
+
+// Polls between clock reads while spinning towards a timeout
+constexpr int kPollsPerClockCheck = 64;
+
+size_t Align8(size_t size) {
+  return (size + 7) & ~size_t{7};
+}
+
+// Process-shared futex operations; the rings live in a MAP_SHARED mapping
+void FutexWait(std::atomic<uint32_t>* word, uint32_t expected, int timeout_ms) {
+  timespec timeout{timeout_ms / 1000, (timeout_ms % 1000) * 1000000L};
+  ::syscall(SYS_futex, reinterpret_cast<uint32_t*>(word), FUTEX_WAIT, expected,
+            &timeout, nullptr, 0);
+}
+
+void FutexWakeAll(std::atomic<uint32_t>* word) {
+  ::syscall(SYS_futex, reinterpret_cast<uint32_t*>(word), FUTEX_WAKE, INT32_MAX,
+            nullptr, nullptr, 0);
+}
+
+// Wake sleepers after publishing a change they may be waiting for
+void Notify(Doorbell* bell) {
+  if (bell->waiters.load(std::memory_order_seq_cst) == 0) return;
+  bell->seq.fetch_add(1, std::memory_order_seq_cst);
+  FutexWakeAll(&bell->seq);
+}
+
+// Wait until `ready()` or the timeout under `strategy`, spinning first and
+// then sleeping on `bell` if the strategy sleeps at all
+template<typename Ready>
+bool Wait(Doorbell* bell, common::WaitStrategy strategy, common::SpinBudget* budget,
+          int timeout_ms, Ready ready) {
+  if (ready()) return true;
+
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+  common::SpinWaiter waiter(strategy, budget);
+  while (!waiter.Pause()) {
+    if (ready()) return true;
+    if (waiter.polls() % kPollsPerClockCheck == 0 &&
+        std::chrono::steady_clock::now() >= deadline) {
+      return false;
+    }
+  }
+
+  uint32_t seq = bell->seq.load(std::memory_order_seq_cst);
+  bell->waiters.fetch_add(1, std::memory_order_seq_cst);
+  if (!ready()) {
+    FutexWait(&bell->seq, seq, timeout_ms);
+  }
+  bell->waiters.fetch_sub(1, std::memory_order_seq_cst);
+  return ready();
+}
+
+void StoreU32(uint8_t* data, uint32_t value) {
+  std::memcpy(data, &value, sizeof(value));
+}
+
+uint32_t LoadU32(const uint8_t* data) {
+  uint32_t value;
+  std::memcpy(&value, data, sizeof(value));
+  return value;
+}
+
+} // namespace
+
+// Ring implementation
+void Ring::Attach(uint8_t* base, size_t capacity, bool initialize) {
+  control_ = initialize ? new (base) RingControl() : reinterpret_cast<RingControl*>(base);
+  data_ = base + sizeof(RingControl);
+  capacity_ = capacity;
+}
+
+uint8_t* Ring::BeginWrite(size_t size, bool more, common::WaitStrategy wait) {
+  size_t record = kRecordHeader + Align8(size);
+
+  while (true) {
+    uint64_t tail = control_->tail.load(std::memory_order_relaxed);
+    uint64_t head = control_->head.load(std::memory_order_acquire);
+    size_t offset = static_cast<size_t>(tail % capacity_);
+    size_t to_end = capacity_ - offset;
+    size_t needed = record <= to_end ? record : to_end + record;
+
+    if (capacity_ - (tail - head) >= needed) {
+      if (record > to_end) {
+        StoreU32(data_ + offset, 0);
+        StoreU32(data_ + offset + 4, kWrapFlag);
+        tail += to_end;
+        offset = 0;
+      }
+      StoreU32(data_ + offset, static_cast<uint32_t>(size));
+      StoreU32(data_ + offset + 4, more ? kMoreFlag : 0);
+      pending_tail_ = tail + record;
+      return data_ + offset + kRecordHeader;
+    }
+
+    if (IsClosed()) return nullptr;
+    Wait(&control_->space, wait, &space_budget_, 100, [&]() {
+      uint64_t free_space = capacity_ - (control_->tail.load(std::memory_order_relaxed) -
+                                         control_->head.load(std::memory_order_seq_cst));
+      return free_space >= needed || IsClosed();
+    });
+  }
+}
+
+void Ring::EndWrite() {
+  control_->tail.store(pending_tail_, std::memory_order_seq_cst);
+  Notify(&control_->data);
+}
+
+bool Ring::Peek(Record* record) {
+  uint64_t head = control_->head.load(std::memory_order_relaxed);
+  uint64_t tail = control_->tail.load(std::memory_order_acquire);
+
+  while (head != tail) {
+    size_t offset = static_cast<size_t>(head % capacity_);
+    uint32_t size = LoadU32(data_ + offset);
+    uint32_t flags = LoadU32(data_ + offset + 4);
+
+    if (flags & kWrapFlag) {
+      // Skipping a wrap marker frees its space right away
+      head += capacity_ - offset;
+      control_->head.store(head, std::memory_order_seq_cst);
+      Notify(&control_->space);
+      continue;
+    }
+
+    record->data = data_ + offset + kRecordHeader;
+    record->size = size;
+    record->more = (flags & kMoreFlag) != 0;
+    peeked_size_ = kRecordHeader + Align8(size);
+    return true;
+  }
+  return false;
+}
+
+void Ring::Release() {
+  uint64_t head = control_->head.load(std::memory_order_relaxed);
+  control_->head.store(head + peeked_size_, std::memory_order_seq_cst);
+  peeked_size_ = 0;
+  Notify(&control_->space);
+}
+
+bool Ring::WaitForData(common::WaitStrategy wait, int timeout_ms) {
+  auto has_data = [this]() {
+    return control_->tail.load(std::memory_order_seq_cst) !=
+           control_->head.load(std::memory_order_relaxed);
+  };
+  Wait(&control_->data, wait, &data_budget_, timeout_ms, [&]() { return has_data() || IsClosed(); });
+  return has_data();
+}
+
+void Ring::Close() {
+  control_->closed.store(1, std::memory_order_seq_cst);
+  for (Doorbell* bell : {&control_->data, &control_->space}) {
+    bell->seq.fetch_add(1, std::memory_order_seq_cst);
+    FutexWakeAll(&bell->seq);
+  }
+}
+
+bool Ring::IsClosed() const {
+  return control_->closed.load(std::memory_order_acquire) != 0;
+}
+
+// RingSender implementation
+bool RingSender::SendFrame(common::wire::MessageType type, uint32_t call_id,
+                           size_t body_size, const common::wire::BodyEncoder& encode) {
+  size_t frame_size = common::wire::kFrameHeaderSize + body_size;
+
+  if (frame_size <= ring_->MaxRecord()) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    uint8_t* frame = ring_->BeginWrite(frame_size, false, wait_);
+    if (!frame) return false;
+    common::wire::WriteFrameHeader(frame, type, call_id, static_cast<uint32_t>(body_size));
+    common::wire::WireWriter writer(frame + common::wire::kFrameHeaderSize, body_size);
+    encode(&writer);
+    ring_->EndWrite();
+    return true;
+  }
+
+  // Too large for one record: encode outside the lock, then copy it
+  // through the ring in pieces
+  std::vector<uint8_t> frame(frame_size);
+  common::wire::WriteFrameHeader(frame.data(), type, call_id, static_cast<uint32_t>(body_size));
+  common::wire::WireWriter writer(frame.data() + common::wire::kFrameHeaderSize, body_size);
+  encode(&writer);
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (size_t offset = 0; offset < frame_size;) {
+    size_t piece = std::min(ring_->MaxRecord(), frame_size - offset);
+    uint8_t* data = ring_->BeginWrite(piece, offset + piece < frame_size, wait_);
+    if (!data) return false;
+    std::memcpy(data, frame.data() + offset, piece);
+    ring_->EndWrite();
+    offset += piece;
+  }
+  return true;
+}
+
+// RingReader implementation
+bool RingReader::Drain(const FrameCallback& on_frame) {
+  Record record;
+  while (ring_->Peek(&record)) {
+    bool ok = true;
+    if (!record.more && partial_.empty()) {
+      ok = Deliver(record.data, record.size, on_frame);
+    } else {
+      partial_.insert(partial_.end(), record.data, record.data + record.size);
+      if (!record.more) {
+        ok = Deliver(partial_.data(), partial_.size(), on_frame);
+        std::vector<uint8_t>().swap(partial_);
+      }
+    }
+    ring_->Release();
+    if (!ok) return false;
+  }
+  return true;
+}
+
+bool RingReader::Deliver(const uint8_t* frame, size_t size, const FrameCallback& on_frame) {
+  common::wire::FrameHeader header;
+  if (size < common::wire::kFrameHeaderSize ||
+      !common::wire::ParseFrameHeader(frame, &header) ||
+      header.body_length != size - common::wire::kFrameHeaderSize) {
+    return false;
+  }
+  return on_frame(header, frame + common::wire::kFrameHeaderSize);
+}
+
+// SharedRegion implementation
+SharedRegion::~SharedRegion() {
+  if (base_) ::munmap(base_, size_);
+  if (fd_ >= 0) ::close(fd_);
+}
+
+bool SharedRegion::Create(size_t ring_capacity) {
+  fd_ = ::memfd_create("proto-bench-shm", MFD_CLOEXEC);
+  if (fd_ < 0) return false;
+
+  ring_capacity_ = ring_capacity;
+  size_ = 2 * Ring::MappedSize(ring_capacity);
+  if (::ftruncate(fd_, static_cast<off_t>(size_)) != 0) return false;
+  return MapAndAttach(true);
+}
+
+bool SharedRegion::Map(int fd, size_t ring_capacity) {
+  fd_ = fd;
+  ring_capacity_ = ring_capacity;
+  size_ = 2 * Ring::MappedSize(ring_capacity);
+
+  struct stat info{};
+  if (::fstat(fd_, &info) != 0 || static_cast<size_t>(info.st_size) < size_) return false;
+  return MapAndAttach(false);
+}
+
+bool SharedRegion::MapAndAttach(bool initialize) {
+  void* base = ::mmap(nullptr, size_, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+  if (base == MAP_FAILED) return false;
+  base_ = base;
+
+  auto* bytes = static_cast<uint8_t*>(base_);
+  to_server_.Attach(bytes, ring_capacity_, initialize);
+  to_client_.Attach(bytes + Ring::MappedSize(ring_capacity_), ring_capacity_, initialize);
+  return true;
+}
+
+bool MakeSocketAddress(const std::string& address, sockaddr_un* result, socklen_t* length) {
+  std::memset(result, 0, sizeof(*result));
+  result->sun_family = AF_UNIX;
+
+  if (!address.empty() && address[0] == '/') {
+    if (address.size() >= sizeof(result->sun_path)) return false;
+    std::memcpy(result->sun_path, address.data(), address.size());
+    *length = static_cast<socklen_t>(offsetof(sockaddr_un, sun_path) + address.size() + 1);
+    return true;
+  }
+
+  // Abstract names start with a NUL byte and are not NUL-terminated
+  std::string name = "proto-bench-shm:" + address;
+  if (name.size() + 1 > sizeof(result->sun_path)) return false;
+  std::memcpy(result->sun_path + 1, name.data(), name.size());
+  *length = static_cast<socklen_t>(offsetof(sockaddr_un, sun_path) + 1 + name.size());
+  return true;
+}
+
+} // namespace shm
+} // namespace benchmark
@@ -1,33 +1,361 @@
-// tRPC-cpp client implementation
-// This file will contain the tRPC-specific implementation of IBenchmarkClient
+// tRPC-cpp client: the common service over the generated proxy
 
-#include "benchmark_service.h"
-#include "benchmark_types.h"
-
-// TODO: Include generated tRPC headers
-// #include "benchmark.trpc.pb.h"
+#include "trpc_framework.h"
+#include "trpc_support.h"
+#include <trpc/client/make_client_context.h>
+#include <trpc/client/trpc_client.h>
+#include <trpc/coroutine/fiber.h>
+#include <trpc/coroutine/fiber_latch.h>
+#include <trpc/future/future.h>
+#include <future>
+#include <iostream>
 
 namespace benchmark {
 namespace trpc_impl {
 
-// TODO: Implement tRPC client wrapper that implements common::IBenchmarkClient
-// tRPC is a high-performance RPC framework developed by Tencent
-// Reference: https://github.com/trpc-group/trpc-cpp
-
-// class TrpcBenchmarkClient : public common::IBenchmarkClient {
-// public:
-//   TrpcBenchmarkClient();
-//   ~TrpcBenchmarkClient() override;
-//
-//   common::IBenchmarkService* GetService() override;
-//   bool Connect(const std::string& address) override;
-//   void Disconnect() override;
-//   bool IsConnected() const override;
-//
-// private:
-//   std::shared_ptr<::trpc::ServiceProxy> proxy_;
-//   // ... other members
-// };
+namespace {
+
+const char* const kNoFiber = "Cannot start a tRPC fiber";
+
+using Proxy = pb::BenchmarkServiceServiceProxy;
+
+// Runs a blocking call: in a fiber that the calling thread waits for
+// under kFiber, where the proxy's synchronous calls must come from a
+// fiber; on the calling thread otherwise
+template<typename T, typename Call>
+common::Result<T> Blocking(bool fiber, Call call) {
+  if (!fiber) return call();
+  std::promise<common::Result<T>> done;
+  auto result = done.get_future();
+  if (!TrpcRuntime::Run([&done, &call]() { done.set_value(call()); })) {
+    return common::Result<T>(common::ErrorCode::UNAVAILABLE, kNoFiber);
+  }
+  return result.get();
+}
+
+// Result of a finished async call. A failed future carries one code, the
+// framework's or the service's.
+template<typename T, typename Proto>
+common::Result<T> FromFuture(::trpc::Future<Proto>&& future) {
+  if (future.IsFailed()) {
+    auto exception = future.GetException();
+    return common::Result<T>(FromRetCode(exception.GetExceptionCode()), exception.what());
+  }
+  common::Result<T> result;
+  FromProto(future.GetValue0(), &result.value);
+  return result;
+}
+
+void Complete(const common::CompletionCallback& on_complete, const ::trpc::Status& status) {
+  on_complete(FromStatus(status), status.ErrorMessage());
+}
+
+// Caller-side provider for a client stream: chunks go to the channel, and
+// the closing empty chunk closes it
+common::StreamCallback<common::DataChunk> ProviderFor(std::shared_ptr<ChunkChannel> channel) {
+  return [channel](const common::DataChunk& chunk) {
+    if (chunk.data.empty()) {
+      channel->Close(common::ErrorCode::OK, std::string());
+    } else {
+      channel->Push(chunk);
+    }
+  };
+}
+
+// Writes out `channel` to a client stream. If a write fails the channel
+// is closed, so the caller's later chunks are dropped.
+template<typename Writer>
+::trpc::Status WriteAll(ChunkChannel* channel, Writer* writer) {
+  pb::DataChunk chunk;
+  while (channel->Pop(&chunk)) {
+    ::trpc::Status status = writer->Write(chunk);
+    if (!status.OK()) {
+      channel->Close(FromStatus(status), status.ErrorMessage());
+      return status;
+    }
+  }
+  return writer->WriteDone();
+}
+
+} // namespace
+
+// TrpcServiceStub implementation
+common::Result<common::EchoResponse> TrpcServiceStub::Echo(const common::EchoRequest& request) {
+  return Blocking<common::EchoResponse>(fiber_, [this, &request]() {
+    pb::EchoRequest proto_request;
+    ToProto(request, &proto_request);
+    pb::EchoResponse response;
+    auto status = proxy_->Echo(::trpc::MakeClientContext(proxy_), proto_request, &response);
+    return ToResult<common::EchoResponse>(status, response);
+  });
+}
+
+void TrpcServiceStub::EchoAsync(
+    const common::EchoRequest& request,
+    common::ResponseCallback<common::EchoResponse> callback) {
+  auto proto_request = std::make_shared<pb::EchoRequest>();
+  ToProto(request, proto_request.get());
+  auto proxy = proxy_;
+  bool started = TrpcRuntime::Run([proxy, proto_request, callback]() {
+    proxy->AsyncEcho(::trpc::MakeClientContext(proxy), *proto_request)
+        .Then([callback](::trpc::Future<pb::EchoResponse>&& future) {
+          callback(FromFuture<common::EchoResponse>(std::move(future)));
+          return ::trpc::MakeReadyFuture<>();
+        });
+  });
+  if (!started) {
+    callback(common::Result<common::EchoResponse>(common::ErrorCode::UNAVAILABLE, kNoFiber));
+  }
+}
+
+void TrpcServiceStub::StreamData(
+    const common::StreamRequest& request,
+    common::StreamCallback<common::DataChunk> on_chunk,
+    common::CompletionCallback on_complete) {
+  if (!fiber_) {
+    on_complete(common::ErrorCode::INTERNAL, kStreamsNeedFiber);
+    return;
+  }
+
+  pb::StreamRequest proto_request;
+  ToProto(request, &proto_request);
+  auto proxy = proxy_;
+  bool started = TrpcRuntime::Run([proxy, proto_request, on_chunk, on_complete]() {
+    auto reader = proxy->StreamData(::trpc::MakeClientContext(proxy), proto_request);
+    ::trpc::Status status = reader.GetStatus();
+    pb::DataChunk message;
+    common::DataChunk chunk;
+    while (status.OK() && (status = reader.Read(&message, kCallTimeoutMs)).OK()) {
+      FromProto(message, &chunk);
+      on_chunk(chunk);
+    }
+    if (status.StreamEof()) status = reader.Finish();
+    Complete(on_complete, status);
+  });
+  if (!started) on_complete(common::ErrorCode::UNAVAILABLE, kNoFiber);
+}
+
+void TrpcServiceStub::UploadData(
+    common::StreamCallback<common::DataChunk>& chunk_provider,
+    common::ResponseCallback<common::UploadResponse> on_complete) {
+  if (!fiber_) {
+    on_complete(common::Result<common::UploadResponse>(common::ErrorCode::INTERNAL,
+                                                       kStreamsNeedFiber));
+    return;
+  }
+
+  auto channel = std::make_shared<ChunkChannel>();
+  chunk_provider = ProviderFor(channel);
+  auto proxy = proxy_;
+  bool started = TrpcRuntime::Run([proxy, channel, on_complete]() {
+    pb::UploadResponse response;
+    auto writer = proxy->UploadData(::trpc::MakeClientContext(proxy), &response);
+    ::trpc::Status status = writer.GetStatus();
+    if (status.OK()) status = WriteAll(channel.get(), &writer);
+    if (status.OK()) {
+      status = writer.Finish();
+    } else {
+      channel->Close(FromStatus(status), status.ErrorMessage());
+    }
+    on_complete(ToResult<common::UploadResponse>(status, response));
+  });
+  if (!started) {
+    on_complete(common::Result<common::UploadResponse>(common::ErrorCode::UNAVAILABLE,
+                                                       kNoFiber));
+  }
+}
+
+void TrpcServiceStub::BidirectionalStream(
+    common::StreamCallback<common::DataChunk>& chunk_provider,
+    common::StreamCallback<common::DataChunk> on_chunk,
+    common::CompletionCallback on_complete) {
+  if (!fiber_) {
+    on_complete(common::ErrorCode::INTERNAL, kStreamsNeedFiber);
+    return;
+  }
+
+  auto channel = std::make_shared<ChunkChannel>();
+  chunk_provider = ProviderFor(channel);
+  auto proxy = proxy_;
+  bool started = TrpcRuntime::Run([proxy, channel, on_chunk, on_complete]() {
+    auto stream = proxy->BidirectionalStream(::trpc::MakeClientContext(proxy));
+    ::trpc::Status status = stream.GetStatus();
+    if (!status.OK()) {
+      channel->Close(FromStatus(status), status.ErrorMessage());
+      Complete(on_complete, status);
+      return;
+    }
+
+    // The caller's chunks go out from a second fiber while this one reads
+    // the replies; it finishes before the stream goes out of scope
+    ::trpc::FiberLatch written(1);
+    bool writing = ::trpc::StartFiberDetached([&stream, &written, channel]() {
+      WriteAll(channel.get(), &stream);
+      written.CountDown();
+    });
+    if (!writing) {
+      channel->Close(common::ErrorCode::UNAVAILABLE, kNoFiber);
+      written.CountDown();
+    }
+
+    pb::DataChunk message;
+    common::DataChunk chunk;
+    while ((status = stream.Read(&message, kCallTimeoutMs)).OK()) {
+      FromProto(message, &chunk);
+      on_chunk(chunk);
+    }
+    if (!status.StreamEof()) channel->Close(FromStatus(status), status.ErrorMessage());
+    written.Wait();
+    if (status.StreamEof()) status = stream.Finish();
+    Complete(on_complete, status);
+  });
+  if (!started) on_complete(common::ErrorCode::UNAVAILABLE, kNoFiber);
+}
+
+common::Result<common::BatchResponse> TrpcServiceStub::BatchProcess(
+    const common::BatchRequest& request) {
+  return Blocking<common::BatchResponse>(fiber_, [this, &request]() {
+    pb::BatchRequest proto_request;
+    ToProto(request, &proto_request);
+    pb::BatchResponse response;
+    auto status = proxy_->BatchProcess(::trpc::MakeClientContext(proxy_), proto_request,
+                                       &response);
+    return ToResult<common::BatchResponse>(status, response);
+  });
+}
+
+void TrpcServiceStub::BatchProcessAsync(
+    const common::BatchRequest& request,
+    common::ResponseCallback<common::BatchResponse> callback) {
+  auto proto_request = std::make_shared<pb::BatchRequest>();
+  ToProto(request, proto_request.get());
+  auto proxy = proxy_;
+  bool started = TrpcRuntime::Run([proxy, proto_request, callback]() {
+    proxy->AsyncBatchProcess(::trpc::MakeClientContext(proxy), *proto_request)
+        .Then([callback](::trpc::Future<pb::BatchResponse>&& future) {
+          callback(FromFuture<common::BatchResponse>(std::move(future)));
+          return ::trpc::MakeReadyFuture<>();
+        });
+  });
+  if (!started) {
+    callback(common::Result<common::BatchResponse>(common::ErrorCode::UNAVAILABLE, kNoFiber));
+  }
+}
+
+common::Result<common::NestedMessage> TrpcServiceStub::EchoShape(
+    const common::NestedMessage& request) {
+  return Blocking<common::NestedMessage>(fiber_, [this, &request]() {
+    pb::NestedMessage proto_request;
+    ToProto(request, &proto_request);
+    pb::NestedMessage response;
+    auto status = proxy_->EchoNested(::trpc::MakeClientContext(proxy_), proto_request,
+                                     &response);
+    return ToResult<common::NestedMessage>(status, response);
+  });
+}
+
+common::Result<common::ArrayMessage> TrpcServiceStub::EchoShape(
+    const common::ArrayMessage& request) {
+  return Blocking<common::ArrayMessage>(fiber_, [this, &request]() {
+    pb::ArrayMessage proto_request;
+    ToProto(request, &proto_request);
+    pb::ArrayMessage response;
+    auto status = proxy_->EchoArrays(::trpc::MakeClientContext(proxy_), proto_request,
+                                     &response);
+    return ToResult<common::ArrayMessage>(status, response);
+  });
+}
+
+common::Result<common::MapMessage> TrpcServiceStub::EchoShape(
+    const common::MapMessage& request) {
+  return Blocking<common::MapMessage>(fiber_, [this, &request]() {
+    pb::MapMessage proto_request;
+    ToProto(request, &proto_request);
+    pb::MapMessage response;
+    auto status = proxy_->EchoMap(::trpc::MakeClientContext(proxy_), proto_request,
+                                  &response);
+    return ToResult<common::MapMessage>(status, response);
+  });
+}
+
+common::Result<common::SparseMessage> TrpcServiceStub::EchoShape(
+    const common::SparseMessage& request) {
+  return Blocking<common::SparseMessage>(fiber_, [this, &request]() {
+    pb::SparseMessage proto_request;
+    ToProto(request, &proto_request);
+    pb::SparseMessage response;
+    auto status = proxy_->EchoSparse(::trpc::MakeClientContext(proxy_), proto_request,
+                                     &response);
+    return ToResult<common::SparseMessage>(status, response);
+  });
+}
+
+common::Result<common::StringMessage> TrpcServiceStub::EchoShape(
+    const common::StringMessage& request) {
+  return Blocking<common::StringMessage>(fiber_, [this, &request]() {
+    pb::StringMessage proto_request;
+    ToProto(request, &proto_request);
+    pb::StringMessage response;
+    auto status = proxy_->EchoStrings(::trpc::MakeClientContext(proxy_), proto_request,
+                                      &response);
+    return ToResult<common::StringMessage>(status, response);
+  });
+}
+
+// TrpcClient implementation
+TrpcClient::~TrpcClient() {
+  Disconnect();
+}
+
+common::IBenchmarkService* TrpcClient::GetService() {
+  return service_.get();
+}
+
+bool TrpcClient::Connect(const std::string& address) {
+  Disconnect();
+
+  std::string ip;
+  int port = 0;
+  if (!SplitAddress(address, &ip, &port)) {
+    std::cerr << "TrpcClient: invalid address " << address << std::endl;
+    return false;
+  }
+  if (!TrpcRuntime::Acquire(options_.model, options_.threads)) return false;
+
+  // tRPC keeps proxies by name for the life of the runtime, so clients of
+  // one address share a proxy and its pool of long connections
+  std::string target = ip + ":" + std::to_string(port);
+  ::trpc::ServiceProxyOption option;
+  option.name = "trpc.benchmark.BenchmarkService@" + target;
+  option.target = target;
+  option.selector_name = "direct";
+  option.codec_name = "trpc";
+  option.network = "tcp";
+  option.conn_type = "long";
+  option.timeout = kCallTimeoutMs;
+  option.max_packet_size = kMaxPacketSize;
+
+  auto proxy = ::trpc::GetTrpcClient()->GetProxy<Proxy>(option.name, &option);
+  if (!proxy) {
+    std::cerr << "TrpcClient: cannot create a proxy for " << address << std::endl;
+    TrpcRuntime::Release();
+    return false;
+  }
+
+  service_ = std::make_unique<TrpcServiceStub>(std::move(proxy),
+                                               options_.model == TrpcThreadModel::kFiber);
+  return true;
+}
+
+void TrpcClient::Disconnect() {
+  if (!service_) return;
+  service_.reset();
+  TrpcRuntime::Release();
+}
+
+bool TrpcClient::IsConnected() const {
+  return service_ != nullptr;
+}
 
 } // namespace trpc_impl
 } // namespace benchmark
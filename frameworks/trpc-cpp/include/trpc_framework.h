@@ -0,0 +1,130 @@
+#pragma once
+
+#include "benchmark_service.h"
+#include "trpc_support.h"
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+
+namespace benchmark {
+namespace trpc_impl {
+
+// tRPC-cpp adapter: the common service over the generated
+// BenchmarkService on the trpc protocol, with a choice of runtime so the
+// fiber scheduler and the merge and separate thread models can be
+// compared on the same service and client.
+
+struct TrpcOptions {
+  TrpcThreadModel model = TrpcThreadModel::kFiber;
+
+  // Fiber workers, or reactor plus handler threads; 0 uses one per CPU
+  int threads = 0;
+};
+
+class TrpcServer : public common::IBenchmarkServer {
+public:
+  TrpcServer(std::shared_ptr<common::IBenchmarkService> service, const TrpcOptions& options)
+    : service_(std::move(service)), options_(options) {}
+  ~TrpcServer() override;
+
+  bool Start(const std::string& address) override;
+  void Stop() override;
+  bool IsRunning() const override;
+  void Wait() override;
+
+private:
+  std::shared_ptr<common::IBenchmarkService> service_;
+  TrpcOptions options_;
+  std::string service_name_;
+  std::atomic<bool> running_{false};
+  std::mutex wait_mutex_;
+  std::condition_variable wait_cv_;
+};
+
+// Client-side service over the generated proxy. Under fibers every call
+// runs in a fiber of its own and blocking callers wait for it; under the
+// thread models blocking calls use the synchronous proxy on the calling
+// thread. Async callbacks run on tRPC's threads.
+class TrpcServiceStub : public common::IBenchmarkService {
+public:
+  TrpcServiceStub(std::shared_ptr<pb::BenchmarkServiceServiceProxy> proxy, bool fiber)
+    : proxy_(std::move(proxy)), fiber_(fiber) {}
+
+  common::Result<common::EchoResponse> Echo(const common::EchoRequest& request) override;
+
+  void EchoAsync(
+      const common::EchoRequest& request,
+      common::ResponseCallback<common::EchoResponse> callback) override;
+
+  void StreamData(
+      const common::StreamRequest& request,
+      common::StreamCallback<common::DataChunk> on_chunk,
+      common::CompletionCallback on_complete) override;
+
+  void UploadData(
+      common::StreamCallback<common::DataChunk>& chunk_provider,
+      common::ResponseCallback<common::UploadResponse> on_complete) override;
+
+  void BidirectionalStream(
+      common::StreamCallback<common::DataChunk>& chunk_provider,
+      common::StreamCallback<common::DataChunk> on_chunk,
+      common::CompletionCallback on_complete) override;
+
+  common::Result<common::BatchResponse> BatchProcess(
+      const common::BatchRequest& request) override;
+
+  void BatchProcessAsync(
+      const common::BatchRequest& request,
+      common::ResponseCallback<common::BatchResponse> callback) override;
+
+  common::Result<common::NestedMessage> EchoShape(const common::NestedMessage& request) override;
+  common::Result<common::ArrayMessage> EchoShape(const common::ArrayMessage& request) override;
+  common::Result<common::MapMessage> EchoShape(const common::MapMessage& request) override;
+  common::Result<common::SparseMessage> EchoShape(const common::SparseMessage& request) override;
+  common::Result<common::StringMessage> EchoShape(const common::StringMessage& request) override;
+
+private:
+  std::shared_ptr<pb::BenchmarkServiceServiceProxy> proxy_;
+  bool fiber_;
+};
+
+// Client over a proxy for the server's address. Clients of one address
+// share the proxy and its long-lived connections (see Connect()).
+class TrpcClient : public common::IBenchmarkClient {
+public:
+  explicit TrpcClient(const TrpcOptions& options) : options_(options) {}
+  ~TrpcClient() override;
+
+  common::IBenchmarkService* GetService() override;
+  bool Connect(const std::string& address) override;
+  void Disconnect() override;
+  bool IsConnected() const override;
+
+private:
+  TrpcOptions options_;
+  std::unique_ptr<TrpcServiceStub> service_;
+};
+
+class TrpcFactory : public common::IFrameworkFactory {
+public:
+  explicit TrpcFactory(const TrpcOptions& options) : options_(options) {}
+
+  std::string GetName() const override;
+  std::unique_ptr<common::IBenchmarkClient> CreateClient() override;
+  std::unique_ptr<common::IBenchmarkServer> CreateServer(
+      std::shared_ptr<common::IBenchmarkService> service) override;
+
+private:
+  TrpcOptions options_;
+};
+
+// The fiber runtime, and the two thread models for comparison, each with
+// `threads` runtime threads (0 = one per CPU)
+std::unique_ptr<common::IFrameworkFactory> CreateTrpcFactory(int threads);
+std::unique_ptr<common::IFrameworkFactory> CreateTrpcMergeFactory(int threads);
+std::unique_ptr<common::IFrameworkFactory> CreateTrpcSeparateFactory(int threads);
+
+} // namespace trpc_impl
+} // namespace benchmark
@@ -0,0 +1,142 @@
+#pragma once
+
+#include "benchmark.trpc.pb.h"
+#include "benchmark_service.h"
+#include "benchmark_types.h"
+#include <trpc/common/status.h>
+#include <trpc/coroutine/fiber_condition_variable.h>
+#include <trpc/coroutine/fiber_mutex.h>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+
+namespace benchmark {
+namespace trpc_impl {
+
+// Pieces shared by the tRPC-cpp client and server. The generated messages
+// live in benchmark::trpc (the proto package), which hides tRPC's own
+// ::trpc inside namespace benchmark, so tRPC names are always written
+// fully qualified.
+
+namespace pb = ::benchmark::trpc;
+
+// Runtime the framework runs its I/O and handlers on
+//   kFiber     tRPC's M:N fiber scheduler; handlers and streams are fibers
+//              that block cheaply
+//   kMerge     one pool of reactor threads that both do I/O and run the
+//              handlers inline, with no handoff
+//   kSeparate  I/O threads hand decoded requests to a separate pool of
+//              handler threads
+// Synchronous streams need fibers, so the thread models serve unary calls
+// only and fail streams with kStreamsNeedFiber.
+enum class TrpcThreadModel { kFiber, kMerge, kSeparate };
+
+const char* TrpcThreadModelName(TrpcThreadModel model);
+
+extern const char* const kStreamsNeedFiber;
+
+// Both ends accept packets of any size the large-message scenario sends,
+// well past tRPC's 10 MB default
+constexpr uint32_t kMaxPacketSize = 0xF0000000u;
+
+// Timeout of a unary call, and of each read of a stream
+constexpr int kCallTimeoutMs = 120000;
+
+// The process-wide tRPC runtime. tRPC keeps its configuration and thread
+// model in globals, so one model runs at a time: Acquire() starts the
+// runtime for `model` with `threads` workers (0 = one per CPU), or joins
+// it if it already runs that model, and fails while another model is in
+// use. Once every user has released it, the next Acquire() of a different
+// model restarts it.
+class TrpcRuntime {
+public:
+  static bool Acquire(TrpcThreadModel model, int threads);
+  static void Release();
+
+  // Run `func` on the runtime: as a fiber under kFiber, inline on the
+  // calling thread otherwise. False if no fiber could be started.
+  static bool Run(std::function<void()> func);
+};
+
+// Split "host:port" for tRPC's direct selector and service config, which
+// take numeric addresses; "localhost" and an empty host become 127.0.0.1
+bool SplitAddress(const std::string& address, std::string* ip, int* port);
+
+// Copy between the common types and the generated messages
+void ToProto(const common::EchoRequest& from, pb::EchoRequest* to);
+void ToProto(const common::EchoResponse& from, pb::EchoResponse* to);
+void ToProto(const common::StreamRequest& from, pb::StreamRequest* to);
+void ToProto(const common::DataChunk& from, pb::DataChunk* to);
+void ToProto(const common::UploadResponse& from, pb::UploadResponse* to);
+void ToProto(const common::BatchRequest& from, pb::BatchRequest* to);
+void ToProto(const common::BatchResponse& from, pb::BatchResponse* to);
+
+void FromProto(const pb::EchoRequest& from, common::EchoRequest* to);
+void FromProto(const pb::EchoResponse& from, common::EchoResponse* to);
+void FromProto(const pb::StreamRequest& from, common::StreamRequest* to);
+void FromProto(const pb::DataChunk& from, common::DataChunk* to);
+void FromProto(const pb::UploadResponse& from, common::UploadResponse* to);
+void FromProto(const pb::BatchRequest& from, common::BatchRequest* to);
+void FromProto(const pb::BatchResponse& from, common::BatchResponse* to);
+
+void ToProto(const common::NestedMessage& from, pb::NestedMessage* to);
+void ToProto(const common::ArrayMessage& from, pb::ArrayMessage* to);
+void ToProto(const common::MapMessage& from, pb::MapMessage* to);
+void ToProto(const common::SparseMessage& from, pb::SparseMessage* to);
+void ToProto(const common::StringMessage& from, pb::StringMessage* to);
+
+void FromProto(const pb::NestedMessage& from, common::NestedMessage* to);
+void FromProto(const pb::ArrayMessage& from, common::ArrayMessage* to);
+void FromProto(const pb::MapMessage& from, common::MapMessage* to);
+void FromProto(const pb::SparseMessage& from, common::SparseMessage* to);
+void FromProto(const pb::StringMessage& from, common::StringMessage* to);
+
+// Service errors travel as the function return code of a tRPC status;
+// framework return codes (timeouts, connection failures) map onto the
+// nearest common code
+::trpc::Status ToStatus(common::ErrorCode code, const std::string& message);
+common::ErrorCode FromStatus(const ::trpc::Status& status);
+common::ErrorCode FromRetCode(int code);
+
+// Result of a finished unary call
+template<typename T, typename Proto>
+common::Result<T> ToResult(const ::trpc::Status& status, const Proto& response) {
+  if (!status.OK()) return common::Result<T>(FromStatus(status), status.ErrorMessage());
+  common::Result<T> result;
+  FromProto(response, &result.value);
+  return result;
+}
+
+// Outgoing half of a stream. Producers push chunks from any thread; the
+// fiber that owns the tRPC stream pops them in order and writes them out.
+// tRPC's fiber mutex and condition variable also work from plain threads,
+// so producers outside the runtime may push too. Push and Close are
+// ignored once closed.
+class ChunkChannel {
+public:
+  void Push(const common::DataChunk& chunk);
+  void Close(common::ErrorCode code, const std::string& message);
+
+  // Fiber side: waits for the next chunk; false once closed and drained
+  bool Pop(pb::DataChunk* chunk);
+
+  // How the producer closed the channel; valid once Pop() returned false
+  common::ErrorCode code();
+  std::string message();
+
+private:
+  ::trpc::FiberMutex mutex_;
+  ::trpc::FiberConditionVariable cv_;
+  std::deque<common::DataChunk> pending_;
+  bool closed_ = false;
+  common::ErrorCode code_ = common::ErrorCode::OK;
+  std::string message_;
+};
+
+common::StreamCallback<common::DataChunk> PushTo(std::shared_ptr<ChunkChannel> channel);
+common::CompletionCallback CloseOf(std::shared_ptr<ChunkChannel> channel);
+
+} // namespace trpc_impl
+} // namespace benchmark
@@ -1,48 +1,297 @@
-// tRPC-cpp server implementation
-// This file will contain the tRPC-specific implementation of IBenchmarkServer
+// tRPC-cpp server: the common service behind the generated
+// BenchmarkService, on the fiber runtime or a thread model
 
-#include "benchmark_service.h"
-#include "benchmark_types.h"
-
-// TODO: Include generated tRPC headers
-// #include "benchmark.trpc.pb.h"
+#include "trpc_framework.h"
+#include "trpc_support.h"
+#include <trpc/common/config/server_conf.h>
+#include <trpc/coroutine/fiber.h>
+#include <trpc/coroutine/fiber_latch.h>
+#include <trpc/server/trpc_server.h>
+#include <iostream>
 
 namespace benchmark {
 namespace trpc_impl {
 
-// TODO: Implement tRPC server wrapper that implements common::IBenchmarkServer
-// Reference: https://github.com/trpc-group/trpc-cpp
-
-// class TrpcBenchmarkServer : public common::IBenchmarkServer {
-// public:
-//   explicit TrpcBenchmarkServer(std::shared_ptr<common::IBenchmarkService> service);
-//   ~TrpcBenchmarkServer() override;
-//
-//   bool Start(const std::string& address) override;
-//   void Stop() override;
-//   bool IsRunning() const override;
-//   void Wait() override;
-//
-// private:
-//   std::shared_ptr<::trpc::TrpcServer> server_;
-//   std::shared_ptr<common::IBenchmarkService> service_;
-//   // ... other members
-// };
-
-// TODO: Implement tRPC service implementation that bridges to common::IBenchmarkService
-// class BenchmarkServiceImpl : public ::benchmark::trpc::BenchmarkService {
-// public:
-//   explicit BenchmarkServiceImpl(std::shared_ptr<common::IBenchmarkService> service);
-//
-//   ::trpc::Status Echo(::trpc::ServerContextPtr context,
-//                       const ::benchmark::trpc::EchoRequest* request,
-//                       ::benchmark::trpc::EchoResponse* response) override;
-//
-//   // ... other RPC methods
-//
-// private:
-//   std::shared_ptr<common::IBenchmarkService> service_;
-// };
+namespace {
+
+const char* const kNoClientStreams = "Service does not accept client streams";
+
+// Distinguishes the services of several servers in one process
+std::atomic<int> next_service_id{0};
+
+// Answers a unary call with the service's result once it arrives, from
+// whichever thread it completes on. The handler returns at once, so under
+// the merge model the reactor thread goes straight back to I/O.
+template<typename Proto, typename T>
+common::ResponseCallback<T> ReplyTo(::trpc::ServerContextPtr context) {
+  context->SetResponse(false);
+  return [context](const common::Result<T>& result) {
+    Proto response;
+    if (result.ok()) ToProto(result.value, &response);
+    context->SendUnaryResponse(ToStatus(result.error_code, result.error_message), response);
+  };
+}
+
+// Writes out `channel` to `writer` until the producer closes it, then
+// returns how it was closed. A failed write means the client went away:
+// the channel is closed so producers stop filling it.
+::trpc::Status WriteAll(ChunkChannel* channel,
+                        ::trpc::stream::StreamWriter<pb::DataChunk>* writer) {
+  pb::DataChunk chunk;
+  while (channel->Pop(&chunk)) {
+    ::trpc::Status status = writer->Write(chunk);
+    if (!status.OK()) {
+      channel->Close(FromStatus(status), status.ErrorMessage());
+      return status;
+    }
+  }
+  return ToStatus(channel->code(), channel->message());
+}
+
+// Hands every chunk the client sends to `sink`, reading each into one
+// reused message and DataChunk, and ends the stream with an empty chunk
+::trpc::Status ReadAll(const ::trpc::stream::StreamReader<pb::DataChunk>& reader,
+                       const common::StreamCallback<common::DataChunk>& sink) {
+  pb::DataChunk message;
+  common::DataChunk chunk;
+  ::trpc::Status status;
+  while ((status = reader.Read(&message, kCallTimeoutMs)).OK()) {
+    FromProto(message, &chunk);
+    sink(chunk);
+  }
+  sink(common::DataChunk());
+  return status.StreamEof() ? ::trpc::Status() : status;
+}
+
+// The common type of each message-zoo message
+template<typename Proto> struct ShapeOf;
+template<> struct ShapeOf<pb::NestedMessage> { using Type = common::NestedMessage; };
+template<> struct ShapeOf<pb::ArrayMessage> { using Type = common::ArrayMessage; };
+template<> struct ShapeOf<pb::MapMessage> { using Type = common::MapMessage; };
+template<> struct ShapeOf<pb::SparseMessage> { using Type = common::SparseMessage; };
+template<> struct ShapeOf<pb::StringMessage> { using Type = common::StringMessage; };
+
+class ServiceImpl : public pb::BenchmarkService {
+public:
+  ServiceImpl(std::shared_ptr<common::IBenchmarkService> service, bool fiber)
+    : service_(std::move(service)), fiber_(fiber) {}
+
+  ::trpc::Status Echo(::trpc::ServerContextPtr context, const pb::EchoRequest* request,
+                      pb::EchoResponse* /*response*/) override {
+    common::EchoRequest common_request;
+    FromProto(*request, &common_request);
+    service_->EchoAsync(common_request,
+                        ReplyTo<pb::EchoResponse, common::EchoResponse>(context));
+    return ::trpc::Status();
+  }
+
+  ::trpc::Status StreamData(const ::trpc::ServerContextPtr& /*context*/,
+                            const pb::StreamRequest& request,
+                            ::trpc::stream::StreamWriter<pb::DataChunk>* writer) override {
+    if (!fiber_) return ToStatus(common::ErrorCode::INTERNAL, kStreamsNeedFiber);
+    common::StreamRequest common_request;
+    FromProto(request, &common_request);
+    auto channel = std::make_shared<ChunkChannel>();
+    service_->StreamData(common_request, PushTo(channel), CloseOf(channel));
+    return WriteAll(channel.get(), writer);
+  }
+
+  ::trpc::Status UploadData(const ::trpc::ServerContextPtr& /*context*/,
+                            const ::trpc::stream::StreamReader<pb::DataChunk>& reader,
+                            pb::UploadResponse* response) override {
+    if (!fiber_) return ToStatus(common::ErrorCode::INTERNAL, kStreamsNeedFiber);
+
+    // The service may answer from any thread, possibly before the stream
+    // has ended
+    struct Outcome {
+      ::trpc::FiberLatch done{1};
+      common::Result<common::UploadResponse> result;
+    };
+    auto outcome = std::make_shared<Outcome>();
+    common::StreamCallback<common::DataChunk> sink;
+    service_->UploadData(sink, [outcome](const common::Result<common::UploadResponse>& result) {
+      outcome->result = result;
+      outcome->done.CountDown();
+    });
+    if (!sink) return ToStatus(common::ErrorCode::INTERNAL, kNoClientStreams);
+
+    ::trpc::Status status = ReadAll(reader, sink);
+    outcome->done.Wait();
+    if (!status.OK()) return status;
+    if (outcome->result.ok()) ToProto(outcome->result.value, response);
+    return ToStatus(outcome->result.error_code, outcome->result.error_message);
+  }
+
+  ::trpc::Status BidirectionalStream(const ::trpc::ServerContextPtr& /*context*/,
+                                     const ::trpc::stream::StreamReader<pb::DataChunk>& reader,
+                                     ::trpc::stream::StreamWriter<pb::DataChunk>* writer) override {
+    if (!fiber_) return ToStatus(common::ErrorCode::INTERNAL, kStreamsNeedFiber);
+
+    auto channel = std::make_shared<ChunkChannel>();
+    common::StreamCallback<common::DataChunk> sink;
+    service_->BidirectionalStream(sink, PushTo(channel), CloseOf(channel));
+    if (!sink) return ToStatus(common::ErrorCode::INTERNAL, kNoClientStreams);
+
+    // Replies drain in a fiber of their own while this one reads
+    struct Replies {
+      ::trpc::FiberLatch done{1};
+      ::trpc::Status status;
+    };
+    auto replies = std::make_shared<Replies>();
+    bool started = ::trpc::StartFiberDetached([channel, writer, replies]() {
+      replies->status = WriteAll(channel.get(), writer);
+      replies->done.CountDown();
+    });
+    if (!started) {
+      channel->Close(common::ErrorCode::INTERNAL, "Cannot start reply fiber");
+      return ToStatus(common::ErrorCode::INTERNAL, "Cannot start reply fiber");
+    }
+
+    ::trpc::Status status = ReadAll(reader, sink);
+    if (!status.OK()) channel->Close(FromStatus(status), status.ErrorMessage());
+    replies->done.Wait();
+    return status.OK() ? replies->status : status;
+  }
+
+  ::trpc::Status BatchProcess(::trpc::ServerContextPtr context, const pb::BatchRequest* request,
+                              pb::BatchResponse* /*response*/) override {
+    common::BatchRequest common_request;
+    FromProto(*request, &common_request);
+    service_->BatchProcessAsync(common_request,
+                                ReplyTo<pb::BatchResponse, common::BatchResponse>(context));
+    return ::trpc::Status();
+  }
+
+  ::trpc::Status EchoNested(::trpc::ServerContextPtr /*context*/, const pb::NestedMessage* request,
+                            pb::NestedMessage* response) override {
+    return Shape(*request, response);
+  }
+
+  ::trpc::Status EchoArrays(::trpc::ServerContextPtr /*context*/, const pb::ArrayMessage* request,
+                            pb::ArrayMessage* response) override {
+    return Shape(*request, response);
+  }
+
+  ::trpc::Status EchoMap(::trpc::ServerContextPtr /*context*/, const pb::MapMessage* request,
+                         pb::MapMessage* response) override {
+    return Shape(*request, response);
+  }
+
+  ::trpc::Status EchoSparse(::trpc::ServerContextPtr /*context*/, const pb::SparseMessage* request,
+                            pb::SparseMessage* response) override {
+    return Shape(*request, response);
+  }
+
+  ::trpc::Status EchoStrings(::trpc::ServerContextPtr /*context*/, const pb::StringMessage* request,
+                             pb::StringMessage* response) override {
+    return Shape(*request, response);
+  }
+
+private:
+  // Message-zoo echoes have no async form, so they answer inline
+  template<typename Proto>
+  ::trpc::Status Shape(const Proto& request, Proto* response) {
+    typename ShapeOf<Proto>::Type shape;
+    FromProto(request, &shape);
+    auto result = service_->EchoShape(shape);
+    if (result.ok()) ToProto(result.value, response);
+    return ToStatus(result.error_code, result.error_message);
+  }
+
+  std::shared_ptr<common::IBenchmarkService> service_;
+  bool fiber_;
+};
+
+} // namespace
+
+// TrpcServer implementation
+TrpcServer::~TrpcServer() {
+  Stop();
+}
+
+bool TrpcServer::Start(const std::string& address) {
+  if (running_) return false;
+
+  ::trpc::ServiceConfig config;
+  if (!SplitAddress(address, &config.ip, &config.port)) {
+    std::cerr << "TrpcServer: invalid address " << address << std::endl;
+    return false;
+  }
+  config.service_name =
+      "trpc.benchmark.BenchmarkService." + std::to_string(next_service_id.fetch_add(1));
+  config.network = "tcp";
+  config.protocol = "trpc";
+  config.max_packet_size = kMaxPacketSize;
+
+  if (!TrpcRuntime::Acquire(options_.model, options_.threads)) return false;
+
+  ::trpc::ServicePtr service = std::make_shared<ServiceImpl>(
+      service_, options_.model == TrpcThreadModel::kFiber);
+  auto server = ::trpc::GetTrpcServer();
+  if (server->RegisterService(config, service) != ::trpc::TrpcServer::RegisterRetCode::kOk) {
+    std::cerr << "TrpcServer: cannot serve on " << address << std::endl;
+    TrpcRuntime::Release();
+    return false;
+  }
+
+  service_name_ = config.service_name;
+  running_ = true;
+  return true;
+}
+
+void TrpcServer::Stop() {
+  if (!running_.exchange(false)) return;
+  ::trpc::GetTrpcServer()->StopService(service_name_);
+  TrpcRuntime::Release();
+  std::lock_guard<std::mutex> lock(wait_mutex_);
+  wait_cv_.notify_all();
+}
+
+bool TrpcServer::IsRunning() const {
+  return running_;
+}
+
+void TrpcServer::Wait() {
+  std::unique_lock<std::mutex> lock(wait_mutex_);
+  wait_cv_.wait(lock, [this] { return !running_; });
+}
+
+// TrpcFactory implementation
+std::string TrpcFactory::GetName() const {
+  return std::string("tRPC (") + TrpcThreadModelName(options_.model) + ")";
+}
+
+std::unique_ptr<common::IBenchmarkClient> TrpcFactory::CreateClient() {
+  return std::make_unique<TrpcClient>(options_);
+}
+
+std::unique_ptr<common::IBenchmarkServer> TrpcFactory::CreateServer(
+    std::shared_ptr<common::IBenchmarkService> service) {
+  return std::make_unique<TrpcServer>(std::move(service), options_);
+}
+
+namespace {
+
+std::unique_ptr<common::IFrameworkFactory> MakeFactory(TrpcThreadModel model, int threads) {
+  TrpcOptions options;
+  options.model = model;
+  options.threads = threads;
+  return std::make_unique<TrpcFactory>(options);
+}
+
+} // namespace
+
+std::unique_ptr<common::IFrameworkFactory> CreateTrpcFactory(int threads) {
+  return MakeFactory(TrpcThreadModel::kFiber, threads);
+}
+
+std::unique_ptr<common::IFrameworkFactory> CreateTrpcMergeFactory(int threads) {
+  return MakeFactory(TrpcThreadModel::kMerge, threads);
+}
+
+std::unique_ptr<common::IFrameworkFactory> CreateTrpcSeparateFactory(int threads) {
+  return MakeFactory(TrpcThreadModel::kSeparate, threads);
+}
 
 } // namespace trpc_impl
 } // namespace benchmark
@@ -0,0 +1,418 @@
+#include "trpc_support.h"
+#include "shape_proto.h"
+#include <trpc/common/config/trpc_config.h>
+#include <trpc/common/runtime_manager.h>
+#include <trpc/coroutine/fiber.h>
+#include <trpc/proto/trpc.pb.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <thread>
+
+namespace benchmark {
+namespace trpc_impl {
+
+const char* const kStreamsNeedFiber = "tRPC-cpp streams need the fiber runtime";
+
+namespace {
+
+std::string ToBytes(const std::vector<uint8_t>& data) {
+  return std::string(reinterpret_cast<const char*>(data.data()), data.size());
+}
+
+std::vector<uint8_t> FromBytes(const std::string& bytes) {
+  return std::vector<uint8_t>(bytes.begin(), bytes.end());
+}
+
+// Global section of a tRPC config with the one thread model instance that
+// clients and services use by default
+std::string RuntimeConfig(TrpcThreadModel model, int threads) {
+  int workers = threads > 0 ? threads
+                            : std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+  std::string yaml = "global:\n  threadmodel:\n";
+  switch (model) {
+    case TrpcThreadModel::kFiber:
+      yaml += "    fiber:\n"
+              "      - instance_name: fiber_instance\n"
+              "        concurrency_hint: " + std::to_string(workers) + "\n";
+      break;
+    case TrpcThreadModel::kMerge:
+      yaml += "    default:\n"
+              "      - instance_name: merge_instance\n"
+              "        io_handle_type: merge\n"
+              "        io_thread_num: " + std::to_string(workers) + "\n";
+      break;
+    case TrpcThreadModel::kSeparate: {
+      // A quarter of the threads for I/O, the rest for handlers
+      int io_threads = std::max(1, workers / 4);
+      yaml += "    default:\n"
+              "      - instance_name: separate_instance\n"
+              "        io_handle_type: separate\n"
+              "        io_thread_num: " + std::to_string(io_threads) + "\n"
+              "        handle_thread_num: " +
+              std::to_string(std::max(1, workers - io_threads)) + "\n";
+      break;
+    }
+  }
+  return yaml;
+}
+
+struct RuntimeState {
+  ~RuntimeState() {
+    if (running) ::trpc::DestroyFrameworkRuntime();
+  }
+
+  std::mutex mutex;
+  bool running = false;
+  int users = 0;
+  std::atomic<TrpcThreadModel> model{TrpcThreadModel::kFiber};
+};
+
+RuntimeState& State() {
+  static RuntimeState state;
+  return state;
+}
+
+// tRPC reads its configuration from a file; write one for this model
+bool LoadConfig(TrpcThreadModel model, int threads) {
+  std::string path = "/tmp/proto-bench-trpc-" + std::to_string(getpid()) + ".yaml";
+  {
+    std::ofstream file(path, std::ios::trunc);
+    file << RuntimeConfig(model, threads);
+    if (!file) {
+      std::cerr << "tRPC: cannot write " << path << std::endl;
+      return false;
+    }
+  }
+  int status = ::trpc::TrpcConfig::GetInstance()->Init(path);
+  std::remove(path.c_str());
+  if (status != 0) {
+    std::cerr << "tRPC: invalid runtime config" << std::endl;
+    return false;
+  }
+  return true;
+}
+
+} // namespace
+
+const char* TrpcThreadModelName(TrpcThreadModel model) {
+  switch (model) {
+    case TrpcThreadModel::kFiber: return "fiber";
+    case TrpcThreadModel::kMerge: return "merge";
+    case TrpcThreadModel::kSeparate: return "separate";
+  }
+  return "unknown";
+}
+
+// TrpcRuntime implementation
+bool TrpcRuntime::Acquire(TrpcThreadModel model, int threads) {
+  RuntimeState& state = State();
+  std::lock_guard<std::mutex> lock(state.mutex);
+  if (state.running && state.model.load() == model) {
+    state.users++;
+    return true;
+  }
+  if (state.users > 0) {
+    std::cerr << "tRPC: the " << TrpcThreadModelName(state.model.load())
+              << " runtime is still in use; cannot start " << TrpcThreadModelName(model)
+              << std::endl;
+    return false;
+  }
+  if (state.running) {
+    ::trpc::DestroyFrameworkRuntime();
+    state.running = false;
+  }
+
+  if (!LoadConfig(model, threads) || ::trpc::InitFrameworkRuntime() != 0) {
+    std::cerr << "tRPC: failed to start the " << TrpcThreadModelName(model) << " runtime"
+              << std::endl;
+    return false;
+  }
+  state.model.store(model);
+  state.running = true;
+  state.users = 1;
+  return true;
+}
+
+void TrpcRuntime::Release() {
+  RuntimeState& state = State();
+  std::lock_guard<std::mutex> lock(state.mutex);
+  if (state.users > 0) state.users--;
+}
+
+bool TrpcRuntime::Run(std::function<void()> func) {
+  if (State().model.load() != TrpcThreadModel::kFiber) {
+    func();
+    return true;
+  }
+  return ::trpc::StartFiberDetached([func = std::move(func)]() { func(); });
+}
+
+bool SplitAddress(const std::string& address, std::string* ip, int* port) {
+  auto colon = address.rfind(':');
+  if (colon == std::string::npos || colon + 1 == address.size()) return false;
+  try {
+    *port = std::stoi(address.substr(colon + 1));
+  } catch (const std::exception&) {
+    return false;
+  }
+  *ip = address.substr(0, colon);
+  if (ip->empty() || *ip == "localhost") *ip = "127.0.0.1";
+  return true;
+}
+
+void ToProto(const common::EchoRequest& from, pb::EchoRequest* to) {
+  to->set_message(from.message);
+  to->set_timestamp(from.timestamp);
+  to->set_sequence_number(from.sequence_number);
+}
+
+void ToProto(const common::EchoResponse& from, pb::EchoResponse* to) {
+  to->set_message(from.message);
+  to->set_client_timestamp(from.client_timestamp);
+  to->set_server_timestamp(from.server_timestamp);
+  to->set_sequence_number(from.sequence_number);
+}
+
+void ToProto(const common::StreamRequest& from, pb::StreamRequest* to) {
+  to->set_chunk_size(from.chunk_size);
+  to->set_chunk_count(from.chunk_count);
+  to->set_delay_ms(from.delay_ms);
+}
+
+void ToProto(const common::DataChunk& from, pb::DataChunk* to) {
+  to->set_sequence_number(from.sequence_number);
+  to->set_data(from.data.data(), from.data.size());
+  to->set_checksum(from.checksum);
+  to->set_timestamp(from.timestamp);
+}
+
+void ToProto(const common::UploadResponse& from, pb::UploadResponse* to) {
+  to->set_total_bytes(from.total_bytes);
+  to->set_chunk_count(from.chunk_count);
+  to->set_duration_ns(from.duration_ns);
+  to->set_checksum_valid(from.checksum_valid);
+}
+
+void ToProto(const common::BatchRequest& from, pb::BatchRequest* to) {
+  to->clear_items();
+  to->mutable_items()->Reserve(static_cast<int>(from.items.size()));
+  for (const auto& item : from.items) {
+    auto* out = to->add_items();
+    out->set_id(item.id);
+    out->set_operation(item.operation);
+    out->set_data(ToBytes(item.data));
+  }
+  to->set_fail_on_error(from.fail_on_error);
+}
+
+void ToProto(const common::BatchResponse& from, pb::BatchResponse* to) {
+  to->clear_results();
+  to->mutable_results()->Reserve(static_cast<int>(from.results.size()));
+  for (const auto& result : from.results) {
+    auto* out = to->add_results();
+    out->set_id(result.id);
+    out->set_success(result.success);
+    out->set_error_message(result.error_message);
+    out->set_result_data(ToBytes(result.result_data));
+  }
+  to->set_total_processed(from.total_processed);
+  to->set_total_failed(from.total_failed);
+}
+
+void FromProto(const pb::EchoRequest& from, common::EchoRequest* to) {
+  to->message = from.message();
+  to->timestamp = from.timestamp();
+  to->sequence_number = from.sequence_number();
+}
+
+void FromProto(const pb::EchoResponse& from, common::EchoResponse* to) {
+  to->message = from.message();
+  to->client_timestamp = from.client_timestamp();
+  to->server_timestamp = from.server_timestamp();
+  to->sequence_number = from.sequence_number();
+}
+
+void FromProto(const pb::StreamRequest& from, common::StreamRequest* to) {
+  to->chunk_size = from.chunk_size();
+  to->chunk_count = from.chunk_count();
+  to->delay_ms = from.delay_ms();
+}
+
+void FromProto(const pb::DataChunk& from, common::DataChunk* to) {
+  to->sequence_number = from.sequence_number();
+  to->data.assign(from.data().begin(), from.data().end());
+  to->checksum = from.checksum();
+  to->timestamp = from.timestamp();
+}
+
+void FromProto(const pb::UploadResponse& from, common::UploadResponse* to) {
+  to->total_bytes = from.total_bytes();
+  to->chunk_count = from.chunk_count();
+  to->duration_ns = from.duration_ns();
+  to->checksum_valid = from.checksum_valid();
+}
+
+void FromProto(const pb::BatchRequest& from, common::BatchRequest* to) {
+  to->items.clear();
+  to->items.reserve(static_cast<size_t>(from.items_size()));
+  for (const auto& item : from.items()) {
+    common::BatchItem out;
+    out.id = item.id();
+    out.operation = item.operation();
+    out.data = FromBytes(item.data());
+    to->items.push_back(std::move(out));
+  }
+  to->fail_on_error = from.fail_on_error();
+}
+
+void FromProto(const pb::BatchResponse& from, common::BatchResponse* to) {
+  to->results.clear();
+  to->results.reserve(static_cast<size_t>(from.results_size()));
+  for (const auto& result : from.results()) {
+    common::BatchResult out;
+    out.id = result.id();
+    out.success = result.success();
+    out.error_message = result.error_message();
+    out.result_data = FromBytes(result.result_data());
+    to->results.push_back(std::move(out));
+  }
+  to->total_processed = from.total_processed();
+  to->total_failed = from.total_failed();
+}
+
+// Message-zoo shapes
+void ToProto(const common::NestedMessage& from, pb::NestedMessage* to) {
+  common::shapes::NestedToProto(from, to);
+}
+
+void ToProto(const common::ArrayMessage& from, pb::ArrayMessage* to) {
+  common::shapes::ArraysToProto(from, to);
+}
+
+void ToProto(const common::MapMessage& from, pb::MapMessage* to) {
+  common::shapes::MapToProto(from, to);
+}
+
+void ToProto(const common::SparseMessage& from, pb::SparseMessage* to) {
+  common::shapes::SparseToProto(from, to);
+}
+
+void ToProto(const common::StringMessage& from, pb::StringMessage* to) {
+  common::shapes::StringsToProto(from, to);
+}
+
+void FromProto(const pb::NestedMessage& from, common::NestedMessage* to) {
+  common::shapes::NestedFromProto(from, to);
+}
+
+void FromProto(const pb::ArrayMessage& from, common::ArrayMessage* to) {
+  common::shapes::ArraysFromProto(from, to);
+}
+
+void FromProto(const pb::MapMessage& from, common::MapMessage* to) {
+  common::shapes::MapFromProto(from, to);
+}
+
+void FromProto(const pb::SparseMessage& from, common::SparseMessage* to) {
+  common::shapes::SparseFromProto(from, to);
+}
+
+void FromProto(const pb::StringMessage& from, common::StringMessage* to) {
+  common::shapes::StringsFromProto(from, to);
+}
+
+::trpc::Status ToStatus(common::ErrorCode code, const std::string& message) {
+  if (code == common::ErrorCode::OK) return ::trpc::Status();
+  return ::trpc::Status(0, static_cast<int>(code), message);
+}
+
+common::ErrorCode FromStatus(const ::trpc::Status& status) {
+  if (status.OK()) return common::ErrorCode::OK;
+  if (status.GetFrameworkRetCode() != 0) return FromRetCode(status.GetFrameworkRetCode());
+
+  int code = status.GetFuncRetCode();
+  if (code < 0 || code > static_cast<int>(common::ErrorCode::UNAVAILABLE)) {
+    return common::ErrorCode::INTERNAL;
+  }
+  return static_cast<common::ErrorCode>(code);
+}
+
+common::ErrorCode FromRetCode(int code) {
+  switch (code) {
+    case ::trpc::TrpcRetCode::TRPC_SERVER_NOSERVICE_ERR:
+    case ::trpc::TrpcRetCode::TRPC_SERVER_NOFUNC_ERR:
+      return common::ErrorCode::NOT_FOUND;
+    case ::trpc::TrpcRetCode::TRPC_SERVER_TIMEOUT_ERR:
+    case ::trpc::TrpcRetCode::TRPC_CLIENT_INVOKE_TIMEOUT_ERR:
+    case ::trpc::TrpcRetCode::TRPC_CLIENT_FULL_LINK_TIMEOUT_ERR:
+      return common::ErrorCode::DEADLINE_EXCEEDED;
+    case ::trpc::TrpcRetCode::TRPC_SERVER_OVERLOAD_ERR:
+    case ::trpc::TrpcRetCode::TRPC_CLIENT_CONNECT_ERR:
+    case ::trpc::TrpcRetCode::TRPC_CLIENT_NETWORK_ERR:
+    case ::trpc::TrpcRetCode::TRPC_CLIENT_OVERLOAD_ERR:
+      return common::ErrorCode::UNAVAILABLE;
+    default:
+      return common::ErrorCode::INTERNAL;
+  }
+}
+
+// ChunkChannel implementation
+void ChunkChannel::Push(const common::DataChunk& chunk) {
+  {
+    std::lock_guard<::trpc::FiberMutex> lock(mutex_);
+    if (closed_) return;
+    pending_.push_back(chunk);
+  }
+  cv_.notify_one();
+}
+
+void ChunkChannel::Close(common::ErrorCode code, const std::string& message) {
+  {
+    std::lock_guard<::trpc::FiberMutex> lock(mutex_);
+    if (closed_) return;
+    closed_ = true;
+    code_ = code;
+    message_ = message;
+  }
+  cv_.notify_all();
+}
+
+bool ChunkChannel::Pop(pb::DataChunk* chunk) {
+  common::DataChunk next;
+  {
+    std::unique_lock<::trpc::FiberMutex> lock(mutex_);
+    cv_.wait(lock, [this] { return closed_ || !pending_.empty(); });
+    if (pending_.empty()) return false;
+    next = std::move(pending_.front());
+    pending_.pop_front();
+  }
+  ToProto(next, chunk);
+  return true;
+}
+
+common::ErrorCode ChunkChannel::code() {
+  std::lock_guard<::trpc::FiberMutex> lock(mutex_);
+  return code_;
+}
+
+std::string ChunkChannel::message() {
+  std::lock_guard<::trpc::FiberMutex> lock(mutex_);
+  return message_;
+}
+
+common::StreamCallback<common::DataChunk> PushTo(std::shared_ptr<ChunkChannel> channel) {
+  return [channel](const common::DataChunk& chunk) { channel->Push(chunk); };
+}
+
+common::CompletionCallback CloseOf(std::shared_ptr<ChunkChannel> channel) {
+  return [channel](common::ErrorCode code, const std::string& message) {
+    channel->Close(code, message);
+  };
+}
+
+} // namespace trpc_impl
+} // namespace benchmark